@@ -96,6 +96,11 @@ namespace FLAC {
 		 * implementations that do nothing.  In order for seeking to work
 		 * you must override seek_callback(), tell_callback(),
 		 * length_callback(), and eof_callback().
+		 *
+		 * In pull mode (see set_pull_mode()) write_callback() is never
+		 * called and the decoded audio is retrieved with read_samples()
+		 * instead, so an implementation of it can simply return
+		 * \c FLAC__STREAM_DECODER_WRITE_STATUS_ABORT.
 		 */
 		class FLACPP_API Stream {
 		public:
@@ -125,6 +130,12 @@ namespace FLAC {
 			virtual bool set_ogg_serial_number(long value);                        ///< See FLAC__stream_decoder_set_ogg_serial_number()
 			virtual bool set_decode_chained_stream(bool value);                    ///< See FLAC__stream_decoder_set_decode_chained_stream()
 			virtual bool set_md5_checking(bool value);                             ///< See FLAC__stream_decoder_set_md5_checking()
+			virtual uint32_t set_num_threads(uint32_t value);                      ///< See FLAC__stream_decoder_set_num_threads()
+			virtual bool set_interleaved_output(::FLAC__StreamDecoderPCMFormat format, void *buffer, size_t buffer_size); ///< See FLAC__stream_decoder_set_interleaved_output()
+			virtual bool set_pull_mode(bool value);                                ///< See FLAC__stream_decoder_set_pull_mode()
+			virtual bool set_build_frame_index(bool value);                        ///< See FLAC__stream_decoder_set_build_frame_index()
+			virtual bool set_frame_index(const ::FLAC__StreamMetadata *frame_index); ///< See FLAC__stream_decoder_set_frame_index()
+			virtual bool set_prefetch_buffers(uint32_t num_buffers);              ///< See FLAC__stream_decoder_set_prefetch_buffers()
 			virtual bool set_metadata_respond(::FLAC__MetadataType type);          ///< See FLAC__stream_decoder_set_metadata_respond()
 			virtual bool set_metadata_respond_application(const FLAC__byte id[4]); ///< See FLAC__stream_decoder_set_metadata_respond_application()
 			virtual bool set_metadata_respond_all();                               ///< See FLAC__stream_decoder_set_metadata_respond_all()
@@ -136,6 +147,11 @@ namespace FLAC {
 			State get_state() const;                                          ///< See FLAC__stream_decoder_get_state()
 			virtual bool get_decode_chained_stream() const;                   ///< See FLAC__stream_decoder_get_decode_chained_stream()
 			virtual bool get_md5_checking() const;                            ///< See FLAC__stream_decoder_get_md5_checking()
+			virtual uint32_t get_num_threads() const;                         ///< See FLAC__stream_decoder_get_num_threads()
+			virtual bool get_pull_mode() const;                               ///< See FLAC__stream_decoder_get_pull_mode()
+			virtual bool get_build_frame_index() const;                       ///< See FLAC__stream_decoder_get_build_frame_index()
+			virtual const ::FLAC__StreamMetadata *get_frame_index() const;    ///< See FLAC__stream_decoder_get_frame_index()
+			virtual uint32_t get_prefetch_buffers() const;                    ///< See FLAC__stream_decoder_get_prefetch_buffers()
 			virtual FLAC__uint64 get_total_samples() const;                   ///< See FLAC__stream_decoder_get_total_samples()
 			virtual FLAC__uint64 find_total_samples();			  ///< See FLAC__stream_decoder_find_total_samples()
 			virtual uint32_t get_channels() const;                            ///< See FLAC__stream_decoder_get_channels()
@@ -145,6 +161,7 @@ namespace FLAC {
 			virtual uint32_t get_blocksize() const;                           ///< See FLAC__stream_decoder_get_blocksize()
 			virtual bool get_decode_position(FLAC__uint64 *position) const;   ///< See FLAC__stream_decoder_get_decode_position()
 			virtual int32_t get_link_lengths(FLAC__uint64 **link_lengths);    ///< See FLAC__stream_decoder_get_link_lengths()
+			virtual bool get_profile(::FLAC__StreamDecoderProfile *profile) const; ///< See FLAC__stream_decoder_get_profile()
 
 			virtual ::FLAC__StreamDecoderInitStatus init();      ///< Seek FLAC__stream_decoder_init_stream()
 			virtual ::FLAC__StreamDecoderInitStatus init_ogg();  ///< Seek FLAC__stream_decoder_init_ogg_stream()
@@ -163,6 +180,9 @@ namespace FLAC {
 			virtual bool skip_single_link();              ///< See FLAC__stream_decoder_skip_single_link()
 
 			virtual bool seek_absolute(FLAC__uint64 sample); ///< See FLAC__stream_decoder_seek_absolute()
+			virtual uint32_t read_samples(::FLAC__StreamDecoderPCMFormat format, void *buffer, uint32_t samples); ///< See FLAC__stream_decoder_read_samples()
+			virtual bool save_frame_index(const char *filename) const; ///< See FLAC__stream_decoder_save_frame_index()
+			virtual bool load_frame_index(const char *filename);       ///< See FLAC__stream_decoder_load_frame_index()
 		protected:
 			/// see FLAC__StreamDecoderReadCallback
 			virtual ::FLAC__StreamDecoderReadStatus read_callback(FLAC__byte buffer[], size_t *bytes) = 0;
@@ -240,6 +260,10 @@ namespace FLAC {
 			virtual ::FLAC__StreamDecoderInitStatus init_ogg(FILE *file);                  ///< See FLAC__stream_decoder_init_ogg_FILE()
 			virtual ::FLAC__StreamDecoderInitStatus init_ogg(const char *filename);        ///< See FLAC__stream_decoder_init_ogg_file()
 			virtual ::FLAC__StreamDecoderInitStatus init_ogg(const std::string &filename); ///< See FLAC__stream_decoder_init_ogg_file()
+			virtual ::FLAC__StreamDecoderInitStatus init_mmap(const char *filename);            ///< See FLAC__stream_decoder_init_mmap()
+			virtual ::FLAC__StreamDecoderInitStatus init_mmap(const std::string &filename);     ///< See FLAC__stream_decoder_init_mmap()
+			virtual ::FLAC__StreamDecoderInitStatus init_ogg_mmap(const char *filename);        ///< See FLAC__stream_decoder_init_ogg_mmap()
+			virtual ::FLAC__StreamDecoderInitStatus init_ogg_mmap(const std::string &filename); ///< See FLAC__stream_decoder_init_ogg_mmap()
 		protected:
 			// this is a dummy implementation to satisfy the pure virtual in Stream that is actually supplied internally by the C layer
 			virtual ::FLAC__StreamDecoderReadStatus read_callback(FLAC__byte buffer[], size_t *bytes);
@@ -133,6 +133,7 @@ namespace FLAC {
 			virtual bool set_sample_rate(uint32_t value);                   ///< See FLAC__stream_encoder_set_sample_rate()
 			virtual bool set_compression_level(uint32_t value);             ///< See FLAC__stream_encoder_set_compression_level()
 			virtual bool set_blocksize(uint32_t value);                     ///< See FLAC__stream_encoder_set_blocksize()
+			virtual bool set_variable_blocksize(uint32_t value);            ///< See FLAC__stream_encoder_set_variable_blocksize()
 			virtual bool set_do_mid_side_stereo(bool value);                ///< See FLAC__stream_encoder_set_do_mid_side_stereo()
 			virtual bool set_loose_mid_side_stereo(bool value);             ///< See FLAC__stream_encoder_set_loose_mid_side_stereo()
 			virtual bool set_apodization(const char *specification);        ///< See FLAC__stream_encoder_set_apodization()
@@ -148,12 +149,16 @@ namespace FLAC {
 			virtual bool set_metadata(::FLAC__StreamMetadata **metadata, uint32_t num_blocks);    ///< See FLAC__stream_encoder_set_metadata()
 			virtual bool set_metadata(FLAC::Metadata::Prototype **metadata, uint32_t num_blocks); ///< See FLAC__stream_encoder_set_metadata()
 			virtual bool set_limit_min_bitrate(bool value);                 ///< See FLAC__stream_encoder_set_limit_min_bitrate()
+			virtual bool set_estimate_only(uint32_t value);                 ///< See FLAC__stream_encoder_set_estimate_only()
+			virtual bool set_write_buffers(bool value);                     ///< See FLAC__stream_encoder_set_write_buffer_callback(); if \c true, write_buffer_callback() is called instead of write_callback()
 			virtual uint32_t set_num_threads(uint32_t value);                       ///< See FLAC__stream_encoder_set_num_threads()
+			virtual bool set_thread_pool(::FLAC__ThreadPool *value);               ///< See FLAC__stream_encoder_set_thread_pool()
 
 			/* get_state() is not virtual since we want subclasses to be able to return their own state */
 			State get_state() const;                                   ///< See FLAC__stream_encoder_get_state()
 			virtual Decoder::Stream::State get_verify_decoder_state() const; ///< See FLAC__stream_encoder_get_verify_decoder_state()
 			virtual void get_verify_decoder_error_stats(FLAC__uint64 *absolute_sample, uint32_t *frame_number, uint32_t *channel, uint32_t *sample, FLAC__int32 *expected, FLAC__int32 *got); ///< See FLAC__stream_encoder_get_verify_decoder_error_stats()
+			virtual void get_estimate(FLAC__uint64 *bytes, FLAC__uint64 *bytes_low, FLAC__uint64 *bytes_high, uint32_t *frames_analysed) const; ///< See FLAC__stream_encoder_get_estimate()
 			virtual bool     get_verify() const;                       ///< See FLAC__stream_encoder_get_verify()
 			virtual bool     get_streamable_subset() const;            ///< See FLAC__stream_encoder_get_streamable_subset()
 			virtual bool     get_do_mid_side_stereo() const;           ///< See FLAC__stream_encoder_get_do_mid_side_stereo()
@@ -162,6 +167,7 @@ namespace FLAC {
 			virtual uint32_t get_bits_per_sample() const;              ///< See FLAC__stream_encoder_get_bits_per_sample()
 			virtual uint32_t get_sample_rate() const;                  ///< See FLAC__stream_encoder_get_sample_rate()
 			virtual uint32_t get_blocksize() const;                    ///< See FLAC__stream_encoder_get_blocksize()
+			virtual uint32_t get_variable_blocksize() const;           ///< See FLAC__stream_encoder_get_variable_blocksize()
 			virtual uint32_t get_max_lpc_order() const;                ///< See FLAC__stream_encoder_get_max_lpc_order()
 			virtual uint32_t get_qlp_coeff_precision() const;          ///< See FLAC__stream_encoder_get_qlp_coeff_precision()
 			virtual bool     get_do_qlp_coeff_prec_search() const;     ///< See FLAC__stream_encoder_get_do_qlp_coeff_prec_search()
@@ -172,7 +178,9 @@ namespace FLAC {
 			virtual uint32_t get_rice_parameter_search_dist() const;   ///< See FLAC__stream_encoder_get_rice_parameter_search_dist()
 			virtual FLAC__uint64 get_total_samples_estimate() const;   ///< See FLAC__stream_encoder_get_total_samples_estimate()
 			virtual bool     get_limit_min_bitrate() const;            ///< See FLAC__stream_encoder_get_limit_min_bitrate()
+			virtual uint32_t get_estimate_only() const;                ///< See FLAC__stream_encoder_get_estimate_only()
 			virtual uint32_t get_num_threads() const;                  ///< See FLAC__stream_encoder_get_num_threads()
+			virtual bool     get_profile(::FLAC__StreamEncoderProfile *profile) const; ///< See FLAC__stream_encoder_get_profile()
 
 			virtual ::FLAC__StreamEncoderInitStatus init();            ///< See FLAC__stream_encoder_init_stream()
 			virtual ::FLAC__StreamEncoderInitStatus init_ogg();        ///< See FLAC__stream_encoder_init_ogg_stream()
@@ -181,6 +189,8 @@ namespace FLAC {
 
 			virtual bool process(const FLAC__int32 * const buffer[], uint32_t samples);     ///< See FLAC__stream_encoder_process()
 			virtual bool process_interleaved(const FLAC__int32 buffer[], uint32_t samples); ///< See FLAC__stream_encoder_process_interleaved()
+
+			virtual bool release_buffer(FLAC__byte buffer[]); ///< See FLAC__stream_encoder_release_buffer()
 		protected:
 			/// See FLAC__StreamEncoderReadCallback
 			virtual ::FLAC__StreamEncoderReadStatus read_callback(FLAC__byte buffer[], size_t *bytes);
@@ -188,6 +198,9 @@ namespace FLAC {
 			/// See FLAC__StreamEncoderWriteCallback
 			virtual ::FLAC__StreamEncoderWriteStatus write_callback(const FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame) = 0;
 
+			/// See FLAC__StreamEncoderWriteBufferCallback; the default implementation calls write_callback() and releases the buffer
+			virtual ::FLAC__StreamEncoderWriteStatus write_buffer_callback(FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame);
+
 			/// See FLAC__StreamEncoderSeekCallback
 			virtual ::FLAC__StreamEncoderSeekStatus seek_callback(FLAC__uint64 absolute_byte_offset);
 
@@ -205,6 +218,7 @@ namespace FLAC {
 
 			static ::FLAC__StreamEncoderReadStatus read_callback_(const ::FLAC__StreamEncoder *encoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
 			static ::FLAC__StreamEncoderWriteStatus write_callback_(const ::FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame, void *client_data);
+			static ::FLAC__StreamEncoderWriteStatus write_buffer_callback_(const ::FLAC__StreamEncoder *encoder, FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame, void *client_data);
 			static ::FLAC__StreamEncoderSeekStatus seek_callback_(const FLAC__StreamEncoder *encoder, FLAC__uint64 absolute_byte_offset, void *client_data);
 			static ::FLAC__StreamEncoderTellStatus tell_callback_(const FLAC__StreamEncoder *encoder, FLAC__uint64 *absolute_byte_offset, void *client_data);
 			static void metadata_callback_(const ::FLAC__StreamEncoder *encoder, const ::FLAC__StreamMetadata *metadata, void *client_data);
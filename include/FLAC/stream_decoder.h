@@ -88,9 +88,11 @@ extern "C" {
  * - The program initializes the instance to validate the settings and
  *   prepare for decoding using
  *   - FLAC__stream_decoder_init_stream() or FLAC__stream_decoder_init_FILE()
- *     or FLAC__stream_decoder_init_file() for native FLAC,
+ *     or FLAC__stream_decoder_init_file() or FLAC__stream_decoder_init_mmap()
+ *     for native FLAC,
  *   - FLAC__stream_decoder_init_ogg_stream() or FLAC__stream_decoder_init_ogg_FILE()
- *     or FLAC__stream_decoder_init_ogg_file() for Ogg FLAC
+ *     or FLAC__stream_decoder_init_ogg_file() or
+ *     FLAC__stream_decoder_init_ogg_mmap() for Ogg FLAC
  * - The program calls the FLAC__stream_decoder_process_*() functions
  *   to decode data, which subsequently calls the callbacks.
  * - The program finishes the decoding with FLAC__stream_decoder_finish(),
@@ -151,6 +153,15 @@ extern "C" {
  * Subsequently, the first time the write callback is called it will be
  * passed a (possibly partial) block starting at that sample.
  *
+ * Instead of receiving the audio through the write callback, the client
+ * can also pull it from the decoder.  After enabling pull mode with
+ * FLAC__stream_decoder_set_pull_mode(), each call to
+ * FLAC__stream_decoder_read_samples() decodes only as many frames as
+ * needed to return the requested number of interleaved samples, and
+ * keeps the rest of the last frame for the next call.  Seeking with
+ * FLAC__stream_decoder_seek_absolute() is sample-accurate in this mode
+ * too.
+ *
  * If the client cannot seek via the callback interface provided, but still
  * has another way of seeking, it can flush the decoder using
  * FLAC__stream_decoder_flush() and start feeding data from the new position
@@ -259,6 +270,11 @@ typedef enum {
 extern FLAC_API const char * const FLAC__StreamDecoderStateString[];
 
 
+#define FLAC__STREAM_DECODER_SET_NUM_THREADS_OK 0
+#define FLAC__STREAM_DECODER_SET_NUM_THREADS_NOT_COMPILED_WITH_MULTITHREADING_ENABLED 1
+#define FLAC__STREAM_DECODER_SET_NUM_THREADS_ALREADY_INITIALIZED 2
+#define FLAC__STREAM_DECODER_SET_NUM_THREADS_TOO_MANY_THREADS 3
+
 /** Possible return values for the FLAC__stream_decoder_init_*() functions.
  */
 typedef enum {
@@ -480,6 +496,85 @@ typedef enum {
 extern FLAC_API const char * const FLAC__StreamDecoderErrorStatusString[];
 
 
+/** Sample formats for interleaved output, see
+ *  FLAC__stream_decoder_set_interleaved_output().
+ */
+typedef enum {
+
+	FLAC__STREAM_DECODER_PCM_FORMAT_S16LE,
+	/**< Signed 16-bit little-endian samples, for streams of up to 16 bits
+	 * per sample.
+	 */
+
+	FLAC__STREAM_DECODER_PCM_FORMAT_S24LE,
+	/**< Signed 24-bit little-endian samples packed in 3 bytes each, for
+	 * streams of up to 24 bits per sample.
+	 */
+
+	FLAC__STREAM_DECODER_PCM_FORMAT_S32LE,
+	/**< Signed 32-bit little-endian samples. */
+
+	FLAC__STREAM_DECODER_PCM_FORMAT_FLOAT
+	/**< Native \c float samples, scaled so that full scale for the bits
+	 * per sample of the stream maps to [-1.0,1.0).  Samples of more than
+	 * 24 bits lose precision.
+	 */
+
+} FLAC__StreamDecoderPCMFormat;
+
+/** Maps a FLAC__StreamDecoderPCMFormat to a C string.
+ *
+ *  Using a FLAC__StreamDecoderPCMFormat as the index to this array
+ *  will give the string equivalent.  The contents should not be modified.
+ */
+extern FLAC_API const char * const FLAC__StreamDecoderPCMFormatString[];
+
+
+/** The stages of decoding that are timed when libFLAC is built with
+ *  profiling, see FLAC__stream_decoder_get_profile().
+ */
+typedef enum {
+
+	FLAC__STREAM_DECODER_PROFILE_SYNC,
+	/**< Searching for the next frame sync code. */
+
+	FLAC__STREAM_DECODER_PROFILE_HEADER,
+	/**< Reading and checking the frame headers. */
+
+	FLAC__STREAM_DECODER_PROFILE_RICE,
+	/**< Reading the Rice coded residual. */
+
+	FLAC__STREAM_DECODER_PROFILE_RESTORE,
+	/**< Restoring the signal from the residual of fixed and LPC
+	 * predictors. */
+
+	FLAC__STREAM_DECODER_PROFILE_DECORRELATION,
+	/**< Undoing the stereo decorrelation. */
+
+	FLAC__STREAM_DECODER_PROFILE_MD5,
+	/**< Updating the MD5 signature of the output. */
+
+	FLAC__STREAM_DECODER_PROFILE_NUM_STAGES
+	/**< The number of stages, not a stage itself. */
+
+} FLAC__StreamDecoderProfileStage;
+
+/** Maps a FLAC__StreamDecoderProfileStage to a C string.
+ *
+ *  Using a FLAC__StreamDecoderProfileStage as the index to this array
+ *  will give the string equivalent.  The contents should not be modified.
+ */
+extern FLAC_API const char * const FLAC__StreamDecoderProfileStageString[];
+
+/** The time spent in each stage of decoding, and the number of times
+ *  each stage was entered, see FLAC__stream_decoder_get_profile().
+ */
+typedef struct {
+	FLAC__uint64 nanoseconds[FLAC__STREAM_DECODER_PROFILE_NUM_STAGES];
+	FLAC__uint64 calls[FLAC__STREAM_DECODER_PROFILE_NUM_STAGES];
+} FLAC__StreamDecoderProfile;
+
+
 /***********************************************************************
  *
  * class FLAC__StreamDecoder
@@ -856,6 +951,200 @@ FLAC_API FLAC__bool FLAC__stream_decoder_set_decode_chained_stream(FLAC__StreamD
  */
 FLAC_API FLAC__bool FLAC__stream_decoder_set_md5_checking(FLAC__StreamDecoder *decoder, FLAC__bool value);
 
+/** Set the maximum number of threads to use during decoding.
+ *  Set to a value different than 1 to enable multithreaded decoding.
+ *
+ *  When multithreading is enabled, a call to
+ *  FLAC__stream_decoder_process_until_end_of_stream() scans ahead in
+ *  the input for frame boundaries and hands complete frames to worker
+ *  threads, which do all of the subframe parsing, residual decoding,
+ *  prediction and channel decorrelation.  The decoded frames are passed
+ *  to the write callback from the calling thread and are guaranteed to
+ *  be in the correct order, as are any calls to the error callback.
+ *  On corrupted input, the decoded audio is the same as when decoding
+ *  in a single thread, but subsequent errors in a damaged region may
+ *  be reported through fewer calls to the error callback.
+ *
+ *  Frame-parallel decoding is only used for native FLAC streams that
+ *  have a STREAMINFO block, and only by
+ *  FLAC__stream_decoder_process_until_end_of_stream().  All other
+ *  process, skip and seek functions, as well as Ogg FLAC decoding,
+ *  always decode in the calling thread.  Because the decoder reads
+ *  ahead, the read callback may be called for data well beyond the
+ *  frame that is being passed to the write callback.
+ *
+ *  When MD5 checking is enabled as well (see
+ *  FLAC__stream_decoder_set_md5_checking()), the decoded samples are
+ *  queued for a dedicated MD5 thread, so calculating the MD5 sum
+ *  overlaps with decoding.  This applies to all process functions.
+ *
+ *  Currently, passing a value of 0 is synonymous with a value of 1,
+ *  but this might change in the future.
+ *
+ * \default \c 1
+ * \param  decoder  A decoder instance to set.
+ * \param  value    See above.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval uint32_t
+ *    - \c FLAC__STREAM_DECODER_SET_NUM_THREADS_OK if the number of threads was set correctly,
+ *    - \c FLAC__STREAM_DECODER_SET_NUM_THREADS_NOT_COMPILED_WITH_MULTITHREADING_ENABLED when
+ *    multithreading was not enabled at compilation,
+ *    - \c FLAC__STREAM_DECODER_SET_NUM_THREADS_ALREADY_INITIALIZED when the decoder was
+ *    already initialized,
+ *    - \c FLAC__STREAM_DECODER_SET_NUM_THREADS_TOO_MANY_THREADS when
+ *    the number of threads was larger than the maximum allowed number of threads (currently
+ *    64).
+ */
+FLAC_API uint32_t FLAC__stream_decoder_set_num_threads(FLAC__StreamDecoder *decoder, uint32_t value);
+
+/** Direct the decoder to also store the decoded samples of every frame
+ *  interleaved in a buffer supplied by the client, converted to
+ *  \a format.  The samples are stored right before the write callback
+ *  is called for that frame, so the write callback (or the code calling
+ *  the process functions) can use the buffer directly instead of
+ *  interleaving the \a buffer argument of the write callback itself,
+ *  which is still passed as usual.
+ *
+ *  Integer samples are stored as they are decoded, i.e. right-justified,
+ *  so a 12-bit stream decoded to \c FLAC__STREAM_DECODER_PCM_FORMAT_S16LE
+ *  has values between -2048 and 2047.
+ *
+ *  Unlike the other setters, this function can be called in any state,
+ *  for example to pass a different buffer before each call to
+ *  FLAC__stream_decoder_process_single().  If a frame does not fit in
+ *  the buffer, or has more bits per sample than \a format can hold, the
+ *  write callback is not called and decoding is aborted as if the write
+ *  callback had returned \c FLAC__STREAM_DECODER_WRITE_STATUS_ABORT.  A
+ *  buffer of the maximum blocksize (see the \c STREAMINFO block) times
+ *  the number of channels times the sample size is always large enough.
+ *  For \c FLAC__STREAM_DECODER_PCM_FORMAT_S16LE, \c ..._S32LE and
+ *  \c ..._FLOAT, \a buffer must be aligned like an array of 16-bit
+ *  integers, 32-bit integers or \c float respectively.
+ *
+ *  Interleaved output is switched off again by FLAC__stream_decoder_finish()
+ *  or by passing a \c NULL \a buffer.
+ *
+ * \default Interleaved output is off.
+ * \param  decoder      A decoder instance to set.
+ * \param  format       The sample format to convert to.
+ * \param  buffer       The buffer to store the samples in, or \c NULL.
+ * \param  buffer_size  The size of \a buffer in bytes.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if \a format is invalid, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_interleaved_output(FLAC__StreamDecoder *decoder, FLAC__StreamDecoderPCMFormat format, void *buffer, size_t buffer_size);
+
+/** Set the decoder to pull mode, in which the client retrieves the
+ *  decoded audio with FLAC__stream_decoder_read_samples() instead of
+ *  through the write callback.  In pull mode the write callback is never
+ *  called, so \c NULL may be passed for it to the init functions.
+ *
+ *  Audio frames decoded by FLAC__stream_decoder_read_samples() are
+ *  stored straight into the buffer passed to it; only the part of a
+ *  frame that does not fit is kept inside the decoder for the next call.
+ *  The process functions can still be used, for example to read the
+ *  metadata with FLAC__stream_decoder_process_until_end_of_metadata(),
+ *  but of the audio frames they decode only the last one is kept.  After
+ *  a successful FLAC__stream_decoder_seek_absolute(), the next call to
+ *  FLAC__stream_decoder_read_samples() starts exactly at the target
+ *  sample.
+ *
+ * \default \c false
+ * \param  decoder  A decoder instance to set.
+ * \param  value    Flag value (see above).
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_pull_mode(FLAC__StreamDecoder *decoder, FLAC__bool value);
+
+/** Direct the decoder to build a frame index while decoding a native
+ *  FLAC stream.  The frame index holds the position and first sample of
+ *  every frame.  It is returned by FLAC__stream_decoder_get_frame_index()
+ *  and can be stored with FLAC__stream_decoder_save_frame_index() to be
+ *  loaded again with FLAC__stream_decoder_load_frame_index() or
+ *  FLAC__stream_decoder_set_frame_index() next time the stream is
+ *  decoded.
+ *
+ *  Frames are only added to the index when they directly follow the
+ *  frames already in it, so the index covers the stream from the start
+ *  up to the furthest point it has been decoded sequentially, for
+ *  example by FLAC__stream_decoder_process_until_end_of_stream().  The
+ *  tell callback must be supported to build an index.
+ *
+ *  FLAC__stream_decoder_seek_absolute() uses the index as soon as it
+ *  covers the target sample, which reduces a seek to a single seek of
+ *  the input and decoding a single frame.
+ *
+ * \default \c false
+ * \param  decoder  A decoder instance to set.
+ * \param  value    Flag value (see above).
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_build_frame_index(FLAC__StreamDecoder *decoder, FLAC__bool value);
+
+/** Set the frame index used for seeking, for example one returned by
+ *  FLAC__stream_decoder_get_frame_index() for the same stream earlier.
+ *  The index is a \c SEEKTABLE metadata object with a seek point for
+ *  every frame, or for every frame from the start of the stream up to
+ *  some point.  This makes it possible to store the index in the FLAC
+ *  file itself, as a \c SEEKTABLE block with a point for every frame,
+ *  with the metadata interfaces; every decoder then seeks through that
+ *  table in a single step.  A \c SEEKTABLE object with a point for every
+ *  frame can also be created during encoding with
+ *  FLAC__metadata_object_seektable_template_append_spaced_points_by_samples()
+ *  and the blocksize of the encoder.
+ *
+ *  The index is copied and replaces any index built or set before.  It
+ *  is kept until FLAC__stream_decoder_finish(), so this function can be
+ *  called before or after initialization.
+ *
+ * \param  decoder      A decoder instance to set.
+ * \param  frame_index  A \c SEEKTABLE metadata object, or \c NULL to
+ *                      remove the frame index.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if \a frame_index is not a legal \c SEEKTABLE (see
+ *    FLAC__format_seektable_is_legal()) or memory allocation fails,
+ *    else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_frame_index(FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *frame_index);
+
+/** Set the number of buffers the decoder reads ahead into from a
+ *  background thread when decoding a file.  With a value of 2 or more,
+ *  a prefetch thread reads the file opened by
+ *  FLAC__stream_decoder_init_file() or FLAC__stream_decoder_init_FILE()
+ *  (or their Ogg counterparts) while the calling thread decodes, so
+ *  slow or stalling reads, for example from a network filesystem,
+ *  overlap with decoding instead of adding to it.  Two buffers give
+ *  double buffering, three triple buffering and so on.  Each buffer
+ *  holds 256 kilobytes.
+ *
+ *  Seeking discards the buffers that have been read ahead.  This
+ *  setting has no effect on FLAC__stream_decoder_init_stream() and
+ *  FLAC__stream_decoder_init_mmap(), or when libFLAC was compiled
+ *  without multithreading support.  A value of 0 or 1 disables the
+ *  prefetch thread.
+ *
+ * \default \c 0
+ * \param  decoder      A decoder instance to set.
+ * \param  num_buffers  The number of buffers, at most 8.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized or \a num_buffers
+ *    is too large, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_prefetch_buffers(FLAC__StreamDecoder *decoder, uint32_t num_buffers);
+
 /** Direct the decoder to pass on all metadata blocks of type \a type.
  *
  * \default By default, only the \c STREAMINFO block is returned via the
@@ -983,6 +1272,62 @@ FLAC_API FLAC__bool FLAC__stream_decoder_get_decode_chained_stream(const FLAC__S
  */
 FLAC_API FLAC__bool FLAC__stream_decoder_get_md5_checking(const FLAC__StreamDecoder *decoder);
 
+/** Get the maximum number of threads setting.
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval uint32_t
+ *    See FLAC__stream_decoder_set_num_threads().
+ */
+FLAC_API uint32_t FLAC__stream_decoder_get_num_threads(const FLAC__StreamDecoder *decoder);
+
+/** Get the pull mode setting.
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    See FLAC__stream_decoder_set_pull_mode().
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_get_pull_mode(const FLAC__StreamDecoder *decoder);
+
+/** Get the frame index building setting.
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    See FLAC__stream_decoder_set_build_frame_index().
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_get_build_frame_index(const FLAC__StreamDecoder *decoder);
+
+/** Get the number of prefetch buffers.
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval uint32_t
+ *    See FLAC__stream_decoder_set_prefetch_buffers().
+ */
+FLAC_API uint32_t FLAC__stream_decoder_get_prefetch_buffers(const FLAC__StreamDecoder *decoder);
+
+/** Get the frame index of the stream, as built while decoding (see
+ *  FLAC__stream_decoder_set_build_frame_index()) or set by the client.
+ *  The index is a \c SEEKTABLE metadata object with a seek point for
+ *  every frame.  It is owned by the decoder and is only valid until the
+ *  next call to a process, skip or seek function or to
+ *  FLAC__stream_decoder_finish(); use FLAC__metadata_object_clone() to
+ *  keep a copy.
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__StreamMetadata*
+ *    The frame index, or \c NULL if it is empty.
+ */
+FLAC_API const FLAC__StreamMetadata *FLAC__stream_decoder_get_frame_index(const FLAC__StreamDecoder *decoder);
+
 /** Get the total number of samples in the stream being decoded.
  *  Will only be valid after decoding has started and will contain the
  *  value from the \c STREAMINFO block.  A value of \c 0 means "unknown".
@@ -1112,6 +1457,25 @@ FLAC_API FLAC__bool FLAC__stream_decoder_get_decode_position(const FLAC__StreamD
  */
 FLAC_API const void *FLAC__stream_decoder_get_client_data(FLAC__StreamDecoder *decoder);
 
+/** Get the time spent in each stage of decoding.
+ *
+ *  The counters are only kept when libFLAC is built with profiling
+ *  (\c --enable-profiling with configure, \c WITH_PROFILING with CMake),
+ *  as timing the stages slows down decoding somewhat.  They are reset
+ *  by FLAC__stream_decoder_init_*() and are still available after
+ *  FLAC__stream_decoder_finish().
+ *
+ * \param  decoder  A decoder instance to query.
+ * \param  profile  Address at which to return the counters.
+ * \assert
+ *    \code decoder != NULL \endcode
+ *    \code profile != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if libFLAC was built without profiling, in which case
+ *    all counters are zero, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_get_profile(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderProfile *profile);
+
 #define FLAC__STREAM_DECODER_GET_LINK_LENGTHS_INVALID -1
 #define FLAC__STREAM_DECODER_GET_LINK_LENGTHS_NOT_INDEXED -2
 #define FLAC__STREAM_DECODER_GET_LINK_LENGTHS_MEMORY_ALLOCATION_ERROR -3
@@ -1199,7 +1563,9 @@ FLAC_API int32_t FLAC__stream_decoder_get_link_lengths(FLAC__StreamDecoder *deco
  *                            may also be supplied, all though this is slightly
  *                            less efficient for the decoder.
  * \param  write_callback     See FLAC__StreamDecoderWriteCallback.  This
- *                            pointer must not be \c NULL.
+ *                            pointer must not be \c NULL, unless pull
+ *                            mode is enabled (see
+ *                            FLAC__stream_decoder_set_pull_mode()).
  * \param  metadata_callback  See FLAC__StreamDecoderMetadataCallback.  This
  *                            pointer may be \c NULL if the callback is not
  *                            desired.
@@ -1280,7 +1646,9 @@ FLAC_API FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_stream(
  *                            may also be supplied, all though this is slightly
  *                            less efficient for the decoder.
  * \param  write_callback     See FLAC__StreamDecoderWriteCallback.  This
- *                            pointer must not be \c NULL.
+ *                            pointer must not be \c NULL, unless pull
+ *                            mode is enabled (see
+ *                            FLAC__stream_decoder_set_pull_mode()).
  * \param  metadata_callback  See FLAC__StreamDecoderMetadataCallback.  This
  *                            pointer may be \c NULL if the callback is not
  *                            desired.
@@ -1329,7 +1697,9 @@ FLAC_API FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_ogg_stream(
  *                            Note however that seeking will not work when
  *                            decoding from \c stdin since it is not seekable.
  * \param  write_callback     See FLAC__StreamDecoderWriteCallback.  This
- *                            pointer must not be \c NULL.
+ *                            pointer must not be \c NULL, unless pull
+ *                            mode is enabled (see
+ *                            FLAC__stream_decoder_set_pull_mode()).
  * \param  metadata_callback  See FLAC__StreamDecoderMetadataCallback.  This
  *                            pointer may be \c NULL if the callback is not
  *                            desired.
@@ -1379,7 +1749,9 @@ FLAC_API FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_FILE(
  *                            Note however that seeking will not work when
  *                            decoding from \c stdin since it is not seekable.
  * \param  write_callback     See FLAC__StreamDecoderWriteCallback.  This
- *                            pointer must not be \c NULL.
+ *                            pointer must not be \c NULL, unless pull
+ *                            mode is enabled (see
+ *                            FLAC__stream_decoder_set_pull_mode()).
  * \param  metadata_callback  See FLAC__StreamDecoderMetadataCallback.  This
  *                            pointer may be \c NULL if the callback is not
  *                            desired.
@@ -1426,7 +1798,9 @@ FLAC_API FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_ogg_FILE(
  *                            be opened with fopen().  Use \c NULL to decode from
  *                            \c stdin.  Note that \c stdin is not seekable.
  * \param  write_callback     See FLAC__StreamDecoderWriteCallback.  This
- *                            pointer must not be \c NULL.
+ *                            pointer must not be \c NULL, unless pull
+ *                            mode is enabled (see
+ *                            FLAC__stream_decoder_set_pull_mode()).
  * \param  metadata_callback  See FLAC__StreamDecoderMetadataCallback.  This
  *                            pointer may be \c NULL if the callback is not
  *                            desired.
@@ -1476,7 +1850,9 @@ FLAC_API FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_file(
  *                            be opened with fopen().  Use \c NULL to decode from
  *                            \c stdin.  Note that \c stdin is not seekable.
  * \param  write_callback     See FLAC__StreamDecoderWriteCallback.  This
- *                            pointer must not be \c NULL.
+ *                            pointer must not be \c NULL, unless pull
+ *                            mode is enabled (see
+ *                            FLAC__stream_decoder_set_pull_mode()).
  * \param  metadata_callback  See FLAC__StreamDecoderMetadataCallback.  This
  *                            pointer may be \c NULL if the callback is not
  *                            desired.
@@ -1499,6 +1875,103 @@ FLAC_API FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_ogg_file(
 	void *client_data
 );
 
+/** Initialize the decoder instance to decode native FLAC files through a
+ *  memory mapping.
+ *
+ *  This is the same as FLAC__stream_decoder_init_file(), except that the
+ *  file is mapped into memory with mmap() instead of being read with
+ *  fread().  This saves a copy of all input through the stdio buffer and
+ *  turns seeks into simple pointer arithmetic, which makes a difference
+ *  mostly when seeking a lot in large files.  Files that cannot be mapped,
+ *  like pipes, and all files on systems without mmap() are read with
+ *  fopen() and fread() as with FLAC__stream_decoder_init_file().
+ *
+ *  \note The file must not be truncated while it is being decoded; on
+ *  most systems, accessing the part of a mapping that is no longer backed
+ *  by the file raises SIGBUS.
+ *
+ *  This function should be called after FLAC__stream_decoder_new() and
+ *  FLAC__stream_decoder_set_*() but before any of the
+ *  FLAC__stream_decoder_process_*() functions.  Will set and return the
+ *  decoder state, which will be FLAC__STREAM_DECODER_SEARCH_FOR_METADATA
+ *  if initialization succeeded.
+ *
+ * \param  decoder            An uninitialized decoder instance.
+ * \param  filename           The name of the file to decode from.  The file will
+ *                            be opened with fopen().  Use \c NULL to decode from
+ *                            \c stdin.  Note that \c stdin is not seekable.
+ * \param  write_callback     See FLAC__StreamDecoderWriteCallback.  This
+ *                            pointer must not be \c NULL, unless pull
+ *                            mode is enabled (see
+ *                            FLAC__stream_decoder_set_pull_mode()).
+ * \param  metadata_callback  See FLAC__StreamDecoderMetadataCallback.  This
+ *                            pointer may be \c NULL if the callback is not
+ *                            desired.
+ * \param  error_callback     See FLAC__StreamDecoderErrorCallback.  This
+ *                            pointer must not be \c NULL.
+ * \param  client_data        This value will be supplied to callbacks in their
+ *                            \a client_data argument.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__StreamDecoderInitStatus
+ *    \c FLAC__STREAM_DECODER_INIT_STATUS_OK if initialization was successful;
+ *    see FLAC__StreamDecoderInitStatus for the meanings of other return values.
+ */
+FLAC_API FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_mmap(
+	FLAC__StreamDecoder *decoder,
+	const char *filename,
+	FLAC__StreamDecoderWriteCallback write_callback,
+	FLAC__StreamDecoderMetadataCallback metadata_callback,
+	FLAC__StreamDecoderErrorCallback error_callback,
+	void *client_data
+);
+
+/** Initialize the decoder instance to decode Ogg FLAC files through a
+ *  memory mapping.
+ *
+ *  This is the same as FLAC__stream_decoder_init_ogg_file(), except that
+ *  the file is mapped into memory as with FLAC__stream_decoder_init_mmap().
+ *
+ *  This function should be called after FLAC__stream_decoder_new() and
+ *  FLAC__stream_decoder_set_*() but before any of the
+ *  FLAC__stream_decoder_process_*() functions.  Will set and return the
+ *  decoder state, which will be FLAC__STREAM_DECODER_SEARCH_FOR_METADATA
+ *  if initialization succeeded.
+ *
+ *  \note Support for Ogg FLAC in the library is optional.  If this
+ *  library has been built without support for Ogg FLAC, this function
+ *  will return \c FLAC__STREAM_DECODER_INIT_STATUS_UNSUPPORTED_CONTAINER.
+ *
+ * \param  decoder            An uninitialized decoder instance.
+ * \param  filename           The name of the file to decode from.  The file will
+ *                            be opened with fopen().  Use \c NULL to decode from
+ *                            \c stdin.  Note that \c stdin is not seekable.
+ * \param  write_callback     See FLAC__StreamDecoderWriteCallback.  This
+ *                            pointer must not be \c NULL, unless pull
+ *                            mode is enabled (see
+ *                            FLAC__stream_decoder_set_pull_mode()).
+ * \param  metadata_callback  See FLAC__StreamDecoderMetadataCallback.  This
+ *                            pointer may be \c NULL if the callback is not
+ *                            desired.
+ * \param  error_callback     See FLAC__StreamDecoderErrorCallback.  This
+ *                            pointer must not be \c NULL.
+ * \param  client_data        This value will be supplied to callbacks in their
+ *                            \a client_data argument.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__StreamDecoderInitStatus
+ *    \c FLAC__STREAM_DECODER_INIT_STATUS_OK if initialization was successful;
+ *    see FLAC__StreamDecoderInitStatus for the meanings of other return values.
+ */
+FLAC_API FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_ogg_mmap(
+	FLAC__StreamDecoder *decoder,
+	const char *filename,
+	FLAC__StreamDecoderWriteCallback write_callback,
+	FLAC__StreamDecoderMetadataCallback metadata_callback,
+	FLAC__StreamDecoderErrorCallback error_callback,
+	void *client_data
+);
+
 /** Finish the decoding process.
  *  Flushes the decoding buffer, releases resources, resets the decoder
  *  settings to their defaults, and returns the decoder state to
@@ -1779,6 +2252,73 @@ FLAC_API FLAC__bool FLAC__stream_decoder_skip_single_link(FLAC__StreamDecoder *d
  */
 FLAC_API FLAC__bool FLAC__stream_decoder_seek_absolute(FLAC__StreamDecoder *decoder, FLAC__uint64 sample);
 
+/** Read decoded audio in pull mode (see
+ *  FLAC__stream_decoder_set_pull_mode()).  Stores up to \a samples
+ *  samples per channel in \a buffer, interleaved and converted to
+ *  \a format as described for FLAC__stream_decoder_set_interleaved_output(),
+ *  decoding as many metadata blocks and audio frames as needed.  The
+ *  metadata and error callbacks are called as usual while doing so.
+ *
+ *  Fewer samples than requested are only returned at the end of the
+ *  stream (or of an Ogg chain link), when decoding fails, or when the
+ *  number of channels changes; in the last case the next call returns
+ *  the samples with the new number of channels.  Check the decoder state
+ *  with FLAC__stream_decoder_get_state() to tell these cases apart.  If
+ *  a frame has more bits per sample than \a format can hold, the decoder
+ *  state is set to \c FLAC__STREAM_DECODER_ABORTED.
+ *
+ * \param  decoder  An initialized decoder instance in pull mode.
+ * \param  format   The sample format to convert to.
+ * \param  buffer   The buffer to store the samples in.  It must be
+ *                  large enough for \a samples times the number of
+ *                  channels samples of \a format, and must be aligned
+ *                  like an array of 16-bit integers, 32-bit integers or
+ *                  \c float for the respective formats.
+ * \param  samples  The number of samples per channel to read.
+ * \assert
+ *    \code decoder != NULL \endcode
+ *    \code buffer != NULL \endcode
+ * \retval uint32_t
+ *    The number of samples per channel stored in \a buffer, or \c 0 if
+ *    the decoder is not in pull mode or \a format is invalid.
+ */
+FLAC_API uint32_t FLAC__stream_decoder_read_samples(FLAC__StreamDecoder *decoder, FLAC__StreamDecoderPCMFormat format, void *buffer, uint32_t samples);
+
+/** Save the frame index (see FLAC__stream_decoder_get_frame_index()) to
+ *  a sidecar file.  Along with the seek points, the file holds the MD5
+ *  signature from the \c STREAMINFO block, so that
+ *  FLAC__stream_decoder_load_frame_index() can check that the index
+ *  belongs to the stream.
+ *
+ * \param  decoder   A decoder instance with a frame index.
+ * \param  filename  The name of the file to write.
+ * \assert
+ *    \code decoder != NULL \endcode
+ *    \code filename != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the frame index is empty or the file could not be
+ *    written, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_save_frame_index(const FLAC__StreamDecoder *decoder, const char *filename);
+
+/** Load a frame index saved by FLAC__stream_decoder_save_frame_index()
+ *  and use it like FLAC__stream_decoder_set_frame_index() does.  If the
+ *  MD5 signature in the file does not match the one in the \c STREAMINFO
+ *  block of the stream, the index is discarded when the \c STREAMINFO
+ *  block is read, or right away if it has been read already.
+ *
+ * \param  decoder   A decoder instance to set.
+ * \param  filename  The name of the file to read.
+ * \assert
+ *    \code decoder != NULL \endcode
+ *    \code filename != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the file could not be read or does not contain a valid
+ *    frame index, or if the index does not belong to the stream, else
+ *    \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_load_frame_index(FLAC__StreamDecoder *decoder, const char *filename);
+
 /* \} */
 
 #ifdef __cplusplus
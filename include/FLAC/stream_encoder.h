@@ -454,6 +454,59 @@ typedef enum {
 extern FLAC_API const char * const FLAC__StreamEncoderTellStatusString[];
 
 
+/** The stages of encoding that are timed when libFLAC is built with
+ *  profiling, see FLAC__stream_encoder_get_profile().
+ */
+typedef enum {
+
+	FLAC__STREAM_ENCODER_PROFILE_WINDOW,
+	/**< Applying the apodization windows to the signal. */
+
+	FLAC__STREAM_ENCODER_PROFILE_AUTOCORRELATION,
+	/**< Computing the autocorrelation of the windowed signal. */
+
+	FLAC__STREAM_ENCODER_PROFILE_LPC_SOLVE,
+	/**< Computing the LPC coefficients from the autocorrelation. */
+
+	FLAC__STREAM_ENCODER_PROFILE_QUANTIZATION,
+	/**< Quantizing the LPC coefficients. */
+
+	FLAC__STREAM_ENCODER_PROFILE_RESIDUAL,
+	/**< Computing the residual of fixed and LPC predictors. */
+
+	FLAC__STREAM_ENCODER_PROFILE_PARTITION_SEARCH,
+	/**< Finding the best partition order and Rice parameters. */
+
+	FLAC__STREAM_ENCODER_PROFILE_BITWRITING,
+	/**< Writing the chosen subframes. */
+
+	FLAC__STREAM_ENCODER_PROFILE_MD5,
+	/**< Updating the MD5 signature of the input. */
+
+	FLAC__STREAM_ENCODER_PROFILE_CRC,
+	/**< Computing the CRC-16 of the frames. */
+
+	FLAC__STREAM_ENCODER_PROFILE_NUM_STAGES
+	/**< The number of stages, not a stage itself. */
+
+} FLAC__StreamEncoderProfileStage;
+
+/** Maps a FLAC__StreamEncoderProfileStage to a C string.
+ *
+ *  Using a FLAC__StreamEncoderProfileStage as the index to this array
+ *  will give the string equivalent.  The contents should not be modified.
+ */
+extern FLAC_API const char * const FLAC__StreamEncoderProfileStageString[];
+
+/** The time spent in each stage of encoding, and the number of times
+ *  each stage was entered, see FLAC__stream_encoder_get_profile().
+ */
+typedef struct {
+	FLAC__uint64 nanoseconds[FLAC__STREAM_ENCODER_PROFILE_NUM_STAGES];
+	FLAC__uint64 calls[FLAC__STREAM_ENCODER_PROFILE_NUM_STAGES];
+} FLAC__StreamEncoderProfile;
+
+
 /***********************************************************************
  *
  * class FLAC__StreamEncoder
@@ -471,6 +524,12 @@ typedef struct {
 	struct FLAC__StreamEncoderPrivate *private_; /* avoid the C++ keyword 'private' */
 } FLAC__StreamEncoder;
 
+/** The opaque structure definition for a pool of threads that can be
+ *  shared by several encoder instances, see
+ *  FLAC__stream_encoder_set_thread_pool().
+ */
+typedef struct FLAC__ThreadPool FLAC__ThreadPool;
+
 /** Signature for the read callback.
  *
  *  A function pointer matching this signature must be passed to
@@ -566,6 +625,41 @@ typedef FLAC__StreamEncoderReadStatus (*FLAC__StreamEncoderReadCallback)(const F
  */
 typedef FLAC__StreamEncoderWriteStatus (*FLAC__StreamEncoderWriteCallback)(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame, void *client_data);
 
+/** Signature for the write buffer callback.
+ *
+ *  A function pointer matching this signature may be passed to
+ *  FLAC__stream_encoder_set_write_buffer_callback().  It is then called
+ *  instead of the write callback with each metadata block and audio frame,
+ *  and hands ownership of \a buffer over to the client, so the data can be
+ *  queued for writing without being copied.  The encoder continues with
+ *  another buffer from its pool.  When the client is done with \a buffer,
+ *  it must return it with FLAC__stream_encoder_release_buffer().
+ *
+ *  The arguments have the same meaning as for the write callback.  Each call
+ *  passes exactly one metadata block or one frame.  In a variable blocksize
+ *  stream, several consecutive frames may share one buffer; each of them is
+ *  passed in its own call and must be released separately.
+ *
+ *  If the callback returns \c FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR,
+ *  ownership of \a buffer stays with the encoder and it must not be released.
+ *
+ * \note In general, FLAC__StreamEncoder functions which change the
+ * state should not be called on the \a encoder while in the callback.
+ *
+ * \param  encoder  The encoder instance calling the callback.
+ * \param  buffer   An array of encoded data of length \a bytes, owned by
+ *                  the client from now on.
+ * \param  bytes    The byte length of \a buffer.
+ * \param  samples  The number of samples encoded by \a buffer, or \c 0
+ *                  for metadata.
+ * \param  current_frame  The number of the current frame being encoded.
+ * \param  client_data  The callee's client data set through
+ *                      FLAC__stream_encoder_init_*().
+ * \retval FLAC__StreamEncoderWriteStatus
+ *    The callee's return status.
+ */
+typedef FLAC__StreamEncoderWriteStatus (*FLAC__StreamEncoderWriteBufferCallback)(const FLAC__StreamEncoder *encoder, FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame, void *client_data);
+
 /** Signature for the seek callback.
  *
  *  A function pointer matching this signature may be passed to
@@ -711,6 +805,27 @@ FLAC_API FLAC__StreamEncoder *FLAC__stream_encoder_new(void);
  */
 FLAC_API void FLAC__stream_encoder_delete(FLAC__StreamEncoder *encoder);
 
+/** Create a pool of \a num_threads threads, which encoder instances
+ *  can share for their frames instead of each creating their own, see
+ *  FLAC__stream_encoder_set_thread_pool().  The threads are started
+ *  right away and wait for work.
+ *
+ * \param  num_threads  The number of threads, between 1 and the
+ *                      maximum of FLAC__stream_encoder_set_num_threads().
+ * \retval FLAC__ThreadPool*
+ *    \c NULL if \a num_threads is out of range, if there was an error
+ *    creating the pool, or if libFLAC was compiled without multithreading,
+ *    else the new pool.
+ */
+FLAC_API FLAC__ThreadPool *FLAC__thread_pool_new(uint32_t num_threads);
+
+/** Stop the threads of a pool and free it.  All encoder instances using
+ *  the pool must have been finished or deleted before.
+ *
+ * \param pool  A pool created with FLAC__thread_pool_new(), or \c NULL.
+ */
+FLAC_API void FLAC__thread_pool_delete(FLAC__ThreadPool *pool);
+
 
 /***********************************************************************
  *
@@ -743,6 +858,12 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_ogg_serial_number(FLAC__StreamEncod
  *  the process call will return \c false.  Note that this will slow the
  *  encoding process by the extra time required for decoding and comparison.
  *
+ *  When encoding with more than one thread (see
+ *  FLAC__stream_encoder_set_num_threads()), the decoding is done by the
+ *  encoder threads as well, so a mismatch may be reported by a process call
+ *  a few frames after the frame in question was written, or by
+ *  FLAC__stream_encoder_finish().
+ *
  * \default \c false
  * \param  encoder  An encoder instance to set.
  * \param  value    Flag value (see above).
@@ -889,6 +1010,36 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_compression_level(FLAC__StreamEncod
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_set_blocksize(FLAC__StreamEncoder *encoder, uint32_t value);
 
+/** Set the number of times the encoder may halve a block when encoding
+ *  a variable-blocksize stream.  With a value larger than 0, the
+ *  encoder encodes each block of the size set with
+ *  FLAC__stream_encoder_set_blocksize() both as a single frame and as
+ *  two halves, each of which may be halved again until \a value is
+ *  reached, and keeps whatever is smallest.  With a value of 2 and a
+ *  blocksize of 4096, a block can for example become one frame of 4096
+ *  samples, two frames of 2048 samples, four of 1024, or 2048 followed
+ *  by two of 1024.  Splitting only pays off around transients, where
+ *  a shorter frame keeps the predictor from having to cover both the
+ *  quiet part and the attack.
+ *
+ *  Frames of such a stream are numbered by sample instead of by frame,
+ *  and the minimum blocksize in the STREAMINFO block is the smallest
+ *  blocksize the encoder could have used.  Each level of halving adds
+ *  roughly the encoding time of one pass over the input.  A block is
+ *  only halved while its length is even and the halves hold more than
+ *  32 samples.  A value of \c 0 disables variable blocksizes.
+ *
+ * \default \c 0
+ * \param  encoder  An encoder instance to set.
+ * \param  value    See above, at most 3.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized or \a value is
+ *    too large, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_variable_blocksize(FLAC__StreamEncoder *encoder, uint32_t value);
+
 /** Set to \c true to enable mid-side encoding on stereo input.  The
  *  number of channels must be 2 for this to have any effect.  Set to
  *  \c false to use only independent channel coding.
@@ -1159,6 +1310,35 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_max_residual_partition_order(FLAC__
  */
 FLAC_API uint32_t FLAC__stream_encoder_set_num_threads(FLAC__StreamEncoder *encoder, uint32_t value);
 
+/** Set a pool of threads to encode frames with, instead of threads created
+ *  by this encoder instance.  When many streams are encoded at once, each
+ *  with its own encoder instance, sharing one pool bounds the total number
+ *  of threads, while a thread that would otherwise idle takes a frame from
+ *  whichever instance has one waiting.  The thread calling
+ *  FLAC__stream_encoder_process() still helps with encoding as it does
+ *  without a pool.
+ *
+ *  The number set with FLAC__stream_encoder_set_num_threads() then limits
+ *  how many frames of this instance can be queued and encoded at once.  If
+ *  it is left at \c 1, the number of threads in the pool plus one for the
+ *  calling thread is used instead.
+ *  The notes for FLAC__stream_encoder_set_num_threads() apply as well.
+ *
+ *  The pool must not be deleted before this instance is finished.
+ *
+ * \default \c NULL
+ * \param  encoder  An encoder instance to set.
+ * \param  pool     A pool created with FLAC__thread_pool_new(), or \c NULL
+ *                  for the encoder to create its own threads.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, or if libFLAC was
+ *    compiled without multithreading and \a pool is not \c NULL, else
+ *    \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_thread_pool(FLAC__StreamEncoder *encoder, FLAC__ThreadPool *pool);
+
 /** Deprecated.  Setting this value has no effect.
  *
  * \default \c 0
@@ -1288,6 +1468,60 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_metadata(FLAC__StreamEncoder *encod
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_set_limit_min_bitrate(FLAC__StreamEncoder *encoder, FLAC__bool value);
 
+/** Set to a nonzero value to only estimate the size of the encoded
+ *  stream instead of encoding it.  The encoder then analyses one in
+ *  every \a value blocks, choosing subframes as it normally would,
+ *  but writes neither frames nor metadata: the write callback is not
+ *  called (and may be \c NULL), and no CRCs or MD5 signature are
+ *  computed.  Verification is disabled in this mode.  Instead, the
+ *  sizes of the analysed frames are added up and extrapolated to the
+ *  whole stream, see FLAC__stream_encoder_get_estimate().
+ *
+ *  With a \a value of 1, all blocks are analysed and the estimate is
+ *  the exact size of the native FLAC stream.  Larger values take
+ *  proportionally less time, apart from reading the input, at the cost
+ *  of a wider confidence interval.  The overhead of the Ogg FLAC
+ *  container is not included.  With
+ *  FLAC__stream_encoder_set_variable_blocksize(), the analysed blocks
+ *  are encoded in full, as that is how they are split.
+ *
+ * \default \c 0
+ * \param  encoder  An encoder instance to set.
+ * \param  value    See above.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_estimate_only(FLAC__StreamEncoder *encoder, uint32_t value);
+
+/** Set a callback that takes over the encoded metadata blocks and frames
+ *  without copying them.  Instead of being written from a buffer that
+ *  the encoder reuses, each block and frame is handed to
+ *  \a write_buffer_callback in a buffer that the client owns until it
+ *  returns it with FLAC__stream_encoder_release_buffer(); see
+ *  FLAC__StreamEncoderWriteBufferCallback.  The encoder keeps a pool of
+ *  these buffers, which grows as long as the client holds on to all of
+ *  them, so the number of buffers in use is bounded by the client.
+ *
+ *  The write callback passed to FLAC__stream_encoder_init_stream() is then
+ *  only used to write back the stream statistics after seeking.  This is
+ *  not supported for Ogg FLAC, nor when encoding to a file with
+ *  FLAC__stream_encoder_init_FILE() or FLAC__stream_encoder_init_file();
+ *  initialization then fails with
+ *  \c FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_CALLBACKS.
+ *
+ * \default \c NULL
+ * \param  encoder  An encoder instance to set.
+ * \param  write_buffer_callback  See above, or \c NULL to use the write
+ *                                callback.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_write_buffer_callback(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderWriteBufferCallback write_buffer_callback);
+
 /** Get the current encoder state.
  *
  * \param  encoder  An encoder instance to query.
@@ -1342,6 +1576,28 @@ FLAC_API const char *FLAC__stream_encoder_get_resolved_state_string(const FLAC__
  */
 FLAC_API void FLAC__stream_encoder_get_verify_decoder_error_stats(const FLAC__StreamEncoder *encoder, FLAC__uint64 *absolute_sample, uint32_t *frame_number, uint32_t *channel, uint32_t *sample, FLAC__int32 *expected, FLAC__int32 *got);
 
+/** Get the estimated size of the stream when encoding with
+ *  FLAC__stream_encoder_set_estimate_only().  The estimate covers the
+ *  input processed so far, and is complete after
+ *  FLAC__stream_encoder_finish(); it stays available until the encoder
+ *  is initialized again.  The arguments should be addresses in which
+ *  the values will be returned, or NULL if a value is not desired.
+ *
+ *  The bounds are those of a 95% confidence interval for the size,
+ *  based on the variation in size of the analysed frames.  When all
+ *  blocks are analysed, they are equal to the estimate.
+ *
+ * \param  encoder          An encoder instance to query.
+ * \param  bytes            The estimated size of the stream in bytes,
+ *                          including metadata.
+ * \param  bytes_low        The lower bound of the estimate.
+ * \param  bytes_high       The upper bound of the estimate.
+ * \param  frames_analysed  The number of blocks the estimate is based on.
+ * \assert
+ *    \code encoder != NULL \endcode
+ */
+FLAC_API void FLAC__stream_encoder_get_estimate(const FLAC__StreamEncoder *encoder, FLAC__uint64 *bytes, FLAC__uint64 *bytes_low, FLAC__uint64 *bytes_high, uint32_t *frames_analysed);
+
 /** Get the "verify" flag.
  *
  * \param  encoder  An encoder instance to query.
@@ -1402,6 +1658,16 @@ FLAC_API uint32_t FLAC__stream_encoder_get_sample_rate(const FLAC__StreamEncoder
  */
 FLAC_API uint32_t FLAC__stream_encoder_get_blocksize(const FLAC__StreamEncoder *encoder);
 
+/** Get the variable blocksize setting.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval uint32_t
+ *    See FLAC__stream_encoder_set_variable_blocksize().
+ */
+FLAC_API uint32_t FLAC__stream_encoder_get_variable_blocksize(const FLAC__StreamEncoder *encoder);
+
 /** Get the "mid/side stereo coding" flag.
  *
  * \param  encoder  An encoder instance to query.
@@ -1535,6 +1801,37 @@ FLAC_API FLAC__uint64 FLAC__stream_encoder_get_total_samples_estimate(const FLAC
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_get_limit_min_bitrate(const FLAC__StreamEncoder *encoder);
 
+/** Get the estimate-only setting.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval uint32_t
+ *    See FLAC__stream_encoder_set_estimate_only().
+ */
+FLAC_API uint32_t FLAC__stream_encoder_get_estimate_only(const FLAC__StreamEncoder *encoder);
+
+/** Get the time spent in each stage of encoding.
+ *
+ *  The counters are only kept when libFLAC is built with profiling
+ *  (\c --enable-profiling with configure, \c WITH_PROFILING with CMake),
+ *  as timing the stages slows down encoding somewhat.  They are reset
+ *  by FLAC__stream_encoder_init_*() and are still available after
+ *  FLAC__stream_encoder_finish().  With more than one thread, the
+ *  counters of all threads are added up, so they can exceed the elapsed
+ *  time, and they are only collected by FLAC__stream_encoder_finish().
+ *
+ * \param  encoder  An encoder instance to query.
+ * \param  profile  Address at which to return the counters.
+ * \assert
+ *    \code encoder != NULL \endcode
+ *    \code profile != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if libFLAC was built without profiling, in which case
+ *    all counters are zero, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_get_profile(const FLAC__StreamEncoder *encoder, FLAC__StreamEncoderProfile *profile);
+
 /** Initialize the encoder instance to encode native FLAC streams.
  *
  *  This flavor of initialization sets up the encoder to encode to a
@@ -1554,7 +1851,12 @@ FLAC_API FLAC__bool FLAC__stream_encoder_get_limit_min_bitrate(const FLAC__Strea
  *
  * \param  encoder            An uninitialized encoder instance.
  * \param  write_callback     See FLAC__StreamEncoderWriteCallback.  This
- *                            pointer must not be \c NULL.
+ *                            pointer must not be \c NULL, unless
+ *                            FLAC__stream_encoder_set_estimate_only()
+ *                            is used, or a write buffer callback is set
+ *                            and \a seek_callback is \c NULL.  With a
+ *                            write buffer callback, it is only used to
+ *                            write back the stream statistics.
  * \param  seek_callback      See FLAC__StreamEncoderSeekCallback.  This
  *                            pointer may be \c NULL if seeking is not
  *                            supported.  The encoder uses seeking to go back
@@ -1622,7 +1924,9 @@ FLAC_API FLAC__StreamEncoderInitStatus FLAC__stream_encoder_init_stream(FLAC__St
  *                            able to write data back to the Ogg FLAC stream
  *                            in the post-encode phase.
  * \param  write_callback     See FLAC__StreamEncoderWriteCallback.  This
- *                            pointer must not be \c NULL.
+ *                            pointer must not be \c NULL, unless
+ *                            FLAC__stream_encoder_set_estimate_only()
+ *                            is used.
  * \param  seek_callback      See FLAC__StreamEncoderSeekCallback.  This
  *                            pointer may be \c NULL if seeking is not
  *                            supported.  The encoder uses seeking to go back
@@ -1895,6 +2199,27 @@ FLAC_API FLAC__bool FLAC__stream_encoder_process(FLAC__StreamEncoder *encoder, c
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_process_interleaved(FLAC__StreamEncoder *encoder, const FLAC__int32 buffer[], uint32_t samples);
 
+/** Return a buffer that was handed over to the client by the write buffer
+ *  callback, see FLAC__stream_encoder_set_write_buffer_callback().  The
+ *  client must not access the buffer afterwards.
+ *
+ *  This function may be called from any thread, also while the encoder
+ *  is processing, and after FLAC__stream_encoder_finish().  If libFLAC
+ *  was built without thread support, it must only be called from the
+ *  thread that drives the encoder.  All buffers must be released before
+ *  FLAC__stream_encoder_delete(), which frees them.
+ *
+ * \param  encoder  The encoder instance that handed over \a buffer.
+ * \param  buffer   A buffer as passed to the write buffer callback.
+ * \assert
+ *    \code encoder != NULL \endcode
+ *    \code buffer != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if \a buffer was not handed over by \a encoder or has
+ *    already been released, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_release_buffer(FLAC__StreamEncoder *encoder, FLAC__byte buffer[]);
+
 /* \} */
 
 #ifdef __cplusplus
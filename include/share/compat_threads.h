@@ -75,6 +75,12 @@
 #define FLAC__cnd_wait(cv, mutex)            cnd_wait(cv, mutex)
 #define FLAC__cnd_destroy(cv)                cnd_destroy(cv)
 
+#define FLAC__tss_t                          tss_t
+#define FLAC__tss_create(key)                tss_create(key, NULL)
+#define FLAC__tss_get(key)                   tss_get(key)
+#define FLAC__tss_set(key, value)            tss_set(key, value)
+#define FLAC__tss_delete(key)                tss_delete(key)
+
 #define FLAC__thread_return_type             int
 #define FLAC__thread_default_return_value    0
 
@@ -113,11 +119,86 @@
 #define FLAC__cnd_wait(cv, mutex)            pthread_cond_wait(cv, mutex)
 #define FLAC__cnd_destroy(cv)                pthread_cond_destroy(cv)
 
+#define FLAC__tss_t                          pthread_key_t
+#define FLAC__tss_create(key)                ((pthread_key_create(key, NULL) == 0) ? FLAC__thrd_success : FLAC__thrd_nomem)
+#define FLAC__tss_get(key)                   pthread_getspecific(key)
+#define FLAC__tss_set(key, value)            ((pthread_setspecific(key, value) == 0) ? FLAC__thrd_success : FLAC__thrd_nomem)
+#define FLAC__tss_delete(key)                pthread_key_delete(key)
+
 #define FLAC__thread_return_type             void *
 #define FLAC__thread_default_return_value    NULL
 
 #endif
 
+/* Atomic operations on 32-bit unsigned integers, all of them sequentially
+ * consistent, and a hint for loops that spin while waiting on another
+ * thread. A build with multithreading needs these, which in practice
+ * means a C11 compiler, GCC, clang or MSVC.
+ */
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_ATOMICS__)
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+typedef _Atomic uint32_t FLAC__atomic_uint32;
+#define FLAC__atomic_load(obj)                             atomic_load(obj)
+#define FLAC__atomic_store(obj, value)                     atomic_store(obj, value)
+#define FLAC__atomic_fetch_add(obj, value)                 atomic_fetch_add(obj, value)
+#define FLAC__atomic_fetch_sub(obj, value)                 atomic_fetch_sub(obj, value)
+#define FLAC__atomic_compare_exchange(obj, expected, value) atomic_compare_exchange_strong(obj, expected, value)
+
+#elif defined(__GNUC__)
+
+#include <stdint.h>
+
+typedef uint32_t FLAC__atomic_uint32;
+#define FLAC__atomic_load(obj)                             __atomic_load_n(obj, __ATOMIC_SEQ_CST)
+#define FLAC__atomic_store(obj, value)                     __atomic_store_n(obj, value, __ATOMIC_SEQ_CST)
+#define FLAC__atomic_fetch_add(obj, value)                 __atomic_fetch_add(obj, value, __ATOMIC_SEQ_CST)
+#define FLAC__atomic_fetch_sub(obj, value)                 __atomic_fetch_sub(obj, value, __ATOMIC_SEQ_CST)
+#define FLAC__atomic_compare_exchange(obj, expected, value) __atomic_compare_exchange_n(obj, expected, value, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+#elif defined(_MSC_VER)
+
+#include <intrin.h>
+#include <stdint.h>
+
+typedef uint32_t FLAC__atomic_uint32;
+#define FLAC__atomic_load(obj)                             ((uint32_t)_InterlockedOr((volatile long *)(obj), 0))
+#define FLAC__atomic_store(obj, value)                     ((void)_InterlockedExchange((volatile long *)(obj), (long)(value)))
+#define FLAC__atomic_fetch_add(obj, value)                 ((uint32_t)_InterlockedExchangeAdd((volatile long *)(obj), (long)(value)))
+#define FLAC__atomic_fetch_sub(obj, value)                 ((uint32_t)_InterlockedExchangeAdd((volatile long *)(obj), -(long)(value)))
+#define FLAC__atomic_compare_exchange(obj, expected, value) FLAC__atomic_compare_exchange_msvc_(obj, expected, value)
+
+static __inline int FLAC__atomic_compare_exchange_msvc_(FLAC__atomic_uint32 *obj, uint32_t *expected, uint32_t value)
+{
+	const uint32_t old = (uint32_t)_InterlockedCompareExchange((volatile long *)obj, (long)value, (long)*expected);
+	if(old == *expected)
+		return 1;
+	*expected = old;
+	return 0;
+}
+
+#else
+
+#error multithreading needs atomic operations, which this compiler does not provide; configure with multithreading disabled
+
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define FLAC__cpu_relax()                    _mm_pause()
+#elif defined(_MSC_VER) && (defined(_M_ARM) || defined(_M_ARM64))
+#include <intrin.h>
+#define FLAC__cpu_relax()                    __yield()
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define FLAC__cpu_relax()                    __builtin_ia32_pause()
+#elif defined(__GNUC__) && (defined(__aarch64__) || (defined(__arm__) && defined(__ARM_ARCH) && __ARM_ARCH >= 7))
+#define FLAC__cpu_relax()                    __asm__ __volatile__("yield")
+#else
+#define FLAC__cpu_relax()                    ((void)0)
+#endif
+
 #endif
 
 
@@ -45,6 +45,8 @@ extern const FLAC__byte * const GRABBAG__REPLAYGAIN_TAG_ALBUM_PEAK; /* = "REPLAY
 FLAC__bool grabbag__replaygain_is_valid_sample_frequency(uint32_t sample_frequency);
 
 FLAC__bool grabbag__replaygain_init(uint32_t sample_frequency);
+/* frees what grabbag__replaygain_init() allocated */
+void grabbag__replaygain_deinit(void);
 
 /* 'bps' must be valid for FLAC, i.e. >=4 and <= 32 */
 FLAC__bool grabbag__replaygain_analyze(const FLAC__int32 * const input[], FLAC__bool is_stereo, uint32_t bps, uint32_t samples);
@@ -52,8 +54,26 @@ FLAC__bool grabbag__replaygain_analyze(const FLAC__int32 * const input[], FLAC__
 void grabbag__replaygain_get_album(float *gain, float *peak);
 void grabbag__replaygain_get_title(float *gain, float *peak);
 
-/* These three functions return an error string on error, or NULL if successful */
+/* The functions above analyze one file at a time.  These do the same on
+ * a context of their own, so that different files can be analyzed on
+ * different threads; a context created with a 'sample_frequency' of 0
+ * can only collect the finished files of an album, with
+ * grabbag__replaygain_context_merge_into_album().  NULL is returned if
+ * 'sample_frequency' is not valid or memory runs out.
+ */
+typedef struct grabbag__ReplayGain grabbag__ReplayGain;
+
+grabbag__ReplayGain *grabbag__replaygain_context_new(uint32_t sample_frequency);
+void grabbag__replaygain_context_delete(grabbag__ReplayGain *context);
+FLAC__bool grabbag__replaygain_context_analyze(grabbag__ReplayGain *context, const FLAC__int32 * const input[], FLAC__bool is_stereo, uint32_t bps, uint32_t samples);
+void grabbag__replaygain_context_get_album(grabbag__ReplayGain *context, float *gain, float *peak);
+void grabbag__replaygain_context_get_title(grabbag__ReplayGain *context, float *gain, float *peak);
+/* adds everything analyzed on 'track' to the album gain of 'album' */
+void grabbag__replaygain_context_merge_into_album(grabbag__ReplayGain *album, const grabbag__ReplayGain *track);
+
+/* These four functions return an error string on error, or NULL if successful */
 const char *grabbag__replaygain_analyze_file(const char *filename, float *title_gain, float *title_peak);
+const char *grabbag__replaygain_context_analyze_file(grabbag__ReplayGain *context, const char *filename, float *title_gain, float *title_peak);
 const char *grabbag__replaygain_store_to_vorbiscomment(FLAC__StreamMetadata *block, float album_gain, float album_peak, float title_gain, float title_peak);
 const char *grabbag__replaygain_store_to_vorbiscomment_reference(FLAC__StreamMetadata *block);
 const char *grabbag__replaygain_store_to_vorbiscomment_album(FLAC__StreamMetadata *block, float album_gain, float album_peak);
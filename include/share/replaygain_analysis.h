@@ -52,6 +52,16 @@ int     AnalyzeSamples   ( const flac_float_t* left_samples, const flac_float_t*
 flac_float_t GetTitleGain     ( void );
 flac_float_t GetAlbumGain     ( void );
 
+/* the same, on a context of their own, see replaygain_analysis.c */
+typedef struct GainAnalysisContext GainAnalysisContext;
+
+GainAnalysisContext* CreateGainAnalysis ( long samplefreq );
+void    DeleteGainAnalysis    ( GainAnalysisContext* ctx );
+int     AnalyzeSamplesContext ( GainAnalysisContext* ctx, const flac_float_t* left_samples, const flac_float_t* right_samples, size_t num_samples, int num_channels );
+flac_float_t GetTitleGainContext   ( GainAnalysisContext* ctx );
+void    MergeIntoAlbumContext ( GainAnalysisContext* album, const GainAnalysisContext* track );
+flac_float_t GetAlbumGainContext   ( const GainAnalysisContext* ctx );
+
 #ifdef __cplusplus
 }
 #endif
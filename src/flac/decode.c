@@ -32,6 +32,16 @@
 #include "share/compat.h"
 #include "decode.h"
 
+typedef union
+{	/* The arrays defined within this union are all the same size. */
+	FLAC__int8	 s8buffer	[FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS * sizeof(FLAC__int32)]; /* WATCHOUT: can be up to 2 megs */
+	FLAC__uint8  u8buffer	[FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS * sizeof(FLAC__int32)];
+	FLAC__int16  s16buffer	[FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS * sizeof(FLAC__int16)];
+	FLAC__uint16 u16buffer	[FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS * sizeof(FLAC__int16)];
+	FLAC__int32  s32buffer	[FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS];
+	FLAC__uint32 u32buffer	[FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS];
+} OutputBuffer;
+
 typedef struct {
 #if FLAC__HAS_OGG
 	FLAC__bool is_ogg;
@@ -46,6 +56,8 @@ typedef struct {
 	FLAC__bool continue_through_decode_errors;
 	FLAC__bool channel_map_none;
 	FLAC__bool relaxed_foreign_metadata_handling;
+	FLAC__bool profile;
+	uint32_t threads;
 
 	struct {
 		replaygain_synthesis_spec_t spec;
@@ -95,6 +107,7 @@ typedef struct {
 	FLAC__StreamDecoder *decoder;
 
 	FILE *fout;
+	OutputBuffer *ubuf; /* per-session so that several files can be decoded at once */
 
 	foreign_metadata_t *foreign_metadata; /* NULL unless --keep-foreign-metadata requested */
 	FLAC__off_t fm_offset1, fm_offset2, fm_offset3;
@@ -104,13 +117,13 @@ typedef struct {
 } DecoderSession;
 
 
-static FLAC__bool is_big_endian_host_;
+static const FLAC__bool is_big_endian_host_ = CPU_IS_BIG_ENDIAN;
 
 
 /*
  * local routines
  */
-static FLAC__bool DecoderSession_construct(DecoderSession *d, FLAC__bool is_ogg, FLAC__bool decode_chained_stream, FLAC__bool use_first_serial_number, long serial_number, FileFormat format, FileSubFormat subformat, FLAC__bool treat_warnings_as_errors, FLAC__bool continue_through_decode_errors, FLAC__bool channel_map_none, FLAC__bool relaxed_foreign_metadata_handling, replaygain_synthesis_spec_t replaygain_synthesis_spec, FLAC__bool analysis_mode, analysis_options aopts, utils__SkipUntilSpecification *skip_specification, utils__SkipUntilSpecification *until_specification, utils__CueSpecification *cue_specification, foreign_metadata_t *foreign_metadata, const char *infilename, const char *outfilename);
+static FLAC__bool DecoderSession_construct(DecoderSession *d, FLAC__bool is_ogg, FLAC__bool decode_chained_stream, FLAC__bool use_first_serial_number, long serial_number, FileFormat format, FileSubFormat subformat, FLAC__bool treat_warnings_as_errors, FLAC__bool continue_through_decode_errors, FLAC__bool channel_map_none, FLAC__bool relaxed_foreign_metadata_handling, FLAC__bool profile, uint32_t threads, replaygain_synthesis_spec_t replaygain_synthesis_spec, FLAC__bool analysis_mode, analysis_options aopts, utils__SkipUntilSpecification *skip_specification, utils__SkipUntilSpecification *until_specification, utils__CueSpecification *cue_specification, foreign_metadata_t *foreign_metadata, const char *infilename, const char *outfilename);
 static void DecoderSession_destroy(DecoderSession *d, FLAC__bool error_occurred);
 static FLAC__bool DecoderSession_init_decoder(DecoderSession *d, const char *infilename);
 static FLAC__bool DecoderSession_process(DecoderSession *d);
@@ -137,6 +150,7 @@ static void error_callback(const FLAC__StreamDecoder *decoder, FLAC__StreamDecod
 static void print_error_with_init_status(const DecoderSession *d, const char *message, FLAC__StreamDecoderInitStatus init_status);
 static void print_error_with_state(const DecoderSession *d, const char *message);
 static void print_stats(const DecoderSession *decoder_session);
+static void print_profile(const DecoderSession *d, const FLAC__StreamDecoderProfile *profile);
 
 
 /*
@@ -180,6 +194,8 @@ int flac__decode_file(const char *infilename, const char *outfilename, FLAC__boo
 			options.continue_through_decode_errors,
 			options.channel_map_none,
 			options.relaxed_foreign_metadata_handling,
+			options.profile,
+			options.threads,
 			options.replaygain_synthesis_spec,
 			analysis_mode,
 			aopts,
@@ -203,7 +219,7 @@ int flac__decode_file(const char *infilename, const char *outfilename, FLAC__boo
 	return DecoderSession_finish_ok(&decoder_session);
 }
 
-FLAC__bool DecoderSession_construct(DecoderSession *d, FLAC__bool is_ogg, FLAC__bool decode_chained_stream, FLAC__bool use_first_serial_number, long serial_number, FileFormat format, FileSubFormat subformat, FLAC__bool treat_warnings_as_errors, FLAC__bool continue_through_decode_errors, FLAC__bool channel_map_none, FLAC__bool relaxed_foreign_metadata_handling, replaygain_synthesis_spec_t replaygain_synthesis_spec, FLAC__bool analysis_mode, analysis_options aopts, utils__SkipUntilSpecification *skip_specification, utils__SkipUntilSpecification *until_specification, utils__CueSpecification *cue_specification, foreign_metadata_t *foreign_metadata, const char *infilename, const char *outfilename)
+FLAC__bool DecoderSession_construct(DecoderSession *d, FLAC__bool is_ogg, FLAC__bool decode_chained_stream, FLAC__bool use_first_serial_number, long serial_number, FileFormat format, FileSubFormat subformat, FLAC__bool treat_warnings_as_errors, FLAC__bool continue_through_decode_errors, FLAC__bool channel_map_none, FLAC__bool relaxed_foreign_metadata_handling, FLAC__bool profile, uint32_t threads, replaygain_synthesis_spec_t replaygain_synthesis_spec, FLAC__bool analysis_mode, analysis_options aopts, utils__SkipUntilSpecification *skip_specification, utils__SkipUntilSpecification *until_specification, utils__CueSpecification *cue_specification, foreign_metadata_t *foreign_metadata, const char *infilename, const char *outfilename)
 {
 #if FLAC__HAS_OGG
 	d->is_ogg = is_ogg;
@@ -223,6 +239,8 @@ FLAC__bool DecoderSession_construct(DecoderSession *d, FLAC__bool is_ogg, FLAC__
 	d->continue_through_decode_errors = continue_through_decode_errors;
 	d->channel_map_none = channel_map_none;
 	d->relaxed_foreign_metadata_handling = relaxed_foreign_metadata_handling;
+	d->profile = profile;
+	d->threads = threads;
 	d->replaygain.spec = replaygain_synthesis_spec;
 	d->replaygain.apply = false;
 	d->replaygain.scale = 0.0;
@@ -268,6 +286,7 @@ FLAC__bool DecoderSession_construct(DecoderSession *d, FLAC__bool is_ogg, FLAC__
 	d->decoder = 0;
 
 	d->fout = 0; /* initialized with an open file later if necessary */
+	d->ubuf = 0;
 
 	d->foreign_metadata = foreign_metadata;
 
@@ -287,6 +306,11 @@ FLAC__bool DecoderSession_construct(DecoderSession *d, FLAC__bool is_ogg, FLAC__
 				return false;
 			}
 		}
+		if(0 == (d->ubuf = malloc(sizeof(OutputBuffer)))) {
+			flac__utils_printf(stderr, 1, "%s: ERROR allocating memory for output buffer\n", d->inbasefilename);
+			DecoderSession_destroy(d, /*error_occurred=*/true);
+			return false;
+		}
 	}
 
 	if(analysis_mode)
@@ -320,14 +344,16 @@ void DecoderSession_destroy(DecoderSession *d, FLAC__bool error_occurred)
 		if(error_occurred)
 			flac_unlink(d->outfilename);
 	}
+
+	if(0 != d->ubuf) {
+		free(d->ubuf);
+		d->ubuf = 0;
+	}
 }
 
 FLAC__bool DecoderSession_init_decoder(DecoderSession *decoder_session, const char *infilename)
 {
 	FLAC__StreamDecoderInitStatus init_status;
-	FLAC__uint32 test = 1;
-
-	is_big_endian_host_ = (*((FLAC__byte*)(&test)))? false : true;
 
 	if(decoder_session->test_only && strcmp(infilename, "-") != 0) {
 		/* When testing, we can be a little more pedantic, as long
@@ -366,6 +392,22 @@ FLAC__bool DecoderSession_init_decoder(DecoderSession *decoder_session, const ch
 	}
 
 	FLAC__stream_decoder_set_md5_checking(decoder_session->decoder, true);
+	if(decoder_session->threads != 1) {
+		uint32_t retval = FLAC__stream_decoder_set_num_threads(decoder_session->decoder, decoder_session->threads);
+		if(retval == FLAC__STREAM_DECODER_SET_NUM_THREADS_NOT_COMPILED_WITH_MULTITHREADING_ENABLED) {
+			flac__utils_printf(stderr, 1, "%s: WARNING, cannot set number of threads: multithreading was not enabled during compilation of this binary\n", decoder_session->inbasefilename);
+			if(decoder_session->treat_warnings_as_errors)
+				return false;
+		}
+		if(retval == FLAC__STREAM_DECODER_SET_NUM_THREADS_TOO_MANY_THREADS) {
+			flac__utils_printf(stderr, 1, "%s: WARNING, cannot set number of threads: too many\n", decoder_session->inbasefilename);
+			if(decoder_session->treat_warnings_as_errors)
+				return false;
+		}
+		if(retval == FLAC__STREAM_DECODER_SET_NUM_THREADS_ALREADY_INITIALIZED) {
+			FLAC__ASSERT(0);
+		}
+	}
 	if (0 != decoder_session->cue_specification)
 		FLAC__stream_decoder_set_metadata_respond(decoder_session->decoder, FLAC__METADATA_TYPE_CUESHEET);
 	if (decoder_session->replaygain.spec.apply || !decoder_session->channel_map_none)
@@ -614,16 +656,21 @@ FLAC__bool verify_streaminfo(DecoderSession *d, FLAC__bool md5_failure)
 
 int DecoderSession_finish_ok(DecoderSession *d)
 {
-	FLAC__bool ok, md5_failure = false;
+	FLAC__bool ok, md5_failure = false, got_profile = false;
+	FLAC__StreamDecoderProfile profile;
 
 	if(d->decoder) {
 		md5_failure = !FLAC__stream_decoder_finish(d->decoder) && !d->aborting_due_to_until;
 		print_stats(d);
+		if(d->profile)
+			got_profile = FLAC__stream_decoder_get_profile(d->decoder, &profile);
 		FLAC__stream_decoder_delete(d->decoder);
 	}
 	if(d->analysis_mode)
 		flac__analyze_finish(d->aopts);
 	ok = verify_streaminfo(d, md5_failure);
+	if(d->profile)
+		print_profile(d, got_profile? &profile : 0);
 	DecoderSession_destroy(d, /*error_occurred=*/!ok);
 	if(!d->analysis_mode && !d->test_only && d->format != FORMAT_RAW) {
 		if(d->iff_headers_need_fixup || (!d->got_stream_info && strcmp(d->outfilename, "-"))) {
@@ -1261,15 +1308,7 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder
 	uint32_t wide_samples = frame->header.blocksize, wide_sample, sample, channel;
 	FLAC__uint64 frame_bytes = 0;
 
-	static union
-	{	/* The arrays defined within this union are all the same size. */
-		FLAC__int8	 s8buffer	[FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS * sizeof(FLAC__int32)]; /* WATCHOUT: can be up to 2 megs */
-		FLAC__uint8  u8buffer	[FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS * sizeof(FLAC__int32)];
-		FLAC__int16  s16buffer	[FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS * sizeof(FLAC__int16)];
-		FLAC__uint16 u16buffer	[FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS * sizeof(FLAC__int16)];
-		FLAC__int32  s32buffer	[FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS];
-		FLAC__uint32 u32buffer	[FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS];
-	} ubuf;
+	OutputBuffer *ubuf = decoder_session->ubuf;
 
 	size_t bytes_to_write = 0;
 
@@ -1447,7 +1486,7 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder
 			}
 			if(decoder_session->replaygain.apply) {
 				bytes_to_write = FLAC__replaygain_synthesis__apply_gain(
-					ubuf.u8buffer,
+					ubuf->u8buffer,
 					!is_big_endian,
 					is_unsigned_samples,
 					buffer,
@@ -1463,17 +1502,17 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder
 			}
 			/* first some special code for common cases */
 			else if(is_big_endian == is_big_endian_host_ && !is_unsigned_samples && channels == 2 && bps+shift == 16) {
-				FLAC__int16 *buf1_ = ubuf.s16buffer + 1;
+				FLAC__int16 *buf1_ = ubuf->s16buffer + 1;
 				if(is_big_endian)
-					memcpy(ubuf.s16buffer, ((FLAC__byte*)(buffer[0]))+2, sizeof(FLAC__int32) * wide_samples - 2);
+					memcpy(ubuf->s16buffer, ((FLAC__byte*)(buffer[0]))+2, sizeof(FLAC__int32) * wide_samples - 2);
 				else
-					memcpy(ubuf.s16buffer, buffer[0], sizeof(FLAC__int32) * wide_samples);
+					memcpy(ubuf->s16buffer, buffer[0], sizeof(FLAC__int32) * wide_samples);
 				for(sample = 0; sample < wide_samples; sample++, buf1_+=2)
 					*buf1_ = (FLAC__int16)buffer[1][sample];
 				bytes_to_write = 4 * sample;
 			}
 			else if(is_big_endian == is_big_endian_host_ && !is_unsigned_samples && channels == 1 && bps+shift == 16) {
-				FLAC__int16 *buf1_ = ubuf.s16buffer;
+				FLAC__int16 *buf1_ = ubuf->s16buffer;
 				for(sample = 0; sample < wide_samples; sample++)
 					*buf1_++ = (FLAC__int16)buffer[0][sample];
 				bytes_to_write = 2 * sample;
@@ -1483,35 +1522,35 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder
 				if(is_unsigned_samples) {
 					if(channels == 2) {
 						for(sample = wide_sample = 0; wide_sample < wide_samples; wide_sample++) {
-							ubuf.u16buffer[sample++] = (FLAC__uint16)(buffer[0][wide_sample] + 0x8000);
-							ubuf.u16buffer[sample++] = (FLAC__uint16)(buffer[1][wide_sample] + 0x8000);
+							ubuf->u16buffer[sample++] = (FLAC__uint16)(buffer[0][wide_sample] + 0x8000);
+							ubuf->u16buffer[sample++] = (FLAC__uint16)(buffer[1][wide_sample] + 0x8000);
 						}
 					}
 					else if(channels == 1) {
 						for(sample = wide_sample = 0; wide_sample < wide_samples; wide_sample++)
-							ubuf.u16buffer[sample++] = (FLAC__uint16)(buffer[0][wide_sample] + 0x8000);
+							ubuf->u16buffer[sample++] = (FLAC__uint16)(buffer[0][wide_sample] + 0x8000);
 					}
 					else { /* works for any 'channels' but above flavors are faster for 1 and 2 */
 						for(sample = wide_sample = 0; wide_sample < wide_samples; wide_sample++)
 							for(channel = 0; channel < channels; channel++, sample++)
-								ubuf.u16buffer[sample] = (FLAC__uint16)(buffer[channel][wide_sample] + 0x8000);
+								ubuf->u16buffer[sample] = (FLAC__uint16)(buffer[channel][wide_sample] + 0x8000);
 					}
 				}
 				else {
 					if(channels == 2) {
 						for(sample = wide_sample = 0; wide_sample < wide_samples; wide_sample++) {
-							ubuf.s16buffer[sample++] = (FLAC__int16)(buffer[0][wide_sample]);
-							ubuf.s16buffer[sample++] = (FLAC__int16)(buffer[1][wide_sample]);
+							ubuf->s16buffer[sample++] = (FLAC__int16)(buffer[0][wide_sample]);
+							ubuf->s16buffer[sample++] = (FLAC__int16)(buffer[1][wide_sample]);
 						}
 					}
 					else if(channels == 1) {
 						for(sample = wide_sample = 0; wide_sample < wide_samples; wide_sample++)
-							ubuf.s16buffer[sample++] = (FLAC__int16)(buffer[0][wide_sample]);
+							ubuf->s16buffer[sample++] = (FLAC__int16)(buffer[0][wide_sample]);
 					}
 					else { /* works for any 'channels' but above flavors are faster for 1 and 2 */
 						for(sample = wide_sample = 0; wide_sample < wide_samples; wide_sample++)
 							for(channel = 0; channel < channels; channel++, sample++)
-								ubuf.s16buffer[sample] = (FLAC__int16)(buffer[channel][wide_sample]);
+								ubuf->s16buffer[sample] = (FLAC__int16)(buffer[channel][wide_sample]);
 					}
 				}
 				if(is_big_endian != is_big_endian_host_) {
@@ -1519,9 +1558,9 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder
 					const uint32_t bytes = sample * 2;
 					uint32_t b;
 					for(b = 0; b < bytes; b += 2) {
-						tmp = ubuf.u8buffer[b];
-						ubuf.u8buffer[b] = ubuf.u8buffer[b+1];
-						ubuf.u8buffer[b+1] = tmp;
+						tmp = ubuf->u8buffer[b];
+						ubuf->u8buffer[b] = ubuf->u8buffer[b+1];
+						ubuf->u8buffer[b+1] = tmp;
 					}
 				}
 				bytes_to_write = 2 * sample;
@@ -1530,24 +1569,24 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder
 				if(is_unsigned_samples) {
 					for(sample = wide_sample = 0; wide_sample < wide_samples; wide_sample++)
 						for(channel = 0; channel < channels; channel++, sample++)
-							ubuf.u32buffer[sample] = buffer[channel][wide_sample] + 0x800000;
+							ubuf->u32buffer[sample] = buffer[channel][wide_sample] + 0x800000;
 				}
 				else {
 					for(sample = wide_sample = 0; wide_sample < wide_samples; wide_sample++)
 						for(channel = 0; channel < channels; channel++, sample++)
-							ubuf.s32buffer[sample] = buffer[channel][wide_sample];
+							ubuf->s32buffer[sample] = buffer[channel][wide_sample];
 				}
 				if(is_big_endian != is_big_endian_host_) {
 					uint8_t tmp;
 					const uint32_t bytes = sample * 4;
 					uint32_t b;
 					for(b = 0; b < bytes; b += 4) {
-						tmp = ubuf.u8buffer[b];
-						ubuf.u8buffer[b] = ubuf.u8buffer[b+3];
-						ubuf.u8buffer[b+3] = tmp;
-						tmp = ubuf.u8buffer[b+1];
-						ubuf.u8buffer[b+1] = ubuf.u8buffer[b+2];
-						ubuf.u8buffer[b+2] = tmp;
+						tmp = ubuf->u8buffer[b];
+						ubuf->u8buffer[b] = ubuf->u8buffer[b+3];
+						ubuf->u8buffer[b+3] = tmp;
+						tmp = ubuf->u8buffer[b+1];
+						ubuf->u8buffer[b+1] = ubuf->u8buffer[b+2];
+						ubuf->u8buffer[b+2] = tmp;
 					}
 				}
 				if(is_big_endian) {
@@ -1555,18 +1594,18 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder
 					const uint32_t bytes = sample * 4;
 					for(lbyte = b = 0; b < bytes; ) {
 						b++;
-						ubuf.u8buffer[lbyte++] = ubuf.u8buffer[b++];
-						ubuf.u8buffer[lbyte++] = ubuf.u8buffer[b++];
-						ubuf.u8buffer[lbyte++] = ubuf.u8buffer[b++];
+						ubuf->u8buffer[lbyte++] = ubuf->u8buffer[b++];
+						ubuf->u8buffer[lbyte++] = ubuf->u8buffer[b++];
+						ubuf->u8buffer[lbyte++] = ubuf->u8buffer[b++];
 					}
 				}
 				else {
 					uint32_t b, lbyte;
 					const uint32_t bytes = sample * 4;
 					for(lbyte = b = 0; b < bytes; ) {
-						ubuf.u8buffer[lbyte++] = ubuf.u8buffer[b++];
-						ubuf.u8buffer[lbyte++] = ubuf.u8buffer[b++];
-						ubuf.u8buffer[lbyte++] = ubuf.u8buffer[b++];
+						ubuf->u8buffer[lbyte++] = ubuf->u8buffer[b++];
+						ubuf->u8buffer[lbyte++] = ubuf->u8buffer[b++];
+						ubuf->u8buffer[lbyte++] = ubuf->u8buffer[b++];
 						b++;
 					}
 				}
@@ -1576,12 +1615,12 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder
 				if(is_unsigned_samples) {
 					for(sample = wide_sample = 0; wide_sample < wide_samples; wide_sample++)
 						for(channel = 0; channel < channels; channel++, sample++)
-							ubuf.u8buffer[sample] = (FLAC__uint8)(buffer[channel][wide_sample] + 0x80);
+							ubuf->u8buffer[sample] = (FLAC__uint8)(buffer[channel][wide_sample] + 0x80);
 				}
 				else {
 					for(sample = wide_sample = 0; wide_sample < wide_samples; wide_sample++)
 						for(channel = 0; channel < channels; channel++, sample++)
-							ubuf.s8buffer[sample] = (FLAC__int8)(buffer[channel][wide_sample]);
+							ubuf->s8buffer[sample] = (FLAC__int8)(buffer[channel][wide_sample]);
 				}
 				bytes_to_write = sample;
 			}
@@ -1589,24 +1628,24 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder
 				if(is_unsigned_samples) {
 					for(sample = wide_sample = 0; wide_sample < wide_samples; wide_sample++)
 						for(channel = 0; channel < channels; channel++, sample++)
-							ubuf.u32buffer[sample] = buffer[channel][wide_sample];
+							ubuf->u32buffer[sample] = buffer[channel][wide_sample];
 				}
 				else {
 					for(sample = wide_sample = 0; wide_sample < wide_samples; wide_sample++)
 						for(channel = 0; channel < channels; channel++, sample++)
-							ubuf.s32buffer[sample] = buffer[channel][wide_sample];
+							ubuf->s32buffer[sample] = buffer[channel][wide_sample];
 				}
 				if(is_big_endian != is_big_endian_host_) {
 					uint8_t tmp;
 					const uint32_t bytes = sample * 4;
 					uint32_t b;
 					for(b = 0; b < bytes; b += 4) {
-						tmp = ubuf.u8buffer[b];
-						ubuf.u8buffer[b] = ubuf.u8buffer[b+3];
-						ubuf.u8buffer[b+3] = tmp;
-						tmp = ubuf.u8buffer[b+1];
-						ubuf.u8buffer[b+1] = ubuf.u8buffer[b+2];
-						ubuf.u8buffer[b+2] = tmp;
+						tmp = ubuf->u8buffer[b];
+						ubuf->u8buffer[b] = ubuf->u8buffer[b+3];
+						ubuf->u8buffer[b+3] = tmp;
+						tmp = ubuf->u8buffer[b+1];
+						ubuf->u8buffer[b+1] = ubuf->u8buffer[b+2];
+						ubuf->u8buffer[b+2] = tmp;
 					}
 				}
 				bytes_to_write = 4 * sample;
@@ -1620,7 +1659,7 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder
 		}
 	}
 	if(bytes_to_write > 0) {
-		if(flac__utils_fwrite(ubuf.u8buffer, 1, bytes_to_write, fout) != bytes_to_write) {
+		if(flac__utils_fwrite(ubuf->u8buffer, 1, bytes_to_write, fout) != bytes_to_write) {
 			/* if a pipe closed when writing to stdout, we let it go without an error message */
 			if(errno == EPIPE && decoder_session->fout == stdout)
 				decoder_session->aborting_due_to_until = true;
@@ -1925,3 +1964,34 @@ void print_stats(const DecoderSession *decoder_session)
 		}
 	}
 }
+
+void print_profile(const DecoderSession *d, const FLAC__StreamDecoderProfile *profile)
+{
+	static const char * const stage_names[FLAC__STREAM_DECODER_PROFILE_NUM_STAGES] = {
+		"frame sync",
+		"frame header",
+		"rice decoding",
+		"restore",
+		"decorrelation",
+		"MD5"
+	};
+	FLAC__uint64 total = 0;
+	uint32_t stage;
+
+	if(0 == profile) {
+		flac__utils_printf(stderr, 1, "%s: WARNING: libFLAC was built without profiling support, --profile ignored\n", d->inbasefilename);
+		return;
+	}
+
+	for(stage = 0; stage < FLAC__STREAM_DECODER_PROFILE_NUM_STAGES; stage++)
+		total += profile->nanoseconds[stage];
+
+	flac__utils_printf(stderr, 1, "%s: decoder profile:\n", d->inbasefilename);
+	for(stage = 0; stage < FLAC__STREAM_DECODER_PROFILE_NUM_STAGES; stage++)
+		flac__utils_printf(stderr, 1, "    %-17s %11.3f ms %12" PRIu64 " calls %6.2f%%\n",
+			stage_names[stage],
+			(double)profile->nanoseconds[stage] / 1e6,
+			profile->calls[stage],
+			total > 0? (double)profile->nanoseconds[stage] * 100.0 / (double)total : 0.0
+		);
+}
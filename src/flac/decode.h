@@ -53,8 +53,10 @@ typedef struct {
 	FLAC__bool has_cue_specification;
 	utils__CueSpecification cue_specification;
 	FLAC__bool channel_map_none; /* --channel-map=none specified, eventually will expand to take actual channel map */
+	FLAC__bool profile; /* print libFLAC profiling counters after each file */
 	FLAC__bool relaxed_foreign_metadata_handling;
 	FileSubFormat force_subformat;
+	uint32_t threads;
 
 	FileFormat format;
 	union {
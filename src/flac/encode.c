@@ -72,6 +72,23 @@ typedef struct {
 	FLAC__bool fatal_error;
 } FLACDecoderData;
 
+#define UBUFFER_INT8_SIZE 0x10000
+
+typedef union {
+	FLAC__int8 s8[UBUFFER_INT8_SIZE];
+	FLAC__uint8 u8[UBUFFER_INT8_SIZE];
+	FLAC__int16 s16[UBUFFER_INT8_SIZE/2];
+	FLAC__uint16 u16[UBUFFER_INT8_SIZE/2];
+	FLAC__int32 s32[UBUFFER_INT8_SIZE/4];
+	FLAC__uint32 u32[UBUFFER_INT8_SIZE/4];
+} UBuffer;
+
+/* per-session so that several files can be encoded at once */
+typedef struct {
+	UBuffer ubuffer;
+	FLAC__int32 in[FLAC__MAX_CHANNELS][CHUNK_OF_SAMPLES];
+} EncoderBuffers;
+
 typedef struct {
 #if FLAC__HAS_OGG
 	FLAC__bool use_ogg;
@@ -86,6 +103,9 @@ typedef struct {
 	FLAC__bool treat_warnings_as_errors;
 	FLAC__bool continue_through_decode_errors;
 	FLAC__bool replay_gain;
+	grabbag__ReplayGain *replaygain; /* owned by the caller of flac__encode_file(), see encode_options_t */
+	FLAC__bool profile;
+	uint32_t estimate; /* if > 0, nothing is written and only the size is estimated, see FLAC__stream_encoder_set_estimate_only() */
 	FLAC__uint64 total_samples_to_encode; /* (i.e. "wide samples" aka "sample frames") WATCHOUT: may be 0 to mean 'unknown' */
 	FLAC__uint64 unencoded_size; /* an estimate of the input size, only used in the progress indicator */
 	FLAC__uint64 bytes_written;
@@ -117,26 +137,14 @@ typedef struct {
 	FILE *fin;
 	FLAC__StreamMetadata *seek_table_template;
 	double progress, compression_ratio;
+
+	EncoderBuffers *buffers;
+	FLAC__int32 *input[FLAC__MAX_CHANNELS];
 } EncoderSession;
 
 const int FLAC_ENCODE__DEFAULT_PADDING = 8192;
 
-static FLAC__bool is_big_endian_host_;
-
-#define UBUFFER_INT8_SIZE 0x10000
-
-static union {
-	FLAC__int8 s8[UBUFFER_INT8_SIZE];
-	FLAC__uint8 u8[UBUFFER_INT8_SIZE];
-	FLAC__int16 s16[UBUFFER_INT8_SIZE/2];
-	FLAC__uint16 u16[UBUFFER_INT8_SIZE/2];
-	FLAC__int32 s32[UBUFFER_INT8_SIZE/4];
-	FLAC__uint32 u32[UBUFFER_INT8_SIZE/4];
-} ubuffer;
-
-
-static FLAC__int32 in_[FLAC__MAX_CHANNELS][CHUNK_OF_SAMPLES];
-static FLAC__int32 *input_[FLAC__MAX_CHANNELS];
+static const FLAC__bool is_big_endian_host_ = CPU_IS_BIG_ENDIAN;
 
 
 /*
@@ -152,7 +160,7 @@ static FLAC__bool EncoderSession_format_is_iff(const EncoderSession *e);
 static FLAC__bool convert_to_seek_table_template(const char *requested_seek_points, int num_requested_seek_points, FLAC__StreamMetadata *cuesheet, EncoderSession *e);
 static FLAC__bool canonicalize_until_specification(utils__SkipUntilSpecification *spec, const char *inbasefilename, uint32_t sample_rate, FLAC__uint64 skip, FLAC__uint64 total_samples_in_input);
 static FLAC__bool verify_metadata(const EncoderSession *e, FLAC__StreamMetadata **metadata, uint32_t num_metadata);
-static FLAC__bool format_input(FLAC__int32 *dest[], uint32_t wide_samples, FLAC__bool is_big_endian, FLAC__bool is_unsigned_samples, uint32_t channels, uint32_t bps, uint32_t shift, size_t *channel_map);
+static FLAC__bool format_input(FLAC__int32 *dest[], const UBuffer *ubuffer, uint32_t wide_samples, FLAC__bool is_big_endian, FLAC__bool is_unsigned_samples, uint32_t channels, uint32_t bps, uint32_t shift, size_t *channel_map);
 static void encoder_progress_callback(const FLAC__StreamEncoder *encoder, FLAC__uint64 bytes_written, FLAC__uint64 samples_written, uint32_t frames_written, uint32_t total_frames_estimate, void *client_data);
 static FLAC__StreamDecoderReadStatus flac_decoder_read_callback(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
 static FLAC__StreamDecoderSeekStatus flac_decoder_seek_callback(const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data);
@@ -164,9 +172,11 @@ static void flac_decoder_metadata_callback(const FLAC__StreamDecoder *decoder, c
 static void flac_decoder_error_callback(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data);
 static FLAC__bool parse_cuesheet(FLAC__StreamMetadata **cuesheet, const char *cuesheet_filename, const char *inbasefilename, uint32_t sample_rate, FLAC__bool is_cdda, FLAC__uint64 lead_out_offset, FLAC__bool treat_warnings_as_errors);
 static void print_stats(const EncoderSession *encoder_session);
+static void print_estimate(EncoderSession *encoder_session);
 static void print_error_with_init_status(const EncoderSession *e, const char *message, FLAC__StreamEncoderInitStatus init_status);
 static void print_error_with_state(const EncoderSession *e, const char *message);
 static void print_verify_error(EncoderSession *e);
+static void print_profile(EncoderSession *e);
 static FLAC__bool read_bytes(FILE *f, FLAC__byte *buf, size_t n, FLAC__bool eof_ok, const char *fn);
 static FLAC__bool read_uint16(FILE *f, FLAC__bool big_endian, FLAC__uint16 *val, const char *fn);
 static FLAC__bool read_uint32(FILE *f, FLAC__bool big_endian, FLAC__uint32 *val, const char *fn);
@@ -1197,8 +1207,8 @@ int flac__encode_file(FILE *infile, FLAC__off_t infilesize, const char *infilena
 					while(!feof(infile)) {
 						if(lookahead_length > 0) {
 							FLAC__ASSERT(lookahead_length < CHUNK_OF_SAMPLES * encoder_session.info.bytes_per_wide_sample);
-							memcpy(ubuffer.u8, lookahead, lookahead_length);
-							bytes_read = fread(ubuffer.u8+lookahead_length, sizeof(uint8_t), CHUNK_OF_SAMPLES * encoder_session.info.bytes_per_wide_sample - lookahead_length, infile) + lookahead_length;
+							memcpy(encoder_session.buffers->ubuffer.u8, lookahead, lookahead_length);
+							bytes_read = fread(encoder_session.buffers->ubuffer.u8+lookahead_length, sizeof(uint8_t), CHUNK_OF_SAMPLES * encoder_session.info.bytes_per_wide_sample - lookahead_length, infile) + lookahead_length;
 							if(ferror(infile)) {
 								flac__utils_printf(stderr, 1, "%s: ERROR during read\n", encoder_session.inbasefilename);
 								return EncoderSession_finish_error(&encoder_session);
@@ -1206,7 +1216,7 @@ int flac__encode_file(FILE *infile, FLAC__off_t infilesize, const char *infilena
 							lookahead_length = 0;
 						}
 						else
-							bytes_read = fread(ubuffer.u8, sizeof(uint8_t), CHUNK_OF_SAMPLES * encoder_session.info.bytes_per_wide_sample, infile);
+							bytes_read = fread(encoder_session.buffers->ubuffer.u8, sizeof(uint8_t), CHUNK_OF_SAMPLES * encoder_session.info.bytes_per_wide_sample, infile);
 
 						if(bytes_read == 0) {
 							if(ferror(infile)) {
@@ -1220,10 +1230,10 @@ int flac__encode_file(FILE *infile, FLAC__off_t infilesize, const char *infilena
 						}
 						else {
 							uint32_t wide_samples = bytes_read / encoder_session.info.bytes_per_wide_sample;
-							if(!format_input(input_, wide_samples, encoder_session.info.is_big_endian, encoder_session.info.is_unsigned_samples, encoder_session.info.channels, encoder_session.info.bits_per_sample, encoder_session.info.shift, channel_map))
+							if(!format_input(encoder_session.input, &encoder_session.buffers->ubuffer, wide_samples, encoder_session.info.is_big_endian, encoder_session.info.is_unsigned_samples, encoder_session.info.channels, encoder_session.info.bits_per_sample, encoder_session.info.shift, channel_map))
 								return EncoderSession_finish_error(&encoder_session);
 
-							if(!EncoderSession_process(&encoder_session, (const FLAC__int32 * const *)input_, wide_samples)) {
+							if(!EncoderSession_process(&encoder_session, (const FLAC__int32 * const *)encoder_session.input, wide_samples)) {
 								print_error_with_state(&encoder_session, "ERROR during encoding");
 								return EncoderSession_finish_error(&encoder_session);
 							}
@@ -1241,19 +1251,19 @@ int flac__encode_file(FILE *infile, FLAC__off_t infilesize, const char *infilena
 
 							if(lookahead_length > 0) {
 								if(lookahead_length <= wanted) {
-									memcpy(ubuffer.u8, lookahead, lookahead_length);
+									memcpy(encoder_session.buffers->ubuffer.u8, lookahead, lookahead_length);
 									wanted -= lookahead_length;
 									bytes_read = lookahead_length;
 								}
 								else {
 									/* This happens when --until is used on a very short file */
 									FLAC__ASSERT(lookahead_length < CHUNK_OF_SAMPLES * encoder_session.info.bytes_per_wide_sample);
-									memcpy(ubuffer.u8, lookahead, wanted);
+									memcpy(encoder_session.buffers->ubuffer.u8, lookahead, wanted);
 									wanted = 0;
 									bytes_read = wanted;
 								}
 								if(wanted > 0) {
-									bytes_read += fread(ubuffer.u8+lookahead_length, sizeof(uint8_t), wanted, infile);
+									bytes_read += fread(encoder_session.buffers->ubuffer.u8+lookahead_length, sizeof(uint8_t), wanted, infile);
 									if(ferror(infile)) {
 										flac__utils_printf(stderr, 1, "%s: ERROR during read\n", encoder_session.inbasefilename);
 										return EncoderSession_finish_error(&encoder_session);
@@ -1262,7 +1272,7 @@ int flac__encode_file(FILE *infile, FLAC__off_t infilesize, const char *infilena
 								lookahead_length = 0;
 							}
 							else
-								bytes_read = fread(ubuffer.u8, sizeof(uint8_t), wanted, infile);
+								bytes_read = fread(encoder_session.buffers->ubuffer.u8, sizeof(uint8_t), wanted, infile);
 						}
 
 						if(bytes_read == 0) {
@@ -1284,10 +1294,10 @@ int flac__encode_file(FILE *infile, FLAC__off_t infilesize, const char *infilena
 							}
 							else {
 								uint32_t wide_samples = bytes_read / encoder_session.info.bytes_per_wide_sample;
-								if(!format_input(input_, wide_samples, encoder_session.info.is_big_endian, encoder_session.info.is_unsigned_samples, encoder_session.info.channels, encoder_session.info.bits_per_sample, encoder_session.info.shift, channel_map))
+								if(!format_input(encoder_session.input, &encoder_session.buffers->ubuffer, wide_samples, encoder_session.info.is_big_endian, encoder_session.info.is_unsigned_samples, encoder_session.info.channels, encoder_session.info.bits_per_sample, encoder_session.info.shift, channel_map))
 									return EncoderSession_finish_error(&encoder_session);
 
-								if(!EncoderSession_process(&encoder_session, (const FLAC__int32 * const *)input_, wide_samples)) {
+								if(!EncoderSession_process(&encoder_session, (const FLAC__int32 * const *)encoder_session.input, wide_samples)) {
 									print_error_with_state(&encoder_session, "ERROR during encoding");
 									return EncoderSession_finish_error(&encoder_session);
 								}
@@ -1304,10 +1314,10 @@ int flac__encode_file(FILE *infile, FLAC__off_t infilesize, const char *infilena
 			case FORMAT_AIFF_C:
 				while(encoder_session.fmt.iff.data_bytes > 0) {
 					const size_t bytes_to_read =
-						(size_t) min (sizeof (ubuffer.u8),
+						(size_t) min (sizeof (encoder_session.buffers->ubuffer.u8),
 							min (encoder_session.fmt.iff.data_bytes,
 								CHUNK_OF_SAMPLES * (uint64_t) encoder_session.info.bytes_per_wide_sample));
-					size_t bytes_read = fread(ubuffer.u8, sizeof(uint8_t), bytes_to_read, infile);
+					size_t bytes_read = fread(encoder_session.buffers->ubuffer.u8, sizeof(uint8_t), bytes_to_read, infile);
 					if(bytes_read == 0) {
 						if(ferror(infile)) {
 							flac__utils_printf(stderr, 1, "%s: ERROR during read\n", encoder_session.inbasefilename);
@@ -1332,10 +1342,10 @@ int flac__encode_file(FILE *infile, FLAC__off_t infilesize, const char *infilena
 						}
 						else {
 							uint32_t wide_samples = bytes_read / encoder_session.info.bytes_per_wide_sample;
-							if(!format_input(input_, wide_samples, encoder_session.info.is_big_endian, encoder_session.info.is_unsigned_samples, encoder_session.info.channels, encoder_session.info.bits_per_sample, encoder_session.info.shift, channel_map))
+							if(!format_input(encoder_session.input, &encoder_session.buffers->ubuffer, wide_samples, encoder_session.info.is_big_endian, encoder_session.info.is_unsigned_samples, encoder_session.info.channels, encoder_session.info.bits_per_sample, encoder_session.info.shift, channel_map))
 								return EncoderSession_finish_error(&encoder_session);
 
-							if(!EncoderSession_process(&encoder_session, (const FLAC__int32 * const *)input_, wide_samples)) {
+							if(!EncoderSession_process(&encoder_session, (const FLAC__int32 * const *)encoder_session.input, wide_samples)) {
 								print_error_with_state(&encoder_session, "ERROR during encoding");
 								return EncoderSession_finish_error(&encoder_session);
 							}
@@ -1393,17 +1403,6 @@ int flac__encode_file(FILE *infile, FLAC__off_t infilesize, const char *infilena
 FLAC__bool EncoderSession_construct(EncoderSession *e, encode_options_t options, FLAC__off_t infilesize, FILE *infile, const char *infilename, const char *outfilename, const FLAC__byte *lookahead, uint32_t lookahead_length)
 {
 	uint32_t i;
-	FLAC__uint32 test = 1;
-
-	/*
-	 * initialize globals
-	 */
-
-	is_big_endian_host_ = (*((FLAC__byte*)(&test)))? false : true;
-
-	for(i = 0; i < FLAC__MAX_CHANNELS; i++)
-		input_[i] = &(in_[i][0]);
-
 
 	/*
 	 * initialize instance
@@ -1415,6 +1414,9 @@ FLAC__bool EncoderSession_construct(EncoderSession *e, encode_options_t options,
 	e->verify = options.verify;
 	e->treat_warnings_as_errors = options.treat_warnings_as_errors;
 	e->continue_through_decode_errors = options.continue_through_decode_errors;
+	e->estimate = options.estimate;
+	e->profile = options.profile;
+	e->replaygain = 0;
 
 	e->is_stdout = (0 == strcmp(outfilename, "-"));
 	e->outputfile_opened = false;
@@ -1473,6 +1475,7 @@ FLAC__bool EncoderSession_construct(EncoderSession *e, encode_options_t options,
 
 	e->fin = infile;
 	e->seek_table_template = 0;
+	e->buffers = 0;
 
 	if(0 == (e->seek_table_template = FLAC__metadata_object_new(FLAC__METADATA_TYPE_SEEKTABLE))) {
 		flac__utils_printf(stderr, 1, "%s: ERROR allocating memory for seek table\n", e->inbasefilename);
@@ -1486,6 +1489,14 @@ FLAC__bool EncoderSession_construct(EncoderSession *e, encode_options_t options,
 		return false;
 	}
 
+	if(0 == (e->buffers = malloc(sizeof(EncoderBuffers)))) {
+		flac__utils_printf(stderr, 1, "%s: ERROR allocating memory for sample buffers\n", e->inbasefilename);
+		EncoderSession_destroy(e);
+		return false;
+	}
+	for(i = 0; i < FLAC__MAX_CHANNELS; i++)
+		e->input[i] = &(e->buffers->in[i][0]);
+
 	return true;
 }
 
@@ -1513,6 +1524,11 @@ void EncoderSession_destroy(EncoderSession *e)
 		FLAC__metadata_object_delete(e->seek_table_template);
 		e->seek_table_template = 0;
 	}
+
+	if(0 != e->buffers) {
+		free(e->buffers);
+		e->buffers = 0;
+	}
 }
 
 int EncoderSession_finish_ok(EncoderSession *e, foreign_metadata_t *foreign_metadata, FLAC__bool error_on_compression_fail)
@@ -1533,6 +1549,8 @@ int EncoderSession_finish_ok(EncoderSession *e, foreign_metadata_t *foreign_meta
 	/* all errors except verify errors should interrupt the stats */
 	if(ret && !verify_error)
 		print_error_with_state(e, "ERROR during encoding");
+	else if(e->estimate > 0)
+		print_estimate(e);
 	else if(e->total_samples_to_encode > 0) {
 		print_stats(e);
 		flac__utils_printf(stderr, 2, "\n");
@@ -1543,7 +1561,10 @@ int EncoderSession_finish_ok(EncoderSession *e, foreign_metadata_t *foreign_meta
 		ret = 1;
 	}
 
-	if(ret == 0 && memcmp(e->md5sum_input,&empty_md5sum,16) != 0) {
+	if(e->encoder && e->profile)
+		print_profile(e);
+
+	if(ret == 0 && e->estimate == 0 && memcmp(e->md5sum_input,&empty_md5sum,16) != 0) {
 		FLAC__StreamMetadata streaminfo;
 		if(!FLAC__metadata_get_streaminfo(e->outfilename, &streaminfo)) {
 			flac__utils_printf(stderr, 1, "%s: ERROR: could not read back MD5sum of output\n", e->inbasefilename);
@@ -1562,7 +1583,7 @@ int EncoderSession_finish_ok(EncoderSession *e, foreign_metadata_t *foreign_meta
 		}
 	}
 
-	if(ret == 0 && foreign_metadata) {
+	if(ret == 0 && e->estimate == 0 && foreign_metadata) {
 		const char *error;
 		if(!flac__foreign_metadata_write_to_flac(foreign_metadata, e->infilename, e->outfilename, &error)) {
 			flac__utils_printf(stderr, 1, "%s: ERROR: updating foreign metadata in FLAC file: %s\n", e->inbasefilename, error);
@@ -1690,12 +1711,14 @@ FLAC__bool EncoderSession_init_encoder(EncoderSession *e, encode_options_t optio
 			flac__utils_printf(stderr, 1, "%s: ERROR, invalid sample rate (%u) for --replay-gain\n", e->inbasefilename, sample_rate);
 			return false;
 		}
-		if(options.is_first_file) {
-			if(!grabbag__replaygain_init(sample_rate)) {
-				flac__utils_printf(stderr, 1, "%s: ERROR initializing ReplayGain stage\n", e->inbasefilename);
-				return false;
-			}
+		/* every file gets a context of its own, which is handed to the caller
+		 * right away so it can add the file to the album once it is done */
+		FLAC__ASSERT(0 != options.replaygain && 0 == *options.replaygain);
+		if(0 == (e->replaygain = grabbag__replaygain_context_new(sample_rate))) {
+			flac__utils_printf(stderr, 1, "%s: ERROR initializing ReplayGain stage\n", e->inbasefilename);
+			return false;
 		}
+		*options.replaygain = e->replaygain;
 	}
 
 	if(!parse_cuesheet(&static_metadata.cuesheet, options.cuesheet_filename, e->inbasefilename, sample_rate, is_cdda, e->total_samples_to_encode, e->treat_warnings_as_errors))
@@ -1972,18 +1995,28 @@ FLAC__bool EncoderSession_init_encoder(EncoderSession *e, encode_options_t optio
 				return false;
 			}
 		}
-		else
-			if(!static_metadata_append(&static_metadata, options.vorbis_comment, /*needs_delete=*/false)) {
+		else {
+			/* the encoder sets is_last on the blocks, so with --parallel-files
+			 * every file gets its own copy of the blocks from the options */
+			FLAC__StreamMetadata *vc = FLAC__metadata_object_clone(options.vorbis_comment);
+			if(0 == vc || !static_metadata_append(&static_metadata, vc, /*needs_delete=*/true)) {
 				flac__utils_printf(stderr, 1, "%s: ERROR allocating memory for VORBIS_COMMENT block\n", e->inbasefilename);
+				if(0 != vc)
+					FLAC__metadata_object_delete(vc);
 				static_metadata_clear(&static_metadata);
 				return false;
 			}
-		for(i = 0; i < options.num_pictures; i++)
-			if(!static_metadata_append(&static_metadata, options.pictures[i], /*needs_delete=*/false)) {
+		}
+		for(i = 0; i < options.num_pictures; i++) {
+			FLAC__StreamMetadata *pic = FLAC__metadata_object_clone(options.pictures[i]);
+			if(0 == pic || !static_metadata_append(&static_metadata, pic, /*needs_delete=*/true)) {
 				flac__utils_printf(stderr, 1, "%s: ERROR allocating memory for PICTURE block\n", e->inbasefilename);
+				if(0 != pic)
+					FLAC__metadata_object_delete(pic);
 				static_metadata_clear(&static_metadata);
 				return false;
 			}
+		}
 		if(foreign_metadata) {
 			for(i = 0; i < foreign_metadata->num_blocks; i++) {
 				FLAC__StreamMetadata *p = FLAC__metadata_object_new(FLAC__METADATA_TYPE_PADDING);
@@ -2099,6 +2132,7 @@ FLAC__bool EncoderSession_init_encoder(EncoderSession *e, encode_options_t optio
 	FLAC__stream_encoder_set_total_samples_estimate(e->encoder, e->total_samples_to_encode);
 	FLAC__stream_encoder_set_metadata(e->encoder, (num_metadata > 0)? metadata : 0, num_metadata);
 	FLAC__stream_encoder_set_limit_min_bitrate(e->encoder, options.limit_min_bitrate);
+	FLAC__stream_encoder_set_variable_blocksize(e->encoder, options.variable_blocksize);
 
 	FLAC__stream_encoder_disable_constant_subframes(e->encoder, options.debug.disable_constant_subframes);
 	FLAC__stream_encoder_disable_fixed_subframes(e->encoder, options.debug.disable_fixed_subframes);
@@ -2111,7 +2145,7 @@ FLAC__bool EncoderSession_init_encoder(EncoderSession *e, encode_options_t optio
 		}
 		FLAC__stream_encoder_set_do_md5(e->encoder, false);
 	}
-	else if(e->is_stdout) {
+	else if(e->is_stdout && e->estimate == 0) {
 		flac__utils_printf(stderr, 1, "%s: WARNING, cannot write back MD5 sum when encoding to stdout\n", e->inbasefilename);
 		if(e->treat_warnings_as_errors) {
 			static_metadata_clear(&static_metadata);
@@ -2139,7 +2173,15 @@ FLAC__bool EncoderSession_init_encoder(EncoderSession *e, encode_options_t optio
 			FLAC__ASSERT(0);
 		}
 	}
+	if(0 != options.thread_pool)
+		FLAC__stream_encoder_set_thread_pool(e->encoder, options.thread_pool);
 
+	if(e->estimate > 0) {
+		/* nothing is written, so no callbacks are needed */
+		FLAC__stream_encoder_set_estimate_only(e->encoder, e->estimate);
+		init_status = FLAC__stream_encoder_init_stream(e->encoder, /*write_callback=*/0, /*seek_callback=*/0, /*tell_callback=*/0, /*metadata_callback=*/0, /*client_data=*/e);
+	}
+	else
 #if FLAC__HAS_OGG
 	if(e->use_ogg) {
 		FLAC__stream_encoder_set_ogg_serial_number(e->encoder, options.serial_number);
@@ -2154,12 +2196,12 @@ FLAC__bool EncoderSession_init_encoder(EncoderSession *e, encode_options_t optio
 
 	if(init_status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
 		print_error_with_init_status(e, "ERROR initializing encoder", init_status);
-		if(FLAC__stream_encoder_get_state(e->encoder) != FLAC__STREAM_ENCODER_IO_ERROR)
+		if(FLAC__stream_encoder_get_state(e->encoder) != FLAC__STREAM_ENCODER_IO_ERROR && e->estimate == 0)
 			e->outputfile_opened = true;
 		static_metadata_clear(&static_metadata);
 		return false;
 	}
-	else
+	else if(e->estimate == 0)
 		e->outputfile_opened = true;
 
 #if 0 /* in case time.h with clock() isn't available for some reason */
@@ -2184,7 +2226,7 @@ FLAC__bool EncoderSession_process(EncoderSession *e, const FLAC__int32 * const b
 #endif
 
 	if(e->replay_gain) {
-		if(!grabbag__replaygain_analyze(buffer, e->info.channels==2, e->info.bits_per_sample, samples)) {
+		if(!grabbag__replaygain_context_analyze(e->replaygain, buffer, e->info.channels==2, e->info.bits_per_sample, samples)) {
 			flac__utils_printf(stderr, 1, "%s: WARNING, error while calculating ReplayGain\n", e->inbasefilename);
 			if(e->treat_warnings_as_errors)
 				return false;
@@ -2244,7 +2286,7 @@ FLAC__bool convert_to_seek_table_template(const char *requested_seek_points, int
 	}
 
 	if(has_real_points) {
-		if(e->is_stdout) {
+		if(e->is_stdout && e->estimate == 0) {
 			flac__utils_printf(stderr, 1, "%s: WARNING, cannot write back seekpoints when encoding to stdout\n", e->inbasefilename);
 			if(e->treat_warnings_as_errors)
 				return false;
@@ -2349,7 +2391,7 @@ FLAC__bool verify_metadata(const EncoderSession *e, FLAC__StreamMetadata **metad
 	return true;
 }
 
-FLAC__bool format_input(FLAC__int32 *dest[], uint32_t wide_samples, FLAC__bool is_big_endian, FLAC__bool is_unsigned_samples, uint32_t channels, uint32_t bps, uint32_t shift, size_t *channel_map)
+FLAC__bool format_input(FLAC__int32 *dest[], const UBuffer *ubuffer, uint32_t wide_samples, FLAC__bool is_big_endian, FLAC__bool is_unsigned_samples, uint32_t channels, uint32_t bps, uint32_t shift, size_t *channel_map)
 {
 	uint32_t wide_sample, sample, channel;
 	FLAC__int32 *out[FLAC__MAX_CHANNELS];
@@ -2367,12 +2409,12 @@ FLAC__bool format_input(FLAC__int32 *dest[], uint32_t wide_samples, FLAC__bool i
 		if(is_unsigned_samples) {
 			for(channel = 0; channel < channels; channel++)
 				for(sample = channel, wide_sample = 0; wide_sample < wide_samples; wide_sample++, sample+=channels)
-					out[channel][wide_sample] = (FLAC__int32)ubuffer.u8[sample] - 0x80;
+					out[channel][wide_sample] = (FLAC__int32)ubuffer->u8[sample] - 0x80;
 		}
 		else {
 			for(channel = 0; channel < channels; channel++)
 				for(sample = channel, wide_sample = 0; wide_sample < wide_samples; wide_sample++, sample+=channels)
-					out[channel][wide_sample] = (FLAC__int32)ubuffer.s8[sample];
+					out[channel][wide_sample] = (FLAC__int32)ubuffer->s8[sample];
 		}
 	}
 	else if(bps == 16) {
@@ -2380,25 +2422,25 @@ FLAC__bool format_input(FLAC__int32 *dest[], uint32_t wide_samples, FLAC__bool i
 			if(is_big_endian != is_big_endian_host_) {
 				for(channel = 0; channel < channels; channel++)
 					for(sample = channel, wide_sample = 0; wide_sample < wide_samples; wide_sample++, sample+=channels)
-						out[channel][wide_sample] = (FLAC__int32)(ENDSWAP_16(ubuffer.u16[sample])) - 0x8000;
+						out[channel][wide_sample] = (FLAC__int32)(ENDSWAP_16(ubuffer->u16[sample])) - 0x8000;
 			}
 			else {
 				for(channel = 0; channel < channels; channel++)
 					for(sample = channel, wide_sample = 0; wide_sample < wide_samples; wide_sample++, sample+=channels)
-						out[channel][wide_sample] = (FLAC__int32)ubuffer.u16[sample] - 0x8000;
+						out[channel][wide_sample] = (FLAC__int32)ubuffer->u16[sample] - 0x8000;
 			}
 		}
 		else {
 			if(is_big_endian != is_big_endian_host_) {
 				for(channel = 0; channel < channels; channel++)
 					for(sample = channel, wide_sample = 0; wide_sample < wide_samples; wide_sample++, sample+=channels)
-						out[channel][wide_sample] = (int16_t)(ENDSWAP_16(ubuffer.s16[sample]));
+						out[channel][wide_sample] = (int16_t)(ENDSWAP_16(ubuffer->s16[sample]));
 
 			}
 			else {
 				for(channel = 0; channel < channels; channel++)
 					for(sample = channel, wide_sample = 0; wide_sample < wide_samples; wide_sample++, sample+=channels)
-						out[channel][wide_sample] = ubuffer.s16[sample];
+						out[channel][wide_sample] = ubuffer->s16[sample];
 			}
 		}
 	}
@@ -2409,9 +2451,9 @@ FLAC__bool format_input(FLAC__int32 *dest[], uint32_t wide_samples, FLAC__bool i
 					uint32_t b = 3*channel;
 					for(wide_sample = 0; wide_sample < wide_samples; wide_sample++) {
 						uint32_t t;
-						t  = ubuffer.u8[b];
-						t |= (uint32_t)(ubuffer.u8[b+1]) << 8;
-						t |= (uint32_t)(ubuffer.u8[b+2]) << 16;
+						t  = ubuffer->u8[b];
+						t |= (uint32_t)(ubuffer->u8[b+1]) << 8;
+						t |= (uint32_t)(ubuffer->u8[b+2]) << 16;
 						out[channel][wide_sample] = (FLAC__int32)t - 0x800000;
 						b += 3*channels;
 					}
@@ -2422,9 +2464,9 @@ FLAC__bool format_input(FLAC__int32 *dest[], uint32_t wide_samples, FLAC__bool i
 					uint32_t b = 3*channel;
 					for(wide_sample = 0; wide_sample < wide_samples; wide_sample++) {
 						uint32_t t;
-						t  = ubuffer.u8[b];
-						t |= (uint32_t)(ubuffer.u8[b+1]) << 8;
-						t |= (uint32_t)((int32_t)(ubuffer.s8[b+2])) << 16;
+						t  = ubuffer->u8[b];
+						t |= (uint32_t)(ubuffer->u8[b+1]) << 8;
+						t |= (uint32_t)((int32_t)(ubuffer->s8[b+2])) << 16;
 						out[channel][wide_sample] = t;
 						b += 3*channels;
 					}
@@ -2437,9 +2479,9 @@ FLAC__bool format_input(FLAC__int32 *dest[], uint32_t wide_samples, FLAC__bool i
 					uint32_t b = 3*channel;
 					for(wide_sample = 0; wide_sample < wide_samples; wide_sample++) {
 						uint32_t t;
-						t  = ubuffer.u8[b]; t <<= 8;
-						t |= ubuffer.u8[b+1]; t <<= 8;
-						t |= ubuffer.u8[b+2];
+						t  = ubuffer->u8[b]; t <<= 8;
+						t |= ubuffer->u8[b+1]; t <<= 8;
+						t |= ubuffer->u8[b+2];
 						out[channel][wide_sample] = (FLAC__int32)t - 0x800000;
 						b += 3*channels;
 					}
@@ -2450,9 +2492,9 @@ FLAC__bool format_input(FLAC__int32 *dest[], uint32_t wide_samples, FLAC__bool i
 					uint32_t b = 3*channel;
 					for(wide_sample = 0; wide_sample < wide_samples; wide_sample++) {
 						uint32_t t;
-						t  = ubuffer.s8[b]; t <<= 8;
-						t |= ubuffer.u8[b+1]; t <<= 8;
-						t |= ubuffer.u8[b+2];
+						t  = ubuffer->s8[b]; t <<= 8;
+						t |= ubuffer->u8[b+1]; t <<= 8;
+						t |= ubuffer->u8[b+2];
 						out[channel][wide_sample] = t;
 						b += 3*channels;
 					}
@@ -2465,24 +2507,24 @@ FLAC__bool format_input(FLAC__int32 *dest[], uint32_t wide_samples, FLAC__bool i
 			if(is_big_endian != is_big_endian_host_) {
 				for(channel = 0; channel < channels; channel++)
 					for(sample = channel, wide_sample = 0; wide_sample < wide_samples; wide_sample++, sample+=channels)
-						out[channel][wide_sample] = ENDSWAP_32(ubuffer.u32[sample]) - 0x80000000;
+						out[channel][wide_sample] = ENDSWAP_32(ubuffer->u32[sample]) - 0x80000000;
 			}
 			else {
 				for(channel = 0; channel < channels; channel++)
 					for(sample = channel, wide_sample = 0; wide_sample < wide_samples; wide_sample++, sample+=channels)
-						out[channel][wide_sample] = ubuffer.u32[sample] - 0x80000000;
+						out[channel][wide_sample] = ubuffer->u32[sample] - 0x80000000;
 			}
 		}
 		else {
 			if(is_big_endian != is_big_endian_host_) {
 				for(channel = 0; channel < channels; channel++)
 					for(sample = channel, wide_sample = 0; wide_sample < wide_samples; wide_sample++, sample+=channels)
-						out[channel][wide_sample] = ENDSWAP_32(ubuffer.s32[sample]);
+						out[channel][wide_sample] = ENDSWAP_32(ubuffer->s32[sample]);
 			}
 			else {
 				for(channel = 0; channel < channels; channel++)
 					for(sample = channel, wide_sample = 0; wide_sample < wide_samples; wide_sample++, sample+=channels)
-						out[channel][wide_sample] = ubuffer.s32[sample];
+						out[channel][wide_sample] = ubuffer->s32[sample];
 			}
 		}
 	}
@@ -2753,6 +2795,21 @@ static void print_stats(const EncoderSession *encoder_session)
 	}
 }
 
+static void print_estimate(EncoderSession *encoder_session)
+{
+	FLAC__uint64 bytes, bytes_low, bytes_high;
+	uint32_t blocks_analysed;
+
+	FLAC__stream_encoder_get_estimate(encoder_session->encoder, &bytes, &bytes_low, &bytes_high, &blocks_analysed);
+	if(encoder_session->unencoded_size > 0)
+		encoder_session->compression_ratio = (double)bytes / (double)encoder_session->unencoded_size;
+
+	if(encoder_session->compression_ratio > 0.0)
+		flac__utils_printf(stdout, 1, "%s: estimated %" PRIu64 " bytes (95%% interval %" PRIu64 "-%" PRIu64 "), ratio=%0.3f, %u blocks analysed\n", encoder_session->inbasefilename, bytes, bytes_low, bytes_high, encoder_session->compression_ratio, blocks_analysed);
+	else
+		flac__utils_printf(stdout, 1, "%s: estimated %" PRIu64 " bytes (95%% interval %" PRIu64 "-%" PRIu64 "), %u blocks analysed\n", encoder_session->inbasefilename, bytes, bytes_low, bytes_high, blocks_analysed);
+}
+
 void print_error_with_init_status(const EncoderSession *e, const char *message, FLAC__StreamEncoderInitStatus init_status)
 {
 	const int ilen = strlen(e->inbasefilename) + 1;
@@ -2846,6 +2903,41 @@ void print_verify_error(EncoderSession *e)
 	flac__utils_printf(stderr, 1, "Verify FAILED!  Do not trust %s\n", e->outfilename);
 }
 
+void print_profile(EncoderSession *e)
+{
+	static const char * const stage_names[FLAC__STREAM_ENCODER_PROFILE_NUM_STAGES] = {
+		"window",
+		"autocorrelation",
+		"LPC solve",
+		"quantization",
+		"residual",
+		"partition search",
+		"bitwriting",
+		"MD5",
+		"CRC"
+	};
+	FLAC__StreamEncoderProfile profile;
+	FLAC__uint64 total = 0;
+	uint32_t stage;
+
+	if(!FLAC__stream_encoder_get_profile(e->encoder, &profile)) {
+		flac__utils_printf(stderr, 1, "%s: WARNING: libFLAC was built without profiling support, --profile ignored\n", e->inbasefilename);
+		return;
+	}
+
+	for(stage = 0; stage < FLAC__STREAM_ENCODER_PROFILE_NUM_STAGES; stage++)
+		total += profile.nanoseconds[stage];
+
+	flac__utils_printf(stderr, 1, "%s: encoder profile:\n", e->inbasefilename);
+	for(stage = 0; stage < FLAC__STREAM_ENCODER_PROFILE_NUM_STAGES; stage++)
+		flac__utils_printf(stderr, 1, "    %-17s %11.3f ms %12" PRIu64 " calls %6.2f%%\n",
+			stage_names[stage],
+			(double)profile.nanoseconds[stage] / 1e6,
+			profile.calls[stage],
+			total > 0? (double)profile.nanoseconds[stage] * 100.0 / (double)total : 0.0
+		);
+}
+
 FLAC__bool read_bytes(FILE *f, FLAC__byte *buf, size_t n, FLAC__bool eof_ok, const char *fn)
 {
 	size_t bytes_read = fread(buf, 1, n, f);
@@ -2934,7 +3026,7 @@ FLAC__bool read_sane_extended(FILE *f, FLAC__uint32 *val, const char *fn)
 
 FLAC__bool fskip_ahead(FILE *f, FLAC__uint64 offset)
 {
-	static uint8_t dump[8192];
+	uint8_t dump[8192];
 	struct flac_stat_s stb;
 
 	if(offset > (FLAC__uint64)FLAC__OFF_T_MAX)
@@ -25,9 +25,11 @@
 #endif
 
 #include "FLAC/metadata.h"
+#include "FLAC/stream_encoder.h"
 #include "foreign_metadata.h"
 #include "utils.h"
 #include "share/compat.h"
+#include "share/grabbag.h"
 
 extern const int FLAC_ENCODE__DEFAULT_PADDING;
 
@@ -69,6 +71,7 @@ typedef struct {
 	size_t num_compression_settings;
 	compression_setting_t compression_settings[64];
 	uint32_t threads;
+	FLAC__ThreadPool *thread_pool; /* shared by the encoders of all files if not NULL, see --parallel-files */
 	char *requested_seek_points;
 	int num_requested_seek_points;
 	const char *cuesheet_filename;
@@ -76,13 +79,15 @@ typedef struct {
 	FLAC__bool continue_through_decode_errors; /* currently only obeyed when encoding from FLAC or Ogg FLAC */
 	FLAC__bool cued_seekpoints;
 	FLAC__bool channel_map_none; /* --channel-map=none specified, eventually will expand to take actual channel map */
+	FLAC__bool profile; /* print libFLAC profiling counters after each file */
 
-	FLAC__bool is_first_file;
-	FLAC__bool is_last_file;
 	FLAC__bool replay_gain;
+	grabbag__ReplayGain **replaygain; /* with replay_gain, receives the analysis of the file, which the caller deletes */
 	FLAC__bool ignore_chunk_sizes;
 	FLAC__bool error_on_compression_fail;
 	FLAC__bool limit_min_bitrate;
+	uint32_t variable_blocksize;
+	uint32_t estimate;
 	FLAC__bool relaxed_foreign_metadata_handling;
 
 	FLAC__StreamMetadata *vorbis_comment;
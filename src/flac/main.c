@@ -46,6 +46,7 @@
 #include "share/alloc.h"
 #include "share/grabbag.h"
 #include "share/compat.h"
+#include "share/compat_threads.h"
 #include "share/endswap.h"
 #include "share/safe_str.h"
 #include "analyze.h"
@@ -79,12 +80,15 @@ static void show_version(void);
 static void show_help(void);
 static void format_mistake(const char *infilename, FileFormat wrong, FileFormat right);
 
-static int encode_file(const char *infilename, FLAC__bool is_first_file, FLAC__bool is_last_file);
+static int encode_file(const char *infilename, long serial_number, grabbag__ReplayGain **replaygain);
 static int decode_file(const char *infilename);
+#ifdef FLAC__USE_THREADS
+static int process_files_in_parallel(long serial_number, grabbag__ReplayGain *replaygain_album);
+#endif
 
-static const char *get_encoded_outfilename(const char *infilename);
-static const char *get_decoded_outfilename(const char *infilename, const FileFormat format);
-static const char *get_outfilename(const char *infilename, const char *suffix);
+static const char *get_encoded_outfilename(const char *infilename, char *buffer, size_t buffer_size);
+static const char *get_decoded_outfilename(const char *infilename, const FileFormat format, char *buffer, size_t buffer_size);
+static const char *get_outfilename(const char *infilename, const char *suffix, char *buffer, size_t buffer_size);
 
 static void die(const char *message);
 static int conditional_fclose(FILE *f);
@@ -117,6 +121,7 @@ static struct share__option long_options_[] = {
 	{ "skip"                             , share__required_argument, 0, 0 },
 	{ "until"                            , share__required_argument, 0, 0 },
 	{ "channel-map"                      , share__required_argument, 0, 0 }, /* undocumented */
+	{ "profile"                          , share__no_argument, 0, 0 },
 
 	/*
 	 * decoding options
@@ -165,6 +170,8 @@ static struct share__option long_options_[] = {
 	{ "serial-number"             , share__required_argument, 0, 0 },
 #endif
 	{ "blocksize"                 , share__required_argument, 0, 'b' },
+	{ "variable-blocksize"        , share__required_argument, 0, 0 },
+	{ "estimate"                  , share__optional_argument, 0, 0 },
 	{ "exhaustive-model-search"   , share__no_argument, 0, 'e' },
 	{ "max-lpc-order"             , share__required_argument, 0, 'l' },
 	{ "apodization"               , share__required_argument, 0, 'A' },
@@ -174,6 +181,7 @@ static struct share__option long_options_[] = {
 	{ "qlp-coeff-precision"       , share__required_argument, 0, 'q' },
 	{ "rice-partition-order"      , share__required_argument, 0, 'r' },
 	{ "threads"                   , share__required_argument, 0, 'j' },
+	{ "parallel-files"            , share__required_argument, 0, 0 },
 	{ "endian"                    , share__required_argument, 0, 0 },
 	{ "channels"                  , share__required_argument, 0, 0 },
 	{ "bps"                       , share__required_argument, 0, 0 },
@@ -271,6 +279,8 @@ static struct {
 	size_t num_compression_settings;
 	compression_setting_t compression_settings[64]; /* bad MAGIC NUMBER but buffer overflow is checked */
 	uint32_t threads;
+	uint32_t parallel_files;
+	FLAC__ThreadPool *thread_pool; /* the -j threads shared by all files with --parallel-files */
 	const char *skip_specification;
 	const char *until_specification;
 	const char *cue_specification;
@@ -285,8 +295,11 @@ static struct {
 	const char *cuesheet_filename;
 	FLAC__bool cued_seekpoints;
 	FLAC__bool channel_map_none; /* --channel-map=none specified, eventually will expand to take actual channel map */
+	FLAC__bool profile;
 	FLAC__bool error_on_compression_fail;
 	FLAC__bool limit_min_bitrate;
+	uint32_t variable_blocksize;
+	uint32_t estimate;
 
 	uint32_t num_files;
 	char **filenames;
@@ -494,6 +507,20 @@ int do_it(void)
 				flac__utils_printf(stderr, 1, "NOTE: --replay-gain may leave a small PADDING block even with --no-padding\n");
 			}
 		}
+		if(option_values.estimate > 0) {
+			if(option_values.mode_decode)
+				return usage_error("ERROR: --estimate only allowed for encoding\n");
+			if(option_values.replay_gain)
+				return usage_error("ERROR: --estimate not allowed with --replay-gain\n");
+			if(option_values.delete_input)
+				return usage_error("ERROR: --estimate not allowed with --delete-input-file\n");
+			if(option_values.keep_foreign_metadata || option_values.keep_foreign_metadata_if_present)
+				return usage_error("ERROR: --estimate not allowed with --keep-foreign-metadata\n");
+#if FLAC__HAS_OGG
+			if(option_values.use_ogg)
+				return usage_error("ERROR: --estimate not allowed with --ogg\n");
+#endif
+		}
 		if(option_values.num_files > 1 && option_values.cmdline_forced_outfilename) {
 			return usage_error("ERROR: -o/--output-name cannot be used with multiple files\n");
 		}
@@ -524,6 +551,23 @@ int do_it(void)
 				return usage_error("ERROR: decoding through errors is not supported when decoding chained streams\n");
 
 		}
+		if(option_values.parallel_files > 1) {
+#ifdef FLAC__USE_THREADS
+			uint32_t i;
+			if(option_values.analyze)
+				return usage_error("ERROR: --parallel-files not allowed with -a/--analyze\n");
+			if(option_values.force_to_stdout)
+				return usage_error("ERROR: --parallel-files not allowed with -c/--stdout\n");
+			if(option_values.cmdline_forced_outfilename)
+				return usage_error("ERROR: --parallel-files not allowed with -o/--output-name\n");
+			for(i = 0; i < option_values.num_files; i++) {
+				if(0 == strcmp(option_values.filenames[i], "-"))
+					return usage_error("ERROR: --parallel-files cannot be used when reading from stdin\n");
+			}
+#else
+			return usage_error("ERROR: --parallel-files is not available: multithreading was not enabled during compilation of this binary\n");
+#endif
+		}
 
 	}
 
@@ -543,6 +587,10 @@ int do_it(void)
 			uint32_t i;
 			if(option_values.num_files > 1)
 				option_values.cmdline_forced_outfilename = 0;
+#ifdef FLAC__USE_THREADS
+			if(option_values.parallel_files > 1 && option_values.num_files > 1)
+				return process_files_in_parallel(0, 0);
+#endif
 			for(i = 0, retval = 0; i < option_values.num_files; i++) {
 				if(0 == strcmp(option_values.filenames[i], "-") && !first)
 					continue;
@@ -557,28 +605,58 @@ int do_it(void)
 		if(option_values.ignore_chunk_sizes)
 			flac__utils_printf(stderr, 1, "INFO: Make sure you know what you're doing when using --ignore-chunk-sizes.\n      Improper use can cause flac to encode non-audio data as audio.\n");
 
+#if FLAC__HAS_OGG
+		/* set a random serial number if one has not yet been specified; each
+		 * file gets the next one so the numbering does not depend on the order
+		 * in which files finish */
+		if(!option_values.has_serial_number) {
+		        if (RAND_MAX < 0x7fffffff)
+				option_values.serial_number = (uint32_t)(rand() & 0x7fff) << 16 | (uint32_t)(rand());
+		        else
+				option_values.serial_number = rand();
+			option_values.has_serial_number = true;
+		}
+#endif
+
 		if(option_values.num_files == 0) {
-			retval = encode_file("-", first, true);
+			retval = encode_file("-", option_values.serial_number, 0);
 		}
 		else {
+			grabbag__ReplayGain *replaygain_album = 0; /* the files finished so far, for the album gain */
 			uint32_t i;
 			if(option_values.num_files > 1)
 				option_values.cmdline_forced_outfilename = 0;
+			if(option_values.replay_gain && 0 == (replaygain_album = grabbag__replaygain_context_new(0))) {
+				flac__utils_printf(stderr, 1, "ERROR: allocating memory\n");
+				return 1;
+			}
+#ifdef FLAC__USE_THREADS
+			if(option_values.parallel_files > 1 && option_values.num_files > 1)
+				retval = process_files_in_parallel(option_values.serial_number, replaygain_album);
+			else
+#endif
 			for(i = 0, retval = 0; i < option_values.num_files; i++) {
+				grabbag__ReplayGain *replaygain = 0;
 				if(0 == strcmp(option_values.filenames[i], "-") && !first)
 					continue;
-				if(encode_file(option_values.filenames[i], first, i == (option_values.num_files-1)))
+				if(encode_file(option_values.filenames[i], (long)((uint32_t)option_values.serial_number + i), &replaygain))
 					retval = 1;
 				else
 					first = false;
+				if(0 != replaygain) {
+					grabbag__replaygain_context_merge_into_album(replaygain_album, replaygain);
+					grabbag__replaygain_context_delete(replaygain);
+				}
 			}
 			if(option_values.replay_gain && retval == 0) {
 				float album_gain, album_peak;
-				grabbag__replaygain_get_album(&album_gain, &album_peak);
+				grabbag__replaygain_context_get_album(replaygain_album, &album_gain, &album_peak);
 				for(i = 0; i < option_values.num_files; i++) {
-					const char *error, *outfilename = get_encoded_outfilename(option_values.filenames[i]);
+					char outfilename_buffer[4096];
+					const char *error, *outfilename = get_encoded_outfilename(option_values.filenames[i], outfilename_buffer, sizeof outfilename_buffer);
 					if(0 == outfilename) {
 						flac__utils_printf(stderr, 1, "ERROR: filename too long: %s", option_values.filenames[i]);
+						grabbag__replaygain_context_delete(replaygain_album);
 						return 1;
 					}
 					if(0 != (error = grabbag__replaygain_store_to_file_album(outfilename, album_gain, album_peak, option_values.preserve_modtime))) {
@@ -587,6 +665,7 @@ int do_it(void)
 					}
 				}
 			}
+			grabbag__replaygain_context_delete(replaygain_album);
 		}
 	}
 
@@ -636,6 +715,8 @@ FLAC__bool init_options(void)
 	option_values.aopts.do_residual_gnuplot = false;
 	option_values.padding = -1;
 	option_values.threads = 1;
+	option_values.parallel_files = 1;
+	option_values.thread_pool = 0;
 	option_values.num_compression_settings = 1;
 	option_values.compression_settings[0].type = CST_COMPRESSION_LEVEL;
 	option_values.compression_settings[0].value.t_unsigned = 5;
@@ -653,8 +734,11 @@ FLAC__bool init_options(void)
 	option_values.cuesheet_filename = 0;
 	option_values.cued_seekpoints = true;
 	option_values.channel_map_none = false;
+	option_values.profile = false;
 	option_values.error_on_compression_fail = false;
 	option_values.limit_min_bitrate = false;
+	option_values.variable_blocksize = 0;
+	option_values.estimate = 0;
 
 	option_values.num_files = 0;
 	option_values.filenames = 0;
@@ -794,6 +878,9 @@ int parse_option(int short_option, const char *long_option, const char *option_a
 				return usage_error("ERROR: only --channel-map=none currently supported\n");
 			option_values.channel_map_none = true;
 		}
+		else if(0 == strcmp(long_option, "profile")) {
+			option_values.profile = true;
+		}
 		else if(0 == strcmp(long_option, "cuesheet")) {
 			FLAC__ASSERT(0 != option_argument);
 			option_values.cuesheet_filename = option_argument;
@@ -860,6 +947,15 @@ int parse_option(int short_option, const char *long_option, const char *option_a
 			option_values.serial_number = atol(option_argument);
 		}
 #endif
+		else if(0 == strcmp(long_option, "parallel-files")) {
+			FLAC__ASSERT(0 != option_argument);
+			{
+				const int n = atoi(option_argument);
+				if(n < 1)
+					return usage_error("ERROR: --%s must be > 0\n", long_option);
+				option_values.parallel_files = (uint32_t)n;
+			}
+		}
 		else if(0 == strcmp(long_option, "endian")) {
 			FLAC__ASSERT(0 != option_argument);
 			if(0 == strncmp(option_argument, "big", strlen(option_argument)))
@@ -899,6 +995,25 @@ int parse_option(int short_option, const char *long_option, const char *option_a
 		else if(0 == strcmp(long_option, "limit-min-bitrate")) {
 			option_values.limit_min_bitrate = true;
 		}
+		else if(0 == strcmp(long_option, "variable-blocksize")) {
+			FLAC__ASSERT(0 != option_argument);
+			{
+				const int n = atoi(option_argument);
+				if(n < 0 || n > 3)
+					return usage_error("ERROR: --%s must be >= 0 and <= 3\n", long_option);
+				option_values.variable_blocksize = (uint32_t)n;
+			}
+		}
+		else if(0 == strcmp(long_option, "estimate")) {
+			if(0 == option_argument)
+				option_values.estimate = 1;
+			else {
+				const int n = atoi(option_argument);
+				if(n < 1)
+					return usage_error("ERROR: --%s must be >= 1\n", long_option);
+				option_values.estimate = (uint32_t)n;
+			}
+		}
 		/*
 		 * negatives
 		 */
@@ -1334,6 +1449,8 @@ void show_help(void)
 	printf("  -t, --test                   As -d except no decoded file is written,\n");
 	printf("                               and with some additional checks.\n");
 	printf("  -a, --analyze                As -d except an analysis file is written\n");
+	printf("      --estimate[=#]           As encoding except no file is written, only the\n");
+	printf("                               size is estimated, analysing 1 in # blocks\n");
 	printf("  -c, --stdout                 Write output to stdout\n");
 	printf("  -f, --force                  Force overwriting of output files\n");
 	printf("      --delete-input-file      Deletes after a successful encode/decode\n");
@@ -1348,6 +1465,8 @@ void show_help(void)
 	printf("      --no-utf8-convert        Do not convert tags from local charset to UTF-8\n");
 	printf("  -s, --silent                 Do not write runtime encode/decode statistics\n");
 	printf("      --totally-silent         Do not print anything, including errors\n");
+	printf("      --profile                Print the time spent in each stage of encoding\n");
+	printf("                               or decoding; needs a libFLAC built with profiling\n");
 	printf("  -w, --warnings-as-errors     Treat all warnings as errors\n");
 	printf("\n");
 	printf("Decoding options:\n");
@@ -1375,6 +1494,7 @@ void show_help(void)
 	printf("                                         -A \"subdivide_tukey(3)\"\n");
 	printf("  -l, --max-lpc-order=#              Max LPC order; 0 => only fixed predictors\n");
 	printf("  -b, --blocksize=#                  Specify blocksize in samples\n");
+	printf("      --variable-blocksize=#         Split blocks in halves up to # times\n");
 	printf("  -m, --mid-side                     Try mid-side coding for each frame\n");
 	printf("  -M, --adaptive-mid-side            Adaptive choice of mid-side coding\n");
 	printf("  -r, --rice-partition-order=[#,]#   Set [min,]max residual partition order\n");
@@ -1385,7 +1505,8 @@ void show_help(void)
 	printf("  -p, --qlp-coeff-precision-search   Exhaustively search LP coeff quantization\n");
 	printf("      --lax                          Allow encoder to generate non-Subset files\n");
 	printf("      --limit-min-bitrate            Limit minimum bitrate (for streaming)\n");
-	printf("  -j, --threads=#                    Set number of encoding threads\n");
+	printf("  -j, --threads=#                    Set number of encoding or decoding threads\n");
+	printf("      --parallel-files=#             Encode or decode up to # files at once\n");
 	printf("      --ignore-chunk-sizes           Ignore data chunk sizes in WAVE/AIFF files\n");
 	printf("      --replay-gain                  Calculate ReplayGain & store in FLAC tags\n");
 	printf("      --cuesheet=FILENAME            Import cuesheet & store in CUESHEET block\n");
@@ -1455,8 +1576,9 @@ void format_mistake(const char *infilename, FileFormat wrong, FileFormat right)
 	flac__utils_printf(stderr, 1, "WARNING: %s is not a%s file; treating as a%s file\n", infilename, FileFormatString[wrong], FileFormatString[right]);
 }
 
-int encode_file(const char *infilename, FLAC__bool is_first_file, FLAC__bool is_last_file)
+int encode_file(const char *infilename, long serial_number, grabbag__ReplayGain **replaygain_out)
 {
+	grabbag__ReplayGain *replaygain = 0; /* set by flac__encode_file() with --replay-gain */
 	FILE *encode_infile;
 	FLAC__byte lookahead[12];
 	uint32_t lookahead_length = 0, master_chunk_size = 0;
@@ -1464,7 +1586,8 @@ int encode_file(const char *infilename, FLAC__bool is_first_file, FLAC__bool is_
 	int retval;
 	FLAC__off_t infilesize;
 	encode_options_t encode_options;
-	const char *outfilename = get_encoded_outfilename(infilename); /* the final name of the encoded file */
+	char outfilename_buffer[4096];
+	const char *outfilename = get_encoded_outfilename(infilename, outfilename_buffer, sizeof outfilename_buffer); /* the final name of the encoded file */
 	/* internal_outfilename is the file we will actually write to; it will be a temporary name if infilename==outfilename */
 	char *internal_outfilename = 0; /* NULL implies 'use outfilename' */
 	size_t infilename_length;
@@ -1592,7 +1715,7 @@ int encode_file(const char *infilename, FLAC__bool is_first_file, FLAC__bool is_
 	 * Error if output file already exists (and -f not used).
 	 * Use grabbag__file_get_filesize() as a cheap way to check.
 	 */
-	if(!option_values.test_only && !option_values.force_file_overwrite && strcmp(outfilename, "-") && grabbag__file_get_filesize(outfilename) != (FLAC__off_t)(-1)) {
+	if(!option_values.test_only && !option_values.estimate && !option_values.force_file_overwrite && strcmp(outfilename, "-") && grabbag__file_get_filesize(outfilename) != (FLAC__off_t)(-1)) {
 		if(input_format == FORMAT_FLAC) {
 			/* need more detailed error message when re-flac'ing to avoid confusing the user */
 			flac__utils_printf(stderr, 1,
@@ -1673,16 +1796,9 @@ int encode_file(const char *infilename, FLAC__bool is_first_file, FLAC__bool is_
 	encode_options.treat_warnings_as_errors = option_values.treat_warnings_as_errors;
 #if FLAC__HAS_OGG
 	encode_options.use_ogg = option_values.use_ogg;
-	/* set a random serial number if one has not yet been specified */
-	if(!option_values.has_serial_number) {
-	        if (RAND_MAX < 0x7fffffff)
-			option_values.serial_number = (uint32_t)(rand() & 0x7fff) << 16 | (uint32_t)(rand());
-	        else
-			option_values.serial_number = rand();
-		option_values.has_serial_number = true;
-	}
-	encode_options.serial_number = option_values.serial_number;
-	option_values.serial_number = (uint32_t)option_values.serial_number + 1;
+	encode_options.serial_number = serial_number;
+#else
+	(void)serial_number;
 #endif
 	encode_options.lax = option_values.lax;
 	encode_options.padding = option_values.padding;
@@ -1690,15 +1806,16 @@ int encode_file(const char *infilename, FLAC__bool is_first_file, FLAC__bool is_
 	FLAC__ASSERT(sizeof(encode_options.compression_settings) >= sizeof(option_values.compression_settings));
 	memcpy(encode_options.compression_settings, option_values.compression_settings, sizeof(option_values.compression_settings));
 	encode_options.threads = option_values.threads;
+	encode_options.thread_pool = option_values.thread_pool;
 	encode_options.requested_seek_points = option_values.requested_seek_points;
 	encode_options.num_requested_seek_points = option_values.num_requested_seek_points;
 	encode_options.cuesheet_filename = option_values.cuesheet_filename;
 	encode_options.continue_through_decode_errors = option_values.continue_through_decode_errors;
 	encode_options.cued_seekpoints = option_values.cued_seekpoints;
 	encode_options.channel_map_none = option_values.channel_map_none;
-	encode_options.is_first_file = is_first_file;
-	encode_options.is_last_file = is_last_file;
+	encode_options.profile = option_values.profile;
 	encode_options.replay_gain = option_values.replay_gain;
+	encode_options.replaygain = &replaygain;
 	encode_options.ignore_chunk_sizes = option_values.ignore_chunk_sizes;
 	encode_options.vorbis_comment = option_values.vorbis_comment;
 	FLAC__ASSERT(sizeof(encode_options.pictures) >= sizeof(option_values.pictures));
@@ -1711,10 +1828,12 @@ int encode_file(const char *infilename, FLAC__bool is_first_file, FLAC__bool is_
 	encode_options.debug.do_md5 = option_values.debug.do_md5;
 	encode_options.error_on_compression_fail = option_values.error_on_compression_fail;
 	encode_options.limit_min_bitrate = option_values.limit_min_bitrate;
+	encode_options.variable_blocksize = option_values.variable_blocksize;
+	encode_options.estimate = option_values.estimate;
 	encode_options.relaxed_foreign_metadata_handling = option_values.keep_foreign_metadata_if_present;
 
 	/* if infilename and outfilename point to the same file, we need to write to a temporary file */
-	if(encode_infile != stdin && grabbag__file_are_same(infilename, outfilename)) {
+	if(encode_infile != stdin && !option_values.estimate && grabbag__file_are_same(infilename, outfilename)) {
 		static const char *tmp_suffix = ".tmp,fl-ac+en'c";
 		size_t dest_len = strlen(outfilename) + strlen(tmp_suffix) + 1;
 		/*@@@@ still a remote possibility that a file with this filename exists */
@@ -1770,12 +1889,12 @@ int encode_file(const char *infilename, FLAC__bool is_first_file, FLAC__bool is_
 		retval = 1; /* double protection */
 	}
 
-	if(retval == 0) {
+	if(retval == 0 && !option_values.estimate) {
 		if(strcmp(outfilename, "-")) {
 			if(option_values.replay_gain) {
 				float title_gain, title_peak;
 				const char *error;
-				grabbag__replaygain_get_title(&title_gain, &title_peak);
+				grabbag__replaygain_context_get_title(replaygain, &title_gain, &title_peak);
 				if(
 					0 != (error = grabbag__replaygain_store_to_file_reference(internal_outfilename? internal_outfilename : outfilename, option_values.preserve_modtime)) ||
 					0 != (error = grabbag__replaygain_store_to_file_title(internal_outfilename? internal_outfilename : outfilename, title_gain, title_peak, option_values.preserve_modtime))
@@ -1816,6 +1935,12 @@ int encode_file(const char *infilename, FLAC__bool is_first_file, FLAC__bool is_
 	if(internal_outfilename != 0)
 		free(internal_outfilename);
 
+	/* the file only counts towards the album gain if it was encoded */
+	if(retval == 0 && 0 != replaygain_out)
+		*replaygain_out = replaygain;
+	else
+		grabbag__replaygain_context_delete(replaygain);
+
 	return retval;
 }
 
@@ -1827,7 +1952,8 @@ int decode_file(const char *infilename)
 	FileSubFormat output_subformat = SUBFORMAT_UNSPECIFIED;
 	decode_options_t decode_options;
 	foreign_metadata_t *foreign_metadata = 0;
-	const char *outfilename = get_outfilename(infilename, ".    "); /* Placeholder until we know what the actual suffix is */
+	char outfilename_buffer[4096];
+	const char *outfilename = get_outfilename(infilename, ".    ", outfilename_buffer, sizeof outfilename_buffer); /* Placeholder until we know what the actual suffix is */
 	size_t infilename_length;
 
 	if(0 == outfilename) {
@@ -1953,7 +2079,7 @@ int decode_file(const char *infilename)
 	}
 
 	/* Now reassemble outfilename */
-	get_decoded_outfilename(infilename, output_format);
+	get_decoded_outfilename(infilename, output_format, outfilename_buffer, sizeof outfilename_buffer);
 
 	/*
 	 * Error if output file already exists (and -f not used).
@@ -2018,6 +2144,7 @@ int decode_file(const char *infilename)
 	decode_options.relaxed_foreign_metadata_handling = option_values.keep_foreign_metadata_if_present;
 	decode_options.replaygain_synthesis_spec = option_values.replaygain_synthesis_spec;
 	decode_options.force_subformat = output_subformat;
+	decode_options.threads = option_values.threads;
 #if FLAC__HAS_OGG
 	decode_options.is_ogg = treat_as_ogg;
 	decode_options.decode_chained_stream = option_values.decode_chained_stream;
@@ -2025,6 +2152,7 @@ int decode_file(const char *infilename)
 	decode_options.serial_number = option_values.serial_number;
 #endif
 	decode_options.channel_map_none = option_values.channel_map_none;
+	decode_options.profile = option_values.profile;
 	decode_options.format = output_format;
 
 	if(output_format == FORMAT_RAW) {
@@ -2053,7 +2181,148 @@ int decode_file(const char *infilename)
 	return retval;
 }
 
-const char *get_encoded_outfilename(const char *infilename)
+#ifdef FLAC__USE_THREADS
+/*
+ * --parallel-files: worker threads take the next file from a shared
+ * counter, and the main thread prints each file's console output in
+ * command line order as soon as it and all files before it are done.
+ */
+typedef struct {
+	int retval;
+	char *output; /* collected console output, NULL if none */
+	grabbag__ReplayGain *replaygain; /* with --replay-gain, the analysis of the file */
+	FLAC__bool done;
+} parallel_file_t;
+
+typedef struct {
+	FLAC__mtx_t mutex;
+	FLAC__cnd_t file_done;
+	uint32_t next_file;
+	long serial_number;
+	parallel_file_t *files;
+} parallel_files_t;
+
+static FLAC__thread_return_type parallel_files_worker(void *args)
+{
+	parallel_files_t *pf = (parallel_files_t *)args;
+	uint32_t i;
+	int retval;
+	char *output;
+	grabbag__ReplayGain *replaygain;
+
+	for(;;) {
+		FLAC__mtx_lock(&pf->mutex);
+		i = pf->next_file++;
+		FLAC__mtx_unlock(&pf->mutex);
+		if(i >= option_values.num_files)
+			break;
+
+		/* if collecting fails the output is printed directly, which is only cosmetic */
+		(void)flac__utils_console_collect_begin();
+		replaygain = 0;
+		if(option_values.mode_decode)
+			retval = decode_file(option_values.filenames[i]);
+		else
+			retval = encode_file(option_values.filenames[i], (long)((uint32_t)pf->serial_number + i), &replaygain);
+		output = flac__utils_console_collect_end();
+
+		FLAC__mtx_lock(&pf->mutex);
+		pf->files[i].retval = retval;
+		pf->files[i].output = output;
+		pf->files[i].replaygain = replaygain;
+		pf->files[i].done = true;
+		FLAC__cnd_broadcast(&pf->file_done);
+		FLAC__mtx_unlock(&pf->mutex);
+	}
+	return FLAC__thread_default_return_value;
+}
+
+int process_files_in_parallel(long serial_number, grabbag__ReplayGain *replaygain_album)
+{
+	parallel_files_t pf;
+	FLAC__thrd_t threads[64];
+	uint32_t i, num_threads, threads_created = 0;
+	int retval = 0;
+
+	num_threads = option_values.parallel_files;
+	if(num_threads > option_values.num_files)
+		num_threads = option_values.num_files;
+	if(num_threads > sizeof(threads) / sizeof(threads[0]))
+		num_threads = sizeof(threads) / sizeof(threads[0]);
+
+	if(!flac__utils_console_init_threads()) {
+		flac__utils_printf(stderr, 1, "ERROR: allocating memory\n");
+		return 1;
+	}
+	if(0 == (pf.files = safe_calloc_(option_values.num_files, sizeof(parallel_file_t)))) {
+		flac__utils_printf(stderr, 1, "ERROR: allocating memory\n");
+		flac__utils_console_finish_threads();
+		return 1;
+	}
+	if(FLAC__mtx_init(&pf.mutex, FLAC__mtx_plain) != FLAC__thrd_success) {
+		flac__utils_printf(stderr, 1, "ERROR: allocating memory\n");
+		free(pf.files);
+		flac__utils_console_finish_threads();
+		return 1;
+	}
+	if(FLAC__cnd_init(&pf.file_done) != FLAC__thrd_success) {
+		flac__utils_printf(stderr, 1, "ERROR: allocating memory\n");
+		FLAC__mtx_destroy(&pf.mutex);
+		free(pf.files);
+		flac__utils_console_finish_threads();
+		return 1;
+	}
+	pf.next_file = 0;
+	pf.serial_number = serial_number;
+
+	/* the encoders of all files share one pool of -j threads, instead of
+	 * each creating their own; without a pool each creates its own */
+	if(!option_values.mode_decode && option_values.threads > 1)
+		option_values.thread_pool = FLAC__thread_pool_new(option_values.threads);
+
+	for(i = 0; i < num_threads; i++) {
+		if(FLAC__thrd_create(&threads[threads_created], parallel_files_worker, &pf) == FLAC__thrd_success)
+			threads_created++;
+	}
+	/* without any worker the files are processed here, the output is still kept in order */
+	if(threads_created == 0)
+		parallel_files_worker(&pf);
+
+	for(i = 0; i < option_values.num_files; i++) {
+		FLAC__mtx_lock(&pf.mutex);
+		while(!pf.files[i].done)
+			FLAC__cnd_wait(&pf.file_done, &pf.mutex);
+		FLAC__mtx_unlock(&pf.mutex);
+		if(0 != pf.files[i].output) {
+			flac_fprintf(stderr, "%s", pf.files[i].output);
+			fflush(stderr);
+			free(pf.files[i].output);
+		}
+		if(pf.files[i].retval)
+			retval = 1;
+		/* the files are added to the album here, so the album does not depend on the order they finish in */
+		if(0 != pf.files[i].replaygain) {
+			grabbag__replaygain_context_merge_into_album(replaygain_album, pf.files[i].replaygain);
+			grabbag__replaygain_context_delete(pf.files[i].replaygain);
+		}
+	}
+
+	for(i = 0; i < threads_created; i++)
+		FLAC__thrd_join(threads[i], NULL);
+
+	FLAC__thread_pool_delete(option_values.thread_pool);
+	option_values.thread_pool = 0;
+
+	FLAC__cnd_destroy(&pf.file_done);
+	FLAC__mtx_destroy(&pf.mutex);
+	free(pf.files);
+	flac__utils_console_finish_threads();
+
+	return retval;
+}
+#endif
+
+const char *get_encoded_outfilename(const char *infilename, char *buffer, size_t buffer_size)
 {
 	const char *suffix = (option_values.use_ogg? ".oga" : ".flac");
 	const char *p;
@@ -2065,10 +2334,10 @@ const char *get_encoded_outfilename(const char *infilename)
 		p = infilename;
 	}
 
-	return get_outfilename(p, suffix);
+	return get_outfilename(p, suffix, buffer, buffer_size);
 }
 
-const char *get_decoded_outfilename(const char *infilename, const FileFormat format)
+const char *get_decoded_outfilename(const char *infilename, const FileFormat format, char *buffer, size_t buffer_size)
 {
 	const char *suffix;
 	const char *p;
@@ -2101,32 +2370,30 @@ const char *get_decoded_outfilename(const char *infilename, const FileFormat for
 	else {
 		suffix = ".wav";
 	}
-	return get_outfilename(p, suffix);
+	return get_outfilename(p, suffix, buffer, buffer_size);
 }
 
-const char *get_outfilename(const char *infilename, const char *suffix)
+const char *get_outfilename(const char *infilename, const char *suffix, char *buffer, size_t buffer_size)
 {
 	if(0 == option_values.cmdline_forced_outfilename) {
-		static char buffer[4096];
-
 		if(0 == strcmp(infilename, "-") || option_values.force_to_stdout) {
 			buffer [0] = '-';
 			buffer [1] = 0;
 		}
 		else {
 			char *p;
-			if (flac__strlcpy(buffer, option_values.output_prefix? option_values.output_prefix : "", sizeof buffer) >= sizeof buffer)
+			if (flac__strlcpy(buffer, option_values.output_prefix? option_values.output_prefix : "", buffer_size) >= buffer_size)
 				return 0;
-			if (flac__strlcat(buffer, infilename, sizeof buffer) >= sizeof buffer)
+			if (flac__strlcat(buffer, infilename, buffer_size) >= buffer_size)
 				return 0;
 			/* the . must come after any / to avoid problems with, e.g. "some.directory/extensionless-filename" */
 			if(0 == (p = strrchr(buffer, '.')) || strchr(p, '/')) {
-				if (flac__strlcat(buffer, suffix, sizeof buffer) >= sizeof buffer)
+				if (flac__strlcat(buffer, suffix, buffer_size) >= buffer_size)
 					return 0;
 			}
 			else {
 				*p = '\0';
-				if (flac__strlcat(buffer, suffix, sizeof buffer) >= sizeof buffer)
+				if (flac__strlcat(buffer, suffix, buffer_size) >= buffer_size)
 					return 0;
 			}
 		}
@@ -30,6 +30,7 @@
 #include "FLAC/assert.h"
 #include "FLAC/metadata.h"
 #include "share/compat.h"
+#include "share/compat_threads.h"
 #ifndef _WIN32
 #ifndef _XOPEN_SOURCE
 #define _XOPEN_SOURCE
@@ -161,6 +162,139 @@ static FLAC__uint64 local__find_closest_cue_(const FLAC__StreamMetadata_CueSheet
 	}
 }
 
+/* variables and functions for console status output */
+typedef struct {
+	FLAC__bool is_name_printed;
+	int stats_char_count;
+	int console_width;
+	int console_chars_left;
+	/* when collecting, output to stderr is appended to buffer instead */
+	FLAC__bool collecting;
+	char *buffer;
+	size_t length;
+	size_t capacity;
+} console_state;
+
+static console_state console_ = { false, 0, 0, 0, false, 0, 0, 0 };
+#ifdef FLAC__USE_THREADS
+static FLAC__bool console_key_created_ = false;
+static FLAC__tss_t console_key_;
+#endif
+
+static console_state *get_console_state_(void)
+{
+#ifdef FLAC__USE_THREADS
+	if(console_key_created_) {
+		console_state *state = (console_state *)FLAC__tss_get(console_key_);
+		if(0 != state)
+			return state;
+	}
+#endif
+	return &console_;
+}
+
+static int console_vprintf_(console_state *state, FILE *stream, const char *format, va_list args)
+{
+	va_list args_copy;
+	char *newbuffer;
+	size_t newcapacity;
+	int len;
+
+	if(!state->collecting || stream != stderr)
+		return flac_vfprintf(stream, format, args);
+
+	va_copy(args_copy, args);
+	len = vsnprintf(0, 0, format, args_copy);
+	va_end(args_copy);
+	if(len <= 0)
+		return len;
+
+	if(state->length + len + 1 > state->capacity) {
+		newcapacity = state->capacity > 0? state->capacity : 1024;
+		while(state->length + len + 1 > newcapacity)
+			newcapacity *= 2;
+		if(0 == (newbuffer = (char *)realloc(state->buffer, newcapacity)))
+			return 0; /* dropping console output is preferable to failing the file */
+		state->buffer = newbuffer;
+		state->capacity = newcapacity;
+	}
+	len = vsnprintf(state->buffer + state->length, state->capacity - state->length, format, args);
+	state->length += len;
+	return len;
+}
+
+static int console_printf_(console_state *state, FILE *stream, const char *format, ...)
+{
+	va_list args;
+	int len;
+
+	va_start(args, format);
+	len = console_vprintf_(state, stream, format, args);
+	va_end(args);
+	return len;
+}
+
+FLAC__bool flac__utils_console_init_threads(void)
+{
+#ifdef FLAC__USE_THREADS
+	if(!console_key_created_) {
+		if(FLAC__tss_create(&console_key_) != FLAC__thrd_success)
+			return false;
+		console_key_created_ = true;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+void flac__utils_console_finish_threads(void)
+{
+#ifdef FLAC__USE_THREADS
+	if(console_key_created_) {
+		FLAC__tss_delete(console_key_);
+		console_key_created_ = false;
+	}
+#endif
+}
+
+FLAC__bool flac__utils_console_collect_begin(void)
+{
+#ifdef FLAC__USE_THREADS
+	console_state *state;
+
+	FLAC__ASSERT(console_key_created_);
+
+	if(0 == (state = (console_state *)calloc(1, sizeof(console_state))))
+		return false;
+	state->collecting = true;
+	if(FLAC__tss_set(console_key_, state) != FLAC__thrd_success) {
+		free(state);
+		return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+char *flac__utils_console_collect_end(void)
+{
+#ifdef FLAC__USE_THREADS
+	console_state *state = (console_state *)FLAC__tss_get(console_key_);
+	char *buffer;
+
+	if(0 == state)
+		return 0;
+	(void)FLAC__tss_set(console_key_, 0);
+	buffer = state->buffer;
+	free(state);
+	return buffer;
+#else
+	return 0;
+#endif
+}
+
 void flac__utils_printf(FILE *stream, int level, const char *format, ...)
 {
 	if(flac__utils_verbosity_ >= level) {
@@ -170,7 +304,7 @@ void flac__utils_printf(FILE *stream, int level, const char *format, ...)
 
 		va_start(args, format);
 
-		(void) flac_vfprintf(stream, format, args);
+		(void) console_vprintf_(get_console_state_(), stream, format, args);
 
 		va_end(args);
 
@@ -181,12 +315,6 @@ void flac__utils_printf(FILE *stream, int level, const char *format, ...)
 	}
 }
 
-/* variables and functions for console status output */
-static FLAC__bool is_name_printed;
-static int stats_char_count = 0;
-static int console_width;
-static int console_chars_left;
-
 int get_console_width(void)
 {
 	int width = 0;
@@ -229,16 +357,31 @@ size_t strlen_console(const char *text)
 
 void stats_new_line(void)
 {
-	is_name_printed = false;
-	stats_char_count = 0;
+	console_state *state = get_console_state_();
+	state->is_name_printed = false;
+	state->stats_char_count = 0;
 }
 
-void stats_clear(void)
+static void stats_clear_(console_state *state)
 {
-	while (stats_char_count > 0 && stats_char_count--)
+	if(state->collecting) {
+		/* drop the previous progress line rather than backspacing over it */
+		if(state->stats_char_count > 0 && (size_t)state->stats_char_count <= state->length) {
+			state->length -= state->stats_char_count;
+			state->buffer[state->length] = '\0';
+		}
+		state->stats_char_count = 0;
+		return;
+	}
+	while (state->stats_char_count > 0 && state->stats_char_count--)
 		flac_fprintf(stderr, "\b");
 }
 
+void stats_clear(void)
+{
+	stats_clear_(get_console_state_());
+}
+
 void stats_print_name(int level, const char *name)
 {
 	stats_print_name_and_stream_number(level, name, -1);
@@ -249,19 +392,20 @@ void stats_print_name_and_stream_number(int level, const char *name, int stream_
 	int len;
 
 	if (flac__utils_verbosity_ >= level) {
-		stats_clear();
-		if(is_name_printed) return;
+		console_state *state = get_console_state_();
+		stats_clear_(state);
+		if(state->is_name_printed) return;
 
-		console_width = get_console_width();
+		state->console_width = get_console_width();
 		len = strlen_console(name)+2;
 		if(stream_number >= 0)
 			len += 10 + floor(log10(stream_number));
-		console_chars_left = console_width  - (len % console_width);
+		state->console_chars_left = state->console_width  - (len % state->console_width);
 		if(stream_number < 0)
-			flac_fprintf(stderr, "%s: ", name);
+			console_printf_(state, stderr, "%s: ", name);
 		else
-			flac_fprintf(stderr, "%s, stream %d: ", name, stream_number);
-		is_name_printed = true;
+			console_printf_(state, stderr, "%s, stream %d: ", name, stream_number);
+		state->is_name_printed = true;
 	}
 }
 
@@ -271,38 +415,41 @@ void stats_print_info(int level, const char *format, ...)
 	int len, clear_len;
 
 	if (flac__utils_verbosity_ >= level) {
+		console_state *state = get_console_state_();
 		va_list args;
 		va_start(args, format);
 		len = flac_vsnprintf(tmp, sizeof(tmp), format, args);
 		va_end(args);
-		stats_clear();
-		if (len >= console_chars_left) {
-			clear_len = console_chars_left;
-			while (clear_len > 0 && clear_len--) flac_fprintf(stderr, " ");
-			flac_fprintf(stderr, "\n");
-			console_chars_left = console_width;
+		stats_clear_(state);
+		if (len >= state->console_chars_left) {
+			clear_len = state->console_chars_left;
+			while (clear_len > 0 && clear_len--) console_printf_(state, stderr, " ");
+			console_printf_(state, stderr, "\n");
+			state->console_chars_left = state->console_width;
 		}
-		stats_char_count = flac_fprintf(stderr, "%s", tmp);
-		fflush(stderr);
+		state->stats_char_count = console_printf_(state, stderr, "%s", tmp);
+		if(!state->collecting)
+			fflush(stderr);
 	}
 }
 
 void flac__utils_printf_clear_stats(FILE *stream, int level, const char *format, ...)
 {
 	if(flac__utils_verbosity_ >= level) {
+		console_state *state = get_console_state_();
 		va_list args;
 
 		FLAC__ASSERT(0 != format);
 
-		if(is_name_printed || stats_char_count > 0) {
-			flac_fprintf(stderr,"\r");
-			stats_char_count = 0;
-			is_name_printed = false;
+		if(state->is_name_printed || state->stats_char_count > 0) {
+			console_printf_(state, stderr,"\r");
+			state->stats_char_count = 0;
+			state->is_name_printed = false;
 		}
 
 		va_start(args, format);
 
-		(void) flac_vfprintf(stream, format, args);
+		(void) console_vprintf_(state, stream, format, args);
 
 		va_end(args);
 
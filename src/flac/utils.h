@@ -58,6 +58,16 @@ size_t flac__utils_fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stre
 extern int flac__utils_verbosity_;
 void flac__utils_printf(FILE *stream, int level, const char *format, ...);
 
+/* Console output of files processed in parallel is collected per thread and
+ * printed by the caller once the file is done, so it does not interleave.
+ * flac__utils_console_collect_end() returns the collected output (to be
+ * free()d, may be NULL) and restores direct output for the calling thread.
+ */
+FLAC__bool flac__utils_console_init_threads(void);
+void flac__utils_console_finish_threads(void);
+FLAC__bool flac__utils_console_collect_begin(void);
+char *flac__utils_console_collect_end(void);
+
 int get_console_width(void);
 size_t strlen_console(const char *text);
 void stats_new_line(void);
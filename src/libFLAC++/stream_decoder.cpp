@@ -86,6 +86,42 @@ namespace FLAC {
 			return static_cast<bool>(::FLAC__stream_decoder_set_md5_checking(decoder_, value));
 		}
 
+		uint32_t Stream::set_num_threads(uint32_t value)
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_decoder_set_num_threads(decoder_, value);
+		}
+
+		bool Stream::set_interleaved_output(::FLAC__StreamDecoderPCMFormat format, void *buffer, size_t buffer_size)
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_decoder_set_interleaved_output(decoder_, format, buffer, buffer_size));
+		}
+
+		bool Stream::set_pull_mode(bool value)
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_decoder_set_pull_mode(decoder_, value));
+		}
+
+		bool Stream::set_build_frame_index(bool value)
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_decoder_set_build_frame_index(decoder_, value));
+		}
+
+		bool Stream::set_frame_index(const ::FLAC__StreamMetadata *frame_index)
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_decoder_set_frame_index(decoder_, frame_index));
+		}
+
+		bool Stream::set_prefetch_buffers(uint32_t num_buffers)
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_decoder_set_prefetch_buffers(decoder_, num_buffers));
+		}
+
 		bool Stream::set_metadata_respond(::FLAC__MetadataType type)
 		{
 			FLAC__ASSERT(is_valid());
@@ -140,6 +176,36 @@ namespace FLAC {
 			return static_cast<bool>(::FLAC__stream_decoder_get_md5_checking(decoder_));
 		}
 
+		uint32_t Stream::get_num_threads() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_decoder_get_num_threads(decoder_);
+		}
+
+		bool Stream::get_pull_mode() const
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_decoder_get_pull_mode(decoder_));
+		}
+
+		bool Stream::get_build_frame_index() const
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_decoder_get_build_frame_index(decoder_));
+		}
+
+		const ::FLAC__StreamMetadata *Stream::get_frame_index() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_decoder_get_frame_index(decoder_);
+		}
+
+		uint32_t Stream::get_prefetch_buffers() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_decoder_get_prefetch_buffers(decoder_);
+		}
+
 		FLAC__uint64 Stream::get_total_samples() const
 		{
 			FLAC__ASSERT(is_valid());
@@ -194,6 +260,12 @@ namespace FLAC {
 			return ::FLAC__stream_decoder_get_link_lengths(decoder_, link_lengths);
 		}
 
+		bool Stream::get_profile(::FLAC__StreamDecoderProfile *profile) const
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_decoder_get_profile(decoder_, profile));
+		}
+
 		::FLAC__StreamDecoderInitStatus Stream::init()
 		{
 			FLAC__ASSERT(is_valid());
@@ -272,6 +344,24 @@ namespace FLAC {
 			return static_cast<bool>(::FLAC__stream_decoder_seek_absolute(decoder_, sample));
 		}
 
+		uint32_t Stream::read_samples(::FLAC__StreamDecoderPCMFormat format, void *buffer, uint32_t samples)
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_decoder_read_samples(decoder_, format, buffer, samples);
+		}
+
+		bool Stream::save_frame_index(const char *filename) const
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_decoder_save_frame_index(decoder_, filename));
+		}
+
+		bool Stream::load_frame_index(const char *filename)
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_decoder_load_frame_index(decoder_, filename));
+		}
+
 		::FLAC__StreamDecoderSeekStatus Stream::seek_callback(FLAC__uint64 absolute_byte_offset)
 		{
 			(void)absolute_byte_offset;
@@ -420,6 +510,28 @@ namespace FLAC {
 			return init_ogg(filename.c_str());
 		}
 
+		::FLAC__StreamDecoderInitStatus File::init_mmap(const char *filename)
+		{
+			FLAC__ASSERT(0 != decoder_);
+			return ::FLAC__stream_decoder_init_mmap(decoder_, filename, write_callback_, metadata_callback_, error_callback_, /*client_data=*/(void*)this);
+		}
+
+		::FLAC__StreamDecoderInitStatus File::init_mmap(const std::string &filename)
+		{
+			return init_mmap(filename.c_str());
+		}
+
+		::FLAC__StreamDecoderInitStatus File::init_ogg_mmap(const char *filename)
+		{
+			FLAC__ASSERT(0 != decoder_);
+			return ::FLAC__stream_decoder_init_ogg_mmap(decoder_, filename, write_callback_, metadata_callback_, error_callback_, /*client_data=*/(void*)this);
+		}
+
+		::FLAC__StreamDecoderInitStatus File::init_ogg_mmap(const std::string &filename)
+		{
+			return init_ogg_mmap(filename.c_str());
+		}
+
 		// This is a dummy to satisfy the pure virtual from Stream; the
 		// read callback will never be called since we are initializing
 		// with FLAC__stream_decoder_init_FILE() or
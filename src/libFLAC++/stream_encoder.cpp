@@ -117,6 +117,12 @@ namespace FLAC {
 			return static_cast<bool>(::FLAC__stream_encoder_set_blocksize(encoder_, value));
 		}
 
+		bool Stream::set_variable_blocksize(uint32_t value)
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_encoder_set_variable_blocksize(encoder_, value));
+		}
+
 		bool Stream::set_do_mid_side_stereo(bool value)
 		{
 			FLAC__ASSERT(is_valid());
@@ -217,12 +223,30 @@ namespace FLAC {
 			return static_cast<bool>(::FLAC__stream_encoder_set_limit_min_bitrate(encoder_, value));
 		}
 
+		bool Stream::set_estimate_only(uint32_t value)
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_encoder_set_estimate_only(encoder_, value));
+		}
+
+		bool Stream::set_write_buffers(bool value)
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_encoder_set_write_buffer_callback(encoder_, value? write_buffer_callback_ : 0));
+		}
+
 		uint32_t Stream::set_num_threads(uint32_t value)
 		{
 			FLAC__ASSERT(is_valid());
 			return ::FLAC__stream_encoder_set_num_threads(encoder_, value);
 		}
 
+		bool Stream::set_thread_pool(::FLAC__ThreadPool *value)
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_encoder_set_thread_pool(encoder_, value));
+		}
+
 		Stream::State Stream::get_state() const
 		{
 			FLAC__ASSERT(is_valid());
@@ -241,6 +265,12 @@ namespace FLAC {
 			::FLAC__stream_encoder_get_verify_decoder_error_stats(encoder_, absolute_sample, frame_number, channel, sample, expected, got);
 		}
 
+		void Stream::get_estimate(FLAC__uint64 *bytes, FLAC__uint64 *bytes_low, FLAC__uint64 *bytes_high, uint32_t *frames_analysed) const
+		{
+			FLAC__ASSERT(is_valid());
+			::FLAC__stream_encoder_get_estimate(encoder_, bytes, bytes_low, bytes_high, frames_analysed);
+		}
+
 		bool Stream::get_verify() const
 		{
 			FLAC__ASSERT(is_valid());
@@ -289,6 +319,12 @@ namespace FLAC {
 			return ::FLAC__stream_encoder_get_blocksize(encoder_);
 		}
 
+		uint32_t Stream::get_variable_blocksize() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_encoder_get_variable_blocksize(encoder_);
+		}
+
 		uint32_t Stream::get_max_lpc_order() const
 		{
 			FLAC__ASSERT(is_valid());
@@ -349,12 +385,24 @@ namespace FLAC {
 			return static_cast<bool>(::FLAC__stream_encoder_get_limit_min_bitrate(encoder_));
 		}
 
+		uint32_t Stream::get_estimate_only() const
+		{
+			FLAC__ASSERT(is_valid());
+			return ::FLAC__stream_encoder_get_estimate_only(encoder_);
+		}
+
 		uint32_t Stream::get_num_threads() const
 		{
 			FLAC__ASSERT(is_valid());
 			return ::FLAC__stream_encoder_get_num_threads(encoder_);
 		}
 
+		bool Stream::get_profile(::FLAC__StreamEncoderProfile *profile) const
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_encoder_get_profile(encoder_, profile));
+		}
+
 		::FLAC__StreamEncoderInitStatus Stream::init()
 		{
 			FLAC__ASSERT(is_valid());
@@ -385,12 +433,26 @@ namespace FLAC {
 			return static_cast<bool>(::FLAC__stream_encoder_process_interleaved(encoder_, buffer, samples));
 		}
 
+		bool Stream::release_buffer(FLAC__byte buffer[])
+		{
+			FLAC__ASSERT(is_valid());
+			return static_cast<bool>(::FLAC__stream_encoder_release_buffer(encoder_, buffer));
+		}
+
 		::FLAC__StreamEncoderReadStatus Stream::read_callback(FLAC__byte buffer[], size_t *bytes)
 		{
 			(void)buffer, (void)bytes;
 			return ::FLAC__STREAM_ENCODER_READ_STATUS_UNSUPPORTED;
 		}
 
+		::FLAC__StreamEncoderWriteStatus Stream::write_buffer_callback(FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame)
+		{
+			::FLAC__StreamEncoderWriteStatus status = write_callback(buffer, bytes, samples, current_frame);
+			if(status == ::FLAC__STREAM_ENCODER_WRITE_STATUS_OK)
+				(void)release_buffer(buffer);
+			return status;
+		}
+
 		::FLAC__StreamEncoderSeekStatus Stream::seek_callback(FLAC__uint64 absolute_byte_offset)
 		{
 			(void)absolute_byte_offset;
@@ -426,6 +488,15 @@ namespace FLAC {
 			return instance->write_callback(buffer, bytes, samples, current_frame);
 		}
 
+		::FLAC__StreamEncoderWriteStatus Stream::write_buffer_callback_(const ::FLAC__StreamEncoder *encoder, FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame, void *client_data)
+		{
+			(void)encoder;
+			FLAC__ASSERT(0 != client_data);
+			Stream *instance = reinterpret_cast<Stream *>(client_data);
+			FLAC__ASSERT(0 != instance);
+			return instance->write_buffer_callback(buffer, bytes, samples, current_frame);
+		}
+
 		::FLAC__StreamEncoderSeekStatus Stream::seek_callback_(const ::FLAC__StreamEncoder *encoder, FLAC__uint64 absolute_byte_offset, void *client_data)
 		{
 			(void)encoder;
@@ -45,6 +45,15 @@
 #include "share/compat.h"
 #include "share/endswap.h"
 
+#if ENABLE_64_BIT_WORDS
+#if defined FLAC__AVX2_SUPPORTED && defined FLAC__BMI2_SUPPORTED
+#include <immintrin.h> /* AVX2 */
+#endif
+#if defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN
+#include <arm_neon.h>
+#endif
+#endif
+
 /* Things should be fastest when this matches the machine word size */
 /* WATCHOUT: if you change this you must also change the following #defines down to COUNT_ZERO_MSBS2 below to match */
 /* WATCHOUT: there are a few places where the code will not work unless brword is >= 32 bits wide */
@@ -112,6 +121,7 @@ struct FLAC__BitReader {
 	uint32_t read_crc16; /* the running frame CRC */
 	uint32_t crc16_offset; /* the number of words in the current buffer that should not be CRC'd */
 	uint32_t crc16_align; /* the number of bits in the current consumed word that should not be CRC'd */
+	const FLAC__CRC16Functions *crc16_functions;
 	FLAC__bool read_limit_set; /* whether reads are limited */
 	uint32_t read_limit; /* the remaining size of what can be read */
 	uint32_t last_seen_framesync; /* the location of the last seen framesync, if it is in the buffer, in bits from front of buffer */
@@ -140,9 +150,9 @@ static inline void crc16_update_block_(FLAC__BitReader *br)
 	/* Prevent OOB read due to wrap-around. */
 	if (br->consumed_words > br->crc16_offset) {
 #if FLAC__BYTES_PER_WORD == 4
-		br->read_crc16 = FLAC__crc16_update_words32(br->buffer + br->crc16_offset, br->consumed_words - br->crc16_offset, br->read_crc16);
+		br->read_crc16 = br->crc16_functions->update_words32(br->buffer + br->crc16_offset, br->consumed_words - br->crc16_offset, br->read_crc16);
 #elif FLAC__BYTES_PER_WORD == 8
-		br->read_crc16 = FLAC__crc16_update_words64(br->buffer + br->crc16_offset, br->consumed_words - br->crc16_offset, br->read_crc16);
+		br->read_crc16 = br->crc16_functions->update_words64(br->buffer + br->crc16_offset, br->consumed_words - br->crc16_offset, br->read_crc16);
 #else
 		unsigned i;
 
@@ -295,6 +305,7 @@ FLAC__bool FLAC__bitreader_init(FLAC__BitReader *br, FLAC__BitReaderReadCallback
 		return false;
 	br->read_callback = rcb;
 	br->client_data = cd;
+	br->crc16_functions = &FLAC__crc16_functions;
 	br->read_limit_set = false;
 	br->read_limit = -1;
 	br->last_seen_framesync = -1;
@@ -347,6 +358,14 @@ FLAC__bool FLAC__bitreader_rewind_to_after_last_seen_framesync(FLAC__BitReader *
 	}
 }
 
+void FLAC__bitreader_set_crc16_functions(FLAC__BitReader *br, const FLAC__CRC16Functions *functions)
+{
+	FLAC__ASSERT(0 != br);
+	FLAC__ASSERT(0 != functions);
+
+	br->crc16_functions = functions;
+}
+
 void FLAC__bitreader_reset_read_crc16(FLAC__BitReader *br, FLAC__uint16 seed)
 {
 	FLAC__ASSERT(0 != br);
@@ -840,6 +859,58 @@ FLAC__bool FLAC__bitreader_read_rice_signed_block_bmi2(FLAC__BitReader *br, int
 #include "deduplication/bitreader_read_rice_signed_block.c"
 #endif
 
+#if ENABLE_64_BIT_WORDS
+#if defined FLAC__AVX2_SUPPORTED && defined FLAC__BMI2_SUPPORTED
+FLAC__SSE_TARGET("avx2,bmi2")
+static inline void zigzag_block_avx2_(int vals[], uint32_t nvals)
+{
+	const __m256i one = _mm256_set1_epi32(1);
+	uint32_t i;
+
+	for(i = 0; i + 8 <= nvals; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(vals + i));
+		/* (x >> 1) ^ -(x & 1) */
+		x = _mm256_xor_si256(_mm256_srli_epi32(x, 1), _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(x, one)));
+		_mm256_storeu_si256((__m256i *)(vals + i), x);
+	}
+	for(; i < nvals; i++)
+		vals[i] = (int)((uint32_t)vals[i] >> 1) ^ -(int)(vals[i] & 1);
+}
+
+FLAC__SSE_TARGET("avx2,bmi2")
+FLAC__bool FLAC__bitreader_read_rice_signed_block_avx2(FLAC__BitReader *br, int vals[], uint32_t nvals, uint32_t parameter)
+#undef ZIGZAG_BLOCK
+#undef READ_RICE_SIGNED_BLOCK
+#define ZIGZAG_BLOCK(vals, n) zigzag_block_avx2_(vals, n)
+#define READ_RICE_SIGNED_BLOCK FLAC__bitreader_read_rice_signed_block_bmi2
+#include "deduplication/bitreader_read_rice_signed_block_window.c"
+#endif
+
+#if defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN
+static inline void zigzag_block_neon_(int vals[], uint32_t nvals)
+{
+	const uint32x4_t one = vdupq_n_u32(1);
+	uint32_t i;
+
+	for(i = 0; i + 4 <= nvals; i += 4) {
+		uint32x4_t x = vld1q_u32((const uint32_t *)(vals + i));
+		/* (x >> 1) ^ -(x & 1) */
+		x = veorq_u32(vshrq_n_u32(x, 1), vreinterpretq_u32_s32(vnegq_s32(vreinterpretq_s32_u32(vandq_u32(x, one)))));
+		vst1q_u32((uint32_t *)(vals + i), x);
+	}
+	for(; i < nvals; i++)
+		vals[i] = (int)((uint32_t)vals[i] >> 1) ^ -(int)(vals[i] & 1);
+}
+
+FLAC__bool FLAC__bitreader_read_rice_signed_block_neon(FLAC__BitReader *br, int vals[], uint32_t nvals, uint32_t parameter)
+#undef ZIGZAG_BLOCK
+#undef READ_RICE_SIGNED_BLOCK
+#define ZIGZAG_BLOCK(vals, n) zigzag_block_neon_(vals, n)
+#define READ_RICE_SIGNED_BLOCK FLAC__bitreader_read_rice_signed_block
+#include "deduplication/bitreader_read_rice_signed_block_window.c"
+#endif
+#endif /* ENABLE_64_BIT_WORDS */
+
 #if 0 /* UNUSED */
 FLAC__bool FLAC__bitreader_read_golomb_signed(FLAC__BitReader *br, int *val, uint32_t parameter)
 {
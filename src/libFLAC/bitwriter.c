@@ -46,6 +46,10 @@
 #include "share/compat.h"
 #include "share/endswap.h"
 
+#if ENABLE_64_BIT_WORDS && defined FLAC__AVX2_SUPPORTED
+#include <immintrin.h> /* AVX2 */
+#endif
+
 /* Things should be fastest when this matches the machine word size */
 /* WATCHOUT: if you change this you must also change the following #defines down to SWAP_BE_WORD_TO_HOST below to match */
 /* WATCHOUT: there are a few places where the code will not work unless bwword is >= 32 bits wide */
@@ -101,8 +105,23 @@ struct FLAC__BitWriter {
 	uint32_t capacity; /* capacity of buffer in words */
 	uint32_t words; /* # of complete words in buffer */
 	uint32_t bits; /* # of used bits in accum */
+	const FLAC__CRC16Functions *crc16_functions;
+	uint32_t crc16_words; /* # of words at the front of buffer that are already in crc16 */
+	FLAC__uint16 crc16; /* the running CRC of the first crc16_words words */
 };
 
+/* Complete words are run through the CRC while writing residuals once at
+ * least this many have piled up, while they are still in cache and in
+ * pieces large enough for the CRC kernels to work with */
+#define FLAC__BITWRITER_CRC16_CHUNK (1024u / FLAC__BYTES_PER_WORD)
+
+static inline void crc16_update_(FLAC__BitWriter *bw)
+{
+	FLAC__ASSERT(bw->crc16_words <= bw->words);
+	bw->crc16 = bw->crc16_functions->update((const FLAC__byte *)(bw->buffer + bw->crc16_words), FLAC__BYTES_PER_WORD * (bw->words - bw->crc16_words), bw->crc16);
+	bw->crc16_words = bw->words;
+}
+
 /* * WATCHOUT: The current implementation only grows the buffer. */
 #ifndef __SUNPRO_C
 static
@@ -183,6 +202,9 @@ FLAC__bool FLAC__bitwriter_init(FLAC__BitWriter *bw)
 	FLAC__ASSERT(0 != bw);
 
 	bw->words = bw->bits = 0;
+	bw->crc16_words = 0;
+	bw->crc16 = 0;
+	bw->crc16_functions = &FLAC__crc16_functions;
 	bw->capacity = FLAC__BITWRITER_DEFAULT_CAPACITY;
 	bw->buffer = malloc(sizeof(bwword) * bw->capacity);
 	if(bw->buffer == 0)
@@ -200,11 +222,23 @@ void FLAC__bitwriter_free(FLAC__BitWriter *bw)
 	bw->buffer = 0;
 	bw->capacity = 0;
 	bw->words = bw->bits = 0;
+	bw->crc16_words = 0;
+	bw->crc16 = 0;
 }
 
 void FLAC__bitwriter_clear(FLAC__BitWriter *bw)
 {
 	bw->words = bw->bits = 0;
+	bw->crc16_words = 0;
+	bw->crc16 = 0;
+}
+
+void FLAC__bitwriter_set_crc16_functions(FLAC__BitWriter *bw, const FLAC__CRC16Functions *functions)
+{
+	FLAC__ASSERT(0 != bw);
+	FLAC__ASSERT(0 != functions);
+
+	bw->crc16_functions = functions;
 }
 
 FLAC__bool FLAC__bitwriter_get_write_crc16(FLAC__BitWriter *bw, FLAC__uint16 *crc)
@@ -217,7 +251,8 @@ FLAC__bool FLAC__bitwriter_get_write_crc16(FLAC__BitWriter *bw, FLAC__uint16 *cr
 	if(!FLAC__bitwriter_get_buffer(bw, &buffer, &bytes))
 		return false;
 
-	*crc = (FLAC__uint16)FLAC__crc16(buffer, bytes);
+	/* only what was written since the last update of the running CRC is left */
+	*crc = bw->crc16_functions->update(buffer + FLAC__BYTES_PER_WORD * bw->crc16_words, (uint32_t)(bytes - FLAC__BYTES_PER_WORD * bw->crc16_words), bw->crc16);
 	FLAC__bitwriter_release_buffer(bw);
 	return true;
 }
@@ -275,6 +310,33 @@ void FLAC__bitwriter_release_buffer(FLAC__BitWriter *bw)
 	(void)bw;
 }
 
+FLAC__bool FLAC__bitwriter_exchange_buffer(FLAC__BitWriter *bw, void **buffer, size_t *capacity)
+{
+	bwword *new_buffer = *buffer;
+	uint32_t new_capacity = (uint32_t)(*capacity / sizeof(bwword));
+
+	FLAC__ASSERT(0 != bw);
+	FLAC__ASSERT(0 != bw->buffer);
+
+	if(new_buffer == 0 || new_capacity == 0) {
+		new_capacity = FLAC__BITWRITER_DEFAULT_CAPACITY;
+		new_buffer = malloc(sizeof(bwword) * new_capacity);
+		if(new_buffer == 0)
+			return false;
+		if(*buffer != 0)
+			free(*buffer);
+	}
+
+	*buffer = bw->buffer;
+	*capacity = sizeof(bwword) * bw->capacity;
+	bw->buffer = new_buffer;
+	bw->capacity = new_capacity;
+	bw->words = bw->bits = 0;
+	bw->crc16_words = 0;
+	bw->crc16 = 0;
+	return true;
+}
+
 FLAC__bool FLAC__bitwriter_write_zeroes(FLAC__BitWriter *bw, uint32_t bits)
 {
 	uint32_t n;
@@ -701,10 +763,108 @@ FLAC__bool FLAC__bitwriter_write_rice_signed_block(FLAC__BitWriter *bw, const FL
 	}
 #endif
 
+	if(bw->words - bw->crc16_words >= FLAC__BITWRITER_CRC16_CHUNK)
+		crc16_update_(bw);
 
 	return true;
 }
 
+#if ENABLE_64_BIT_WORDS && defined FLAC__AVX2_SUPPORTED
+/* Takes eight residuals at a time: they are folded to unsigned and their
+ * codes and lengths computed in one go, then each code is joined with the
+ * next one, which gives four codes of at most 64 bits to append to the
+ * accumulator instead of eight. Groups that hold a code longer than 32
+ * bits, which can happen with large escapes of the unary part, and the
+ * last few residuals of the block are left to the plain version */
+FLAC__SSE_TARGET("avx2")
+FLAC__bool FLAC__bitwriter_write_rice_signed_block_avx2(FLAC__BitWriter *bw, const FLAC__int32 *vals, uint32_t nvals, uint32_t parameter)
+{
+	const __m256i mask1 = _mm256_set1_epi32((int)((FLAC__uint32)0xffffffff << parameter)); /* stop bit and above */
+	const __m256i mask2 = _mm256_set1_epi32((int)((FLAC__uint32)0xffffffff >> (31-parameter))); /* stop bit and below */
+	const __m256i lsbits = _mm256_set1_epi32((int)parameter + 1);
+	const __m256i max_msbits = _mm256_set1_epi32(31 - (int)parameter); /* so that a code fits 32 bits */
+	const __m256i low_half = _mm256_set_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+	const __m128i shift = _mm_cvtsi32_si128((int)parameter);
+	FLAC__uint64 accum, codes[4], lengths[4];
+	uint32_t bits, i;
+
+	FLAC__ASSERT(0 != bw);
+	FLAC__ASSERT(0 != bw->buffer);
+	FLAC__ASSERT(parameter < 31);
+	FLAC__ASSERT(bw->bits <= FLAC__BITS_PER_WORD);
+
+	/* a group of eight takes at most 8 * 32 bits, that is four words */
+	if(bw->capacity <= bw->words + nvals / 2 + 1 && !bitwriter_grow_(bw, nvals * 32 + FLAC__BITS_PER_WORD))
+		return false;
+
+	accum = bw->accum;
+	bits = bw->bits;
+	while(nvals >= 8) {
+		__m256i uval, msbits, code, length;
+
+		/* the plain version can leave the accumulator full */
+		if(bits == FLAC__BITS_PER_WORD) {
+			bw->buffer[bw->words++] = SWAP_BE_WORD_TO_HOST(accum);
+			bits = 0;
+		}
+
+		/* fold signed to unsigned, see the plain version */
+		uval = _mm256_loadu_si256((const __m256i*)vals);
+		uval = _mm256_xor_si256(_mm256_slli_epi32(uval, 1), _mm256_srai_epi32(uval, 31));
+		msbits = _mm256_srl_epi32(uval, shift);
+
+		if(_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_min_epu32(msbits, max_msbits), msbits)) != -1) {
+			bw->accum = accum;
+			bw->bits = bits;
+			if(!FLAC__bitwriter_write_rice_signed_block(bw, vals, 8, parameter))
+				return false;
+			/* that may have used more than its share of the space */
+			if(bw->capacity <= bw->words + nvals / 2 + 1 && !bitwriter_grow_(bw, nvals * 32 + FLAC__BITS_PER_WORD))
+				return false;
+			accum = bw->accum;
+			bits = bw->bits;
+		}
+		else {
+			code = _mm256_and_si256(_mm256_or_si256(uval, mask1), mask2);
+			length = _mm256_add_epi32(msbits, lsbits);
+
+			/* join the code of each even residual with the one of the odd
+			 * residual after it, which sits in the upper half of the lane */
+			code = _mm256_or_si256(_mm256_sllv_epi64(_mm256_and_si256(code, low_half), _mm256_srli_epi64(length, 32)), _mm256_srli_epi64(code, 32));
+			length = _mm256_add_epi64(_mm256_and_si256(length, low_half), _mm256_srli_epi64(length, 32));
+			_mm256_storeu_si256((__m256i*)codes, code);
+			_mm256_storeu_si256((__m256i*)lengths, length);
+
+			for(i = 0; i < 4; i++) {
+				if(bits + lengths[i] < FLAC__BITS_PER_WORD) {
+					accum = (accum << lengths[i]) | codes[i];
+					bits += (uint32_t)lengths[i];
+				}
+				else {
+					/* the word is complete, the rest of the code stays behind */
+					const uint32_t left = bits + (uint32_t)lengths[i] - FLAC__BITS_PER_WORD;
+					bw->buffer[bw->words++] = SWAP_BE_WORD_TO_HOST((accum << (FLAC__BITS_PER_WORD - 1 - bits) << 1) | (codes[i] >> left));
+					accum = codes[i] & (((FLAC__uint64)1 << left) - 1);
+					bits = left;
+				}
+			}
+		}
+		vals += 8;
+		nvals -= 8;
+	}
+	bw->accum = accum;
+	bw->bits = bits;
+
+	if(nvals > 0)
+		return FLAC__bitwriter_write_rice_signed_block(bw, vals, nvals, parameter);
+
+	if(bw->words - bw->crc16_words >= FLAC__BITWRITER_CRC16_CHUNK)
+		crc16_update_(bw);
+
+	return true;
+}
+#endif
+
 #if 0 /* UNUSED */
 FLAC__bool FLAC__bitwriter_write_golomb_signed(FLAC__BitWriter *bw, int val, uint32_t parameter)
 {
@@ -375,8 +375,11 @@ FLAC__uint8 FLAC__crc8(const FLAC__byte *data, uint32_t len)
 
 FLAC__uint16 FLAC__crc16(const FLAC__byte *data, uint32_t len)
 {
-	FLAC__uint16 crc = 0;
+	return FLAC__crc16_update(data, len, 0);
+}
 
+FLAC__uint16 FLAC__crc16_update(const FLAC__byte *data, uint32_t len, FLAC__uint16 crc)
+{
 	while(len >= 8){
 		crc ^= data[0] << 8 | data[1];
 
@@ -434,3 +437,9 @@ FLAC__uint16 FLAC__crc16_update_words64(const FLAC__uint64 *words, uint32_t len,
 
 	return crc;
 }
+
+const FLAC__CRC16Functions FLAC__crc16_functions = {
+	FLAC__crc16_update,
+	FLAC__crc16_update_words32,
+	FLAC__crc16_update_words64
+};
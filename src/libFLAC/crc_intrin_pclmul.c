@@ -0,0 +1,179 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2026  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "private/cpu.h"
+
+#ifndef FLAC__NO_ASM
+#if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
+#include "private/crc.h"
+#ifdef FLAC__PCLMUL_SUPPORTED
+
+#include "FLAC/assert.h"
+#include <tmmintrin.h> /* SSSE3 */
+#include <wmmintrin.h> /* PCLMUL */
+
+/*
+ * CRC-16 by folding, see "Fast CRC Computation for Generic Polynomials
+ * Using PCLMULQDQ Instruction" (Intel, 2009).  The data is taken 128 bits
+ * at a time as a big-endian number.  A 128-bit remainder X that is
+ * followed by another n bits of data is congruent to X * x^n modulo the
+ * polynomial, and that can be replaced by a 64x16 bit carry-less
+ * multiplication of each half of X, which is then XORed into the block n
+ * bits further on.  Four remainders are folded 512 bits ahead at a time
+ * to keep the multiplier busy, then folded into one.  What is left at the
+ * end, the last remainder and any data that does not fill a block, is
+ * run through the tables.  The initial CRC is XORed into the top of the
+ * first block, which is what the table versions do as well.
+ */
+
+/* x^n mod P(x) for P(x) = x^16 + x^15 + x^2 + 1, for the high and the low
+ * half of a remainder folded n = 128 or 512 bits ahead */
+#define K128_HI 0x1666 /* x^192 */
+#define K128_LO 0x0106 /* x^128 */
+#define K512_HI 0x1446 /* x^576 */
+#define K512_LO 0x8107 /* x^512 */
+
+typedef enum { LOAD_BYTES, LOAD_WORDS32, LOAD_WORDS64 } load_type_;
+
+/* Loads 16 bytes of the stream as a 128-bit big-endian number. Byte
+ * buffers are in stream order, while the words of the bitreader hold
+ * the stream big-endian in host order already */
+FLAC__SSE_TARGET("pclmul,ssse3")
+static inline __m128i load_(const void *data, load_type_ type)
+{
+	__m128i x = _mm_loadu_si128((const __m128i*)data);
+	switch(type) {
+		case LOAD_BYTES:
+			return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+		case LOAD_WORDS32:
+			return _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 1, 2, 3));
+		default:
+			return _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2));
+	}
+}
+
+FLAC__SSE_TARGET("pclmul,ssse3")
+static inline __m128i fold_(__m128i x, __m128i k, __m128i data)
+{
+	return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11), _mm_clmulepi64_si128(x, k, 0x00)), data);
+}
+
+/* Folds 'blocks' blocks of 16 bytes, at least 4, into a CRC. The
+ * constants are set with 32-bit lanes, as _mm_set_epi64x() is not
+ * available on all 32-bit compilers */
+FLAC__SSE_TARGET("pclmul,ssse3")
+static inline FLAC__uint16 crc16_blocks_(const FLAC__byte *data, uint32_t blocks, FLAC__uint16 crc, load_type_ type)
+{
+	const __m128i k128 = _mm_set_epi32(0, K128_HI, 0, K128_LO);
+	const __m128i k512 = _mm_set_epi32(0, K512_HI, 0, K512_LO);
+	__m128i x0, x1, x2, x3;
+	FLAC__uint64 remainder[2];
+
+	FLAC__ASSERT(blocks >= 4);
+
+	x0 = _mm_xor_si128(load_(data, type), _mm_set_epi32((int)((FLAC__uint32)crc << 16), 0, 0, 0));
+	x1 = load_(data + 16, type);
+	x2 = load_(data + 32, type);
+	x3 = load_(data + 48, type);
+	data += 64;
+	blocks -= 4;
+
+	for( ; blocks >= 4; blocks -= 4, data += 64) {
+		x0 = fold_(x0, k512, load_(data, type));
+		x1 = fold_(x1, k512, load_(data + 16, type));
+		x2 = fold_(x2, k512, load_(data + 32, type));
+		x3 = fold_(x3, k512, load_(data + 48, type));
+	}
+
+	x1 = fold_(x0, k128, x1);
+	x2 = fold_(x1, k128, x2);
+	x3 = fold_(x2, k128, x3);
+
+	for( ; blocks > 0; blocks--, data += 16)
+		x3 = fold_(x3, k128, load_(data, type));
+
+	/* the CRC of the remainder, high half first, with an initial CRC of 0 */
+	_mm_storeu_si128((__m128i*)remainder, x3);
+	crc = FLAC__crc16_update_words64(remainder + 1, 1, 0);
+	return FLAC__crc16_update_words64(remainder, 1, crc);
+}
+
+FLAC__SSE_TARGET("pclmul,ssse3")
+FLAC__uint16 FLAC__crc16_update_intrin_pclmul(const FLAC__byte *data, uint32_t len, FLAC__uint16 crc)
+{
+	if(len >= 64) {
+		crc = crc16_blocks_(data, len / 16, crc, LOAD_BYTES);
+		data += len & ~15u;
+		len &= 15;
+	}
+
+	while(len--)
+		crc = (crc<<8) ^ FLAC__crc16_table[0][(crc>>8) ^ *data++];
+
+	return crc;
+}
+
+FLAC__SSE_TARGET("pclmul,ssse3")
+FLAC__uint16 FLAC__crc16_update_words32_intrin_pclmul(const FLAC__uint32 *words, uint32_t len, FLAC__uint16 crc)
+{
+	if(len >= 16) {
+		crc = crc16_blocks_((const FLAC__byte*)words, len / 4, crc, LOAD_WORDS32);
+		words += len & ~3u;
+		len &= 3;
+	}
+	return FLAC__crc16_update_words32(words, len, crc);
+}
+
+FLAC__SSE_TARGET("pclmul,ssse3")
+FLAC__uint16 FLAC__crc16_update_words64_intrin_pclmul(const FLAC__uint64 *words, uint32_t len, FLAC__uint16 crc)
+{
+	if(len >= 8) {
+		crc = crc16_blocks_((const FLAC__byte*)words, len / 2, crc, LOAD_WORDS64);
+		words += len & ~1u;
+		len &= 1;
+	}
+	return FLAC__crc16_update_words64(words, len, crc);
+}
+
+const FLAC__CRC16Functions FLAC__crc16_functions_intrin_pclmul = {
+	FLAC__crc16_update_intrin_pclmul,
+	FLAC__crc16_update_words32_intrin_pclmul,
+	FLAC__crc16_update_words64_intrin_pclmul
+};
+
+#endif /* FLAC__PCLMUL_SUPPORTED */
+#endif /* (FLAC__CPU_IA32 || FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN */
+#endif /* FLAC__NO_ASM */
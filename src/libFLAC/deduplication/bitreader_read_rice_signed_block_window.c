@@ -0,0 +1,89 @@
+/* This code is imported several times in bitreader.c with different
+ * definitions of ZIGZAG_BLOCK(vals, n), which converts n folded residuals
+ * to signed values in place, and READ_RICE_SIGNED_BLOCK, the routine that
+ * handles everything this one does not. It needs 64-bit brwords.
+ *
+ * The unary parts cannot be located in parallel, as the binary parts may
+ * contain set bits as well. Instead, a 64-bit window is assembled at the
+ * current bit position and a fixed number of residuals is extracted from
+ * it, so there is no branch on word boundaries, which are unpredictable.
+ * The folded values are converted to signed values afterwards with vector
+ * instructions. Windows only pay off when several residuals fit in one,
+ * so larger parameters, long unary parts and the tail of the buffer are
+ * left to READ_RICE_SIGNED_BLOCK */
+{
+	uint32_t cwords, words, bitpos, msbs, n, per;
+	brword w;
+	int *val, *run, *end;
+
+	FLAC__ASSERT(0 != br);
+	FLAC__ASSERT(0 != br->buffer);
+	FLAC__ASSERT(FLAC__BITS_PER_WORD == 64);
+	FLAC__ASSERT(parameter < 32);
+
+	if(parameter == 0 || parameter > 10)
+		return READ_RICE_SIGNED_BLOCK(br, vals, nvals, parameter);
+
+	/* residuals per window; with parameter <= 10, msbs within a window
+	 * never exceed the limit for residuals bounded to int32_t */
+	per = parameter <= 9 ? 4 : 3;
+
+	val = vals;
+	end = vals + nvals;
+
+	while(val < end) {
+		cwords = br->consumed_words;
+		words = br->words;
+		run = val;
+
+		if(cwords + 2 < words) {
+			const brword *buffer = br->buffer;
+			brword cur = buffer[cwords], next = buffer[cwords + 1], mask;
+			bitpos = br->consumed_bits;
+
+			while(val + per <= end && cwords + 2 < words) {
+				/* loaded ahead, so the load is not in the dependency chain of the bit position */
+				const brword next2 = buffer[cwords + 2];
+				uint32_t i, used = 0;
+				/* the 64 bits starting at bitpos; the double shift avoids shifting by 64 */
+				w = (cur << bitpos) | ((next >> 1) >> (FLAC__BITS_PER_WORD - 1 - bitpos));
+				for(i = 0; i < per; i++) {
+					msbs = COUNT_ZERO_MSBS2(w);
+					n = msbs + 1 + parameter;
+					if(used + n > FLAC__BITS_PER_WORD)
+						break;
+					/* skip msbs and stop bit, the binary part is then in the top bits */
+					w <<= msbs;
+					val[i] = (int)((msbs << parameter) | (FLAC__uint32)((w << 1) >> (FLAC__BITS_PER_WORD - parameter)));
+					w <<= parameter + 1;
+					used += n;
+				}
+				val += i;
+				bitpos += used;
+				/* advance to the next word without a branch */
+				mask = (brword)0 - (brword)(bitpos / FLAC__BITS_PER_WORD);
+				cwords += bitpos / FLAC__BITS_PER_WORD;
+				bitpos %= FLAC__BITS_PER_WORD;
+				cur = (cur & ~mask) | (next & mask);
+				next = (next & ~mask) | (next2 & mask);
+				if(i < per)
+					break;
+			}
+
+			br->consumed_words = cwords;
+			br->consumed_bits = bitpos;
+			ZIGZAG_BLOCK(run, (uint32_t)(val - run));
+		}
+
+		if(val < end) {
+			/* a single residual here, then try windows again; with the
+			 * buffer nearly drained, READ_RICE_SIGNED_BLOCK does the rest */
+			n = (cwords + 2 < words && val + per <= end) ? 1 : (uint32_t)(end - val);
+			if(!READ_RICE_SIGNED_BLOCK(br, val, n, parameter))
+				return false;
+			val += n;
+		}
+	}
+
+	return true;
+}
@@ -36,7 +36,6 @@
 
 #include "private/cpu.h"
 
-#ifndef FLAC__INTEGER_ONLY_LIBRARY
 #ifndef FLAC__NO_ASM
 #if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
 #include "private/fixed.h"
@@ -48,6 +47,8 @@
 #include "share/compat.h"
 #include "FLAC/assert.h"
 
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+
 #ifdef local_abs
 #undef local_abs
 #endif
@@ -337,7 +338,97 @@ uint32_t FLAC__fixed_compute_best_predictor_limit_residual_intrin_avx2(const FLA
 	return order;
 }
 
+#endif /* !FLAC__INTEGER_ONLY_LIBRARY */
+
+/* See the comment with FLAC__fixed_restore_signal_intrin_sse2(), this does
+ * the same 8 samples at a time */
+
+#define RESTORE_PARTIAL_SUM(ymm, carry) \
+	ymm = _mm256_add_epi32(ymm, _mm256_slli_si256(ymm, 4)); \
+	ymm = _mm256_add_epi32(ymm, _mm256_slli_si256(ymm, 8)); \
+	ymm = _mm256_add_epi32(ymm, _mm256_permute2x128_si256(_mm256_shuffle_epi32(ymm, _MM_SHUFFLE(3,3,3,3)), _mm256_shuffle_epi32(ymm, _MM_SHUFFLE(3,3,3,3)), 0x08)); \
+	ymm = _mm256_add_epi32(ymm, carry); \
+	carry = _mm256_permutevar8x32_epi32(ymm, last);
+
+FLAC__SSE_TARGET("avx2")
+static inline void restore_signal_avx2_(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[],
+	void (*restore_signal_scalar)(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[]))
+{
+	int i = 0;
+	FLAC__uint32 x1, x2, x3, x4;
+	const __m256i last = _mm256_set1_epi32(7);
+	__m256i ymm, carry0, carry1, carry2, carry3;
+
+	if(order == 0 || data_len < 8) {
+		restore_signal_scalar(residual, data_len, order, data);
+		return;
+	}
+
+	/* last warmup sample and its differences of order 1 to 3 */
+	x1 = data[-1];
+	x2 = order > 1 ? (FLAC__uint32)data[-2] : 0;
+	x3 = order > 2 ? (FLAC__uint32)data[-3] : 0;
+	x4 = order > 3 ? (FLAC__uint32)data[-4] : 0;
+	carry0 = _mm256_set1_epi32(x1);
+	carry1 = _mm256_set1_epi32(x1 - x2);
+	carry2 = _mm256_set1_epi32(x1 - 2*x2 + x3);
+	carry3 = _mm256_set1_epi32(x1 - 3*x2 + 3*x3 - x4);
+
+	switch(order) {
+		case 1:
+			for(; i + 8 <= (int)data_len; i += 8) {
+				ymm = _mm256_loadu_si256((const __m256i*)(residual+i));
+				RESTORE_PARTIAL_SUM(ymm, carry0)
+				_mm256_storeu_si256((__m256i*)(data+i), ymm);
+			}
+			break;
+		case 2:
+			for(; i + 8 <= (int)data_len; i += 8) {
+				ymm = _mm256_loadu_si256((const __m256i*)(residual+i));
+				RESTORE_PARTIAL_SUM(ymm, carry1)
+				RESTORE_PARTIAL_SUM(ymm, carry0)
+				_mm256_storeu_si256((__m256i*)(data+i), ymm);
+			}
+			break;
+		case 3:
+			for(; i + 8 <= (int)data_len; i += 8) {
+				ymm = _mm256_loadu_si256((const __m256i*)(residual+i));
+				RESTORE_PARTIAL_SUM(ymm, carry2)
+				RESTORE_PARTIAL_SUM(ymm, carry1)
+				RESTORE_PARTIAL_SUM(ymm, carry0)
+				_mm256_storeu_si256((__m256i*)(data+i), ymm);
+			}
+			break;
+		case 4:
+			for(; i + 8 <= (int)data_len; i += 8) {
+				ymm = _mm256_loadu_si256((const __m256i*)(residual+i));
+				RESTORE_PARTIAL_SUM(ymm, carry3)
+				RESTORE_PARTIAL_SUM(ymm, carry2)
+				RESTORE_PARTIAL_SUM(ymm, carry1)
+				RESTORE_PARTIAL_SUM(ymm, carry0)
+				_mm256_storeu_si256((__m256i*)(data+i), ymm);
+			}
+			break;
+		default:
+			FLAC__ASSERT(0);
+	}
+	_mm256_zeroupper();
+	if(i < (int)data_len)
+		restore_signal_scalar(residual+i, data_len-i, order, data+i);
+}
+
+FLAC__SSE_TARGET("avx2")
+void FLAC__fixed_restore_signal_intrin_avx2(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[])
+{
+	restore_signal_avx2_(residual, data_len, order, data, FLAC__fixed_restore_signal);
+}
+
+FLAC__SSE_TARGET("avx2")
+void FLAC__fixed_restore_signal_wide_intrin_avx2(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[])
+{
+	restore_signal_avx2_(residual, data_len, order, data, FLAC__fixed_restore_signal_wide);
+}
+
 #endif /* FLAC__AVX2_SUPPORTED */
 #endif /* (FLAC__CPU_IA32 || FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN */
 #endif /* FLAC__NO_ASM */
-#endif /* FLAC__INTEGER_ONLY_LIBRARY */
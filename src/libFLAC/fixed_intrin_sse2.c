@@ -36,7 +36,6 @@
 
 #include "private/cpu.h"
 
-#ifndef FLAC__INTEGER_ONLY_LIBRARY
 #ifndef FLAC__NO_ASM
 #if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && defined FLAC__HAS_X86INTRIN
 #include "private/fixed.h"
@@ -48,6 +47,8 @@
 #include "share/compat.h"
 #include "FLAC/assert.h"
 
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+
 #ifdef FLAC__CPU_IA32
 #define m128i_to_i64(dest, src) _mm_storel_epi64((__m128i*)&dest, src)
 #else
@@ -188,7 +189,98 @@ uint32_t FLAC__fixed_compute_best_predictor_intrin_sse2(const FLAC__int32 data[]
 	return order;
 }
 
+#endif /* !FLAC__INTEGER_ONLY_LIBRARY */
+
+/* A fixed predictor of order N restores the signal by summing the residual
+ * N times, so this is done with running sums, 4 samples at a time. As the
+ * sums wrap the same way the scalar code does, this can replace both
+ * FLAC__fixed_restore_signal() and FLAC__fixed_restore_signal_wide(); the
+ * samples not done with vectors are left to the one that is replaced, so
+ * the wide version doesn't overflow signed integers in its intermediates */
+
+#define RESTORE_PARTIAL_SUM(xmm, carry) \
+	xmm = _mm_add_epi32(xmm, _mm_slli_si128(xmm, 4)); \
+	xmm = _mm_add_epi32(xmm, _mm_slli_si128(xmm, 8)); \
+	xmm = _mm_add_epi32(xmm, carry); \
+	carry = _mm_shuffle_epi32(xmm, _MM_SHUFFLE(3,3,3,3));
+
+FLAC__SSE_TARGET("sse2")
+static inline void restore_signal_sse2_(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[],
+	void (*restore_signal_scalar)(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[]))
+{
+	int i = 0;
+	FLAC__uint32 x1, x2, x3, x4;
+	__m128i xmm, carry0, carry1, carry2, carry3;
+
+	if(order == 0 || data_len < 4) {
+		restore_signal_scalar(residual, data_len, order, data);
+		return;
+	}
+
+	/* last warmup sample and its differences of order 1 to 3 */
+	x1 = data[-1];
+	x2 = order > 1 ? (FLAC__uint32)data[-2] : 0;
+	x3 = order > 2 ? (FLAC__uint32)data[-3] : 0;
+	x4 = order > 3 ? (FLAC__uint32)data[-4] : 0;
+	carry0 = _mm_set1_epi32(x1);
+	carry1 = _mm_set1_epi32(x1 - x2);
+	carry2 = _mm_set1_epi32(x1 - 2*x2 + x3);
+	carry3 = _mm_set1_epi32(x1 - 3*x2 + 3*x3 - x4);
+
+	switch(order) {
+		case 1:
+			for(; i + 4 <= (int)data_len; i += 4) {
+				xmm = _mm_loadu_si128((const __m128i*)(residual+i));
+				RESTORE_PARTIAL_SUM(xmm, carry0)
+				_mm_storeu_si128((__m128i*)(data+i), xmm);
+			}
+			break;
+		case 2:
+			for(; i + 4 <= (int)data_len; i += 4) {
+				xmm = _mm_loadu_si128((const __m128i*)(residual+i));
+				RESTORE_PARTIAL_SUM(xmm, carry1)
+				RESTORE_PARTIAL_SUM(xmm, carry0)
+				_mm_storeu_si128((__m128i*)(data+i), xmm);
+			}
+			break;
+		case 3:
+			for(; i + 4 <= (int)data_len; i += 4) {
+				xmm = _mm_loadu_si128((const __m128i*)(residual+i));
+				RESTORE_PARTIAL_SUM(xmm, carry2)
+				RESTORE_PARTIAL_SUM(xmm, carry1)
+				RESTORE_PARTIAL_SUM(xmm, carry0)
+				_mm_storeu_si128((__m128i*)(data+i), xmm);
+			}
+			break;
+		case 4:
+			for(; i + 4 <= (int)data_len; i += 4) {
+				xmm = _mm_loadu_si128((const __m128i*)(residual+i));
+				RESTORE_PARTIAL_SUM(xmm, carry3)
+				RESTORE_PARTIAL_SUM(xmm, carry2)
+				RESTORE_PARTIAL_SUM(xmm, carry1)
+				RESTORE_PARTIAL_SUM(xmm, carry0)
+				_mm_storeu_si128((__m128i*)(data+i), xmm);
+			}
+			break;
+		default:
+			FLAC__ASSERT(0);
+	}
+	if(i < (int)data_len)
+		restore_signal_scalar(residual+i, data_len-i, order, data+i);
+}
+
+FLAC__SSE_TARGET("sse2")
+void FLAC__fixed_restore_signal_intrin_sse2(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[])
+{
+	restore_signal_sse2_(residual, data_len, order, data, FLAC__fixed_restore_signal);
+}
+
+FLAC__SSE_TARGET("sse2")
+void FLAC__fixed_restore_signal_wide_intrin_sse2(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[])
+{
+	restore_signal_sse2_(residual, data_len, order, data, FLAC__fixed_restore_signal_wide);
+}
+
 #endif /* FLAC__SSE2_SUPPORTED */
 #endif /* (FLAC__CPU_IA32 || FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN */
 #endif /* FLAC__NO_ASM */
-#endif /* FLAC__INTEGER_ONLY_LIBRARY */
@@ -36,6 +36,7 @@
 #include <stdio.h> /* for FILE */
 #include "FLAC/ordinals.h"
 #include "cpu.h"
+#include "crc.h"
 
 /*
  * opaque structure definition
@@ -59,6 +60,7 @@ FLAC__bool FLAC__bitreader_rewind_to_after_last_seen_framesync(FLAC__BitReader *
 /*
  * CRC functions
  */
+void FLAC__bitreader_set_crc16_functions(FLAC__BitReader *br, const FLAC__CRC16Functions *functions);
 void FLAC__bitreader_reset_read_crc16(FLAC__BitReader *br, FLAC__uint16 seed);
 FLAC__uint16 FLAC__bitreader_get_read_crc16(FLAC__BitReader *br);
 
@@ -91,6 +93,14 @@ FLAC__bool FLAC__bitreader_read_rice_signed_block(FLAC__BitReader *br, int vals[
 #ifdef FLAC__BMI2_SUPPORTED
 FLAC__bool FLAC__bitreader_read_rice_signed_block_bmi2(FLAC__BitReader *br, int vals[], uint32_t nvals, uint32_t parameter);
 #endif
+#if ENABLE_64_BIT_WORDS
+#if defined FLAC__AVX2_SUPPORTED && defined FLAC__BMI2_SUPPORTED
+FLAC__bool FLAC__bitreader_read_rice_signed_block_avx2(FLAC__BitReader *br, int vals[], uint32_t nvals, uint32_t parameter);
+#endif
+#if defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN
+FLAC__bool FLAC__bitreader_read_rice_signed_block_neon(FLAC__BitReader *br, int vals[], uint32_t nvals, uint32_t parameter);
+#endif
+#endif
 
 #if 0 /* UNUSED */
 FLAC__bool FLAC__bitreader_read_golomb_signed(FLAC__BitReader *br, int *val, uint32_t parameter);
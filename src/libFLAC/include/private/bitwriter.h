@@ -35,6 +35,8 @@
 
 #include <stdio.h> /* for FILE */
 #include "FLAC/ordinals.h"
+#include "cpu.h"
+#include "crc.h"
 
 /*
  * opaque structure definition
@@ -55,7 +57,11 @@ void FLAC__bitwriter_clear(FLAC__BitWriter *bw);
  * CRC functions
  *
  * non-const *bw because they have to cal FLAC__bitwriter_get_buffer()
+ *
+ * the CRC-16 covers everything since the last clear; most of it is
+ * computed while residuals are written, get_write_crc16() only adds the rest
  */
+void FLAC__bitwriter_set_crc16_functions(FLAC__BitWriter *bw, const FLAC__CRC16Functions *functions);
 FLAC__bool FLAC__bitwriter_get_write_crc16(FLAC__BitWriter *bw, FLAC__uint16 *crc);
 FLAC__bool FLAC__bitwriter_get_write_crc8(FLAC__BitWriter *bw, FLAC__byte *crc);
 
@@ -75,6 +81,16 @@ uint32_t FLAC__bitwriter_get_input_bits_unconsumed(const FLAC__BitWriter *bw); /
 FLAC__bool FLAC__bitwriter_get_buffer(FLAC__BitWriter *bw, const FLAC__byte **buffer, size_t *bytes);
 void FLAC__bitwriter_release_buffer(FLAC__BitWriter *bw);
 
+/*
+ * buffer exchange
+ *
+ * hands the buffer over to the caller, with its capacity in bytes, and
+ * continues empty in the given buffer of *capacity bytes, or in a newly
+ * allocated one if *buffer is NULL.  the caller becomes responsible for
+ * freeing the returned buffer.
+ */
+FLAC__bool FLAC__bitwriter_exchange_buffer(FLAC__BitWriter *bw, void **buffer, size_t *capacity);
+
 /*
  * write functions
  */
@@ -93,6 +109,10 @@ uint32_t FLAC__bitwriter_golomb_bits_unsigned(uint32_t val, uint32_t parameter);
 FLAC__bool FLAC__bitwriter_write_rice_signed(FLAC__BitWriter *bw, FLAC__int32 val, uint32_t parameter);
 #endif
 FLAC__bool FLAC__bitwriter_write_rice_signed_block(FLAC__BitWriter *bw, const FLAC__int32 *vals, uint32_t nvals, uint32_t parameter);
+#if ENABLE_64_BIT_WORDS && defined FLAC__AVX2_SUPPORTED
+FLAC__bool FLAC__bitwriter_write_rice_signed_block_avx2(FLAC__BitWriter *bw, const FLAC__int32 *vals, uint32_t nvals, uint32_t parameter);
+#endif
+typedef FLAC__bool (*FLAC__BitWriterWriteRiceSignedBlock)(FLAC__BitWriter *bw, const FLAC__int32 *vals, uint32_t nvals, uint32_t parameter);
 #if 0 /* UNUSED */
 FLAC__bool FLAC__bitwriter_write_golomb_signed(FLAC__BitWriter *bw, int val, uint32_t parameter);
 FLAC__bool FLAC__bitwriter_write_golomb_unsigned(FLAC__BitWriter *bw, uint32_t val, uint32_t parameter);
@@ -34,6 +34,7 @@
 #define FLAC__PRIVATE__CRC_H
 
 #include "FLAC/ordinals.h"
+#include "private/cpu.h"
 
 /* 8 bit CRC generator, MSB shifted first
 ** polynomial = x^8 + x^2 + x^1 + x^0
@@ -54,7 +55,32 @@ extern FLAC__uint16 const FLAC__crc16_table[8][256];
 #endif
 
 FLAC__uint16 FLAC__crc16(const FLAC__byte *data, uint32_t len);
+FLAC__uint16 FLAC__crc16_update(const FLAC__byte *data, uint32_t len, FLAC__uint16 crc);
 FLAC__uint16 FLAC__crc16_update_words32(const FLAC__uint32 *words, uint32_t len, FLAC__uint16 crc);
 FLAC__uint16 FLAC__crc16_update_words64(const FLAC__uint64 *words, uint32_t len, FLAC__uint16 crc);
 
+/* The CRC-16 routines used by a bitreader or bitwriter, chosen with
+** FLAC__cpu_info() by the decoder or encoder.  The words are in host
+** order and hold the stream big-endian, like those of the bitreader.
+*/
+typedef struct {
+	FLAC__uint16 (*update)(const FLAC__byte *data, uint32_t len, FLAC__uint16 crc);
+	FLAC__uint16 (*update_words32)(const FLAC__uint32 *words, uint32_t len, FLAC__uint16 crc);
+	FLAC__uint16 (*update_words64)(const FLAC__uint64 *words, uint32_t len, FLAC__uint16 crc);
+} FLAC__CRC16Functions;
+
+extern const FLAC__CRC16Functions FLAC__crc16_functions; /* the above */
+
+#ifndef FLAC__NO_ASM
+#  if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
+#    ifdef FLAC__PCLMUL_SUPPORTED
+/* needs PCLMULQDQ and SSSE3 */
+FLAC__uint16 FLAC__crc16_update_intrin_pclmul(const FLAC__byte *data, uint32_t len, FLAC__uint16 crc);
+FLAC__uint16 FLAC__crc16_update_words32_intrin_pclmul(const FLAC__uint32 *words, uint32_t len, FLAC__uint16 crc);
+FLAC__uint16 FLAC__crc16_update_words64_intrin_pclmul(const FLAC__uint64 *words, uint32_t len, FLAC__uint16 crc);
+extern const FLAC__CRC16Functions FLAC__crc16_functions_intrin_pclmul;
+#    endif
+#  endif
+#endif
+
 #endif
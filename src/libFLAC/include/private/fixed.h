@@ -113,5 +113,17 @@ void FLAC__fixed_compute_residual_wide_33bit(const FLAC__int64 data[], uint32_t
 void FLAC__fixed_restore_signal(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[]);
 void FLAC__fixed_restore_signal_wide(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[]);
 void FLAC__fixed_restore_signal_wide_33bit(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int64 data[]);
+#ifndef FLAC__NO_ASM
+# if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
+#  ifdef FLAC__SSE2_SUPPORTED
+void FLAC__fixed_restore_signal_intrin_sse2(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[]);
+void FLAC__fixed_restore_signal_wide_intrin_sse2(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[]);
+#  endif
+#  ifdef FLAC__AVX2_SUPPORTED
+void FLAC__fixed_restore_signal_intrin_avx2(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[]);
+void FLAC__fixed_restore_signal_wide_intrin_avx2(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[]);
+#  endif
+# endif
+#endif
 
 #endif
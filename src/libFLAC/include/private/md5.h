@@ -26,7 +26,9 @@
  * Still in the public domain, with no warranty.
  */
 
+#include <stddef.h> /* for size_t */
 #include "FLAC/ordinals.h"
+#include "private/cpu.h"
 
 typedef union {
 	FLAC__byte *p8;
@@ -34,12 +36,15 @@ typedef union {
 	FLAC__int32 *p32;
 } FLAC__multibyte;
 
+typedef void (*FLAC__MD5FormatInput)(FLAC__multibyte *mbuf, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample);
+
 typedef struct {
 	FLAC__uint32 in[16];
 	FLAC__uint32 buf[4];
 	FLAC__uint32 bytes[2];
 	FLAC__multibyte internal_buf;
 	size_t capacity;
+	FLAC__MD5FormatInput format_input; /* set to FLAC__md5_format_input() by FLAC__MD5Init(), may be overridden afterwards */
 } FLAC__MD5Context;
 
 void FLAC__MD5Init(FLAC__MD5Context *context);
@@ -47,4 +52,33 @@ void FLAC__MD5Final(FLAC__byte digest[16], FLAC__MD5Context *context);
 
 FLAC__bool FLAC__MD5Accumulate(FLAC__MD5Context *ctx, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample);
 
+/*
+ *	FLAC__md5_format_input()
+ *	--------------------------------------------------------------------
+ *	Interleaves the signal and stores it as little-endian samples of
+ *	bytes_per_sample bytes each, which is what is fed to the MD5 sum.
+ *	The intrinsic versions handle the common 16-bit and 24-bit layouts
+ *	and call the plain C version for everything else.
+ *
+ *	OUT mbuf          at least channels*samples*bytes_per_sample bytes
+ *	IN  signal[0,channels-1][0,samples-1]
+ *	IN  channels
+ *	IN  samples
+ *	IN  bytes_per_sample
+ */
+void FLAC__md5_format_input(FLAC__multibyte *mbuf, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample);
+#ifndef FLAC__NO_ASM
+#  if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
+#    ifdef FLAC__SSE2_SUPPORTED
+void FLAC__md5_format_input_intrin_sse2(FLAC__multibyte *mbuf, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample);
+#    endif
+#    ifdef FLAC__AVX2_SUPPORTED
+void FLAC__md5_format_input_intrin_avx2(FLAC__multibyte *mbuf, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample);
+#    endif
+#  endif
+#  if defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN && !WORDS_BIGENDIAN
+void FLAC__md5_format_input_intrin_neon(FLAC__multibyte *mbuf, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample);
+#  endif
+#endif /* FLAC__NO_ASM */
+
 #endif
@@ -0,0 +1,63 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2026  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLAC__PRIVATE__PROFILE_H
+#define FLAC__PRIVATE__PROFILE_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "FLAC/ordinals.h"
+
+#ifdef FLAC__PROFILING
+
+/* Returns a monotonic time in nanoseconds */
+FLAC__uint64 FLAC__profile_nanoseconds(void);
+
+/*
+ * Times a stage of encoding or decoding. The profile is either a
+ * FLAC__StreamEncoderProfile or a FLAC__StreamDecoderProfile. The start
+ * time is subtracted from the counter and the stop time added to it, so
+ * no variable is needed to hold it, but every start must be paired with
+ * a stop. Without FLAC__PROFILING, both expand to nothing.
+ */
+#define FLAC__PROFILE_START(profile, stage) ((profile)->nanoseconds[stage] -= FLAC__profile_nanoseconds())
+#define FLAC__PROFILE_STOP(profile, stage) ((profile)->nanoseconds[stage] += FLAC__profile_nanoseconds(), (profile)->calls[stage]++)
+
+#else
+
+#define FLAC__PROFILE_START(profile, stage) ((void)0)
+#define FLAC__PROFILE_STOP(profile, stage) ((void)0)
+
+#endif
+
+#endif
@@ -50,6 +50,20 @@
 #define FLAC__STREAM_ENCODER_MAX_THREADTASKS 130
 #endif
 
+/*
+ * The number of times a block may be halved when encoding a
+ * variable-blocksize stream
+ */
+#define FLAC__STREAM_ENCODER_MAX_BLOCKSIZE_SPLITS 3
+
+/*
+ * The number of samples per granule for which the autocorrelation of
+ * the unwindowed signal is cached, to be shared by all apodization
+ * windows that are flat over that granule. It must be larger than
+ * FLAC__MAX_LPC_ORDER + 1
+ */
+#define FLAC__STREAM_ENCODER_AUTOC_GRANULE 128
+
 #if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && defined FLAC__HAS_X86INTRIN
 #include "private/cpu.h"
 #include "FLAC/format.h"
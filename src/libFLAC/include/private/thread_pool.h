@@ -0,0 +1,65 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2026  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLAC__PRIVATE__THREAD_POOL_H
+#define FLAC__PRIVATE__THREAD_POOL_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "FLAC/stream_encoder.h"
+#include "share/compat_threads.h"
+
+#ifdef FLAC__USE_THREADS
+
+/*
+ * Something the threads of a pool can work on, in practice an encoder
+ * instance.  work() does one piece of work, like encoding one frame, and
+ * returns false if there was nothing to do.  The structure is owned by the
+ * source; the other members are managed by the pool.
+ */
+typedef struct FLAC__ThreadPoolSource {
+	FLAC__bool (*work)(void *data);
+	void *data;
+	uint32_t busy;        /* the number of threads in work() */
+	FLAC__bool detached;
+	struct FLAC__ThreadPoolSource *next;
+} FLAC__ThreadPoolSource;
+
+void FLAC__thread_pool_attach(FLAC__ThreadPool *pool, FLAC__ThreadPoolSource *source, FLAC__bool (*work)(void *data), void *data);
+void FLAC__thread_pool_detach(FLAC__ThreadPool *pool, FLAC__ThreadPoolSource *source); /* waits until no thread is in work() */
+void FLAC__thread_pool_notify(FLAC__ThreadPool *pool); /* to be called when a source has new work */
+uint32_t FLAC__thread_pool_get_num_threads(const FLAC__ThreadPool *pool);
+
+#endif
+
+#endif
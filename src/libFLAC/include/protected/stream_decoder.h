@@ -47,6 +47,10 @@ typedef struct FLAC__StreamDecoderProtected {
 	uint32_t sample_rate; /* in Hz */
 	uint32_t blocksize; /* in samples (per channel) */
 	FLAC__bool md5_checking; /* if true, generate MD5 signature of decoded data and compare against signature in the STREAMINFO metadata block */
+	uint32_t num_threads;
+	FLAC__bool pull_mode; /* if true, decoded audio is kept for FLAC__stream_decoder_read_samples() instead of being passed to the write callback */
+	FLAC__bool build_frame_index; /* if true, add every frame decoded in sequence to the frame index */
+	uint32_t prefetch_buffers; /* number of buffers the prefetch thread reads a file into, 0 if there is no prefetch thread */
 #if FLAC__HAS_OGG
 	FLAC__OggDecoderAspect ogg_decoder_aspect;
 #endif
@@ -99,6 +99,7 @@ typedef struct FLAC__StreamEncoderProtected {
 	uint32_t bits_per_sample;
 	uint32_t sample_rate;
 	uint32_t blocksize;
+	uint32_t variable_blocksize;
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	uint32_t num_apodizations;
 	FLAC__ApodizationSpecification apodizations[FLAC__MAX_APODIZATION_FUNCTIONS];
@@ -113,6 +114,7 @@ typedef struct FLAC__StreamEncoderProtected {
 	uint32_t rice_parameter_search_dist;
 	FLAC__uint64 total_samples_estimate;
 	FLAC__bool limit_min_bitrate;
+	uint32_t estimate_only;
 	FLAC__StreamMetadata **metadata;
 	uint32_t num_metadata_blocks;
 	uint32_t num_threads;
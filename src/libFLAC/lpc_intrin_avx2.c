@@ -36,7 +36,6 @@
 
 #include "private/cpu.h"
 
-#ifndef FLAC__INTEGER_ONLY_LIBRARY
 #ifndef FLAC__NO_ASM
 #if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
 #include "private/lpc.h"
@@ -47,6 +46,8 @@
 
 #include <immintrin.h> /* AVX2 */
 
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+
 FLAC__SSE_TARGET("avx2")
 void FLAC__lpc_compute_residual_from_qlp_coefficients_16_intrin_avx2(const FLAC__int32 *data, uint32_t data_len, const FLAC__int32 qlp_coeff[], uint32_t order, int lp_quantization, FLAC__int32 residual[])
 {
@@ -1116,7 +1117,132 @@ void FLAC__lpc_compute_residual_from_qlp_coefficients_wide_intrin_avx2(const FLA
 	_mm256_zeroupper();
 }
 
+#endif /* !FLAC__INTEGER_ONLY_LIBRARY */
+
+/* See the comment with FLAC__lpc_restore_signal_intrin_sse41(). Here, two
+ * taps are done per 256-bit multiplication for the 32-bit version, and the
+ * 64-bit version does 4 samples per vector */
+
+#if defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION) && !defined(FUZZING_BUILD_MODE_FLAC_SANITIZE_SIGNED_INTEGER_OVERFLOW)
+/* See FLAC__lpc_restore_signal() */
+__attribute__((no_sanitize("signed-integer-overflow")))
+#endif
+FLAC__SSE_TARGET("avx2")
+void FLAC__lpc_restore_signal_intrin_avx2(const FLAC__int32 residual[], uint32_t data_len, const FLAC__int32 qlp_coeff[], uint32_t order, int lp_quantization, FLAC__int32 data[])
+{
+	int i, j, k, pairs;
+	FLAC__int32 sum, sum_older[4];
+	__m256i q[(FLAC__MAX_LPC_ORDER - 8) / 2];
+	__m128i q_last;
+
+	FLAC__ASSERT(order > 0);
+	FLAC__ASSERT(order <= 32);
+
+	if(order <= 10 || data_len < 4) {
+		FLAC__lpc_restore_signal(residual, data_len, qlp_coeff, order, lp_quantization, data);
+		return;
+	}
+
+	/* taps 8+2j and 9+2j in the low and high lane, and the last tap on its own if the number of taps left is odd */
+	pairs = (order - 8) / 2;
+	for(j = 0; j < pairs; j++)
+		q[j] = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_set1_epi32(qlp_coeff[8+2*j])), _mm_set1_epi32(qlp_coeff[9+2*j]), 1);
+	q_last = _mm_set1_epi32(order & 1 ? qlp_coeff[order-1] : 0);
+
+	for(i = 0; i + 4 <= (int)data_len; i += 4) {
+		__m256i older;
+		__m128i older4;
+		if(order <= 12) {
+			older = _mm256_mullo_epi32(q[0], _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(data+i-9))), _mm_loadu_si128((const __m128i*)(data+i-10)), 1));
+			if(order == 12)
+				older = _mm256_add_epi32(older, _mm256_mullo_epi32(q[1], _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(data+i-11))), _mm_loadu_si128((const __m128i*)(data+i-12)), 1)));
+		}
+		else {
+			older = _mm256_setzero_si256();
+			for(j = 0; j < pairs; j++)
+				older = _mm256_add_epi32(older, _mm256_mullo_epi32(q[j], _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(data+i-9-2*j))), _mm_loadu_si128((const __m128i*)(data+i-10-2*j)), 1)));
+		}
+		older4 = _mm_add_epi32(_mm256_castsi256_si128(older), _mm256_extracti128_si256(older, 1));
+		if(order & 1)
+			older4 = _mm_add_epi32(older4, _mm_mullo_epi32(q_last, _mm_loadu_si128((const __m128i*)(data+i-order))));
+		_mm_storeu_si128((__m128i*)sum_older, older4);
+
+		for(k = 0; k < 4; k++) {
+			const FLAC__int32 *history = data + i + k;
+			sum = sum_older[k];
+			sum += qlp_coeff[7] * history[-8];
+			sum += qlp_coeff[6] * history[-7];
+			sum += qlp_coeff[5] * history[-6];
+			sum += qlp_coeff[4] * history[-5];
+			sum += qlp_coeff[3] * history[-4];
+			sum += qlp_coeff[2] * history[-3];
+			sum += qlp_coeff[1] * history[-2];
+			sum += qlp_coeff[0] * history[-1];
+			data[i+k] = residual[i+k] + (sum >> lp_quantization);
+		}
+	}
+	if(i < (int)data_len)
+		FLAC__lpc_restore_signal(residual+i, data_len-i, qlp_coeff, order, lp_quantization, data+i);
+	_mm256_zeroupper();
+}
+
+#if defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION) && !defined(FUZZING_BUILD_MODE_FLAC_SANITIZE_SIGNED_INTEGER_OVERFLOW)
+/* See FLAC__lpc_restore_signal() */
+__attribute__((no_sanitize("signed-integer-overflow")))
+#endif
+FLAC__SSE_TARGET("avx2")
+void FLAC__lpc_restore_signal_wide_intrin_avx2(const FLAC__int32 residual[], uint32_t data_len, const FLAC__int32 qlp_coeff[], uint32_t order, int lp_quantization, FLAC__int32 data[])
+{
+	int i, j, k;
+	FLAC__int64 sum, sum_older[4];
+	__m256i q[FLAC__MAX_LPC_ORDER - 8];
+
+	FLAC__ASSERT(order > 0);
+	FLAC__ASSERT(order <= 32);
+
+	if(order <= 10 || data_len < 4) {
+		FLAC__lpc_restore_signal_wide(residual, data_len, qlp_coeff, order, lp_quantization, data);
+		return;
+	}
+
+	for(j = 8; j < (int)order; j++)
+		q[j-8] = _mm256_set1_epi32(qlp_coeff[j]);
+
+	for(i = 0; i + 4 <= (int)data_len; i += 4) {
+		__m256i older;
+		if(order <= 12) {
+			older = _mm256_mul_epi32(q[0], _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(data+i-9))));
+			older = _mm256_add_epi64(older, _mm256_mul_epi32(q[1], _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(data+i-10)))));
+			older = _mm256_add_epi64(older, _mm256_mul_epi32(q[2], _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(data+i-11)))));
+			if(order == 12)
+				older = _mm256_add_epi64(older, _mm256_mul_epi32(q[3], _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(data+i-12)))));
+		}
+		else {
+			older = _mm256_setzero_si256();
+			for(j = 8; j < (int)order; j++)
+				older = _mm256_add_epi64(older, _mm256_mul_epi32(q[j-8], _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)(data+i-j-1)))));
+		}
+		_mm256_storeu_si256((__m256i*)sum_older, older);
+
+		for(k = 0; k < 4; k++) {
+			const FLAC__int32 *history = data + i + k;
+			sum = sum_older[k];
+			sum += qlp_coeff[7] * (FLAC__int64)history[-8];
+			sum += qlp_coeff[6] * (FLAC__int64)history[-7];
+			sum += qlp_coeff[5] * (FLAC__int64)history[-6];
+			sum += qlp_coeff[4] * (FLAC__int64)history[-5];
+			sum += qlp_coeff[3] * (FLAC__int64)history[-4];
+			sum += qlp_coeff[2] * (FLAC__int64)history[-3];
+			sum += qlp_coeff[1] * (FLAC__int64)history[-2];
+			sum += qlp_coeff[0] * (FLAC__int64)history[-1];
+			data[i+k] = (FLAC__int32) (residual[i+k] + (sum >> lp_quantization));
+		}
+	}
+	if(i < (int)data_len)
+		FLAC__lpc_restore_signal_wide(residual+i, data_len-i, qlp_coeff, order, lp_quantization, data+i);
+	_mm256_zeroupper();
+}
+
 #endif /* FLAC__AVX2_SUPPORTED */
 #endif /* (FLAC__CPU_IA32 || FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN */
 #endif /* FLAC__NO_ASM */
-#endif /* FLAC__INTEGER_ONLY_LIBRARY */
@@ -32,7 +32,6 @@
 
 #include "private/cpu.h"
 
-#ifndef FLAC__INTEGER_ONLY_LIBRARY
 #ifndef FLAC__NO_ASM
 #if defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN
 #include "private/lpc.h"
@@ -41,6 +40,8 @@
 #include "private/macros.h"
 #include <arm_neon.h>
 
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+
 #if FLAC__HAS_A64NEONINTRIN
 void FLAC__lpc_compute_autocorrelation_intrin_neon_lag_14(const FLAC__real data[], uint32_t data_len, uint32_t lag, double autoc[])
 {
@@ -1268,6 +1269,107 @@ void FLAC__lpc_compute_residual_from_qlp_coefficients_wide_intrin_neon(const FLA
     return;
 }
 
+#endif /* !FLAC__INTEGER_ONLY_LIBRARY */
+
+/* See the comment with FLAC__lpc_restore_signal_intrin_sse41() in
+ * lpc_intrin_sse41.c, this works the same way */
+
+#if defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION) && !defined(FUZZING_BUILD_MODE_FLAC_SANITIZE_SIGNED_INTEGER_OVERFLOW)
+/* See FLAC__lpc_restore_signal() */
+__attribute__((no_sanitize("signed-integer-overflow")))
+#endif
+void FLAC__lpc_restore_signal_intrin_neon(const FLAC__int32 residual[], uint32_t data_len, const FLAC__int32 qlp_coeff[], uint32_t order, int lp_quantization, FLAC__int32 data[])
+{
+    int i, j, k;
+    FLAC__int32 sum, sum_older[4];
+
+    FLAC__ASSERT(order > 0);
+    FLAC__ASSERT(order <= 32);
+
+    if (order <= 10 || data_len < 4) {
+        FLAC__lpc_restore_signal(residual, data_len, qlp_coeff, order, lp_quantization, data);
+        return;
+    }
+
+    for (i = 0; i + 4 <= (int)data_len; i += 4) {
+        int32x4_t older;
+        if (order <= 12) {
+            older = vmulq_n_s32(vld1q_s32(data + i - 9), qlp_coeff[8]);
+            older = vmlaq_n_s32(older, vld1q_s32(data + i - 10), qlp_coeff[9]);
+            older = vmlaq_n_s32(older, vld1q_s32(data + i - 11), qlp_coeff[10]);
+            if (order == 12)
+                older = vmlaq_n_s32(older, vld1q_s32(data + i - 12), qlp_coeff[11]);
+        }
+        else {
+            older = vdupq_n_s32(0);
+            for (j = 8; j < (int)order; j++)
+                older = vmlaq_n_s32(older, vld1q_s32(data + i - j - 1), qlp_coeff[j]);
+        }
+        vst1q_s32(sum_older, older);
+
+        for (k = 0; k < 4; k++) {
+            const FLAC__int32 *history = data + i + k;
+            sum = sum_older[k];
+            sum += qlp_coeff[7] * history[-8];
+            sum += qlp_coeff[6] * history[-7];
+            sum += qlp_coeff[5] * history[-6];
+            sum += qlp_coeff[4] * history[-5];
+            sum += qlp_coeff[3] * history[-4];
+            sum += qlp_coeff[2] * history[-3];
+            sum += qlp_coeff[1] * history[-2];
+            sum += qlp_coeff[0] * history[-1];
+            data[i + k] = residual[i + k] + (sum >> lp_quantization);
+        }
+    }
+    if (i < (int)data_len)
+        FLAC__lpc_restore_signal(residual + i, data_len - i, qlp_coeff, order, lp_quantization, data + i);
+}
+
+#if defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION) && !defined(FUZZING_BUILD_MODE_FLAC_SANITIZE_SIGNED_INTEGER_OVERFLOW)
+/* See FLAC__lpc_restore_signal() */
+__attribute__((no_sanitize("signed-integer-overflow")))
+#endif
+void FLAC__lpc_restore_signal_wide_intrin_neon(const FLAC__int32 residual[], uint32_t data_len, const FLAC__int32 qlp_coeff[], uint32_t order, int lp_quantization, FLAC__int32 data[])
+{
+    int i, j, k;
+    FLAC__int64 sum, sum_older[4];
+
+    FLAC__ASSERT(order > 0);
+    FLAC__ASSERT(order <= 32);
+
+    if (order <= 10 || data_len < 4) {
+        FLAC__lpc_restore_signal_wide(residual, data_len, qlp_coeff, order, lp_quantization, data);
+        return;
+    }
+
+    for (i = 0; i + 4 <= (int)data_len; i += 4) {
+        int64x2_t older01 = vdupq_n_s64(0), older23 = vdupq_n_s64(0);
+        int32x4_t tmp_vec;
+        for (j = 8; j < (int)order; j++) {
+            tmp_vec = vld1q_s32(data + i - j - 1);
+            older01 = vmlal_n_s32(older01, vget_low_s32(tmp_vec), qlp_coeff[j]);
+            older23 = vmlal_n_s32(older23, vget_high_s32(tmp_vec), qlp_coeff[j]);
+        }
+        vst1q_s64(sum_older, older01);
+        vst1q_s64(sum_older + 2, older23);
+
+        for (k = 0; k < 4; k++) {
+            const FLAC__int32 *history = data + i + k;
+            sum = sum_older[k];
+            sum += qlp_coeff[7] * (FLAC__int64)history[-8];
+            sum += qlp_coeff[6] * (FLAC__int64)history[-7];
+            sum += qlp_coeff[5] * (FLAC__int64)history[-6];
+            sum += qlp_coeff[4] * (FLAC__int64)history[-5];
+            sum += qlp_coeff[3] * (FLAC__int64)history[-4];
+            sum += qlp_coeff[2] * (FLAC__int64)history[-3];
+            sum += qlp_coeff[1] * (FLAC__int64)history[-2];
+            sum += qlp_coeff[0] * (FLAC__int64)history[-1];
+            data[i + k] = (FLAC__int32) (residual[i + k] + (sum >> lp_quantization));
+        }
+    }
+    if (i < (int)data_len)
+        FLAC__lpc_restore_signal_wide(residual + i, data_len - i, qlp_coeff, order, lp_quantization, data + i);
+}
+
 #endif /* FLAC__CPU_ARM64 && FLAC__HAS_ARCH64INTRIN */
 #endif /* FLAC__NO_ASM */
-#endif /* FLAC__INTEGER_ONLY_LIBRARY */
@@ -36,7 +36,6 @@
 
 #include "private/cpu.h"
 
-#ifndef FLAC__INTEGER_ONLY_LIBRARY
 #ifndef FLAC__NO_ASM
 #if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
 #include "private/lpc.h"
@@ -47,6 +46,8 @@
 
 #include <smmintrin.h> /* SSE4.1 */
 
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+
 #if defined FLAC__CPU_IA32 /* unused for x64 */
 
 #define RESIDUAL64_RESULT(xmmN)  residual[i] = data[i] - _mm_cvtsi128_si32(_mm_srl_epi64(xmmN, cnt))
@@ -944,7 +945,140 @@ void FLAC__lpc_compute_residual_from_qlp_coefficients_intrin_sse41(const FLAC__i
 	}
 }
 
+#endif /* !FLAC__INTEGER_ONLY_LIBRARY */
+
+/* The prediction of a sample depends on the sample just before it, so the
+ * signal is restored one sample at a time. What is done with vectors here
+ * is the part of the prediction that only depends on samples that are at
+ * least 8 back, for 4 samples at once; the first 8 taps are left in scalar
+ * code. Up to order 10 the scalar routine is limited by the dependency on
+ * the previous sample rather than by the multiplications, so it is used as
+ * is for those orders. */
+
+#if defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION) && !defined(FUZZING_BUILD_MODE_FLAC_SANITIZE_SIGNED_INTEGER_OVERFLOW)
+/* See FLAC__lpc_restore_signal() */
+__attribute__((no_sanitize("signed-integer-overflow")))
+#endif
+FLAC__SSE_TARGET("sse4.1")
+void FLAC__lpc_restore_signal_intrin_sse41(const FLAC__int32 residual[], uint32_t data_len, const FLAC__int32 qlp_coeff[], uint32_t order, int lp_quantization, FLAC__int32 data[])
+{
+	int i, j, k;
+	FLAC__int32 sum, sum_older[4];
+	__m128i q[FLAC__MAX_LPC_ORDER - 8];
+
+	FLAC__ASSERT(order > 0);
+	FLAC__ASSERT(order <= 32);
+
+	if(order <= 10 || data_len < 4) {
+		FLAC__lpc_restore_signal(residual, data_len, qlp_coeff, order, lp_quantization, data);
+		return;
+	}
+
+	for(j = 8; j < (int)order; j++)
+		q[j-8] = _mm_set1_epi32(qlp_coeff[j]);
+
+	for(i = 0; i + 4 <= (int)data_len; i += 4) {
+		__m128i older;
+		if(order <= 12) {
+			older = _mm_mullo_epi32(q[0], _mm_loadu_si128((const __m128i*)(data+i-9)));
+			older = _mm_add_epi32(older, _mm_mullo_epi32(q[1], _mm_loadu_si128((const __m128i*)(data+i-10))));
+			older = _mm_add_epi32(older, _mm_mullo_epi32(q[2], _mm_loadu_si128((const __m128i*)(data+i-11))));
+			if(order == 12)
+				older = _mm_add_epi32(older, _mm_mullo_epi32(q[3], _mm_loadu_si128((const __m128i*)(data+i-12))));
+		}
+		else {
+			older = _mm_setzero_si128();
+			for(j = 8; j < (int)order; j++)
+				older = _mm_add_epi32(older, _mm_mullo_epi32(q[j-8], _mm_loadu_si128((const __m128i*)(data+i-j-1))));
+		}
+		_mm_storeu_si128((__m128i*)sum_older, older);
+
+		for(k = 0; k < 4; k++) {
+			const FLAC__int32 *history = data + i + k;
+			sum = sum_older[k];
+			sum += qlp_coeff[7] * history[-8];
+			sum += qlp_coeff[6] * history[-7];
+			sum += qlp_coeff[5] * history[-6];
+			sum += qlp_coeff[4] * history[-5];
+			sum += qlp_coeff[3] * history[-4];
+			sum += qlp_coeff[2] * history[-3];
+			sum += qlp_coeff[1] * history[-2];
+			sum += qlp_coeff[0] * history[-1];
+			data[i+k] = residual[i+k] + (sum >> lp_quantization);
+		}
+	}
+	if(i < (int)data_len)
+		FLAC__lpc_restore_signal(residual+i, data_len-i, qlp_coeff, order, lp_quantization, data+i);
+}
+
+#if defined(FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION) && !defined(FUZZING_BUILD_MODE_FLAC_SANITIZE_SIGNED_INTEGER_OVERFLOW)
+/* See FLAC__lpc_restore_signal() */
+__attribute__((no_sanitize("signed-integer-overflow")))
+#endif
+FLAC__SSE_TARGET("sse4.1")
+void FLAC__lpc_restore_signal_wide_intrin_sse41(const FLAC__int32 residual[], uint32_t data_len, const FLAC__int32 qlp_coeff[], uint32_t order, int lp_quantization, FLAC__int32 data[])
+{
+	int i, j, k;
+	FLAC__int64 sum, sum_older[4];
+	__m128i q[FLAC__MAX_LPC_ORDER - 8];
+
+	FLAC__ASSERT(order > 0);
+	FLAC__ASSERT(order <= 32);
+
+	if(order <= 10 || data_len < 4) {
+		FLAC__lpc_restore_signal_wide(residual, data_len, qlp_coeff, order, lp_quantization, data);
+		return;
+	}
+
+	for(j = 8; j < (int)order; j++)
+		q[j-8] = _mm_set1_epi32(qlp_coeff[j]);
+
+	for(i = 0; i + 4 <= (int)data_len; i += 4) {
+		__m128i older01 = _mm_setzero_si128(), older23 = _mm_setzero_si128(), xmm;
+		if(order <= 12) {
+			xmm = _mm_loadu_si128((const __m128i*)(data+i-9));
+			older01 = _mm_mul_epi32(q[0], _mm_cvtepi32_epi64(xmm));
+			older23 = _mm_mul_epi32(q[0], _mm_cvtepi32_epi64(_mm_srli_si128(xmm, 8)));
+			xmm = _mm_loadu_si128((const __m128i*)(data+i-10));
+			older01 = _mm_add_epi64(older01, _mm_mul_epi32(q[1], _mm_cvtepi32_epi64(xmm)));
+			older23 = _mm_add_epi64(older23, _mm_mul_epi32(q[1], _mm_cvtepi32_epi64(_mm_srli_si128(xmm, 8))));
+			xmm = _mm_loadu_si128((const __m128i*)(data+i-11));
+			older01 = _mm_add_epi64(older01, _mm_mul_epi32(q[2], _mm_cvtepi32_epi64(xmm)));
+			older23 = _mm_add_epi64(older23, _mm_mul_epi32(q[2], _mm_cvtepi32_epi64(_mm_srli_si128(xmm, 8))));
+			if(order == 12) {
+				xmm = _mm_loadu_si128((const __m128i*)(data+i-12));
+				older01 = _mm_add_epi64(older01, _mm_mul_epi32(q[3], _mm_cvtepi32_epi64(xmm)));
+				older23 = _mm_add_epi64(older23, _mm_mul_epi32(q[3], _mm_cvtepi32_epi64(_mm_srli_si128(xmm, 8))));
+			}
+		}
+		else {
+			for(j = 8; j < (int)order; j++) {
+				xmm = _mm_loadu_si128((const __m128i*)(data+i-j-1));
+				older01 = _mm_add_epi64(older01, _mm_mul_epi32(q[j-8], _mm_cvtepi32_epi64(xmm)));
+				older23 = _mm_add_epi64(older23, _mm_mul_epi32(q[j-8], _mm_cvtepi32_epi64(_mm_srli_si128(xmm, 8))));
+			}
+		}
+		_mm_storeu_si128((__m128i*)sum_older, older01);
+		_mm_storeu_si128((__m128i*)(sum_older+2), older23);
+
+		for(k = 0; k < 4; k++) {
+			const FLAC__int32 *history = data + i + k;
+			sum = sum_older[k];
+			sum += qlp_coeff[7] * (FLAC__int64)history[-8];
+			sum += qlp_coeff[6] * (FLAC__int64)history[-7];
+			sum += qlp_coeff[5] * (FLAC__int64)history[-6];
+			sum += qlp_coeff[4] * (FLAC__int64)history[-5];
+			sum += qlp_coeff[3] * (FLAC__int64)history[-4];
+			sum += qlp_coeff[2] * (FLAC__int64)history[-3];
+			sum += qlp_coeff[1] * (FLAC__int64)history[-2];
+			sum += qlp_coeff[0] * (FLAC__int64)history[-1];
+			data[i+k] = (FLAC__int32) (residual[i+k] + (sum >> lp_quantization));
+		}
+	}
+	if(i < (int)data_len)
+		FLAC__lpc_restore_signal_wide(residual+i, data_len-i, qlp_coeff, order, lp_quantization, data+i);
+}
+
 #endif /* FLAC__SSE4_1_SUPPORTED */
 #endif /* (FLAC__CPU_IA32 || FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN */
 #endif /* FLAC__NO_ASM */
-#endif /* FLAC__INTEGER_ONLY_LIBRARY */
@@ -232,6 +232,8 @@ void FLAC__MD5Init(FLAC__MD5Context *ctx)
 
 	ctx->internal_buf.p8 = 0;
 	ctx->capacity = 0;
+
+	ctx->format_input = FLAC__md5_format_input;
 }
 
 /*
@@ -277,7 +279,7 @@ void FLAC__MD5Final(FLAC__byte digest[16], FLAC__MD5Context *ctx)
 /*
  * Convert the incoming audio signal to a byte stream
  */
-static void format_input_(FLAC__multibyte *mbuf, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample)
+void FLAC__md5_format_input(FLAC__multibyte *mbuf, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample)
 {
 	FLAC__byte *buf_ = mbuf->p8;
 	FLAC__int16 *buf16 = mbuf->p16;
@@ -514,7 +516,7 @@ FLAC__bool FLAC__MD5Accumulate(FLAC__MD5Context *ctx, const FLAC__int32 * const
 		ctx->capacity = bytes_needed;
 	}
 
-	format_input_(&ctx->internal_buf, signal, channels, samples, bytes_per_sample);
+	ctx->format_input(&ctx->internal_buf, signal, channels, samples, bytes_per_sample);
 
 	FLAC__MD5Update(ctx, ctx->internal_buf.p8, bytes_needed);
 
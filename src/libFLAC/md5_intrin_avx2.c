@@ -0,0 +1,158 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2026  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "private/cpu.h"
+
+#ifndef FLAC__NO_ASM
+#if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
+#include "private/md5.h"
+#ifdef FLAC__AVX2_SUPPORTED
+
+#include <immintrin.h> /* AVX2 */
+#include "FLAC/format.h"
+
+#define TRUNCATE_16(x) _mm256_srai_epi32(_mm256_slli_epi32(x, 16), 16)
+
+static void format_input_tail_(FLAC__byte *buf, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample, uint32_t done)
+{
+	const FLAC__int32 *tail[FLAC__MAX_CHANNELS];
+	FLAC__multibyte mbuf;
+	uint32_t channel;
+
+	if(done >= samples)
+		return;
+	for(channel = 0; channel < channels; channel++)
+		tail[channel] = signal[channel] + done;
+	mbuf.p8 = buf + (size_t)done * channels * bytes_per_sample;
+	FLAC__md5_format_input(&mbuf, tail, channels, samples - done, bytes_per_sample);
+}
+
+FLAC__SSE_TARGET("avx2")
+void FLAC__md5_format_input_intrin_avx2(FLAC__multibyte *mbuf, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample)
+{
+	FLAC__byte *buf = mbuf->p8;
+	uint32_t sample = 0, channel;
+
+	if(bytes_per_sample == 2 && channels == 1) {
+		for(; sample + 16 <= samples; sample += 16) {
+			__m256i a = TRUNCATE_16(_mm256_loadu_si256((const __m256i*)(signal[0] + sample)));
+			__m256i b = TRUNCATE_16(_mm256_loadu_si256((const __m256i*)(signal[0] + sample + 8)));
+			/* packs works per 128-bit lane, so the middle quarters need swapping */
+			_mm256_storeu_si256((__m256i*)(buf + (size_t)sample * 2), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3,1,2,0)));
+		}
+	}
+	else if(bytes_per_sample == 2 && (channels == 2 || channels == 4 || channels == 8)) {
+		for(; sample + 8 <= samples; sample += 8) {
+			FLAC__byte *out = buf + (size_t)sample * channels * 2;
+			/* pair[p] holds channels 2p and 2p+1 of 8 samples, one 32-bit word
+			 * per sample, in the order 0 1 2 3 | 4 5 6 7 */
+			__m256i pair[FLAC__MAX_CHANNELS / 2], t0, t1, t2, t3;
+			for(channel = 0; channel < channels; channel += 2) {
+				__m256i l = TRUNCATE_16(_mm256_loadu_si256((const __m256i*)(signal[channel] + sample)));
+				__m256i r = TRUNCATE_16(_mm256_loadu_si256((const __m256i*)(signal[channel+1] + sample)));
+				pair[channel/2] = _mm256_packs_epi32(_mm256_unpacklo_epi32(l, r), _mm256_unpackhi_epi32(l, r));
+			}
+			if(channels == 2) {
+				_mm256_storeu_si256((__m256i*)out, pair[0]);
+			}
+			else if(channels == 4) {
+				/* samples 0 1 | 4 5 and 2 3 | 6 7 */
+				t0 = _mm256_unpacklo_epi32(pair[0], pair[1]);
+				t1 = _mm256_unpackhi_epi32(pair[0], pair[1]);
+				_mm256_storeu_si256((__m256i*)out, _mm256_permute2x128_si256(t0, t1, 0x20));
+				_mm256_storeu_si256((__m256i*)(out + 32), _mm256_permute2x128_si256(t0, t1, 0x31));
+			}
+			else {
+				/* transpose each lane; afterwards tN holds samples N | N+4 */
+				__m256i u0 = _mm256_unpacklo_epi32(pair[0], pair[1]);
+				__m256i u1 = _mm256_unpacklo_epi32(pair[2], pair[3]);
+				__m256i u2 = _mm256_unpackhi_epi32(pair[0], pair[1]);
+				__m256i u3 = _mm256_unpackhi_epi32(pair[2], pair[3]);
+				t0 = _mm256_unpacklo_epi64(u0, u1);
+				t1 = _mm256_unpackhi_epi64(u0, u1);
+				t2 = _mm256_unpacklo_epi64(u2, u3);
+				t3 = _mm256_unpackhi_epi64(u2, u3);
+				_mm256_storeu_si256((__m256i*)out, _mm256_permute2x128_si256(t0, t1, 0x20));
+				_mm256_storeu_si256((__m256i*)(out + 32), _mm256_permute2x128_si256(t2, t3, 0x20));
+				_mm256_storeu_si256((__m256i*)(out + 64), _mm256_permute2x128_si256(t0, t1, 0x31));
+				_mm256_storeu_si256((__m256i*)(out + 96), _mm256_permute2x128_si256(t2, t3, 0x31));
+			}
+		}
+	}
+	else if(bytes_per_sample == 3 && channels <= 2) {
+		/* Gathers the low 3 bytes of each 32-bit word into the first 12
+		 * bytes of each lane. Every 16-byte store writes 4 bytes past the
+		 * 12 it is meant to, so only loop while at least 4 more bytes of
+		 * output follow */
+		const __m256i shuffle = _mm256_setr_epi8(
+			0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+			0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		if(channels == 1) {
+			for(; sample + 10 <= samples; sample += 8) {
+				FLAC__byte *out = buf + (size_t)sample * 3;
+				__m256i x = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(signal[0] + sample)), shuffle);
+				_mm_storeu_si128((__m128i*)out, _mm256_castsi256_si128(x));
+				_mm_storeu_si128((__m128i*)(out + 12), _mm256_extracti128_si256(x, 1));
+			}
+		}
+		else {
+			for(; sample + 9 <= samples; sample += 8) {
+				FLAC__byte *out = buf + (size_t)sample * 6;
+				__m256i l = _mm256_loadu_si256((const __m256i*)(signal[0] + sample));
+				__m256i r = _mm256_loadu_si256((const __m256i*)(signal[1] + sample));
+				/* samples 0 1 | 4 5 and 2 3 | 6 7 */
+				__m256i a = _mm256_shuffle_epi8(_mm256_unpacklo_epi32(l, r), shuffle);
+				__m256i b = _mm256_shuffle_epi8(_mm256_unpackhi_epi32(l, r), shuffle);
+				_mm_storeu_si128((__m128i*)out, _mm256_castsi256_si128(a));
+				_mm_storeu_si128((__m128i*)(out + 12), _mm256_castsi256_si128(b));
+				_mm_storeu_si128((__m128i*)(out + 24), _mm256_extracti128_si256(a, 1));
+				_mm_storeu_si128((__m128i*)(out + 36), _mm256_extracti128_si256(b, 1));
+			}
+		}
+	}
+#ifdef FLAC__SSE2_SUPPORTED
+	else {
+		FLAC__md5_format_input_intrin_sse2(mbuf, signal, channels, samples, bytes_per_sample);
+		return;
+	}
+#endif
+
+	format_input_tail_(buf, signal, channels, samples, bytes_per_sample, sample);
+}
+
+#endif /* FLAC__AVX2_SUPPORTED */
+#endif /* (FLAC__CPU_IA32 || FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN */
+#endif /* FLAC__NO_ASM */
@@ -0,0 +1,149 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2026  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "private/cpu.h"
+
+#ifndef FLAC__NO_ASM
+#if defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN && !WORDS_BIGENDIAN
+#include "private/md5.h"
+#include "FLAC/format.h"
+#include <arm_neon.h>
+
+static void format_input_tail_(FLAC__byte *buf, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample, uint32_t done)
+{
+	const FLAC__int32 *tail[FLAC__MAX_CHANNELS];
+	FLAC__multibyte mbuf;
+	uint32_t channel;
+
+	if(done >= samples)
+		return;
+	for(channel = 0; channel < channels; channel++)
+		tail[channel] = signal[channel] + done;
+	mbuf.p8 = buf + (size_t)done * channels * bytes_per_sample;
+	FLAC__md5_format_input(&mbuf, tail, channels, samples - done, bytes_per_sample);
+}
+
+/* Narrows channels c and c+1 of 4 samples to 16 bits and interleaves them,
+ * giving one 32-bit word per sample */
+static inline uint32x4_t narrow_pair_(const FLAC__int32 * const signal[], uint32_t channel, uint32_t sample)
+{
+	int16x4x2_t z = vzip_s16(vmovn_s32(vld1q_s32(signal[channel] + sample)), vmovn_s32(vld1q_s32(signal[channel+1] + sample)));
+	return vreinterpretq_u32_s16(vcombine_s16(z.val[0], z.val[1]));
+}
+
+void FLAC__md5_format_input_intrin_neon(FLAC__multibyte *mbuf, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample)
+{
+	FLAC__byte *buf = mbuf->p8;
+	uint32_t sample = 0, channel;
+
+	if(bytes_per_sample == 2) {
+		switch(channels) {
+			case 1:
+				for(; sample + 8 <= samples; sample += 8)
+					vst1q_s16((int16_t*)(buf + (size_t)sample * 2), vcombine_s16(vmovn_s32(vld1q_s32(signal[0] + sample)), vmovn_s32(vld1q_s32(signal[0] + sample + 4))));
+				break;
+			case 2:
+				for(; sample + 8 <= samples; sample += 8) {
+					int16x8x2_t x;
+					for(channel = 0; channel < 2; channel++)
+						x.val[channel] = vcombine_s16(vmovn_s32(vld1q_s32(signal[channel] + sample)), vmovn_s32(vld1q_s32(signal[channel] + sample + 4)));
+					vst2q_s16((int16_t*)(buf + (size_t)sample * 4), x);
+				}
+				break;
+			case 4:
+				for(; sample + 8 <= samples; sample += 8) {
+					int16x8x4_t x;
+					for(channel = 0; channel < 4; channel++)
+						x.val[channel] = vcombine_s16(vmovn_s32(vld1q_s32(signal[channel] + sample)), vmovn_s32(vld1q_s32(signal[channel] + sample + 4)));
+					vst4q_s16((int16_t*)(buf + (size_t)sample * 8), x);
+				}
+				break;
+			case 6:
+				for(; sample + 4 <= samples; sample += 4) {
+					uint32x4x3_t x;
+					for(channel = 0; channel < 3; channel++)
+						x.val[channel] = narrow_pair_(signal, channel * 2, sample);
+					vst3q_u32((uint32_t*)(buf + (size_t)sample * 12), x);
+				}
+				break;
+			case 8:
+				for(; sample + 4 <= samples; sample += 4) {
+					uint32x4x4_t x;
+					for(channel = 0; channel < 4; channel++)
+						x.val[channel] = narrow_pair_(signal, channel * 2, sample);
+					vst4q_u32((uint32_t*)(buf + (size_t)sample * 16), x);
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	else if(bytes_per_sample == 3 && channels == 1) {
+		/* de-interleave the bytes of 16 samples and store only the low three */
+		for(; sample + 16 <= samples; sample += 16) {
+			uint8x16x4_t in = vld4q_u8((const uint8_t*)(signal[0] + sample));
+			uint8x16x3_t out;
+			out.val[0] = in.val[0];
+			out.val[1] = in.val[1];
+			out.val[2] = in.val[2];
+			vst3q_u8(buf + (size_t)sample * 3, out);
+		}
+	}
+	else if(bytes_per_sample == 3 && channels == 2) {
+		FLAC__int32 interleaved[16];
+		for(; sample + 8 <= samples; sample += 8) {
+			int32x4x2_t x;
+			uint8x16x4_t in;
+			uint8x16x3_t out;
+			x.val[0] = vld1q_s32(signal[0] + sample);
+			x.val[1] = vld1q_s32(signal[1] + sample);
+			vst2q_s32(interleaved, x);
+			x.val[0] = vld1q_s32(signal[0] + sample + 4);
+			x.val[1] = vld1q_s32(signal[1] + sample + 4);
+			vst2q_s32(interleaved + 8, x);
+			in = vld4q_u8((const uint8_t*)interleaved);
+			out.val[0] = in.val[0];
+			out.val[1] = in.val[1];
+			out.val[2] = in.val[2];
+			vst3q_u8(buf + (size_t)sample * 6, out);
+		}
+	}
+
+	format_input_tail_(buf, signal, channels, samples, bytes_per_sample, sample);
+}
+
+#endif /* FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN && !WORDS_BIGENDIAN */
+#endif /* FLAC__NO_ASM */
@@ -0,0 +1,168 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2026  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "private/cpu.h"
+
+#ifndef FLAC__NO_ASM
+#if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
+#include "private/md5.h"
+#ifdef FLAC__SSE2_SUPPORTED
+
+#include <emmintrin.h> /* SSE2 */
+#include "FLAC/format.h"
+
+/* Keep the low 16 bits of every 32-bit lane, sign-extended, so that a
+ * saturating pack gives the same result as a truncating store */
+#define TRUNCATE_16(x) _mm_srai_epi32(_mm_slli_epi32(x, 16), 16)
+
+static void format_input_tail_(FLAC__byte *buf, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample, uint32_t done)
+{
+	const FLAC__int32 *tail[FLAC__MAX_CHANNELS];
+	FLAC__multibyte mbuf;
+	uint32_t channel;
+
+	if(done >= samples)
+		return;
+	for(channel = 0; channel < channels; channel++)
+		tail[channel] = signal[channel] + done;
+	mbuf.p8 = buf + (size_t)done * channels * bytes_per_sample;
+	FLAC__md5_format_input(&mbuf, tail, channels, samples - done, bytes_per_sample);
+}
+
+/* Packs the low 24 bits of each 32-bit lane, so that each 64-bit half
+ * holds 6 valid bytes followed by 2 bytes of garbage */
+FLAC__SSE_TARGET("sse2")
+static inline __m128i pack_24_(__m128i x)
+{
+	const __m128i lo = _mm_set_epi32(0, 0x00ffffff, 0, 0x00ffffff);
+	const __m128i hi = _mm_set_epi32(0x0000ffff, (int)0xff000000, 0x0000ffff, (int)0xff000000);
+	x = _mm_and_si128(x, _mm_set1_epi32(0x00ffffff));
+	return _mm_or_si128(_mm_and_si128(x, lo), _mm_and_si128(_mm_srli_epi64(x, 8), hi));
+}
+
+FLAC__SSE_TARGET("sse2")
+void FLAC__md5_format_input_intrin_sse2(FLAC__multibyte *mbuf, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample)
+{
+	FLAC__byte *buf = mbuf->p8;
+	uint32_t sample = 0, channel;
+
+	if(bytes_per_sample == 2) {
+		switch(channels) {
+			case 1:
+				for(; sample + 8 <= samples; sample += 8) {
+					__m128i a = TRUNCATE_16(_mm_loadu_si128((const __m128i*)(signal[0] + sample)));
+					__m128i b = TRUNCATE_16(_mm_loadu_si128((const __m128i*)(signal[0] + sample + 4)));
+					_mm_storeu_si128((__m128i*)(buf + (size_t)sample * 2), _mm_packs_epi32(a, b));
+				}
+				break;
+			case 2:
+			case 4:
+			case 6:
+			case 8:
+				for(; sample + 4 <= samples; sample += 4) {
+					FLAC__byte *out = buf + (size_t)sample * channels * 2;
+					/* pair[p] holds channels 2p and 2p+1 of 4 samples, one 32-bit word per sample */
+					__m128i pair[FLAC__MAX_CHANNELS / 2], t0, t1, t2, t3;
+					for(channel = 0; channel < channels; channel += 2) {
+						__m128i l = TRUNCATE_16(_mm_loadu_si128((const __m128i*)(signal[channel] + sample)));
+						__m128i r = TRUNCATE_16(_mm_loadu_si128((const __m128i*)(signal[channel+1] + sample)));
+						pair[channel/2] = _mm_packs_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r));
+					}
+					switch(channels) {
+						case 2:
+							_mm_storeu_si128((__m128i*)out, pair[0]);
+							break;
+						case 4:
+							_mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi32(pair[0], pair[1]));
+							_mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi32(pair[0], pair[1]));
+							break;
+						case 6:
+							t0 = _mm_unpacklo_epi32(pair[0], pair[1]);
+							t1 = _mm_unpackhi_epi32(pair[0], pair[1]);
+							t2 = _mm_unpacklo_epi32(pair[2], _mm_srli_si128(t0, 8));
+							_mm_storeu_si128((__m128i*)out, _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(t0), _mm_castsi128_ps(t2), _MM_SHUFFLE(1,0,1,0))));
+							_mm_storeu_si128((__m128i*)(out + 16), _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(t2), _mm_castsi128_ps(t1), _MM_SHUFFLE(1,0,2,3))));
+							_mm_storeu_si128((__m128i*)(out + 32), _mm_shuffle_epi32(_mm_unpackhi_epi32(pair[2], t1), _MM_SHUFFLE(2,3,1,0)));
+							break;
+						case 8:
+							t0 = _mm_unpacklo_epi32(pair[0], pair[1]);
+							t1 = _mm_unpacklo_epi32(pair[2], pair[3]);
+							t2 = _mm_unpackhi_epi32(pair[0], pair[1]);
+							t3 = _mm_unpackhi_epi32(pair[2], pair[3]);
+							_mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi64(t0, t1));
+							_mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi64(t0, t1));
+							_mm_storeu_si128((__m128i*)(out + 32), _mm_unpacklo_epi64(t2, t3));
+							_mm_storeu_si128((__m128i*)(out + 48), _mm_unpackhi_epi64(t2, t3));
+							break;
+					}
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	else if(bytes_per_sample == 3 && channels <= 2) {
+		/* Every 8-byte store writes 2 bytes past the 6 it is meant to, so
+		 * stop while at least one more sample follows the last one stored */
+		if(channels == 1) {
+			for(; sample + 4 < samples; sample += 4) {
+				FLAC__byte *out = buf + (size_t)sample * 3;
+				__m128i x = pack_24_(_mm_loadu_si128((const __m128i*)(signal[0] + sample)));
+				_mm_storel_epi64((__m128i*)out, x);
+				_mm_storel_epi64((__m128i*)(out + 6), _mm_srli_si128(x, 8));
+			}
+		}
+		else {
+			for(; sample + 4 < samples; sample += 4) {
+				FLAC__byte *out = buf + (size_t)sample * 6;
+				__m128i l = _mm_loadu_si128((const __m128i*)(signal[0] + sample));
+				__m128i r = _mm_loadu_si128((const __m128i*)(signal[1] + sample));
+				__m128i a = pack_24_(_mm_unpacklo_epi32(l, r));
+				__m128i b = pack_24_(_mm_unpackhi_epi32(l, r));
+				_mm_storel_epi64((__m128i*)out, a);
+				_mm_storel_epi64((__m128i*)(out + 6), _mm_srli_si128(a, 8));
+				_mm_storel_epi64((__m128i*)(out + 12), b);
+				_mm_storel_epi64((__m128i*)(out + 18), _mm_srli_si128(b, 8));
+			}
+		}
+	}
+
+	format_input_tail_(buf, signal, channels, samples, bytes_per_sample, sample);
+}
+
+#endif /* FLAC__SSE2_SUPPORTED */
+#endif /* (FLAC__CPU_IA32 || FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN */
+#endif /* FLAC__NO_ASM */
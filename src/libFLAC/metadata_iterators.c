@@ -41,6 +41,10 @@
 #include <stdarg.h>
 
 #include <sys/stat.h> /* for stat(), maybe chmod() */
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h> /* for FICLONERANGE */
+#include <sys/ioctl.h>
+#endif
 
 #include "private/metadata.h"
 
@@ -55,6 +59,10 @@
 /* Alias the first (in share/alloc.h) to the second (in src/libFLAC/memory.c). */
 #define safe_malloc_mul_2op_ safe_malloc_mul_2op_p
 
+/* Size of the buffer the audio data is copied through when a rewrite of
+ * the metadata has to move it and the kernel can't copy it for us. */
+#define COPY_BUFFER_SIZE (1u << 20)
+
 /****************************************************************************
  *
  * Local function declarations
@@ -112,6 +120,9 @@ static FLAC__bool simple_iterator_copy_file_postfix_(FLAC__Metadata_SimpleIterat
 static FLAC__bool copy_n_bytes_from_file_(FILE *file, FILE *tempfile, FLAC__off_t bytes, FLAC__Metadata_SimpleIteratorStatus *status);
 static FLAC__bool copy_n_bytes_from_file_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__IOHandle temp_handle, FLAC__IOCallback_Write temp_write_cb, FLAC__off_t bytes, FLAC__Metadata_SimpleIteratorStatus *status);
 static FLAC__bool copy_remaining_bytes_from_file_(FILE *file, FILE *tempfile, FLAC__Metadata_SimpleIteratorStatus *status);
+#if defined HAVE_COPY_FILE_RANGE || (defined HAVE_LINUX_FS_H && defined FICLONERANGE)
+static FLAC__bool copy_remaining_bytes_in_kernel_(FILE *file, FILE *tempfile, FLAC__bool *done, FLAC__Metadata_SimpleIteratorStatus *status);
+#endif
 static FLAC__bool copy_remaining_bytes_from_file_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__IOCallback_Eof eof_cb, FLAC__IOHandle temp_handle, FLAC__IOCallback_Write temp_write_cb, FLAC__Metadata_SimpleIteratorStatus *status);
 
 static FLAC__bool open_tempfile_(const char *filename, const char *tempfile_path_prefix, FILE **tempfile, char **tempfilename, FLAC__Metadata_SimpleIteratorStatus *status);
@@ -3413,24 +3424,100 @@ FLAC__bool copy_n_bytes_from_file_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Re
 
 FLAC__bool copy_remaining_bytes_from_file_(FILE *file, FILE *tempfile, FLAC__Metadata_SimpleIteratorStatus *status)
 {
-	FLAC__byte buffer[8192];
+	FLAC__byte *buffer;
 	size_t n;
 
+#if defined HAVE_COPY_FILE_RANGE || (defined HAVE_LINUX_FS_H && defined FICLONERANGE)
+	{
+		FLAC__bool done;
+		if(!copy_remaining_bytes_in_kernel_(file, tempfile, &done, status))
+			return false;
+		if(done)
+			return true;
+	}
+#endif
+
+	if(0 == (buffer = malloc(COPY_BUFFER_SIZE))) {
+		*status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
 	while(!feof(file)) {
-		n = fread(buffer, 1, sizeof(buffer), file);
+		n = fread(buffer, 1, COPY_BUFFER_SIZE, file);
 		if(n == 0 && !feof(file)) {
+			free(buffer);
 			*status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_READ_ERROR;
 			return false;
 		}
 		if(n > 0 && local__fwrite(buffer, 1, n, tempfile) != n) {
+			free(buffer);
 			*status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_WRITE_ERROR;
 			return false;
 		}
 	}
 
+	free(buffer);
 	return true;
 }
 
+#if defined HAVE_COPY_FILE_RANGE || (defined HAVE_LINUX_FS_H && defined FICLONERANGE)
+/*
+ * Lets the kernel copy the rest of 'file' to 'tempfile', so the audio
+ * data doesn't pass through user space.  When both offsets are block
+ * aligned, filesystems with reflinks (Btrfs, XFS) can share the data
+ * instead of copying it at all, otherwise copy_file_range() is used.
+ * Sets 'done' to false if the copy could not be finished, with both
+ * files positioned where it stopped so the caller can copy the remainder
+ * itself; otherwise both files are positioned at their end.
+ */
+FLAC__bool copy_remaining_bytes_in_kernel_(FILE *file, FILE *tempfile, FLAC__bool *done, FLAC__Metadata_SimpleIteratorStatus *status)
+{
+	const int fd = fileno(file), temp_fd = fileno(tempfile);
+	struct stat stats;
+	FLAC__off_t offset, temp_offset;
+
+	*done = false;
+	if(0 != fflush(tempfile) || (offset = ftello(file)) < 0 || (temp_offset = ftello(tempfile)) < 0 || 0 != fstat(fd, &stats))
+		return true;
+	if(offset >= stats.st_size)
+		return true; /* nothing to copy, leave it to the caller to set the EOF indicator */
+
+#if defined HAVE_LINUX_FS_H && defined FICLONERANGE
+	if(stats.st_blksize > 0 && offset % stats.st_blksize == 0 && temp_offset % stats.st_blksize == 0) {
+		struct file_clone_range range;
+		range.src_fd = fd;
+		range.src_offset = (FLAC__uint64)offset;
+		range.src_length = 0; /* i.e. up to the end of the file */
+		range.dest_offset = (FLAC__uint64)temp_offset;
+		if(0 == ioctl(temp_fd, FICLONERANGE, &range)) {
+			temp_offset += stats.st_size - offset;
+			offset = stats.st_size;
+		}
+	}
+#endif
+#ifdef HAVE_COPY_FILE_RANGE
+	{
+		off_t in = offset, out = temp_offset; /* 64 bits wide, as config.h sets _FILE_OFFSET_BITS */
+		while(in < stats.st_size) {
+			/* fails on e.g. EXDEV or ENOSYS before copying anything, which just means falling back */
+			const ssize_t n = copy_file_range(fd, &in, temp_fd, &out, (size_t)flac_min(stats.st_size - in, (off_t)1 << 30), 0);
+			if(n <= 0)
+				break;
+		}
+		offset = in;
+		temp_offset = out;
+	}
+#endif
+
+	/* copy_file_range() and the ioctl leave the file offsets alone, so move the streams past the copied data */
+	if(0 != fseeko(tempfile, temp_offset, SEEK_SET) || 0 != fseeko(file, offset, SEEK_SET)) {
+		*status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_SEEK_ERROR;
+		return false;
+	}
+	*done = offset >= stats.st_size;
+	return true;
+}
+#endif
+
 FLAC__bool copy_remaining_bytes_from_file_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__IOCallback_Eof eof_cb, FLAC__IOHandle temp_handle, FLAC__IOCallback_Write temp_write_cb, FLAC__Metadata_SimpleIteratorStatus *status)
 {
 	FLAC__byte buffer[8192];
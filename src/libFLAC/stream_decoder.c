@@ -39,7 +39,11 @@
 #include <string.h> /* for memset/memcpy() */
 #include <sys/types.h> /* for off_t */
 #include <sys/stat.h>  /* for stat() */
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>  /* for mmap() */
+#endif
 #include "share/compat.h"
+#include "share/compat_threads.h"
 #include "FLAC/assert.h"
 #include "share/alloc.h"
 #include "protected/stream_decoder.h"
@@ -53,6 +57,8 @@
 #include "private/md5.h"
 #include "private/memory.h"
 #include "private/macros.h"
+#include "private/profile.h"
+#include "private/stream_decoder.h"
 
 
 /* technically this should be in an "export.c" but this is convenient enough */
@@ -67,6 +73,49 @@ FLAC_API int FLAC_API_SUPPORTS_OGG_FLAC = FLAC__HAS_OGG;
 
 static const FLAC__byte ID3V2_TAG_[3] = { 'I', 'D', '3' };
 
+#ifdef FLAC__USE_THREADS
+/* MAGIC NUMBER: the longest possible frame header, including the CRC-8 */
+static const uint32_t FLAC__STREAM_DECODER_MAX_FRAME_HEADER_LEN = 16;
+
+/* the number of bytes requested from the read callback at once when reading ahead for the threadtasks */
+static const size_t FLAC__STREAM_DECODER_READ_AHEAD_SIZE = 65536;
+
+/* the number of frames the MD5 queue can hold before the decoding thread has to wait for the MD5 thread */
+static const uint32_t FLAC__STREAM_DECODER_MD5_QUEUE_FRAMES = 8;
+
+/* the size of each buffer the prefetch thread reads a file into */
+static const size_t FLAC__STREAM_DECODER_PREFETCH_BUFFER_SIZE = 262144;
+#endif
+
+/***********************************************************************
+ *
+ * Thread-private data
+ *
+ ***********************************************************************/
+
+#ifdef FLAC__USE_THREADS
+/* MAGIC NUMBER: errors beyond this number within a single threadtask are dropped */
+#define FLAC__STREAM_DECODER_MAX_THREADTASK_ERRORS 16
+
+typedef struct FLAC__StreamDecoderThreadTask {
+	FLAC__StreamDecoder *decoder;                     /* the embedded decoder that does the actual decoding */
+	FLAC__byte *data;                                 /* the frame to be decoded, from its sync code up to the next frame */
+	size_t data_length, data_capacity;                /* in bytes */
+	size_t data_consumed;                             /* number of bytes of data already handed to the embedded decoder */
+	FLAC__uint64 end_position;                        /* position in the stream directly after the frame */
+	FLAC__StreamDecoderErrorStatus error[FLAC__STREAM_DECODER_MAX_THREADTASK_ERRORS]; /* errors to pass on to the client before the frame */
+	uint32_t num_errors;
+	const FLAC__Frame *frame;                         /* the decoded frame, if got_a_frame is true */
+	const FLAC__int32 * const *buffer;
+	FLAC__bool got_a_frame;
+	FLAC__bool trailing_data;                         /* true if data was left after the decoded frame */
+	FLAC__bool returnvalue;
+	FLAC__mtx_t mutex_this_task;                      /* To lock whole threadtask */
+	FLAC__cnd_t cond_task_done;
+	FLAC__bool task_done;
+} FLAC__StreamDecoderThreadTask;
+#endif
+
 /***********************************************************************
  *
  * Private class method prototypes
@@ -87,6 +136,8 @@ static FLAC__bool read_metadata_picture_(FLAC__StreamDecoder *decoder, FLAC__Str
 static FLAC__bool skip_id3v2_tag_(FLAC__StreamDecoder *decoder);
 static FLAC__bool frame_sync_(FLAC__StreamDecoder *decoder);
 static FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FLAC__bool do_full_decode);
+static FLAC__bool write_missing_frames_to_client_(FLAC__StreamDecoder *decoder, const FLAC__FrameHeader *header);
+static void update_stream_properties_(FLAC__StreamDecoder *decoder, const FLAC__FrameHeader *header);
 static FLAC__bool read_frame_header_(FLAC__StreamDecoder *decoder);
 static FLAC__bool read_subframe_(FLAC__StreamDecoder *decoder, uint32_t channel, uint32_t bps, FLAC__bool do_full_decode);
 static FLAC__bool read_subframe_constant_(FLAC__StreamDecoder *decoder, uint32_t channel, uint32_t bps, FLAC__bool do_full_decode);
@@ -102,6 +153,18 @@ static FLAC__StreamDecoderReadStatus read_callback_ogg_aspect_(const FLAC__Strea
 static FLAC__OggDecoderAspectReadStatus read_callback_proxy_(const void *void_decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
 #endif
 static FLAC__StreamDecoderWriteStatus write_audio_frame_to_client_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[]);
+static FLAC__StreamDecoderWriteStatus call_write_callback_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[]);
+static FLAC__bool store_interleaved_output_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[]);
+static uint32_t pcm_format_bytes_per_sample_(FLAC__StreamDecoderPCMFormat format, uint32_t *max_bps);
+static void pack_interleaved_(FLAC__StreamDecoder *decoder, FLAC__StreamDecoderPCMFormat format, void *out, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bps);
+static FLAC__StreamDecoderWriteStatus pull_write_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[]);
+static FLAC__bool grow_pull_fifo_(FLAC__StreamDecoder *decoder, uint32_t channels, uint32_t samples);
+static void free_pull_fifo_(FLAC__StreamDecoder *decoder);
+static FLAC__bool add_frame_to_index_(FLAC__StreamDecoder *decoder, const FLAC__FrameHeader *header, FLAC__uint64 frame_position);
+static const FLAC__StreamMetadata_SeekPoint *find_frame_in_index_(const FLAC__StreamDecoder *decoder, FLAC__uint64 target_sample, const FLAC__StreamMetadata_SeekPoint **next_point);
+static FLAC__bool grow_frame_index_(FLAC__StreamDecoder *decoder, uint32_t points);
+static FLAC__bool check_frame_index_md5sum_(FLAC__StreamDecoder *decoder);
+static void free_frame_index_(FLAC__StreamDecoder *decoder);
 static void send_error_to_client_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status);
 static FLAC__bool seek_to_absolute_sample_(FLAC__StreamDecoder *decoder, FLAC__uint64 stream_length, FLAC__uint64 target_sample);
 #if FLAC__HAS_OGG
@@ -112,7 +175,43 @@ static FLAC__StreamDecoderSeekStatus file_seek_callback_(const FLAC__StreamDecod
 static FLAC__StreamDecoderTellStatus file_tell_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data);
 static FLAC__StreamDecoderLengthStatus file_length_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data);
 static FLAC__bool file_eof_callback_(const FLAC__StreamDecoder *decoder, void *client_data);
+#ifdef HAVE_SYS_MMAN_H
+static FLAC__StreamDecoderReadStatus mmap_read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
+static FLAC__StreamDecoderSeekStatus mmap_seek_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data);
+static FLAC__StreamDecoderTellStatus mmap_tell_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data);
+static FLAC__StreamDecoderLengthStatus mmap_length_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data);
+static FLAC__bool mmap_eof_callback_(const FLAC__StreamDecoder *decoder, void *client_data);
+#endif
 static void reset_decoder_internal_(FLAC__StreamDecoder* decoder);
+#ifdef FLAC__USE_THREADS
+static uint32_t frame_header_length_(const FLAC__byte *header, size_t bytes);
+static FLAC__bool fill_read_ahead_(FLAC__StreamDecoder *decoder, size_t bytes);
+static FLAC__bool read_frame_for_threadtask_(FLAC__StreamDecoder *decoder, FLAC__StreamDecoderThreadTask *task);
+static FLAC__StreamDecoderReadStatus threadtask_read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
+static FLAC__StreamDecoderWriteStatus threadtask_write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data);
+static void threadtask_error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data);
+static void process_threadtask_(FLAC__StreamDecoderThreadTask *task);
+static FLAC__StreamDecoderThreadTask *take_threadtask_(FLAC__StreamDecoder *decoder);
+static FLAC__thread_return_type process_frame_thread_(void *args);
+static FLAC__StreamDecoderThreadTask *new_threadtask_(FLAC__StreamDecoder *decoder);
+static FLAC__bool init_threadtasks_(FLAC__StreamDecoder *decoder);
+static void free_threadtasks_(FLAC__StreamDecoder *decoder);
+#ifdef FLAC__PROFILING
+static void add_profile_(FLAC__StreamDecoderProfile *total, const FLAC__StreamDecoderProfile *profile);
+#endif
+static FLAC__bool write_threadtask_to_client_(FLAC__StreamDecoder *decoder, FLAC__StreamDecoderThreadTask *task);
+static FLAC__bool process_frames_threaded_(FLAC__StreamDecoder *decoder);
+static FLAC__bool start_md5_thread_(FLAC__StreamDecoder *decoder);
+static void finish_md5_thread_(FLAC__StreamDecoder *decoder);
+static FLAC__thread_return_type md5_thread_(void *args);
+static FLAC__bool queue_md5_(FLAC__StreamDecoder *decoder, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample);
+static FLAC__bool start_prefetch_thread_(const FLAC__StreamDecoder *decoder);
+static void finish_prefetch_thread_(FLAC__StreamDecoder *decoder);
+static void free_prefetch_buffers_(const FLAC__StreamDecoder *decoder);
+static FLAC__thread_return_type prefetch_thread_(void *args);
+static FLAC__StreamDecoderReadStatus prefetch_read_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes);
+static FLAC__StreamDecoderSeekStatus prefetch_seek_(const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset);
+#endif
 
 /***********************************************************************
  *
@@ -132,6 +231,9 @@ typedef struct FLAC__StreamDecoderPrivate {
 	FLAC__StreamDecoderErrorCallback error_callback;
 	void *client_data;
 	FILE *file; /* only used if FLAC__stream_decoder_init_file()/FLAC__stream_decoder_init_file() called, else NULL */
+	const FLAC__byte *mmap_data; /* only used if FLAC__stream_decoder_init_mmap()/FLAC__stream_decoder_init_ogg_mmap() could map the file, else NULL */
+	size_t mmap_length;
+	size_t mmap_position;
 	FLAC__BitReader *input;
 	FLAC__int32 *output[FLAC__MAX_CHANNELS];
 	FLAC__int32 *residual[FLAC__MAX_CHANNELS]; /* WATCHOUT: these are the aligned pointers; the real pointers that should be free()'d are residual_unaligned[] below */
@@ -169,6 +271,26 @@ typedef struct FLAC__StreamDecoderPrivate {
 	uint32_t unparseable_frame_count; /* used to tell whether we're decoding a future version of FLAC or just got a bad sync */
 	FLAC__bool got_a_frame; /* hack needed in Ogg FLAC seek routine and find_total_samples to check when process_single() actually writes a frame */
 	FLAC__bool (*local_bitreader_read_rice_signed_block)(FLAC__BitReader *br, int vals[], uint32_t nvals, uint32_t parameter);
+	void (*local_fixed_restore_signal)(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[]);
+	void (*local_fixed_restore_signal_wide)(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[]);
+	void (*local_lpc_restore_signal)(const FLAC__int32 residual[], uint32_t data_len, const FLAC__int32 qlp_coeff[], uint32_t order, int lp_quantization, FLAC__int32 data[]);
+	void (*local_lpc_restore_signal_64bit)(const FLAC__int32 residual[], uint32_t data_len, const FLAC__int32 qlp_coeff[], uint32_t order, int lp_quantization, FLAC__int32 data[]);
+	FLAC__MD5FormatInput local_md5_format_input;
+	const FLAC__CRC16Functions *local_crc16_functions;
+	FLAC__StreamDecoderPCMFormat pcm_format;
+	void *pcm_buffer; /* only used if FLAC__stream_decoder_set_interleaved_output() was called with a buffer, else NULL */
+	size_t pcm_buffer_size; /* in bytes */
+	void *pull_buffer; /* only set during FLAC__stream_decoder_read_samples() */
+	FLAC__StreamDecoderPCMFormat pull_format;
+	uint32_t pull_samples, pull_samples_done; /* in samples per channel */
+	uint32_t pull_channels; /* number of channels of the samples in pull_buffer, 0 if there are none yet */
+	FLAC__int32 *pull_fifo[FLAC__MAX_CHANNELS]; /* decoded samples that did not fit in pull_buffer */
+	uint32_t pull_fifo_capacity, pull_fifo_start, pull_fifo_size; /* in samples per channel */
+	uint32_t pull_fifo_capacity_channels; /* number of channels pull_fifo has been allocated for */
+	uint32_t pull_fifo_channels, pull_fifo_bps; /* format of the samples currently in pull_fifo */
+	FLAC__StreamMetadata frame_index; /* SEEKTABLE with a seek point for every frame from the start of the stream */
+	uint32_t frame_index_capacity; /* in seek points */
+	FLAC__byte frame_index_md5sum[16]; /* MD5 signature of the stream a loaded frame index belongs to, all zeroes if unknown */
 	FLAC__bool error_has_been_sent; /* To check whether a missing frame has been signalled yet */
 #if FLAC__HAS_OGG
 	FLAC__bool ogg_decoder_aspect_allocation_failure;
@@ -176,6 +298,57 @@ typedef struct FLAC__StreamDecoderPrivate {
 #ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
 	uint32_t fuzzing_rewind_count; /* To stop excessive rewinding, as it causes timeouts */
 #endif
+#ifdef FLAC__USE_THREADS
+	FLAC__StreamDecoderThreadTask *threadtask[FLAC__STREAM_DECODER_MAX_THREADTASKS];
+	FLAC__thrd_t thread[FLAC__STREAM_DECODER_MAX_THREADS];
+	uint32_t num_threadtasks;
+	uint32_t num_created_threads;
+	uint32_t next_threadtask; /* Next threadtask that is available to work on */
+	uint32_t num_available_threadtasks; /* Number of threadtasks that are available to work on */
+	FLAC__mtx_t mutex_work_queue; /* To lock work related variables in this struct */
+	FLAC__cnd_t cond_work_available; /* To signal to threads that work is available */
+	FLAC__bool finish_work_threads;
+	FLAC__byte *read_ahead; /* input that has been read ahead for the threadtasks */
+	size_t read_ahead_capacity, read_ahead_start, read_ahead_end; /* in bytes; data between start and end has not been handed to a threadtask yet */
+	FLAC__bool read_ahead_end_of_stream;
+	FLAC__bool read_ahead_position_valid; /* if true, read_ahead_position is the position in the stream of read_ahead[0] */
+	FLAC__uint64 read_ahead_position;
+	FLAC__bool threadtask_position_valid; /* if true, FLAC__stream_decoder_get_decode_position() returns threadtask_position */
+	FLAC__uint64 threadtask_position;
+	FLAC__thrd_t md5_thread;
+	FLAC__bool md5_thread_created;
+	FLAC__mtx_t mutex_md5_fifo; /* To lock the MD5 queue */
+	FLAC__cnd_t cond_md5_available; /* To signal to the MD5 thread that the queue has been filled */
+	FLAC__cnd_t cond_md5_emptied; /* To signal to the decoding thread that the queue has been emptied */
+	FLAC__bool finish_md5_thread;
+	FLAC__bool md5_thread_error;
+#ifdef FLAC__PROFILING
+	FLAC__StreamDecoderProfile md5_thread_profile;
+#endif
+	FLAC__int32 *md5_fifo[FLAC__MAX_CHANNELS];
+	uint32_t md5_fifo_size, md5_fifo_tail; /* in samples per channel */
+	uint32_t md5_fifo_capacity_channels; /* number of channels md5_fifo has been allocated for */
+	uint32_t md5_fifo_channels, md5_fifo_bytes_per_sample; /* format of the samples currently in the queue */
+	FLAC__thrd_t prefetch_thread;
+	FLAC__bool prefetch_thread_created;
+	FLAC__bool prefetch_thread_failed; /* if true, the prefetch thread could not be started and the file is read directly */
+	FLAC__mtx_t mutex_prefetch; /* To lock the prefetch buffers */
+	FLAC__cnd_t cond_prefetch_filled; /* To signal to the decoding thread that a buffer has been filled */
+	FLAC__cnd_t cond_prefetch_emptied; /* To signal to the prefetch thread that a buffer has been emptied */
+	FLAC__bool finish_prefetch_thread;
+	FLAC__byte *prefetch_buffer[FLAC__STREAM_DECODER_MAX_PREFETCH_BUFFERS];
+	size_t prefetch_length[FLAC__STREAM_DECODER_MAX_PREFETCH_BUFFERS]; /* in bytes */
+	uint32_t prefetch_head; /* the buffer that is read from next */
+	uint32_t prefetch_filled; /* number of buffers, starting at prefetch_head, that hold data not yet read */
+	size_t prefetch_consumed; /* in bytes, of the buffer at prefetch_head */
+	FLAC__bool prefetch_reading; /* true while the prefetch thread reads the file without holding the lock */
+	FLAC__bool prefetch_end_of_file, prefetch_error;
+	FLAC__bool prefetch_position_valid; /* if true, prefetch_position is the position in the file of the next byte to be read by the decoder */
+	FLAC__uint64 prefetch_position;
+#endif
+#ifdef FLAC__PROFILING
+	FLAC__StreamDecoderProfile profile; /* the counters of the threads are added when they finish */
+#endif
 } FLAC__StreamDecoderPrivate;
 
 /***********************************************************************
@@ -247,6 +420,22 @@ FLAC_API const char * const FLAC__StreamDecoderErrorStatusString[] = {
 	"FLAC__STREAM_DECODER_ERROR_STATUS_MISSING_FRAME"
 };
 
+FLAC_API const char * const FLAC__StreamDecoderPCMFormatString[] = {
+	"FLAC__STREAM_DECODER_PCM_FORMAT_S16LE",
+	"FLAC__STREAM_DECODER_PCM_FORMAT_S24LE",
+	"FLAC__STREAM_DECODER_PCM_FORMAT_S32LE",
+	"FLAC__STREAM_DECODER_PCM_FORMAT_FLOAT"
+};
+
+FLAC_API const char * const FLAC__StreamDecoderProfileStageString[] = {
+	"FLAC__STREAM_DECODER_PROFILE_SYNC",
+	"FLAC__STREAM_DECODER_PROFILE_HEADER",
+	"FLAC__STREAM_DECODER_PROFILE_RICE",
+	"FLAC__STREAM_DECODER_PROFILE_RESTORE",
+	"FLAC__STREAM_DECODER_PROFILE_DECORRELATION",
+	"FLAC__STREAM_DECODER_PROFILE_MD5"
+};
+
 /***********************************************************************
  *
  * Class constructor/destructor
@@ -297,6 +486,7 @@ FLAC_API FLAC__StreamDecoder *FLAC__stream_decoder_new(void)
 	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
 		decoder->private_->output[i] = 0;
 		decoder->private_->residual_unaligned[i] = decoder->private_->residual[i] = 0;
+		decoder->private_->pull_fifo[i] = 0;
 	}
 
 	decoder->private_->side_subframe = 0;
@@ -305,10 +495,21 @@ FLAC_API FLAC__StreamDecoder *FLAC__stream_decoder_new(void)
 	decoder->private_->output_channels = 0;
 	decoder->private_->has_seek_table = false;
 
+	decoder->private_->pull_buffer = 0;
+	decoder->private_->pull_fifo_capacity = 0;
+	decoder->private_->pull_fifo_capacity_channels = 0;
+	decoder->private_->pull_fifo_size = 0;
+
+	memset(&decoder->private_->frame_index, 0, sizeof(decoder->private_->frame_index));
+	decoder->private_->frame_index.type = FLAC__METADATA_TYPE_SEEKTABLE;
+	decoder->private_->frame_index_capacity = 0;
+	memset(decoder->private_->frame_index_md5sum, 0, sizeof(decoder->private_->frame_index_md5sum));
+
 	for(i = 0; i < FLAC__MAX_CHANNELS; i++)
 		FLAC__format_entropy_coding_method_partitioned_rice_contents_init(&decoder->private_->partitioned_rice_contents[i]);
 
 	decoder->private_->file = 0;
+	decoder->private_->mmap_data = 0;
 
 	set_defaults_(decoder);
 
@@ -373,7 +574,7 @@ static FLAC__StreamDecoderInitStatus init_stream_internal_(
 
 	if(
 		0 == read_callback ||
-		0 == write_callback ||
+		(0 == write_callback && !decoder->protected_->pull_mode) ||
 		0 == error_callback ||
 		(seek_callback && (0 == tell_callback || 0 == length_callback || 0 == eof_callback))
 	)
@@ -395,6 +596,63 @@ static FLAC__StreamDecoderInitStatus init_stream_internal_(
 		decoder->private_->local_bitreader_read_rice_signed_block = FLAC__bitreader_read_rice_signed_block_bmi2;
 	}
 #endif
+#if ENABLE_64_BIT_WORDS
+#if defined FLAC__AVX2_SUPPORTED && defined FLAC__BMI2_SUPPORTED
+	if (decoder->private_->cpuinfo.x86.avx2 && decoder->private_->cpuinfo.x86.bmi2) {
+		decoder->private_->local_bitreader_read_rice_signed_block = FLAC__bitreader_read_rice_signed_block_avx2;
+	}
+#endif
+#if defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN
+	decoder->private_->local_bitreader_read_rice_signed_block = FLAC__bitreader_read_rice_signed_block_neon;
+#endif
+#endif
+
+	decoder->private_->local_md5_format_input = FLAC__md5_format_input;
+	decoder->private_->local_crc16_functions = &FLAC__crc16_functions;
+	decoder->private_->local_fixed_restore_signal = FLAC__fixed_restore_signal;
+	decoder->private_->local_fixed_restore_signal_wide = FLAC__fixed_restore_signal_wide;
+	decoder->private_->local_lpc_restore_signal = FLAC__lpc_restore_signal;
+	decoder->private_->local_lpc_restore_signal_64bit = FLAC__lpc_restore_signal_wide;
+#if !defined FLAC__NO_ASM && FLAC__HAS_X86INTRIN
+	if(decoder->private_->cpuinfo.use_asm) {
+# if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64)
+#  ifdef FLAC__SSE2_SUPPORTED
+		if (decoder->private_->cpuinfo.x86.sse2) {
+			decoder->private_->local_md5_format_input = FLAC__md5_format_input_intrin_sse2;
+			decoder->private_->local_fixed_restore_signal = FLAC__fixed_restore_signal_intrin_sse2;
+			decoder->private_->local_fixed_restore_signal_wide = FLAC__fixed_restore_signal_wide_intrin_sse2;
+		}
+#  endif
+#  ifdef FLAC__SSE4_1_SUPPORTED
+		if (decoder->private_->cpuinfo.x86.sse41) {
+			decoder->private_->local_lpc_restore_signal = FLAC__lpc_restore_signal_intrin_sse41;
+			decoder->private_->local_lpc_restore_signal_64bit = FLAC__lpc_restore_signal_wide_intrin_sse41;
+		}
+#  endif
+#  ifdef FLAC__PCLMUL_SUPPORTED
+		if (decoder->private_->cpuinfo.x86.pclmul && decoder->private_->cpuinfo.x86.ssse3) {
+			decoder->private_->local_crc16_functions = &FLAC__crc16_functions_intrin_pclmul;
+		}
+#  endif
+#  ifdef FLAC__AVX2_SUPPORTED
+		if (decoder->private_->cpuinfo.x86.avx2) {
+			decoder->private_->local_md5_format_input = FLAC__md5_format_input_intrin_avx2;
+			decoder->private_->local_fixed_restore_signal = FLAC__fixed_restore_signal_intrin_avx2;
+			decoder->private_->local_fixed_restore_signal_wide = FLAC__fixed_restore_signal_wide_intrin_avx2;
+			decoder->private_->local_lpc_restore_signal = FLAC__lpc_restore_signal_intrin_avx2;
+			decoder->private_->local_lpc_restore_signal_64bit = FLAC__lpc_restore_signal_wide_intrin_avx2;
+		}
+#  endif
+# endif /* FLAC__CPU_... */
+	}
+#endif /* !FLAC__NO_ASM && FLAC__HAS_X86INTRIN */
+#if !defined FLAC__NO_ASM && defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN
+	decoder->private_->local_lpc_restore_signal = FLAC__lpc_restore_signal_intrin_neon;
+	decoder->private_->local_lpc_restore_signal_64bit = FLAC__lpc_restore_signal_wide_intrin_neon;
+#endif
+#if !defined FLAC__NO_ASM && defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN && !WORDS_BIGENDIAN
+	decoder->private_->local_md5_format_input = FLAC__md5_format_input_intrin_neon;
+#endif
 
 	/* from here on, errors are fatal */
 
@@ -402,6 +660,7 @@ static FLAC__StreamDecoderInitStatus init_stream_internal_(
 		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 		return FLAC__STREAM_DECODER_INIT_STATUS_MEMORY_ALLOCATION_ERROR;
 	}
+	FLAC__bitreader_set_crc16_functions(decoder->private_->input, decoder->private_->local_crc16_functions);
 
 	decoder->private_->read_callback = read_callback;
 	decoder->private_->seek_callback = seek_callback;
@@ -420,6 +679,9 @@ static FLAC__StreamDecoderInitStatus init_stream_internal_(
 	decoder->private_->do_md5_checking = decoder->protected_->md5_checking;
 	decoder->private_->is_seeking = false;
 	decoder->private_->is_indexing = false;
+#ifdef FLAC__PROFILING
+	memset(&decoder->private_->profile, 0, sizeof(decoder->private_->profile));
+#endif
 
 	decoder->private_->internal_reset_hack = true; /* so the following reset does not try to rewind the input */
 	if(!FLAC__stream_decoder_reset(decoder)) {
@@ -502,7 +764,7 @@ static FLAC__StreamDecoderInitStatus init_FILE_internal_(
 	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
 		return decoder->protected_->initstate = FLAC__STREAM_DECODER_INIT_STATUS_ALREADY_INITIALIZED;
 
-	if(0 == write_callback || 0 == error_callback)
+	if((0 == write_callback && !decoder->protected_->pull_mode) || 0 == error_callback)
 		return decoder->protected_->initstate = FLAC__STREAM_DECODER_INIT_STATUS_INVALID_CALLBACKS;
 
 	/*
@@ -576,7 +838,7 @@ static FLAC__StreamDecoderInitStatus init_file_internal_(
 	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
 		return decoder->protected_->initstate = FLAC__STREAM_DECODER_INIT_STATUS_ALREADY_INITIALIZED;
 
-	if(0 == write_callback || 0 == error_callback)
+	if((0 == write_callback && !decoder->protected_->pull_mode) || 0 == error_callback)
 		return decoder->protected_->initstate = FLAC__STREAM_DECODER_INIT_STATUS_INVALID_CALLBACKS;
 
 	file = filename? flac_fopen(filename, "rb") : stdin;
@@ -611,6 +873,95 @@ FLAC_API FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_ogg_file(
 	return init_file_internal_(decoder, filename, write_callback, metadata_callback, error_callback, client_data, /*is_ogg=*/true);
 }
 
+static FLAC__StreamDecoderInitStatus init_mmap_internal_(
+	FLAC__StreamDecoder *decoder,
+	const char *filename,
+	FLAC__StreamDecoderWriteCallback write_callback,
+	FLAC__StreamDecoderMetadataCallback metadata_callback,
+	FLAC__StreamDecoderErrorCallback error_callback,
+	void *client_data,
+	FLAC__bool is_ogg
+)
+{
+#ifdef HAVE_SYS_MMAN_H
+	FILE *file;
+	struct flac_stat_s filestats;
+	void *data;
+
+	FLAC__ASSERT(0 != decoder);
+
+	/* see init_file_internal_() for why these checks are done here */
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return decoder->protected_->initstate = FLAC__STREAM_DECODER_INIT_STATUS_ALREADY_INITIALIZED;
+
+	if((0 == write_callback && !decoder->protected_->pull_mode) || 0 == error_callback)
+		return decoder->protected_->initstate = FLAC__STREAM_DECODER_INIT_STATUS_INVALID_CALLBACKS;
+
+	if(0 == filename)
+		return init_FILE_internal_(decoder, stdin, write_callback, metadata_callback, error_callback, client_data, is_ogg);
+
+	if(0 == (file = flac_fopen(filename, "rb")))
+		return FLAC__STREAM_DECODER_INIT_STATUS_ERROR_OPENING_FILE;
+
+	/* Anything that cannot be mapped, like an empty file, a pipe or a
+	 * file too large for the address space, is read the usual way */
+	if(
+		flac_fstat(fileno(file), &filestats) != 0 ||
+		filestats.st_size <= 0 ||
+		(FLAC__uint64)filestats.st_size > (FLAC__uint64)SIZE_MAX ||
+		MAP_FAILED == (data = mmap(0, (size_t)filestats.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0))
+	)
+		return init_FILE_internal_(decoder, file, write_callback, metadata_callback, error_callback, client_data, is_ogg);
+
+	/* the mapping stays valid after the file is closed */
+	fclose(file);
+
+	decoder->private_->mmap_data = (const FLAC__byte *)data;
+	decoder->private_->mmap_length = (size_t)filestats.st_size;
+	decoder->private_->mmap_position = 0;
+
+	return init_stream_internal_(
+		decoder,
+		mmap_read_callback_,
+		mmap_seek_callback_,
+		mmap_tell_callback_,
+		mmap_length_callback_,
+		mmap_eof_callback_,
+		write_callback,
+		metadata_callback,
+		error_callback,
+		client_data,
+		is_ogg
+	);
+#else
+	return init_file_internal_(decoder, filename, write_callback, metadata_callback, error_callback, client_data, is_ogg);
+#endif
+}
+
+FLAC_API FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_mmap(
+	FLAC__StreamDecoder *decoder,
+	const char *filename,
+	FLAC__StreamDecoderWriteCallback write_callback,
+	FLAC__StreamDecoderMetadataCallback metadata_callback,
+	FLAC__StreamDecoderErrorCallback error_callback,
+	void *client_data
+)
+{
+	return init_mmap_internal_(decoder, filename, write_callback, metadata_callback, error_callback, client_data, /*is_ogg=*/false);
+}
+
+FLAC_API FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_ogg_mmap(
+	FLAC__StreamDecoder *decoder,
+	const char *filename,
+	FLAC__StreamDecoderWriteCallback write_callback,
+	FLAC__StreamDecoderMetadataCallback metadata_callback,
+	FLAC__StreamDecoderErrorCallback error_callback,
+	void *client_data
+)
+{
+	return init_mmap_internal_(decoder, filename, write_callback, metadata_callback, error_callback, client_data, /*is_ogg=*/true);
+}
+
 FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder)
 {
 	FLAC__bool md5_failed = false;
@@ -626,6 +977,9 @@ FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder)
 	/* see the comment in FLAC__stream_decoder_reset() as to why we
 	 * always call FLAC__MD5Final()
 	 */
+#ifdef FLAC__USE_THREADS
+	finish_md5_thread_(decoder);
+#endif
 	FLAC__MD5Final(decoder->private_->computed_md5sum, &decoder->private_->md5context);
 
 	free(decoder->private_->seek_table.data.seek_table.points);
@@ -635,10 +989,9 @@ FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder)
 	FLAC__bitreader_free(decoder->private_->input);
 	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
 		/* WATCHOUT:
-		 * FLAC__lpc_restore_signal_asm_ia32_mmx() and ..._intrin_sseN()
-		 * require that the output arrays have a buffer of up to 3 zeroes
-		 * in front (at negative indices) for alignment purposes;
-		 * we use 4 to keep the data well-aligned.
+		 * the output arrays have 4 zeroes in front (at negative indices),
+		 * which keeps the data as well-aligned as the allocation itself.
+		 * The restore routines only read back to data[-order].
 		 */
 		if(0 != decoder->private_->output[i]) {
 			free(decoder->private_->output[i]-4);
@@ -655,6 +1008,8 @@ FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder)
 	}
 	decoder->private_->output_capacity = 0;
 	decoder->private_->output_channels = 0;
+	free_pull_fifo_(decoder);
+	free_frame_index_(decoder);
 
 #if FLAC__HAS_OGG
 	if(decoder->private_->is_ogg)
@@ -662,11 +1017,21 @@ FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder)
 #endif
 
 	if(0 != decoder->private_->file) {
+#ifdef FLAC__USE_THREADS
+		finish_prefetch_thread_(decoder);
+#endif
 		if(decoder->private_->file != stdin)
 			fclose(decoder->private_->file);
 		decoder->private_->file = 0;
 	}
 
+	if(0 != decoder->private_->mmap_data) {
+#ifdef HAVE_SYS_MMAN_H
+		munmap((void*)decoder->private_->mmap_data, decoder->private_->mmap_length);
+#endif
+		decoder->private_->mmap_data = 0;
+	}
+
 	if(decoder->private_->do_md5_checking) {
 		if(memcmp(decoder->private_->stream_info.data.stream_info.md5sum, decoder->private_->computed_md5sum, 16))
 			md5_failed = true;
@@ -723,6 +1088,97 @@ FLAC_API FLAC__bool FLAC__stream_decoder_set_md5_checking(FLAC__StreamDecoder *d
 	return true;
 }
 
+FLAC_API uint32_t FLAC__stream_decoder_set_num_threads(FLAC__StreamDecoder *decoder, uint32_t value)
+{
+#ifdef FLAC__USE_THREADS
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return FLAC__STREAM_DECODER_SET_NUM_THREADS_ALREADY_INITIALIZED;
+	if(value > FLAC__STREAM_DECODER_MAX_THREADS)
+		return FLAC__STREAM_DECODER_SET_NUM_THREADS_TOO_MANY_THREADS;
+	if(value == 0)
+		decoder->protected_->num_threads = 1;
+	else
+		decoder->protected_->num_threads = value;
+	return FLAC__STREAM_DECODER_SET_NUM_THREADS_OK;
+#else
+	(void)decoder;
+	(void)value;
+	return FLAC__STREAM_DECODER_SET_NUM_THREADS_NOT_COMPILED_WITH_MULTITHREADING_ENABLED;
+#endif
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_interleaved_output(FLAC__StreamDecoder *decoder, FLAC__StreamDecoderPCMFormat format, void *buffer, size_t buffer_size)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	if((uint32_t)format > FLAC__STREAM_DECODER_PCM_FORMAT_FLOAT)
+		return false;
+	decoder->private_->pcm_format = format;
+	decoder->private_->pcm_buffer = buffer;
+	decoder->private_->pcm_buffer_size = buffer_size;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_pull_mode(FLAC__StreamDecoder *decoder, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	decoder->protected_->pull_mode = value;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_build_frame_index(FLAC__StreamDecoder *decoder, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	decoder->protected_->build_frame_index = value;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_prefetch_buffers(FLAC__StreamDecoder *decoder, uint32_t num_buffers)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	if(num_buffers > FLAC__STREAM_DECODER_MAX_PREFETCH_BUFFERS)
+		return false;
+	decoder->protected_->prefetch_buffers = num_buffers;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_frame_index(FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *frame_index)
+{
+	FLAC__StreamMetadata_SeekTable *index;
+
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+
+	if(0 != frame_index && (frame_index->type != FLAC__METADATA_TYPE_SEEKTABLE || !FLAC__format_seektable_is_legal(&frame_index->data.seek_table)))
+		return false;
+
+	index = &decoder->private_->frame_index.data.seek_table;
+	index->num_points = 0;
+	decoder->private_->frame_index.length = 0;
+	memset(decoder->private_->frame_index_md5sum, 0, sizeof(decoder->private_->frame_index_md5sum));
+	if(0 == frame_index || 0 == frame_index->data.seek_table.num_points)
+		return true;
+
+	if(!grow_frame_index_(decoder, frame_index->data.seek_table.num_points))
+		return false;
+	memcpy(index->points, frame_index->data.seek_table.points, frame_index->data.seek_table.num_points * sizeof(FLAC__StreamMetadata_SeekPoint));
+	index->num_points = frame_index->data.seek_table.num_points;
+	decoder->private_->frame_index.length = index->num_points * FLAC__STREAM_METADATA_SEEKPOINT_LENGTH;
+	return true;
+}
+
 FLAC_API FLAC__bool FLAC__stream_decoder_set_metadata_respond(FLAC__StreamDecoder *decoder, FLAC__MetadataType type)
 {
 	FLAC__ASSERT(0 != decoder);
@@ -858,6 +1314,43 @@ FLAC_API FLAC__bool FLAC__stream_decoder_get_md5_checking(const FLAC__StreamDeco
 	return decoder->protected_->md5_checking;
 }
 
+FLAC_API uint32_t FLAC__stream_decoder_get_num_threads(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->num_threads;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_get_pull_mode(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->pull_mode;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_get_build_frame_index(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->build_frame_index;
+}
+
+FLAC_API uint32_t FLAC__stream_decoder_get_prefetch_buffers(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->prefetch_buffers;
+}
+
+FLAC_API const FLAC__StreamMetadata *FLAC__stream_decoder_get_frame_index(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	if(decoder->private_->frame_index.data.seek_table.num_points == 0)
+		return 0;
+	return &decoder->private_->frame_index;
+}
+
 FLAC_API FLAC__uint64 FLAC__stream_decoder_get_total_samples(const FLAC__StreamDecoder *decoder)
 {
 	FLAC__ASSERT(0 != decoder);
@@ -909,6 +1402,14 @@ FLAC_API FLAC__bool FLAC__stream_decoder_get_decode_position(const FLAC__StreamD
 	if(FLAC__HAS_OGG && decoder->private_->is_ogg)
 		return false;
 
+#ifdef FLAC__USE_THREADS
+	/* when decoding with threadtasks, the input has been read far beyond the frame being passed to the client */
+	if(decoder->private_->threadtask_position_valid) {
+		*position = decoder->private_->threadtask_position;
+		return true;
+	}
+#endif
+
 	if(0 == decoder->private_->tell_callback)
 		return false;
 	if(decoder->private_->tell_callback(decoder, position, decoder->private_->client_data) != FLAC__STREAM_DECODER_TELL_STATUS_OK)
@@ -926,6 +1427,21 @@ FLAC_API const void *FLAC__stream_decoder_get_client_data(FLAC__StreamDecoder *d
 	return decoder->private_->client_data;
 }
 
+FLAC_API FLAC__bool FLAC__stream_decoder_get_profile(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderProfile *profile)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != profile);
+#ifdef FLAC__PROFILING
+	*profile = decoder->private_->profile;
+	return true;
+#else
+	(void)decoder;
+	memset(profile, 0, sizeof(*profile));
+	return false;
+#endif
+}
+
 FLAC_API FLAC__bool FLAC__stream_decoder_flush(FLAC__StreamDecoder *decoder)
 {
 	FLAC__ASSERT(0 != decoder);
@@ -941,6 +1457,7 @@ FLAC_API FLAC__bool FLAC__stream_decoder_flush(FLAC__StreamDecoder *decoder)
 	decoder->private_->do_md5_checking = false;
 	decoder->private_->last_seen_framesync = 0;
 	decoder->private_->last_frame_is_set = false;
+	decoder->private_->pull_fifo_size = 0;
 
 #if FLAC__HAS_OGG
 	if(decoder->private_->is_ogg)
@@ -984,11 +1501,15 @@ void reset_decoder_internal_(FLAC__StreamDecoder* decoder) {
 	if(!decoder->private_->internal_reset_hack) {
 		/* Only finish MD5 context when it has been initialized
 		 * (i.e. when internal_reset_hack is not set) */
+#ifdef FLAC__USE_THREADS
+		finish_md5_thread_(decoder);
+#endif
 		FLAC__MD5Final(decoder->private_->computed_md5sum, &decoder->private_->md5context);
 	}
 	else
 		decoder->private_->internal_reset_hack = false;
 	FLAC__MD5Init(&decoder->private_->md5context);
+	decoder->private_->md5context.format_input = decoder->private_->local_md5_format_input;
 
 	decoder->private_->first_frame_offset = 0;
 	decoder->private_->unparseable_frame_count = 0;
@@ -1144,6 +1665,9 @@ FLAC_API FLAC__bool FLAC__stream_decoder_finish_link(FLAC__StreamDecoder *decode
 		return true;
 	}
 
+#ifdef FLAC__USE_THREADS
+	finish_md5_thread_(decoder);
+#endif
 	FLAC__MD5Final(decoder->private_->computed_md5sum, &decoder->private_->md5context);
 
 	if(decoder->private_->do_md5_checking) {
@@ -1178,6 +1702,13 @@ FLAC_API FLAC__bool FLAC__stream_decoder_process_until_end_of_stream(FLAC__Strea
 					return false; /* above function sets the status for us */
 				break;
 			case FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC:
+#ifdef FLAC__USE_THREADS
+				if(decoder->protected_->num_threads > 1 && !decoder->private_->is_ogg && decoder->private_->has_stream_info && !decoder->private_->is_seeking) {
+					if(!process_frames_threaded_(decoder))
+						return false; /* above function sets the status for us */
+					break;
+				}
+#endif
 				if(!frame_sync_(decoder) && decoder->protected_->state != FLAC__STREAM_DECODER_END_OF_LINK && decoder->protected_->state != FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR) {
 					return true; /* above function sets the status for us */
 				}
@@ -1267,6 +1798,9 @@ FLAC_API FLAC__bool FLAC__stream_decoder_skip_single_link(FLAC__StreamDecoder *d
 		return false;
 	}
 	else {
+#ifdef FLAC__USE_THREADS
+		finish_md5_thread_(decoder);
+#endif
 		FLAC__MD5Final(decoder->private_->computed_md5sum, &decoder->private_->md5context);
 		reset_decoder_internal_(decoder);
 	}
@@ -1306,6 +1840,7 @@ FLAC_API FLAC__bool FLAC__stream_decoder_seek_absolute(FLAC__StreamDecoder *deco
 		return false;
 
 	decoder->private_->is_seeking = true;
+	decoder->private_->pull_fifo_size = 0;
 
 	/* turn off md5 checking if a seek is attempted */
 	decoder->private_->do_md5_checking = false;
@@ -1346,51 +1881,206 @@ FLAC_API FLAC__bool FLAC__stream_decoder_seek_absolute(FLAC__StreamDecoder *deco
 	}
 }
 
-FLAC_API FLAC__uint64 FLAC__stream_decoder_find_total_samples(FLAC__StreamDecoder *decoder)
+FLAC_API uint32_t FLAC__stream_decoder_read_samples(FLAC__StreamDecoder *decoder, FLAC__StreamDecoderPCMFormat format, void *buffer, uint32_t samples)
 {
-	if(
-		decoder->protected_->state != FLAC__STREAM_DECODER_SEARCH_FOR_METADATA &&
-		decoder->protected_->state != FLAC__STREAM_DECODER_READ_METADATA &&
-		decoder->protected_->state != FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC &&
-		decoder->protected_->state != FLAC__STREAM_DECODER_READ_FRAME &&
-		decoder->protected_->state != FLAC__STREAM_DECODER_END_OF_STREAM
-	)
-		return 0;
+	uint32_t bytes_per_sample, max_bps;
 
-	if(
-		decoder->private_->length_callback == NULL ||
-		decoder->private_->seek_callback == NULL ||
-		decoder->private_->tell_callback == NULL
-	)
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != decoder->protected_);
+	FLAC__ASSERT(0 != buffer);
+
+	if(!decoder->protected_->pull_mode || decoder->protected_->state == FLAC__STREAM_DECODER_UNINITIALIZED)
+		return 0;
+	if(0 == (bytes_per_sample = pcm_format_bytes_per_sample_(format, &max_bps)))
 		return 0;
 
-#if FLAC__HAS_OGG
-	if(decoder->private_->is_ogg && FLAC__ogg_decoder_aspect_get_decode_chained_stream(&decoder->protected_->ogg_decoder_aspect)) {
-		/* Keep moving forward until reaching end-of-stream */
-		uint32_t i;
-		FLAC__uint64 total_samples = 0;
-		decoder->private_->is_indexing = true;
-		while(1) {
-			FLAC__OggDecoderAspectReadStatus status;
-			if(decoder->protected_->state == FLAC__STREAM_DECODER_END_OF_STREAM ||
-			   decoder->protected_->state == FLAC__STREAM_DECODER_OGG_ERROR ||
-			   decoder->protected_->state == FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR ||
-			   decoder->protected_->state == FLAC__STREAM_DECODER_ABORTED) {
-				decoder->private_->is_indexing = false;
-				decoder->protected_->state = FLAC__STREAM_DECODER_SEEK_ERROR;
-				return 0;
-			}
-			status = FLAC__ogg_decoder_aspect_skip_link(&decoder->protected_->ogg_decoder_aspect, read_callback_proxy_, decoder->private_->seek_callback, decoder->private_->tell_callback, decoder->private_->length_callback, decoder, decoder->private_->client_data);
-			if(status == FLAC__OGG_DECODER_ASPECT_READ_STATUS_END_OF_STREAM)
-				break;
-			else if(status != FLAC__OGG_DECODER_ASPECT_READ_STATUS_OK) {
-				decoder->protected_->state = FLAC__STREAM_DECODER_SEEK_ERROR;
-				return 0;
-			}
-		}
-		decoder->private_->is_indexing = false;
-		for(i = 0; i < decoder->protected_->ogg_decoder_aspect.number_of_links_indexed; i++) {
-			total_samples += decoder->protected_->ogg_decoder_aspect.linkdetails[i].samples;
+	decoder->private_->pull_format = format;
+	decoder->private_->pull_samples = samples;
+	decoder->private_->pull_samples_done = 0;
+	decoder->private_->pull_channels = 0;
+
+	/* first return what is left of the last frame */
+	if(decoder->private_->pull_fifo_size > 0) {
+		const uint32_t channels = decoder->private_->pull_fifo_channels;
+		const uint32_t n = flac_min(decoder->private_->pull_fifo_size, samples);
+		const FLAC__int32 *signal[FLAC__MAX_CHANNELS];
+		uint32_t channel;
+
+		if(decoder->private_->pull_fifo_bps > max_bps) {
+			decoder->protected_->state = FLAC__STREAM_DECODER_ABORTED;
+			return 0;
+		}
+		for(channel = 0; channel < channels; channel++)
+			signal[channel] = decoder->private_->pull_fifo[channel] + decoder->private_->pull_fifo_start;
+		pack_interleaved_(decoder, format, buffer, signal, channels, n, decoder->private_->pull_fifo_bps);
+		decoder->private_->pull_fifo_start += n;
+		decoder->private_->pull_fifo_size -= n;
+		decoder->private_->pull_samples_done = n;
+		decoder->private_->pull_channels = channels;
+	}
+
+	/* then decode straight into the buffer until it is full; whatever
+	 * does not fit of the last frame, or does not match the number of
+	 * channels, ends up in pull_fifo */
+	decoder->private_->pull_buffer = buffer;
+	while(
+		decoder->private_->pull_samples_done < samples &&
+		decoder->private_->pull_fifo_size == 0 &&
+		decoder->protected_->state <= FLAC__STREAM_DECODER_READ_FRAME
+	) {
+		if(!FLAC__stream_decoder_process_single(decoder))
+			break;
+	}
+	decoder->private_->pull_buffer = 0;
+
+	return decoder->private_->pull_samples_done;
+}
+
+/* A frame index sidecar file consists of this magic number, the MD5
+ * signature of the stream, the number of seek points as a 32-bit
+ * big-endian number, and the seek points as they are stored in a
+ * SEEKTABLE metadata block.
+ */
+static const FLAC__byte frame_index_magic_[4] = { 'f', 'L', 'a', 'I' };
+
+FLAC_API FLAC__bool FLAC__stream_decoder_save_frame_index(const FLAC__StreamDecoder *decoder, const char *filename)
+{
+	const FLAC__StreamMetadata_SeekTable *index;
+	FLAC__byte buffer[FLAC__STREAM_METADATA_SEEKPOINT_LENGTH];
+	FILE *file;
+	uint32_t i;
+	int j;
+	FLAC__bool ok;
+
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != filename);
+
+	index = &decoder->private_->frame_index.data.seek_table;
+	if(index->num_points == 0)
+		return false;
+	if(0 == (file = flac_fopen(filename, "wb")))
+		return false;
+
+	for(j = 0; j < 4; j++)
+		buffer[j] = (FLAC__byte)(index->num_points >> (24 - 8*j));
+	ok =
+		fwrite(frame_index_magic_, 1, sizeof(frame_index_magic_), file) == sizeof(frame_index_magic_) &&
+		fwrite(decoder->private_->has_stream_info? decoder->private_->stream_info.data.stream_info.md5sum : decoder->private_->frame_index_md5sum, 1, 16, file) == 16 &&
+		fwrite(buffer, 1, 4, file) == 4;
+	for(i = 0; ok && i < index->num_points; i++) {
+		for(j = 0; j < 8; j++) {
+			buffer[j] = (FLAC__byte)(index->points[i].sample_number >> (56 - 8*j));
+			buffer[8+j] = (FLAC__byte)(index->points[i].stream_offset >> (56 - 8*j));
+		}
+		buffer[16] = (FLAC__byte)(index->points[i].frame_samples >> 8);
+		buffer[17] = (FLAC__byte)index->points[i].frame_samples;
+		ok = fwrite(buffer, 1, FLAC__STREAM_METADATA_SEEKPOINT_LENGTH, file) == FLAC__STREAM_METADATA_SEEKPOINT_LENGTH;
+	}
+
+	if(fclose(file) != 0)
+		ok = false;
+	return ok;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_load_frame_index(FLAC__StreamDecoder *decoder, const char *filename)
+{
+	FLAC__StreamMetadata_SeekTable *index;
+	FLAC__byte header[sizeof(frame_index_magic_) + 16 + 4], buffer[FLAC__STREAM_METADATA_SEEKPOINT_LENGTH];
+	FILE *file;
+	uint32_t num_points, i;
+	int j;
+
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != filename);
+
+	if(0 == (file = flac_fopen(filename, "rb")))
+		return false;
+	if(fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, frame_index_magic_, sizeof(frame_index_magic_))) {
+		fclose(file);
+		return false;
+	}
+
+	index = &decoder->private_->frame_index.data.seek_table;
+	index->num_points = 0;
+	decoder->private_->frame_index.length = 0;
+	num_points = (FLAC__uint32)header[20] << 24 | (FLAC__uint32)header[21] << 16 | (FLAC__uint32)header[22] << 8 | (FLAC__uint32)header[23];
+	/* grow the index while reading, so a corrupt number of points does not cause a huge allocation */
+	for(i = 0; i < num_points; i++) {
+		if(fread(buffer, 1, FLAC__STREAM_METADATA_SEEKPOINT_LENGTH, file) != FLAC__STREAM_METADATA_SEEKPOINT_LENGTH || !grow_frame_index_(decoder, i + 1)) {
+			fclose(file);
+			return false;
+		}
+		index->points[i].sample_number = 0;
+		index->points[i].stream_offset = 0;
+		for(j = 0; j < 8; j++) {
+			index->points[i].sample_number = index->points[i].sample_number << 8 | buffer[j];
+			index->points[i].stream_offset = index->points[i].stream_offset << 8 | buffer[8+j];
+		}
+		index->points[i].frame_samples = (uint32_t)buffer[16] << 8 | buffer[17];
+	}
+	fclose(file);
+
+	index->num_points = num_points;
+	if(!FLAC__format_seektable_is_legal(index)) {
+		index->num_points = 0;
+		return false;
+	}
+	decoder->private_->frame_index.length = num_points * FLAC__STREAM_METADATA_SEEKPOINT_LENGTH;
+	memcpy(decoder->private_->frame_index_md5sum, header + sizeof(frame_index_magic_), 16);
+
+	if(decoder->private_->has_stream_info)
+		return check_frame_index_md5sum_(decoder);
+	return true;
+}
+
+FLAC_API FLAC__uint64 FLAC__stream_decoder_find_total_samples(FLAC__StreamDecoder *decoder)
+{
+	if(
+		decoder->protected_->state != FLAC__STREAM_DECODER_SEARCH_FOR_METADATA &&
+		decoder->protected_->state != FLAC__STREAM_DECODER_READ_METADATA &&
+		decoder->protected_->state != FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC &&
+		decoder->protected_->state != FLAC__STREAM_DECODER_READ_FRAME &&
+		decoder->protected_->state != FLAC__STREAM_DECODER_END_OF_STREAM
+	)
+		return 0;
+
+	if(
+		decoder->private_->length_callback == NULL ||
+		decoder->private_->seek_callback == NULL ||
+		decoder->private_->tell_callback == NULL
+	)
+		return 0;
+
+#if FLAC__HAS_OGG
+	if(decoder->private_->is_ogg && FLAC__ogg_decoder_aspect_get_decode_chained_stream(&decoder->protected_->ogg_decoder_aspect)) {
+		/* Keep moving forward until reaching end-of-stream */
+		uint32_t i;
+		FLAC__uint64 total_samples = 0;
+		decoder->private_->is_indexing = true;
+		while(1) {
+			FLAC__OggDecoderAspectReadStatus status;
+			if(decoder->protected_->state == FLAC__STREAM_DECODER_END_OF_STREAM ||
+			   decoder->protected_->state == FLAC__STREAM_DECODER_OGG_ERROR ||
+			   decoder->protected_->state == FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR ||
+			   decoder->protected_->state == FLAC__STREAM_DECODER_ABORTED) {
+				decoder->private_->is_indexing = false;
+				decoder->protected_->state = FLAC__STREAM_DECODER_SEEK_ERROR;
+				return 0;
+			}
+			status = FLAC__ogg_decoder_aspect_skip_link(&decoder->protected_->ogg_decoder_aspect, read_callback_proxy_, decoder->private_->seek_callback, decoder->private_->tell_callback, decoder->private_->length_callback, decoder, decoder->private_->client_data);
+			if(status == FLAC__OGG_DECODER_ASPECT_READ_STATUS_END_OF_STREAM)
+				break;
+			else if(status != FLAC__OGG_DECODER_ASPECT_READ_STATUS_OK) {
+				decoder->protected_->state = FLAC__STREAM_DECODER_SEEK_ERROR;
+				return 0;
+			}
+		}
+		decoder->private_->is_indexing = false;
+		for(i = 0; i < decoder->protected_->ogg_decoder_aspect.number_of_links_indexed; i++) {
+			total_samples += decoder->protected_->ogg_decoder_aspect.linkdetails[i].samples;
 		}
 		return total_samples;
 	}
@@ -1540,12 +2230,19 @@ void set_defaults_(FLAC__StreamDecoder *decoder)
 	decoder->private_->metadata_callback = 0;
 	decoder->private_->error_callback = 0;
 	decoder->private_->client_data = 0;
+	decoder->private_->pcm_format = FLAC__STREAM_DECODER_PCM_FORMAT_S16LE;
+	decoder->private_->pcm_buffer = 0;
+	decoder->private_->pcm_buffer_size = 0;
 
 	memset(decoder->private_->metadata_filter, 0, sizeof(decoder->private_->metadata_filter));
 	decoder->private_->metadata_filter[FLAC__METADATA_TYPE_STREAMINFO] = true;
 	decoder->private_->metadata_filter_ids_count = 0;
 
 	decoder->protected_->md5_checking = false;
+	decoder->protected_->num_threads = 1;
+	decoder->protected_->pull_mode = false;
+	decoder->protected_->build_frame_index = false;
+	decoder->protected_->prefetch_buffers = 0;
 
 #if FLAC__HAS_OGG
 	FLAC__ogg_decoder_aspect_set_defaults(&decoder->protected_->ogg_decoder_aspect);
@@ -1604,10 +2301,9 @@ FLAC__bool allocate_output_(FLAC__StreamDecoder *decoder, uint32_t size, uint32_
 
 	for(i = 0; i < channels; i++) {
 		/* WATCHOUT:
-		 * FLAC__lpc_restore_signal_asm_ia32_mmx() and ..._intrin_sseN()
-		 * require that the output arrays have a buffer of up to 3 zeroes
-		 * in front (at negative indices) for alignment purposes;
-		 * we use 4 to keep the data well-aligned.
+		 * the output arrays have 4 zeroes in front (at negative indices),
+		 * which keeps the data as well-aligned as the allocation itself.
+		 * The restore routines only read back to data[-order].
 		 */
 		tmp = safe_malloc_muladd2_(sizeof(FLAC__int32), /*times (*/size, /*+*/4/*)*/);
 		if(tmp == 0) {
@@ -1740,6 +2436,7 @@ FLAC__bool read_metadata_(FLAC__StreamDecoder *decoder)
 		decoder->private_->has_stream_info = true;
 		if(0 == memcmp(decoder->private_->stream_info.data.stream_info.md5sum, "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 16))
 			decoder->private_->do_md5_checking = false;
+		(void)check_frame_index_md5sum_(decoder);
 		if(!decoder->private_->is_seeking && decoder->private_->metadata_filter[FLAC__METADATA_TYPE_STREAMINFO] && decoder->private_->metadata_callback)
 			decoder->private_->metadata_callback(decoder, &decoder->private_->stream_info, decoder->private_->client_data);
 	}
@@ -2323,10 +3020,14 @@ FLAC__bool frame_sync_(FLAC__StreamDecoder *decoder)
 	FLAC__uint32 x;
 	FLAC__bool first = true;
 
+	FLAC__PROFILE_START(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_SYNC);
+
 	/* make sure we're byte aligned */
 	if(!FLAC__bitreader_is_consumed_byte_aligned(decoder->private_->input)) {
-		if(!FLAC__bitreader_read_raw_uint32(decoder->private_->input, &x, FLAC__bitreader_bits_left_for_byte_alignment(decoder->private_->input)))
+		if(!FLAC__bitreader_read_raw_uint32(decoder->private_->input, &x, FLAC__bitreader_bits_left_for_byte_alignment(decoder->private_->input))) {
+			FLAC__PROFILE_STOP(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_SYNC);
 			return false; /* read_callback_ sets the state for us */
+		}
 	}
 
 	while(1) {
@@ -2335,13 +3036,17 @@ FLAC__bool frame_sync_(FLAC__StreamDecoder *decoder)
 			decoder->private_->cached = false;
 		}
 		else {
-			if(!FLAC__bitreader_read_raw_uint32(decoder->private_->input, &x, 8))
+			if(!FLAC__bitreader_read_raw_uint32(decoder->private_->input, &x, 8)) {
+				FLAC__PROFILE_STOP(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_SYNC);
 				return false; /* read_callback_ sets the state for us */
+			}
 		}
 		if(x == 0xff) { /* MAGIC NUMBER for the first 8 frame sync bits */
 			decoder->private_->header_warmup[0] = (FLAC__byte)x;
-			if(!FLAC__bitreader_read_raw_uint32(decoder->private_->input, &x, 8))
+			if(!FLAC__bitreader_read_raw_uint32(decoder->private_->input, &x, 8)) {
+				FLAC__PROFILE_STOP(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_SYNC);
 				return false; /* read_callback_ sets the state for us */
+			}
 
 			/* we have to check if we just read two 0xff's in a row; the second may actually be the beginning of the sync code */
 			/* else we have to check if the second byte is the end of a sync code */
@@ -2358,6 +3063,7 @@ FLAC__bool frame_sync_(FLAC__StreamDecoder *decoder)
 				FLAC__bitreader_set_framesync_location(decoder->private_->input);
 				if(!FLAC__stream_decoder_get_decode_position(decoder, &decoder->private_->last_seen_framesync))
 					decoder->private_->last_seen_framesync = 0;
+				FLAC__PROFILE_STOP(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_SYNC);
 				return true;
 			}
 		}
@@ -2376,6 +3082,7 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 	uint32_t i;
 	uint32_t frame_crc; /* the one we calculate from the input stream */
 	FLAC__uint32 x;
+	FLAC__bool ok;
 
 	*got_a_frame = false;
 	decoder->private_->side_subframe_in_use = false;
@@ -2386,7 +3093,10 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 	frame_crc = FLAC__CRC16_UPDATE(decoder->private_->header_warmup[1], frame_crc);
 	FLAC__bitreader_reset_read_crc16(decoder->private_->input, (FLAC__uint16)frame_crc);
 
-	if(!read_frame_header_(decoder))
+	FLAC__PROFILE_START(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_HEADER);
+	ok = read_frame_header_(decoder);
+	FLAC__PROFILE_STOP(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_HEADER);
+	if(!ok)
 		return false;
 	if(decoder->protected_->state == FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC) /* means we didn't sync on a valid header */
 		return true;
@@ -2453,7 +3163,9 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 #endif
 		if(do_full_decode) {
 			/* Undo any special channel coding */
+			FLAC__PROFILE_START(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_DECORRELATION);
 			undo_channel_coding(decoder);
+			FLAC__PROFILE_STOP(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_DECORRELATION);
 			/* Check whether decoded data actually fits bps */
 			for(channel = 0; channel < decoder->private_->frame.header.channels; channel++) {
 				int shift_bits = 32 - decoder->private_->frame.header.bits_per_sample;
@@ -2482,75 +3194,8 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 
 	/* Check whether frames are missing, if so, add silence to compensate */
 	if(decoder->private_->last_frame_is_set && decoder->protected_->state == FLAC__STREAM_DECODER_READ_FRAME && !decoder->private_->is_seeking && do_full_decode) {
-		FLAC__ASSERT(decoder->private_->frame.header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
-		FLAC__ASSERT(decoder->private_->last_frame.header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
-		if(decoder->private_->last_frame.header.number.sample_number + decoder->private_->last_frame.header.blocksize < decoder->private_->frame.header.number.sample_number) {
-			uint32_t padding_samples_needed = decoder->private_->frame.header.number.sample_number - (decoder->private_->last_frame.header.number.sample_number + decoder->private_->last_frame.header.blocksize);
-			/* Send an error that we lost sync, but only in case no error
-			 * has been sent yet. This is the case if exactly one or more
-			 * frames are missing, and the frames before and after it
-			 * are complete */
-			if(!decoder->private_->error_has_been_sent)
-				send_error_to_client_(decoder, FLAC__STREAM_DECODER_ERROR_STATUS_MISSING_FRAME);
-			/* Do some extra validation to assure last frame an current frame
-			 * header are both valid before adding silence inbetween
-			 * Technically both frames could be valid with differing sample_rates,
-			 * channels and bits_per_sample, but it is quite rare */
-			if(decoder->private_->last_frame.header.sample_rate == decoder->private_->frame.header.sample_rate &&
-			   decoder->private_->last_frame.header.channels == decoder->private_->frame.header.channels &&
-			   decoder->private_->last_frame.header.bits_per_sample == decoder->private_->frame.header.bits_per_sample &&
-			   decoder->private_->last_frame.header.blocksize >= 16) {
-				FLAC__Frame empty_frame;
-				FLAC__int32 * empty_buffer[FLAC__MAX_CHANNELS] = {NULL};
-				empty_frame.header = decoder->private_->last_frame.header;
-				empty_frame.footer.crc = 0;
-				for(i = 0; i < empty_frame.header.channels; i++) {
-					empty_buffer[i] = safe_calloc_(empty_frame.header.blocksize, sizeof(FLAC__int32));
-					if(empty_buffer[i] == NULL) {
-						for(i = 0; i < empty_frame.header.channels; i++)
-							if(empty_buffer[i] != NULL)
-								free(empty_buffer[i]);
-						decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
-						return false;
-					}
-				}
-				/* No repairs larger than 5 seconds or 50 frames are made, to not
-				 * unexpectedly create enormous files when one of the headers was
-				 * corrupt after all */
-				if(padding_samples_needed > (5*empty_frame.header.sample_rate))
-					padding_samples_needed = 5*empty_frame.header.sample_rate;
-				if(padding_samples_needed > (50*empty_frame.header.blocksize))
-					padding_samples_needed = 50*empty_frame.header.blocksize;
-				while(padding_samples_needed){
-					empty_frame.header.number.sample_number += empty_frame.header.blocksize;
-					if(padding_samples_needed < empty_frame.header.blocksize)
-						empty_frame.header.blocksize = padding_samples_needed;
-					padding_samples_needed -= empty_frame.header.blocksize;
-					decoder->protected_->blocksize = empty_frame.header.blocksize;
-
-					FLAC__ASSERT(empty_frame.header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
-					decoder->private_->samples_decoded = empty_frame.header.number.sample_number + empty_frame.header.blocksize;
-
-					for(channel = 0; channel < empty_frame.header.channels; channel++) {
-						empty_frame.subframes[channel].type = FLAC__SUBFRAME_TYPE_CONSTANT;
-						empty_frame.subframes[channel].data.constant.value = 0;
-						empty_frame.subframes[channel].wasted_bits = 0;
-					}
-
-					if(write_audio_frame_to_client_(decoder, &empty_frame, (const FLAC__int32 * const *)empty_buffer) != FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE) {
-						decoder->protected_->state = FLAC__STREAM_DECODER_ABORTED;
-						for(i = 0; i < empty_frame.header.channels; i++)
-							if(empty_buffer[i] != NULL)
-								free(empty_buffer[i]);
-						return false;
-					}
-				}
-				for(i = 0; i < empty_frame.header.channels; i++)
-					if(empty_buffer[i] != NULL)
-						free(empty_buffer[i]);
-
-			}
-		}
+		if(!write_missing_frames_to_client_(decoder, &decoder->private_->frame.header))
+			return false; /* above function sets the status for us */
 	}
 
 	decoder->private_->error_has_been_sent = false;
@@ -2598,15 +3243,13 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 		if(decoder->private_->next_fixed_block_size)
 			decoder->private_->fixed_block_size = decoder->private_->next_fixed_block_size;
 
-		/* put the latest values into the public section of the decoder instance */
-		decoder->protected_->channels = decoder->private_->frame.header.channels;
-		decoder->protected_->channel_assignment = decoder->private_->frame.header.channel_assignment;
-		decoder->protected_->bits_per_sample = decoder->private_->frame.header.bits_per_sample;
-		decoder->protected_->sample_rate = decoder->private_->frame.header.sample_rate;
-		decoder->protected_->blocksize = decoder->private_->frame.header.blocksize;
+		update_stream_properties_(decoder, &decoder->private_->frame.header);
 
-		FLAC__ASSERT(decoder->private_->frame.header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
-		decoder->private_->samples_decoded = decoder->private_->frame.header.number.sample_number + decoder->private_->frame.header.blocksize;
+		/* last_seen_framesync is the position right after the 2 bytes of sync code */
+		if(decoder->protected_->build_frame_index && decoder->private_->last_seen_framesync >= 2) {
+			if(!add_frame_to_index_(decoder, &decoder->private_->frame.header, decoder->private_->last_seen_framesync - 2))
+				return false; /* above function sets the status for us */
+		}
 
 		/* write it */
 		if(do_full_decode) {
@@ -2621,6 +3264,96 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 	return true;
 }
 
+FLAC__bool write_missing_frames_to_client_(FLAC__StreamDecoder *decoder, const FLAC__FrameHeader *header)
+{
+	uint32_t channel;
+	uint32_t i;
+
+	FLAC__ASSERT(header->number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
+	FLAC__ASSERT(decoder->private_->last_frame.header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
+	if(decoder->private_->last_frame.header.number.sample_number + decoder->private_->last_frame.header.blocksize < header->number.sample_number) {
+		uint32_t padding_samples_needed = header->number.sample_number - (decoder->private_->last_frame.header.number.sample_number + decoder->private_->last_frame.header.blocksize);
+		/* Send an error that we lost sync, but only in case no error
+		 * has been sent yet. This is the case if exactly one or more
+		 * frames are missing, and the frames before and after it
+		 * are complete */
+		if(!decoder->private_->error_has_been_sent)
+			send_error_to_client_(decoder, FLAC__STREAM_DECODER_ERROR_STATUS_MISSING_FRAME);
+		/* Do some extra validation to assure last frame an current frame
+		 * header are both valid before adding silence inbetween
+		 * Technically both frames could be valid with differing sample_rates,
+		 * channels and bits_per_sample, but it is quite rare */
+		if(decoder->private_->last_frame.header.sample_rate == header->sample_rate &&
+		   decoder->private_->last_frame.header.channels == header->channels &&
+		   decoder->private_->last_frame.header.bits_per_sample == header->bits_per_sample &&
+		   decoder->private_->last_frame.header.blocksize >= 16) {
+			FLAC__Frame empty_frame;
+			FLAC__int32 * empty_buffer[FLAC__MAX_CHANNELS] = {NULL};
+			empty_frame.header = decoder->private_->last_frame.header;
+			empty_frame.footer.crc = 0;
+			for(i = 0; i < empty_frame.header.channels; i++) {
+				empty_buffer[i] = safe_calloc_(empty_frame.header.blocksize, sizeof(FLAC__int32));
+				if(empty_buffer[i] == NULL) {
+					for(i = 0; i < empty_frame.header.channels; i++)
+						if(empty_buffer[i] != NULL)
+							free(empty_buffer[i]);
+					decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+					return false;
+				}
+			}
+			/* No repairs larger than 5 seconds or 50 frames are made, to not
+			 * unexpectedly create enormous files when one of the headers was
+			 * corrupt after all */
+			if(padding_samples_needed > (5*empty_frame.header.sample_rate))
+				padding_samples_needed = 5*empty_frame.header.sample_rate;
+			if(padding_samples_needed > (50*empty_frame.header.blocksize))
+				padding_samples_needed = 50*empty_frame.header.blocksize;
+			while(padding_samples_needed){
+				empty_frame.header.number.sample_number += empty_frame.header.blocksize;
+				if(padding_samples_needed < empty_frame.header.blocksize)
+					empty_frame.header.blocksize = padding_samples_needed;
+				padding_samples_needed -= empty_frame.header.blocksize;
+				decoder->protected_->blocksize = empty_frame.header.blocksize;
+
+				FLAC__ASSERT(empty_frame.header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
+				decoder->private_->samples_decoded = empty_frame.header.number.sample_number + empty_frame.header.blocksize;
+
+				for(channel = 0; channel < empty_frame.header.channels; channel++) {
+					empty_frame.subframes[channel].type = FLAC__SUBFRAME_TYPE_CONSTANT;
+					empty_frame.subframes[channel].data.constant.value = 0;
+					empty_frame.subframes[channel].wasted_bits = 0;
+				}
+
+				if(write_audio_frame_to_client_(decoder, &empty_frame, (const FLAC__int32 * const *)empty_buffer) != FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE) {
+					decoder->protected_->state = FLAC__STREAM_DECODER_ABORTED;
+					for(i = 0; i < empty_frame.header.channels; i++)
+						if(empty_buffer[i] != NULL)
+							free(empty_buffer[i]);
+					return false;
+				}
+			}
+			for(i = 0; i < empty_frame.header.channels; i++)
+				if(empty_buffer[i] != NULL)
+					free(empty_buffer[i]);
+
+		}
+	}
+	return true;
+}
+
+void update_stream_properties_(FLAC__StreamDecoder *decoder, const FLAC__FrameHeader *header)
+{
+	/* put the latest values into the public section of the decoder instance */
+	decoder->protected_->channels = header->channels;
+	decoder->protected_->channel_assignment = header->channel_assignment;
+	decoder->protected_->bits_per_sample = header->bits_per_sample;
+	decoder->protected_->sample_rate = header->sample_rate;
+	decoder->protected_->blocksize = header->blocksize;
+
+	FLAC__ASSERT(header->number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
+	decoder->private_->samples_decoded = header->number.sample_number + header->blocksize;
+}
+
 FLAC__bool read_frame_header_(FLAC__StreamDecoder *decoder)
 {
 	FLAC__uint32 x;
@@ -3081,6 +3814,7 @@ FLAC__bool read_subframe_fixed_(FLAC__StreamDecoder *decoder, uint32_t channel,
 {
 	FLAC__Subframe_Fixed *subframe = &decoder->private_->frame.subframes[channel].data.fixed;
 	FLAC__int64 i64;
+	FLAC__bool ok;
 	FLAC__uint32 u32;
 	uint32_t u;
 
@@ -3124,7 +3858,10 @@ FLAC__bool read_subframe_fixed_(FLAC__StreamDecoder *decoder, uint32_t channel,
 	switch(subframe->entropy_coding_method.type) {
 		case FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE:
 		case FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2:
-			if(!read_residual_partitioned_rice_(decoder, order, subframe->entropy_coding_method.data.partitioned_rice.order, &decoder->private_->partitioned_rice_contents[channel], decoder->private_->residual[channel], /*is_extended=*/subframe->entropy_coding_method.type == FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2))
+			FLAC__PROFILE_START(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_RICE);
+			ok = read_residual_partitioned_rice_(decoder, order, subframe->entropy_coding_method.data.partitioned_rice.order, &decoder->private_->partitioned_rice_contents[channel], decoder->private_->residual[channel], /*is_extended=*/subframe->entropy_coding_method.type == FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2);
+			FLAC__PROFILE_STOP(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_RICE);
+			if(!ok)
 				return false;
 			break;
 		default:
@@ -3133,20 +3870,22 @@ FLAC__bool read_subframe_fixed_(FLAC__StreamDecoder *decoder, uint32_t channel,
 
 	/* decode the subframe */
 	if(do_full_decode) {
+		FLAC__PROFILE_START(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_RESTORE);
 		if(bps < 33){
 			uint32_t i;
 			for(i = 0; i < order; i++)
 				decoder->private_->output[channel][i] = subframe->warmup[i];
 			if(bps+order <= 32)
-				FLAC__fixed_restore_signal(decoder->private_->residual[channel], decoder->private_->frame.header.blocksize-order, order, decoder->private_->output[channel]+order);
+				decoder->private_->local_fixed_restore_signal(decoder->private_->residual[channel], decoder->private_->frame.header.blocksize-order, order, decoder->private_->output[channel]+order);
 			else
-				FLAC__fixed_restore_signal_wide(decoder->private_->residual[channel], decoder->private_->frame.header.blocksize-order, order, decoder->private_->output[channel]+order);
+				decoder->private_->local_fixed_restore_signal_wide(decoder->private_->residual[channel], decoder->private_->frame.header.blocksize-order, order, decoder->private_->output[channel]+order);
 		}
 		else {
 			decoder->private_->side_subframe_in_use = true;
 			memcpy(decoder->private_->side_subframe, subframe->warmup, sizeof(FLAC__int64) * order);
 			FLAC__fixed_restore_signal_wide_33bit(decoder->private_->residual[channel], decoder->private_->frame.header.blocksize-order, order, decoder->private_->side_subframe+order);
 		}
+		FLAC__PROFILE_STOP(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_RESTORE);
 	}
 
 	return true;
@@ -3155,6 +3894,7 @@ FLAC__bool read_subframe_fixed_(FLAC__StreamDecoder *decoder, uint32_t channel,
 FLAC__bool read_subframe_lpc_(FLAC__StreamDecoder *decoder, uint32_t channel, uint32_t bps, const uint32_t order, FLAC__bool do_full_decode)
 {
 	FLAC__Subframe_LPC *subframe = &decoder->private_->frame.subframes[channel].data.lpc;
+	FLAC__bool ok;
 	FLAC__int32 i32;
 	FLAC__int64 i64;
 	FLAC__uint32 u32;
@@ -3227,7 +3967,10 @@ FLAC__bool read_subframe_lpc_(FLAC__StreamDecoder *decoder, uint32_t channel, ui
 	switch(subframe->entropy_coding_method.type) {
 		case FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE:
 		case FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2:
-			if(!read_residual_partitioned_rice_(decoder, order, subframe->entropy_coding_method.data.partitioned_rice.order, &decoder->private_->partitioned_rice_contents[channel], decoder->private_->residual[channel], /*is_extended=*/subframe->entropy_coding_method.type == FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2))
+			FLAC__PROFILE_START(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_RICE);
+			ok = read_residual_partitioned_rice_(decoder, order, subframe->entropy_coding_method.data.partitioned_rice.order, &decoder->private_->partitioned_rice_contents[channel], decoder->private_->residual[channel], /*is_extended=*/subframe->entropy_coding_method.type == FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2);
+			FLAC__PROFILE_STOP(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_RICE);
+			if(!ok)
 				return false;
 			break;
 		default:
@@ -3236,21 +3979,23 @@ FLAC__bool read_subframe_lpc_(FLAC__StreamDecoder *decoder, uint32_t channel, ui
 
 	/* decode the subframe */
 	if(do_full_decode) {
+		FLAC__PROFILE_START(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_RESTORE);
 		if(bps <= 32) {
 			uint32_t i;
 			for(i = 0; i < order; i++)
 				decoder->private_->output[channel][i] = subframe->warmup[i];
 			if(FLAC__lpc_max_residual_bps(bps, subframe->qlp_coeff, order, subframe->quantization_level) <= 32 &&
 			   FLAC__lpc_max_prediction_before_shift_bps(bps, subframe->qlp_coeff, order) <= 32)
-				FLAC__lpc_restore_signal(decoder->private_->residual[channel], decoder->private_->frame.header.blocksize-order, subframe->qlp_coeff, order, subframe->quantization_level, decoder->private_->output[channel]+order);
+				decoder->private_->local_lpc_restore_signal(decoder->private_->residual[channel], decoder->private_->frame.header.blocksize-order, subframe->qlp_coeff, order, subframe->quantization_level, decoder->private_->output[channel]+order);
 			else
-				FLAC__lpc_restore_signal_wide(decoder->private_->residual[channel], decoder->private_->frame.header.blocksize-order, subframe->qlp_coeff, order, subframe->quantization_level, decoder->private_->output[channel]+order);
+				decoder->private_->local_lpc_restore_signal_64bit(decoder->private_->residual[channel], decoder->private_->frame.header.blocksize-order, subframe->qlp_coeff, order, subframe->quantization_level, decoder->private_->output[channel]+order);
 		}
 		else {
 			decoder->private_->side_subframe_in_use = true;
 			memcpy(decoder->private_->side_subframe, subframe->warmup, sizeof(FLAC__int64) * order);
 			FLAC__lpc_restore_signal_wide_33bit(decoder->private_->residual[channel], decoder->private_->frame.header.blocksize-order, subframe->qlp_coeff, order, subframe->quantization_level, decoder->private_->side_subframe+order);
 		}
+		FLAC__PROFILE_STOP(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_RESTORE);
 	}
 
 	return true;
@@ -3605,11 +4350,11 @@ FLAC__StreamDecoderWriteStatus write_audio_frame_to_client_(FLAC__StreamDecoder
 				decoder->private_->last_frame.header.blocksize -= delta;
 				decoder->private_->last_frame.header.number.sample_number += (FLAC__uint64)delta;
 				/* write the relevant samples */
-				return decoder->private_->write_callback(decoder, &decoder->private_->last_frame, newbuffer, decoder->private_->client_data);
+				return call_write_callback_(decoder, &decoder->private_->last_frame, newbuffer);
 			}
 			else {
 				/* write the relevant samples */
-				return decoder->private_->write_callback(decoder, frame, buffer, decoder->private_->client_data);
+				return call_write_callback_(decoder, frame, buffer);
 			}
 		}
 		else {
@@ -3624,16 +4369,297 @@ FLAC__StreamDecoderWriteStatus write_audio_frame_to_client_(FLAC__StreamDecoder
 		if(!decoder->private_->has_stream_info)
 			decoder->private_->do_md5_checking = false;
 		if(decoder->private_->do_md5_checking) {
-			if(!FLAC__MD5Accumulate(&decoder->private_->md5context, buffer, frame->header.channels, frame->header.blocksize, (frame->header.bits_per_sample+7) / 8))
-				return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+#ifdef FLAC__USE_THREADS
+			/* hand the samples to the MD5 thread, so calculating the MD5 sum overlaps with decoding */
+			if(decoder->protected_->num_threads > 1) {
+				if(!queue_md5_(decoder, buffer, frame->header.channels, frame->header.blocksize, (frame->header.bits_per_sample+7) / 8))
+					return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+			}
+			else
+#endif
+			{
+				FLAC__bool ok;
+				FLAC__PROFILE_START(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_MD5);
+				ok = FLAC__MD5Accumulate(&decoder->private_->md5context, buffer, frame->header.channels, frame->header.blocksize, (frame->header.bits_per_sample+7) / 8);
+				FLAC__PROFILE_STOP(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_MD5);
+				if(!ok)
+					return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+			}
 		}
-		return decoder->private_->write_callback(decoder, frame, buffer, decoder->private_->client_data);
+		return call_write_callback_(decoder, frame, buffer);
 	}
 	else { /* decoder->private_->is_indexing == true */
 		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 	}
 }
 
+FLAC__StreamDecoderWriteStatus call_write_callback_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[])
+{
+	if(decoder->protected_->pull_mode)
+		return pull_write_(decoder, frame, buffer);
+	if(0 != decoder->private_->pcm_buffer && !store_interleaved_output_(decoder, frame, buffer))
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	return decoder->private_->write_callback(decoder, frame, buffer, decoder->private_->client_data);
+}
+
+FLAC__bool store_interleaved_output_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[])
+{
+	const uint32_t channels = frame->header.channels;
+	const uint32_t blocksize = frame->header.blocksize;
+	const uint32_t bps = frame->header.bits_per_sample;
+	uint32_t bytes_per_sample, max_bps;
+
+	bytes_per_sample = pcm_format_bytes_per_sample_(decoder->private_->pcm_format, &max_bps);
+	FLAC__ASSERT(bytes_per_sample > 0);
+
+	if(bps > max_bps || (size_t)blocksize * channels * bytes_per_sample > decoder->private_->pcm_buffer_size)
+		return false;
+
+	pack_interleaved_(decoder, decoder->private_->pcm_format, decoder->private_->pcm_buffer, buffer, channels, blocksize, bps);
+	return true;
+}
+
+/*
+ * Returns the size of a sample of format in bytes and sets max_bps to the
+ * largest number of bits per sample it can hold, or returns 0 if format is
+ * invalid.
+ */
+uint32_t pcm_format_bytes_per_sample_(FLAC__StreamDecoderPCMFormat format, uint32_t *max_bps)
+{
+	switch(format) {
+		case FLAC__STREAM_DECODER_PCM_FORMAT_S16LE:
+			*max_bps = 16;
+			return 2;
+		case FLAC__STREAM_DECODER_PCM_FORMAT_S24LE:
+			*max_bps = 24;
+			return 3;
+		case FLAC__STREAM_DECODER_PCM_FORMAT_S32LE:
+			*max_bps = 32;
+			return 4;
+		case FLAC__STREAM_DECODER_PCM_FORMAT_FLOAT:
+			*max_bps = 32;
+			return sizeof(float);
+		default:
+			*max_bps = 0;
+			return 0;
+	}
+}
+
+void pack_interleaved_(FLAC__StreamDecoder *decoder, FLAC__StreamDecoderPCMFormat format, void *out, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bps)
+{
+	if(format == FLAC__STREAM_DECODER_PCM_FORMAT_FLOAT) {
+		float *fout = (float *)out;
+		const float scale = (float)(1.0 / (double)((FLAC__uint64)1 << (bps - 1)));
+		uint32_t sample, channel;
+		for(sample = 0; sample < samples; sample++)
+			for(channel = 0; channel < channels; channel++)
+				*fout++ = (float)signal[channel][sample] * scale;
+	}
+	else {
+		/* the MD5 input formatter produces exactly this interleaved little-endian layout */
+		FLAC__multibyte mbuf;
+		uint32_t max_bps;
+		mbuf.p8 = (FLAC__byte *)out;
+		decoder->private_->local_md5_format_input(&mbuf, signal, channels, samples, pcm_format_bytes_per_sample_(format, &max_bps));
+	}
+}
+
+FLAC__StreamDecoderWriteStatus pull_write_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[])
+{
+	const uint32_t channels = frame->header.channels;
+	const uint32_t blocksize = frame->header.blocksize;
+	const uint32_t bps = frame->header.bits_per_sample;
+	uint32_t stored = 0, channel;
+
+	if(0 != decoder->private_->pull_buffer) {
+		uint32_t max_bps;
+		const uint32_t bytes_per_sample = pcm_format_bytes_per_sample_(decoder->private_->pull_format, &max_bps);
+
+		if(bps > max_bps)
+			return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+		if(decoder->private_->pull_channels == 0)
+			decoder->private_->pull_channels = channels;
+		if(decoder->private_->pull_channels == channels && decoder->private_->pull_fifo_size == 0) {
+			const uint32_t done = decoder->private_->pull_samples_done;
+			stored = flac_min(blocksize, decoder->private_->pull_samples - done);
+			pack_interleaved_(decoder, decoder->private_->pull_format, (FLAC__byte *)decoder->private_->pull_buffer + (size_t)done * channels * bytes_per_sample, buffer, channels, stored, bps);
+			decoder->private_->pull_samples_done += stored;
+		}
+	}
+	else {
+		/* outside of FLAC__stream_decoder_read_samples() only the last frame is kept */
+		decoder->private_->pull_fifo_size = 0;
+	}
+
+	if(stored < blocksize) {
+		const uint32_t rest = blocksize - stored;
+		if(decoder->private_->pull_fifo_size > 0 && (decoder->private_->pull_fifo_channels != channels || decoder->private_->pull_fifo_bps != bps))
+			decoder->private_->pull_fifo_size = 0;
+		if(decoder->private_->pull_fifo_size == 0)
+			decoder->private_->pull_fifo_start = 0;
+		if(decoder->private_->pull_fifo_start + decoder->private_->pull_fifo_size + rest > decoder->private_->pull_fifo_capacity && decoder->private_->pull_fifo_start > 0) {
+			for(channel = 0; channel < decoder->private_->pull_fifo_channels; channel++)
+				memmove(decoder->private_->pull_fifo[channel], decoder->private_->pull_fifo[channel] + decoder->private_->pull_fifo_start, decoder->private_->pull_fifo_size * sizeof(FLAC__int32));
+			decoder->private_->pull_fifo_start = 0;
+		}
+		if(!grow_pull_fifo_(decoder, channels, decoder->private_->pull_fifo_start + decoder->private_->pull_fifo_size + rest))
+			return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+		for(channel = 0; channel < channels; channel++)
+			memcpy(decoder->private_->pull_fifo[channel] + decoder->private_->pull_fifo_start + decoder->private_->pull_fifo_size, buffer[channel] + stored, rest * sizeof(FLAC__int32));
+		decoder->private_->pull_fifo_size += rest;
+		decoder->private_->pull_fifo_channels = channels;
+		decoder->private_->pull_fifo_bps = bps;
+	}
+
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+FLAC__bool grow_pull_fifo_(FLAC__StreamDecoder *decoder, uint32_t channels, uint32_t samples)
+{
+	uint32_t capacity, capacity_channels, channel;
+
+	if(samples <= decoder->private_->pull_fifo_capacity && channels <= decoder->private_->pull_fifo_capacity_channels)
+		return true;
+
+	capacity = flac_max(samples, decoder->private_->pull_fifo_capacity);
+	capacity_channels = flac_max(channels, decoder->private_->pull_fifo_capacity_channels);
+	for(channel = 0; channel < capacity_channels; channel++) {
+		FLAC__int32 *tmp = safe_realloc_nofree_mul_2op_(decoder->private_->pull_fifo[channel], sizeof(FLAC__int32), /*times*/capacity);
+		if(0 == tmp)
+			return false;
+		decoder->private_->pull_fifo[channel] = tmp;
+	}
+	decoder->private_->pull_fifo_capacity = capacity;
+	decoder->private_->pull_fifo_capacity_channels = capacity_channels;
+	return true;
+}
+
+void free_pull_fifo_(FLAC__StreamDecoder *decoder)
+{
+	uint32_t channel;
+
+	for(channel = 0; channel < FLAC__MAX_CHANNELS; channel++) {
+		free(decoder->private_->pull_fifo[channel]);
+		decoder->private_->pull_fifo[channel] = 0;
+	}
+	decoder->private_->pull_fifo_capacity = 0;
+	decoder->private_->pull_fifo_capacity_channels = 0;
+	decoder->private_->pull_fifo_size = 0;
+}
+
+FLAC__bool add_frame_to_index_(FLAC__StreamDecoder *decoder, const FLAC__FrameHeader *header, FLAC__uint64 frame_position)
+{
+	FLAC__StreamMetadata_SeekTable *index = &decoder->private_->frame_index.data.seek_table;
+	FLAC__StreamMetadata_SeekPoint *point;
+	FLAC__uint64 next_sample = 0;
+
+	FLAC__ASSERT(header->number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
+
+	/* positions are relative to the first frame, so they are meaningless without it or in Ogg */
+	if(decoder->private_->is_ogg || decoder->private_->first_frame_offset == 0 || frame_position < decoder->private_->first_frame_offset)
+		return true;
+
+	/* only add frames that directly follow the ones already in the index */
+	if(index->num_points > 0)
+		next_sample = index->points[index->num_points - 1].sample_number + index->points[index->num_points - 1].frame_samples;
+	if(header->number.sample_number != next_sample)
+		return true;
+
+	if(!grow_frame_index_(decoder, index->num_points + 1)) {
+		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
+	point = &index->points[index->num_points++];
+	point->sample_number = header->number.sample_number;
+	point->stream_offset = frame_position - decoder->private_->first_frame_offset;
+	point->frame_samples = header->blocksize;
+	decoder->private_->frame_index.length = index->num_points * FLAC__STREAM_METADATA_SEEKPOINT_LENGTH;
+	return true;
+}
+
+/*
+ * Returns the seek point of the frame that holds target_sample, or NULL
+ * if the frame index does not cover it.  If the point of the frame after
+ * it is in the index as well, it is returned in next_point, else
+ * next_point is set to NULL.
+ */
+const FLAC__StreamMetadata_SeekPoint *find_frame_in_index_(const FLAC__StreamDecoder *decoder, FLAC__uint64 target_sample, const FLAC__StreamMetadata_SeekPoint **next_point)
+{
+	const FLAC__StreamMetadata_SeekTable *index = &decoder->private_->frame_index.data.seek_table;
+	const FLAC__StreamMetadata_SeekPoint *point;
+	uint32_t low = 0, high = index->num_points;
+
+	*next_point = 0;
+
+	/* find the last point with sample_number <= target_sample; placeholders sort last */
+	while(low < high) {
+		const uint32_t mid = low + (high - low) / 2;
+		if(index->points[mid].sample_number <= target_sample)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if(low == 0)
+		return 0;
+
+	point = &index->points[low - 1];
+	if(point->sample_number == FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER || target_sample - point->sample_number >= point->frame_samples)
+		return 0;
+	if(low < index->num_points && index->points[low].sample_number == point->sample_number + point->frame_samples)
+		*next_point = &index->points[low];
+	return point;
+}
+
+FLAC__bool grow_frame_index_(FLAC__StreamDecoder *decoder, uint32_t points)
+{
+	FLAC__StreamMetadata_SeekPoint *tmp;
+	uint32_t capacity;
+
+	if(points <= decoder->private_->frame_index_capacity)
+		return true;
+
+	capacity = flac_max(decoder->private_->frame_index_capacity * 2, 1024u);
+	if(capacity < points)
+		capacity = points;
+	if(0 == (tmp = safe_realloc_nofree_mul_2op_(decoder->private_->frame_index.data.seek_table.points, sizeof(FLAC__StreamMetadata_SeekPoint), /*times*/capacity)))
+		return false;
+	decoder->private_->frame_index.data.seek_table.points = tmp;
+	decoder->private_->frame_index_capacity = capacity;
+	return true;
+}
+
+/*
+ * Discards the frame index if it was loaded for another stream than the
+ * one described by the STREAMINFO block.
+ */
+FLAC__bool check_frame_index_md5sum_(FLAC__StreamDecoder *decoder)
+{
+	static const FLAC__byte zero[16] = { 0 };
+	const FLAC__byte *md5sum = decoder->private_->stream_info.data.stream_info.md5sum;
+
+	if(
+		decoder->private_->frame_index.data.seek_table.num_points == 0 ||
+		0 == memcmp(decoder->private_->frame_index_md5sum, zero, 16) ||
+		0 == memcmp(md5sum, zero, 16) ||
+		0 == memcmp(decoder->private_->frame_index_md5sum, md5sum, 16)
+	)
+		return true;
+
+	decoder->private_->frame_index.data.seek_table.num_points = 0;
+	decoder->private_->frame_index.length = 0;
+	return false;
+}
+
+void free_frame_index_(FLAC__StreamDecoder *decoder)
+{
+	free(decoder->private_->frame_index.data.seek_table.points);
+	decoder->private_->frame_index.data.seek_table.points = 0;
+	decoder->private_->frame_index.data.seek_table.num_points = 0;
+	decoder->private_->frame_index.length = 0;
+	decoder->private_->frame_index_capacity = 0;
+	memset(decoder->private_->frame_index_md5sum, 0, sizeof(decoder->private_->frame_index_md5sum));
+}
+
 void send_error_to_client_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status)
 {
 	if(!decoder->private_->is_seeking) {
@@ -3760,6 +4786,22 @@ FLAC__bool seek_to_absolute_sample_(FLAC__StreamDecoder *decoder, FLAC__uint64 s
 		}
 	}
 
+	/*
+	 * If the frame index covers the target sample, we know exactly which
+	 * frame holds it, so seek straight to the start of that frame.
+	 */
+	{
+		const FLAC__StreamMetadata_SeekPoint *next_point;
+		const FLAC__StreamMetadata_SeekPoint *point = find_frame_in_index_(decoder, target_sample, &next_point);
+		if(0 != point && first_frame_offset + point->stream_offset < (next_point? first_frame_offset + next_point->stream_offset : stream_length)) {
+			lower_bound = first_frame_offset + point->stream_offset;
+			lower_bound_sample = point->sample_number;
+			upper_bound = next_point? first_frame_offset + next_point->stream_offset : stream_length;
+			upper_bound_sample = point->sample_number + point->frame_samples;
+			seek_from_lower_bound = true;
+		}
+	}
+
 #ifndef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
 	FLAC__ASSERT(upper_bound_sample >= lower_bound_sample);
 #endif
@@ -4102,6 +5144,10 @@ FLAC__StreamDecoderReadStatus file_read_callback_(const FLAC__StreamDecoder *dec
 	(void)client_data;
 
 	if(*bytes > 0) {
+#ifdef FLAC__USE_THREADS
+		if(decoder->private_->prefetch_thread_created || (decoder->protected_->prefetch_buffers > 1 && !decoder->private_->prefetch_thread_failed && start_prefetch_thread_(decoder)))
+			return prefetch_read_(decoder, buffer, bytes);
+#endif
 		*bytes = fread(buffer, sizeof(FLAC__byte), *bytes, decoder->private_->file);
 		if(ferror(decoder->private_->file))
 			return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
@@ -4120,6 +5166,10 @@ FLAC__StreamDecoderSeekStatus file_seek_callback_(const FLAC__StreamDecoder *dec
 
 	if(decoder->private_->file == stdin)
 		return FLAC__STREAM_DECODER_SEEK_STATUS_UNSUPPORTED;
+#ifdef FLAC__USE_THREADS
+	else if(decoder->private_->prefetch_thread_created)
+		return prefetch_seek_(decoder, absolute_byte_offset);
+#endif
 	else if(fseeko(decoder->private_->file, (FLAC__off_t)absolute_byte_offset, SEEK_SET) < 0)
 		return FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
 	else
@@ -4133,6 +5183,15 @@ FLAC__StreamDecoderTellStatus file_tell_callback_(const FLAC__StreamDecoder *dec
 
 	if(decoder->private_->file == stdin)
 		return FLAC__STREAM_DECODER_TELL_STATUS_UNSUPPORTED;
+#ifdef FLAC__USE_THREADS
+	/* only the decoding thread changes prefetch_position, so no need to lock */
+	else if(decoder->private_->prefetch_thread_created) {
+		if(!decoder->private_->prefetch_position_valid)
+			return FLAC__STREAM_DECODER_TELL_STATUS_ERROR;
+		*absolute_byte_offset = decoder->private_->prefetch_position;
+		return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+	}
+#endif
 	else if((pos = ftello(decoder->private_->file)) < 0)
 		return FLAC__STREAM_DECODER_TELL_STATUS_ERROR;
 	else {
@@ -4166,5 +5225,960 @@ FLAC__bool file_eof_callback_(const FLAC__StreamDecoder *decoder, void *client_d
 {
 	(void)client_data;
 
+#ifdef FLAC__USE_THREADS
+	if(decoder->private_->prefetch_thread_created) {
+		FLAC__bool end_of_file;
+		FLAC__mtx_lock(&decoder->private_->mutex_prefetch);
+		end_of_file = decoder->private_->prefetch_filled == 0 && decoder->private_->prefetch_end_of_file;
+		FLAC__mtx_unlock(&decoder->private_->mutex_prefetch);
+		return end_of_file;
+	}
+#endif
 	return feof(decoder->private_->file)? true : false;
 }
+
+#ifdef HAVE_SYS_MMAN_H
+FLAC__StreamDecoderReadStatus mmap_read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
+{
+	const size_t remaining = decoder->private_->mmap_length - decoder->private_->mmap_position;
+	(void)client_data;
+
+	if(*bytes > 0) {
+		if(remaining == 0) {
+			*bytes = 0;
+			return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+		}
+		if(*bytes > remaining)
+			*bytes = remaining;
+		memcpy(buffer, decoder->private_->mmap_data + decoder->private_->mmap_position, *bytes);
+		decoder->private_->mmap_position += *bytes;
+		return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+	}
+	else
+		return FLAC__STREAM_DECODER_READ_STATUS_ABORT; /* abort to avoid a deadlock */
+}
+
+FLAC__StreamDecoderSeekStatus mmap_seek_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data)
+{
+	(void)client_data;
+
+	if(absolute_byte_offset > (FLAC__uint64)decoder->private_->mmap_length)
+		return FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+	decoder->private_->mmap_position = (size_t)absolute_byte_offset;
+	return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
+}
+
+FLAC__StreamDecoderTellStatus mmap_tell_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data)
+{
+	(void)client_data;
+
+	*absolute_byte_offset = (FLAC__uint64)decoder->private_->mmap_position;
+	return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+}
+
+FLAC__StreamDecoderLengthStatus mmap_length_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data)
+{
+	(void)client_data;
+
+	*stream_length = (FLAC__uint64)decoder->private_->mmap_length;
+	return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+}
+
+FLAC__bool mmap_eof_callback_(const FLAC__StreamDecoder *decoder, void *client_data)
+{
+	(void)client_data;
+
+	return decoder->private_->mmap_position >= decoder->private_->mmap_length;
+}
+#endif
+
+#ifdef FLAC__USE_THREADS
+/*
+ * Frame-parallel decoding
+ *
+ * The calling thread reads ahead in the input and cuts it into frames:
+ * a frame starts at a valid frame header and ends at the next valid
+ * frame header for which the CRC-16 over the bytes in between checks
+ * out. Each frame is handed to a threadtask, which decodes it with an
+ * embedded decoder of its own. The calling thread collects the
+ * threadtasks in order and passes on the errors the embedded decoder
+ * ran into and the decoded frame, so the client receives the same
+ * callbacks in the same order as when decoding in a single thread.
+ */
+
+uint32_t frame_header_length_(const FLAC__byte *header, size_t bytes)
+{
+	uint32_t len, i;
+
+	/* these checks mirror the ones in read_frame_header_() */
+	if(bytes < 6 || header[0] != 0xff || header[1] >> 1 != 0x7c) /* MAGIC NUMBERs for the sync code and reserved bit, 6 bytes is the shortest possible frame header */
+		return 0;
+	/* MAGIC NUMBERs for the reserved blocksize, sample rate, channel assignment and sample size codes and the reserved bit */
+	if((header[2] >> 4) == 0 || (header[2] & 0x0f) == 0x0f || (header[3] >> 4) > 10 || ((header[3] >> 1) & 0x07) == 3 || (header[3] & 0x01))
+		return 0;
+
+	/* length of the UTF-8 coded frame or sample number */
+	if(!(header[4] & 0x80))
+		len = 1;
+	else if((header[4] & 0xe0) == 0xc0)
+		len = 2;
+	else if((header[4] & 0xf0) == 0xe0)
+		len = 3;
+	else if((header[4] & 0xf8) == 0xf0)
+		len = 4;
+	else if((header[4] & 0xfc) == 0xf8)
+		len = 5;
+	else if((header[4] & 0xfe) == 0xfc)
+		len = 6;
+	else if(header[4] == 0xfe)
+		len = 7;
+	else
+		return 0;
+	if(bytes < 4 + len)
+		return 0;
+	for(i = 1; i < len; i++)
+		if((header[4 + i] & 0xc0) != 0x80)
+			return 0;
+	len += 4;
+
+	/* blocksize and sample rate at the end of the header */
+	if((header[2] >> 4) == 6)
+		len += 1;
+	else if((header[2] >> 4) == 7)
+		len += 2;
+	if((header[2] & 0x0f) == 12)
+		len += 1;
+	else if((header[2] & 0x0f) > 12)
+		len += 2;
+
+	if(bytes <= len || FLAC__crc8(header, len) != header[len])
+		return 0;
+	return len + 1;
+}
+
+FLAC__bool fill_read_ahead_(FLAC__StreamDecoder *decoder, size_t bytes)
+{
+	size_t read;
+
+	while(!decoder->private_->read_ahead_end_of_stream && decoder->private_->read_ahead_end - decoder->private_->read_ahead_start < bytes) {
+		/* move what has not been handed to a threadtask yet to the front of the buffer */
+		if(decoder->private_->read_ahead_start > 0) {
+			memmove(decoder->private_->read_ahead, decoder->private_->read_ahead + decoder->private_->read_ahead_start, decoder->private_->read_ahead_end - decoder->private_->read_ahead_start);
+			decoder->private_->read_ahead_position += decoder->private_->read_ahead_start;
+			decoder->private_->read_ahead_end -= decoder->private_->read_ahead_start;
+			decoder->private_->read_ahead_start = 0;
+		}
+		if(decoder->private_->read_ahead_capacity - decoder->private_->read_ahead_end < FLAC__STREAM_DECODER_READ_AHEAD_SIZE) {
+			size_t new_capacity = decoder->private_->read_ahead_capacity * 2;
+			if(new_capacity < decoder->private_->read_ahead_end + FLAC__STREAM_DECODER_READ_AHEAD_SIZE)
+				new_capacity = decoder->private_->read_ahead_end + FLAC__STREAM_DECODER_READ_AHEAD_SIZE;
+			if(0 == (decoder->private_->read_ahead = safe_realloc_(decoder->private_->read_ahead, new_capacity))) {
+				decoder->private_->read_ahead_capacity = 0;
+				decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+				return false;
+			}
+			decoder->private_->read_ahead_capacity = new_capacity;
+		}
+		read = decoder->private_->read_ahead_capacity - decoder->private_->read_ahead_end;
+		if(!read_callback_(decoder->private_->read_ahead + decoder->private_->read_ahead_end, &read, decoder)) {
+			if(decoder->protected_->state != FLAC__STREAM_DECODER_END_OF_STREAM)
+				return false; /* read_callback_ sets the state for us */
+			/* the end of stream is only reported to the client after the last frame */
+			decoder->private_->read_ahead_end_of_stream = true;
+			decoder->protected_->state = FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC;
+		}
+		decoder->private_->read_ahead_end += read;
+	}
+	return true;
+}
+
+FLAC__bool read_frame_for_threadtask_(FLAC__StreamDecoder *decoder, FLAC__StreamDecoderThreadTask *task)
+{
+	const FLAC__StreamMetadata_StreamInfo *stream_info = &decoder->private_->stream_info.data.stream_info;
+	const FLAC__byte *b, *hit;
+	size_t pos, bytes, search_end, frame_end, first_candidate = 0;
+	size_t crc_end = 0; /* the CRC-16 of the bytes before crc_end is in crc */
+	FLAC__uint16 crc = 0;
+	/* no frame is larger than one with only verbatim subframes, so any
+	 * frame header found beyond this limit is considered to start the
+	 * next frame, even if the CRC-16 did not match */
+	const size_t max_frame_length = (size_t)stream_info->max_blocksize * stream_info->channels * (stream_info->bits_per_sample + 1) / 8 + stream_info->channels * 6 + FLAC__STREAM_DECODER_MAX_FRAME_HEADER_LEN + 3;
+
+	task->data_length = 0;
+	task->num_errors = 0;
+
+	/* skip anything that does not start with a valid frame header */
+	pos = 0;
+	while(1) {
+		if(!fill_read_ahead_(decoder, pos + FLAC__STREAM_DECODER_MAX_FRAME_HEADER_LEN))
+			return false; /* above function sets the status for us */
+		b = decoder->private_->read_ahead + decoder->private_->read_ahead_start;
+		bytes = decoder->private_->read_ahead_end - decoder->private_->read_ahead_start;
+		if(pos >= bytes || (b[pos] == 0xff && frame_header_length_(b + pos, bytes - pos) > 0))
+			break;
+		hit = memchr(b + pos + 1, 0xff, bytes - pos - 1);
+		pos = hit? (size_t)(hit - b) : bytes;
+	}
+	if(pos > 0) {
+		task->error[task->num_errors++] = FLAC__STREAM_DECODER_ERROR_STATUS_LOST_SYNC;
+		decoder->private_->read_ahead_start += pos;
+		b += pos;
+		bytes -= pos;
+	}
+
+	/* look for the end of the frame */
+	frame_end = 0;
+	pos = 1;
+	while(bytes > 0) {
+		if(!fill_read_ahead_(decoder, pos + FLAC__STREAM_DECODER_MAX_FRAME_HEADER_LEN))
+			return false; /* above function sets the status for us */
+		b = decoder->private_->read_ahead + decoder->private_->read_ahead_start;
+		bytes = decoder->private_->read_ahead_end - decoder->private_->read_ahead_start;
+		/* only look at sync codes for which the complete frame header has been read */
+		search_end = decoder->private_->read_ahead_end_of_stream? bytes - 1 : bytes - FLAC__STREAM_DECODER_MAX_FRAME_HEADER_LEN + 1;
+		if(pos >= search_end) {
+			FLAC__ASSERT(decoder->private_->read_ahead_end_of_stream);
+			frame_end = bytes;
+			break;
+		}
+		if(0 == (hit = memchr(b + pos, 0xff, search_end - pos))) {
+			pos = search_end;
+			continue;
+		}
+		pos = hit - b;
+		if(b[pos + 1] >> 1 == 0x7c && frame_header_length_(b + pos, bytes - pos) > 0) {
+			/* the CRC-16 over a complete frame, including its footer, is
+			 * zero; it is carried forward from the previous candidate, so
+			 * that many false sync codes don't make this quadratic */
+			crc = decoder->private_->local_crc16_functions->update(b + crc_end, (uint32_t)(pos - crc_end), crc);
+			crc_end = pos;
+			if(crc == 0) {
+				frame_end = pos;
+				break;
+			}
+			if(first_candidate == 0)
+				first_candidate = pos;
+		}
+		if(first_candidate > 0 && pos > max_frame_length) {
+			frame_end = first_candidate;
+			break;
+		}
+		pos++;
+	}
+
+	if(frame_end > 0) {
+		if(task->data_capacity < frame_end) {
+			if(0 == (task->data = safe_realloc_(task->data, frame_end))) {
+				task->data_capacity = 0;
+				decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+				return false;
+			}
+			task->data_capacity = frame_end;
+		}
+		memcpy(task->data, b, frame_end);
+		task->data_length = frame_end;
+		decoder->private_->read_ahead_start += frame_end;
+	}
+	task->end_position = decoder->private_->read_ahead_position + decoder->private_->read_ahead_start;
+	return true;
+}
+
+FLAC__StreamDecoderReadStatus threadtask_read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
+{
+	FLAC__StreamDecoderThreadTask *task = (FLAC__StreamDecoderThreadTask *)client_data;
+	(void)decoder;
+
+	if(task->data_consumed >= task->data_length) {
+		*bytes = 0;
+		return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+	}
+	if(*bytes > task->data_length - task->data_consumed)
+		*bytes = task->data_length - task->data_consumed;
+	memcpy(buffer, task->data + task->data_consumed, *bytes);
+	task->data_consumed += *bytes;
+	return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+FLAC__StreamDecoderWriteStatus threadtask_write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
+{
+	FLAC__StreamDecoderThreadTask *task = (FLAC__StreamDecoderThreadTask *)client_data;
+	(void)decoder;
+
+	/* frame and buffer stay valid until the embedded decoder is used again */
+	task->frame = frame;
+	task->buffer = buffer;
+	task->got_a_frame = true;
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+void threadtask_error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+	FLAC__StreamDecoderThreadTask *task = (FLAC__StreamDecoderThreadTask *)client_data;
+	(void)decoder;
+
+	if(task->num_errors < FLAC__STREAM_DECODER_MAX_THREADTASK_ERRORS)
+		task->error[task->num_errors++] = status;
+}
+
+void process_threadtask_(FLAC__StreamDecoderThreadTask *task)
+{
+	task->returnvalue = true;
+	task->got_a_frame = false;
+	task->trailing_data = false;
+	if(task->data_length > 0) {
+		task->data_consumed = 0;
+		/* each threadtask holds a single frame, so the embedded decoder must not look back at the previous one */
+		if(!FLAC__stream_decoder_flush(task->decoder))
+			task->returnvalue = false;
+		else {
+			task->decoder->private_->cached = false;
+			task->returnvalue = FLAC__stream_decoder_process_single(task->decoder);
+			/* a corrupt frame directly following a good one ends up in the same threadtask */
+			task->trailing_data = task->got_a_frame && (task->data_consumed < task->data_length || FLAC__bitreader_get_input_bits_unconsumed(task->decoder->private_->input) >= 8);
+		}
+	}
+
+	FLAC__mtx_lock(&task->mutex_this_task);
+	task->task_done = true;
+	FLAC__cnd_signal(&task->cond_task_done);
+	FLAC__mtx_unlock(&task->mutex_this_task);
+}
+
+FLAC__StreamDecoderThreadTask *take_threadtask_(FLAC__StreamDecoder *decoder)
+{
+	FLAC__StreamDecoderThreadTask *task = 0;
+
+	FLAC__mtx_lock(&decoder->private_->mutex_work_queue);
+	if(decoder->private_->num_available_threadtasks > 0) {
+		task = decoder->private_->threadtask[decoder->private_->next_threadtask];
+		decoder->private_->next_threadtask = (decoder->private_->next_threadtask + 1) % decoder->private_->num_threadtasks;
+		decoder->private_->num_available_threadtasks--;
+	}
+	FLAC__mtx_unlock(&decoder->private_->mutex_work_queue);
+	return task;
+}
+
+FLAC__thread_return_type process_frame_thread_(void *args)
+{
+	FLAC__StreamDecoder *decoder = args;
+	FLAC__StreamDecoderThreadTask *task;
+
+	while(1) {
+		FLAC__mtx_lock(&decoder->private_->mutex_work_queue);
+		while(decoder->private_->num_available_threadtasks == 0 && !decoder->private_->finish_work_threads)
+			FLAC__cnd_wait(&decoder->private_->cond_work_available, &decoder->private_->mutex_work_queue);
+		if(decoder->private_->num_available_threadtasks == 0) {
+			FLAC__mtx_unlock(&decoder->private_->mutex_work_queue);
+			return FLAC__thread_default_return_value;
+		}
+		task = decoder->private_->threadtask[decoder->private_->next_threadtask];
+		decoder->private_->next_threadtask = (decoder->private_->next_threadtask + 1) % decoder->private_->num_threadtasks;
+		decoder->private_->num_available_threadtasks--;
+		FLAC__mtx_unlock(&decoder->private_->mutex_work_queue);
+
+		process_threadtask_(task);
+	}
+}
+
+FLAC__StreamDecoderThreadTask *new_threadtask_(FLAC__StreamDecoder *decoder)
+{
+	FLAC__StreamDecoderThreadTask *task;
+
+	if(0 == (task = safe_calloc_(1, sizeof(FLAC__StreamDecoderThreadTask))))
+		return 0;
+	if(FLAC__mtx_init(&task->mutex_this_task, FLAC__mtx_plain) != FLAC__thrd_success) {
+		free(task);
+		return 0;
+	}
+	if(FLAC__cnd_init(&task->cond_task_done) != FLAC__thrd_success) {
+		FLAC__mtx_destroy(&task->mutex_this_task);
+		free(task);
+		return 0;
+	}
+	if(0 == (task->decoder = FLAC__stream_decoder_new()) ||
+	   FLAC__stream_decoder_init_stream(task->decoder, threadtask_read_callback_, 0, 0, 0, 0, threadtask_write_callback_, 0, threadtask_error_callback_, task) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+		if(0 != task->decoder)
+			FLAC__stream_decoder_delete(task->decoder);
+		FLAC__cnd_destroy(&task->cond_task_done);
+		FLAC__mtx_destroy(&task->mutex_this_task);
+		free(task);
+		return 0;
+	}
+	/* the embedded decoder never sees the metadata, so hand it the STREAMINFO the frame headers may refer to */
+	task->decoder->private_->has_stream_info = true;
+	task->decoder->private_->stream_info = decoder->private_->stream_info;
+	task->task_done = true;
+	return task;
+}
+
+FLAC__bool init_threadtasks_(FLAC__StreamDecoder *decoder)
+{
+	uint32_t t;
+
+	decoder->private_->num_threadtasks = 0;
+	decoder->private_->num_created_threads = 0;
+	decoder->private_->next_threadtask = 0;
+	decoder->private_->num_available_threadtasks = 0;
+	decoder->private_->finish_work_threads = false;
+
+	if(FLAC__mtx_init(&decoder->private_->mutex_work_queue, FLAC__mtx_plain) != FLAC__thrd_success) {
+		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
+	if(FLAC__cnd_init(&decoder->private_->cond_work_available) != FLAC__thrd_success) {
+		FLAC__mtx_destroy(&decoder->private_->mutex_work_queue);
+		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
+
+	/* Two threadtasks per thread, so there is always work queued up
+	 * while the calling thread is busy passing frames to the client */
+	for(t = 0; t < decoder->protected_->num_threads * 2 && t < FLAC__STREAM_DECODER_MAX_THREADTASKS; t++) {
+		if(0 == (decoder->private_->threadtask[t] = new_threadtask_(decoder))) {
+			free_threadtasks_(decoder);
+			decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+			return false;
+		}
+		decoder->private_->num_threadtasks++;
+	}
+
+	/* The calling thread decodes frames too. If not all threads can be
+	 * created, continue with the ones that could */
+	for(t = 1; t < decoder->protected_->num_threads; t++) {
+		if(FLAC__thrd_create(&decoder->private_->thread[decoder->private_->num_created_threads], process_frame_thread_, decoder) != FLAC__thrd_success)
+			break;
+		decoder->private_->num_created_threads++;
+	}
+	return true;
+}
+
+void free_threadtasks_(FLAC__StreamDecoder *decoder)
+{
+	uint32_t t;
+
+	FLAC__mtx_lock(&decoder->private_->mutex_work_queue);
+	decoder->private_->finish_work_threads = true;
+	FLAC__cnd_broadcast(&decoder->private_->cond_work_available);
+	FLAC__mtx_unlock(&decoder->private_->mutex_work_queue);
+	for(t = 0; t < decoder->private_->num_created_threads; t++)
+		FLAC__thrd_join(decoder->private_->thread[t], NULL);
+	decoder->private_->num_created_threads = 0;
+
+	for(t = 0; t < decoder->private_->num_threadtasks; t++) {
+		FLAC__StreamDecoderThreadTask *task = decoder->private_->threadtask[t];
+#ifdef FLAC__PROFILING
+		add_profile_(&decoder->private_->profile, &task->decoder->private_->profile);
+#endif
+		FLAC__stream_decoder_delete(task->decoder);
+		free(task->data);
+		FLAC__cnd_destroy(&task->cond_task_done);
+		FLAC__mtx_destroy(&task->mutex_this_task);
+		free(task);
+		decoder->private_->threadtask[t] = 0;
+	}
+	decoder->private_->num_threadtasks = 0;
+
+	FLAC__cnd_destroy(&decoder->private_->cond_work_available);
+	FLAC__mtx_destroy(&decoder->private_->mutex_work_queue);
+
+	free(decoder->private_->read_ahead);
+	decoder->private_->read_ahead = 0;
+	decoder->private_->read_ahead_capacity = 0;
+	decoder->private_->threadtask_position_valid = false;
+}
+
+#ifdef FLAC__PROFILING
+void add_profile_(FLAC__StreamDecoderProfile *total, const FLAC__StreamDecoderProfile *profile)
+{
+	uint32_t stage;
+	for(stage = 0; stage < FLAC__STREAM_DECODER_PROFILE_NUM_STAGES; stage++) {
+		total->nanoseconds[stage] += profile->nanoseconds[stage];
+		total->calls[stage] += profile->calls[stage];
+	}
+}
+#endif
+
+FLAC__bool write_threadtask_to_client_(FLAC__StreamDecoder *decoder, FLAC__StreamDecoderThreadTask *task)
+{
+	uint32_t i;
+
+	if(!task->returnvalue) {
+		decoder->protected_->state = task->decoder->protected_->state;
+		return false;
+	}
+
+	decoder->private_->threadtask_position_valid = decoder->private_->read_ahead_position_valid;
+	decoder->private_->threadtask_position = task->end_position;
+
+	for(i = 0; i < task->num_errors; i++)
+		send_error_to_client_(decoder, task->error[i]);
+
+	if(task->got_a_frame) {
+		/* Check whether frames are missing, if so, add silence to compensate */
+		if(decoder->private_->last_frame_is_set) {
+			if(!write_missing_frames_to_client_(decoder, &task->frame->header))
+				return false; /* above function sets the status for us */
+		}
+		decoder->private_->error_has_been_sent = false;
+		update_stream_properties_(decoder, &task->frame->header);
+		if(decoder->protected_->build_frame_index && decoder->private_->read_ahead_position_valid) {
+			if(!add_frame_to_index_(decoder, &task->frame->header, task->end_position - task->data_length))
+				return false; /* above function sets the status for us */
+		}
+		if(write_audio_frame_to_client_(decoder, task->frame, task->buffer) != FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE) {
+			decoder->protected_->state = FLAC__STREAM_DECODER_ABORTED;
+			return false;
+		}
+		if(task->trailing_data)
+			send_error_to_client_(decoder, FLAC__STREAM_DECODER_ERROR_STATUS_LOST_SYNC);
+	}
+	return true;
+}
+
+FLAC__bool process_frames_threaded_(FLAC__StreamDecoder *decoder)
+{
+	FLAC__StreamDecoderThreadTask *task;
+	uint32_t next_to_fill = 0, next_to_write = 0, num_pending = 0;
+	FLAC__bool read_ok = true, write_ok = true, end_of_input = false;
+	size_t bytes;
+	FLAC__uint32 x;
+
+	FLAC__ASSERT(decoder->protected_->num_threads > 1);
+	FLAC__ASSERT(decoder->private_->has_stream_info);
+
+	/* make sure we're byte aligned, like frame_sync_() */
+	if(!FLAC__bitreader_is_consumed_byte_aligned(decoder->private_->input)) {
+		if(!FLAC__bitreader_read_raw_uint32(decoder->private_->input, &x, FLAC__bitreader_bits_left_for_byte_alignment(decoder->private_->input)))
+			return decoder->protected_->state == FLAC__STREAM_DECODER_END_OF_STREAM; /* read_callback_ sets the state for us */
+	}
+
+	if(!init_threadtasks_(decoder))
+		return false; /* above function sets the status for us */
+
+	/* Take over whatever the bitreader has buffered already */
+	bytes = FLAC__bitreader_get_input_bits_unconsumed(decoder->private_->input) / 8;
+	decoder->private_->read_ahead_capacity = bytes + 1 + FLAC__STREAM_DECODER_READ_AHEAD_SIZE;
+	if(0 == (decoder->private_->read_ahead = safe_malloc_(decoder->private_->read_ahead_capacity))) {
+		free_threadtasks_(decoder);
+		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
+	decoder->private_->read_ahead_start = 0;
+	decoder->private_->read_ahead_end = 0;
+	decoder->private_->read_ahead_end_of_stream = false;
+	decoder->private_->read_ahead_position_valid = FLAC__stream_decoder_get_decode_position(decoder, &decoder->private_->read_ahead_position);
+	if(decoder->private_->cached) {
+		decoder->private_->read_ahead[decoder->private_->read_ahead_end++] = decoder->private_->lookahead;
+		decoder->private_->read_ahead_position--;
+		decoder->private_->cached = false;
+	}
+	if(bytes > 0) {
+		if(!FLAC__bitreader_read_byte_block_aligned_no_crc(decoder->private_->input, decoder->private_->read_ahead + decoder->private_->read_ahead_end, (uint32_t)bytes)) {
+			free_threadtasks_(decoder);
+			return false; /* read_callback_ sets the state for us */
+		}
+		decoder->private_->read_ahead_end += bytes;
+	}
+
+	while(1) {
+		/* Keep all threadtasks busy */
+		while(read_ok && write_ok && !end_of_input && num_pending < decoder->private_->num_threadtasks) {
+			task = decoder->private_->threadtask[next_to_fill];
+			FLAC__PROFILE_START(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_SYNC);
+			read_ok = read_frame_for_threadtask_(decoder, task);
+			FLAC__PROFILE_STOP(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_SYNC);
+			if(!read_ok)
+				break;
+			if(task->data_length == 0) {
+				end_of_input = true;
+				/* errors found after the last frame are passed on too */
+				if(task->num_errors == 0)
+					break;
+			}
+			task->task_done = false;
+			FLAC__mtx_lock(&decoder->private_->mutex_work_queue);
+			decoder->private_->num_available_threadtasks++;
+			FLAC__cnd_signal(&decoder->private_->cond_work_available);
+			FLAC__mtx_unlock(&decoder->private_->mutex_work_queue);
+			next_to_fill = (next_to_fill + 1) % decoder->private_->num_threadtasks;
+			num_pending++;
+		}
+		if(num_pending == 0)
+			break;
+
+		/* Work on queued threadtasks until the oldest one is done */
+		task = decoder->private_->threadtask[next_to_write];
+		while(1) {
+			FLAC__StreamDecoderThreadTask *queued_task;
+			FLAC__bool task_done;
+			FLAC__mtx_lock(&task->mutex_this_task);
+			task_done = task->task_done;
+			FLAC__mtx_unlock(&task->mutex_this_task);
+			if(task_done)
+				break;
+			if(0 != (queued_task = take_threadtask_(decoder)))
+				process_threadtask_(queued_task);
+			else {
+				FLAC__mtx_lock(&task->mutex_this_task);
+				while(!task->task_done)
+					FLAC__cnd_wait(&task->cond_task_done, &task->mutex_this_task);
+				FLAC__mtx_unlock(&task->mutex_this_task);
+				break;
+			}
+		}
+		next_to_write = (next_to_write + 1) % decoder->private_->num_threadtasks;
+		num_pending--;
+
+		/* After a failure, remaining threadtasks are finished but not passed to the client */
+		if(write_ok && !write_threadtask_to_client_(decoder, task))
+			write_ok = false;
+	}
+
+	free_threadtasks_(decoder);
+	if(!read_ok || !write_ok)
+		return false; /* above functions set the status for us */
+	decoder->protected_->state = FLAC__STREAM_DECODER_END_OF_STREAM;
+	return true;
+}
+
+FLAC__bool start_md5_thread_(FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(!decoder->private_->md5_thread_created);
+
+	if(FLAC__mtx_init(&decoder->private_->mutex_md5_fifo, FLAC__mtx_plain) != FLAC__thrd_success)
+		return false;
+	if(FLAC__cnd_init(&decoder->private_->cond_md5_available) != FLAC__thrd_success) {
+		FLAC__mtx_destroy(&decoder->private_->mutex_md5_fifo);
+		return false;
+	}
+	if(FLAC__cnd_init(&decoder->private_->cond_md5_emptied) != FLAC__thrd_success) {
+		FLAC__cnd_destroy(&decoder->private_->cond_md5_available);
+		FLAC__mtx_destroy(&decoder->private_->mutex_md5_fifo);
+		return false;
+	}
+	decoder->private_->finish_md5_thread = false;
+	decoder->private_->md5_thread_error = false;
+	decoder->private_->md5_fifo_tail = 0;
+#ifdef FLAC__PROFILING
+	memset(&decoder->private_->md5_thread_profile, 0, sizeof(decoder->private_->md5_thread_profile));
+#endif
+	if(FLAC__thrd_create(&decoder->private_->md5_thread, md5_thread_, decoder) != FLAC__thrd_success) {
+		FLAC__cnd_destroy(&decoder->private_->cond_md5_emptied);
+		FLAC__cnd_destroy(&decoder->private_->cond_md5_available);
+		FLAC__mtx_destroy(&decoder->private_->mutex_md5_fifo);
+		return false;
+	}
+	decoder->private_->md5_thread_created = true;
+	return true;
+}
+
+void finish_md5_thread_(FLAC__StreamDecoder *decoder)
+{
+	uint32_t channel;
+
+	if(!decoder->private_->md5_thread_created)
+		return;
+
+	/* the MD5 thread empties the queue before it quits */
+	FLAC__mtx_lock(&decoder->private_->mutex_md5_fifo);
+	decoder->private_->finish_md5_thread = true;
+	FLAC__cnd_signal(&decoder->private_->cond_md5_available);
+	FLAC__mtx_unlock(&decoder->private_->mutex_md5_fifo);
+	FLAC__thrd_join(decoder->private_->md5_thread, NULL);
+	decoder->private_->md5_thread_created = false;
+#ifdef FLAC__PROFILING
+	add_profile_(&decoder->private_->profile, &decoder->private_->md5_thread_profile);
+#endif
+
+	FLAC__cnd_destroy(&decoder->private_->cond_md5_emptied);
+	FLAC__cnd_destroy(&decoder->private_->cond_md5_available);
+	FLAC__mtx_destroy(&decoder->private_->mutex_md5_fifo);
+
+	for(channel = 0; channel < decoder->private_->md5_fifo_capacity_channels; channel++) {
+		free(decoder->private_->md5_fifo[channel]);
+		decoder->private_->md5_fifo[channel] = 0;
+	}
+	decoder->private_->md5_fifo_capacity_channels = 0;
+	decoder->private_->md5_fifo_size = 0;
+	decoder->private_->md5_fifo_tail = 0;
+}
+
+FLAC__thread_return_type md5_thread_(void *args)
+{
+	FLAC__StreamDecoder *decoder = args;
+	uint32_t channel, length, channels, bytes_per_sample;
+	FLAC__bool ok;
+
+	FLAC__mtx_lock(&decoder->private_->mutex_md5_fifo);
+	while(1) {
+		while(decoder->private_->md5_fifo_tail == 0 && !decoder->private_->finish_md5_thread)
+			FLAC__cnd_wait(&decoder->private_->cond_md5_available, &decoder->private_->mutex_md5_fifo);
+		if(decoder->private_->md5_fifo_tail == 0) {
+			FLAC__mtx_unlock(&decoder->private_->mutex_md5_fifo);
+			return FLAC__thread_default_return_value;
+		}
+		/* The decoding thread only appends beyond the tail, so the
+		 * samples up to the tail can be processed without holding
+		 * the lock */
+		length = decoder->private_->md5_fifo_tail;
+		channels = decoder->private_->md5_fifo_channels;
+		bytes_per_sample = decoder->private_->md5_fifo_bytes_per_sample;
+		FLAC__mtx_unlock(&decoder->private_->mutex_md5_fifo);
+
+		FLAC__PROFILE_START(&decoder->private_->md5_thread_profile, FLAC__STREAM_DECODER_PROFILE_MD5);
+		ok = FLAC__MD5Accumulate(&decoder->private_->md5context, (const FLAC__int32 * const *)decoder->private_->md5_fifo, channels, length, bytes_per_sample);
+		FLAC__PROFILE_STOP(&decoder->private_->md5_thread_profile, FLAC__STREAM_DECODER_PROFILE_MD5);
+
+		FLAC__mtx_lock(&decoder->private_->mutex_md5_fifo);
+		if(!ok)
+			decoder->private_->md5_thread_error = true;
+		for(channel = 0; channel < channels; channel++)
+			memmove(&decoder->private_->md5_fifo[channel][0], &decoder->private_->md5_fifo[channel][length], (decoder->private_->md5_fifo_tail-length) * sizeof(decoder->private_->md5_fifo[0][0]));
+		decoder->private_->md5_fifo_tail -= length;
+		FLAC__cnd_signal(&decoder->private_->cond_md5_emptied);
+	}
+}
+
+FLAC__bool queue_md5_(FLAC__StreamDecoder *decoder, const FLAC__int32 * const signal[], uint32_t channels, uint32_t samples, uint32_t bytes_per_sample)
+{
+	uint32_t channel;
+
+	if(!decoder->private_->md5_thread_created && !start_md5_thread_(decoder)) {
+		/* if no thread can be started, calculate the MD5 sum in this thread */
+		FLAC__bool ok;
+		FLAC__PROFILE_START(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_MD5);
+		ok = FLAC__MD5Accumulate(&decoder->private_->md5context, signal, channels, samples, bytes_per_sample);
+		FLAC__PROFILE_STOP(&decoder->private_->profile, FLAC__STREAM_DECODER_PROFILE_MD5);
+		return ok;
+	}
+
+	FLAC__mtx_lock(&decoder->private_->mutex_md5_fifo);
+	/* Wait for room in the queue. All samples in the queue have to be
+	 * of the same format, so on a change wait for it to be empty */
+	while(!decoder->private_->md5_thread_error && decoder->private_->md5_fifo_tail > 0 && (
+	      decoder->private_->md5_fifo_tail + samples > decoder->private_->md5_fifo_size ||
+	      decoder->private_->md5_fifo_channels != channels ||
+	      decoder->private_->md5_fifo_bytes_per_sample != bytes_per_sample))
+		FLAC__cnd_wait(&decoder->private_->cond_md5_emptied, &decoder->private_->mutex_md5_fifo);
+	if(decoder->private_->md5_thread_error) {
+		FLAC__mtx_unlock(&decoder->private_->mutex_md5_fifo);
+		return false;
+	}
+
+	/* the MD5 thread does not touch the queue when it is empty, so it can be reallocated */
+	if(samples > decoder->private_->md5_fifo_size || channels > decoder->private_->md5_fifo_capacity_channels) {
+		FLAC__ASSERT(decoder->private_->md5_fifo_tail == 0);
+		if(samples > decoder->private_->md5_fifo_size)
+			decoder->private_->md5_fifo_size = samples * FLAC__STREAM_DECODER_MD5_QUEUE_FRAMES;
+		for(channel = 0; channel < decoder->private_->md5_fifo_capacity_channels; channel++) {
+			free(decoder->private_->md5_fifo[channel]);
+			decoder->private_->md5_fifo[channel] = 0;
+		}
+		for(channel = 0; channel < channels; channel++) {
+			if(0 == (decoder->private_->md5_fifo[channel] = safe_malloc_mul_2op_p(sizeof(FLAC__int32), /*times*/decoder->private_->md5_fifo_size))) {
+				decoder->private_->md5_fifo_capacity_channels = channel;
+				decoder->private_->md5_fifo_size = 0;
+				FLAC__mtx_unlock(&decoder->private_->mutex_md5_fifo);
+				return false;
+			}
+		}
+		decoder->private_->md5_fifo_capacity_channels = channels;
+	}
+
+	decoder->private_->md5_fifo_channels = channels;
+	decoder->private_->md5_fifo_bytes_per_sample = bytes_per_sample;
+	for(channel = 0; channel < channels; channel++)
+		memcpy(decoder->private_->md5_fifo[channel] + decoder->private_->md5_fifo_tail, signal[channel], samples * sizeof(signal[0][0]));
+	decoder->private_->md5_fifo_tail += samples;
+	FLAC__cnd_signal(&decoder->private_->cond_md5_available);
+	FLAC__mtx_unlock(&decoder->private_->mutex_md5_fifo);
+	return true;
+}
+
+FLAC__bool start_prefetch_thread_(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__off_t pos;
+	uint32_t i;
+
+	FLAC__ASSERT(!decoder->private_->prefetch_thread_created);
+	FLAC__ASSERT(decoder->protected_->prefetch_buffers <= FLAC__STREAM_DECODER_MAX_PREFETCH_BUFFERS);
+
+	/* if anything fails, the file is read directly instead */
+	decoder->private_->prefetch_thread_failed = true;
+
+	for(i = 0; i < decoder->protected_->prefetch_buffers; i++) {
+		if(0 == (decoder->private_->prefetch_buffer[i] = malloc(FLAC__STREAM_DECODER_PREFETCH_BUFFER_SIZE))) {
+			free_prefetch_buffers_(decoder);
+			return false;
+		}
+	}
+	if(FLAC__mtx_init(&decoder->private_->mutex_prefetch, FLAC__mtx_plain) != FLAC__thrd_success) {
+		free_prefetch_buffers_(decoder);
+		return false;
+	}
+	if(FLAC__cnd_init(&decoder->private_->cond_prefetch_filled) != FLAC__thrd_success) {
+		FLAC__mtx_destroy(&decoder->private_->mutex_prefetch);
+		free_prefetch_buffers_(decoder);
+		return false;
+	}
+	if(FLAC__cnd_init(&decoder->private_->cond_prefetch_emptied) != FLAC__thrd_success) {
+		FLAC__cnd_destroy(&decoder->private_->cond_prefetch_filled);
+		FLAC__mtx_destroy(&decoder->private_->mutex_prefetch);
+		free_prefetch_buffers_(decoder);
+		return false;
+	}
+
+	decoder->private_->finish_prefetch_thread = false;
+	decoder->private_->prefetch_head = 0;
+	decoder->private_->prefetch_filled = 0;
+	decoder->private_->prefetch_consumed = 0;
+	decoder->private_->prefetch_reading = false;
+	decoder->private_->prefetch_end_of_file = false;
+	decoder->private_->prefetch_error = false;
+	if(decoder->private_->file != stdin && (pos = ftello(decoder->private_->file)) >= 0) {
+		decoder->private_->prefetch_position_valid = true;
+		decoder->private_->prefetch_position = (FLAC__uint64)pos;
+	}
+	else
+		decoder->private_->prefetch_position_valid = false;
+
+	if(FLAC__thrd_create(&decoder->private_->prefetch_thread, prefetch_thread_, (void *)decoder) != FLAC__thrd_success) {
+		FLAC__cnd_destroy(&decoder->private_->cond_prefetch_emptied);
+		FLAC__cnd_destroy(&decoder->private_->cond_prefetch_filled);
+		FLAC__mtx_destroy(&decoder->private_->mutex_prefetch);
+		free_prefetch_buffers_(decoder);
+		return false;
+	}
+	decoder->private_->prefetch_thread_created = true;
+	decoder->private_->prefetch_thread_failed = false;
+	return true;
+}
+
+void finish_prefetch_thread_(FLAC__StreamDecoder *decoder)
+{
+	decoder->private_->prefetch_thread_failed = false;
+	if(!decoder->private_->prefetch_thread_created)
+		return;
+
+	FLAC__mtx_lock(&decoder->private_->mutex_prefetch);
+	decoder->private_->finish_prefetch_thread = true;
+	FLAC__cnd_signal(&decoder->private_->cond_prefetch_emptied);
+	FLAC__mtx_unlock(&decoder->private_->mutex_prefetch);
+	FLAC__thrd_join(decoder->private_->prefetch_thread, NULL);
+	decoder->private_->prefetch_thread_created = false;
+
+	FLAC__cnd_destroy(&decoder->private_->cond_prefetch_emptied);
+	FLAC__cnd_destroy(&decoder->private_->cond_prefetch_filled);
+	FLAC__mtx_destroy(&decoder->private_->mutex_prefetch);
+	free_prefetch_buffers_(decoder);
+}
+
+void free_prefetch_buffers_(const FLAC__StreamDecoder *decoder)
+{
+	uint32_t i;
+
+	for(i = 0; i < FLAC__STREAM_DECODER_MAX_PREFETCH_BUFFERS; i++) {
+		free(decoder->private_->prefetch_buffer[i]);
+		decoder->private_->prefetch_buffer[i] = 0;
+	}
+}
+
+FLAC__thread_return_type prefetch_thread_(void *args)
+{
+	const FLAC__StreamDecoder *decoder = args;
+	const uint32_t num_buffers = decoder->protected_->prefetch_buffers;
+	uint32_t buffer;
+	size_t length;
+	FLAC__bool error, end_of_file;
+
+	FLAC__mtx_lock(&decoder->private_->mutex_prefetch);
+	while(1) {
+		while(!decoder->private_->finish_prefetch_thread && (
+		      decoder->private_->prefetch_filled == num_buffers ||
+		      decoder->private_->prefetch_end_of_file ||
+		      decoder->private_->prefetch_error))
+			FLAC__cnd_wait(&decoder->private_->cond_prefetch_emptied, &decoder->private_->mutex_prefetch);
+		if(decoder->private_->finish_prefetch_thread) {
+			FLAC__mtx_unlock(&decoder->private_->mutex_prefetch);
+			return FLAC__thread_default_return_value;
+		}
+
+		/* The decoding thread leaves buffers that are not filled
+		 * alone and waits for prefetch_reading to become false
+		 * before it touches the file, so the file can be read
+		 * without holding the lock */
+		buffer = (decoder->private_->prefetch_head + decoder->private_->prefetch_filled) % num_buffers;
+		decoder->private_->prefetch_reading = true;
+		FLAC__mtx_unlock(&decoder->private_->mutex_prefetch);
+
+		length = fread(decoder->private_->prefetch_buffer[buffer], 1, FLAC__STREAM_DECODER_PREFETCH_BUFFER_SIZE, decoder->private_->file);
+		error = ferror(decoder->private_->file)? true : false;
+		end_of_file = feof(decoder->private_->file)? true : false;
+
+		FLAC__mtx_lock(&decoder->private_->mutex_prefetch);
+		decoder->private_->prefetch_reading = false;
+		decoder->private_->prefetch_length[buffer] = length;
+		if(length > 0)
+			decoder->private_->prefetch_filled++;
+		decoder->private_->prefetch_error = error;
+		decoder->private_->prefetch_end_of_file = end_of_file;
+		FLAC__cnd_broadcast(&decoder->private_->cond_prefetch_filled);
+	}
+}
+
+FLAC__StreamDecoderReadStatus prefetch_read_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes)
+{
+	const uint32_t num_buffers = decoder->protected_->prefetch_buffers;
+	const size_t wanted = *bytes;
+	size_t length;
+	FLAC__StreamDecoderReadStatus status = FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+
+	*bytes = 0;
+	FLAC__mtx_lock(&decoder->private_->mutex_prefetch);
+	while(decoder->private_->prefetch_filled == 0 && !decoder->private_->prefetch_end_of_file && !decoder->private_->prefetch_error)
+		FLAC__cnd_wait(&decoder->private_->cond_prefetch_filled, &decoder->private_->mutex_prefetch);
+
+	/* return whatever has been read ahead, without waiting for more */
+	while(*bytes < wanted && decoder->private_->prefetch_filled > 0) {
+		const uint32_t head = decoder->private_->prefetch_head;
+		length = flac_min(wanted - *bytes, decoder->private_->prefetch_length[head] - decoder->private_->prefetch_consumed);
+		memcpy(buffer + *bytes, decoder->private_->prefetch_buffer[head] + decoder->private_->prefetch_consumed, length);
+		*bytes += length;
+		decoder->private_->prefetch_consumed += length;
+		if(decoder->private_->prefetch_consumed == decoder->private_->prefetch_length[head]) {
+			decoder->private_->prefetch_head = (head + 1) % num_buffers;
+			decoder->private_->prefetch_filled--;
+			decoder->private_->prefetch_consumed = 0;
+			FLAC__cnd_signal(&decoder->private_->cond_prefetch_emptied);
+		}
+	}
+	if(*bytes == 0)
+		status = decoder->private_->prefetch_error? FLAC__STREAM_DECODER_READ_STATUS_ABORT : FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+	FLAC__mtx_unlock(&decoder->private_->mutex_prefetch);
+
+	decoder->private_->prefetch_position += *bytes;
+	return status;
+}
+
+FLAC__StreamDecoderSeekStatus prefetch_seek_(const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset)
+{
+	FLAC__bool ok;
+
+	FLAC__mtx_lock(&decoder->private_->mutex_prefetch);
+	while(decoder->private_->prefetch_reading)
+		FLAC__cnd_wait(&decoder->private_->cond_prefetch_filled, &decoder->private_->mutex_prefetch);
+
+	/* discard everything that has been read ahead */
+	ok = fseeko(decoder->private_->file, (FLAC__off_t)absolute_byte_offset, SEEK_SET) >= 0;
+	decoder->private_->prefetch_filled = 0;
+	decoder->private_->prefetch_consumed = 0;
+	decoder->private_->prefetch_end_of_file = false;
+	decoder->private_->prefetch_error = false;
+	decoder->private_->prefetch_position_valid = ok;
+	decoder->private_->prefetch_position = absolute_byte_offset;
+	FLAC__cnd_signal(&decoder->private_->cond_prefetch_emptied);
+	FLAC__mtx_unlock(&decoder->private_->mutex_prefetch);
+
+	return ok? FLAC__STREAM_DECODER_SEEK_STATUS_OK : FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+}
+#endif
@@ -35,6 +35,7 @@
 #endif
 
 #include <limits.h>
+#include <math.h> /* for sqrt() */
 #include <stdio.h>
 #include <stdlib.h> /* for malloc() */
 #include <string.h> /* for memcpy() */
@@ -58,12 +59,14 @@
 #include "private/md5.h"
 #include "private/memory.h"
 #include "private/macros.h"
+#include "private/profile.h"
 #if FLAC__HAS_OGG
 #include "private/ogg_helper.h"
 #include "private/ogg_mapping.h"
 #endif
 #include "private/stream_encoder.h"
 #include "private/stream_encoder_framing.h"
+#include "private/thread_pool.h"
 #include "private/window.h"
 #include "share/alloc.h"
 #include "share/private.h"
@@ -99,6 +102,19 @@ typedef struct {
 	uint32_t bytes;
 } verify_output;
 
+typedef struct {
+	FLAC__byte *data;
+	size_t capacity;
+	size_t bytes;
+	FLAC__bool is_last_frame;
+} verify_frame;
+
+typedef struct {
+	void *data;
+	size_t capacity;     /* in bytes */
+	uint32_t references; /* the number of frames in it not yet released by the client; 0 means the buffer is free */
+} output_buffer;
+
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 typedef struct {
 	uint32_t a, b, c;
@@ -106,6 +122,17 @@ typedef struct {
 	double autoc_root[FLAC__MAX_LPC_ORDER+1];
 	double autoc[FLAC__MAX_LPC_ORDER+1];
 } apply_apodization_state_struct;
+
+typedef struct {
+	uint32_t nonzero_start, nonzero_end; /* the window is zero outside of this range */
+	uint32_t flat_start, flat_end;       /* the longest range over which the window is exactly 1.0 */
+} window_range_struct;
+
+typedef struct {
+	double autoc[FLAC__MAX_LPC_ORDER+1]; /* lag products with both samples within the granule */
+	double cross[FLAC__MAX_LPC_ORDER+1]; /* lag products reaching back into the previous granule */
+	uint32_t autoc_lag, cross_lag;       /* the number of valid entries, 0 if not computed for the current signal yet */
+} autoc_granule_struct;
 #endif
 
 typedef enum {
@@ -152,6 +179,7 @@ typedef struct FLAC__StreamEncoderThreadTask {
 	FLAC__int64 *integer_signal_33bit_side;           /* 33-bit side for 32-bit stereo decorrelation */
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	FLAC__real *windowed_signal;                      /* the integer_signal[] * current window[] */
+	autoc_granule_struct *autoc_granules;             /* the autocorrelation of the signal being analysed, per FLAC__STREAM_ENCODER_AUTOC_GRANULE samples */
 #endif
 	uint32_t subframe_bps[FLAC__MAX_CHANNELS];        /* the effective bits per sample of the input signal (stream bps - wasted bits) */
 	uint32_t subframe_bps_mid_side[2];                /* the effective bits per sample of the mid-side input signal (stream bps - wasted bits + 0/1) */
@@ -173,6 +201,16 @@ typedef struct FLAC__StreamEncoderThreadTask {
 	uint32_t *raw_bits_per_partition;                 /* workspace where the sum of silog2(candidate residual) for each partition is stored */
 	FLAC__BitWriter *frame;                           /* the current frame being worked on */
 	uint32_t current_frame_number;
+	FLAC__uint64 first_sample_number;                 /* the number of the first sample of the block, for variable-blocksize streams */
+	/* for variable-blocksize streams, the block is encoded whole into split_frame[0]
+	 * and in halves into split_halves[0], each half being encoded whole into
+	 * split_frame[1] and in halves into split_halves[1] and so on */
+	FLAC__BitWriter *split_frame[FLAC__STREAM_ENCODER_MAX_BLOCKSIZE_SPLITS+1];
+	FLAC__BitWriter *split_halves[FLAC__STREAM_ENCODER_MAX_BLOCKSIZE_SPLITS];
+	uint32_t split_depth;                             /* the number of times the block being encoded has been halved */
+	uint32_t num_frames;                              /* the number of frames the block ended up in */
+	uint32_t frame_blocksize[1u << FLAC__STREAM_ENCODER_MAX_BLOCKSIZE_SPLITS];
+	uint32_t frame_bytes[1u << FLAC__STREAM_ENCODER_MAX_BLOCKSIZE_SPLITS];
 	/* unaligned (original) pointers to allocated data */
 	FLAC__int32 *integer_signal_unaligned[FLAC__MAX_CHANNELS];
 	FLAC__int32 *integer_signal_mid_side_unaligned[2];
@@ -193,10 +231,15 @@ typedef struct FLAC__StreamEncoderThreadTask {
 #endif
 	FLAC__EntropyCodingMethod_PartitionedRiceContents partitioned_rice_contents_extra[2]; /* from find_best_partition_order_() */
 	FLAC__bool disable_constant_subframes;
+	uint32_t estimated_bits;          /* Size of the subframes when only estimating, see process_subframes_() */
+#ifdef FLAC__PROFILING
+	FLAC__StreamEncoderProfile profile; /* only written by the thread working on this task */
+#endif
 #ifdef FLAC__USE_THREADS
-	FLAC__mtx_t mutex_this_task;      /* To lock whole threadtask */
+	FLAC__mtx_t mutex_this_task;      /* Only to wait on cond_task_done */
 	FLAC__cnd_t cond_task_done;
-	FLAC__bool task_done;
+	FLAC__atomic_uint32 task_done;
+	FLAC__atomic_uint32 task_waited_on; /* Set while the main thread waits on cond_task_done */
 	FLAC__bool returnvalue;
 #endif
 } FLAC__StreamEncoderThreadTask;
@@ -212,6 +255,8 @@ static void free_(FLAC__StreamEncoder *encoder);
 static FLAC__bool resize_buffers_(FLAC__StreamEncoder *encoder, uint32_t new_blocksize);
 static FLAC__bool write_bitbuffer_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderThreadTask *threadtask, uint32_t samples, FLAC__bool is_last_block);
 static FLAC__StreamEncoderWriteStatus write_frame_(FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, uint32_t samples, FLAC__bool is_last_block);
+static FLAC__bool hand_over_buffer_(FLAC__StreamEncoder *encoder, FLAC__BitWriter *frame, uint32_t references);
+static FLAC__bool release_references_(FLAC__StreamEncoder *encoder, const FLAC__byte *buffer, uint32_t references);
 static void update_metadata_(const FLAC__StreamEncoder *encoder);
 #if FLAC__HAS_OGG
 static void update_ogg_metadata_(FLAC__StreamEncoder *encoder);
@@ -219,9 +264,19 @@ static void update_ogg_metadata_(FLAC__StreamEncoder *encoder);
 static FLAC__bool process_frame_(FLAC__StreamEncoder *encoder, FLAC__bool is_last_block);
 #ifdef FLAC__USE_THREADS
 FLAC__thread_return_type process_frame_thread_(void * encoder);
+static FLAC__bool process_thread_work_(void * encoder);
+static uint32_t get_num_queued_threadtasks_(const FLAC__StreamEncoder *encoder);
+static FLAC__StreamEncoderThreadTask *claim_threadtask_(FLAC__StreamEncoder *encoder);
+static void submit_threadtask_(FLAC__StreamEncoder *encoder);
+static void wake_up_threads_(FLAC__StreamEncoder *encoder, FLAC__bool force);
+static void wait_for_threadtask_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderThreadTask *task);
+static void process_md5_fifo_(FLAC__StreamEncoder *encoder);
 #endif
 FLAC__bool process_frame_thread_inner_(FLAC__StreamEncoder * encoder, FLAC__StreamEncoderThreadTask *threadtask);
-static FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderThreadTask *threadtask);
+static FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderThreadTask *threadtask, uint32_t offset, uint32_t blocksize, FLAC__BitWriter *frame);
+static uint32_t get_blocksize_splits_(const FLAC__StreamEncoder *encoder, uint32_t blocksize);
+static FLAC__bool process_variable_block_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderThreadTask *threadtask, FLAC__bool is_last_block);
+static FLAC__bool process_split_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderThreadTask *threadtask, uint32_t offset, uint32_t blocksize, uint32_t depth, uint32_t max_depth, FLAC__BitWriter *frames);
 
 static FLAC__bool process_subframe_(
 	FLAC__StreamEncoder *encoder,
@@ -239,6 +294,20 @@ static FLAC__bool process_subframe_(
 );
 
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
+static void set_window_range_(const FLAC__real window[], uint32_t blocksize, window_range_struct *range);
+
+static void compute_autocorrelation_(
+	FLAC__StreamEncoder *encoder,
+	FLAC__StreamEncoderThreadTask *threadtask,
+	const FLAC__real data[],
+	uint32_t data_len,
+	uint32_t offset,
+	uint32_t flat_start,
+	uint32_t flat_end,
+	uint32_t lag,
+	double autoc[]
+);
+
 static FLAC__bool apply_apodization_(
 	FLAC__StreamEncoder *encoder,
 	FLAC__StreamEncoderThreadTask *threadtask,
@@ -260,6 +329,8 @@ static FLAC__bool add_subframe_(
 	FLAC__BitWriter *frame
 );
 
+static FLAC__bool add_frame_footer_(FLAC__StreamEncoderThreadTask *threadtask, FLAC__BitWriter *frame);
+
 static uint32_t evaluate_constant_subframe_(
 	FLAC__StreamEncoder *encoder,
 	const FLAC__int64 signal,
@@ -318,6 +389,13 @@ static uint32_t evaluate_verbatim_subframe_(
 	FLAC__Subframe *subframe
 );
 
+static uint32_t count_subframe_bits_(
+	const FLAC__Subframe *subframe,
+	uint32_t blocksize,
+	uint32_t subframe_bps,
+	uint32_t estimate
+);
+
 static uint32_t find_best_partition_order_(
 	struct FLAC__StreamEncoderPrivate *private_,
 	FLAC__StreamEncoderThreadTask *threadtask,
@@ -390,6 +468,12 @@ static void append_to_verify_fifo_interleaved_(
 	uint32_t wide_samples
 );
 
+static FLAC__bool verify_frame_(FLAC__StreamEncoder *encoder, const FLAC__byte *buffer, size_t bytes, FLAC__bool is_last_frame);
+#ifdef FLAC__USE_THREADS
+static FLAC__bool queue_verify_frame_(FLAC__StreamEncoder *encoder, const FLAC__byte *buffer, size_t bytes, FLAC__bool is_last_frame);
+static void process_verify_queue_(FLAC__StreamEncoder *encoder);
+static FLAC__bool finish_verify_queue_(FLAC__StreamEncoder *encoder);
+#endif
 static FLAC__StreamDecoderReadStatus verify_read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
 static FLAC__StreamDecoderWriteStatus verify_write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data);
 static void verify_metadata_callback_(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data);
@@ -417,6 +501,9 @@ typedef struct FLAC__StreamEncoderPrivate {
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	FLAC__real *window[FLAC__MAX_APODIZATION_FUNCTIONS]; /* the pre-computed floating-point window for each apodization function */
 	FLAC__real *window_unaligned[FLAC__MAX_APODIZATION_FUNCTIONS];
+	FLAC__real *window_split[FLAC__STREAM_ENCODER_MAX_BLOCKSIZE_SPLITS][FLAC__MAX_APODIZATION_FUNCTIONS]; /* the windows for halved blocks, stored after window[] */
+	window_range_struct window_range[FLAC__STREAM_ENCODER_MAX_BLOCKSIZE_SPLITS+1][FLAC__MAX_APODIZATION_FUNCTIONS]; /* for window[] and window_split[] */
+	FLAC__bool use_autoc_cache;                       /* whether several windows are applied to each signal, so autoc_granules pay off */
 #endif
 	FLAC__StreamMetadata streaminfo;                  /* scratchpad for STREAMINFO as it is built */
 	FLAC__StreamMetadata_SeekTable *seek_table;       /* pointer into encoder->protected_->metadata_ where the seek table is */
@@ -425,6 +512,9 @@ typedef struct FLAC__StreamEncoderPrivate {
 	FLAC__MD5Context md5context;
 	FLAC__CPUInfo cpuinfo;
 	void (*local_precompute_partition_info_sums)(const FLAC__int32 residual[], FLAC__uint64 abs_residual_partition_sums[], uint32_t residual_samples, uint32_t predictor_order, uint32_t min_partition_order, uint32_t max_partition_order, uint32_t bps);
+	FLAC__MD5FormatInput local_md5_format_input;
+	const FLAC__CRC16Functions *local_crc16_functions;
+	FLAC__BitWriterWriteRiceSignedBlock local_bitwriter_write_rice_signed_block;
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	uint32_t (*local_fixed_compute_best_predictor)(const FLAC__int32 data[], uint32_t data_len, float residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1]);
 	uint32_t (*local_fixed_compute_best_predictor_wide)(const FLAC__int32 data[], uint32_t data_len, float residual_bits_per_sample[FLAC__MAX_FIXED_ORDER+1]);
@@ -450,11 +540,14 @@ typedef struct FLAC__StreamEncoderPrivate {
 	FLAC__bool disable_constant_subframes;
 	FLAC__bool disable_fixed_subframes;
 	FLAC__bool disable_verbatim_subframes;
+	FLAC__bool inject_verify_mismatch;
+	FLAC__uint64 verify_mismatch_sample;   /* see FLAC__stream_encoder_inject_verify_mismatch() */
 	FLAC__bool is_ogg;
 	FLAC__StreamEncoderReadCallback read_callback; /* currently only needed for Ogg FLAC */
 	FLAC__StreamEncoderSeekCallback seek_callback;
 	FLAC__StreamEncoderTellCallback tell_callback;
 	FLAC__StreamEncoderWriteCallback write_callback;
+	FLAC__StreamEncoderWriteBufferCallback write_buffer_callback;
 	FLAC__StreamEncoderMetadataCallback metadata_callback;
 	FLAC__StreamEncoderProgressCallback progress_callback;
 	void *client_data;
@@ -473,6 +566,7 @@ typedef struct FLAC__StreamEncoderPrivate {
 		FLAC__bool needs_magic_hack;
 		verify_input_fifo input_fifo;
 		verify_output output;
+		FLAC__StreamEncoderState error; /* set by the callbacks, copied to the encoder state by the main thread */
 		struct {
 			FLAC__uint64 absolute_sample;
 			uint32_t frame_number;
@@ -481,25 +575,83 @@ typedef struct FLAC__StreamEncoderPrivate {
 			FLAC__int32 expected;
 			FLAC__int32 got;
 		} error_stats;
+#ifdef FLAC__USE_THREADS
+		/* When encoding with threads, frames are verified on the threads
+		 * in order, by one thread at a time, like the MD5 work. The main
+		 * thread queues copies of the frames and writes them right away,
+		 * and only waits when the queue is full. Mismatches are reported
+		 * from the next call that processes samples, or from finishing */
+		verify_frame *queue;
+		uint32_t queue_size;
+		uint32_t queue_head; /* next frame to verify, only used by the verifying thread */
+		uint32_t queue_tail; /* next free slot, only used by the main thread */
+		FLAC__atomic_uint32 num_queued;
+		FLAC__atomic_uint32 active; /* set by the one thread verifying */
+		FLAC__atomic_uint32 failed;
+		FLAC__mtx_t mutex; /* for input_fifo, and to wait on cond_dequeued */
+		FLAC__cnd_t cond_dequeued;
+#endif
 	} verify;
+	/*
+	 * The sums from which the estimate is computed when only estimating
+	 */
+	struct {
+		FLAC__uint64 metadata_bytes;
+		FLAC__uint64 total_samples;
+		uint32_t total_blocks;
+		uint32_t blocks;          /* the number of blocks analysed */
+		uint32_t sample_bits;     /* the size of an unencoded sample, over all channels */
+		double samples, bytes;    /* sums over the analysed blocks */
+		double samples_squared, bytes_squared, samples_bytes;
+	} estimate;
+	/*
+	 * The buffers handed over through the write buffer callback.  The
+	 * pool lives as long as the encoder instance, as the client may
+	 * hold on to buffers past FLAC__stream_encoder_finish().
+	 */
+	struct {
+		output_buffer *buffers;
+		uint32_t num_buffers;
+#ifdef FLAC__USE_THREADS
+		FLAC__mtx_t mutex; /* buffers may be released from any thread */
+#endif
+	} output_pool;
 	FLAC__bool is_being_deleted; /* if true, call to ..._finish() from ..._delete() will not call the callbacks */
 	uint32_t num_threadtasks;
+#ifdef FLAC__PROFILING
+	FLAC__StreamEncoderProfile profile; /* the counters of finished threadtasks are added here */
+#endif
 #ifdef FLAC__USE_THREADS
 	uint32_t num_created_threads;
 	uint32_t next_thread; /* This is the next thread that needs start, or needs to finish and be restarted */
 	uint32_t num_started_threadtasks;
-	uint32_t num_available_threadtasks; /* Number of threadtasks that are available to work on */
-	uint32_t num_running_threads;
-	uint32_t next_threadtask; /* Next threadtask that is available to work on */
-	FLAC__mtx_t mutex_md5_fifo;
-	FLAC__mtx_t mutex_work_queue; /* To lock work related variables in this struct */
+	/* The threadtasks form a ring, the main thread being the only producer
+	 * and the threads the consumers. Both positions below keep counting up
+	 * and are only reduced to a threadtask number when used, so a thread
+	 * that reads a stale claim position can only win the compare-and-swap
+	 * if the ring went around billions of times in the meantime. As the
+	 * size of the ring is odd, they wrap at threadtask_positions, the
+	 * largest multiple of it that fits in 32 bits, instead of at 2^32.
+	 * Only the main thread writes the submit position, the threads
+	 * advance the claim position with a compare-and-swap. */
+	FLAC__atomic_uint32 threadtask_submit_position;
+	FLAC__atomic_uint32 threadtask_claim_position;
+	uint32_t threadtask_positions;
+	FLAC__atomic_uint32 num_parked_threads; /* Number of threads waiting on cond_work_available */
+	uint32_t num_unannounced_threadtasks; /* Submitted since the threads were last woken up */
+	FLAC__mtx_t mutex_md5_fifo; /* To lock md5_fifo */
+	FLAC__mtx_t mutex_work_queue; /* Only to park threads on cond_work_available, and for finish_work_threads */
 	FLAC__cnd_t cond_md5_emptied; /* To signal to main thread that MD5 queue has been emptied */
 	FLAC__cnd_t cond_work_available; /* To signal to threads that work is available */
-	FLAC__cnd_t cond_wake_up_thread; /* To signal that one sleeping thread can wake up */
-	FLAC__bool md5_active;
+	FLAC__atomic_uint32 md5_active; /* Set by the one thread processing md5_fifo */
+	FLAC__atomic_uint32 md5_fifo_tail; /* Copy of md5_fifo.tail, to check for MD5 work without locking */
 	FLAC__bool finish_work_threads;
-	int32_t overcommitted_indicator;
+	FLAC__ThreadPool *thread_pool; /* if set, no threads are created by this instance */
+	FLAC__ThreadPoolSource thread_pool_source;
 	verify_input_fifo md5_fifo;
+#ifdef FLAC__PROFILING
+	FLAC__StreamEncoderProfile md5_fifo_profile;
+#endif
 #endif
 } FLAC__StreamEncoderPrivate;
 
@@ -562,6 +714,18 @@ FLAC_API const char * const FLAC__StreamEncoderTellStatusString[] = {
 	"FLAC__STREAM_ENCODER_TELL_STATUS_UNSUPPORTED"
 };
 
+FLAC_API const char * const FLAC__StreamEncoderProfileStageString[] = {
+	"FLAC__STREAM_ENCODER_PROFILE_WINDOW",
+	"FLAC__STREAM_ENCODER_PROFILE_AUTOCORRELATION",
+	"FLAC__STREAM_ENCODER_PROFILE_LPC_SOLVE",
+	"FLAC__STREAM_ENCODER_PROFILE_QUANTIZATION",
+	"FLAC__STREAM_ENCODER_PROFILE_RESIDUAL",
+	"FLAC__STREAM_ENCODER_PROFILE_PARTITION_SEARCH",
+	"FLAC__STREAM_ENCODER_PROFILE_BITWRITING",
+	"FLAC__STREAM_ENCODER_PROFILE_MD5",
+	"FLAC__STREAM_ENCODER_PROFILE_CRC"
+};
+
 /* Number of samples that will be overread to watch for end of stream.  By
  * 'overread', we mean that the FLAC__stream_encoder_process*() calls will
  * always try to read blocksize+1 samples before encoding a block, so that
@@ -575,6 +739,18 @@ FLAC_API const char * const FLAC__StreamEncoderTellStatusString[] = {
  */
 static const uint32_t OVERREAD_ = 1;
 
+#ifdef FLAC__USE_THREADS
+/* Number of times a thread looks for new work or for its threadtask to be
+ * done before it goes to sleep.  Waking up a sleeping thread costs far more
+ * than this when frames are encoded quickly, like with the lower presets. */
+static const uint32_t SPIN_LIMIT_ = 256;
+
+/* Sleeping threads are woken up once this many threadtasks have been
+ * submitted, instead of once for every threadtask, unless the main thread
+ * is about to wait itself. */
+static const uint32_t MAX_THREADTASK_BATCH_ = 4;
+#endif
+
 /***********************************************************************
  *
  * Class constructor/destructor
@@ -622,6 +798,17 @@ FLAC_API FLAC__StreamEncoder *FLAC__stream_encoder_new(void)
 		return 0;
 	}
 
+#ifdef FLAC__USE_THREADS
+	if(FLAC__mtx_init(&encoder->private_->output_pool.mutex, FLAC__mtx_plain) != FLAC__thrd_success) {
+		FLAC__bitwriter_delete(encoder->private_->threadtask[0]->frame);
+		free(encoder->private_->threadtask[0]);
+		free(encoder->private_);
+		free(encoder->protected_);
+		free(encoder);
+		return 0;
+	}
+#endif
+
 	encoder->private_->file = 0;
 
 	encoder->protected_->state = FLAC__STREAM_ENCODER_UNINITIALIZED;
@@ -691,6 +878,17 @@ FLAC_API void FLAC__stream_encoder_delete(FLAC__StreamEncoder *encoder)
 	for(i = 0; i < 2; i++)
 		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->threadtask[0]->partitioned_rice_contents_extra[i]);
 
+	/* buffers still held by the client are freed as well */
+	for(i = 0; i < encoder->private_->output_pool.num_buffers; i++) {
+		if(0 != encoder->private_->output_pool.buffers[i].data)
+			free(encoder->private_->output_pool.buffers[i].data);
+	}
+	if(0 != encoder->private_->output_pool.buffers)
+		free(encoder->private_->output_pool.buffers);
+#ifdef FLAC__USE_THREADS
+	FLAC__mtx_destroy(&encoder->private_->output_pool.mutex);
+#endif
+
 	FLAC__bitwriter_delete(encoder->private_->threadtask[0]->frame);
 	free(encoder->private_->threadtask[0]);
 	free(encoder->private_);
@@ -726,9 +924,20 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	if(FLAC__HAS_OGG == 0 && is_ogg)
 		return FLAC__STREAM_ENCODER_INIT_STATUS_UNSUPPORTED_CONTAINER;
 
-	if(0 == write_callback || (seek_callback && 0 == tell_callback))
+	/* With a write buffer callback, the write callback is only needed to write back metadata after seeking */
+	if((0 == write_callback && encoder->protected_->estimate_only == 0 && (0 == encoder->private_->write_buffer_callback || seek_callback)) || (seek_callback && 0 == tell_callback))
+		return FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_CALLBACKS;
+
+	if(encoder->private_->write_buffer_callback && (is_ogg || encoder->private_->file))
 		return FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_CALLBACKS;
 
+	/* Nothing is written when only estimating, so there is nothing to
+	 * verify or to compute an MD5 signature for */
+	if(encoder->protected_->estimate_only > 0) {
+		encoder->protected_->verify = false;
+		encoder->protected_->do_md5 = false;
+	}
+
 	if(encoder->protected_->channels == 0 || encoder->protected_->channels > FLAC__MAX_CHANNELS)
 		return FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_NUMBER_OF_CHANNELS;
 
@@ -922,6 +1131,15 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	encoder->private_->input_capacity = 0;
 	encoder->private_->current_sample_number = 0;
 	encoder->private_->current_frame_number = 0;
+	memset(&encoder->private_->estimate, 0, sizeof(encoder->private_->estimate));
+	encoder->private_->estimate.sample_bits = encoder->protected_->channels * encoder->protected_->bits_per_sample;
+#ifdef FLAC__PROFILING
+	memset(&encoder->private_->profile, 0, sizeof(encoder->private_->profile));
+	memset(&encoder->private_->threadtask[0]->profile, 0, sizeof(encoder->private_->threadtask[0]->profile));
+#ifdef FLAC__USE_THREADS
+	memset(&encoder->private_->md5_fifo_profile, 0, sizeof(encoder->private_->md5_fifo_profile));
+#endif
+#endif
 
 	/*
 	 * get the CPU info and set the function pointers
@@ -946,8 +1164,19 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	/* first default to the non-asm routines */
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	encoder->private_->local_lpc_compute_autocorrelation = FLAC__lpc_compute_autocorrelation;
+	/* with a single window, caching the autocorrelation of the unwindowed
+	 * signal is only overhead */
+	encoder->private_->use_autoc_cache = encoder->protected_->num_apodizations > 1 ||
+		(encoder->protected_->apodizations[0].type == FLAC__APODIZATION_SUBDIVIDE_TUKEY && encoder->protected_->apodizations[0].parameters.subdivide_tukey.parts > 1);
 #endif
 	encoder->private_->local_precompute_partition_info_sums = precompute_partition_info_sums_;
+	encoder->private_->local_md5_format_input = FLAC__md5_format_input;
+	encoder->private_->local_crc16_functions = &FLAC__crc16_functions;
+	encoder->private_->local_bitwriter_write_rice_signed_block = FLAC__bitwriter_write_rice_signed_block;
+#if ENABLE_64_BIT_WORDS && defined FLAC__AVX2_SUPPORTED
+	if(encoder->private_->cpuinfo.x86.avx2)
+		encoder->private_->local_bitwriter_write_rice_signed_block = FLAC__bitwriter_write_rice_signed_block_avx2;
+#endif
 	encoder->private_->local_fixed_compute_best_predictor = FLAC__fixed_compute_best_predictor;
 	encoder->private_->local_fixed_compute_best_predictor_wide = FLAC__fixed_compute_best_predictor_wide;
 	encoder->private_->local_fixed_compute_best_predictor_limit_residual = FLAC__fixed_compute_best_predictor_limit_residual;
@@ -1109,9 +1338,24 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 		if (encoder->private_->cpuinfo.x86.avx2)
 			encoder->private_->local_precompute_partition_info_sums = FLAC__precompute_partition_info_sums_intrin_avx2;
 #  endif
+#  ifdef FLAC__SSE2_SUPPORTED
+		if (encoder->private_->cpuinfo.x86.sse2)
+			encoder->private_->local_md5_format_input = FLAC__md5_format_input_intrin_sse2;
+#  endif
+#  ifdef FLAC__AVX2_SUPPORTED
+		if (encoder->private_->cpuinfo.x86.avx2)
+			encoder->private_->local_md5_format_input = FLAC__md5_format_input_intrin_avx2;
+#  endif
+#  ifdef FLAC__PCLMUL_SUPPORTED
+		if (encoder->private_->cpuinfo.x86.pclmul && encoder->private_->cpuinfo.x86.ssse3)
+			encoder->private_->local_crc16_functions = &FLAC__crc16_functions_intrin_pclmul;
+#  endif
 # endif /* FLAC__CPU_... */
 	}
 #endif /* !FLAC__NO_ASM && FLAC__HAS_X86INTRIN */
+#if !defined FLAC__NO_ASM && defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN && !WORDS_BIGENDIAN
+	encoder->private_->local_md5_format_input = FLAC__md5_format_input_intrin_neon;
+#endif
 
 	/* set state to OK; from here on, errors are fatal and we'll override the state then */
 	encoder->protected_->state = FLAC__STREAM_ENCODER_OK;
@@ -1131,9 +1375,15 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	encoder->private_->metadata_callback = metadata_callback;
 	encoder->private_->client_data = client_data;
 
+#ifdef FLAC__USE_THREADS
+	if(0 != encoder->private_->thread_pool && encoder->protected_->num_threads < 2)
+		encoder->protected_->num_threads = flac_min(FLAC__thread_pool_get_num_threads(encoder->private_->thread_pool) + 1, (uint32_t)FLAC__STREAM_ENCODER_MAX_THREADS);
+#endif
+
 	if(encoder->protected_->num_threads > 1) {
 #ifdef FLAC__USE_THREADS
 		encoder->private_->num_threadtasks = encoder->protected_->num_threads * 2 + 2; /* First threadtask is reserved for main thread */
+		encoder->private_->threadtask_positions = UINT32_MAX / (encoder->private_->num_threadtasks - 1) * (encoder->private_->num_threadtasks - 1);
 		if(FLAC__mtx_init(&encoder->private_->mutex_md5_fifo, FLAC__mtx_plain) != FLAC__thrd_success) {
 			encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
 			return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
@@ -1156,14 +1406,6 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 			encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
 			return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
 		}
-		if(FLAC__cnd_init(&encoder->private_->cond_wake_up_thread) != FLAC__thrd_success) {
-			FLAC__mtx_destroy(&encoder->private_->mutex_md5_fifo);
-			FLAC__mtx_destroy(&encoder->private_->mutex_work_queue);
-			FLAC__cnd_destroy(&encoder->private_->cond_md5_emptied);
-			FLAC__cnd_destroy(&encoder->private_->cond_work_available);
-			encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
-			return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
-		}
 		if(encoder->protected_->do_md5) {
 			encoder->private_->md5_fifo.size = (encoder->protected_->blocksize+OVERREAD_) * (encoder->private_->num_threadtasks + 2);
 			for(i = 0; i < encoder->protected_->channels; i++) {
@@ -1172,7 +1414,6 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 					FLAC__mtx_destroy(&encoder->private_->mutex_work_queue);
 					FLAC__cnd_destroy(&encoder->private_->cond_md5_emptied);
 					FLAC__cnd_destroy(&encoder->private_->cond_work_available);
-					FLAC__cnd_destroy(&encoder->private_->cond_wake_up_thread);
 					encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
 					return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
 				}
@@ -1236,6 +1477,11 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 			for(i = 0; i < 2; i++)
 				FLAC__format_entropy_coding_method_partitioned_rice_contents_init(&encoder->private_->threadtask[t]->partitioned_rice_contents_extra[i]);
 		}
+		if(0 != encoder->private_->thread_pool) {
+			/* the threads of the pool take the place of the threads this instance would create */
+			encoder->private_->num_created_threads = encoder->protected_->num_threads;
+			FLAC__thread_pool_attach(encoder->private_->thread_pool, &encoder->private_->thread_pool_source, process_thread_work_, encoder);
+		}
 #else
 		FLAC__ASSERT(0);
 #endif
@@ -1255,6 +1501,7 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 		encoder->private_->threadtask[t]->integer_signal_33bit_side_unaligned = encoder->private_->threadtask[t]->integer_signal_33bit_side = 0;
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 		encoder->private_->threadtask[t]->windowed_signal_unaligned = encoder->private_->threadtask[t]->windowed_signal = 0;
+		encoder->private_->threadtask[t]->autoc_granules = 0;
 #endif
 		for(i = 0; i < encoder->protected_->channels; i++) {
 			encoder->private_->threadtask[t]->residual_workspace_unaligned[i][0] = encoder->private_->threadtask[t]->residual_workspace[i][0] = 0;
@@ -1281,6 +1528,22 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 			encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
 			return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
 		}
+		FLAC__bitwriter_set_crc16_functions(encoder->private_->threadtask[t]->frame, encoder->private_->local_crc16_functions);
+		if(encoder->protected_->variable_blocksize > 0) {
+			for(i = 0; i <= encoder->protected_->variable_blocksize; i++) {
+				if(0 == (encoder->private_->threadtask[t]->split_frame[i] = FLAC__bitwriter_new()) || !FLAC__bitwriter_init(encoder->private_->threadtask[t]->split_frame[i])) {
+					encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+					return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
+				}
+				FLAC__bitwriter_set_crc16_functions(encoder->private_->threadtask[t]->split_frame[i], encoder->private_->local_crc16_functions);
+			}
+			for(i = 0; i < encoder->protected_->variable_blocksize; i++) {
+				if(0 == (encoder->private_->threadtask[t]->split_halves[i] = FLAC__bitwriter_new()) || !FLAC__bitwriter_init(encoder->private_->threadtask[t]->split_halves[i])) {
+					encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+					return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
+				}
+			}
+		}
 	}
 
 	/*
@@ -1292,6 +1555,35 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 		 * original signal to compare against
 		 */
 		encoder->private_->verify.input_fifo.size = (encoder->protected_->blocksize+OVERREAD_) * encoder->private_->num_threadtasks;
+#ifdef FLAC__USE_THREADS
+		if(encoder->protected_->num_threads > 1) {
+			/* the fifo also holds the samples of the frames in the queue */
+			encoder->private_->verify.queue_size = encoder->private_->num_threadtasks;
+			encoder->private_->verify.input_fifo.size += (encoder->protected_->blocksize+OVERREAD_) * encoder->private_->verify.queue_size;
+			if(0 == (encoder->private_->verify.queue = safe_calloc_(encoder->private_->verify.queue_size, sizeof(verify_frame)))) {
+				encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+				return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
+			}
+			if(FLAC__mtx_init(&encoder->private_->verify.mutex, FLAC__mtx_plain) != FLAC__thrd_success) {
+				free(encoder->private_->verify.queue);
+				encoder->private_->verify.queue = 0;
+				encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+				return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
+			}
+			if(FLAC__cnd_init(&encoder->private_->verify.cond_dequeued) != FLAC__thrd_success) {
+				FLAC__mtx_destroy(&encoder->private_->verify.mutex);
+				free(encoder->private_->verify.queue);
+				encoder->private_->verify.queue = 0;
+				encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+				return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
+			}
+			encoder->private_->verify.queue_head = 0;
+			encoder->private_->verify.queue_tail = 0;
+			FLAC__atomic_store(&encoder->private_->verify.num_queued, 0);
+			FLAC__atomic_store(&encoder->private_->verify.active, 0);
+			FLAC__atomic_store(&encoder->private_->verify.failed, 0);
+		}
+#endif
 		for(i = 0; i < encoder->protected_->channels; i++) {
 			if(0 == (encoder->private_->verify.input_fifo.data[i] = safe_malloc_mul_2op_p(sizeof(FLAC__int32), /*times*/encoder->private_->verify.input_fifo.size))) {
 				encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
@@ -1316,6 +1608,7 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 			return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
 		}
 	}
+	encoder->private_->verify.error = FLAC__STREAM_ENCODER_OK;
 	encoder->private_->verify.error_stats.absolute_sample = 0;
 	encoder->private_->verify.error_stats.frame_number = 0;
 	encoder->private_->verify.error_stats.channel = 0;
@@ -1355,7 +1648,8 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	encoder->private_->streaminfo.type = FLAC__METADATA_TYPE_STREAMINFO;
 	encoder->private_->streaminfo.is_last = false; /* we will have at a minimum a VORBIS_COMMENT afterwards */
 	encoder->private_->streaminfo.length = FLAC__STREAM_METADATA_STREAMINFO_LENGTH;
-	encoder->private_->streaminfo.data.stream_info.min_blocksize = encoder->protected_->blocksize; /* this encoder uses the same blocksize for the whole stream */
+	/* this encoder uses the same blocksize for the whole stream, unless blocks may be split */
+	encoder->private_->streaminfo.data.stream_info.min_blocksize = encoder->protected_->blocksize >> get_blocksize_splits_(encoder, encoder->protected_->blocksize);
 	encoder->private_->streaminfo.data.stream_info.max_blocksize = encoder->protected_->blocksize;
 	encoder->private_->streaminfo.data.stream_info.min_framesize = 0; /* we don't know this yet; have to fill it in later */
 	encoder->private_->streaminfo.data.stream_info.max_framesize = 0; /* we don't know this yet; have to fill it in later */
@@ -1364,8 +1658,10 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	encoder->private_->streaminfo.data.stream_info.bits_per_sample = encoder->protected_->bits_per_sample;
 	encoder->private_->streaminfo.data.stream_info.total_samples = encoder->protected_->total_samples_estimate; /* we will replace this later with the real total */
 	memset(encoder->private_->streaminfo.data.stream_info.md5sum, 0, 16); /* we don't know this yet; have to fill it in later */
-	if(encoder->protected_->do_md5)
+	if(encoder->protected_->do_md5) {
 		FLAC__MD5Init(&encoder->private_->md5context);
+		encoder->private_->md5context.format_input = encoder->private_->local_md5_format_input;
+	}
 	if(!FLAC__add_metadata_block(&encoder->private_->streaminfo, encoder->private_->threadtask[0]->frame, true)) {
 		encoder->protected_->state = FLAC__STREAM_ENCODER_FRAMING_ERROR;
 		return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
@@ -1679,23 +1975,20 @@ FLAC_API FLAC__bool FLAC__stream_encoder_finish(FLAC__StreamEncoder *encoder)
 			for(twrap = start; twrap < end; twrap++) {
 				FLAC__ASSERT(twrap > 0);
 				t = (twrap - 1) % (encoder->private_->num_threadtasks - 1) + 1;
-				/* Lock mutex, if task isn't done yet, wait for condition */
-				FLAC__mtx_lock(&encoder->private_->threadtask[t]->mutex_this_task);
-				while(!encoder->private_->threadtask[t]->task_done)
-					FLAC__cnd_wait(&encoder->private_->threadtask[t]->cond_task_done,&encoder->private_->threadtask[t]->mutex_this_task);
+				wait_for_threadtask_(encoder, encoder->private_->threadtask[t]);
 
 				if(!encoder->private_->threadtask[t]->returnvalue)
 					ok = false;
 				if(ok && !write_bitbuffer_(encoder, encoder->private_->threadtask[t], encoder->protected_->blocksize, 0))
 					ok = false;
-				FLAC__mtx_unlock(&encoder->private_->threadtask[t]->mutex_this_task);
 			}
 			/* Wait for MD5 calculation to finish */
-			FLAC__mtx_lock(&encoder->private_->mutex_work_queue);
-			while(encoder->private_->md5_active || encoder->private_->md5_fifo.tail > 0) {
-				FLAC__cnd_wait(&encoder->private_->cond_md5_emptied, &encoder->private_->mutex_work_queue);
+			wake_up_threads_(encoder, true);
+			FLAC__mtx_lock(&encoder->private_->mutex_md5_fifo);
+			while(FLAC__atomic_load(&encoder->private_->md5_active) || encoder->private_->md5_fifo.tail > 0) {
+				FLAC__cnd_wait(&encoder->private_->cond_md5_emptied, &encoder->private_->mutex_md5_fifo);
 			}
-			FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
+			FLAC__mtx_unlock(&encoder->private_->mutex_md5_fifo);
 #else
 			FLAC__ASSERT(0);
 #endif
@@ -1715,26 +2008,54 @@ FLAC_API FLAC__bool FLAC__stream_encoder_finish(FLAC__StreamEncoder *encoder)
 #ifdef FLAC__USE_THREADS
 		/* Properly finish all threads */
 		uint32_t t;
+		if(0 != encoder->private_->verify.queue && !finish_verify_queue_(encoder) && !error) {
+			encoder->protected_->state = encoder->private_->verify.error;
+			error = true;
+		}
 		FLAC__mtx_lock(&encoder->private_->mutex_work_queue);
-		for(t = 1; t < encoder->private_->num_created_threads; t++)
-			encoder->private_->finish_work_threads = true;
-		FLAC__cnd_broadcast(&encoder->private_->cond_wake_up_thread);
+		encoder->private_->finish_work_threads = true;
 		FLAC__cnd_broadcast(&encoder->private_->cond_work_available);
 		FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
 
-		for(t = 1; t < encoder->private_->num_created_threads; t++)
-			FLAC__thrd_join(encoder->private_->thread[t], NULL);
+		if(0 != encoder->private_->thread_pool)
+			FLAC__thread_pool_detach(encoder->private_->thread_pool, &encoder->private_->thread_pool_source);
+		else
+			for(t = 1; t < encoder->private_->num_created_threads; t++)
+				FLAC__thrd_join(encoder->private_->thread[t], NULL);
 #else
 			FLAC__ASSERT(0);
 #endif
 	}
 
+#ifdef FLAC__PROFILING
+	/* The threads are done, collect their counters before the
+	 * threadtasks are freed. Those of the first threadtask are left
+	 * alone, FLAC__stream_encoder_get_profile() adds them */
+	{
+		uint32_t t, stage;
+		for(t = 1; t < encoder->private_->num_threadtasks; t++) {
+			if(0 == encoder->private_->threadtask[t])
+				continue;
+			for(stage = 0; stage < FLAC__STREAM_ENCODER_PROFILE_NUM_STAGES; stage++) {
+				encoder->private_->profile.nanoseconds[stage] += encoder->private_->threadtask[t]->profile.nanoseconds[stage];
+				encoder->private_->profile.calls[stage] += encoder->private_->threadtask[t]->profile.calls[stage];
+			}
+		}
+#ifdef FLAC__USE_THREADS
+		for(stage = 0; stage < FLAC__STREAM_ENCODER_PROFILE_NUM_STAGES; stage++) {
+			encoder->private_->profile.nanoseconds[stage] += encoder->private_->md5_fifo_profile.nanoseconds[stage];
+			encoder->private_->profile.calls[stage] += encoder->private_->md5_fifo_profile.calls[stage];
+		}
+#endif
+	}
+#endif
+
 	if(encoder->protected_->do_md5)
 		FLAC__MD5Final(encoder->private_->streaminfo.data.stream_info.md5sum, &encoder->private_->md5context);
 
 	if(!encoder->private_->is_being_deleted) {
 		if(encoder->protected_->state == FLAC__STREAM_ENCODER_OK) {
-			if(encoder->private_->seek_callback) {
+			if(encoder->private_->seek_callback && encoder->protected_->estimate_only == 0) {
 #if FLAC__HAS_OGG
 				if(encoder->private_->is_ogg)
 					update_ogg_metadata_(encoder);
@@ -1914,6 +2235,19 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_blocksize(FLAC__StreamEncoder *enco
 	return true;
 }
 
+FLAC_API FLAC__bool FLAC__stream_encoder_set_variable_blocksize(FLAC__StreamEncoder *encoder, uint32_t value)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	if(value > FLAC__STREAM_ENCODER_MAX_BLOCKSIZE_SPLITS)
+		return false;
+	encoder->protected_->variable_blocksize = value;
+	return true;
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_set_do_mid_side_stereo(FLAC__StreamEncoder *encoder, FLAC__bool value)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -2171,6 +2505,21 @@ FLAC_API uint32_t FLAC__stream_encoder_set_num_threads(FLAC__StreamEncoder *enco
 #endif
 }
 
+FLAC_API FLAC__bool FLAC__stream_encoder_set_thread_pool(FLAC__StreamEncoder *encoder, FLAC__ThreadPool *pool)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+#ifdef FLAC__USE_THREADS
+	encoder->private_->thread_pool = pool;
+	return true;
+#else
+	return 0 == pool;
+#endif
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_set_rice_parameter_search_dist(FLAC__StreamEncoder *encoder, uint32_t value)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -2242,8 +2591,30 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_limit_min_bitrate(FLAC__StreamEncod
 	return true;
 }
 
+FLAC_API FLAC__bool FLAC__stream_encoder_set_estimate_only(FLAC__StreamEncoder *encoder, uint32_t value)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->protected_->estimate_only = value;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_encoder_set_write_buffer_callback(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderWriteBufferCallback write_buffer_callback)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->private_->write_buffer_callback = write_buffer_callback;
+	return true;
+}
+
 /*
- * These four functions are not static, but not publicly exposed in
+ * These functions are not static, but not publicly exposed in
  * include/FLAC/ either.  They are used by the test suite and in fuzzing
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_disable_instruction_set(FLAC__StreamEncoder *encoder, FLAC__bool value)
@@ -2296,6 +2667,20 @@ FLAC_API FLAC__bool FLAC__stream_encoder_disable_verbatim_subframes(FLAC__Stream
 	return true;
 }
 
+/* Makes the verify decoder expect a different value for the given sample of
+ * the first channel, so that reporting a mismatch can be tested */
+FLAC_API FLAC__bool FLAC__stream_encoder_inject_verify_mismatch(FLAC__StreamEncoder *encoder, FLAC__uint64 absolute_sample)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->private_->inject_verify_mismatch = true;
+	encoder->private_->verify_mismatch_sample = absolute_sample;
+	return true;
+}
+
 FLAC_API FLAC__StreamEncoderState FLAC__stream_encoder_get_state(const FLAC__StreamEncoder *encoder)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -2350,6 +2735,52 @@ FLAC_API void FLAC__stream_encoder_get_verify_decoder_error_stats(const FLAC__St
 		*got = encoder->private_->verify.error_stats.got;
 }
 
+FLAC_API void FLAC__stream_encoder_get_estimate(const FLAC__StreamEncoder *encoder, FLAC__uint64 *bytes, FLAC__uint64 *bytes_low, FLAC__uint64 *bytes_high, uint32_t *frames_analysed)
+{
+	const FLAC__uint64 metadata_bytes = encoder->private_->estimate.metadata_bytes;
+	double estimate = 0.0, margin = 0.0;
+
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+
+	if(encoder->private_->estimate.samples > 0.0) {
+		/* The analysed blocks are a sample of all blocks, from which the
+		 * ratio of bytes to samples is estimated. The variance of that
+		 * ratio follows from the deviation of each block from the ratio,
+		 * corrected for the fraction of blocks that was analysed */
+		const double n = encoder->private_->estimate.blocks;
+		const double total_samples = (double)encoder->private_->estimate.total_samples;
+		const double ratio = encoder->private_->estimate.bytes / encoder->private_->estimate.samples;
+		estimate = total_samples * ratio;
+		if(encoder->private_->estimate.blocks < encoder->private_->estimate.total_blocks) {
+			if(encoder->private_->estimate.blocks > 1) {
+				const double mean_samples = encoder->private_->estimate.samples / n;
+				const double sampled_fraction = n / encoder->private_->estimate.total_blocks;
+				double deviation = encoder->private_->estimate.bytes_squared - 2.0 * ratio * encoder->private_->estimate.samples_bytes + ratio * ratio * encoder->private_->estimate.samples_squared;
+				if(deviation < 0.0)
+					deviation = 0.0;
+				margin = 1.96 * total_samples * sqrt((1.0 - sampled_fraction) * deviation / (n - 1.0) / n) / mean_samples;
+			}
+			else {
+				/* With a single block there is nothing to go by; the
+				 * stream is at least the metadata and at most about as
+				 * large as the unencoded audio */
+				margin = -1.0;
+			}
+		}
+	}
+
+	if(0 != bytes)
+		*bytes = metadata_bytes + (FLAC__uint64)(estimate + 0.5);
+	if(0 != bytes_low)
+		*bytes_low = margin < 0.0? metadata_bytes : metadata_bytes + (FLAC__uint64)(estimate > margin? estimate - margin + 0.5 : 0.0);
+	if(0 != bytes_high)
+		*bytes_high = metadata_bytes + (FLAC__uint64)(margin < 0.0? flac_max(estimate, (double)encoder->private_->estimate.total_samples * encoder->private_->estimate.sample_bits / 8.0) : estimate + margin + 0.5);
+	if(0 != frames_analysed)
+		*frames_analysed = encoder->private_->estimate.blocks;
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_get_verify(const FLAC__StreamEncoder *encoder)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -2406,6 +2837,14 @@ FLAC_API uint32_t FLAC__stream_encoder_get_blocksize(const FLAC__StreamEncoder *
 	return encoder->protected_->blocksize;
 }
 
+FLAC_API uint32_t FLAC__stream_encoder_get_variable_blocksize(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->variable_blocksize;
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_get_do_mid_side_stereo(const FLAC__StreamEncoder *encoder)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -2510,6 +2949,39 @@ FLAC_API FLAC__bool FLAC__stream_encoder_get_limit_min_bitrate(const FLAC__Strea
 	return encoder->protected_->limit_min_bitrate;
 }
 
+FLAC_API uint32_t FLAC__stream_encoder_get_estimate_only(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->estimate_only;
+}
+
+FLAC_API FLAC__bool FLAC__stream_encoder_get_profile(const FLAC__StreamEncoder *encoder, FLAC__StreamEncoderProfile *profile)
+{
+#ifdef FLAC__PROFILING
+	uint32_t stage;
+#endif
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	FLAC__ASSERT(0 != profile);
+#ifdef FLAC__PROFILING
+	/* The first threadtask is only used by the calling thread, so its
+	 * counters can be added while encoding */
+	*profile = encoder->private_->profile;
+	for(stage = 0; stage < FLAC__STREAM_ENCODER_PROFILE_NUM_STAGES; stage++) {
+		profile->nanoseconds[stage] += encoder->private_->threadtask[0]->profile.nanoseconds[stage];
+		profile->calls[stage] += encoder->private_->threadtask[0]->profile.calls[stage];
+	}
+	return true;
+#else
+	(void)encoder;
+	memset(profile, 0, sizeof(*profile));
+	return false;
+#endif
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_process(FLAC__StreamEncoder *encoder, const FLAC__int32 * const buffer[], uint32_t samples)
 {
 	uint32_t i, j = 0, k = 0, channel;
@@ -2533,8 +3005,17 @@ FLAC_API FLAC__bool FLAC__stream_encoder_process(FLAC__StreamEncoder *encoder, c
 	do {
 		const uint32_t n = flac_min(blocksize+OVERREAD_-encoder->private_->current_sample_number, samples-j);
 
-		if(encoder->protected_->verify)
+		if(encoder->protected_->verify) {
+#ifdef FLAC__USE_THREADS
+			if(0 != encoder->private_->verify.queue)
+				FLAC__mtx_lock(&encoder->private_->verify.mutex);
+#endif
 			append_to_verify_fifo_(&encoder->private_->verify.input_fifo, buffer, j, channels, n);
+#ifdef FLAC__USE_THREADS
+			if(0 != encoder->private_->verify.queue)
+				FLAC__mtx_unlock(&encoder->private_->verify.mutex);
+#endif
+		}
 
 		for(channel = 0; channel < channels; channel++) {
 			if (buffer[channel] == NULL) {
@@ -2589,8 +3070,17 @@ FLAC_API FLAC__bool FLAC__stream_encoder_process_interleaved(FLAC__StreamEncoder
 
 	j = k = 0;
 	do {
-		if(encoder->protected_->verify)
+		if(encoder->protected_->verify) {
+#ifdef FLAC__USE_THREADS
+			if(0 != encoder->private_->verify.queue)
+				FLAC__mtx_lock(&encoder->private_->verify.mutex);
+#endif
 			append_to_verify_fifo_interleaved_(&encoder->private_->verify.input_fifo, buffer, j, channels, flac_min(blocksize+OVERREAD_-encoder->private_->current_sample_number, samples-j));
+#ifdef FLAC__USE_THREADS
+			if(0 != encoder->private_->verify.queue)
+				FLAC__mtx_unlock(&encoder->private_->verify.mutex);
+#endif
+		}
 
 			/* "i <= blocksize" to overread 1 sample; see comment in OVERREAD_ decl */
 		for(i = encoder->private_->current_sample_number; i <= blocksize && j < samples; i++, j++) {
@@ -2619,6 +3109,15 @@ FLAC_API FLAC__bool FLAC__stream_encoder_process_interleaved(FLAC__StreamEncoder
 	return true;
 }
 
+FLAC_API FLAC__bool FLAC__stream_encoder_release_buffer(FLAC__StreamEncoder *encoder, FLAC__byte buffer[])
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != buffer);
+
+	return release_references_(encoder, buffer, 1);
+}
+
 /***********************************************************************
  *
  * Private class methods
@@ -2642,6 +3141,7 @@ void set_defaults_(FLAC__StreamEncoder *encoder)
 	encoder->protected_->bits_per_sample = 16;
 	encoder->protected_->sample_rate = 44100;
 	encoder->protected_->blocksize = 0;
+	encoder->protected_->variable_blocksize = 0;
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	encoder->protected_->num_apodizations = 1;
 	encoder->protected_->apodizations[0].type = FLAC__APODIZATION_TUKEY;
@@ -2657,6 +3157,7 @@ void set_defaults_(FLAC__StreamEncoder *encoder)
 	encoder->protected_->rice_parameter_search_dist = 0;
 	encoder->protected_->total_samples_estimate = 0;
 	encoder->protected_->limit_min_bitrate = false;
+	encoder->protected_->estimate_only = 0;
 	encoder->protected_->metadata = 0;
 	encoder->protected_->num_metadata_blocks = 0;
 	encoder->protected_->num_threads = 1;
@@ -2671,9 +3172,12 @@ void set_defaults_(FLAC__StreamEncoder *encoder)
 	encoder->private_->disable_constant_subframes = false;
 	encoder->private_->disable_fixed_subframes = false;
 	encoder->private_->disable_verbatim_subframes = false;
+	encoder->private_->inject_verify_mismatch = false;
+	encoder->private_->verify_mismatch_sample = 0;
 	encoder->private_->is_ogg = false;
 	encoder->private_->read_callback = 0;
 	encoder->private_->write_callback = 0;
+	encoder->private_->write_buffer_callback = 0;
 	encoder->private_->seek_callback = 0;
 	encoder->private_->tell_callback = 0;
 	encoder->private_->metadata_callback = 0;
@@ -2682,13 +3186,15 @@ void set_defaults_(FLAC__StreamEncoder *encoder)
 	encoder->private_->num_threadtasks = 1;
 #ifdef FLAC__USE_THREADS
 	encoder->private_->num_created_threads = 1;
+	encoder->private_->thread_pool = 0;
 	encoder->private_->next_thread = 1;
-	encoder->private_->num_running_threads = 1;
 	encoder->private_->num_started_threadtasks = 1;
-	encoder->private_->num_available_threadtasks = 0;
-	encoder->private_->overcommitted_indicator = 0;
-	encoder->private_->next_threadtask = 1;
-	encoder->private_->md5_active = false;
+	FLAC__atomic_store(&encoder->private_->threadtask_submit_position, 0);
+	FLAC__atomic_store(&encoder->private_->threadtask_claim_position, 0);
+	FLAC__atomic_store(&encoder->private_->num_parked_threads, 0);
+	encoder->private_->num_unannounced_threadtasks = 0;
+	FLAC__atomic_store(&encoder->private_->md5_active, 0);
+	FLAC__atomic_store(&encoder->private_->md5_fifo_tail, 0);
 	encoder->private_->finish_work_threads = false;
 #endif
 
@@ -2741,6 +3247,10 @@ void free_(FLAC__StreamEncoder *encoder)
 			free(encoder->private_->threadtask[t]->windowed_signal_unaligned);
 			encoder->private_->threadtask[t]->windowed_signal_unaligned = 0;
 		}
+		if(0 != encoder->private_->threadtask[t]->autoc_granules) {
+			free(encoder->private_->threadtask[t]->autoc_granules);
+			encoder->private_->threadtask[t]->autoc_granules = 0;
+		}
 #endif
 		for(channel = 0; channel < encoder->protected_->channels; channel++) {
 			for(i = 0; i < 2; i++) {
@@ -2776,6 +3286,16 @@ void free_(FLAC__StreamEncoder *encoder)
 		}
 		for(i = 0; i < 2; i++)
 			FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->threadtask[t]->partitioned_rice_contents_extra[i]);
+		for(i = 0; i <= FLAC__STREAM_ENCODER_MAX_BLOCKSIZE_SPLITS; i++) {
+			if(0 != encoder->private_->threadtask[t]->split_frame[i]) {
+				FLAC__bitwriter_delete(encoder->private_->threadtask[t]->split_frame[i]);
+				encoder->private_->threadtask[t]->split_frame[i] = 0;
+			}
+			if(i < FLAC__STREAM_ENCODER_MAX_BLOCKSIZE_SPLITS && 0 != encoder->private_->threadtask[t]->split_halves[i]) {
+				FLAC__bitwriter_delete(encoder->private_->threadtask[t]->split_halves[i]);
+				encoder->private_->threadtask[t]->split_halves[i] = 0;
+			}
+		}
 		if(t > 0) {
 #ifdef FLAC__USE_THREADS
 			FLAC__bitwriter_delete(encoder->private_->threadtask[t]->frame);
@@ -2795,7 +3315,6 @@ void free_(FLAC__StreamEncoder *encoder)
 		FLAC__mtx_destroy(&encoder->private_->mutex_work_queue);
 		FLAC__cnd_destroy(&encoder->private_->cond_md5_emptied);
 		FLAC__cnd_destroy(&encoder->private_->cond_work_available);
-		FLAC__cnd_destroy(&encoder->private_->cond_wake_up_thread);
 		if(encoder->protected_->do_md5) {
 			for(i = 0; i < encoder->protected_->channels; i++) {
 				if(0 != encoder->private_->md5_fifo.data[i]) {
@@ -2815,6 +3334,31 @@ void free_(FLAC__StreamEncoder *encoder)
 			}
 		}
 	}
+#ifdef FLAC__USE_THREADS
+	if(0 != encoder->private_->verify.queue) {
+		for(i = 0; i < encoder->private_->verify.queue_size; i++)
+			free(encoder->private_->verify.queue[i].data);
+		free(encoder->private_->verify.queue);
+		encoder->private_->verify.queue = 0;
+		FLAC__mtx_destroy(&encoder->private_->verify.mutex);
+		FLAC__cnd_destroy(&encoder->private_->verify.cond_dequeued);
+	}
+#endif
+	/* buffers still held by the client are kept until they are released */
+#ifdef FLAC__USE_THREADS
+	FLAC__mtx_lock(&encoder->private_->output_pool.mutex);
+#endif
+	for(i = 0; i < encoder->private_->output_pool.num_buffers; i++) {
+		output_buffer *buffer = &encoder->private_->output_pool.buffers[i];
+		if(buffer->references == 0 && 0 != buffer->data) {
+			free(buffer->data);
+			buffer->data = 0;
+			buffer->capacity = 0;
+		}
+	}
+#ifdef FLAC__USE_THREADS
+	FLAC__mtx_unlock(&encoder->private_->output_pool.mutex);
+#endif
 }
 
 FLAC__bool resize_buffers_(FLAC__StreamEncoder *encoder, uint32_t new_blocksize)
@@ -2837,8 +3381,11 @@ FLAC__bool resize_buffers_(FLAC__StreamEncoder *encoder, uint32_t new_blocksize)
 		 */
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 		if(ok && encoder->protected_->max_lpc_order > 0) {
+			/* for variable-blocksize streams, the windows for halved blocks
+			 * are stored after the window; they add up to less than new_blocksize */
+			const uint32_t window_size = encoder->protected_->variable_blocksize > 0? new_blocksize * 2 : new_blocksize;
 			for(i = 0; ok && i < encoder->protected_->num_apodizations; i++)
-				ok = ok && FLAC__memory_alloc_aligned_real_array(new_blocksize, &encoder->private_->window_unaligned[i], &encoder->private_->window[i]);
+				ok = ok && FLAC__memory_alloc_aligned_real_array(window_size, &encoder->private_->window_unaligned[i], &encoder->private_->window[i]);
 		}
 #endif
 		for(t = 0; t < encoder->private_->num_threadtasks; t++) {
@@ -2860,6 +3407,8 @@ FLAC__bool resize_buffers_(FLAC__StreamEncoder *encoder, uint32_t new_blocksize)
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 			if(ok && encoder->protected_->max_lpc_order > 0) {
 				ok = ok && FLAC__memory_alloc_aligned_real_array(new_blocksize, &encoder->private_->threadtask[t]->windowed_signal_unaligned, &encoder->private_->threadtask[t]->windowed_signal);
+				free(encoder->private_->threadtask[t]->autoc_granules);
+				ok = ok && 0 != (encoder->private_->threadtask[t]->autoc_granules = safe_malloc_mul_2op_p(sizeof(autoc_granule_struct), /*times*/new_blocksize / FLAC__STREAM_ENCODER_AUTOC_GRANULE + 1));
 			}
 #endif
 			for(channel = 0; ok && channel < encoder->protected_->channels; channel++) {
@@ -2911,67 +3460,78 @@ FLAC__bool resize_buffers_(FLAC__StreamEncoder *encoder, uint32_t new_blocksize)
 	/* now adjust the windows if the blocksize has changed */
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	if(encoder->protected_->max_lpc_order > 0 && new_blocksize > 1) {
+		const uint32_t splits = get_blocksize_splits_(encoder, new_blocksize);
 		for(i = 0; i < encoder->protected_->num_apodizations; i++) {
-			switch(encoder->protected_->apodizations[i].type) {
-				case FLAC__APODIZATION_BARTLETT:
-					FLAC__window_bartlett(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_BARTLETT_HANN:
-					FLAC__window_bartlett_hann(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_BLACKMAN:
-					FLAC__window_blackman(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_BLACKMAN_HARRIS_4TERM_92DB_SIDELOBE:
-					FLAC__window_blackman_harris_4term_92db_sidelobe(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_CONNES:
-					FLAC__window_connes(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_FLATTOP:
-					FLAC__window_flattop(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_GAUSS:
-					FLAC__window_gauss(encoder->private_->window[i], new_blocksize, encoder->protected_->apodizations[i].parameters.gauss.stddev);
-					break;
-				case FLAC__APODIZATION_HAMMING:
-					FLAC__window_hamming(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_HANN:
-					FLAC__window_hann(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_KAISER_BESSEL:
-					FLAC__window_kaiser_bessel(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_NUTTALL:
-					FLAC__window_nuttall(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_RECTANGLE:
-					FLAC__window_rectangle(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_TRIANGLE:
-					FLAC__window_triangle(encoder->private_->window[i], new_blocksize);
-					break;
-				case FLAC__APODIZATION_TUKEY:
-					FLAC__window_tukey(encoder->private_->window[i], new_blocksize, encoder->protected_->apodizations[i].parameters.tukey.p);
-					break;
-				case FLAC__APODIZATION_PARTIAL_TUKEY:
-					FLAC__window_partial_tukey(encoder->private_->window[i], new_blocksize, encoder->protected_->apodizations[i].parameters.multiple_tukey.p, encoder->protected_->apodizations[i].parameters.multiple_tukey.start, encoder->protected_->apodizations[i].parameters.multiple_tukey.end);
-					break;
-				case FLAC__APODIZATION_PUNCHOUT_TUKEY:
-					FLAC__window_punchout_tukey(encoder->private_->window[i], new_blocksize, encoder->protected_->apodizations[i].parameters.multiple_tukey.p, encoder->protected_->apodizations[i].parameters.multiple_tukey.start, encoder->protected_->apodizations[i].parameters.multiple_tukey.end);
-					break;
-				case FLAC__APODIZATION_SUBDIVIDE_TUKEY:
-					FLAC__window_tukey(encoder->private_->window[i], new_blocksize, encoder->protected_->apodizations[i].parameters.tukey.p);
-					break;
-				case FLAC__APODIZATION_WELCH:
-					FLAC__window_welch(encoder->private_->window[i], new_blocksize);
-					break;
-				default:
-					FLAC__ASSERT(0);
-					/* double protection */
-					FLAC__window_hann(encoder->private_->window[i], new_blocksize);
+			FLAC__real *window = encoder->private_->window[i];
+			uint32_t window_blocksize = new_blocksize;
+			for(t = 0; ; t++) {
+				switch(encoder->protected_->apodizations[i].type) {
+					case FLAC__APODIZATION_BARTLETT:
+						FLAC__window_bartlett(window, window_blocksize);
+						break;
+					case FLAC__APODIZATION_BARTLETT_HANN:
+						FLAC__window_bartlett_hann(window, window_blocksize);
+						break;
+					case FLAC__APODIZATION_BLACKMAN:
+						FLAC__window_blackman(window, window_blocksize);
+						break;
+					case FLAC__APODIZATION_BLACKMAN_HARRIS_4TERM_92DB_SIDELOBE:
+						FLAC__window_blackman_harris_4term_92db_sidelobe(window, window_blocksize);
+						break;
+					case FLAC__APODIZATION_CONNES:
+						FLAC__window_connes(window, window_blocksize);
+						break;
+					case FLAC__APODIZATION_FLATTOP:
+						FLAC__window_flattop(window, window_blocksize);
+						break;
+					case FLAC__APODIZATION_GAUSS:
+						FLAC__window_gauss(window, window_blocksize, encoder->protected_->apodizations[i].parameters.gauss.stddev);
+						break;
+					case FLAC__APODIZATION_HAMMING:
+						FLAC__window_hamming(window, window_blocksize);
+						break;
+					case FLAC__APODIZATION_HANN:
+						FLAC__window_hann(window, window_blocksize);
+						break;
+					case FLAC__APODIZATION_KAISER_BESSEL:
+						FLAC__window_kaiser_bessel(window, window_blocksize);
+						break;
+					case FLAC__APODIZATION_NUTTALL:
+						FLAC__window_nuttall(window, window_blocksize);
+						break;
+					case FLAC__APODIZATION_RECTANGLE:
+						FLAC__window_rectangle(window, window_blocksize);
+						break;
+					case FLAC__APODIZATION_TRIANGLE:
+						FLAC__window_triangle(window, window_blocksize);
+						break;
+					case FLAC__APODIZATION_TUKEY:
+						FLAC__window_tukey(window, window_blocksize, encoder->protected_->apodizations[i].parameters.tukey.p);
+						break;
+					case FLAC__APODIZATION_PARTIAL_TUKEY:
+						FLAC__window_partial_tukey(window, window_blocksize, encoder->protected_->apodizations[i].parameters.multiple_tukey.p, encoder->protected_->apodizations[i].parameters.multiple_tukey.start, encoder->protected_->apodizations[i].parameters.multiple_tukey.end);
+						break;
+					case FLAC__APODIZATION_PUNCHOUT_TUKEY:
+						FLAC__window_punchout_tukey(window, window_blocksize, encoder->protected_->apodizations[i].parameters.multiple_tukey.p, encoder->protected_->apodizations[i].parameters.multiple_tukey.start, encoder->protected_->apodizations[i].parameters.multiple_tukey.end);
+						break;
+					case FLAC__APODIZATION_SUBDIVIDE_TUKEY:
+						FLAC__window_tukey(window, window_blocksize, encoder->protected_->apodizations[i].parameters.tukey.p);
+						break;
+					case FLAC__APODIZATION_WELCH:
+						FLAC__window_welch(window, window_blocksize);
+						break;
+					default:
+						FLAC__ASSERT(0);
+						/* double protection */
+						FLAC__window_hann(window, window_blocksize);
+						break;
+				}
+				set_window_range_(window, window_blocksize, &encoder->private_->window_range[t][i]);
+				if(t == splits)
 					break;
+				window += window_blocksize;
+				window_blocksize /= 2;
+				encoder->private_->window_split[t][i] = window;
 			}
 		}
 	}
@@ -2988,7 +3548,8 @@ FLAC__bool resize_buffers_(FLAC__StreamEncoder *encoder, uint32_t new_blocksize)
 FLAC__bool write_bitbuffer_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderThreadTask *threadtask, uint32_t samples, FLAC__bool is_last_block)
 {
 	const FLAC__byte *buffer;
-	size_t bytes;
+	size_t bytes, frame_bytes;
+	uint32_t frame, num_frames = 1, frame_samples;
 
 	FLAC__ASSERT(FLAC__bitwriter_is_byte_aligned(threadtask->frame));
 
@@ -2997,41 +3558,90 @@ FLAC__bool write_bitbuffer_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderThr
 		return false;
 	}
 
-	if(encoder->protected_->verify) {
-		encoder->private_->verify.output.data = buffer;
-		encoder->private_->verify.output.bytes = bytes;
-		if(encoder->private_->verify.state_hint == ENCODER_IN_MAGIC) {
-			encoder->private_->verify.needs_magic_hack = true;
-		}
+	/* When only estimating, the sizes are added up instead of written */
+	if(encoder->protected_->estimate_only > 0) {
+		if(samples == 0)
+			encoder->private_->estimate.metadata_bytes += bytes;
 		else {
-			if(!FLAC__stream_decoder_process_single(encoder->private_->verify.decoder)
-			    || (!is_last_block
-				    && (FLAC__stream_encoder_get_verify_decoder_state(encoder) == FLAC__STREAM_DECODER_END_OF_STREAM))
-			    || encoder->protected_->state == FLAC__STREAM_ENCODER_VERIFY_DECODER_ERROR /* Happens when error callback was used */) {
+			double block_bytes = (double)bytes;
+			if(encoder->protected_->variable_blocksize == 0) /* only the header was written */
+				block_bytes += (threadtask->estimated_bits + 7) / 8 + FLAC__FRAME_FOOTER_CRC_LEN / 8;
+			encoder->private_->estimate.blocks++;
+			encoder->private_->estimate.samples += samples;
+			encoder->private_->estimate.bytes += block_bytes;
+			encoder->private_->estimate.samples_squared += (double)samples * samples;
+			encoder->private_->estimate.bytes_squared += block_bytes * block_bytes;
+			encoder->private_->estimate.samples_bytes += samples * block_bytes;
+		}
+		FLAC__bitwriter_release_buffer(threadtask->frame);
+		FLAC__bitwriter_clear(threadtask->frame);
+		return true;
+	}
+
+	frame_bytes = bytes;
+	frame_samples = samples;
+
+	/* In a variable-blocksize stream, the block may have been split into
+	 * several frames, which are verified and written one by one */
+	if(samples > 0 && encoder->protected_->variable_blocksize > 0)
+		num_frames = threadtask->num_frames;
+
+	/* The client takes the buffer, one reference for each frame, and the
+	 * bitwriter continues with a free one */
+	if(encoder->private_->write_buffer_callback && !hand_over_buffer_(encoder, threadtask->frame, num_frames)) {
+		encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
+
+	for(frame = 0; frame < num_frames; frame++) {
+		const FLAC__bool is_last_frame = is_last_block && frame + 1 == num_frames;
+
+		if(samples > 0 && encoder->protected_->variable_blocksize > 0) {
+			frame_bytes = threadtask->frame_bytes[frame];
+			frame_samples = threadtask->frame_blocksize[frame];
+		}
+
+		if(encoder->protected_->verify) {
+			FLAC__bool ok;
+#ifdef FLAC__USE_THREADS
+			/* Audio frames are verified on the threads once there are any,
+			 * frames verified earlier were done here, so the order holds */
+			if(0 != encoder->private_->verify.queue && samples > 0 && (encoder->private_->num_created_threads > 1 || 0 != encoder->private_->thread_pool))
+				ok = queue_verify_frame_(encoder, buffer, frame_bytes, is_last_frame);
+			else
+#endif
+			ok = verify_frame_(encoder, buffer, frame_bytes, is_last_frame);
+			if(!ok) {
 				FLAC__bitwriter_release_buffer(threadtask->frame);
 				FLAC__bitwriter_clear(threadtask->frame);
-				if(encoder->protected_->state != FLAC__STREAM_ENCODER_VERIFY_MISMATCH_IN_AUDIO_DATA)
-					encoder->protected_->state = FLAC__STREAM_ENCODER_VERIFY_DECODER_ERROR;
+				if(encoder->private_->write_buffer_callback)
+					(void)release_references_(encoder, buffer, num_frames - frame);
+				if(encoder->protected_->state == FLAC__STREAM_ENCODER_OK)
+					encoder->protected_->state = encoder->private_->verify.error;
 				return false;
 			}
 		}
-	}
 
-	if(write_frame_(encoder, buffer, bytes, samples, is_last_block) != FLAC__STREAM_ENCODER_WRITE_STATUS_OK) {
-		FLAC__bitwriter_release_buffer(threadtask->frame);
-		FLAC__bitwriter_clear(threadtask->frame);
-		encoder->protected_->state = FLAC__STREAM_ENCODER_CLIENT_ERROR;
-		return false;
+		if(write_frame_(encoder, buffer, frame_bytes, frame_samples, is_last_frame) != FLAC__STREAM_ENCODER_WRITE_STATUS_OK) {
+			FLAC__bitwriter_release_buffer(threadtask->frame);
+			FLAC__bitwriter_clear(threadtask->frame);
+			if(encoder->private_->write_buffer_callback)
+				(void)release_references_(encoder, buffer, num_frames - frame);
+			encoder->protected_->state = FLAC__STREAM_ENCODER_CLIENT_ERROR;
+			return false;
+		}
+
+		if(frame_samples > 0) {
+			encoder->private_->streaminfo.data.stream_info.min_framesize = flac_min(frame_bytes, encoder->private_->streaminfo.data.stream_info.min_framesize);
+			encoder->private_->streaminfo.data.stream_info.max_framesize = flac_max(frame_bytes, encoder->private_->streaminfo.data.stream_info.max_framesize);
+		}
+
+		buffer += frame_bytes;
 	}
 
 	FLAC__bitwriter_release_buffer(threadtask->frame);
 	FLAC__bitwriter_clear(threadtask->frame);
 
-	if(samples > 0) {
-		encoder->private_->streaminfo.data.stream_info.min_framesize = flac_min(bytes, encoder->private_->streaminfo.data.stream_info.min_framesize);
-		encoder->private_->streaminfo.data.stream_info.max_framesize = flac_max(bytes, encoder->private_->streaminfo.data.stream_info.max_framesize);
-	}
-
 	return true;
 }
 
@@ -3068,9 +3678,8 @@ FLAC__StreamEncoderWriteStatus write_frame_(FLAC__StreamEncoder *encoder, const
 	 * frame yet)
 	 */
 	if(0 != encoder->private_->seek_table && encoder->protected_->audio_offset > 0 && encoder->private_->seek_table->num_points > 0) {
-		const uint32_t blocksize = FLAC__stream_encoder_get_blocksize(encoder);
 		const FLAC__uint64 frame_first_sample = encoder->private_->samples_written;
-		const FLAC__uint64 frame_last_sample = frame_first_sample + (FLAC__uint64)blocksize - 1;
+		const FLAC__uint64 frame_last_sample = frame_first_sample + (FLAC__uint64)samples - 1;
 		FLAC__uint64 test_sample;
 		uint32_t i;
 		for(i = encoder->private_->first_seekpoint_to_check; i < encoder->private_->seek_table->num_points; i++) {
@@ -3087,7 +3696,7 @@ FLAC__StreamEncoderWriteStatus write_frame_(FLAC__StreamEncoder *encoder, const
 
 				encoder->private_->seek_table->points[i].sample_number = frame_first_sample;
 				encoder->private_->seek_table->points[i].stream_offset = output_position - encoder->protected_->audio_offset;
-				encoder->private_->seek_table->points[i].frame_samples = blocksize;
+				encoder->private_->seek_table->points[i].frame_samples = samples;
 				encoder->private_->first_seekpoint_to_check++;
 				/* DO NOT: "break;" and here's why:
 				 * The seektable template may contain more than one target
@@ -3118,7 +3727,11 @@ FLAC__StreamEncoderWriteStatus write_frame_(FLAC__StreamEncoder *encoder, const
 	}
 	else
 #endif
-	status = encoder->private_->write_callback(encoder, buffer, bytes, samples, encoder->private_->current_frame_number, encoder->private_->client_data);
+	if(encoder->private_->write_buffer_callback)
+		/* the buffer is from the output pool, see write_bitbuffer_() */
+		status = encoder->private_->write_buffer_callback(encoder, (FLAC__byte *)buffer, bytes, samples, encoder->private_->current_frame_number, encoder->private_->client_data);
+	else
+		status = encoder->private_->write_callback(encoder, buffer, bytes, samples, encoder->private_->current_frame_number, encoder->private_->client_data);
 
 	if(status == FLAC__STREAM_ENCODER_WRITE_STATUS_OK) {
 		encoder->private_->bytes_written += bytes;
@@ -3135,6 +3748,73 @@ FLAC__StreamEncoderWriteStatus write_frame_(FLAC__StreamEncoder *encoder, const
 	return status;
 }
 
+/* Moves the frame data into a free buffer of the output pool, which is
+ * handed to the client with the given number of references.
+ */
+FLAC__bool hand_over_buffer_(FLAC__StreamEncoder *encoder, FLAC__BitWriter *frame, uint32_t references)
+{
+	output_buffer *buffer = 0;
+	uint32_t i;
+	FLAC__bool ok = true;
+
+	FLAC__ASSERT(references > 0);
+
+#ifdef FLAC__USE_THREADS
+	FLAC__mtx_lock(&encoder->private_->output_pool.mutex);
+#endif
+	for(i = 0; i < encoder->private_->output_pool.num_buffers; i++) {
+		if(encoder->private_->output_pool.buffers[i].references == 0) {
+			buffer = &encoder->private_->output_pool.buffers[i];
+			break;
+		}
+	}
+	if(0 == buffer) {
+		/* all buffers are held by the client, so the pool grows by one */
+		output_buffer *new_buffers = safe_realloc_nofree_mul_2op_(encoder->private_->output_pool.buffers, sizeof(output_buffer), /*times*/encoder->private_->output_pool.num_buffers + 1);
+		if(0 == new_buffers)
+			ok = false;
+		else {
+			encoder->private_->output_pool.buffers = new_buffers;
+			buffer = &new_buffers[encoder->private_->output_pool.num_buffers++];
+			buffer->data = 0;
+			buffer->capacity = 0;
+			buffer->references = 0;
+		}
+	}
+	/* the bitwriter continues in the free buffer and the frame data ends up in the pool */
+	if(ok && (ok = FLAC__bitwriter_exchange_buffer(frame, &buffer->data, &buffer->capacity)))
+		buffer->references = references;
+#ifdef FLAC__USE_THREADS
+	FLAC__mtx_unlock(&encoder->private_->output_pool.mutex);
+#endif
+	return ok;
+}
+
+/* Drops references to the output pool buffer containing 'buffer'; returns
+ * false if no buffer holds that many references to it.
+ */
+FLAC__bool release_references_(FLAC__StreamEncoder *encoder, const FLAC__byte *buffer, uint32_t references)
+{
+	uint32_t i;
+	FLAC__bool found = false;
+
+#ifdef FLAC__USE_THREADS
+	FLAC__mtx_lock(&encoder->private_->output_pool.mutex);
+#endif
+	for(i = 0; i < encoder->private_->output_pool.num_buffers; i++) {
+		output_buffer *b = &encoder->private_->output_pool.buffers[i];
+		if(b->references >= references && buffer >= (const FLAC__byte *)b->data && buffer < (const FLAC__byte *)b->data + b->capacity) {
+			b->references -= references;
+			found = true;
+			break;
+		}
+	}
+#ifdef FLAC__USE_THREADS
+	FLAC__mtx_unlock(&encoder->private_->output_pool.mutex);
+#endif
+	return found;
+}
+
 /* Gets called when the encoding process has finished so that we can update the STREAMINFO and SEEKTABLE blocks.  */
 void update_metadata_(const FLAC__StreamEncoder *encoder)
 {
@@ -3434,49 +4114,68 @@ void update_ogg_metadata_(FLAC__StreamEncoder *encoder)
 
 FLAC__bool process_frame_(FLAC__StreamEncoder *encoder, FLAC__bool is_last_block)
 {
-	FLAC__uint16 crc;
 #ifdef FLAC__USE_THREADS
 	uint32_t i;
 #endif
-	if(encoder->protected_->num_threads < 2 || is_last_block) {
+	if(encoder->protected_->estimate_only > 0 && encoder->private_->current_frame_number % encoder->protected_->estimate_only != 0) {
+		/* Only one in every estimate_only blocks is analysed, the others
+		 * are merely counted */
+	}
+	else if(encoder->protected_->num_threads < 2 || is_last_block) {
 
 		FLAC__ASSERT(encoder->protected_->state == FLAC__STREAM_ENCODER_OK);
 
 		/*
 		 * Accumulate raw signal to the MD5 signature
 		 */
-		if(encoder->protected_->do_md5 && !FLAC__MD5Accumulate(&encoder->private_->md5context, (const FLAC__int32 * const *)encoder->private_->threadtask[0]->integer_signal, encoder->protected_->channels, encoder->protected_->blocksize, (encoder->protected_->bits_per_sample+7) / 8)) {
-			encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
-			return false;
+		if(encoder->protected_->do_md5) {
+			FLAC__bool ok;
+			FLAC__PROFILE_START(&encoder->private_->threadtask[0]->profile, FLAC__STREAM_ENCODER_PROFILE_MD5);
+			ok = FLAC__MD5Accumulate(&encoder->private_->md5context, (const FLAC__int32 * const *)encoder->private_->threadtask[0]->integer_signal, encoder->protected_->channels, encoder->protected_->blocksize, (encoder->protected_->bits_per_sample+7) / 8);
+			FLAC__PROFILE_STOP(&encoder->private_->threadtask[0]->profile, FLAC__STREAM_ENCODER_PROFILE_MD5);
+			if(!ok) {
+				encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+				return false;
+			}
 		}
 
-		/*
-		 * Process the frame header and subframes into the frame bitbuffer
-		 */
 		encoder->private_->threadtask[0]->current_frame_number = encoder->private_->current_frame_number;
-		if(!process_subframes_(encoder, encoder->private_->threadtask[0])) {
-			/* the above function sets the state for us in case of an error */
-			return false;
+		encoder->private_->threadtask[0]->first_sample_number = encoder->private_->streaminfo.data.stream_info.total_samples;
+		if(encoder->protected_->variable_blocksize > 0) {
+			/*
+			 * Process the block into one or more frames in the frame bitbuffer
+			 */
+			if(!process_variable_block_(encoder, encoder->private_->threadtask[0], is_last_block)) {
+				/* the above function sets the state for us in case of an error */
+				return false;
+			}
 		}
+		else {
+			/*
+			 * Process the frame header and subframes into the frame bitbuffer
+			 */
+			if(!process_subframes_(encoder, encoder->private_->threadtask[0], 0, encoder->protected_->blocksize, encoder->private_->threadtask[0]->frame)) {
+				/* the above function sets the state for us in case of an error */
+				return false;
+			}
 
-		/*
-		 * Zero-pad the frame to a byte_boundary
-		 */
-		if(!FLAC__bitwriter_zero_pad_to_byte_boundary(encoder->private_->threadtask[0]->frame)) {
-			encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
-			return false;
-		}
+			/*
+			 * Zero-pad the frame to a byte_boundary
+			 */
+			if(!FLAC__bitwriter_zero_pad_to_byte_boundary(encoder->private_->threadtask[0]->frame)) {
+				encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+				return false;
+			}
 
-		/*
-		 * CRC-16 the whole thing
-		 */
-		FLAC__ASSERT(FLAC__bitwriter_is_byte_aligned(encoder->private_->threadtask[0]->frame));
-		if(
-			!FLAC__bitwriter_get_write_crc16(encoder->private_->threadtask[0]->frame, &crc) ||
-			!FLAC__bitwriter_write_raw_uint32(encoder->private_->threadtask[0]->frame, crc, FLAC__FRAME_FOOTER_CRC_LEN)
-		) {
-			encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
-			return false;
+			/*
+			 * CRC-16 the whole thing, unless only the header was written
+			 * because the encoder is only estimating
+			 */
+			FLAC__ASSERT(FLAC__bitwriter_is_byte_aligned(encoder->private_->threadtask[0]->frame));
+			if(encoder->protected_->estimate_only == 0 && !add_frame_footer_(encoder->private_->threadtask[0], encoder->private_->threadtask[0]->frame)) {
+				encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+				return false;
+			}
 		}
 
 		/*
@@ -3498,29 +4197,35 @@ FLAC__bool process_frame_(FLAC__StreamEncoder *encoder, FLAC__bool is_last_block
 		 * done. If it is, the bitbuffer is written and the threadtask memory reused for the next
 		 * frame. If it is not done, the main thread checks whether there is enough work left in the
 		 * queue. If there is a lot of work left, the main thread starts on some of it too.
-		 * If not a lot of work is left, the main thread goes to sleep until the frame due first is
-		 * finished.
+		 * If not a lot of work is left, the main thread waits until the frame due first is
+		 * finished, see wait_for_threadtask_()
 		 *
 		 * - encoder->private_->next_thread is the number of the next thread to be created or, when
 		 *    the required number of threads is created, the next threadtask to be populated,
 		 *    or, when all threadtasks have been populated once, the next threadtask that needs
 		 *    to finish and thus reused.
-		 * - encoder->private_->next_threadtask is the number of the next threadtask that a thread
-		 *    can start work on.
+		 * - encoder->private_->threadtask_claim_position points to the next threadtask that a
+		 *    thread can start work on, see claim_threadtask_()
 		 *
 		 * So, in effect, next_thread is (after startup) a pointer considering the chronological
-		 * order, so input/output isn't shuffled. next_threadtask is a pointer to the next task that
+		 * order, so input/output isn't shuffled. The claim position points to the next task that
 		 * hasn't been picked up by a thread yet. This distinction enables threads to work on frames
 		 * in a non-chronological order
 		 *
+		 * No locks are taken to hand over a threadtask: the main thread only touches a threadtask
+		 * that is done, and a thread only one it claimed. Threads that find no work spin for a
+		 * while and then sleep, and are woken up once a few threadtasks have been submitted,
+		 * see wake_up_threads_()
+		 *
 		 * encoder->protected_->num_threads is the max number of threads that can be spawned
 		 * encoder->private_->num_created_threads is the number of threads that has been spawned
 		 * encoder->private_->num_threadtasks keeps track of how many threadtasks are available
 		 * encoder->private_->num_started_threadtasks keeps track of how many threadtasks have been populated
 		 *
 		 * NOTE: thread no. 0 and threadtask no. 0 are reserved for non-threaded operations, so next_thread
-		 * and next_threadtask start at 1
+		 * starts at 1
 		 */
+		FLAC__StreamEncoderThreadTask * task = encoder->private_->threadtask[encoder->private_->next_thread];
 		if(encoder->private_->num_created_threads < encoder->protected_->num_threads) {
 			/* Create a new thread */
 			FLAC__thrd_create(&encoder->private_->thread[encoder->private_->next_thread],
@@ -3528,82 +4233,41 @@ FLAC__bool process_frame_(FLAC__StreamEncoder *encoder, FLAC__bool is_last_block
 			encoder->private_->num_created_threads++;
 		}
 		else if(encoder->private_->num_started_threadtasks == encoder->private_->num_threadtasks) {
-			/* If the first task in the queue is still running, check whether there is enough work
-			 * left in the queue. If there is, start on some
-			 * First, check whether the mutex for the next due task is locked or free. If it is free (and thus acquired now) and
-			 * the task is done, proceed to the next bit (writing the bitbuffer). If it is either currently locked or not yet
-			 * processed, choose between starting on some work (if there is enough work in the queue) or waiting for the task
-			 * to finish. Either way, release the mutex first, so it doesn't get interlocked with the work queue mutex  */
-			int mutex_result = (FLAC__mtx_trylock(&encoder->private_->threadtask[encoder->private_->next_thread]->mutex_this_task) == FLAC__thrd_success) ? 0 : 1;
-			while(mutex_result || !encoder->private_->threadtask[encoder->private_->next_thread]->task_done) {
-				if(!mutex_result)
-					FLAC__mtx_unlock(&encoder->private_->threadtask[encoder->private_->next_thread]->mutex_this_task);
-
-				FLAC__mtx_lock(&encoder->private_->mutex_work_queue);
-				if(encoder->private_->num_available_threadtasks > (encoder->protected_->num_threads - 1)) {
-					FLAC__StreamEncoderThreadTask * task = NULL;
-					task = encoder->private_->threadtask[encoder->private_->next_threadtask];
-					encoder->private_->num_available_threadtasks--;
-					encoder->private_->next_threadtask++;
-					if(encoder->private_->next_threadtask == encoder->private_->num_threadtasks)
-						encoder->private_->next_threadtask = 1;
-					FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
-					FLAC__mtx_lock(&task->mutex_this_task);
-					process_frame_thread_inner_(encoder, task);
-					mutex_result = (FLAC__mtx_trylock(&encoder->private_->threadtask[encoder->private_->next_thread]->mutex_this_task) == FLAC__thrd_success) ? 0 : 1;
-				}
-				else {
-					FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
-					FLAC__mtx_lock(&encoder->private_->threadtask[encoder->private_->next_thread]->mutex_this_task);
-					while(!encoder->private_->threadtask[encoder->private_->next_thread]->task_done)
-						FLAC__cnd_wait(&encoder->private_->threadtask[encoder->private_->next_thread]->cond_task_done,&encoder->private_->threadtask[encoder->private_->next_thread]->mutex_this_task);
-					mutex_result = 0;
-				}
-			}
-			/* Task is finished, write bitbuffer */
-			if(!encoder->private_->threadtask[encoder->private_->next_thread]->returnvalue) {
-				FLAC__mtx_unlock(&encoder->private_->threadtask[encoder->private_->next_thread]->mutex_this_task);
+			/* The threadtask due first is reused for this block, so wait for it and write its bitbuffer */
+			wait_for_threadtask_(encoder, task);
+			if(!task->returnvalue)
 				return false;
-			}
-			if(!write_bitbuffer_(encoder, encoder->private_->threadtask[encoder->private_->next_thread], encoder->protected_->blocksize, is_last_block)) {
+			if(!write_bitbuffer_(encoder, task, encoder->protected_->blocksize, is_last_block)) {
 				/* the above function sets the state for us in case of an error */
-				FLAC__mtx_unlock(&encoder->private_->threadtask[encoder->private_->next_thread]->mutex_this_task);
 				return false;
 			}
-			FLAC__mtx_unlock(&encoder->private_->threadtask[encoder->private_->next_thread]->mutex_this_task);
 		}
 		/* Copy input data for MD5 calculation */
 		if(encoder->protected_->do_md5) {
-			FLAC__mtx_lock(&encoder->private_->mutex_work_queue);
+			if(FLAC__atomic_load(&encoder->private_->md5_fifo_tail) + encoder->protected_->blocksize > encoder->private_->md5_fifo.size)
+				wake_up_threads_(encoder, true);
+			FLAC__mtx_lock(&encoder->private_->mutex_md5_fifo);
 			while(encoder->private_->md5_fifo.tail + encoder->protected_->blocksize > encoder->private_->md5_fifo.size) {
-				FLAC__cnd_wait(&encoder->private_->cond_md5_emptied,&encoder->private_->mutex_work_queue);
+				FLAC__cnd_wait(&encoder->private_->cond_md5_emptied,&encoder->private_->mutex_md5_fifo);
 			}
-			FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
-			FLAC__mtx_lock(&encoder->private_->mutex_md5_fifo);
 			for(i = 0; i < encoder->protected_->channels; i++)
 				memcpy(encoder->private_->md5_fifo.data[i]+encoder->private_->md5_fifo.tail, encoder->private_->threadtask[0]->integer_signal[i], encoder->protected_->blocksize * sizeof(encoder->private_->threadtask[0]->integer_signal[i][0]));
-			FLAC__mtx_lock(&encoder->private_->mutex_work_queue);
 			encoder->private_->md5_fifo.tail += encoder->protected_->blocksize;
-			FLAC__cnd_signal(&encoder->private_->cond_work_available);
-			FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
+			FLAC__atomic_store(&encoder->private_->md5_fifo_tail, encoder->private_->md5_fifo.tail);
 			FLAC__mtx_unlock(&encoder->private_->mutex_md5_fifo);
 		}
 
 		/* Copy input data for frame creation */
-		FLAC__mtx_lock(&encoder->private_->threadtask[encoder->private_->next_thread]->mutex_this_task);
 		for(i = 0; i < encoder->protected_->channels; i++)
-			memcpy(encoder->private_->threadtask[encoder->private_->next_thread]->integer_signal[i], encoder->private_->threadtask[0]->integer_signal[i], encoder->protected_->blocksize * sizeof(encoder->private_->threadtask[0]->integer_signal[i][0]));
+			memcpy(task->integer_signal[i], encoder->private_->threadtask[0]->integer_signal[i], encoder->protected_->blocksize * sizeof(encoder->private_->threadtask[0]->integer_signal[i][0]));
 
-		encoder->private_->threadtask[encoder->private_->next_thread]->current_frame_number = encoder->private_->current_frame_number;
-		FLAC__mtx_unlock(&encoder->private_->threadtask[encoder->private_->next_thread]->mutex_this_task);
+		task->current_frame_number = encoder->private_->current_frame_number;
+		task->first_sample_number = encoder->private_->streaminfo.data.stream_info.total_samples;
+		FLAC__atomic_store(&task->task_done, 0);
 
-		FLAC__mtx_lock(&encoder->private_->mutex_work_queue);
 		if(encoder->private_->num_started_threadtasks < encoder->private_->num_threadtasks)
 			encoder->private_->num_started_threadtasks++;
-		encoder->private_->num_available_threadtasks++;
-		encoder->private_->threadtask[encoder->private_->next_thread]->task_done = false;
-		FLAC__cnd_signal(&encoder->private_->cond_work_available);
-		FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
+		submit_threadtask_(encoder);
 
 		encoder->private_->next_thread++;
 		if(encoder->private_->next_thread == encoder->private_->num_threadtasks)
@@ -3619,6 +4283,10 @@ FLAC__bool process_frame_(FLAC__StreamEncoder *encoder, FLAC__bool is_last_block
 	encoder->private_->current_sample_number = 0;
 	encoder->private_->current_frame_number++;
 	encoder->private_->streaminfo.data.stream_info.total_samples += (FLAC__uint64)encoder->protected_->blocksize;
+	if(encoder->protected_->estimate_only > 0) {
+		encoder->private_->estimate.total_blocks++;
+		encoder->private_->estimate.total_samples += encoder->protected_->blocksize;
+	}
 
 	return true;
 }
@@ -3626,150 +4294,260 @@ FLAC__bool process_frame_(FLAC__StreamEncoder *encoder, FLAC__bool is_last_block
 #ifdef FLAC__USE_THREADS
 FLAC__thread_return_type process_frame_thread_(void * args) {
 	FLAC__StreamEncoder * encoder = args;
-	uint32_t channel;
-
-	FLAC__mtx_lock(&encoder->private_->mutex_work_queue);
-	encoder->private_->num_running_threads++;
-	FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
+	uint32_t spin = 0;
 
 	while(1) {
+		FLAC__bool finish;
+		if(process_thread_work_(encoder)) {
+			spin = 0;
+			continue;
+		}
+		if(spin < SPIN_LIMIT_) {
+			spin++;
+			FLAC__cpu_relax();
+			continue;
+		}
+		spin = 0;
+		/* No work for a while, so go to sleep. num_parked_threads is
+		 * increased before checking for work once more, so the main
+		 * thread either sees this thread parked or this thread sees the
+		 * work it submitted */
+		FLAC__atomic_fetch_add(&encoder->private_->num_parked_threads, 1);
 		FLAC__mtx_lock(&encoder->private_->mutex_work_queue);
-		if(encoder->private_->finish_work_threads) {
-			FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
+		while(!encoder->private_->finish_work_threads && get_num_queued_threadtasks_(encoder) == 0 &&
+		      (FLAC__atomic_load(&encoder->private_->md5_fifo_tail) == 0 || FLAC__atomic_load(&encoder->private_->md5_active)) &&
+		      (0 == encoder->private_->verify.queue || FLAC__atomic_load(&encoder->private_->verify.num_queued) == 0 || FLAC__atomic_load(&encoder->private_->verify.active)))
+			FLAC__cnd_wait(&encoder->private_->cond_work_available, &encoder->private_->mutex_work_queue);
+		finish = encoder->private_->finish_work_threads;
+		FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
+		FLAC__atomic_fetch_sub(&encoder->private_->num_parked_threads, 1);
+		if(finish)
 			return FLAC__thread_default_return_value;
+	}
+}
+
+/* Does one piece of work, either MD5, verification or a frame, and returns
+ * false if there was nothing to do. Called by the threads of this instance
+ * or of a pool */
+FLAC__bool process_thread_work_(void * args) {
+	FLAC__StreamEncoder * encoder = args;
+	FLAC__StreamEncoderThreadTask * task;
+
+	if(encoder->protected_->do_md5 && FLAC__atomic_load(&encoder->private_->md5_fifo_tail) > 0) {
+		uint32_t md5_active = 0;
+		if(FLAC__atomic_compare_exchange(&encoder->private_->md5_active, &md5_active, 1)) {
+			process_md5_fifo_(encoder);
+			return true;
 		}
-		/* The code below pauses and restarts threads if it is noticed threads are often put too sleep
-		 * because of a lack of work. This reduces overhead when too many threads are active. The
-		 * overcommited indicator is increased when no tasks are available, decreased when more tasks
-		 * are available then threads are running, and reset when a thread is woken up or put to sleep */
-		if(encoder->private_->num_available_threadtasks == 0)
-			encoder->private_->overcommitted_indicator++;
-		else if(encoder->private_->num_available_threadtasks > encoder->private_->num_running_threads)
-			encoder->private_->overcommitted_indicator--;
-		if(encoder->private_->overcommitted_indicator < -20) {
-			encoder->private_->overcommitted_indicator = 0;
-			FLAC__cnd_signal(&encoder->private_->cond_wake_up_thread);
-		}
-		else if(encoder->private_->overcommitted_indicator > 20 && encoder->private_->num_running_threads > 2) {
-			encoder->private_->overcommitted_indicator = 0;
-			encoder->private_->num_running_threads--;
-			FLAC__cnd_wait(&encoder->private_->cond_wake_up_thread, &encoder->private_->mutex_work_queue);
-			encoder->private_->num_running_threads++;
-		}
-		while(encoder->private_->num_available_threadtasks == 0 && (encoder->private_->md5_active || encoder->private_->md5_fifo.tail == 0)) {
-			if(encoder->private_->finish_work_threads) {
-				FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
-				return FLAC__thread_default_return_value;
-			}
-			FLAC__cnd_wait(&encoder->private_->cond_work_available, &encoder->private_->mutex_work_queue);
+	}
+	if(0 != encoder->private_->verify.queue && FLAC__atomic_load(&encoder->private_->verify.num_queued) > 0) {
+		uint32_t verify_active = 0;
+		if(FLAC__atomic_compare_exchange(&encoder->private_->verify.active, &verify_active, 1)) {
+			process_verify_queue_(encoder);
+			return true;
 		}
-		if(encoder->protected_->do_md5 && !encoder->private_->md5_active && encoder->private_->md5_fifo.tail > 0) {
-			uint32_t length = 0;
-			encoder->private_->md5_active = true;
-			while(encoder->private_->md5_fifo.tail > 0) {
-				length = encoder->private_->md5_fifo.tail;
-				FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
-				if(!FLAC__MD5Accumulate(&encoder->private_->md5context, (const FLAC__int32 * const *)encoder->private_->md5_fifo.data, encoder->protected_->channels, length, (encoder->protected_->bits_per_sample+7) / 8)) {
-					encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
-					return FLAC__thread_default_return_value;
-				}
-				FLAC__mtx_lock(&encoder->private_->mutex_md5_fifo);
-				for(channel = 0; channel < encoder->protected_->channels; channel++)
-					memmove(&encoder->private_->md5_fifo.data[channel][0], &encoder->private_->md5_fifo.data[channel][length], (encoder->private_->md5_fifo.tail-length) * sizeof(encoder->private_->md5_fifo.data[0][0]));
-				FLAC__mtx_lock(&encoder->private_->mutex_work_queue);
-				encoder->private_->md5_fifo.tail -= length;
-				FLAC__cnd_signal(&encoder->private_->cond_md5_emptied);
-				FLAC__mtx_unlock(&encoder->private_->mutex_md5_fifo);
-			}
-			encoder->private_->md5_active = false;
-			FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
-		}
-		else if(encoder->private_->num_available_threadtasks > 0) {
-			FLAC__StreamEncoderThreadTask * task = NULL;
-			task = encoder->private_->threadtask[encoder->private_->next_threadtask];
-			encoder->private_->num_available_threadtasks--;
-			encoder->private_->next_threadtask++;
-			if(encoder->private_->next_threadtask == encoder->private_->num_threadtasks)
-				encoder->private_->next_threadtask = 1;
-			FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
+	}
+	if(0 != (task = claim_threadtask_(encoder))) {
+		process_frame_thread_inner_(encoder, task);
+		return true;
+	}
+	return false;
+}
+
+uint32_t get_num_queued_threadtasks_(const FLAC__StreamEncoder *encoder) {
+	const uint32_t submit = FLAC__atomic_load(&encoder->private_->threadtask_submit_position);
+	const uint32_t claim = FLAC__atomic_load(&encoder->private_->threadtask_claim_position);
+	return submit >= claim? submit - claim : submit + (encoder->private_->threadtask_positions - claim);
+}
+
+/* Takes the next submitted threadtask from the ring, or returns NULL if there is none */
+FLAC__StreamEncoderThreadTask *claim_threadtask_(FLAC__StreamEncoder *encoder) {
+	uint32_t claim = FLAC__atomic_load(&encoder->private_->threadtask_claim_position);
+	/* on failure, the compare-and-swap updates claim to the current position */
+	while(claim != FLAC__atomic_load(&encoder->private_->threadtask_submit_position)) {
+		const uint32_t next = claim + 1 == encoder->private_->threadtask_positions? 0 : claim + 1;
+		if(FLAC__atomic_compare_exchange(&encoder->private_->threadtask_claim_position, &claim, next))
+			return encoder->private_->threadtask[claim % (encoder->private_->num_threadtasks - 1) + 1];
+	}
+	return 0;
+}
+
+/* Hands threadtask next_thread to the threads, called by the main thread only */
+void submit_threadtask_(FLAC__StreamEncoder *encoder) {
+	const uint32_t submit = FLAC__atomic_load(&encoder->private_->threadtask_submit_position);
+	FLAC__ASSERT(submit % (encoder->private_->num_threadtasks - 1) + 1 == encoder->private_->next_thread);
+	FLAC__atomic_store(&encoder->private_->threadtask_submit_position, submit + 1 == encoder->private_->threadtask_positions? 0 : submit + 1);
+	encoder->private_->num_unannounced_threadtasks++;
+	wake_up_threads_(encoder, false);
+}
+
+/* Wakes up sleeping threads, but only once a batch of threadtasks has been
+ * submitted since the last time, unless force is set. Threads that are
+ * still spinning pick up work without this */
+void wake_up_threads_(FLAC__StreamEncoder *encoder, FLAC__bool force) {
+	const uint32_t batch = flac_min(flac_max(encoder->protected_->num_threads / 2, 1u), MAX_THREADTASK_BATCH_);
+	if(encoder->private_->num_unannounced_threadtasks == 0 && !force)
+		return;
+	if(encoder->private_->num_unannounced_threadtasks < batch && !force)
+		return;
+	if(0 != encoder->private_->thread_pool) {
+		if(encoder->private_->num_unannounced_threadtasks > 0 || FLAC__atomic_load(&encoder->private_->md5_fifo_tail) > 0 ||
+		   (0 != encoder->private_->verify.queue && FLAC__atomic_load(&encoder->private_->verify.num_queued) > 0))
+			FLAC__thread_pool_notify(encoder->private_->thread_pool);
+	}
+	else if(FLAC__atomic_load(&encoder->private_->num_parked_threads) > 0) {
+		FLAC__mtx_lock(&encoder->private_->mutex_work_queue);
+		if(encoder->private_->num_unannounced_threadtasks > 1)
+			FLAC__cnd_broadcast(&encoder->private_->cond_work_available);
+		else
+			FLAC__cnd_signal(&encoder->private_->cond_work_available);
+		FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
+	}
+	encoder->private_->num_unannounced_threadtasks = 0;
+}
+
+/* Waits until a threadtask is done, meanwhile working on other threadtasks
+ * if there are more queued than the threads can start on */
+void wait_for_threadtask_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderThreadTask *task) {
+	uint32_t spin;
+	while(!FLAC__atomic_load(&task->task_done)) {
+		FLAC__StreamEncoderThreadTask * other = 0;
+		if(get_num_queued_threadtasks_(encoder) > encoder->protected_->num_threads - 1)
+			other = claim_threadtask_(encoder);
+		if(0 != other) {
+			process_frame_thread_inner_(encoder, other);
+			continue;
+		}
+		wake_up_threads_(encoder, true);
+		for(spin = 0; spin < SPIN_LIMIT_ && !FLAC__atomic_load(&task->task_done); spin++)
+			FLAC__cpu_relax();
+		if(!FLAC__atomic_load(&task->task_done)) {
+			/* Same as with num_parked_threads, the thread finishing the
+			 * task either sees task_waited_on or this thread sees task_done */
+			FLAC__atomic_store(&task->task_waited_on, 1);
 			FLAC__mtx_lock(&task->mutex_this_task);
-			if(!process_frame_thread_inner_(encoder, task))
-				return FLAC__thread_default_return_value;
+			while(!FLAC__atomic_load(&task->task_done))
+				FLAC__cnd_wait(&task->cond_task_done, &task->mutex_this_task);
+			FLAC__mtx_unlock(&task->mutex_this_task);
+			FLAC__atomic_store(&task->task_waited_on, 0);
 		}
-		else {
-			FLAC__mtx_unlock(&encoder->private_->mutex_work_queue);
+	}
+}
+
+/* Must be called with md5_active set, which is cleared on return */
+void process_md5_fifo_(FLAC__StreamEncoder *encoder) {
+	uint32_t length = 0, channel;
+	FLAC__bool ok = true;
+	FLAC__mtx_lock(&encoder->private_->mutex_md5_fifo);
+	while(encoder->private_->md5_fifo.tail > 0) {
+		length = encoder->private_->md5_fifo.tail;
+		/* the main thread only appends to the fifo, so the part up to length can be read unlocked */
+		FLAC__mtx_unlock(&encoder->private_->mutex_md5_fifo);
+		if(ok) {
+			FLAC__PROFILE_START(&encoder->private_->md5_fifo_profile, FLAC__STREAM_ENCODER_PROFILE_MD5);
+			ok = FLAC__MD5Accumulate(&encoder->private_->md5context, (const FLAC__int32 * const *)encoder->private_->md5_fifo.data, encoder->protected_->channels, length, (encoder->protected_->bits_per_sample+7) / 8);
+			FLAC__PROFILE_STOP(&encoder->private_->md5_fifo_profile, FLAC__STREAM_ENCODER_PROFILE_MD5);
+			if(!ok)
+				encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
 		}
+		FLAC__mtx_lock(&encoder->private_->mutex_md5_fifo);
+		for(channel = 0; channel < encoder->protected_->channels; channel++)
+			memmove(&encoder->private_->md5_fifo.data[channel][0], &encoder->private_->md5_fifo.data[channel][length], (encoder->private_->md5_fifo.tail-length) * sizeof(encoder->private_->md5_fifo.data[0][0]));
+		encoder->private_->md5_fifo.tail -= length;
+		FLAC__atomic_store(&encoder->private_->md5_fifo_tail, encoder->private_->md5_fifo.tail);
+		FLAC__cnd_signal(&encoder->private_->cond_md5_emptied);
 	}
+	FLAC__atomic_store(&encoder->private_->md5_active, 0);
+	FLAC__cnd_signal(&encoder->private_->cond_md5_emptied);
+	FLAC__mtx_unlock(&encoder->private_->mutex_md5_fifo);
 }
 
 FLAC__bool process_frame_thread_inner_(FLAC__StreamEncoder * encoder, FLAC__StreamEncoderThreadTask * task) {
 	FLAC__bool ok = true;
-	FLAC__uint16 crc;
 
-	/*
-	 * Process the frame header and subframes into the frame bitbuffer
-	 */
-	if(ok && !process_subframes_(encoder, task)) {
-		/* the above function sets the state for us in case of an error */
-		ok = false;
+	if(encoder->protected_->variable_blocksize > 0) {
+		/*
+		 * Process the block into one or more frames in the frame bitbuffer
+		 */
+		if(!process_variable_block_(encoder, task, /*is_last_block=*/false)) {
+			/* the above function sets the state for us in case of an error */
+			ok = false;
+		}
 	}
+	else {
+		/*
+		 * Process the frame header and subframes into the frame bitbuffer
+		 */
+		if(ok && !process_subframes_(encoder, task, 0, encoder->protected_->blocksize, task->frame)) {
+			/* the above function sets the state for us in case of an error */
+			ok = false;
+		}
 
-	/*
-	 * Zero-pad the frame to a byte_boundary
-	 */
-	if(ok && !FLAC__bitwriter_zero_pad_to_byte_boundary(task->frame)) {
-		encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
-		ok = false;
-	}
+		/*
+		 * Zero-pad the frame to a byte_boundary
+		 */
+		if(ok && !FLAC__bitwriter_zero_pad_to_byte_boundary(task->frame)) {
+			encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+			ok = false;
+		}
 
-	/*
-	 * CRC-16 the whole thing
-	 */
-	FLAC__ASSERT(!ok || FLAC__bitwriter_is_byte_aligned(task->frame));
-	if(
-		ok &&
-		(
-			!FLAC__bitwriter_get_write_crc16(task->frame, &crc) ||
-			!FLAC__bitwriter_write_raw_uint32(task->frame, crc, FLAC__FRAME_FOOTER_CRC_LEN)
-		)
-	) {
-		encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
-		ok = false;
+		/*
+		 * CRC-16 the whole thing, unless only the header was written
+		 * because the encoder is only estimating
+		 */
+		FLAC__ASSERT(!ok || FLAC__bitwriter_is_byte_aligned(task->frame));
+		if(ok && encoder->protected_->estimate_only == 0 && !add_frame_footer_(task, task->frame)) {
+			encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+			ok = false;
+		}
 	}
 	task->returnvalue = ok;
-	task->task_done = true;
-	FLAC__cnd_signal(&task->cond_task_done);
-	FLAC__mtx_unlock(&task->mutex_this_task);
+	FLAC__atomic_store(&task->task_done, 1);
+	if(FLAC__atomic_load(&task->task_waited_on)) {
+		FLAC__mtx_lock(&task->mutex_this_task);
+		FLAC__cnd_signal(&task->cond_task_done);
+		FLAC__mtx_unlock(&task->mutex_this_task);
+	}
 	return true;
 }
 #endif
 
-FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderThreadTask * threadtask)
+FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderThreadTask * threadtask, uint32_t offset, uint32_t blocksize, FLAC__BitWriter *frame)
 {
 	FLAC__FrameHeader frame_header;
+	FLAC__int32 *integer_signal[FLAC__MAX_CHANNELS];
 	uint32_t channel, min_partition_order = encoder->protected_->min_residual_partition_order, max_partition_order;
-	FLAC__bool do_independent, do_mid_side, all_subframes_constant = true;
+	FLAC__bool do_independent, do_mid_side, all_subframes_constant = true, ok = true;
 
 	threadtask->disable_constant_subframes = encoder->private_->disable_constant_subframes;
 
+	for(channel = 0; channel < encoder->protected_->channels; channel++)
+		integer_signal[channel] = threadtask->integer_signal[channel] + offset;
+
 	/*
 	 * Calculate the min,max Rice partition orders
 	 */
 
-	max_partition_order = FLAC__format_get_max_rice_partition_order_from_blocksize(encoder->protected_->blocksize);
+	max_partition_order = FLAC__format_get_max_rice_partition_order_from_blocksize(blocksize);
 	max_partition_order = flac_min(max_partition_order, encoder->protected_->max_residual_partition_order);
 	min_partition_order = flac_min(min_partition_order, max_partition_order);
 
 	/*
 	 * Setup the frame
 	 */
-	frame_header.blocksize = encoder->protected_->blocksize;
+	frame_header.blocksize = blocksize;
 	frame_header.sample_rate = encoder->protected_->sample_rate;
 	frame_header.channels = encoder->protected_->channels;
 	frame_header.channel_assignment = FLAC__CHANNEL_ASSIGNMENT_INDEPENDENT; /* the default unless the encoder determines otherwise */
 	frame_header.bits_per_sample = encoder->protected_->bits_per_sample;
-	frame_header.number_type = FLAC__FRAME_NUMBER_TYPE_FRAME_NUMBER;
-	frame_header.number.frame_number = threadtask->current_frame_number;
+	if(encoder->protected_->variable_blocksize > 0) {
+		frame_header.number_type = FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER;
+		frame_header.number.sample_number = threadtask->first_sample_number + offset;
+	}
+	else {
+		frame_header.number_type = FLAC__FRAME_NUMBER_TYPE_FRAME_NUMBER;
+		frame_header.number.frame_number = threadtask->current_frame_number;
+	}
 
 	/*
 	 * Figure out what channel assignments to try
@@ -3779,17 +4557,17 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderT
 			uint64_t sumAbsLR = 0, sumAbsMS = 0;
 			uint32_t i;
 			if(encoder->protected_->bits_per_sample < 25) {
-				for(i = 1; i < encoder->protected_->blocksize; i++) {
-					int32_t predictionLeft = threadtask->integer_signal[0][i] - threadtask->integer_signal[0][i-1];
-					int32_t predictionRight = threadtask->integer_signal[1][i] - threadtask->integer_signal[1][i-1];
+				for(i = 1; i < blocksize; i++) {
+					int32_t predictionLeft = integer_signal[0][i] - integer_signal[0][i-1];
+					int32_t predictionRight = integer_signal[1][i] - integer_signal[1][i-1];
 					sumAbsLR += abs(predictionLeft) + abs(predictionRight);
 					sumAbsMS += abs((predictionLeft + predictionRight) >> 1) + abs(predictionLeft - predictionRight);
 				}
 			}
 			else { /* bps 25 or higher */
-				for(i = 1; i < encoder->protected_->blocksize; i++) {
-					int64_t predictionLeft = (int64_t)threadtask->integer_signal[0][i] - (int64_t)threadtask->integer_signal[0][i-1];
-					int64_t predictionRight = (int64_t)threadtask->integer_signal[1][i] - (int64_t)threadtask->integer_signal[1][i-1];
+				for(i = 1; i < blocksize; i++) {
+					int64_t predictionLeft = (int64_t)integer_signal[0][i] - (int64_t)integer_signal[0][i-1];
+					int64_t predictionRight = (int64_t)integer_signal[1][i] - (int64_t)integer_signal[1][i-1];
 					sumAbsLR += local_abs64(predictionLeft) + local_abs64(predictionRight);
 					sumAbsMS += local_abs64((predictionLeft + predictionRight) >> 1) + local_abs64(predictionLeft - predictionRight);
 				}
@@ -3824,14 +4602,14 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderT
 		uint32_t i;
 		FLAC__ASSERT(encoder->protected_->channels == 2);
 		if(encoder->protected_->bits_per_sample < 32)
-			for(i = 0; i < encoder->protected_->blocksize; i++) {
-				threadtask->integer_signal_mid_side[1][i] = threadtask->integer_signal[0][i] - threadtask->integer_signal[1][i];
-				threadtask->integer_signal_mid_side[0][i] = (threadtask->integer_signal[0][i] + threadtask->integer_signal[1][i]) >> 1; /* NOTE: not the same as 'mid = (signal[0][j] + signal[1][j]) / 2' ! */
+			for(i = 0; i < blocksize; i++) {
+				threadtask->integer_signal_mid_side[1][i] = integer_signal[0][i] - integer_signal[1][i];
+				threadtask->integer_signal_mid_side[0][i] = (integer_signal[0][i] + integer_signal[1][i]) >> 1; /* NOTE: not the same as 'mid = (signal[0][j] + signal[1][j]) / 2' ! */
 			}
 		else
-			for(i = 0; i <= encoder->protected_->blocksize; i++) {
-				threadtask->integer_signal_33bit_side[i] = (FLAC__int64)threadtask->integer_signal[0][i] - (FLAC__int64)threadtask->integer_signal[1][i];
-				threadtask->integer_signal_mid_side[0][i] = ((FLAC__int64)threadtask->integer_signal[0][i] + (FLAC__int64)threadtask->integer_signal[1][i]) >> 1; /* NOTE: not the same as 'mid = (signal[0][j] + signal[1][j]) / 2' ! */
+			for(i = 0; i <= blocksize; i++) {
+				threadtask->integer_signal_33bit_side[i] = (FLAC__int64)integer_signal[0][i] - (FLAC__int64)integer_signal[1][i];
+				threadtask->integer_signal_mid_side[0][i] = ((FLAC__int64)integer_signal[0][i] + (FLAC__int64)integer_signal[1][i]) >> 1; /* NOTE: not the same as 'mid = (signal[0][j] + signal[1][j]) / 2' ! */
 			}
 	}
 
@@ -3841,7 +4619,7 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderT
 	 */
 	if(do_independent) {
 		for(channel = 0; channel < encoder->protected_->channels; channel++) {
-			uint32_t w = get_wasted_bits_(threadtask->integer_signal[channel], encoder->protected_->blocksize);
+			uint32_t w = get_wasted_bits_(integer_signal[channel], blocksize);
 			if (w > encoder->protected_->bits_per_sample) {
 				w = encoder->protected_->bits_per_sample;
 			}
@@ -3854,9 +4632,9 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderT
 		for(channel = 0; channel < 2; channel++) {
 			uint32_t w;
 			if(encoder->protected_->bits_per_sample < 32 || channel == 0)
-				w = get_wasted_bits_(threadtask->integer_signal_mid_side[channel], encoder->protected_->blocksize);
+				w = get_wasted_bits_(threadtask->integer_signal_mid_side[channel], blocksize);
 			else
-				w = get_wasted_bits_wide_(threadtask->integer_signal_33bit_side, threadtask->integer_signal_mid_side[channel], encoder->protected_->blocksize);
+				w = get_wasted_bits_wide_(threadtask->integer_signal_33bit_side, threadtask->integer_signal_mid_side[channel], blocksize);
 
 			if (w > encoder->protected_->bits_per_sample) {
 				w = encoder->protected_->bits_per_sample;
@@ -3885,7 +4663,7 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderT
 					max_partition_order,
 					&frame_header,
 					threadtask->subframe_bps[channel],
-					threadtask->integer_signal[channel],
+					integer_signal[channel],
 					threadtask->subframe_workspace_ptr[channel],
 					threadtask->partitioned_rice_contents_workspace_ptr[channel],
 					threadtask->residual_workspace[channel],
@@ -3936,6 +4714,7 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderT
 	 */
 	if((do_independent && do_mid_side) || encoder->protected_->loose_mid_side_stereo) {
 		uint32_t left_bps = 0, right_bps = 0; /* initialized only to prevent superfluous compiler warning */
+		uint32_t left_bits = 0, right_bits = 0; /* initialized only to prevent superfluous compiler warning */
 		FLAC__Subframe *left_subframe = 0, *right_subframe = 0; /* initialized only to prevent superfluous compiler warning */
 		FLAC__ChannelAssignment channel_assignment;
 
@@ -3971,7 +4750,7 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderT
 			frame_header.channel_assignment = channel_assignment;
 		}
 
-		if(!FLAC__frame_add_header(&frame_header, threadtask->frame)) {
+		if(!FLAC__frame_add_header(&frame_header, frame)) {
 			encoder->protected_->state = FLAC__STREAM_ENCODER_FRAMING_ERROR;
 			return false;
 		}
@@ -3980,18 +4759,26 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderT
 			case FLAC__CHANNEL_ASSIGNMENT_INDEPENDENT:
 				left_subframe  = &threadtask->subframe_workspace         [0][threadtask->best_subframe         [0]];
 				right_subframe = &threadtask->subframe_workspace         [1][threadtask->best_subframe         [1]];
+				left_bits      = threadtask->best_subframe_bits         [0];
+				right_bits     = threadtask->best_subframe_bits         [1];
 				break;
 			case FLAC__CHANNEL_ASSIGNMENT_LEFT_SIDE:
 				left_subframe  = &threadtask->subframe_workspace         [0][threadtask->best_subframe         [0]];
 				right_subframe = &threadtask->subframe_workspace_mid_side[1][threadtask->best_subframe_mid_side[1]];
+				left_bits      = threadtask->best_subframe_bits         [0];
+				right_bits     = threadtask->best_subframe_bits_mid_side[1];
 				break;
 			case FLAC__CHANNEL_ASSIGNMENT_RIGHT_SIDE:
 				left_subframe  = &threadtask->subframe_workspace_mid_side[1][threadtask->best_subframe_mid_side[1]];
 				right_subframe = &threadtask->subframe_workspace         [1][threadtask->best_subframe         [1]];
+				left_bits      = threadtask->best_subframe_bits_mid_side[1];
+				right_bits     = threadtask->best_subframe_bits         [1];
 				break;
 			case FLAC__CHANNEL_ASSIGNMENT_MID_SIDE:
 				left_subframe  = &threadtask->subframe_workspace_mid_side[0][threadtask->best_subframe_mid_side[0]];
 				right_subframe = &threadtask->subframe_workspace_mid_side[1][threadtask->best_subframe_mid_side[1]];
+				left_bits      = threadtask->best_subframe_bits_mid_side[0];
+				right_bits     = threadtask->best_subframe_bits_mid_side[1];
 				break;
 			default:
 				FLAC__ASSERT(0);
@@ -4018,30 +4805,156 @@ FLAC__bool process_subframes_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderT
 				FLAC__ASSERT(0);
 		}
 
+		/* When only estimating, the subframes are not written, the frame
+		 * only holds the header */
+		if(encoder->protected_->estimate_only > 0 && encoder->protected_->variable_blocksize == 0) {
+			threadtask->estimated_bits =
+				count_subframe_bits_(left_subframe, frame_header.blocksize, left_bps, left_bits) +
+				count_subframe_bits_(right_subframe, frame_header.blocksize, right_bps, right_bits);
+			return true;
+		}
+
 		/* note that encoder_add_subframe_ sets the state for us in case of an error */
-		if(!add_subframe_(encoder, frame_header.blocksize, left_bps , left_subframe , threadtask->frame))
-			return false;
-		if(!add_subframe_(encoder, frame_header.blocksize, right_bps, right_subframe, threadtask->frame))
+		FLAC__PROFILE_START(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_BITWRITING);
+		ok =
+			add_subframe_(encoder, frame_header.blocksize, left_bps , left_subframe , frame) &&
+			add_subframe_(encoder, frame_header.blocksize, right_bps, right_subframe, frame);
+		FLAC__PROFILE_STOP(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_BITWRITING);
+		if(!ok)
 			return false;
 	}
 	else {
 		FLAC__ASSERT(do_independent);
-		if(!FLAC__frame_add_header(&frame_header, threadtask->frame)) {
+		if(!FLAC__frame_add_header(&frame_header, frame)) {
 			encoder->protected_->state = FLAC__STREAM_ENCODER_FRAMING_ERROR;
 			return false;
 		}
 
+		if(encoder->protected_->estimate_only > 0 && encoder->protected_->variable_blocksize == 0) {
+			threadtask->estimated_bits = 0;
+			for(channel = 0; channel < encoder->protected_->channels; channel++)
+				threadtask->estimated_bits += count_subframe_bits_(&threadtask->subframe_workspace[channel][threadtask->best_subframe[channel]], frame_header.blocksize, threadtask->subframe_bps[channel], threadtask->best_subframe_bits[channel]);
+			return true;
+		}
+
+		FLAC__PROFILE_START(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_BITWRITING);
+		for(channel = 0; ok && channel < encoder->protected_->channels; channel++)
+			ok = add_subframe_(encoder, frame_header.blocksize, threadtask->subframe_bps[channel], &threadtask->subframe_workspace[channel][threadtask->best_subframe[channel]], frame);
+		FLAC__PROFILE_STOP(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_BITWRITING);
+		if(!ok) {
+			/* the above function sets the state for us in case of an error */
+			return false;
+		}
+	}
+
+	/* The wasted bits were shifted out of the signal in place; when the
+	 * block is encoded again in parts, they must be shifted back first */
+	if(encoder->protected_->variable_blocksize > 0 && do_independent) {
 		for(channel = 0; channel < encoder->protected_->channels; channel++) {
-			if(!add_subframe_(encoder, frame_header.blocksize, threadtask->subframe_bps[channel], &threadtask->subframe_workspace[channel][threadtask->best_subframe[channel]], threadtask->frame)) {
-				/* the above function sets the state for us in case of an error */
-				return false;
-			}
+			const uint32_t w = threadtask->subframe_workspace[channel][0].wasted_bits;
+			uint32_t i;
+			if(w > 0)
+				for(i = 0; i < blocksize; i++)
+					integer_signal[channel][i] = (FLAC__int32)((FLAC__uint32)integer_signal[channel][i] << w);
 		}
 	}
 
 	return true;
 }
 
+/* CRC-16s the byte-aligned frame and appends the result */
+FLAC__bool add_frame_footer_(FLAC__StreamEncoderThreadTask *threadtask, FLAC__BitWriter *frame)
+{
+	FLAC__uint16 crc;
+	FLAC__bool ok;
+	(void)threadtask;
+	FLAC__PROFILE_START(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_CRC);
+	ok = FLAC__bitwriter_get_write_crc16(frame, &crc) && FLAC__bitwriter_write_raw_uint32(frame, crc, FLAC__FRAME_FOOTER_CRC_LEN);
+	FLAC__PROFILE_STOP(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_CRC);
+	return ok;
+}
+
+/* Returns how many times a block of the given size can be halved. Halves
+ * must be larger than FLAC__MAX_LPC_ORDER, as not all intrinsics
+ * autocorrelation routines handle a lag larger than the data length */
+uint32_t get_blocksize_splits_(const FLAC__StreamEncoder *encoder, uint32_t blocksize)
+{
+	uint32_t splits = 0;
+
+	while(splits < encoder->protected_->variable_blocksize && blocksize % 2 == 0 && blocksize / 2 > FLAC__MAX_LPC_ORDER) {
+		blocksize /= 2;
+		splits++;
+	}
+	return splits;
+}
+
+FLAC__bool process_variable_block_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderThreadTask *threadtask, FLAC__bool is_last_block)
+{
+	/* The last block is never split: the STREAMINFO minimum blocksize
+	 * only excludes the last frame */
+	const uint32_t max_depth = is_last_block? 0 : get_blocksize_splits_(encoder, encoder->protected_->blocksize);
+
+	threadtask->num_frames = 0;
+	return process_split_(encoder, threadtask, 0, encoder->protected_->blocksize, 0, max_depth, threadtask->frame);
+}
+
+/* Encodes blocksize samples starting at offset into the block both as a
+ * single frame and, if max_depth has not been reached, as two halves which
+ * are recursively processed the same way. Whichever results in fewer bytes
+ * is appended to frames and recorded in threadtask->frame_blocksize[] and
+ * threadtask->frame_bytes[] */
+FLAC__bool process_split_(FLAC__StreamEncoder *encoder, FLAC__StreamEncoderThreadTask *threadtask, uint32_t offset, uint32_t blocksize, uint32_t depth, uint32_t max_depth, FLAC__BitWriter *frames)
+{
+	FLAC__BitWriter *whole = threadtask->split_frame[depth], *append = whole;
+	const uint32_t first_frame = threadtask->num_frames;
+	const FLAC__byte *buffer;
+	size_t bytes;
+
+	FLAC__bitwriter_clear(whole);
+	threadtask->split_depth = depth;
+	if(!process_subframes_(encoder, threadtask, offset, blocksize, whole)) {
+		/* the above function sets the state for us in case of an error */
+		return false;
+	}
+	if(!FLAC__bitwriter_zero_pad_to_byte_boundary(whole) || !add_frame_footer_(threadtask, whole)) {
+		encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
+
+	if(depth < max_depth) {
+		FLAC__BitWriter *halves = threadtask->split_halves[depth];
+		FLAC__bitwriter_clear(halves);
+		if(
+			!process_split_(encoder, threadtask, offset, blocksize / 2, depth + 1, max_depth, halves) ||
+			!process_split_(encoder, threadtask, offset + blocksize / 2, blocksize / 2, depth + 1, max_depth, halves)
+		)
+			return false;
+		if(FLAC__bitwriter_get_input_bits_unconsumed(halves) < FLAC__bitwriter_get_input_bits_unconsumed(whole))
+			append = halves;
+		else
+			threadtask->num_frames = first_frame; /* forget the frames of the halves */
+	}
+
+	if(append == whole) {
+		FLAC__ASSERT(threadtask->num_frames < (1u << FLAC__STREAM_ENCODER_MAX_BLOCKSIZE_SPLITS));
+		threadtask->frame_blocksize[threadtask->num_frames] = blocksize;
+		threadtask->frame_bytes[threadtask->num_frames] = FLAC__bitwriter_get_input_bits_unconsumed(whole) / 8;
+		threadtask->num_frames++;
+	}
+
+	if(!FLAC__bitwriter_get_buffer(append, &buffer, &bytes)) {
+		encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
+	if(!FLAC__bitwriter_write_byte_block(frames, buffer, (uint32_t)bytes)) {
+		FLAC__bitwriter_release_buffer(append);
+		encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
+	FLAC__bitwriter_release_buffer(append);
+	return true;
+}
+
 FLAC__bool process_subframe_(
 	FLAC__StreamEncoder *encoder,
 	FLAC__StreamEncoderThreadTask *threadtask,
@@ -4206,6 +5119,12 @@ FLAC__bool process_subframe_(
 					apply_apodization_state.a = 0;
 					apply_apodization_state.b = 1;
 					apply_apodization_state.c = 0;
+					if(encoder->private_->use_autoc_cache) {
+						/* the cached autocorrelation is that of the previous signal */
+						uint32_t g;
+						for(g = 0; g < frame_header->blocksize / FLAC__STREAM_ENCODER_AUTOC_GRANULE; g++)
+							threadtask->autoc_granules[g].autoc_lag = threadtask->autoc_granules[g].cross_lag = 0;
+					}
 					while (apply_apodization_state.a < encoder->protected_->num_apodizations) {
 						uint32_t max_lpc_order_this_apodization = max_lpc_order;
 
@@ -4315,6 +5234,121 @@ static inline void set_next_subdivide_tukey(FLAC__int32 parts, uint32_t * apodiz
 	}
 }
 
+void set_window_range_(const FLAC__real window[], uint32_t blocksize, window_range_struct *range)
+{
+	uint32_t i, run_start = 0;
+
+	range->nonzero_start = 0;
+	range->nonzero_end = blocksize;
+	while(range->nonzero_start < blocksize && window[range->nonzero_start] == 0.0f)
+		range->nonzero_start++;
+	while(range->nonzero_end > range->nonzero_start && window[range->nonzero_end-1] == 0.0f)
+		range->nonzero_end--;
+
+	range->flat_start = range->flat_end = 0;
+	for(i = 0; i <= blocksize; i++) {
+		if(i == blocksize || window[i] != 1.0f) {
+			if(i - run_start > range->flat_end - range->flat_start) {
+				range->flat_start = run_start;
+				range->flat_end = i;
+			}
+			run_start = i + 1;
+		}
+	}
+}
+
+static inline void add_autocorrelation_across_(const FLAC__real *boundary, uint32_t lag, double autoc[])
+{
+	/* adds the lag products of which one sample is before boundary and one is not */
+	uint32_t i, j;
+	for(j = 1; j < lag; j++)
+		for(i = 0; i < j; i++)
+			autoc[j] += (double)boundary[i] * (double)(boundary - j)[i];
+}
+
+void compute_autocorrelation_(
+	FLAC__StreamEncoder *encoder,
+	FLAC__StreamEncoderThreadTask *threadtask,
+	const FLAC__real data[],
+	uint32_t data_len,
+	uint32_t offset,
+	uint32_t flat_start,
+	uint32_t flat_end,
+	uint32_t lag,
+	double autoc[]
+)
+{
+	/* data[] holds the windowed signal from sample offset of the block on,
+	 * and the window is 1.0 from sample flat_start up to flat_end. The
+	 * autocorrelation is split up in the part before the first and after
+	 * the last granule in that range, which is computed as usual, the
+	 * granules themselves and the lag products across the boundaries
+	 * in between. As the windowed signal equals the unwindowed signal
+	 * within the granules, their part is the same for all windows that
+	 * are flat there, and is only computed once per signal */
+	const uint32_t granule_size = FLAC__STREAM_ENCODER_AUTOC_GRANULE;
+	double autoc_part[FLAC__MAX_LPC_ORDER+1];
+	uint32_t first, last, start, end, g, j;
+
+	FLAC__ASSERT(lag <= FLAC__MAX_LPC_ORDER+1);
+	FLAC__ASSERT(flat_end <= flat_start || (flat_start >= offset && flat_end <= offset + data_len));
+
+	if(!encoder->private_->use_autoc_cache || flat_end <= flat_start) {
+		encoder->private_->local_lpc_compute_autocorrelation(data, data_len, lag, autoc);
+		return;
+	}
+
+	first = (flat_start + granule_size - 1) / granule_size;
+	last = flat_end / granule_size;
+	/* the parts before and after the granules must either be empty or
+	 * longer than the lag, see the comment in apply_apodization_() */
+	while(first < last && first * granule_size > offset && first * granule_size - offset <= FLAC__MAX_LPC_ORDER)
+		first++;
+	while(first < last && offset + data_len > last * granule_size && offset + data_len - last * granule_size <= FLAC__MAX_LPC_ORDER)
+		last--;
+	if(first >= last) {
+		encoder->private_->local_lpc_compute_autocorrelation(data, data_len, lag, autoc);
+		return;
+	}
+	start = first * granule_size - offset;
+	end = last * granule_size - offset;
+
+	for(j = 0; j < lag; j++)
+		autoc[j] = 0.0;
+	if(start > 0) {
+		encoder->private_->local_lpc_compute_autocorrelation(data, start, lag, autoc_part);
+		for(j = 0; j < lag; j++)
+			autoc[j] += autoc_part[j];
+		add_autocorrelation_across_(data + start, lag, autoc);
+	}
+	if(end < data_len) {
+		encoder->private_->local_lpc_compute_autocorrelation(data + end, data_len - end, lag, autoc_part);
+		for(j = 0; j < lag; j++)
+			autoc[j] += autoc_part[j];
+		add_autocorrelation_across_(data + end, lag, autoc);
+	}
+	for(g = first; g < last; g++) {
+		autoc_granule_struct *granule = &threadtask->autoc_granules[g];
+		const FLAC__real *granule_data = data + g * granule_size - offset;
+		if(granule->autoc_lag < lag) {
+			encoder->private_->local_lpc_compute_autocorrelation(granule_data, granule_size, lag, granule->autoc);
+			granule->autoc_lag = lag;
+		}
+		for(j = 0; j < lag; j++)
+			autoc[j] += granule->autoc[j];
+		if(g > first) {
+			if(granule->cross_lag < lag) {
+				for(j = 0; j < lag; j++)
+					granule->cross[j] = 0.0;
+				add_autocorrelation_across_(granule_data, lag, granule->cross);
+				granule->cross_lag = lag;
+			}
+			for(j = 0; j < lag; j++)
+				autoc[j] += granule->cross[j];
+		}
+	}
+}
+
 FLAC__bool apply_apodization_(FLAC__StreamEncoder *encoder,
                         FLAC__StreamEncoderThreadTask *threadtask,
                         apply_apodization_state_struct *apply_apodization_state,
@@ -4325,15 +5359,30 @@ FLAC__bool apply_apodization_(FLAC__StreamEncoder *encoder,
                         const void *integer_signal,
                         uint32_t *guess_lpc_order)
 {
+	/* halved blocks of variable-blocksize streams have windows of their own */
+	FLAC__real * const *window = threadtask->split_depth > 0? encoder->private_->window_split[threadtask->split_depth-1] : encoder->private_->window;
+	const window_range_struct *range = &encoder->private_->window_range[threadtask->split_depth][apply_apodization_state->a];
+
 	apply_apodization_state->current_apodization = &encoder->protected_->apodizations[apply_apodization_state->a];
 
 	if(apply_apodization_state->b == 1) {
 		/* window full subblock */
+		uint32_t offset = 0, len = blocksize;
+		/* windows that are zero over a good part of the block, like those
+		 * of partial_tukey, only need to be applied to the rest of it */
+		if(range->nonzero_end - range->nonzero_start <= blocksize - blocksize / 8 && range->nonzero_end - range->nonzero_start > FLAC__MAX_LPC_ORDER) {
+			offset = range->nonzero_start;
+			len = range->nonzero_end - range->nonzero_start;
+		}
+		FLAC__PROFILE_START(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_WINDOW);
 		if(subframe_bps <= 32)
-			FLAC__lpc_window_data(integer_signal, encoder->private_->window[apply_apodization_state->a], threadtask->windowed_signal, blocksize);
+			FLAC__lpc_window_data((const FLAC__int32 *)integer_signal + offset, window[apply_apodization_state->a] + offset, threadtask->windowed_signal, len);
 		else
-			FLAC__lpc_window_data_wide(integer_signal, encoder->private_->window[apply_apodization_state->a], threadtask->windowed_signal, blocksize);
-		encoder->private_->local_lpc_compute_autocorrelation(threadtask->windowed_signal, blocksize, (*max_lpc_order_this_apodization)+1, apply_apodization_state->autoc);
+			FLAC__lpc_window_data_wide((const FLAC__int64 *)integer_signal + offset, window[apply_apodization_state->a] + offset, threadtask->windowed_signal, len);
+		FLAC__PROFILE_STOP(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_WINDOW);
+		FLAC__PROFILE_START(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_AUTOCORRELATION);
+		compute_autocorrelation_(encoder, threadtask, threadtask->windowed_signal, len, offset, range->flat_start, range->flat_end, (*max_lpc_order_this_apodization)+1, apply_apodization_state->autoc);
+		FLAC__PROFILE_STOP(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_AUTOCORRELATION);
 		if(apply_apodization_state->current_apodization->type == FLAC__APODIZATION_SUBDIVIDE_TUKEY){
 			uint32_t i;
 			for(i = 0; i < *max_lpc_order_this_apodization; i++)
@@ -4357,11 +5406,25 @@ FLAC__bool apply_apodization_(FLAC__StreamEncoder *encoder,
 		}
 		if(!(apply_apodization_state->c % 2)) {
 			/* on even c, evaluate the (c/2)th partial window of size blocksize/b  */
+			const uint32_t part_size = blocksize/apply_apodization_state->b/2;
+			const uint32_t data_shift = (apply_apodization_state->c/2*blocksize)/apply_apodization_state->b;
+			uint32_t flat_start = 0, flat_end = 0;
+			FLAC__PROFILE_START(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_WINDOW);
 			if(subframe_bps <= 32)
-				FLAC__lpc_window_data_partial(integer_signal, encoder->private_->window[apply_apodization_state->a], threadtask->windowed_signal, blocksize, blocksize/apply_apodization_state->b/2, (apply_apodization_state->c/2*blocksize)/apply_apodization_state->b);
+				FLAC__lpc_window_data_partial(integer_signal, window[apply_apodization_state->a], threadtask->windowed_signal, blocksize, part_size, data_shift);
 			else
-				FLAC__lpc_window_data_partial_wide(integer_signal, encoder->private_->window[apply_apodization_state->a], threadtask->windowed_signal, blocksize, blocksize/apply_apodization_state->b/2, (apply_apodization_state->c/2*blocksize)/apply_apodization_state->b);
-			encoder->private_->local_lpc_compute_autocorrelation(threadtask->windowed_signal, blocksize/apply_apodization_state->b, (*max_lpc_order_this_apodization)+1, apply_apodization_state->autoc);
+				FLAC__lpc_window_data_partial_wide(integer_signal, window[apply_apodization_state->a], threadtask->windowed_signal, blocksize, part_size, data_shift);
+			FLAC__PROFILE_STOP(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_WINDOW);
+			/* the partial window consists of the first and last part_size
+			 * samples of the root window, so it is flat in between if the
+			 * root window is flat over both of those */
+			if(range->flat_end > range->flat_start && range->flat_start <= part_size && range->flat_end >= blocksize - part_size && data_shift + 2 * part_size <= blocksize) {
+				flat_start = data_shift + range->flat_start;
+				flat_end = data_shift + 2 * part_size - (blocksize - range->flat_end);
+			}
+			FLAC__PROFILE_START(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_AUTOCORRELATION);
+			compute_autocorrelation_(encoder, threadtask, threadtask->windowed_signal, blocksize/apply_apodization_state->b, data_shift, flat_start, flat_end, (*max_lpc_order_this_apodization)+1, apply_apodization_state->autoc);
+			FLAC__PROFILE_STOP(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_AUTOCORRELATION);
 		}
 		else {
 			/* on uneven c, evaluate the root window (over the whole block) minus the previous partial window
@@ -4376,7 +5439,9 @@ FLAC__bool apply_apodization_(FLAC__StreamEncoder *encoder,
 
 	if(apply_apodization_state->autoc[0] == 0.0) /* Signal seems to be constant, so we can't do lp. Constant detection is probably disabled */
 		return false;
+	FLAC__PROFILE_START(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_LPC_SOLVE);
 	FLAC__lpc_compute_lp_coefficients(apply_apodization_state->autoc, max_lpc_order_this_apodization, threadtask->lp_coeff, lpc_error);
+	FLAC__PROFILE_STOP(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_LPC_SOLVE);
 	*guess_lpc_order =
 	FLAC__lpc_compute_best_order(
 		lpc_error,
@@ -4408,13 +5473,13 @@ FLAC__bool add_subframe_(
 			}
 			break;
 		case FLAC__SUBFRAME_TYPE_FIXED:
-			if(!FLAC__subframe_add_fixed(&(subframe->data.fixed), blocksize - subframe->data.fixed.order, subframe_bps, subframe->wasted_bits, frame)) {
+			if(!FLAC__subframe_add_fixed(&(subframe->data.fixed), blocksize - subframe->data.fixed.order, subframe_bps, subframe->wasted_bits, frame, encoder->private_->local_bitwriter_write_rice_signed_block)) {
 				encoder->protected_->state = FLAC__STREAM_ENCODER_FRAMING_ERROR;
 				return false;
 			}
 			break;
 		case FLAC__SUBFRAME_TYPE_LPC:
-			if(!FLAC__subframe_add_lpc(&(subframe->data.lpc), blocksize - subframe->data.lpc.order, subframe_bps, subframe->wasted_bits, frame)) {
+			if(!FLAC__subframe_add_lpc(&(subframe->data.lpc), blocksize - subframe->data.lpc.order, subframe_bps, subframe->wasted_bits, frame, encoder->private_->local_bitwriter_write_rice_signed_block)) {
 				encoder->protected_->state = FLAC__STREAM_ENCODER_FRAMING_ERROR;
 				return false;
 			}
@@ -4508,12 +5573,14 @@ uint32_t evaluate_fixed_subframe_(
 	uint32_t i, residual_bits, estimate;
 	const uint32_t residual_samples = blocksize - order;
 
+	FLAC__PROFILE_START(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_RESIDUAL);
 	if((subframe_bps + order) <= 32)
 		FLAC__fixed_compute_residual(((FLAC__int32 *)signal)+order, residual_samples, order, residual);
 	else if(subframe_bps <= 32)
 		FLAC__fixed_compute_residual_wide(((FLAC__int32 *)signal)+order, residual_samples, order, residual);
 	else
 		FLAC__fixed_compute_residual_wide_33bit(((FLAC__int64 *)signal)+order, residual_samples, order, residual);
+	FLAC__PROFILE_STOP(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_RESIDUAL);
 
 	subframe->type = FLAC__SUBFRAME_TYPE_FIXED;
 
@@ -4585,6 +5652,7 @@ uint32_t evaluate_lpc_subframe_(
 	FLAC__int32 qlp_coeff[FLAC__MAX_LPC_ORDER]; /* WATCHOUT: the size is important; some x86 intrinsic routines need more than lpc order elements */
 	uint32_t i, residual_bits, estimate;
 	int quantization, ret;
+	FLAC__bool ok = true;
 	const uint32_t residual_samples = blocksize - order;
 
 	/* try to keep qlp coeff precision such that only 32-bit math is required for decode of <=16bps(+1bps for side channel) streams */
@@ -4594,18 +5662,18 @@ uint32_t evaluate_lpc_subframe_(
 		qlp_coeff_precision = flac_min(qlp_coeff_precision, 32 - subframe_bps - FLAC__bitmath_ilog2(order));
 	}
 
+	FLAC__PROFILE_START(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_QUANTIZATION);
 	ret = FLAC__lpc_quantize_coefficients(lp_coeff, order, qlp_coeff_precision, qlp_coeff, &quantization);
+	FLAC__PROFILE_STOP(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_QUANTIZATION);
 	if(ret != 0)
 		return 0; /* this is a hack to indicate to the caller that we can't do lp at this order on this subframe */
 
+	FLAC__PROFILE_START(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_RESIDUAL);
 	if(FLAC__lpc_max_residual_bps(subframe_bps, qlp_coeff, order, quantization) > 32) {
-		if(subframe_bps <= 32){
-			if(!FLAC__lpc_compute_residual_from_qlp_coefficients_limit_residual(((FLAC__int32 *)signal)+order, residual_samples, qlp_coeff, order, quantization, residual))
-				return 0;
-		}
+		if(subframe_bps <= 32)
+			ok = FLAC__lpc_compute_residual_from_qlp_coefficients_limit_residual(((FLAC__int32 *)signal)+order, residual_samples, qlp_coeff, order, quantization, residual);
 		else
-			if(!FLAC__lpc_compute_residual_from_qlp_coefficients_limit_residual_33bit(((FLAC__int64 *)signal)+order, residual_samples, qlp_coeff, order, quantization, residual))
-				return 0;
+			ok = FLAC__lpc_compute_residual_from_qlp_coefficients_limit_residual_33bit(((FLAC__int64 *)signal)+order, residual_samples, qlp_coeff, order, quantization, residual);
 	}
 	else
 		if(FLAC__lpc_max_prediction_before_shift_bps(subframe_bps, qlp_coeff, order) <= 32)
@@ -4615,6 +5683,9 @@ uint32_t evaluate_lpc_subframe_(
 				encoder->private_->local_lpc_compute_residual_from_qlp_coefficients(((FLAC__int32 *)signal)+order, residual_samples, qlp_coeff, order, quantization, residual);
 		else
 			encoder->private_->local_lpc_compute_residual_from_qlp_coefficients_64bit(((FLAC__int32 *)signal)+order, residual_samples, qlp_coeff, order, quantization, residual);
+	FLAC__PROFILE_STOP(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_RESIDUAL);
+	if(!ok)
+		return 0;
 
 	subframe->type = FLAC__SUBFRAME_TYPE_LPC;
 
@@ -4698,6 +5769,63 @@ uint32_t evaluate_verbatim_subframe_(
 	return estimate;
 }
 
+/* Returns the number of bits add_subframe_() writes for a subframe, given
+ * the estimate returned when the subframe was evaluated. The estimates for
+ * fixed and LPC subframes approximate the size of the Rice-coded residual,
+ * so that part is counted exactly here */
+uint32_t count_subframe_bits_(
+	const FLAC__Subframe *subframe,
+	uint32_t blocksize,
+	uint32_t subframe_bps,
+	uint32_t estimate
+)
+{
+	const FLAC__EntropyCodingMethod *method;
+	const FLAC__int32 *residual;
+	uint32_t order, partition, partitions, partition_samples, plen, i;
+	FLAC__uint64 bits;
+
+	switch(subframe->type) {
+		case FLAC__SUBFRAME_TYPE_FIXED:
+			method = &subframe->data.fixed.entropy_coding_method;
+			residual = subframe->data.fixed.residual;
+			order = subframe->data.fixed.order;
+			bits = FLAC__SUBFRAME_ZERO_PAD_LEN + FLAC__SUBFRAME_TYPE_LEN + FLAC__SUBFRAME_WASTED_BITS_FLAG_LEN + subframe->wasted_bits + (order * subframe_bps);
+			break;
+		case FLAC__SUBFRAME_TYPE_LPC:
+			method = &subframe->data.lpc.entropy_coding_method;
+			residual = subframe->data.lpc.residual;
+			order = subframe->data.lpc.order;
+			bits = FLAC__SUBFRAME_ZERO_PAD_LEN + FLAC__SUBFRAME_TYPE_LEN + FLAC__SUBFRAME_WASTED_BITS_FLAG_LEN + subframe->wasted_bits + FLAC__SUBFRAME_LPC_QLP_COEFF_PRECISION_LEN + FLAC__SUBFRAME_LPC_QLP_SHIFT_LEN + (order * (subframe->data.lpc.qlp_coeff_precision + subframe_bps));
+			break;
+		default:
+			/* constant and verbatim subframes are estimated exactly */
+			return estimate;
+	}
+
+	plen = method->type == FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2? FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2_PARAMETER_LEN : FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE_PARAMETER_LEN;
+	partitions = 1u << method->data.partitioned_rice.order;
+	bits += FLAC__ENTROPY_CODING_METHOD_TYPE_LEN + FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE_ORDER_LEN + partitions * plen;
+
+	for(partition = 0; partition < partitions; partition++) {
+		const uint32_t rice_parameter = method->data.partitioned_rice.contents->parameters[partition];
+		const uint32_t raw_bits = method->data.partitioned_rice.contents->raw_bits[partition];
+		partition_samples = blocksize >> method->data.partitioned_rice.order;
+		if(partition == 0)
+			partition_samples -= order;
+		if(raw_bits > 0)
+			bits += FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE_RAW_LEN + (FLAC__uint64)raw_bits * partition_samples;
+		else {
+			bits += (FLAC__uint64)(1 + rice_parameter) * partition_samples;
+			for(i = 0; i < partition_samples; i++)
+				bits += (FLAC__uint32)((residual[i]<<1)^(residual[i]>>31)) >> rice_parameter;
+		}
+		residual += partition_samples;
+	}
+
+	return (uint32_t)flac_min(bits, UINT32_MAX);
+}
+
 uint32_t find_best_partition_order_(
 	FLAC__StreamEncoderPrivate *private_,
 	FLAC__StreamEncoderThreadTask *threadtask,
@@ -4720,6 +5848,8 @@ uint32_t find_best_partition_order_(
 	uint32_t best_partition_order = 0;
 	const uint32_t blocksize = residual_samples + predictor_order;
 
+	FLAC__PROFILE_START(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_PARTITION_SEARCH);
+
 	max_partition_order = FLAC__format_get_max_rice_partition_order_from_blocksize_limited_max_and_predictor_order(max_partition_order, blocksize, predictor_order);
 	min_partition_order = flac_min(min_partition_order, max_partition_order);
 
@@ -4791,6 +5921,7 @@ uint32_t find_best_partition_order_(
 		}
 	}
 
+	FLAC__PROFILE_STOP(&threadtask->profile, FLAC__STREAM_ENCODER_PROFILE_PARTITION_SEARCH);
 	return best_residual_bits;
 }
 
@@ -5123,6 +6254,95 @@ uint32_t get_wasted_bits_wide_(FLAC__int64 signal_wide[], FLAC__int32 signal[],
 }
 
 
+/* Feeds one frame to the verify decoder, returns false with verify.error set on a failure */
+FLAC__bool verify_frame_(FLAC__StreamEncoder *encoder, const FLAC__byte *buffer, size_t bytes, FLAC__bool is_last_frame)
+{
+	encoder->private_->verify.output.data = buffer;
+	encoder->private_->verify.output.bytes = (uint32_t)bytes;
+	if(encoder->private_->verify.state_hint == ENCODER_IN_MAGIC) {
+		encoder->private_->verify.needs_magic_hack = true;
+		return true;
+	}
+	if(!FLAC__stream_decoder_process_single(encoder->private_->verify.decoder)
+	    || (!is_last_frame
+		    && (FLAC__stream_decoder_get_state(encoder->private_->verify.decoder) == FLAC__STREAM_DECODER_END_OF_STREAM))
+	    || encoder->private_->verify.error == FLAC__STREAM_ENCODER_VERIFY_DECODER_ERROR /* Happens when error callback was used */) {
+		if(encoder->private_->verify.error != FLAC__STREAM_ENCODER_VERIFY_MISMATCH_IN_AUDIO_DATA)
+			encoder->private_->verify.error = FLAC__STREAM_ENCODER_VERIFY_DECODER_ERROR;
+		return false;
+	}
+	return true;
+}
+
+#ifdef FLAC__USE_THREADS
+/* Copies a frame into the verify queue, waiting for a free slot if needed.
+ * Returns false if a frame queued earlier failed to verify */
+FLAC__bool queue_verify_frame_(FLAC__StreamEncoder *encoder, const FLAC__byte *buffer, size_t bytes, FLAC__bool is_last_frame)
+{
+	verify_frame *slot;
+
+	if(FLAC__atomic_load(&encoder->private_->verify.num_queued) == encoder->private_->verify.queue_size) {
+		wake_up_threads_(encoder, true);
+		FLAC__mtx_lock(&encoder->private_->verify.mutex);
+		while(FLAC__atomic_load(&encoder->private_->verify.num_queued) == encoder->private_->verify.queue_size)
+			FLAC__cnd_wait(&encoder->private_->verify.cond_dequeued, &encoder->private_->verify.mutex);
+		FLAC__mtx_unlock(&encoder->private_->verify.mutex);
+	}
+	if(FLAC__atomic_load(&encoder->private_->verify.failed))
+		return false;
+
+	slot = &encoder->private_->verify.queue[encoder->private_->verify.queue_tail];
+	if(slot->capacity < bytes) {
+		FLAC__byte *data = realloc(slot->data, bytes);
+		if(0 == data) {
+			encoder->private_->verify.error = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+			return false;
+		}
+		slot->data = data;
+		slot->capacity = bytes;
+	}
+	memcpy(slot->data, buffer, bytes);
+	slot->bytes = bytes;
+	slot->is_last_frame = is_last_frame;
+	encoder->private_->verify.queue_tail = (encoder->private_->verify.queue_tail + 1) % encoder->private_->verify.queue_size;
+	FLAC__atomic_fetch_add(&encoder->private_->verify.num_queued, 1);
+	encoder->private_->num_unannounced_threadtasks++;
+	wake_up_threads_(encoder, false);
+	return true;
+}
+
+/* Must be called with verify.active set, which is cleared on return. After
+ * a failure, the remaining frames are dropped without verifying them */
+void process_verify_queue_(FLAC__StreamEncoder *encoder)
+{
+	while(FLAC__atomic_load(&encoder->private_->verify.num_queued) > 0) {
+		const verify_frame *slot = &encoder->private_->verify.queue[encoder->private_->verify.queue_head];
+		if(!FLAC__atomic_load(&encoder->private_->verify.failed) && !verify_frame_(encoder, slot->data, slot->bytes, slot->is_last_frame))
+			FLAC__atomic_store(&encoder->private_->verify.failed, 1);
+		encoder->private_->verify.queue_head = (encoder->private_->verify.queue_head + 1) % encoder->private_->verify.queue_size;
+		FLAC__mtx_lock(&encoder->private_->verify.mutex);
+		FLAC__atomic_fetch_sub(&encoder->private_->verify.num_queued, 1);
+		FLAC__cnd_signal(&encoder->private_->verify.cond_dequeued);
+		FLAC__mtx_unlock(&encoder->private_->verify.mutex);
+	}
+	FLAC__mtx_lock(&encoder->private_->verify.mutex);
+	FLAC__atomic_store(&encoder->private_->verify.active, 0);
+	FLAC__cnd_signal(&encoder->private_->verify.cond_dequeued);
+	FLAC__mtx_unlock(&encoder->private_->verify.mutex);
+}
+
+/* Waits until all queued frames are verified, returns false if one failed */
+FLAC__bool finish_verify_queue_(FLAC__StreamEncoder *encoder)
+{
+	wake_up_threads_(encoder, true);
+	FLAC__mtx_lock(&encoder->private_->verify.mutex);
+	while(FLAC__atomic_load(&encoder->private_->verify.num_queued) > 0 || FLAC__atomic_load(&encoder->private_->verify.active))
+		FLAC__cnd_wait(&encoder->private_->verify.cond_dequeued, &encoder->private_->verify.mutex);
+	FLAC__mtx_unlock(&encoder->private_->verify.mutex);
+	return !FLAC__atomic_load(&encoder->private_->verify.failed);
+}
+#endif
+
 void append_to_verify_fifo_(verify_input_fifo *fifo, const FLAC__int32 * const input[], uint32_t input_offset, uint32_t channels, uint32_t wide_samples)
 {
 	uint32_t channel;
@@ -5193,11 +6413,18 @@ FLAC__StreamDecoderWriteStatus verify_write_callback_(const FLAC__StreamDecoder
 
 	(void)decoder;
 
-	if(encoder->protected_->state == FLAC__STREAM_ENCODER_VERIFY_DECODER_ERROR) {
+	if(encoder->private_->verify.error == FLAC__STREAM_ENCODER_VERIFY_DECODER_ERROR) {
 		/* This is set when verify_error_callback_ was called */
 		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 	}
 
+	if(
+		encoder->private_->inject_verify_mismatch &&
+		encoder->private_->verify_mismatch_sample >= frame->header.number.sample_number &&
+		encoder->private_->verify_mismatch_sample - frame->header.number.sample_number < blocksize
+	)
+		encoder->private_->verify.input_fifo.data[0][encoder->private_->verify_mismatch_sample - frame->header.number.sample_number] ^= 1;
+
 	for(channel = 0; channel < channels; channel++) {
 		if(0 != memcmp(buffer[channel], encoder->private_->verify.input_fifo.data[channel], bytes_per_block)) {
 			uint32_t i, sample = 0;
@@ -5219,14 +6446,24 @@ FLAC__StreamDecoderWriteStatus verify_write_callback_(const FLAC__StreamDecoder
 			encoder->private_->verify.error_stats.sample = sample;
 			encoder->private_->verify.error_stats.expected = expect;
 			encoder->private_->verify.error_stats.got = got;
-			encoder->protected_->state = FLAC__STREAM_ENCODER_VERIFY_MISMATCH_IN_AUDIO_DATA;
+			encoder->private_->verify.error = FLAC__STREAM_ENCODER_VERIFY_MISMATCH_IN_AUDIO_DATA;
 			return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 		}
 	}
-	/* dequeue the frame from the fifo */
+	/* dequeue the frame from the fifo; when verifying on the threads, the
+	 * main thread appends to it meanwhile, but never touches the samples
+	 * compared above */
+#ifdef FLAC__USE_THREADS
+	if(0 != encoder->private_->verify.queue)
+		FLAC__mtx_lock(&encoder->private_->verify.mutex);
+#endif
 	encoder->private_->verify.input_fifo.tail -= blocksize;
 	for(channel = 0; channel < channels; channel++)
 		memmove(&encoder->private_->verify.input_fifo.data[channel][0], &encoder->private_->verify.input_fifo.data[channel][blocksize], encoder->private_->verify.input_fifo.tail * sizeof(encoder->private_->verify.input_fifo.data[0][0]));
+#ifdef FLAC__USE_THREADS
+	if(0 != encoder->private_->verify.queue)
+		FLAC__mtx_unlock(&encoder->private_->verify.mutex);
+#endif
 	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
 
@@ -5239,7 +6476,7 @@ void verify_error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDeco
 {
 	FLAC__StreamEncoder *encoder = (FLAC__StreamEncoder*)client_data;
 	(void)decoder, (void)status;
-	encoder->protected_->state = FLAC__STREAM_ENCODER_VERIFY_DECODER_ERROR;
+	encoder->private_->verify.error = FLAC__STREAM_ENCODER_VERIFY_DECODER_ERROR;
 }
 
 FLAC__StreamEncoderReadStatus file_read_callback_(const FLAC__StreamEncoder *encoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
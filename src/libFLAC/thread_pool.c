@@ -0,0 +1,237 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2026  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h>
+#include "private/stream_encoder.h"
+#include "private/thread_pool.h"
+#include "FLAC/assert.h"
+#include "share/alloc.h"
+
+#ifdef FLAC__USE_THREADS
+
+struct FLAC__ThreadPool {
+	FLAC__thrd_t thread[FLAC__STREAM_ENCODER_MAX_THREADS];
+	uint32_t num_threads;
+	FLAC__mtx_t mutex;               /* locks everything below */
+	FLAC__cnd_t cond_work;           /* signalled when a source has new work, or on shutdown */
+	FLAC__cnd_t cond_left;           /* signalled when a thread leaves a detached source */
+	FLAC__ThreadPoolSource *sources; /* a list of the attached sources */
+	FLAC__ThreadPoolSource *next_source;
+	uint32_t num_sources;
+	uint32_t generation;             /* incremented on each notification, so none are missed */
+	FLAC__bool shutdown;
+};
+
+/*
+ * The threads take work from the attached sources in turn, starting at the
+ * source after the one they last got work from.  So an idle thread steals
+ * work from whichever encoder has some, and busy encoders are served
+ * round-robin instead of the first one getting all threads.
+ */
+static FLAC__thread_return_type thread_pool_worker_(void *args)
+{
+	FLAC__ThreadPool *pool = args;
+	FLAC__ThreadPoolSource *source;
+	FLAC__bool did_work;
+	uint32_t generation, n;
+
+	FLAC__mtx_lock(&pool->mutex);
+	while(!pool->shutdown) {
+		generation = pool->generation;
+		did_work = false;
+		source = pool->next_source;
+		for(n = 0; n < pool->num_sources && !did_work; n++) {
+			if(0 == source)
+				source = pool->sources;
+			if(!source->detached) {
+				/* a busy source stays in the list, so it can be left unlocked */
+				source->busy++;
+				FLAC__mtx_unlock(&pool->mutex);
+				did_work = source->work(source->data);
+				FLAC__mtx_lock(&pool->mutex);
+				source->busy--;
+				if(source->detached && source->busy == 0)
+					FLAC__cnd_broadcast(&pool->cond_left);
+				if(did_work)
+					pool->next_source = source->next;
+			}
+			source = source->next;
+		}
+		if(!did_work && generation == pool->generation)
+			FLAC__cnd_wait(&pool->cond_work, &pool->mutex);
+	}
+	FLAC__mtx_unlock(&pool->mutex);
+	return FLAC__thread_default_return_value;
+}
+
+FLAC_API FLAC__ThreadPool *FLAC__thread_pool_new(uint32_t num_threads)
+{
+	FLAC__ThreadPool *pool;
+
+	if(num_threads == 0 || num_threads > FLAC__STREAM_ENCODER_MAX_THREADS)
+		return 0;
+
+	pool = safe_calloc_(1, sizeof(FLAC__ThreadPool));
+	if(0 == pool)
+		return 0;
+
+	if(FLAC__mtx_init(&pool->mutex, FLAC__mtx_plain) != FLAC__thrd_success) {
+		free(pool);
+		return 0;
+	}
+	if(FLAC__cnd_init(&pool->cond_work) != FLAC__thrd_success) {
+		FLAC__mtx_destroy(&pool->mutex);
+		free(pool);
+		return 0;
+	}
+	if(FLAC__cnd_init(&pool->cond_left) != FLAC__thrd_success) {
+		FLAC__cnd_destroy(&pool->cond_work);
+		FLAC__mtx_destroy(&pool->mutex);
+		free(pool);
+		return 0;
+	}
+
+	for(pool->num_threads = 0; pool->num_threads < num_threads; pool->num_threads++) {
+		if(FLAC__thrd_create(&pool->thread[pool->num_threads], thread_pool_worker_, pool) != FLAC__thrd_success)
+			break;
+	}
+	if(pool->num_threads == 0) {
+		FLAC__thread_pool_delete(pool);
+		return 0;
+	}
+
+	return pool;
+}
+
+FLAC_API void FLAC__thread_pool_delete(FLAC__ThreadPool *pool)
+{
+	uint32_t t;
+
+	if(0 == pool)
+		return;
+
+	FLAC__mtx_lock(&pool->mutex);
+	FLAC__ASSERT(pool->num_sources == 0);
+	pool->shutdown = true;
+	FLAC__cnd_broadcast(&pool->cond_work);
+	FLAC__mtx_unlock(&pool->mutex);
+
+	for(t = 0; t < pool->num_threads; t++)
+		FLAC__thrd_join(pool->thread[t], NULL);
+
+	FLAC__cnd_destroy(&pool->cond_left);
+	FLAC__cnd_destroy(&pool->cond_work);
+	FLAC__mtx_destroy(&pool->mutex);
+	free(pool);
+}
+
+void FLAC__thread_pool_attach(FLAC__ThreadPool *pool, FLAC__ThreadPoolSource *source, FLAC__bool (*work)(void *data), void *data)
+{
+	FLAC__ASSERT(0 != pool);
+	FLAC__ASSERT(0 != source);
+
+	source->work = work;
+	source->data = data;
+	source->busy = 0;
+	source->detached = false;
+
+	FLAC__mtx_lock(&pool->mutex);
+	source->next = pool->sources;
+	pool->sources = source;
+	pool->num_sources++;
+	FLAC__mtx_unlock(&pool->mutex);
+}
+
+void FLAC__thread_pool_detach(FLAC__ThreadPool *pool, FLAC__ThreadPoolSource *source)
+{
+	FLAC__ThreadPoolSource **s;
+
+	FLAC__ASSERT(0 != pool);
+	FLAC__ASSERT(0 != source);
+
+	FLAC__mtx_lock(&pool->mutex);
+	for(s = &pool->sources; *s != 0 && *s != source; s = &(*s)->next)
+		;
+	/* not attached, which happens when initialization failed */
+	if(*s == 0) {
+		FLAC__mtx_unlock(&pool->mutex);
+		return;
+	}
+
+	source->detached = true;
+	while(source->busy > 0)
+		FLAC__cnd_wait(&pool->cond_left, &pool->mutex);
+
+	/* the list may have changed while waiting */
+	for(s = &pool->sources; *s != source; s = &(*s)->next)
+		;
+	*s = source->next;
+	if(pool->next_source == source)
+		pool->next_source = source->next;
+	pool->num_sources--;
+	FLAC__mtx_unlock(&pool->mutex);
+}
+
+void FLAC__thread_pool_notify(FLAC__ThreadPool *pool)
+{
+	FLAC__ASSERT(0 != pool);
+
+	FLAC__mtx_lock(&pool->mutex);
+	pool->generation++;
+	/* work is submitted in batches, so wake up all threads */
+	FLAC__cnd_broadcast(&pool->cond_work);
+	FLAC__mtx_unlock(&pool->mutex);
+}
+
+uint32_t FLAC__thread_pool_get_num_threads(const FLAC__ThreadPool *pool)
+{
+	FLAC__ASSERT(0 != pool);
+	return pool->num_threads;
+}
+
+#else
+
+FLAC_API FLAC__ThreadPool *FLAC__thread_pool_new(uint32_t num_threads)
+{
+	(void)num_threads;
+	return 0;
+}
+
+FLAC_API void FLAC__thread_pool_delete(FLAC__ThreadPool *pool)
+{
+	(void)pool;
+}
+
+#endif
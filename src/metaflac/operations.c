@@ -29,6 +29,7 @@
 #include "share/alloc.h"
 #include "share/grabbag.h"
 #include "share/compat.h"
+#include "share/compat_threads.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -44,7 +45,7 @@ static FLAC__bool do_major_operation__remove_all(FLAC__Metadata_Chain *chain, co
 static FLAC__bool do_shorthand_operations(const CommandLineOptions *options);
 static FLAC__bool do_shorthand_operations_on_file(const char *filename, const CommandLineOptions *options);
 static FLAC__bool do_shorthand_operation(const char *filename, FLAC__bool prefix_with_filename, FLAC__Metadata_Chain *chain, const Operation *operation, FLAC__bool *needs_write, FLAC__bool utf8_convert);
-static FLAC__bool do_shorthand_operation__add_replay_gain(char **filenames, unsigned num_files, FLAC__bool preserve_modtime, FLAC__bool scan);
+static FLAC__bool do_shorthand_operation__add_replay_gain(char **filenames, unsigned num_files, unsigned num_threads, FLAC__bool preserve_modtime, FLAC__bool scan);
 static FLAC__bool do_shorthand_operation__add_padding(const char *filename, FLAC__Metadata_Chain *chain, unsigned length, FLAC__bool *needs_write);
 
 static FLAC__bool passes_filter(const CommandLineOptions *options, const FLAC__StreamMetadata *block, unsigned block_number);
@@ -417,9 +418,9 @@ FLAC__bool do_shorthand_operations(const CommandLineOptions *options)
 	if(ok && options->num_files > 0) {
 		for(i = 0; i < options->ops.num_operations; i++) {
 			if(options->ops.operations[i].type == OP__ADD_REPLAY_GAIN)
-				ok = do_shorthand_operation__add_replay_gain(options->filenames, options->num_files, options->preserve_modtime, false);
+				ok = do_shorthand_operation__add_replay_gain(options->filenames, options->num_files, options->threads, options->preserve_modtime, false);
 			else if(options->ops.operations[i].type == OP__SCAN_REPLAY_GAIN)
-				ok = do_shorthand_operation__add_replay_gain(options->filenames, options->num_files, options->preserve_modtime, true);
+				ok = do_shorthand_operation__add_replay_gain(options->filenames, options->num_files, options->threads, options->preserve_modtime, true);
 		}
 	}
 
@@ -554,7 +555,60 @@ FLAC__bool do_shorthand_operation(const char *filename, FLAC__bool prefix_with_f
 	return ok;
 }
 
-FLAC__bool do_shorthand_operation__add_replay_gain(char **filenames, unsigned num_files, FLAC__bool preserve_modtime, FLAC__bool scan)
+/*
+ * ReplayGain analysis: every file is analyzed in a context of its own,
+ * possibly on a thread of its own; each context is merged into the album
+ * and deleted as soon as its file is done. The album only adds up the
+ * histograms and takes the highest peak, so the order doesn't matter.
+ */
+typedef struct {
+	char **filenames;
+	unsigned num_files;
+	unsigned sample_rate;
+	unsigned next_file;
+#ifdef FLAC__USE_THREADS
+	FLAC__mtx_t mutex; /* for next_file and album */
+#endif
+	grabbag__ReplayGain *album;
+	float *title_gains, *title_peaks;
+	const char **errors;
+} replay_gain_files_t;
+
+static FLAC__thread_return_type replay_gain_worker(void *args)
+{
+	replay_gain_files_t *rg = (replay_gain_files_t *)args;
+	grabbag__ReplayGain *context;
+	unsigned i;
+
+	for(;;) {
+#ifdef FLAC__USE_THREADS
+		FLAC__mtx_lock(&rg->mutex);
+#endif
+		i = rg->next_file++;
+#ifdef FLAC__USE_THREADS
+		FLAC__mtx_unlock(&rg->mutex);
+#endif
+		if(i >= rg->num_files)
+			break;
+		if(0 == (context = grabbag__replaygain_context_new(rg->sample_rate))) {
+			rg->errors[i] = "memory allocation error";
+			continue;
+		}
+		if(0 == (rg->errors[i] = grabbag__replaygain_context_analyze_file(context, rg->filenames[i], rg->title_gains+i, rg->title_peaks+i))) {
+#ifdef FLAC__USE_THREADS
+			FLAC__mtx_lock(&rg->mutex);
+#endif
+			grabbag__replaygain_context_merge_into_album(rg->album, context);
+#ifdef FLAC__USE_THREADS
+			FLAC__mtx_unlock(&rg->mutex);
+#endif
+		}
+		grabbag__replaygain_context_delete(context);
+	}
+	return FLAC__thread_default_return_value;
+}
+
+FLAC__bool do_shorthand_operation__add_replay_gain(char **filenames, unsigned num_files, unsigned num_threads, FLAC__bool preserve_modtime, FLAC__bool scan)
 {
 	FLAC__StreamMetadata streaminfo;
 	float *title_gains = 0, *title_peaks = 0;
@@ -564,7 +618,12 @@ FLAC__bool do_shorthand_operation__add_replay_gain(char **filenames, unsigned nu
 	unsigned channels = 0;
 	unsigned i;
 	const char *error;
-	FLAC__bool first = true;
+	FLAC__bool first = true, ok = true;
+	replay_gain_files_t rg;
+#ifdef FLAC__USE_THREADS
+	FLAC__thrd_t threads[64];
+	unsigned threads_created = 0;
+#endif
 
 	FLAC__ASSERT(num_files > 0);
 
@@ -608,7 +667,7 @@ FLAC__bool do_shorthand_operation__add_replay_gain(char **filenames, unsigned nu
 		}
 	}
 
-	if(!grabbag__replaygain_init(sample_rate)) {
+	if(!grabbag__replaygain_is_valid_sample_frequency(sample_rate)) {
 		FLAC__ASSERT(0);
 		/* double protection */
 		flac_fprintf(stderr, "internal error\n");
@@ -617,19 +676,55 @@ FLAC__bool do_shorthand_operation__add_replay_gain(char **filenames, unsigned nu
 
 	if(
 		0 == (title_gains = safe_malloc_mul_2op_(sizeof(float), /*times*/num_files)) ||
-		0 == (title_peaks = safe_malloc_mul_2op_(sizeof(float), /*times*/num_files))
+		0 == (title_peaks = safe_malloc_mul_2op_(sizeof(float), /*times*/num_files)) ||
+		0 == (rg.errors = safe_calloc_(num_files, sizeof(const char *))) ||
+		0 == (rg.album = grabbag__replaygain_context_new(0))
 	)
 		die("out of memory allocating space for title gains/peaks");
 
-	for(i = 0; i < num_files; i++) {
-		if(0 != (error = grabbag__replaygain_analyze_file(filenames[i], title_gains+i, title_peaks+i))) {
-			flac_fprintf(stderr, "%s: ERROR: during analysis (%s)\n", filenames[i], error);
-			free(title_gains);
-			free(title_peaks);
-			return false;
+	rg.filenames = filenames;
+	rg.num_files = num_files;
+	rg.sample_rate = sample_rate;
+	rg.next_file = 0;
+	rg.title_gains = title_gains;
+	rg.title_peaks = title_peaks;
+
+#ifdef FLAC__USE_THREADS
+	if(num_threads > num_files)
+		num_threads = num_files;
+	if(num_threads > sizeof(threads) / sizeof(threads[0]))
+		num_threads = sizeof(threads) / sizeof(threads[0]);
+	if(FLAC__mtx_init(&rg.mutex, FLAC__mtx_plain) != FLAC__thrd_success)
+		die("out of memory allocating mutex");
+	for(i = 0; num_threads > 1 && i < num_threads; i++) {
+		if(FLAC__thrd_create(&threads[threads_created], replay_gain_worker, &rg) == FLAC__thrd_success)
+			threads_created++;
+	}
+	/* without any worker the files are analyzed here */
+	if(threads_created == 0)
+		replay_gain_worker(&rg);
+	for(i = 0; i < threads_created; i++)
+		FLAC__thrd_join(threads[i], NULL);
+	FLAC__mtx_destroy(&rg.mutex);
+#else
+	(void)num_threads;
+	replay_gain_worker(&rg);
+#endif
+
+	for(i = 0; ok && i < num_files; i++) {
+		if(0 != rg.errors[i]) {
+			flac_fprintf(stderr, "%s: ERROR: during analysis (%s)\n", filenames[i], rg.errors[i]);
+			ok = false;
 		}
 	}
-	grabbag__replaygain_get_album(&album_gain, &album_peak);
+	grabbag__replaygain_context_get_album(rg.album, &album_gain, &album_peak);
+	grabbag__replaygain_context_delete(rg.album);
+	free(rg.errors);
+	if(!ok) {
+		free(title_gains);
+		free(title_peaks);
+		return false;
+	}
 
 	for(i = 0; i < num_files; i++) {
 		if(!scan) {
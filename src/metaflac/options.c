@@ -46,6 +46,7 @@ struct share__option long_options_[] = {
 	{ "no-utf8-convert", 0, 0, 0 },
 	{ "dont-use-padding", 0, 0, 0 },
 	{ "no-cued-seekpoints", 0, 0, 0 },
+	{ "threads", 1, 0, 0 },
 	/* shorthand operations */
 	{ "show-md5sum", 0, 0, 0 },
 	{ "show-min-blocksize", 0, 0, 0 },
@@ -138,6 +139,7 @@ void init_options(CommandLineOptions *options)
 	options->utf8_convert = true;
 	options->use_padding = true;
 	options->cued_seekpoints = true;
+	options->threads = 1;
 	options->show_long_help = false;
 	options->show_version = false;
 	options->data_format_is_binary = false;
@@ -404,6 +406,12 @@ FLAC__bool parse_option(int option_index, const char *option_argument, CommandLi
 	else if(0 == strcmp(opt, "no-cued-seekpoints")) {
 		options->cued_seekpoints = false;
 	}
+	else if(0 == strcmp(opt, "threads")) {
+		if(!parse_uint32(option_argument, &options->threads) || options->threads < 1 || options->threads > 64) {
+			flac_fprintf(stderr, "ERROR (--%s): value must be >= 1 and <= 64\n", opt);
+			ok = false;
+		}
+	}
 	else if(0 == strcmp(opt, "output-name")) {
 		options->output_name = option_argument;
 	}
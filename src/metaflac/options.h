@@ -189,6 +189,7 @@ typedef struct {
 	FLAC__bool utf8_convert;
 	FLAC__bool use_padding;
 	FLAC__bool cued_seekpoints;
+	FLAC__uint32 threads;
 	FLAC__bool show_long_help;
 	FLAC__bool show_version;
 	FLAC__bool data_format_is_binary;
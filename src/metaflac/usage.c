@@ -77,6 +77,8 @@ static void usage_summary(FILE *out)
 	flac_fprintf(out, "                      to avoid rewriting the entire file if the metadata size\n");
 	flac_fprintf(out, "                      changes.  Use this option to tell metaflac to not take\n");
 	flac_fprintf(out, "                      advantage of padding this way.\n");
+	flac_fprintf(out, "--threads=#           Analyze up to # files at once for --add-replay-gain and\n");
+	flac_fprintf(out, "                      --scan-replay-gain (default 1, max 64).\n");
 }
 
 int short_usage(const char *message, ...)
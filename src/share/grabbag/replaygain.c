@@ -57,7 +57,15 @@ static const char *reference_format_ = "%s=%2.1f dB";
 static const char *gain_format_ = "%s=%+2.2f dB";
 static const char *peak_format_ = "%s=%1.8f";
 
-static double album_peak_, title_peak_;
+struct grabbag__ReplayGain {
+	GainAnalysisContext *analysis;
+	double album_peak, title_peak;
+	/* using a small buffer improves data locality; we'd like it to fit easily in the dcache */
+	flac_float_t lbuffer[2048], rbuffer[2048];
+};
+
+/* the context of grabbag__replaygain_init() and the functions without a context argument */
+static grabbag__ReplayGain *default_context_ = 0;
 
 const uint32_t GRABBAG__REPLAYGAIN_MAX_TAG_SPACE_REQUIRED = 190;
 /*
@@ -93,7 +101,9 @@ static void set_file_stats_(const char *filename, struct flac_stat_s *stats)
 static FLAC__bool append_tag_(FLAC__StreamMetadata *block, const char *format, const FLAC__byte *name, float value)
 {
 	char buffer[256];
-	char *saved_locale;
+	const char *decimal_point;
+	char *p;
+	size_t decimal_point_len;
 	FLAC__StreamMetadata_VorbisComment_Entry entry;
 
 	FLAC__ASSERT(0 != block);
@@ -102,17 +112,19 @@ static FLAC__bool append_tag_(FLAC__StreamMetadata *block, const char *format, c
 	FLAC__ASSERT(0 != name);
 
 	buffer[sizeof(buffer)-1] = '\0';
+	flac_snprintf(buffer, sizeof(buffer), format, name, value);
 	/*
-	 * We need to save the old locale and switch to "C" because the locale
-	 * influences the formatting of %f and we want it a certain way.
+	 * The locale influences the formatting of %f, and the tags always
+	 * need a '.'.  Switching to the "C" locale for the formatting would
+	 * change it for all threads, so replace the locale's decimal point
+	 * afterwards instead.
 	 */
-	saved_locale = strdup(setlocale(LC_ALL, 0));
-	if (0 == saved_locale)
-		return false;
-	setlocale(LC_ALL, "C");
-	flac_snprintf(buffer, sizeof(buffer), format, name, value);
-	setlocale(LC_ALL, saved_locale);
-	free(saved_locale);
+	decimal_point = localeconv()->decimal_point;
+	decimal_point_len = strlen(decimal_point);
+	if(decimal_point_len > 0 && strcmp(decimal_point, ".") && 0 != (p = strstr(buffer + strlen((const char *)name), decimal_point))) {
+		*p = '.';
+		memmove(p + 1, p + decimal_point_len, strlen(p + decimal_point_len) + 1);
+	}
 
 	entry.entry = (FLAC__byte *)buffer;
 	entry.length = strlen(buffer);
@@ -127,15 +139,48 @@ FLAC__bool grabbag__replaygain_is_valid_sample_frequency(uint32_t sample_frequen
 
 FLAC__bool grabbag__replaygain_init(uint32_t sample_frequency)
 {
-	title_peak_ = album_peak_ = 0.0;
-	return InitGainAnalysis((long)sample_frequency) == INIT_GAIN_ANALYSIS_OK;
+	grabbag__replaygain_context_delete(default_context_);
+	return 0 != (default_context_ = grabbag__replaygain_context_new(sample_frequency));
+}
+
+void grabbag__replaygain_deinit(void)
+{
+	grabbag__replaygain_context_delete(default_context_);
+	default_context_ = 0;
+}
+
+grabbag__ReplayGain *grabbag__replaygain_context_new(uint32_t sample_frequency)
+{
+	grabbag__ReplayGain *context = calloc(1, sizeof(grabbag__ReplayGain));
+
+	if(0 == context)
+		return 0;
+	if(0 == (context->analysis = CreateGainAnalysis((long)sample_frequency))) {
+		free(context);
+		return 0;
+	}
+	context->title_peak = context->album_peak = 0.0;
+	return context;
+}
+
+void grabbag__replaygain_context_delete(grabbag__ReplayGain *context)
+{
+	if(0 == context)
+		return;
+	DeleteGainAnalysis(context->analysis);
+	free(context);
 }
 
 FLAC__bool grabbag__replaygain_analyze(const FLAC__int32 * const input[], FLAC__bool is_stereo, uint32_t bps, uint32_t samples)
 {
-	/* using a small buffer improves data locality; we'd like it to fit easily in the dcache */
-	static flac_float_t lbuffer[2048], rbuffer[2048];
-	static const uint32_t nbuffer = sizeof(lbuffer) / sizeof(lbuffer[0]);
+	FLAC__ASSERT(0 != default_context_);
+	return grabbag__replaygain_context_analyze(default_context_, input, is_stereo, bps, samples);
+}
+
+FLAC__bool grabbag__replaygain_context_analyze(grabbag__ReplayGain *context, const FLAC__int32 * const input[], FLAC__bool is_stereo, uint32_t bps, uint32_t samples)
+{
+	flac_float_t *lbuffer = context->lbuffer, *rbuffer = context->rbuffer;
+	const uint32_t nbuffer = sizeof(context->lbuffer) / sizeof(context->lbuffer[0]);
 	FLAC__int32 block_peak = 0, s;
 	uint32_t i, j;
 
@@ -159,7 +204,7 @@ FLAC__bool grabbag__replaygain_analyze(const FLAC__int32 * const input[], FLAC__
 					block_peak = local_max(block_peak, s);
 				}
 				samples -= n;
-				if(AnalyzeSamples(lbuffer, rbuffer, n, 2) != GAIN_ANALYSIS_OK)
+				if(AnalyzeSamplesContext(context->analysis, lbuffer, rbuffer, n, 2) != GAIN_ANALYSIS_OK)
 					return false;
 			}
 		}
@@ -174,7 +219,7 @@ FLAC__bool grabbag__replaygain_analyze(const FLAC__int32 * const input[], FLAC__
 					block_peak = local_max(block_peak, s);
 				}
 				samples -= n;
-				if(AnalyzeSamples(lbuffer, 0, n, 1) != GAIN_ANALYSIS_OK)
+				if(AnalyzeSamplesContext(context->analysis, lbuffer, 0, n, 1) != GAIN_ANALYSIS_OK)
 					return false;
 			}
 		}
@@ -202,7 +247,7 @@ FLAC__bool grabbag__replaygain_analyze(const FLAC__int32 * const input[], FLAC__
 					block_peak = local_max(block_peak, s);
 				}
 				samples -= n;
-				if(AnalyzeSamples(lbuffer, rbuffer, n, 2) != GAIN_ANALYSIS_OK)
+				if(AnalyzeSamplesContext(context->analysis, lbuffer, rbuffer, n, 2) != GAIN_ANALYSIS_OK)
 					return false;
 			}
 		}
@@ -217,7 +262,7 @@ FLAC__bool grabbag__replaygain_analyze(const FLAC__int32 * const input[], FLAC__
 					block_peak = local_max(block_peak, s);
 				}
 				samples -= n;
-				if(AnalyzeSamples(lbuffer, 0, n, 1) != GAIN_ANALYSIS_OK)
+				if(AnalyzeSamplesContext(context->analysis, lbuffer, 0, n, 1) != GAIN_ANALYSIS_OK)
 					return false;
 			}
 		}
@@ -226,10 +271,10 @@ FLAC__bool grabbag__replaygain_analyze(const FLAC__int32 * const input[], FLAC__
 	{
 		const double peak_scale = (double)(1u << (bps - 1));
 		double peak = (double)block_peak / peak_scale;
-		if(peak > title_peak_)
-			title_peak_ = peak;
-		if(peak > album_peak_)
-			album_peak_ = peak;
+		if(peak > context->title_peak)
+			context->title_peak = peak;
+		if(peak > context->album_peak)
+			context->album_peak = peak;
 	}
 
 	return true;
@@ -237,16 +282,35 @@ FLAC__bool grabbag__replaygain_analyze(const FLAC__int32 * const input[], FLAC__
 
 void grabbag__replaygain_get_album(float *gain, float *peak)
 {
-	*gain = (float)GetAlbumGain();
-	*peak = (float)album_peak_;
-	album_peak_ = 0.0;
+	FLAC__ASSERT(0 != default_context_);
+	grabbag__replaygain_context_get_album(default_context_, gain, peak);
+}
+
+void grabbag__replaygain_context_get_album(grabbag__ReplayGain *context, float *gain, float *peak)
+{
+	*gain = (float)GetAlbumGainContext(context->analysis);
+	*peak = (float)context->album_peak;
+	context->album_peak = 0.0;
 }
 
 void grabbag__replaygain_get_title(float *gain, float *peak)
 {
-	*gain = (float)GetTitleGain();
-	*peak = (float)title_peak_;
-	title_peak_ = 0.0;
+	FLAC__ASSERT(0 != default_context_);
+	grabbag__replaygain_context_get_title(default_context_, gain, peak);
+}
+
+void grabbag__replaygain_context_get_title(grabbag__ReplayGain *context, float *gain, float *peak)
+{
+	*gain = (float)GetTitleGainContext(context->analysis);
+	*peak = (float)context->title_peak;
+	context->title_peak = 0.0;
+}
+
+void grabbag__replaygain_context_merge_into_album(grabbag__ReplayGain *album, const grabbag__ReplayGain *track)
+{
+	MergeIntoAlbumContext(album->analysis, track->analysis);
+	if(track->album_peak > album->album_peak)
+		album->album_peak = track->album_peak;
 }
 
 
@@ -254,6 +318,7 @@ typedef struct {
 	uint32_t channels;
 	uint32_t bits_per_sample;
 	uint32_t sample_rate;
+	grabbag__ReplayGain *context;
 	FLAC__bool error;
 } DecoderInstance;
 
@@ -274,7 +339,7 @@ static FLAC__StreamDecoderWriteStatus write_callback_(const FLAC__StreamDecoder
 		channels == instance->channels &&
 		sample_rate == instance->sample_rate
 	) {
-		instance->error = !grabbag__replaygain_analyze(buffer, channels==2, bits_per_sample, samples);
+		instance->error = !grabbag__replaygain_context_analyze(instance->context, buffer, channels==2, bits_per_sample, samples);
 	}
 	else {
 		instance->error = true;
@@ -319,6 +384,12 @@ static void error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDeco
 }
 
 const char *grabbag__replaygain_analyze_file(const char *filename, float *title_gain, float *title_peak)
+{
+	FLAC__ASSERT(0 != default_context_);
+	return grabbag__replaygain_context_analyze_file(default_context_, filename, title_gain, title_peak);
+}
+
+const char *grabbag__replaygain_context_analyze_file(grabbag__ReplayGain *context, const char *filename, float *title_gain, float *title_peak)
 {
 	DecoderInstance instance;
 	FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new();
@@ -326,6 +397,7 @@ const char *grabbag__replaygain_analyze_file(const char *filename, float *title_
 	if(0 == decoder)
 		return "memory allocation error";
 
+	instance.context = context;
 	instance.error = false;
 
 	/* It does these three by default but lets be explicit: */
@@ -345,7 +417,7 @@ const char *grabbag__replaygain_analyze_file(const char *filename, float *title_
 
 	FLAC__stream_decoder_delete(decoder);
 
-	grabbag__replaygain_get_title(title_gain, title_peak);
+	grabbag__replaygain_context_get_title(context, title_gain, title_peak);
 
 	return 0;
 }
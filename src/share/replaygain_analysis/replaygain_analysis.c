@@ -72,6 +72,25 @@
  *        fprintf ("Recommended dB change for song %2d: %+6.2f dB\n", i, GetTitleGain() );
  *    }
  *    fprintf ("Recommended dB change for whole album: %+6.2f dB\n", GetAlbumGain() );
+ *
+ *  The functions above keep their state in a single static context, so
+ *  only one track can be analyzed at a time.  To analyze several tracks
+ *  at once, e.g. on different threads, give each its own context:
+ *
+ *    GainAnalysisContext* track = CreateGainAnalysis ( 44100 );
+ *    while ( ( num_samples = getSongSamples ( song, left_samples, right_samples ) ) > 0 )
+ *        AnalyzeSamplesContext ( track, left_samples, right_samples, num_samples, 2 );
+ *    title_gain = GetTitleGainContext ( track );
+ *
+ *  and merge the finished tracks into a context holding the album with
+ *
+ *    MergeIntoAlbumContext ( album, track );
+ *    DeleteGainAnalysis ( track );
+ *
+ *  after which GetAlbumGainContext ( album ) returns the album gain.  A
+ *  context that only collects tracks can be created with samplefreq 0.
+ *  Different contexts can be used on different threads at the same time,
+ *  as long as each of them is used by one thread at a time.
  */
 
 /*
@@ -101,6 +120,12 @@
 #include "share/compat.h"
 #include "share/replaygain_analysis.h"
 
+/* x86-64 always has SSE2, so there is no need for a runtime check */
+#if FLAC__HAS_X86INTRIN && !defined FLAC__NO_ASM && (defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2))
+#define FILTER_SSE2
+#include <emmintrin.h>
+#endif
+
 flac_float_t ReplayGainReferenceLoudness = 89.0; /* in dB SPL */
 
 #define YULE_ORDER         10
@@ -113,35 +138,6 @@ flac_float_t ReplayGainReferenceLoudness = 89.0; /* in dB SPL */
 #define MAX_ORDER               (BUTTER_ORDER > YULE_ORDER ? BUTTER_ORDER : YULE_ORDER)
 #define PINK_REF                64.82 /* 298640883795 */                          /* calibration value */
 
-static flac_float_t          linprebuf [MAX_ORDER * 2];
-static flac_float_t*         linpre;                                          /* left input samples, with pre-buffer */
-static flac_float_t*         lstepbuf;
-static flac_float_t*         lstep;                                           /* left "first step" (i.e. post first filter) samples */
-static flac_float_t*         loutbuf;
-static flac_float_t*         lout;                                            /* left "out" (i.e. post second filter) samples */
-static flac_float_t          rinprebuf [MAX_ORDER * 2];
-static flac_float_t*         rinpre;                                          /* right input samples ... */
-static flac_float_t*         rstepbuf;
-static flac_float_t*         rstep;
-static flac_float_t*         routbuf;
-static flac_float_t*         rout;
-static uint32_t              sampleWindow;                           /* number of samples required to reach number of milliseconds required for RMS window */
-static uint64_t	        totsamp;
-static double           lsum;
-static double           rsum;
-#if 0
-static uint32_t  A [(size_t)(STEPS_per_dB * MAX_dB)];
-static uint32_t  B [(size_t)(STEPS_per_dB * MAX_dB)];
-#else
-/* [JEC] Solaris Forte compiler doesn't like float calc in array indices */
-static uint32_t  A [120 * 100];
-static uint32_t  B [120 * 100];
-#endif
-
-#ifdef _MSC_VER
-#pragma warning ( disable : 4305 )
-#endif
-
 struct ReplayGainFilter {
     long rate;
     uint32_t downsample;
@@ -151,7 +147,40 @@ struct ReplayGainFilter {
     flac_float_t AButter[BUTTER_ORDER+1];
 };
 
-static struct ReplayGainFilter *replaygainfilter;
+struct GainAnalysisContext {
+    flac_float_t          linprebuf [MAX_ORDER * 2];
+    flac_float_t*         linpre;                                          /* left input samples, with pre-buffer */
+    flac_float_t*         lstepbuf;
+    flac_float_t*         lstep;                                           /* left "first step" (i.e. post first filter) samples */
+    flac_float_t*         loutbuf;
+    flac_float_t*         lout;                                            /* left "out" (i.e. post second filter) samples */
+    flac_float_t          rinprebuf [MAX_ORDER * 2];
+    flac_float_t*         rinpre;                                          /* right input samples ... */
+    flac_float_t*         rstepbuf;
+    flac_float_t*         rstep;
+    flac_float_t*         routbuf;
+    flac_float_t*         rout;
+    uint32_t              sampleWindow;                           /* number of samples required to reach number of milliseconds required for RMS window */
+    uint64_t	          totsamp;
+    double                lsum;
+    double                rsum;
+#if 0
+    uint32_t  A [(size_t)(STEPS_per_dB * MAX_dB)];
+    uint32_t  B [(size_t)(STEPS_per_dB * MAX_dB)];
+#else
+/* [JEC] Solaris Forte compiler doesn't like float calc in array indices */
+    uint32_t  A [120 * 100];                                       /* histogram of the current title */
+    uint32_t  B [120 * 100];                                       /* histogram of the finished titles */
+#endif
+    struct ReplayGainFilter *replaygainfilter;
+};
+
+/* the context of InitGainAnalysis(), AnalyzeSamples(), GetTitleGain() and GetAlbumGain() */
+static GainAnalysisContext defaultcontext;
+
+#ifdef _MSC_VER
+#pragma warning ( disable : 4305 )
+#endif
 
 static const struct ReplayGainFilter ReplayGainFilters[] = {
 
@@ -266,38 +295,131 @@ static const struct ReplayGainFilter ReplayGainFilters[] = {
 #pragma warning ( default : 4305 )
 #endif
 
-/* When calling this procedure, make sure that ip[-order] and op[-order] point to real data! */
+/*
+ * Runs each channel through the Yule-Walker and then the Butterworth
+ * filter, computing y[i] = b[0]*x[i] + sum over k of (b[k]*x[i-k] - a[k]*y[i-k])
+ * in single precision products and a double precision sum, in that order,
+ * and adds the squares of the output samples to 'lsum' and 'rsum' for the
+ * RMS window.  The recursion on the previous output samples keeps a
+ * channel from running ahead, so what is done in parallel is the two
+ * channels, in the two lanes of a vector with SSE2, and the two filters,
+ * which the CPU can overlap because they are done in one pass.  Both
+ * versions give bit-identical results.
+ *
+ * When calling this procedure, make sure that the YULE_ORDER samples
+ * before each input and output point to real data!
+ */
+
+#ifdef FILTER_SSE2
+
+static void
+filter_stereo ( const flac_float_t* linput, const flac_float_t* rinput, flac_float_t* lstep, flac_float_t* rstep, flac_float_t* loutput, flac_float_t* routput, size_t nSamples, const struct ReplayGainFilter* f, uint32_t downsample, double* lsum, double* rsum )
+{
+    __m128   ayule [YULE_ORDER+1];
+    __m128   byule [YULE_ORDER+1];
+    __m128   abutter [BUTTER_ORDER+1];
+    __m128   bbutter [BUTTER_ORDER+1];
+    __m128   step1, step2, out1, out2;   /* the last two samples of lstep/rstep and loutput/routput */
+    __m128   x;
+    __m128d  y;
+    __m128d  sum = _mm_setzero_pd();
+    double   sums [2];
+    size_t   i;
+    size_t   k;
+
+    for ( k = 0; k <= YULE_ORDER; k++ ) {
+        ayule[k] = _mm_set1_ps(f->AYule[k]);
+        byule[k] = _mm_set1_ps(f->BYule[k]);
+    }
+    for ( k = 0; k <= BUTTER_ORDER; k++ ) {
+        abutter[k] = _mm_set1_ps(f->AButter[k]);
+        bbutter[k] = _mm_set1_ps(f->BButter[k]);
+    }
+
+    step1 = _mm_unpacklo_ps(_mm_load_ss(lstep - 1), _mm_load_ss(rstep - 1));
+    step2 = _mm_unpacklo_ps(_mm_load_ss(lstep - 2), _mm_load_ss(rstep - 2));
+    out1  = _mm_unpacklo_ps(_mm_load_ss(loutput - 1), _mm_load_ss(routput - 1));
+    out2  = _mm_unpacklo_ps(_mm_load_ss(loutput - 2), _mm_load_ss(routput - 2));
+
+    for ( i = 0; i < nSamples; i++, linput += downsample, rinput += downsample ) {
+
+        x = _mm_unpacklo_ps(_mm_load_ss(linput), _mm_load_ss(rinput));
+        y = _mm_cvtps_pd(_mm_mul_ps(x, byule[0]));
+
+        for ( k = 1; k <= YULE_ORDER; k++ ) {
+            __m128 in  = _mm_unpacklo_ps(_mm_load_ss(linput - k * downsample), _mm_load_ss(rinput - k * downsample));
+            __m128 out = _mm_unpacklo_ps(_mm_load_ss(lstep + i - k), _mm_load_ss(rstep + i - k));
+            y = _mm_add_pd(y, _mm_cvtps_pd(_mm_sub_ps(_mm_mul_ps(in, byule[k]), _mm_mul_ps(out, ayule[k]))));
+        }
+
+        x = _mm_cvtpd_ps(y);
+        _mm_store_ss(lstep + i, x);
+        _mm_store_ss(rstep + i, _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1)));
+
+        y = _mm_cvtps_pd(_mm_mul_ps(x, bbutter[0]));
+        y = _mm_add_pd(y, _mm_cvtps_pd(_mm_sub_ps(_mm_mul_ps(step1, bbutter[1]), _mm_mul_ps(out1, abutter[1]))));
+        y = _mm_add_pd(y, _mm_cvtps_pd(_mm_sub_ps(_mm_mul_ps(step2, bbutter[2]), _mm_mul_ps(out2, abutter[2]))));
+        step2 = step1;
+        step1 = x;
+
+        x = _mm_cvtpd_ps(y);
+        _mm_store_ss(loutput + i, x);
+        _mm_store_ss(routput + i, _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1)));
+        out2 = out1;
+        out1 = x;
+
+        sum = _mm_add_pd(sum, _mm_cvtps_pd(_mm_mul_ps(x, x)));
+    }
+
+    _mm_storeu_pd(sums, sum);
+    *lsum += sums[0];
+    *rsum += sums[1];
+}
+
+#else
 
 static void
-filter ( const flac_float_t* input, flac_float_t* output, size_t nSamples, const flac_float_t* a, const flac_float_t* b, size_t order, uint32_t downsample )
+filter_stereo ( const flac_float_t* linput, const flac_float_t* rinput, flac_float_t* lstep, flac_float_t* rstep, flac_float_t* loutput, flac_float_t* routput, size_t nSamples, const struct ReplayGainFilter* f, uint32_t downsample, double* lsum, double* rsum )
 {
-    double  y;
+    double  yl, yr;
+    double  suml = 0., sumr = 0.;
     size_t  i;
     size_t  k;
 
-    const flac_float_t* input_head = input;
-    const flac_float_t* input_tail;
+    for ( i = 0; i < nSamples; i++, linput += downsample, rinput += downsample ) {
 
-    flac_float_t* output_head = output;
-    flac_float_t* output_tail;
+        yl = *linput * f->BYule[0];
+        yr = *rinput * f->BYule[0];
 
-    for ( i = 0; i < nSamples; i++, input_head += downsample, ++output_head ) {
+        for ( k = 1; k <= YULE_ORDER; k++ ) {
+            yl += linput[-(long)(k * downsample)] * f->BYule[k] - lstep[i-k] * f->AYule[k];
+            yr += rinput[-(long)(k * downsample)] * f->BYule[k] - rstep[i-k] * f->AYule[k];
+        }
 
-        input_tail = input_head;
-        output_tail = output_head;
+        lstep[i] = (flac_float_t)yl;
+        rstep[i] = (flac_float_t)yr;
 
-        y = *input_head * b[0];
+        yl = lstep[i] * f->BButter[0];
+        yr = rstep[i] * f->BButter[0];
 
-        for ( k = 1; k <= order; k++ ) {
-            input_tail -= downsample;
-            --output_tail;
-            y += *input_tail * b[k] - *output_tail * a[k];
+        for ( k = 1; k <= BUTTER_ORDER; k++ ) {
+            yl += lstep[i-k] * f->BButter[k] - loutput[i-k] * f->AButter[k];
+            yr += rstep[i-k] * f->BButter[k] - routput[i-k] * f->AButter[k];
         }
 
-        output[i] = (flac_float_t)y;
+        loutput[i] = (flac_float_t)yl;
+        routput[i] = (flac_float_t)yr;
+
+        suml += loutput[i] * loutput[i];
+        sumr += routput[i] * routput[i];
     }
+
+    *lsum += suml;
+    *rsum += sumr;
 }
 
+#endif
+
 /* returns a INIT_GAIN_ANALYSIS_OK if successful, INIT_GAIN_ANALYSIS_ERROR if not */
 
 static struct ReplayGainFilter*
@@ -345,36 +467,55 @@ ReallocateWindowBuffer(uint32_t window_size, flac_float_t **window_buffer)
 }
 
 static int
-ResetSampleFrequency ( long samplefreq ) {
+ResetSampleFrequency ( GainAnalysisContext* ctx, long samplefreq ) {
     int  i;
 
-    free(replaygainfilter);
+    free(ctx->replaygainfilter);
 
-    replaygainfilter = CreateGainFilter( samplefreq );
+    ctx->replaygainfilter = CreateGainFilter( samplefreq );
 
-    if ( ! replaygainfilter)
+    if ( ! ctx->replaygainfilter)
         return INIT_GAIN_ANALYSIS_ERROR;
 
-    sampleWindow =
-        (replaygainfilter->rate * RMS_WINDOW_TIME + 1000-1) / 1000;
+    ctx->sampleWindow =
+        (ctx->replaygainfilter->rate * RMS_WINDOW_TIME + 1000-1) / 1000;
 
-    if ( ! ReallocateWindowBuffer(sampleWindow, &lstepbuf) ||
-         ! ReallocateWindowBuffer(sampleWindow, &rstepbuf) ||
-         ! ReallocateWindowBuffer(sampleWindow, &loutbuf)  ||
-         ! ReallocateWindowBuffer(sampleWindow, &routbuf) ) {
+    if ( ! ReallocateWindowBuffer(ctx->sampleWindow, &ctx->lstepbuf) ||
+         ! ReallocateWindowBuffer(ctx->sampleWindow, &ctx->rstepbuf) ||
+         ! ReallocateWindowBuffer(ctx->sampleWindow, &ctx->loutbuf)  ||
+         ! ReallocateWindowBuffer(ctx->sampleWindow, &ctx->routbuf) ) {
 
         return INIT_GAIN_ANALYSIS_ERROR;
     }
 
     /* zero out initial values */
     for ( i = 0; i < MAX_ORDER; i++ )
-        linprebuf[i] = lstepbuf[i] = loutbuf[i] = rinprebuf[i] = rstepbuf[i] = routbuf[i] = 0.;
+        ctx->linprebuf[i] = ctx->lstepbuf[i] = ctx->loutbuf[i] = ctx->rinprebuf[i] = ctx->rstepbuf[i] = ctx->routbuf[i] = 0.;
 
-    lsum         = 0.;
-    rsum         = 0.;
-    totsamp      = 0;
+    ctx->lsum         = 0.;
+    ctx->rsum         = 0.;
+    ctx->totsamp      = 0;
 
-    memset ( A, 0, sizeof(A) );
+    memset ( ctx->A, 0, sizeof(ctx->A) );
+
+    return INIT_GAIN_ANALYSIS_OK;
+}
+
+static int
+InitContext ( GainAnalysisContext* ctx, long samplefreq )
+{
+    if (ResetSampleFrequency(ctx, samplefreq) != INIT_GAIN_ANALYSIS_OK) {
+            return INIT_GAIN_ANALYSIS_ERROR;
+    }
+
+    ctx->linpre       = ctx->linprebuf + MAX_ORDER;
+    ctx->rinpre       = ctx->rinprebuf + MAX_ORDER;
+    ctx->lstep        = ctx->lstepbuf  + MAX_ORDER;
+    ctx->rstep        = ctx->rstepbuf  + MAX_ORDER;
+    ctx->lout         = ctx->loutbuf   + MAX_ORDER;
+    ctx->rout         = ctx->routbuf   + MAX_ORDER;
+
+    memset ( ctx->B, 0, sizeof(ctx->B) );
 
     return INIT_GAIN_ANALYSIS_OK;
 }
@@ -395,28 +536,48 @@ ValidGainFrequency ( long samplefreq )
 int
 InitGainAnalysis ( long samplefreq )
 {
-    if (ResetSampleFrequency(samplefreq) != INIT_GAIN_ANALYSIS_OK) {
-            return INIT_GAIN_ANALYSIS_ERROR;
-    }
+    return InitContext ( &defaultcontext, samplefreq );
+}
 
-    linpre       = linprebuf + MAX_ORDER;
-    rinpre       = rinprebuf + MAX_ORDER;
-    lstep        = lstepbuf  + MAX_ORDER;
-    rstep        = rstepbuf  + MAX_ORDER;
-    lout         = loutbuf   + MAX_ORDER;
-    rout         = routbuf   + MAX_ORDER;
+/* returns a new context, or NULL if samplefreq is not supported or memory runs out */
 
-    memset ( B, 0, sizeof(B) );
+GainAnalysisContext*
+CreateGainAnalysis ( long samplefreq )
+{
+    GainAnalysisContext* ctx = calloc(1, sizeof(*ctx));
 
-    return INIT_GAIN_ANALYSIS_OK;
+    if ( !ctx )
+        return 0;
+
+    /* a context created with 0 can only collect finished tracks for the album gain */
+    if ( samplefreq != 0 && InitContext(ctx, samplefreq) != INIT_GAIN_ANALYSIS_OK ) {
+        DeleteGainAnalysis(ctx);
+        return 0;
+    }
+
+    return ctx;
+}
+
+void
+DeleteGainAnalysis ( GainAnalysisContext* ctx )
+{
+    if ( !ctx )
+        return;
+
+    free(ctx->replaygainfilter);
+    free(ctx->lstepbuf);
+    free(ctx->rstepbuf);
+    free(ctx->loutbuf);
+    free(ctx->routbuf);
+    free(ctx);
 }
 
 /* returns GAIN_ANALYSIS_OK if successful, GAIN_ANALYSIS_ERROR if not */
 
 int
-AnalyzeSamples ( const flac_float_t* left_samples, const flac_float_t* right_samples, size_t num_samples, int num_channels )
+AnalyzeSamplesContext ( GainAnalysisContext* ctx, const flac_float_t* left_samples, const flac_float_t* right_samples, size_t num_samples, int num_channels )
 {
-    uint32_t        downsample = replaygainfilter->downsample;
+    uint32_t        downsample;
     const flac_float_t*  curleft;
     const flac_float_t*  curright;
     long            prebufsamples;
@@ -425,6 +586,10 @@ AnalyzeSamples ( const flac_float_t* left_samples, const flac_float_t* right_sam
     long            cursamplepos;
     int             i;
 
+    if ( ! ctx->replaygainfilter )
+        return GAIN_ANALYSIS_ERROR;
+
+    downsample = ctx->replaygainfilter->downsample;
     num_samples /= downsample;
 
     if ( num_samples == 0 )
@@ -444,80 +609,78 @@ AnalyzeSamples ( const flac_float_t* left_samples, const flac_float_t* right_sam
         prebufsamples = num_samples;
 
     for ( i = 0; i < prebufsamples; ++i ) {
-        linprebuf[i+MAX_ORDER] = left_samples [i * downsample];
-        rinprebuf[i+MAX_ORDER] = right_samples[i * downsample];
+        ctx->linprebuf[i+MAX_ORDER] = left_samples [i * downsample];
+        ctx->rinprebuf[i+MAX_ORDER] = right_samples[i * downsample];
     }
 
     while ( batchsamples > 0 ) {
-        cursamples = batchsamples > (long)(sampleWindow-totsamp)  ?  (long)(sampleWindow - totsamp)  :  batchsamples;
+        cursamples = batchsamples > (long)(ctx->sampleWindow-ctx->totsamp)  ?  (long)(ctx->sampleWindow - ctx->totsamp)  :  batchsamples;
         if ( cursamplepos < MAX_ORDER ) {
             downsample = 1;
-            curleft  = linpre+cursamplepos;
-            curright = rinpre+cursamplepos;
+            curleft  = ctx->linpre+cursamplepos;
+            curright = ctx->rinpre+cursamplepos;
             if (cursamples > MAX_ORDER - cursamplepos )
                 cursamples = MAX_ORDER - cursamplepos;
         }
         else {
-            downsample = replaygainfilter->downsample;
+            downsample = ctx->replaygainfilter->downsample;
             curleft  = left_samples  + cursamplepos * downsample;
             curright = right_samples + cursamplepos * downsample;
         }
 
-        filter ( curleft , lstep + totsamp, cursamples, replaygainfilter->AYule, replaygainfilter->BYule, YULE_ORDER, downsample );
-        filter ( curright, rstep + totsamp, cursamples, replaygainfilter->AYule, replaygainfilter->BYule, YULE_ORDER, downsample );
-
-        filter ( lstep + totsamp, lout + totsamp, cursamples, replaygainfilter->AButter, replaygainfilter->BButter, BUTTER_ORDER, 1 );
-        filter ( rstep + totsamp, rout + totsamp, cursamples, replaygainfilter->AButter, replaygainfilter->BButter, BUTTER_ORDER, 1 );
-
-        for ( i = 0; i < cursamples; i++ ) {             /* Get the squared values */
-            lsum += lout [totsamp+i] * lout [totsamp+i];
-            rsum += rout [totsamp+i] * rout [totsamp+i];
-        }
+        /* also gets the squared values */
+        filter_stereo ( curleft, curright, ctx->lstep + ctx->totsamp, ctx->rstep + ctx->totsamp, ctx->lout + ctx->totsamp, ctx->rout + ctx->totsamp, cursamples, ctx->replaygainfilter, downsample, &ctx->lsum, &ctx->rsum );
 
         batchsamples -= cursamples;
         cursamplepos += cursamples;
-        totsamp      += cursamples;
-        if ( totsamp == sampleWindow ) {  /* Get the Root Mean Square (RMS) for this set of samples */
-            double  val  = STEPS_per_dB * 10. * log10 ( (lsum+rsum) / totsamp * 0.5 + 1.e-37 );
+        ctx->totsamp += cursamples;
+        if ( ctx->totsamp == ctx->sampleWindow ) {  /* Get the Root Mean Square (RMS) for this set of samples */
+            double  val  = STEPS_per_dB * 10. * log10 ( (ctx->lsum+ctx->rsum) / ctx->totsamp * 0.5 + 1.e-37 );
             int     ival = (int) val;
             if ( ival <                     0 ) ival = 0;
-            if ( ival >= (int)(sizeof(A)/sizeof(*A)) ) ival = (int)(sizeof(A)/sizeof(*A)) - 1;
-            A [ival]++;
-            lsum = rsum = 0.;
-            memmove ( loutbuf , loutbuf  + totsamp, MAX_ORDER * sizeof(flac_float_t) );
-            memmove ( routbuf , routbuf  + totsamp, MAX_ORDER * sizeof(flac_float_t) );
-            memmove ( lstepbuf, lstepbuf + totsamp, MAX_ORDER * sizeof(flac_float_t) );
-            memmove ( rstepbuf, rstepbuf + totsamp, MAX_ORDER * sizeof(flac_float_t) );
-            totsamp = 0;
+            if ( ival >= (int)(sizeof(ctx->A)/sizeof(*ctx->A)) ) ival = (int)(sizeof(ctx->A)/sizeof(*ctx->A)) - 1;
+            ctx->A [ival]++;
+            ctx->lsum = ctx->rsum = 0.;
+            memmove ( ctx->loutbuf , ctx->loutbuf  + ctx->totsamp, MAX_ORDER * sizeof(flac_float_t) );
+            memmove ( ctx->routbuf , ctx->routbuf  + ctx->totsamp, MAX_ORDER * sizeof(flac_float_t) );
+            memmove ( ctx->lstepbuf, ctx->lstepbuf + ctx->totsamp, MAX_ORDER * sizeof(flac_float_t) );
+            memmove ( ctx->rstepbuf, ctx->rstepbuf + ctx->totsamp, MAX_ORDER * sizeof(flac_float_t) );
+            ctx->totsamp = 0;
         }
-        if ( totsamp > sampleWindow )   /* somehow I really screwed up: Error in programming! Contact author about totsamp > sampleWindow */
+        if ( ctx->totsamp > ctx->sampleWindow )   /* somehow I really screwed up: Error in programming! Contact author about totsamp > sampleWindow */
             return GAIN_ANALYSIS_ERROR;
     }
 
     if ( num_samples < MAX_ORDER ) {
-        memmove ( linprebuf,                           linprebuf + num_samples, (MAX_ORDER-num_samples) * sizeof(flac_float_t) );
-        memmove ( rinprebuf,                           rinprebuf + num_samples, (MAX_ORDER-num_samples) * sizeof(flac_float_t) );
-        memcpy  ( linprebuf + MAX_ORDER - num_samples, left_samples,          num_samples             * sizeof(flac_float_t) );
-        memcpy  ( rinprebuf + MAX_ORDER - num_samples, right_samples,         num_samples             * sizeof(flac_float_t) );
+        memmove ( ctx->linprebuf,                           ctx->linprebuf + num_samples, (MAX_ORDER-num_samples) * sizeof(flac_float_t) );
+        memmove ( ctx->rinprebuf,                           ctx->rinprebuf + num_samples, (MAX_ORDER-num_samples) * sizeof(flac_float_t) );
+        memcpy  ( ctx->linprebuf + MAX_ORDER - num_samples, left_samples,          num_samples             * sizeof(flac_float_t) );
+        memcpy  ( ctx->rinprebuf + MAX_ORDER - num_samples, right_samples,         num_samples             * sizeof(flac_float_t) );
     }
     else {
-        downsample = replaygainfilter->downsample;
+        downsample = ctx->replaygainfilter->downsample;
 
         left_samples  += (num_samples - MAX_ORDER) * downsample;
         right_samples += (num_samples - MAX_ORDER) * downsample;
 
         for ( i = 0; i < MAX_ORDER; ++i ) {
-            linprebuf[i] = left_samples [i * downsample];
-            rinprebuf[i] = right_samples[i * downsample];
+            ctx->linprebuf[i] = left_samples [i * downsample];
+            ctx->rinprebuf[i] = right_samples[i * downsample];
         }
     }
 
     return GAIN_ANALYSIS_OK;
 }
 
+int
+AnalyzeSamples ( const flac_float_t* left_samples, const flac_float_t* right_samples, size_t num_samples, int num_channels )
+{
+    return AnalyzeSamplesContext ( &defaultcontext, left_samples, right_samples, num_samples, num_channels );
+}
+
 
 static flac_float_t
-analyzeResult ( uint32_t* Array, size_t len )
+analyzeResult ( const uint32_t* Array, size_t len )
 {
     uint32_t  elems;
     int32_t   upper;
@@ -545,31 +708,56 @@ analyzeResult ( uint32_t* Array, size_t len )
 
 
 flac_float_t
-GetTitleGain ( void )
+GetTitleGainContext ( GainAnalysisContext* ctx )
 {
     flac_float_t  retval;
     uint32_t      i;
 
-    retval = analyzeResult ( A, sizeof(A)/sizeof(*A) );
+    retval = analyzeResult ( ctx->A, sizeof(ctx->A)/sizeof(*ctx->A) );
 
-    for ( i = 0; i < sizeof(A)/sizeof(*A); i++ ) {
-        B[i] += A[i];
-        A[i]  = 0;
+    for ( i = 0; i < sizeof(ctx->A)/sizeof(*ctx->A); i++ ) {
+        ctx->B[i] += ctx->A[i];
+        ctx->A[i]  = 0;
     }
 
-    for ( i = 0; i < MAX_ORDER; i++ )
-        linprebuf[i] = lstepbuf[i] = loutbuf[i] = rinprebuf[i] = rstepbuf[i] = routbuf[i] = 0.f;
+    if ( ctx->replaygainfilter ) {
+        for ( i = 0; i < MAX_ORDER; i++ )
+            ctx->linprebuf[i] = ctx->lstepbuf[i] = ctx->loutbuf[i] = ctx->rinprebuf[i] = ctx->rstepbuf[i] = ctx->routbuf[i] = 0.f;
+    }
 
-    totsamp = 0;
-    lsum    = rsum = 0.;
+    ctx->totsamp = 0;
+    ctx->lsum    = ctx->rsum = 0.;
     return retval;
 }
 
+flac_float_t
+GetTitleGain ( void )
+{
+    return GetTitleGainContext ( &defaultcontext );
+}
+
+
+/* adds the titles finished with GetTitleGainContext() on 'track' to the album of 'album' */
+
+void
+MergeIntoAlbumContext ( GainAnalysisContext* album, const GainAnalysisContext* track )
+{
+    uint32_t  i;
+
+    for ( i = 0; i < sizeof(album->B)/sizeof(*album->B); i++ )
+        album->B[i] += track->B[i];
+}
+
+flac_float_t
+GetAlbumGainContext ( const GainAnalysisContext* ctx )
+{
+    return analyzeResult ( ctx->B, sizeof(ctx->B)/sizeof(*ctx->B) );
+}
 
 flac_float_t
 GetAlbumGain ( void )
 {
-    return analyzeResult ( B, sizeof(B)/sizeof(*B) );
+    return GetAlbumGainContext ( &defaultcontext );
 }
 
 /* end of replaygain_analysis.c */
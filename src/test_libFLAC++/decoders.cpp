@@ -45,14 +45,16 @@ typedef enum {
 	LAYER_STREAM = 0, /* FLAC__stream_decoder_init_stream() without seeking */
 	LAYER_SEEKABLE_STREAM, /* FLAC__stream_decoder_init_stream() with seeking */
 	LAYER_FILE, /* FLAC__stream_decoder_init_FILE() */
-	LAYER_FILENAME /* FLAC__stream_decoder_init_file() */
+	LAYER_FILENAME, /* FLAC__stream_decoder_init_file() */
+	LAYER_MMAP /* FLAC__stream_decoder_init_mmap() */
 } Layer;
 
 static const char * const LayerString[] = {
 	"Stream",
 	"Seekable Stream",
 	"FILE*",
-	"Filename"
+	"Filename",
+	"Filename (mmap)"
 };
 
 static ::FLAC__StreamMetadata streaminfo_, padding_, seektable_, application1_, application2_, vorbiscomment_, cuesheet_, picture_, unknown_;
@@ -325,6 +327,8 @@ void StreamDecoder::error_callback(::FLAC__StreamDecoderErrorStatus status)
 bool StreamDecoder::test_respond(bool is_ogg, bool is_chained_ogg)
 {
 	::FLAC__StreamDecoderInitStatus init_status;
+	::FLAC__StreamDecoderProfile profile;
+	uint32_t i;
 
 	if(!set_md5_checking(true)) {
 		printf("FAILED at set_md5_checking(), returned false\n");
@@ -374,6 +378,18 @@ bool StreamDecoder::test_respond(bool is_ogg, bool is_chained_ogg)
 	}
 	printf("OK\n");
 
+	printf("testing get_profile()... ");
+	if(get_profile(&profile)) {
+		if(profile.calls[FLAC__STREAM_DECODER_PROFILE_HEADER] == 0)
+			return die_s_("returned no counts for a decoded stream", this);
+	}
+	else {
+		for(i = 0; i < FLAC__STREAM_DECODER_PROFILE_NUM_STAGES; i++)
+			if(profile.calls[i] != 0)
+				return die_s_("returned false but did not clear the counters", this);
+	}
+	printf("OK\n");
+
 	return true;
 }
 
@@ -441,6 +457,10 @@ bool FileDecoder::test_respond(bool is_ogg, bool is_chained_ogg)
 			printf("testing init%s()... ", is_ogg? "_ogg":"");
 			init_status = is_ogg? init_ogg(flacfilename(is_ogg, is_chained_ogg)) : init(flacfilename(is_ogg, is_chained_ogg));
 			break;
+		case LAYER_MMAP:
+			printf("testing init%s_mmap()... ", is_ogg? "_ogg":"");
+			init_status = is_ogg? init_ogg_mmap(flacfilename(is_ogg, is_chained_ogg)) : init_mmap(flacfilename(is_ogg, is_chained_ogg));
+			break;
 		default:
 			die_("internal error 001");
 			return false;
@@ -560,6 +580,11 @@ static bool test_stream_decoder(Layer layer, bool is_ogg, bool is_chained_ogg)
 				dynamic_cast<FLAC::Decoder::File*>(decoder)->init_ogg(flacfilename(is_ogg, is_chained_ogg)) :
 				dynamic_cast<FLAC::Decoder::File*>(decoder)->init(flacfilename(is_ogg, is_chained_ogg));
 			break;
+		case LAYER_MMAP:
+			init_status = is_ogg?
+				dynamic_cast<FLAC::Decoder::File*>(decoder)->init_ogg_mmap(flacfilename(is_ogg, is_chained_ogg)) :
+				dynamic_cast<FLAC::Decoder::File*>(decoder)->init_mmap(flacfilename(is_ogg, is_chained_ogg));
+			break;
 		default:
 			die_("internal error 006");
 			delete decoder;
@@ -650,6 +675,12 @@ static bool test_stream_decoder(Layer layer, bool is_ogg, bool is_chained_ogg)
 				dynamic_cast<FLAC::Decoder::File*>(decoder)->init_ogg(flacfilename(is_ogg, is_chained_ogg)) :
 				dynamic_cast<FLAC::Decoder::File*>(decoder)->init(flacfilename(is_ogg, is_chained_ogg));
 			break;
+		case LAYER_MMAP:
+			printf("testing init%s_mmap()... ", is_ogg? "_ogg":"");
+			init_status = is_ogg?
+				dynamic_cast<FLAC::Decoder::File*>(decoder)->init_ogg_mmap(flacfilename(is_ogg, is_chained_ogg)) :
+				dynamic_cast<FLAC::Decoder::File*>(decoder)->init_mmap(flacfilename(is_ogg, is_chained_ogg));
+			break;
 		default:
 			die_("internal error 009");
 			return false;
@@ -1301,6 +1332,93 @@ static bool test_stream_decoder(Layer layer, bool is_ogg, bool is_chained_ogg)
 	return true;
 }
 
+class PullDecoder : public FLAC::Decoder::File {
+public:
+	PullDecoder(): FLAC::Decoder::File(), error_occurred_(false) { }
+	~PullDecoder() { }
+
+	bool error_occurred_;
+
+	// from FLAC::Decoder::Stream
+	::FLAC__StreamDecoderWriteStatus write_callback(const ::FLAC__Frame *frame, const FLAC__int32 * const buffer[])
+	{
+		(void)frame;
+		(void)buffer;
+		printf("ERROR: write callback called in pull mode\n");
+		return ::FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+	void error_callback(::FLAC__StreamDecoderErrorStatus status)
+	{
+		printf("ERROR: got error callback: err = %u (%s)\n", (unsigned)status, ::FLAC__StreamDecoderErrorStatusString[status]);
+		error_occurred_ = true;
+	}
+};
+
+static bool test_file_decoder_pull()
+{
+	FLAC__int16 buffer[1000 * FLAC__MAX_CHANNELS];
+	uint32_t n, total = 0;
+
+	printf("\n+++ libFLAC++ unit test: FLAC::Decoder::File (pull mode, format: FLAC)\n\n");
+
+	printf("allocating decoder instance... ");
+	PullDecoder *decoder = new PullDecoder();
+	if(0 == decoder) {
+		printf("FAILED, new returned NULL\n");
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing set_pull_mode()... ");
+	if(!decoder->set_pull_mode(true))
+		return die_s_("returned false", decoder);
+	if(!decoder->get_pull_mode())
+		return die_s_("get_pull_mode() returned wrong value", decoder);
+	printf("OK\n");
+
+	printf("testing set_md5_checking()... ");
+	if(!decoder->set_md5_checking(true))
+		return die_s_("returned false", decoder);
+	printf("OK\n");
+
+	printf("testing init()... ");
+	if(decoder->init(flacfilename(/*is_ogg=*/false, /*is_chained_ogg=*/false)) != ::FLAC__STREAM_DECODER_INIT_STATUS_OK)
+		return die_s_(0, decoder);
+	printf("OK\n");
+
+	printf("testing read_samples()... ");
+	while((n = decoder->read_samples(::FLAC__STREAM_DECODER_PCM_FORMAT_S16LE, buffer, 1000)) > 0)
+		total += n;
+	if(decoder->get_state() != ::FLAC__STREAM_DECODER_END_OF_STREAM || decoder->error_occurred_)
+		return die_s_("did not read up to the end of the stream", decoder);
+	if(total != 512 * 1024) {
+		printf("FAILED, read %u samples, expected %u\n", total, 512 * 1024);
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing seek_absolute() and read_samples()... ");
+	if(!decoder->seek_absolute(512 * 1024 - 300))
+		return die_s_("returned false", decoder);
+	if((n = decoder->read_samples(::FLAC__STREAM_DECODER_PCM_FORMAT_S16LE, buffer, 1000)) != 300) {
+		printf("FAILED, read %u samples, expected 300\n", n);
+		return false;
+	}
+	printf("OK\n");
+
+	printf("testing finish()... ");
+	decoder->finish();
+	printf("OK\n");
+
+	printf("freeing decoder instance... ");
+	delete decoder;
+	printf("OK\n");
+
+	printf("\nPASSED!\n");
+
+	return true;
+}
+
 bool test_decoders()
 {
 	FLAC__bool is_ogg = false;
@@ -1324,6 +1442,12 @@ bool test_decoders()
 		if(!test_stream_decoder(LAYER_FILENAME, is_ogg, is_chained_ogg))
 			return false;
 
+		if(!test_stream_decoder(LAYER_MMAP, is_ogg, is_chained_ogg))
+			return false;
+
+		if(!is_ogg && !test_file_decoder_pull())
+			return false;
+
 		(void) grabbag__file_remove_file(flacfilename(is_ogg, is_chained_ogg));
 
 		free_metadata_blocks_();
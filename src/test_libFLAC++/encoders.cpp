@@ -197,6 +197,7 @@ static bool test_stream_encoder(Layer layer, bool is_ogg)
 {
 	FLAC::Encoder::Stream *encoder;
 	::FLAC__StreamEncoderInitStatus init_status;
+	::FLAC__StreamEncoderProfile profile;
 	FILE *file = 0;
 	FLAC__int32 samples[1024];
 	FLAC__int32 *samples_array[1] = { samples };
@@ -532,6 +533,18 @@ static bool test_stream_encoder(Layer layer, bool is_ogg)
 	}
 	printf("OK\n");
 
+	printf("testing get_profile()... ");
+	if(encoder->get_profile(&profile)) {
+		if(profile.calls[FLAC__STREAM_ENCODER_PROFILE_BITWRITING] == 0)
+			return die_s_("returned no counts for an encoded stream", encoder);
+	}
+	else {
+		for(i = 0; i < FLAC__STREAM_ENCODER_PROFILE_NUM_STAGES; i++)
+			if(profile.calls[i] != 0)
+				return die_s_("returned false but did not clear the counters", encoder);
+	}
+	printf("OK\n");
+
 	if(layer < LAYER_FILE)
 		::fclose(dynamic_cast<StreamEncoder*>(encoder)->file_);
 
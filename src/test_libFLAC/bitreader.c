@@ -24,8 +24,11 @@
 #include "FLAC/assert.h"
 #include "share/compat.h"
 #include "private/bitreader.h" /* from the libFLAC private include area */
+#include "private/bitwriter.h" /* from the libFLAC private include area */
+#include "private/cpu.h" /* from the libFLAC private include area */
 #include "bitreader.h"
 #include <stdio.h>
+#include <stdlib.h> /* for malloc() */
 #include <string.h> /* for memcpy() */
 
 /*
@@ -98,6 +101,108 @@ static void FLAC__bitreader_dump(const FLAC__BitReader *br, FILE *out)
 	}
 }
 
+typedef FLAC__bool (*read_rice_signed_block_fn)(FLAC__BitReader *br, int vals[], uint32_t nvals, uint32_t parameter);
+
+typedef struct {
+	const FLAC__byte *data;
+	size_t bytes, position;
+} rice_stream;
+
+static FLAC__bool rice_read_callback(FLAC__byte buffer[], size_t *bytes, void *data)
+{
+	rice_stream *stream = (rice_stream *)data;
+
+	/* an odd chunk size, so the buffer tail lands anywhere within a residual */
+	if(*bytes > 1021)
+		*bytes = 1021;
+	if(*bytes > stream->bytes - stream->position)
+		*bytes = stream->bytes - stream->position;
+	memcpy(buffer, stream->data + stream->position, *bytes);
+	stream->position += *bytes;
+
+	return *bytes > 0;
+}
+
+static FLAC__bool test_read_rice_signed_block(const char *name, read_rice_signed_block_fn read_rice_signed_block)
+{
+	enum { BLOCKSIZE = 4096, BLOCKS = 16 };
+	FLAC__BitWriter *bw;
+	FLAC__BitReader *br;
+	FLAC__int32 *vals;
+	int *decoded;
+	const FLAC__byte *buffer;
+	rice_stream stream;
+	uint32_t parameter, block, i;
+	FLAC__uint32 seed = 12345, dummy;
+	FLAC__bool ok = true;
+
+	printf("testing read_rice_signed_block (%s)... ", name);
+
+	vals = malloc(sizeof(FLAC__int32) * BLOCKSIZE * BLOCKS);
+	decoded = malloc(sizeof(int) * BLOCKSIZE);
+	if(0 == vals || 0 == decoded) {
+		printf("FAILED, malloc\n");
+		free(vals);
+		free(decoded);
+		return false;
+	}
+
+	for(parameter = 0; parameter <= 20 && ok; parameter++) {
+		const FLAC__int32 range = 3 << parameter;
+
+		for(i = 0; i < BLOCKSIZE * BLOCKS; i++) {
+			seed = seed * 1103515245 + 12345;
+			vals[i] = (FLAC__int32)((seed >> 8) % (2 * range + 1)) - range;
+			/* now and then a residual with a unary part longer than a word */
+			if(i % 1000 == 999)
+				vals[i] = (i & 1)? 150 << parameter : -(150 << parameter);
+		}
+
+		if(0 == (bw = FLAC__bitwriter_new()))
+			break;
+		/* start off at an odd bit position */
+		ok = FLAC__bitwriter_init(bw) && FLAC__bitwriter_write_raw_uint32(bw, 1, 3);
+		for(block = 0; block < BLOCKS && ok; block++)
+			ok = FLAC__bitwriter_write_rice_signed_block(bw, vals + block * BLOCKSIZE, BLOCKSIZE, parameter);
+		ok = ok && FLAC__bitwriter_zero_pad_to_byte_boundary(bw) && FLAC__bitwriter_get_buffer(bw, &buffer, &stream.bytes);
+		if(!ok) {
+			printf("FAILED, writing residuals with parameter %u\n", parameter);
+			FLAC__bitwriter_delete(bw);
+			break;
+		}
+		stream.data = buffer;
+		stream.position = 0;
+
+		br = FLAC__bitreader_new();
+		ok = 0 != br && FLAC__bitreader_init(br, rice_read_callback, &stream) && FLAC__bitreader_read_raw_uint32(br, &dummy, 3);
+		if(!ok)
+			printf("FAILED, bitreader\n");
+		for(block = 0; block < BLOCKS && ok; block++) {
+			if(!read_rice_signed_block(br, decoded, BLOCKSIZE, parameter)) {
+				printf("FAILED, read error in block %u with parameter %u\n", block, parameter);
+				ok = false;
+			}
+			for(i = 0; i < BLOCKSIZE && ok; i++) {
+				if(decoded[i] != vals[block * BLOCKSIZE + i]) {
+					printf("FAILED, residual %u of block %u with parameter %u is %d, expected %d\n", i, block, parameter, decoded[i], vals[block * BLOCKSIZE + i]);
+					ok = false;
+				}
+			}
+		}
+
+		if(0 != br)
+			FLAC__bitreader_delete(br);
+		FLAC__bitwriter_release_buffer(bw);
+		FLAC__bitwriter_delete(bw);
+	}
+
+	free(vals);
+	free(decoded);
+	if(ok)
+		printf("OK\n");
+	return ok;
+}
+
 FLAC__bool test_bitreader(void)
 {
 	FLAC__BitReader *br;
@@ -338,6 +443,29 @@ FLAC__bool test_bitreader(void)
 	FLAC__bitreader_delete(br);
 	printf("OK\n");
 
+	{
+		FLAC__CPUInfo cpuinfo;
+		FLAC__cpu_info(&cpuinfo);
+		(void)cpuinfo;
+
+		if(!test_read_rice_signed_block("generic", FLAC__bitreader_read_rice_signed_block))
+			return false;
+#ifdef FLAC__BMI2_SUPPORTED
+		if(cpuinfo.x86.bmi2 && !test_read_rice_signed_block("bmi2", FLAC__bitreader_read_rice_signed_block_bmi2))
+			return false;
+#endif
+#if ENABLE_64_BIT_WORDS
+#if defined FLAC__AVX2_SUPPORTED && defined FLAC__BMI2_SUPPORTED
+		if(cpuinfo.x86.avx2 && cpuinfo.x86.bmi2 && !test_read_rice_signed_block("avx2", FLAC__bitreader_read_rice_signed_block_avx2))
+			return false;
+#endif
+#if defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN
+		if(!test_read_rice_signed_block("neon", FLAC__bitreader_read_rice_signed_block_neon))
+			return false;
+#endif
+#endif
+	}
+
 	printf("\nPASSED!\n");
 	return true;
 }
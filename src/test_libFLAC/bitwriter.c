@@ -24,8 +24,10 @@
 #include "FLAC/assert.h"
 #include "share/compat.h"
 #include "private/bitwriter.h" /* from the libFLAC private include area */
+#include "private/cpu.h" /* from the libFLAC private include area */
 #include "bitwriter.h"
 #include <stdio.h>
+#include <stdlib.h> /* for malloc() */
 #include <string.h> /* for memcmp() */
 
 /*
@@ -55,6 +57,9 @@ struct FLAC__BitWriter {
 	uint32_t capacity; /* capacity of buffer in words */
 	uint32_t words; /* # of complete words in buffer */
 	uint32_t bits; /* # of used bits in accum */
+	const FLAC__CRC16Functions *crc16_functions;
+	uint32_t crc16_words; /* # of words at the front of buffer that are already in crc16 */
+	FLAC__uint16 crc16; /* the running CRC of the first crc16_words words */
 };
 
 #define WORDS_TO_BITS(words) ((words) * FLAC__BITS_PER_WORD)
@@ -84,6 +89,79 @@ static void FLAC__bitwriter_dump(const FLAC__BitWriter *bw, FILE *out)
 	}
 }
 
+/* Checks that a variant of write_rice_signed_block() writes exactly what
+ * the plain version writes, for any bit position to start from and any
+ * length of the block */
+static FLAC__bool test_write_rice_signed_block(const char *name, FLAC__BitWriterWriteRiceSignedBlock write_rice_signed_block)
+{
+	enum { MAX_NVALS = 4096 };
+	FLAC__BitWriter *bw0, *bw1;
+	FLAC__int32 *vals;
+	const FLAC__byte *buffer0, *buffer1;
+	size_t bytes0, bytes1;
+	uint32_t parameter, nvals, offset, i;
+	FLAC__uint32 seed = 12345;
+	FLAC__bool ok = true;
+
+	printf("testing write_rice_signed_block (%s)... ", name);
+
+	if(0 == (vals = malloc(sizeof(FLAC__int32) * MAX_NVALS))) {
+		printf("FAILED, malloc\n");
+		return false;
+	}
+	bw0 = FLAC__bitwriter_new();
+	bw1 = FLAC__bitwriter_new();
+	if(0 == bw0 || 0 == bw1 || !FLAC__bitwriter_init(bw0) || !FLAC__bitwriter_init(bw1)) {
+		printf("FAILED, bitwriter\n");
+		ok = false;
+	}
+
+	for(parameter = 0; parameter <= 30 && ok; parameter++) {
+		const FLAC__int32 range = parameter < 24? 3 << parameter : 0x3fffffff;
+
+		for(i = 0; i < MAX_NVALS; i++) {
+			seed = seed * 1103515245 + 12345;
+			vals[i] = (FLAC__int32)((seed >> 1) % (2 * (FLAC__uint32)range + 1)) - range;
+			/* now and then a residual with a code longer than 32 bits */
+			if(i % 97 == 96 && parameter < 24)
+				vals[i] = (i & 1)? 40 << parameter : -(40 << parameter);
+		}
+
+		for(nvals = 0; nvals <= MAX_NVALS && ok; nvals = (nvals < 40? nvals + 1 : nvals * 4)) {
+			for(offset = 0; offset < 64 && ok; offset += (nvals < 40? 7 : 1)) {
+				FLAC__bitwriter_clear(bw0);
+				FLAC__bitwriter_clear(bw1);
+				ok =
+					(offset == 0 || FLAC__bitwriter_write_raw_uint64(bw0, FLAC__U64L(0x5555555555555555) >> (64 - offset), offset)) &&
+					(offset == 0 || FLAC__bitwriter_write_raw_uint64(bw1, FLAC__U64L(0x5555555555555555) >> (64 - offset), offset)) &&
+					FLAC__bitwriter_write_rice_signed_block(bw0, vals, nvals, parameter) &&
+					write_rice_signed_block(bw1, vals, nvals, parameter) &&
+					FLAC__bitwriter_zero_pad_to_byte_boundary(bw0) &&
+					FLAC__bitwriter_zero_pad_to_byte_boundary(bw1) &&
+					FLAC__bitwriter_get_buffer(bw0, &buffer0, &bytes0) &&
+					FLAC__bitwriter_get_buffer(bw1, &buffer1, &bytes1);
+				if(!ok)
+					printf("FAILED, writing %u residuals with parameter %u\n", nvals, parameter);
+				else if(bytes0 != bytes1 || memcmp(buffer0, buffer1, bytes0)) {
+					printf("FAILED, %u residuals with parameter %u at bit %u differ from the plain version\n", nvals, parameter, offset);
+					ok = false;
+				}
+				FLAC__bitwriter_release_buffer(bw0);
+				FLAC__bitwriter_release_buffer(bw1);
+			}
+		}
+	}
+
+	if(0 != bw0)
+		FLAC__bitwriter_delete(bw0);
+	if(0 != bw1)
+		FLAC__bitwriter_delete(bw1);
+	free(vals);
+	if(ok)
+		printf("OK\n");
+	return ok;
+}
+
 FLAC__bool test_bitwriter(void)
 {
 	FLAC__BitWriter *bw;
@@ -683,6 +761,19 @@ FLAC__bool test_bitwriter(void)
 	FLAC__bitwriter_delete(bw);
 	printf("OK\n");
 
+	{
+		FLAC__CPUInfo cpuinfo;
+		FLAC__cpu_info(&cpuinfo);
+		(void)cpuinfo;
+
+		if(!test_write_rice_signed_block("generic", FLAC__bitwriter_write_rice_signed_block))
+			return false;
+#if ENABLE_64_BIT_WORDS && defined FLAC__AVX2_SUPPORTED
+		if(cpuinfo.x86.avx2 && !test_write_rice_signed_block("avx2", FLAC__bitwriter_write_rice_signed_block_avx2))
+			return false;
+#endif
+	}
+
 	printf("\nPASSED!\n");
 	return true;
 }
@@ -24,6 +24,7 @@
 
 #include "FLAC/assert.h"
 #include "share/compat.h"
+#include "private/cpu.h"
 #include "private/crc.h"
 #include "crc.h"
 
@@ -35,6 +36,7 @@ static FLAC__bool test_crc16(const FLAC__byte *data, size_t size);
 static FLAC__bool test_crc16_update(const FLAC__byte *data, size_t size);
 static FLAC__bool test_crc16_32bit_words(const FLAC__uint32 *words, size_t size);
 static FLAC__bool test_crc16_64bit_words(const FLAC__uint64 *words, size_t size);
+static FLAC__bool test_crc16_functions(const FLAC__byte *data, size_t size);
 
 #define DATA_SIZE 32768
 
@@ -64,6 +66,9 @@ FLAC__bool test_crc(void)
 	if (! test_crc16_64bit_words((FLAC__uint64 *)data, DATA_SIZE / 8))
 		return false;
 
+	if (! test_crc16_functions(data, DATA_SIZE))
+		return false;
+
 	printf("\nPASSED!\n");
 	return true;
 }
@@ -272,3 +277,53 @@ static FLAC__bool test_crc16_64bit_words(const FLAC__uint64 *words, size_t size)
 
 	return true;
 }
+
+static FLAC__bool test_crc16_functions(const FLAC__byte *data, size_t size)
+{
+	const FLAC__CRC16Functions *functions[1];
+	const char *name[1];
+	uint32_t n, len, offset, count = 0;
+	FLAC__uint16 seed = 0xc0de;
+	FLAC__CPUInfo cpuinfo;
+
+	FLAC__cpu_info(&cpuinfo);
+	(void)cpuinfo;
+#ifndef FLAC__NO_ASM
+#  if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
+#    ifdef FLAC__PCLMUL_SUPPORTED
+	if (cpuinfo.use_asm && cpuinfo.x86.pclmul && cpuinfo.x86.ssse3) {
+		functions[count] = &FLAC__crc16_functions_intrin_pclmul;
+		name[count++] = "pclmul";
+	}
+#    endif
+#  endif
+#endif
+
+	for (n = 0; n < count; n++) {
+		printf("testing FLAC__crc16_functions_intrin_%s ... ", name[n]);
+		/* all lengths around the block sizes of the kernels, at every
+		 * alignment, and a few long ones, each with another initial CRC */
+		for (len = 0; len <= 4096 && len + 16 < size; len = (len < 600? len + 1 : len * 2)) {
+			for (offset = 0; offset < 16; offset++) {
+				const FLAC__uint32 *words32 = (const FLAC__uint32 *)(data + (offset & ~3u));
+				const FLAC__uint64 *words64 = (const FLAC__uint64 *)(data + (offset & ~7u));
+				seed = crc16_update_ref(data[len + offset], seed);
+				if (functions[n]->update(data + offset, len, seed) != FLAC__crc16_update(data + offset, len, seed)) {
+					printf("FAILED, update did not match FLAC__crc16_update (length=%u, offset=%u)\n", len, offset);
+					return false;
+				}
+				if (functions[n]->update_words32(words32, len / 4, seed) != FLAC__crc16_update_words32(words32, len / 4, seed)) {
+					printf("FAILED, update_words32 did not match FLAC__crc16_update_words32 (length=%u, offset=%u)\n", len / 4, offset & ~3u);
+					return false;
+				}
+				if (functions[n]->update_words64(words64, len / 8, seed) != FLAC__crc16_update_words64(words64, len / 8, seed)) {
+					printf("FAILED, update_words64 did not match FLAC__crc16_update_words64 (length=%u, offset=%u)\n", len / 8, offset & ~7u);
+					return false;
+				}
+			}
+		}
+		printf("OK\n");
+	}
+
+	return true;
+}
@@ -27,6 +27,7 @@
 #include <string.h>
 #include "decoders.h"
 #include "FLAC/assert.h"
+#include "FLAC/metadata.h"
 #include "FLAC/stream_decoder.h"
 #include "share/grabbag.h"
 #include "share/compat.h"
@@ -38,14 +39,16 @@ typedef enum {
 	LAYER_STREAM = 0, /* FLAC__stream_decoder_init_[ogg_]stream() without seeking */
 	LAYER_SEEKABLE_STREAM, /* FLAC__stream_decoder_init_[ogg_]stream() with seeking */
 	LAYER_FILE, /* FLAC__stream_decoder_init_[ogg_]FILE() */
-	LAYER_FILENAME /* FLAC__stream_decoder_init_[ogg_]file() */
+	LAYER_FILENAME, /* FLAC__stream_decoder_init_[ogg_]file() */
+	LAYER_MMAP /* FLAC__stream_decoder_init_[ogg_]mmap() */
 } Layer;
 
 static const char * const LayerString[] = {
 	"Stream",
 	"Seekable Stream",
 	"FILE*",
-	"Filename"
+	"Filename",
+	"Filename (mmap)"
 };
 
 typedef struct {
@@ -269,7 +272,8 @@ static FLAC__StreamDecoderWriteStatus stream_decoder_write_callback_(const FLAC_
 {
 	StreamDecoderClientData *dcd = (StreamDecoderClientData*)client_data;
 
-	(void)decoder, (void)buffer;
+	(void)decoder;
+	(void)buffer;
 
 	if(0 == dcd) {
 		printf("ERROR: client_data in write callback is NULL\n");
@@ -348,6 +352,8 @@ static void stream_decoder_error_callback_(const FLAC__StreamDecoder *decoder, F
 static FLAC__bool stream_decoder_test_respond_(FLAC__StreamDecoder *decoder, StreamDecoderClientData *dcd, FLAC__bool is_ogg, FLAC__bool is_chained_ogg)
 {
 	FLAC__StreamDecoderInitStatus init_status;
+	FLAC__StreamDecoderProfile profile;
+	uint32_t i;
 
 	if(!FLAC__stream_decoder_set_md5_checking(decoder, true))
 		return die_s_("at FLAC__stream_decoder_set_md5_checking(), returned false", decoder);
@@ -396,6 +402,12 @@ static FLAC__bool stream_decoder_test_respond_(FLAC__StreamDecoder *decoder, Str
 				FLAC__stream_decoder_init_ogg_file(decoder, flacfilename(is_ogg,is_chained_ogg), stream_decoder_write_callback_, stream_decoder_metadata_callback_, stream_decoder_error_callback_, dcd) :
 				FLAC__stream_decoder_init_file(decoder, flacfilename(is_ogg,is_chained_ogg), stream_decoder_write_callback_, stream_decoder_metadata_callback_, stream_decoder_error_callback_, dcd);
 			break;
+		case LAYER_MMAP:
+			printf("testing FLAC__stream_decoder_init_%smmap()... ", is_ogg? "ogg_":"");
+			init_status = is_ogg?
+				FLAC__stream_decoder_init_ogg_mmap(decoder, flacfilename(is_ogg,is_chained_ogg), stream_decoder_write_callback_, stream_decoder_metadata_callback_, stream_decoder_error_callback_, dcd) :
+				FLAC__stream_decoder_init_mmap(decoder, flacfilename(is_ogg,is_chained_ogg), stream_decoder_write_callback_, stream_decoder_metadata_callback_, stream_decoder_error_callback_, dcd);
+			break;
 		default:
 			die_("internal error 000");
 			return false;
@@ -473,6 +485,18 @@ static FLAC__bool stream_decoder_test_respond_(FLAC__StreamDecoder *decoder, Str
 		return die_s_("returned false", decoder);
 	printf("OK\n");
 
+	printf("testing FLAC__stream_decoder_get_profile()... ");
+	if(FLAC__stream_decoder_get_profile(decoder, &profile)) {
+		if(profile.calls[FLAC__STREAM_DECODER_PROFILE_HEADER] == 0)
+			return die_s_("returned no counts for a decoded stream", decoder);
+	}
+	else {
+		for(i = 0; i < FLAC__STREAM_DECODER_PROFILE_NUM_STAGES; i++)
+			if(profile.nanoseconds[i] != 0 || profile.calls[i] != 0)
+				return die_s_("returned false but did not clear the counters", decoder);
+	}
+	printf("OK\n");
+
 	return true;
 }
 
@@ -555,6 +579,12 @@ static FLAC__bool test_stream_decoder(Layer layer, FLAC__bool is_ogg, FLAC__bool
 				FLAC__stream_decoder_init_ogg_file(decoder, flacfilename(is_ogg,is_chained_ogg), stream_decoder_write_callback_, stream_decoder_metadata_callback_, stream_decoder_error_callback_, &decoder_client_data) :
 				FLAC__stream_decoder_init_file(decoder, flacfilename(is_ogg,is_chained_ogg), stream_decoder_write_callback_, stream_decoder_metadata_callback_, stream_decoder_error_callback_, &decoder_client_data);
 			break;
+		case LAYER_MMAP:
+			printf("testing FLAC__stream_decoder_init_%smmap()... ", is_ogg? "ogg_":"");
+			init_status = is_ogg?
+				FLAC__stream_decoder_init_ogg_mmap(decoder, flacfilename(is_ogg,is_chained_ogg), stream_decoder_write_callback_, stream_decoder_metadata_callback_, stream_decoder_error_callback_, &decoder_client_data) :
+				FLAC__stream_decoder_init_mmap(decoder, flacfilename(is_ogg,is_chained_ogg), stream_decoder_write_callback_, stream_decoder_metadata_callback_, stream_decoder_error_callback_, &decoder_client_data);
+			break;
 		default:
 			die_("internal error 009");
 			return false;
@@ -626,6 +656,12 @@ static FLAC__bool test_stream_decoder(Layer layer, FLAC__bool is_ogg, FLAC__bool
 				FLAC__stream_decoder_init_ogg_file(decoder, flacfilename(is_ogg,is_chained_ogg), 0, 0, 0, 0) :
 				FLAC__stream_decoder_init_file(decoder, flacfilename(is_ogg,is_chained_ogg), 0, 0, 0, 0);
 			break;
+		case LAYER_MMAP:
+			printf("testing FLAC__stream_decoder_init_%smmap()... ", is_ogg? "ogg_":"");
+			init_status = is_ogg?
+				FLAC__stream_decoder_init_ogg_mmap(decoder, flacfilename(is_ogg,is_chained_ogg), 0, 0, 0, 0) :
+				FLAC__stream_decoder_init_mmap(decoder, flacfilename(is_ogg,is_chained_ogg), 0, 0, 0, 0);
+			break;
 		default:
 			die_("internal error 003");
 			return false;
@@ -703,6 +739,12 @@ static FLAC__bool test_stream_decoder(Layer layer, FLAC__bool is_ogg, FLAC__bool
 				FLAC__stream_decoder_init_ogg_file(decoder, flacfilename(is_ogg,is_chained_ogg), stream_decoder_write_callback_, stream_decoder_metadata_callback_, stream_decoder_error_callback_, &decoder_client_data) :
 				FLAC__stream_decoder_init_file(decoder, flacfilename(is_ogg,is_chained_ogg), stream_decoder_write_callback_, stream_decoder_metadata_callback_, stream_decoder_error_callback_, &decoder_client_data);
 			break;
+		case LAYER_MMAP:
+			printf("testing FLAC__stream_decoder_init_%smmap()... ", is_ogg? "ogg_":"");
+			init_status = is_ogg?
+				FLAC__stream_decoder_init_ogg_mmap(decoder, flacfilename(is_ogg,is_chained_ogg), stream_decoder_write_callback_, stream_decoder_metadata_callback_, stream_decoder_error_callback_, &decoder_client_data) :
+				FLAC__stream_decoder_init_mmap(decoder, flacfilename(is_ogg,is_chained_ogg), stream_decoder_write_callback_, stream_decoder_metadata_callback_, stream_decoder_error_callback_, &decoder_client_data);
+			break;
 		default:
 			die_("internal error 009");
 			return false;
@@ -1435,6 +1477,717 @@ static FLAC__bool test_stream_decoder(Layer layer, FLAC__bool is_ogg, FLAC__bool
 	return true;
 }
 
+typedef struct {
+	FLAC__uint64 checksum;
+	uint32_t frames;
+	FLAC__bool error_occurred;
+} ThreadedDecoderClientData;
+
+static FLAC__StreamDecoderWriteStatus threaded_decoder_write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
+{
+	ThreadedDecoderClientData *tdcd = (ThreadedDecoderClientData*)client_data;
+	uint32_t channel, i;
+
+	(void)decoder;
+
+	for(channel = 0; channel < frame->header.channels; channel++)
+		for(i = 0; i < frame->header.blocksize; i++)
+			tdcd->checksum = tdcd->checksum * 31 + (FLAC__uint32)buffer[channel][i];
+	tdcd->frames++;
+
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void threaded_decoder_error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+	ThreadedDecoderClientData *tdcd = (ThreadedDecoderClientData*)client_data;
+
+	(void)decoder;
+
+	printf("ERROR: got error callback: err = %u (%s)\n", (uint32_t)status, FLAC__StreamDecoderErrorStatusString[status]);
+	tdcd->error_occurred = true;
+}
+
+static FLAC__bool decode_with_threads_(uint32_t num_threads, FLAC__bool frame_by_frame, ThreadedDecoderClientData *tdcd)
+{
+	FLAC__StreamDecoder *decoder;
+	uint32_t retval;
+
+	tdcd->checksum = 0;
+	tdcd->frames = 0;
+	tdcd->error_occurred = false;
+
+	printf("testing decoding with %u thread(s)%s... ", num_threads, frame_by_frame? " frame by frame" : "");
+	decoder = FLAC__stream_decoder_new();
+	if(0 == decoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	if(!FLAC__stream_decoder_set_md5_checking(decoder, true))
+		return die_s_("at FLAC__stream_decoder_set_md5_checking(), returned false", decoder);
+	retval = FLAC__stream_decoder_set_num_threads(decoder, num_threads);
+	if(retval != FLAC__STREAM_DECODER_SET_NUM_THREADS_OK && retval != FLAC__STREAM_DECODER_SET_NUM_THREADS_NOT_COMPILED_WITH_MULTITHREADING_ENABLED)
+		return die_s_("at FLAC__stream_decoder_set_num_threads(), returned an error", decoder);
+	if(FLAC__stream_decoder_init_file(decoder, flacfilename(/*is_ogg=*/false, /*is_chained_ogg=*/false), threaded_decoder_write_callback_, /*metadata_callback=*/0, threaded_decoder_error_callback_, tdcd) != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+		return die_s_("at FLAC__stream_decoder_init_file()", decoder);
+	if(frame_by_frame) {
+		while(FLAC__stream_decoder_get_state(decoder) != FLAC__STREAM_DECODER_END_OF_STREAM) {
+			if(!FLAC__stream_decoder_process_single(decoder))
+				return die_s_("at FLAC__stream_decoder_process_single(), returned false", decoder);
+		}
+	}
+	else if(!FLAC__stream_decoder_process_until_end_of_stream(decoder))
+		return die_s_("at FLAC__stream_decoder_process_until_end_of_stream(), returned false", decoder);
+	if(FLAC__stream_decoder_get_state(decoder) != FLAC__STREAM_DECODER_END_OF_STREAM)
+		return die_s_("at FLAC__stream_decoder_process_until_end_of_stream(), did not reach end of stream", decoder);
+	if(tdcd->error_occurred)
+		return die_s_("got error callback", decoder);
+	if(!FLAC__stream_decoder_finish(decoder))
+		return die_s_("at FLAC__stream_decoder_finish(), MD5 mismatch", decoder);
+	FLAC__stream_decoder_delete(decoder);
+	printf("OK, %u frames\n", tdcd->frames);
+
+	return true;
+}
+
+static FLAC__bool compare_threaded_decoding_(const ThreadedDecoderClientData *single, const ThreadedDecoderClientData *threaded)
+{
+	printf("comparing with single-threaded decoding... ");
+	if(threaded->frames != single->frames || threaded->checksum != single->checksum) {
+		printf("FAILED, got %u frames, expected %u\n", threaded->frames, single->frames);
+		return false;
+	}
+	printf("OK\n");
+	return true;
+}
+
+static FLAC__bool test_stream_decoder_threads(void)
+{
+	FLAC__StreamDecoder *decoder;
+	ThreadedDecoderClientData single, threaded;
+	uint32_t num_threads;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamDecoder (multithreaded, format: FLAC)\n\n");
+
+	printf("testing FLAC__stream_decoder_set_num_threads()... ");
+	decoder = FLAC__stream_decoder_new();
+	if(0 == decoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	if(FLAC__stream_decoder_set_num_threads(decoder, 4) == FLAC__STREAM_DECODER_SET_NUM_THREADS_OK) {
+		if(FLAC__stream_decoder_get_num_threads(decoder) != 4)
+			return die_s_("FLAC__stream_decoder_get_num_threads() returned wrong value", decoder);
+		if(FLAC__stream_decoder_set_num_threads(decoder, 1024) != FLAC__STREAM_DECODER_SET_NUM_THREADS_TOO_MANY_THREADS)
+			return die_s_("did not reject too many threads", decoder);
+	}
+	else if(FLAC__stream_decoder_get_num_threads(decoder) != 1)
+		return die_s_("FLAC__stream_decoder_get_num_threads() returned wrong value", decoder);
+	FLAC__stream_decoder_delete(decoder);
+	printf("OK\n");
+
+	if(!decode_with_threads_(1, /*frame_by_frame=*/false, &single))
+		return false;
+
+	for(num_threads = 2; num_threads <= 8; num_threads *= 2) {
+		if(!decode_with_threads_(num_threads, /*frame_by_frame=*/false, &threaded))
+			return false;
+		if(!compare_threaded_decoding_(&single, &threaded))
+			return false;
+	}
+
+	/* only the MD5 sum is calculated in a separate thread here */
+	if(!decode_with_threads_(2, /*frame_by_frame=*/true, &threaded))
+		return false;
+	if(!compare_threaded_decoding_(&single, &threaded))
+		return false;
+
+	printf("\nPASSED!\n");
+
+	return true;
+}
+
+static FLAC__bool decode_with_prefetch_(uint32_t num_buffers, uint32_t num_threads, FLAC__uint64 seek_target, ThreadedDecoderClientData *tdcd)
+{
+	FLAC__StreamDecoder *decoder;
+
+	tdcd->checksum = 0;
+	tdcd->frames = 0;
+	tdcd->error_occurred = false;
+
+	printf("testing decoding with %u prefetch buffer(s) and %u thread(s)", num_buffers, num_threads);
+	if(seek_target > 0)
+		printf(" from sample %" PRIu64, seek_target);
+	printf("... ");
+	decoder = FLAC__stream_decoder_new();
+	if(0 == decoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	if(!FLAC__stream_decoder_set_prefetch_buffers(decoder, num_buffers))
+		return die_s_("at FLAC__stream_decoder_set_prefetch_buffers(), returned false", decoder);
+	if(FLAC__stream_decoder_set_num_threads(decoder, num_threads) > FLAC__STREAM_DECODER_SET_NUM_THREADS_NOT_COMPILED_WITH_MULTITHREADING_ENABLED)
+		return die_s_("at FLAC__stream_decoder_set_num_threads(), returned an error", decoder);
+	if(FLAC__stream_decoder_init_file(decoder, flacfilename(/*is_ogg=*/false, /*is_chained_ogg=*/false), threaded_decoder_write_callback_, /*metadata_callback=*/0, threaded_decoder_error_callback_, tdcd) != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+		return die_s_("at FLAC__stream_decoder_init_file()", decoder);
+	if(seek_target > 0) {
+		if(!FLAC__stream_decoder_process_until_end_of_metadata(decoder))
+			return die_s_("at FLAC__stream_decoder_process_until_end_of_metadata(), returned false", decoder);
+		if(!FLAC__stream_decoder_seek_absolute(decoder, seek_target))
+			return die_s_("at FLAC__stream_decoder_seek_absolute(), returned false", decoder);
+	}
+	if(!FLAC__stream_decoder_process_until_end_of_stream(decoder))
+		return die_s_("at FLAC__stream_decoder_process_until_end_of_stream(), returned false", decoder);
+	if(FLAC__stream_decoder_get_state(decoder) != FLAC__STREAM_DECODER_END_OF_STREAM)
+		return die_s_("at FLAC__stream_decoder_process_until_end_of_stream(), did not reach end of stream", decoder);
+	if(tdcd->error_occurred)
+		return die_s_("got error callback", decoder);
+	FLAC__stream_decoder_finish(decoder);
+	FLAC__stream_decoder_delete(decoder);
+	printf("OK, %u frames\n", tdcd->frames);
+
+	return true;
+}
+
+static FLAC__bool test_stream_decoder_prefetch(void)
+{
+	static const FLAC__uint64 seek_targets[] = { 0, 1, 100000, 524287 };
+	FLAC__StreamDecoder *decoder;
+	ThreadedDecoderClientData direct, prefetched;
+	uint32_t i, num_buffers;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamDecoder (prefetch, format: FLAC)\n\n");
+
+	printf("testing FLAC__stream_decoder_set_prefetch_buffers()... ");
+	decoder = FLAC__stream_decoder_new();
+	if(0 == decoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	if(FLAC__stream_decoder_get_prefetch_buffers(decoder) != 0)
+		return die_s_("FLAC__stream_decoder_get_prefetch_buffers() returned wrong default", decoder);
+	if(!FLAC__stream_decoder_set_prefetch_buffers(decoder, 3) || FLAC__stream_decoder_get_prefetch_buffers(decoder) != 3)
+		return die_s_("FLAC__stream_decoder_get_prefetch_buffers() returned wrong value", decoder);
+	if(FLAC__stream_decoder_set_prefetch_buffers(decoder, 1024))
+		return die_s_("did not reject too many buffers", decoder);
+	FLAC__stream_decoder_delete(decoder);
+	printf("OK\n");
+
+	for(i = 0; i < sizeof(seek_targets)/sizeof(seek_targets[0]); i++) {
+		if(!decode_with_prefetch_(0, 1, seek_targets[i], &direct))
+			return false;
+		for(num_buffers = 2; num_buffers <= 3; num_buffers++) {
+			if(!decode_with_prefetch_(num_buffers, 1, seek_targets[i], &prefetched))
+				return false;
+			if(!compare_threaded_decoding_(&direct, &prefetched))
+				return false;
+		}
+		if(!decode_with_prefetch_(2, 4, seek_targets[i], &prefetched))
+			return false;
+		if(!compare_threaded_decoding_(&direct, &prefetched))
+			return false;
+	}
+
+	printf("\nPASSED!\n");
+
+	return true;
+}
+
+typedef struct {
+	FLAC__StreamDecoderPCMFormat format;
+	FLAC__byte *pcm;
+	uint32_t frames;
+	FLAC__bool mismatch;
+	FLAC__bool error_occurred;
+} InterleavedDecoderClientData;
+
+static FLAC__StreamDecoderWriteStatus interleaved_decoder_write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
+{
+	InterleavedDecoderClientData *idcd = (InterleavedDecoderClientData*)client_data;
+	const uint32_t channels = frame->header.channels;
+	const float scale = (float)(1.0 / (double)((FLAC__uint64)1 << (frame->header.bits_per_sample - 1)));
+	uint32_t channel, i;
+
+	(void)decoder;
+
+	for(i = 0; i < frame->header.blocksize; i++) {
+		for(channel = 0; channel < channels; channel++) {
+			const size_t n = (size_t)i * channels + channel;
+			const FLAC__byte *p;
+			FLAC__int32 x;
+			switch(idcd->format) {
+				case FLAC__STREAM_DECODER_PCM_FORMAT_S16LE:
+					p = idcd->pcm + n * 2;
+					x = (FLAC__int16)(p[0] | (p[1] << 8));
+					break;
+				case FLAC__STREAM_DECODER_PCM_FORMAT_S24LE:
+					p = idcd->pcm + n * 3;
+					x = (FLAC__int32)((FLAC__uint32)p[0] << 8 | (FLAC__uint32)p[1] << 16 | (FLAC__uint32)p[2] << 24) >> 8;
+					break;
+				case FLAC__STREAM_DECODER_PCM_FORMAT_S32LE:
+					p = idcd->pcm + n * 4;
+					x = (FLAC__int32)((FLAC__uint32)p[0] | (FLAC__uint32)p[1] << 8 | (FLAC__uint32)p[2] << 16 | (FLAC__uint32)p[3] << 24);
+					break;
+				default:
+					if(((const float *)idcd->pcm)[n] != (float)buffer[channel][i] * scale)
+						idcd->mismatch = true;
+					continue;
+			}
+			if(x != buffer[channel][i])
+				idcd->mismatch = true;
+		}
+	}
+	idcd->frames++;
+
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void interleaved_decoder_error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+	InterleavedDecoderClientData *idcd = (InterleavedDecoderClientData*)client_data;
+
+	(void)decoder;
+
+	printf("ERROR: got error callback: err = %u (%s)\n", (uint32_t)status, FLAC__StreamDecoderErrorStatusString[status]);
+	idcd->error_occurred = true;
+}
+
+static FLAC__bool test_stream_decoder_interleaved_output(void)
+{
+	FLAC__StreamDecoder *decoder;
+	InterleavedDecoderClientData idcd;
+	const size_t pcm_size = (size_t)FLAC__MAX_BLOCK_SIZE * FLAC__MAX_CHANNELS * 4;
+	FLAC__int32 *pcm;
+	uint32_t format;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamDecoder (interleaved output, format: FLAC)\n\n");
+
+	if(0 == (pcm = malloc(pcm_size)))
+		return die_("out of memory");
+
+	printf("testing FLAC__stream_decoder_set_interleaved_output()... ");
+	decoder = FLAC__stream_decoder_new();
+	if(0 == decoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	if(FLAC__stream_decoder_set_interleaved_output(decoder, (FLAC__StreamDecoderPCMFormat)(FLAC__STREAM_DECODER_PCM_FORMAT_FLOAT+1), pcm, pcm_size))
+		return die_s_("did not reject an invalid format", decoder);
+	printf("OK\n");
+
+	for(format = FLAC__STREAM_DECODER_PCM_FORMAT_S16LE; format <= FLAC__STREAM_DECODER_PCM_FORMAT_FLOAT; format++) {
+		printf("testing decoding to %s... ", FLAC__StreamDecoderPCMFormatString[format]);
+		idcd.format = (FLAC__StreamDecoderPCMFormat)format;
+		idcd.pcm = (FLAC__byte *)pcm;
+		idcd.frames = 0;
+		idcd.mismatch = false;
+		idcd.error_occurred = false;
+		if(!FLAC__stream_decoder_set_interleaved_output(decoder, idcd.format, pcm, pcm_size))
+			return die_s_("at FLAC__stream_decoder_set_interleaved_output(), returned false", decoder);
+		if(FLAC__stream_decoder_init_file(decoder, flacfilename(/*is_ogg=*/false, /*is_chained_ogg=*/false), interleaved_decoder_write_callback_, /*metadata_callback=*/0, interleaved_decoder_error_callback_, &idcd) != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+			return die_s_("at FLAC__stream_decoder_init_file()", decoder);
+		if(!FLAC__stream_decoder_process_until_end_of_stream(decoder))
+			return die_s_("at FLAC__stream_decoder_process_until_end_of_stream(), returned false", decoder);
+		if(idcd.error_occurred)
+			return die_s_("got error callback", decoder);
+		if(idcd.mismatch)
+			return die_s_("interleaved output does not match the decoded samples", decoder);
+		if(!FLAC__stream_decoder_finish(decoder))
+			return die_s_("at FLAC__stream_decoder_finish(), returned false", decoder);
+		printf("OK, %u frames\n", idcd.frames);
+	}
+
+	printf("testing decoding to a buffer that is too small... ");
+	idcd.format = FLAC__STREAM_DECODER_PCM_FORMAT_S32LE;
+	idcd.frames = 0;
+	idcd.error_occurred = false;
+	if(!FLAC__stream_decoder_set_interleaved_output(decoder, idcd.format, pcm, 4))
+		return die_s_("at FLAC__stream_decoder_set_interleaved_output(), returned false", decoder);
+	if(FLAC__stream_decoder_init_file(decoder, flacfilename(/*is_ogg=*/false, /*is_chained_ogg=*/false), interleaved_decoder_write_callback_, /*metadata_callback=*/0, interleaved_decoder_error_callback_, &idcd) != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+		return die_s_("at FLAC__stream_decoder_init_file()", decoder);
+	if(FLAC__stream_decoder_process_until_end_of_stream(decoder))
+		return die_s_("at FLAC__stream_decoder_process_until_end_of_stream(), did not abort", decoder);
+	if(FLAC__stream_decoder_get_state(decoder) != FLAC__STREAM_DECODER_ABORTED || idcd.frames != 0)
+		return die_s_("decoder was not aborted before the write callback", decoder);
+	FLAC__stream_decoder_finish(decoder);
+	printf("OK\n");
+
+	FLAC__stream_decoder_delete(decoder);
+	free(pcm);
+
+	printf("\nPASSED!\n");
+
+	return true;
+}
+
+typedef struct {
+	FLAC__int32 *frame; /* interleaved output of the current frame */
+	FLAC__int32 *reference; /* interleaved output of the whole stream */
+	uint32_t channels;
+	uint32_t samples; /* per channel, in reference */
+	FLAC__bool error_occurred;
+} PullDecoderClientData;
+
+static FLAC__StreamDecoderWriteStatus pull_reference_write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
+{
+	PullDecoderClientData *pdcd = (PullDecoderClientData*)client_data;
+
+	(void)decoder;
+	(void)buffer;
+
+	if(frame->header.channels != pdcd->channels || pdcd->samples + frame->header.blocksize > samples_) {
+		printf("ERROR: unexpected frame\n");
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+	memcpy(pdcd->reference + (size_t)pdcd->samples * pdcd->channels, pdcd->frame, (size_t)frame->header.blocksize * pdcd->channels * sizeof(FLAC__int32));
+	pdcd->samples += frame->header.blocksize;
+
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void pull_decoder_error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+	PullDecoderClientData *pdcd = (PullDecoderClientData*)client_data;
+
+	(void)decoder;
+
+	printf("ERROR: got error callback: err = %u (%s)\n", (uint32_t)status, FLAC__StreamDecoderErrorStatusString[status]);
+	pdcd->error_occurred = true;
+}
+
+static FLAC__bool init_pull_decoder_(FLAC__StreamDecoder *decoder, PullDecoderClientData *pdcd)
+{
+	if(!FLAC__stream_decoder_set_md5_checking(decoder, true))
+		return die_s_("at FLAC__stream_decoder_set_md5_checking(), returned false", decoder);
+	if(!FLAC__stream_decoder_set_pull_mode(decoder, true))
+		return die_s_("at FLAC__stream_decoder_set_pull_mode(), returned false", decoder);
+	if(!FLAC__stream_decoder_get_pull_mode(decoder))
+		return die_s_("FLAC__stream_decoder_get_pull_mode() returned wrong value", decoder);
+	if(FLAC__stream_decoder_init_file(decoder, flacfilename(/*is_ogg=*/false, /*is_chained_ogg=*/false), /*write_callback=*/0, /*metadata_callback=*/0, pull_decoder_error_callback_, pdcd) != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+		return die_s_("at FLAC__stream_decoder_init_file()", decoder);
+	return true;
+}
+
+static FLAC__bool test_stream_decoder_pull(void)
+{
+	static const uint32_t chunk_sizes[] = { 1, 37, 576, 577, 1000, 4096 };
+	static const FLAC__uint64 seek_targets[] = { 0, 1, 575, 576, 5000, 100000 };
+	FLAC__StreamDecoder *decoder;
+	PullDecoderClientData pdcd;
+	FLAC__int32 *buffer;
+	uint32_t total, n, i;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamDecoder (pull mode, format: FLAC)\n\n");
+
+	pdcd.channels = streaminfo_.data.stream_info.channels;
+	pdcd.samples = 0;
+	pdcd.error_occurred = false;
+	pdcd.frame = malloc(sizeof(FLAC__int32) * FLAC__MAX_BLOCK_SIZE * pdcd.channels);
+	pdcd.reference = malloc(sizeof(FLAC__int32) * samples_ * pdcd.channels);
+	buffer = malloc(sizeof(FLAC__int32) * 4096 * pdcd.channels);
+	if(0 == pdcd.frame || 0 == pdcd.reference || 0 == buffer)
+		return die_("out of memory");
+
+	printf("decoding reference output... ");
+	decoder = FLAC__stream_decoder_new();
+	if(0 == decoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	if(!FLAC__stream_decoder_set_interleaved_output(decoder, FLAC__STREAM_DECODER_PCM_FORMAT_S32LE, pdcd.frame, sizeof(FLAC__int32) * FLAC__MAX_BLOCK_SIZE * pdcd.channels))
+		return die_s_("at FLAC__stream_decoder_set_interleaved_output(), returned false", decoder);
+	if(FLAC__stream_decoder_init_file(decoder, flacfilename(/*is_ogg=*/false, /*is_chained_ogg=*/false), pull_reference_write_callback_, /*metadata_callback=*/0, pull_decoder_error_callback_, &pdcd) != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+		return die_s_("at FLAC__stream_decoder_init_file()", decoder);
+	if(!FLAC__stream_decoder_process_until_end_of_stream(decoder) || pdcd.error_occurred)
+		return die_s_("at FLAC__stream_decoder_process_until_end_of_stream()", decoder);
+	FLAC__stream_decoder_finish(decoder);
+	printf("OK, %u samples\n", pdcd.samples);
+
+	printf("testing FLAC__stream_decoder_init_file() without write callback... ");
+	if(FLAC__stream_decoder_init_file(decoder, flacfilename(/*is_ogg=*/false, /*is_chained_ogg=*/false), /*write_callback=*/0, /*metadata_callback=*/0, pull_decoder_error_callback_, &pdcd) != FLAC__STREAM_DECODER_INIT_STATUS_INVALID_CALLBACKS)
+		return die_s_("did not return FLAC__STREAM_DECODER_INIT_STATUS_INVALID_CALLBACKS", decoder);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_decoder_read_samples()... ");
+	if(!init_pull_decoder_(decoder, &pdcd))
+		return false;
+	total = 0;
+	for(i = 0; ; i++) {
+		const uint32_t chunk = chunk_sizes[i % (sizeof(chunk_sizes)/sizeof(chunk_sizes[0]))];
+		n = FLAC__stream_decoder_read_samples(decoder, FLAC__STREAM_DECODER_PCM_FORMAT_S32LE, buffer, chunk);
+		if(n > chunk || total + n > pdcd.samples)
+			return die_s_("returned too many samples", decoder);
+		if(memcmp(buffer, pdcd.reference + (size_t)total * pdcd.channels, sizeof(FLAC__int32) * n * pdcd.channels))
+			return die_s_("samples do not match the reference output", decoder);
+		total += n;
+		if(n < chunk)
+			break;
+	}
+	if(total != pdcd.samples || FLAC__stream_decoder_get_state(decoder) != FLAC__STREAM_DECODER_END_OF_STREAM)
+		return die_s_("did not read up to the end of the stream", decoder);
+	if(pdcd.error_occurred)
+		return die_s_("got error callback", decoder);
+	if(!FLAC__stream_decoder_finish(decoder))
+		return die_s_("at FLAC__stream_decoder_finish(), MD5 mismatch", decoder);
+	printf("OK\n");
+
+	if(!init_pull_decoder_(decoder, &pdcd))
+		return false;
+	for(i = 0; i < sizeof(seek_targets)/sizeof(seek_targets[0]); i++) {
+		const uint32_t target = (uint32_t)seek_targets[i];
+		const uint32_t expected = pdcd.samples - target < 1000? pdcd.samples - target : 1000;
+		printf("testing FLAC__stream_decoder_seek_absolute() to %u and reading 1000 samples... ", target);
+		if(!FLAC__stream_decoder_seek_absolute(decoder, target))
+			return die_s_("at FLAC__stream_decoder_seek_absolute(), returned false", decoder);
+		n = FLAC__stream_decoder_read_samples(decoder, FLAC__STREAM_DECODER_PCM_FORMAT_S32LE, buffer, 1000);
+		if(n != expected)
+			return die_s_("returned wrong number of samples", decoder);
+		if(memcmp(buffer, pdcd.reference + (size_t)target * pdcd.channels, sizeof(FLAC__int32) * n * pdcd.channels))
+			return die_s_("samples do not match the reference output", decoder);
+		printf("OK\n");
+	}
+	FLAC__stream_decoder_finish(decoder);
+
+	FLAC__stream_decoder_delete(decoder);
+	free(pdcd.frame);
+	free(pdcd.reference);
+	free(buffer);
+
+	printf("\nPASSED!\n");
+
+	return true;
+}
+
+typedef struct {
+	FILE *file;
+	uint32_t seeks;
+	uint32_t frames;
+	FLAC__uint64 last_sample_number; /* of the last frame passed to the write callback */
+	FLAC__bool error_occurred;
+} FrameIndexDecoderClientData;
+
+static FLAC__StreamDecoderReadStatus frame_index_read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
+{
+	FrameIndexDecoderClientData *fdcd = (FrameIndexDecoderClientData*)client_data;
+
+	(void)decoder;
+
+	*bytes = fread(buffer, 1, *bytes, fdcd->file);
+	if(ferror(fdcd->file))
+		return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+	return *bytes == 0? FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM : FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+static FLAC__StreamDecoderSeekStatus frame_index_seek_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data)
+{
+	FrameIndexDecoderClientData *fdcd = (FrameIndexDecoderClientData*)client_data;
+
+	(void)decoder;
+
+	fdcd->seeks++;
+	if(fseeko(fdcd->file, (FLAC__off_t)absolute_byte_offset, SEEK_SET) < 0)
+		return FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+	return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
+}
+
+static FLAC__StreamDecoderTellStatus frame_index_tell_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data)
+{
+	FrameIndexDecoderClientData *fdcd = (FrameIndexDecoderClientData*)client_data;
+	FLAC__off_t pos;
+
+	(void)decoder;
+
+	if((pos = ftello(fdcd->file)) < 0)
+		return FLAC__STREAM_DECODER_TELL_STATUS_ERROR;
+	*absolute_byte_offset = (FLAC__uint64)pos;
+	return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+}
+
+static FLAC__StreamDecoderLengthStatus frame_index_length_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data)
+{
+	(void)decoder;
+	(void)client_data;
+
+	*stream_length = (FLAC__uint64)flacfilesize_;
+	return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+}
+
+static FLAC__bool frame_index_eof_callback_(const FLAC__StreamDecoder *decoder, void *client_data)
+{
+	FrameIndexDecoderClientData *fdcd = (FrameIndexDecoderClientData*)client_data;
+
+	(void)decoder;
+
+	return feof(fdcd->file)? true : false;
+}
+
+static FLAC__StreamDecoderWriteStatus frame_index_write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
+{
+	FrameIndexDecoderClientData *fdcd = (FrameIndexDecoderClientData*)client_data;
+
+	(void)decoder;
+	(void)buffer;
+
+	fdcd->frames++;
+	fdcd->last_sample_number = frame->header.number.sample_number;
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void frame_index_error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+	FrameIndexDecoderClientData *fdcd = (FrameIndexDecoderClientData*)client_data;
+
+	(void)decoder;
+
+	printf("ERROR: got error callback: err = %u (%s)\n", (uint32_t)status, FLAC__StreamDecoderErrorStatusString[status]);
+	fdcd->error_occurred = true;
+}
+
+static FLAC__StreamDecoder *init_frame_index_decoder_(FrameIndexDecoderClientData *fdcd, uint32_t num_threads, FLAC__bool build_frame_index, const char *sidecar)
+{
+	FLAC__StreamDecoder *decoder;
+
+	fdcd->seeks = 0;
+	fdcd->frames = 0;
+	fdcd->error_occurred = false;
+	if(0 == (fdcd->file = flac_fopen(flacfilename(/*is_ogg=*/false, /*is_chained_ogg=*/false), "rb"))) {
+		printf("FAILED, could not open file\n");
+		return 0;
+	}
+	if(0 == (decoder = FLAC__stream_decoder_new())) {
+		printf("FAILED, returned NULL\n");
+		return 0;
+	}
+	if(FLAC__stream_decoder_set_num_threads(decoder, num_threads) > FLAC__STREAM_DECODER_SET_NUM_THREADS_NOT_COMPILED_WITH_MULTITHREADING_ENABLED) {
+		die_s_("at FLAC__stream_decoder_set_num_threads(), returned an error", decoder);
+		return 0;
+	}
+	if(!FLAC__stream_decoder_set_build_frame_index(decoder, build_frame_index) || FLAC__stream_decoder_get_build_frame_index(decoder) != build_frame_index) {
+		die_s_("at FLAC__stream_decoder_set_build_frame_index()", decoder);
+		return 0;
+	}
+	if(0 != sidecar && !FLAC__stream_decoder_load_frame_index(decoder, sidecar)) {
+		die_s_("at FLAC__stream_decoder_load_frame_index(), returned false", decoder);
+		return 0;
+	}
+	if(FLAC__stream_decoder_init_stream(decoder, frame_index_read_callback_, frame_index_seek_callback_, frame_index_tell_callback_, frame_index_length_callback_, frame_index_eof_callback_, frame_index_write_callback_, /*metadata_callback=*/0, frame_index_error_callback_, fdcd) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+		die_s_("at FLAC__stream_decoder_init_stream()", decoder);
+		return 0;
+	}
+	return decoder;
+}
+
+static FLAC__bool test_stream_decoder_frame_index(void)
+{
+	static const char *sidecar = "decoders.fidx";
+	static const FLAC__uint64 seek_targets[] = { 1, 575, 576, 5000, 100000, 524287, 0 };
+	FLAC__StreamDecoder *decoder;
+	FrameIndexDecoderClientData fdcd;
+	FLAC__StreamMetadata *frame_index;
+	const FLAC__StreamMetadata *threaded_index;
+	FLAC__uint64 next_sample = 0;
+	uint32_t i;
+	FILE *f;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamDecoder (frame index, format: FLAC)\n\n");
+
+	printf("testing FLAC__stream_decoder_set_build_frame_index()... ");
+	if(0 == (decoder = init_frame_index_decoder_(&fdcd, 1, /*build_frame_index=*/true, /*sidecar=*/0)))
+		return false;
+	if(!FLAC__stream_decoder_process_until_end_of_stream(decoder) || fdcd.error_occurred)
+		return die_s_("at FLAC__stream_decoder_process_until_end_of_stream()", decoder);
+	if(0 == FLAC__stream_decoder_get_frame_index(decoder))
+		return die_s_("FLAC__stream_decoder_get_frame_index() returned NULL", decoder);
+	if(0 == (frame_index = FLAC__metadata_object_clone(FLAC__stream_decoder_get_frame_index(decoder))))
+		return die_("out of memory");
+	if(frame_index->data.seek_table.num_points != fdcd.frames)
+		return die_s_("frame index does not have a point for every frame", decoder);
+	for(i = 0; i < frame_index->data.seek_table.num_points; i++) {
+		const FLAC__StreamMetadata_SeekPoint *point = &frame_index->data.seek_table.points[i];
+		if(point->sample_number != next_sample || (i == 0 && point->stream_offset != 0) || (i > 0 && point->stream_offset <= point[-1].stream_offset))
+			return die_s_("frame index has a wrong point", decoder);
+		next_sample += point->frame_samples;
+	}
+	if(next_sample != samples_)
+		return die_s_("frame index does not cover the stream", decoder);
+	if(!FLAC__stream_decoder_save_frame_index(decoder, sidecar))
+		return die_s_("at FLAC__stream_decoder_save_frame_index(), returned false", decoder);
+	FLAC__stream_decoder_finish(decoder);
+	FLAC__stream_decoder_delete(decoder);
+	fclose(fdcd.file);
+	printf("OK, %u points\n", frame_index->data.seek_table.num_points);
+
+	printf("testing building the frame index with 4 threads... ");
+	if(0 == (decoder = init_frame_index_decoder_(&fdcd, 4, /*build_frame_index=*/true, /*sidecar=*/0)))
+		return false;
+	if(!FLAC__stream_decoder_process_until_end_of_stream(decoder) || fdcd.error_occurred)
+		return die_s_("at FLAC__stream_decoder_process_until_end_of_stream()", decoder);
+	if(0 == (threaded_index = FLAC__stream_decoder_get_frame_index(decoder)) || !FLAC__metadata_object_is_equal(threaded_index, frame_index))
+		return die_s_("frame index differs from the one built in a single thread", decoder);
+	FLAC__stream_decoder_finish(decoder);
+	FLAC__stream_decoder_delete(decoder);
+	fclose(fdcd.file);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_decoder_load_frame_index()... ");
+	if(0 == (decoder = init_frame_index_decoder_(&fdcd, 1, /*build_frame_index=*/false, sidecar)))
+		return false;
+	if(!FLAC__stream_decoder_process_until_end_of_metadata(decoder))
+		return die_s_("at FLAC__stream_decoder_process_until_end_of_metadata()", decoder);
+	if(0 == FLAC__stream_decoder_get_frame_index(decoder) || !FLAC__metadata_object_is_equal(FLAC__stream_decoder_get_frame_index(decoder), frame_index))
+		return die_s_("loaded frame index differs from the saved one", decoder);
+	printf("OK\n");
+
+	for(i = 0; i < sizeof(seek_targets)/sizeof(seek_targets[0]); i++) {
+		printf("testing FLAC__stream_decoder_seek_absolute() to %" PRIu64 " with frame index... ", seek_targets[i]);
+		fdcd.seeks = 0;
+		fdcd.frames = 0;
+		if(!FLAC__stream_decoder_seek_absolute(decoder, seek_targets[i]))
+			return die_s_("at FLAC__stream_decoder_seek_absolute(), returned false", decoder);
+		if(fdcd.frames != 1 || fdcd.last_sample_number != seek_targets[i])
+			return die_s_("did not land on the target sample", decoder);
+		if(fdcd.seeks != 1) {
+			printf("FAILED, needed %u seeks\n", fdcd.seeks);
+			return false;
+		}
+		printf("OK\n");
+	}
+	FLAC__stream_decoder_finish(decoder);
+	FLAC__stream_decoder_delete(decoder);
+	fclose(fdcd.file);
+
+	printf("testing FLAC__stream_decoder_load_frame_index() with a corrupt file... ");
+	if(0 == (f = flac_fopen(sidecar, "r+b")) || fputc('x', f) == EOF || fclose(f) != 0)
+		return die_("modifying the sidecar file");
+	if(0 == (decoder = init_frame_index_decoder_(&fdcd, 1, /*build_frame_index=*/false, /*sidecar=*/0)))
+		return false;
+	if(FLAC__stream_decoder_load_frame_index(decoder, sidecar))
+		return die_s_("corrupt frame index was accepted", decoder);
+	if(0 != FLAC__stream_decoder_get_frame_index(decoder))
+		return die_s_("corrupt frame index was not discarded", decoder);
+	printf("OK\n");
+
+	printf("testing FLAC__stream_decoder_set_frame_index()... ");
+	if(!FLAC__stream_decoder_set_frame_index(decoder, frame_index))
+		return die_s_("at FLAC__stream_decoder_set_frame_index(), returned false", decoder);
+	fdcd.seeks = 0;
+	if(!FLAC__stream_decoder_seek_absolute(decoder, 300000) || fdcd.last_sample_number != 300000 || fdcd.seeks != 1)
+		return die_s_("seek with frame index failed", decoder);
+	if(!FLAC__stream_decoder_set_frame_index(decoder, 0) || 0 != FLAC__stream_decoder_get_frame_index(decoder))
+		return die_s_("frame index was not removed", decoder);
+	FLAC__stream_decoder_finish(decoder);
+	FLAC__stream_decoder_delete(decoder);
+	fclose(fdcd.file);
+	printf("OK\n");
+
+	FLAC__metadata_object_delete(frame_index);
+	(void) grabbag__file_remove_file(sidecar);
+
+	printf("\nPASSED!\n");
+
+	return true;
+}
+
 FLAC__bool test_decoders(void)
 {
 	FLAC__bool is_ogg = false;
@@ -1459,6 +2212,24 @@ FLAC__bool test_decoders(void)
 		if(!test_stream_decoder(LAYER_FILENAME, is_ogg, is_chained_ogg))
 			return false;
 
+		if(!test_stream_decoder(LAYER_MMAP, is_ogg, is_chained_ogg))
+			return false;
+
+		if(!is_ogg && !test_stream_decoder_threads())
+			return false;
+
+		if(!is_ogg && !test_stream_decoder_interleaved_output())
+			return false;
+
+		if(!is_ogg && !test_stream_decoder_pull())
+			return false;
+
+		if(!is_ogg && !test_stream_decoder_frame_index())
+			return false;
+
+		if(!is_ogg && !test_stream_decoder_prefetch())
+			return false;
+
 		(void) grabbag__file_remove_file(flacfilename(is_ogg, is_chained_ogg));
 
 		free_metadata_blocks_();
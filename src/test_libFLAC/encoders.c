@@ -30,6 +30,7 @@
 #include "FLAC/stream_encoder.h"
 #include "share/grabbag.h"
 #include "share/compat.h"
+#include "share/private.h"
 #include "test_libs_common/file_utils_flac.h"
 #include "test_libs_common/metadata_utils.h"
 
@@ -156,6 +157,7 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 	FLAC__StreamEncoderInitStatus init_status;
 	FLAC__StreamEncoderState state;
 	FLAC__StreamDecoderState dstate;
+	FLAC__StreamEncoderProfile profile;
 	FILE *file = 0;
 	FLAC__int32 samples[1024];
 	FLAC__int32 *samples_array[1];
@@ -486,6 +488,18 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 		return die_s_("returned false", encoder);
 	printf("OK\n");
 
+	printf("testing FLAC__stream_encoder_get_profile()... ");
+	if(FLAC__stream_encoder_get_profile(encoder, &profile)) {
+		if(profile.calls[FLAC__STREAM_ENCODER_PROFILE_BITWRITING] == 0 || profile.calls[FLAC__STREAM_ENCODER_PROFILE_CRC] == 0)
+			return die_s_("returned no counts for an encoded stream", encoder);
+	}
+	else {
+		for(i = 0; i < FLAC__STREAM_ENCODER_PROFILE_NUM_STAGES; i++)
+			if(profile.nanoseconds[i] != 0 || profile.calls[i] != 0)
+				return die_s_("returned false but did not clear the counters", encoder);
+	}
+	printf("OK\n");
+
 	if(layer < LAYER_FILE)
 		fclose(file);
 
@@ -498,6 +512,725 @@ static FLAC__bool test_stream_encoder(Layer layer, FLAC__bool is_ogg)
 	return true;
 }
 
+typedef struct {
+	FLAC__uint64 bytes;
+	uint32_t frames;
+	uint32_t min_blocksize;
+	uint32_t max_blocksize;
+} VariableBlocksizeClientData;
+
+static FLAC__StreamEncoderWriteStatus variable_blocksize_write_callback_(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame, void *client_data)
+{
+	VariableBlocksizeClientData *cd = (VariableBlocksizeClientData*)client_data;
+	(void)encoder, (void)buffer, (void)current_frame;
+	cd->bytes += bytes;
+	if(samples > 0)
+		cd->frames++;
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+static void variable_blocksize_metadata_callback_(const FLAC__StreamEncoder *encoder, const FLAC__StreamMetadata *metadata, void *client_data)
+{
+	VariableBlocksizeClientData *cd = (VariableBlocksizeClientData*)client_data;
+	(void)encoder;
+	if(metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
+		cd->min_blocksize = metadata->data.stream_info.min_blocksize;
+		cd->max_blocksize = metadata->data.stream_info.max_blocksize;
+	}
+}
+
+static FLAC__bool encode_with_variable_blocksize_(const FLAC__int32 *signal, uint32_t samples, uint32_t variable_blocksize, uint32_t threads, VariableBlocksizeClientData *cd)
+{
+	FLAC__StreamEncoder *encoder;
+	uint32_t i;
+
+	memset(cd, 0, sizeof(*cd));
+
+	printf("testing encoding with variable blocksize %u, %u thread(s)... ", variable_blocksize, threads);
+
+	encoder = FLAC__stream_encoder_new();
+	if(0 == encoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	FLAC__stream_encoder_set_verify(encoder, true);
+	FLAC__stream_encoder_set_channels(encoder, 2);
+	FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+	FLAC__stream_encoder_set_sample_rate(encoder, 44100);
+	FLAC__stream_encoder_set_compression_level(encoder, 5);
+	FLAC__stream_encoder_set_blocksize(encoder, 4096);
+	FLAC__stream_encoder_set_total_samples_estimate(encoder, samples);
+	if(!FLAC__stream_encoder_set_variable_blocksize(encoder, variable_blocksize))
+		return die_s_("FLAC__stream_encoder_set_variable_blocksize() returned false", encoder);
+	if(FLAC__stream_encoder_get_variable_blocksize(encoder) != variable_blocksize)
+		return die_s_("FLAC__stream_encoder_get_variable_blocksize() returned wrong value", encoder);
+	if(FLAC__stream_encoder_set_num_threads(encoder, threads) != FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK && threads == 1)
+		return die_s_("FLAC__stream_encoder_set_num_threads() failed", encoder);
+
+	if(FLAC__stream_encoder_init_stream(encoder, variable_blocksize_write_callback_, 0, 0, variable_blocksize_metadata_callback_, cd) != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+		return die_s_("FLAC__stream_encoder_init_stream() failed", encoder);
+
+	for(i = 0; i < samples; i += 1000) {
+		const uint32_t n = samples - i < 1000? samples - i : 1000;
+		if(!FLAC__stream_encoder_process_interleaved(encoder, signal + 2 * i, n))
+			return die_s_("FLAC__stream_encoder_process_interleaved() failed", encoder);
+	}
+
+	if(!FLAC__stream_encoder_finish(encoder))
+		return die_s_("FLAC__stream_encoder_finish() failed", encoder);
+
+	FLAC__stream_encoder_delete(encoder);
+
+	printf("OK, %u frames, %" PRIu64 " bytes\n", cd->frames, cd->bytes);
+
+	return true;
+}
+
+static FLAC__bool test_stream_encoder_variable_blocksize(void)
+{
+	const uint32_t samples = 20 * 4096 + 123;
+	FLAC__StreamEncoder *encoder;
+	FLAC__int32 *signal;
+	FLAC__uint32 rand_state = 0x12345678;
+	VariableBlocksizeClientData fixed, variable;
+	uint32_t i, threads;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (variable blocksize)\n\n");
+
+	printf("testing FLAC__stream_encoder_set_variable_blocksize()... ");
+	encoder = FLAC__stream_encoder_new();
+	if(0 == encoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	if(FLAC__stream_encoder_get_variable_blocksize(encoder) != 0)
+		return die_s_("FLAC__stream_encoder_get_variable_blocksize() returned wrong default", encoder);
+	if(FLAC__stream_encoder_set_variable_blocksize(encoder, 4))
+		return die_s_("did not reject too many splits", encoder);
+	FLAC__stream_encoder_delete(encoder);
+	printf("OK\n");
+
+	/* quiet tones interrupted by short loud noise bursts, for which
+	 * splitting blocks pays off; the second channel has wasted bits, which
+	 * must survive encoding the same samples several times */
+	if(0 == (signal = malloc(sizeof(FLAC__int32) * 2 * samples)))
+		return die_("malloc failed");
+	for(i = 0; i < samples; i++) {
+		const FLAC__bool burst = (i % 5000) < 700;
+		FLAC__int32 noise;
+		rand_state = rand_state * 1103515245u + 12345u;
+		noise = (FLAC__int32)((rand_state >> 16) & 0x3fff) - 0x2000;
+		signal[2*i] = (FLAC__int32)(i % 64) - 32 + (burst? noise : 0);
+		signal[2*i+1] = ((FLAC__int32)(i % 50) - 25 + (burst? noise / 2 : 0)) * 4;
+	}
+
+	if(!encode_with_variable_blocksize_(signal, samples, 0, 1, &fixed))
+		return false;
+	if(fixed.min_blocksize != 4096 || fixed.max_blocksize != 4096)
+		return die_("fixed-blocksize stream has wrong blocksizes in STREAMINFO");
+
+	for(threads = 1; threads <= 2; threads++) {
+		if(!encode_with_variable_blocksize_(signal, samples, 2, threads, &variable))
+			return false;
+		if(variable.min_blocksize != 1024 || variable.max_blocksize != 4096)
+			return die_("variable-blocksize stream has wrong blocksizes in STREAMINFO");
+		if(variable.frames <= fixed.frames)
+			return die_("no blocks were split");
+		if(variable.bytes >= fixed.bytes)
+			return die_("variable-blocksize stream is not smaller");
+	}
+
+	free(signal);
+
+	printf("\nPASSED!\n");
+
+	return true;
+}
+
+static FLAC__bool estimate_size_(const FLAC__int32 *signal, uint32_t samples, uint32_t estimate_only, uint32_t variable_blocksize, uint32_t threads, FLAC__uint64 *bytes, FLAC__uint64 *bytes_low, FLAC__uint64 *bytes_high, uint32_t *frames_analysed)
+{
+	FLAC__StreamEncoder *encoder;
+	uint32_t i;
+
+	printf("testing estimating 1 in %u blocks with variable blocksize %u, %u thread(s)... ", estimate_only, variable_blocksize, threads);
+
+	encoder = FLAC__stream_encoder_new();
+	if(0 == encoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	FLAC__stream_encoder_set_verify(encoder, true);
+	FLAC__stream_encoder_set_channels(encoder, 2);
+	FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+	FLAC__stream_encoder_set_sample_rate(encoder, 44100);
+	FLAC__stream_encoder_set_compression_level(encoder, 5);
+	FLAC__stream_encoder_set_blocksize(encoder, 4096);
+	FLAC__stream_encoder_set_total_samples_estimate(encoder, samples);
+	FLAC__stream_encoder_set_variable_blocksize(encoder, variable_blocksize);
+	if(!FLAC__stream_encoder_set_estimate_only(encoder, estimate_only))
+		return die_s_("FLAC__stream_encoder_set_estimate_only() returned false", encoder);
+	if(FLAC__stream_encoder_get_estimate_only(encoder) != estimate_only)
+		return die_s_("FLAC__stream_encoder_get_estimate_only() returned wrong value", encoder);
+	if(FLAC__stream_encoder_set_num_threads(encoder, threads) != FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK && threads == 1)
+		return die_s_("FLAC__stream_encoder_set_num_threads() failed", encoder);
+
+	/* nothing is written, so no write callback is needed */
+	if(FLAC__stream_encoder_init_stream(encoder, 0, 0, 0, 0, 0) != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+		return die_s_("FLAC__stream_encoder_init_stream() failed", encoder);
+
+	for(i = 0; i < samples; i += 1000) {
+		const uint32_t n = samples - i < 1000? samples - i : 1000;
+		if(!FLAC__stream_encoder_process_interleaved(encoder, signal + 2 * i, n))
+			return die_s_("FLAC__stream_encoder_process_interleaved() failed", encoder);
+	}
+
+	if(!FLAC__stream_encoder_finish(encoder))
+		return die_s_("FLAC__stream_encoder_finish() failed", encoder);
+
+	/* the estimate must remain available after finishing */
+	FLAC__stream_encoder_get_estimate(encoder, bytes, bytes_low, bytes_high, frames_analysed);
+
+	FLAC__stream_encoder_delete(encoder);
+
+	printf("OK, %" PRIu64 " bytes (%" PRIu64 "-%" PRIu64 ") from %u frames\n", *bytes, *bytes_low, *bytes_high, *frames_analysed);
+
+	return true;
+}
+
+static FLAC__bool test_stream_encoder_estimate(void)
+{
+	const uint32_t samples = 40 * 4096 + 123;
+	FLAC__StreamEncoder *encoder;
+	FLAC__int32 *signal;
+	FLAC__uint32 rand_state = 0x87654321;
+	FLAC__uint64 bytes, bytes_low, bytes_high;
+	VariableBlocksizeClientData actual;
+	uint32_t i, frames_analysed, variable_blocksize, threads;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (estimate only)\n\n");
+
+	printf("testing FLAC__stream_encoder_set_estimate_only()... ");
+	encoder = FLAC__stream_encoder_new();
+	if(0 == encoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	if(FLAC__stream_encoder_get_estimate_only(encoder) != 0)
+		return die_s_("FLAC__stream_encoder_get_estimate_only() returned wrong default", encoder);
+	if(FLAC__stream_encoder_init_stream(encoder, 0, 0, 0, 0, 0) != FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_CALLBACKS)
+		return die_s_("did not reject a NULL write callback when encoding", encoder);
+	FLAC__stream_encoder_delete(encoder);
+	printf("OK\n");
+
+	/* tones with a noise level that changes from block to block, so the
+	 * frame sizes vary */
+	if(0 == (signal = malloc(sizeof(FLAC__int32) * 2 * samples)))
+		return die_("malloc failed");
+	for(i = 0; i < samples; i++) {
+		const FLAC__int32 level = 1 << ((i / 3000) % 12);
+		FLAC__int32 noise;
+		rand_state = rand_state * 1103515245u + 12345u;
+		noise = (FLAC__int32)((rand_state >> 16) & 0xffff) % level - level / 2;
+		signal[2*i] = (FLAC__int32)(i % 100) * 50 - 2500 + noise;
+		signal[2*i+1] = (FLAC__int32)(i % 77) * 40 - 1540 + noise / 2;
+	}
+
+	for(variable_blocksize = 0; variable_blocksize <= 1; variable_blocksize++) {
+		if(!encode_with_variable_blocksize_(signal, samples, variable_blocksize, 1, &actual))
+			return false;
+
+		/* when all blocks are analysed, the estimate is exact */
+		for(threads = 1; threads <= 2; threads++) {
+			if(!estimate_size_(signal, samples, 1, variable_blocksize, threads, &bytes, &bytes_low, &bytes_high, &frames_analysed))
+				return false;
+			if(bytes != actual.bytes || bytes_low != bytes || bytes_high != bytes)
+				return die_("estimate is not the actual size");
+			if(frames_analysed != 41)
+				return die_("wrong number of frames analysed");
+		}
+
+		/* frames 0, 4, ..., 40 are analysed */
+		for(threads = 1; threads <= 2; threads++) {
+			if(!estimate_size_(signal, samples, 4, variable_blocksize, threads, &bytes, &bytes_low, &bytes_high, &frames_analysed))
+				return false;
+			if(frames_analysed != 11)
+				return die_("wrong number of frames analysed");
+			if(bytes_low >= bytes || bytes_high <= bytes)
+				return die_("confidence interval is empty");
+			if(actual.bytes < bytes_low || actual.bytes > bytes_high)
+				return die_("actual size is outside of the confidence interval");
+		}
+	}
+
+	free(signal);
+
+	printf("\nPASSED!\n");
+
+	return true;
+}
+
+#define WRITE_BUFFERS_HELD 3
+
+typedef struct {
+	FLAC__StreamEncoder *encoder;
+	FLAC__byte *data;
+	size_t bytes;
+	FLAC__byte *held[WRITE_BUFFERS_HELD + 1]; /* buffers handed over but not yet written, oldest first */
+	size_t held_bytes[WRITE_BUFFERS_HELD + 1];
+	uint32_t num_held;
+	FLAC__bool error;
+} WriteBufferClientData;
+
+static FLAC__bool append_output_(WriteBufferClientData *cd, const FLAC__byte buffer[], size_t bytes)
+{
+	FLAC__byte *data = realloc(cd->data, cd->bytes + bytes);
+	if(0 == data)
+		return false;
+	memcpy(data + cd->bytes, buffer, bytes);
+	cd->data = data;
+	cd->bytes += bytes;
+	return true;
+}
+
+/* writes out and releases the oldest buffer held, the way an asynchronous writer would on completion */
+static FLAC__bool complete_write_buffer_(WriteBufferClientData *cd)
+{
+	uint32_t i;
+	if(!append_output_(cd, cd->held[0], cd->held_bytes[0]))
+		return false;
+	if(!FLAC__stream_encoder_release_buffer(cd->encoder, cd->held[0]))
+		return false;
+	for(i = 1; i < cd->num_held; i++) {
+		cd->held[i-1] = cd->held[i];
+		cd->held_bytes[i-1] = cd->held_bytes[i];
+	}
+	cd->num_held--;
+	return true;
+}
+
+static FLAC__StreamEncoderWriteStatus write_buffer_copy_callback_(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame, void *client_data)
+{
+	WriteBufferClientData *cd = (WriteBufferClientData*)client_data;
+	(void)encoder, (void)samples, (void)current_frame;
+	if(!append_output_(cd, buffer, bytes)) {
+		cd->error = true;
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+	}
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+static FLAC__StreamEncoderWriteStatus write_buffer_callback_(const FLAC__StreamEncoder *encoder, FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame, void *client_data)
+{
+	WriteBufferClientData *cd = (WriteBufferClientData*)client_data;
+	(void)encoder, (void)samples, (void)current_frame;
+	cd->held[cd->num_held] = buffer;
+	cd->held_bytes[cd->num_held] = bytes;
+	cd->num_held++;
+	/* the held buffers must not be touched by the encoder, which is
+	 * checked by only copying them out here */
+	if(cd->num_held > WRITE_BUFFERS_HELD && !complete_write_buffer_(cd)) {
+		cd->error = true;
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+	}
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+static FLAC__bool encode_to_memory_(const FLAC__int32 *signal, uint32_t samples, uint32_t variable_blocksize, uint32_t threads, FLAC__bool use_buffers, WriteBufferClientData *cd)
+{
+	FLAC__StreamEncoder *encoder;
+	FLAC__byte *buffer;
+	uint32_t i;
+
+	memset(cd, 0, sizeof(*cd));
+
+	printf("testing encoding %s with variable blocksize %u, %u thread(s)... ", use_buffers? "to handed over buffers" : "with the write callback", variable_blocksize, threads);
+
+	encoder = FLAC__stream_encoder_new();
+	if(0 == encoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	cd->encoder = encoder;
+	FLAC__stream_encoder_set_verify(encoder, true);
+	FLAC__stream_encoder_set_channels(encoder, 2);
+	FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+	FLAC__stream_encoder_set_sample_rate(encoder, 44100);
+	FLAC__stream_encoder_set_compression_level(encoder, 5);
+	FLAC__stream_encoder_set_blocksize(encoder, 4096);
+	FLAC__stream_encoder_set_total_samples_estimate(encoder, samples);
+	FLAC__stream_encoder_set_variable_blocksize(encoder, variable_blocksize);
+	if(FLAC__stream_encoder_set_num_threads(encoder, threads) != FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK && threads == 1)
+		return die_s_("FLAC__stream_encoder_set_num_threads() failed", encoder);
+	if(use_buffers && !FLAC__stream_encoder_set_write_buffer_callback(encoder, write_buffer_callback_))
+		return die_s_("FLAC__stream_encoder_set_write_buffer_callback() returned false", encoder);
+
+	/* without a seek callback, the write callback is not needed with buffers */
+	if(FLAC__stream_encoder_init_stream(encoder, use_buffers? 0 : write_buffer_copy_callback_, 0, 0, 0, cd) != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+		return die_s_("FLAC__stream_encoder_init_stream() failed", encoder);
+
+	if(FLAC__stream_encoder_set_write_buffer_callback(encoder, 0))
+		return die_s_("FLAC__stream_encoder_set_write_buffer_callback() did not return false when initialized", encoder);
+
+	for(i = 0; i < samples; i += 1000) {
+		const uint32_t n = samples - i < 1000? samples - i : 1000;
+		if(!FLAC__stream_encoder_process_interleaved(encoder, signal + 2 * i, n))
+			return die_s_("FLAC__stream_encoder_process_interleaved() failed", encoder);
+	}
+
+	if(!FLAC__stream_encoder_finish(encoder))
+		return die_s_("FLAC__stream_encoder_finish() failed", encoder);
+
+	if(cd->error)
+		return die_("writing the output failed");
+
+	/* buffers may be released after finishing */
+	buffer = cd->num_held > 0? cd->held[0] : 0;
+	while(cd->num_held > 0) {
+		if(!complete_write_buffer_(cd))
+			return die_("FLAC__stream_encoder_release_buffer() failed");
+	}
+	if(use_buffers) {
+		if(0 == buffer)
+			return die_("no buffers were handed over");
+		if(FLAC__stream_encoder_release_buffer(encoder, buffer))
+			return die_("FLAC__stream_encoder_release_buffer() did not return false for a released buffer");
+		if(FLAC__stream_encoder_release_buffer(encoder, (FLAC__byte*)signal))
+			return die_("FLAC__stream_encoder_release_buffer() did not return false for a foreign buffer");
+	}
+
+	FLAC__stream_encoder_delete(encoder);
+
+	printf("OK, %u bytes\n", (uint32_t)cd->bytes);
+
+	return true;
+}
+
+static FLAC__bool test_stream_encoder_write_buffers(void)
+{
+	const uint32_t samples = 20 * 4096 + 123;
+	FLAC__StreamEncoder *encoder;
+	FLAC__int32 *signal;
+	FLAC__uint32 rand_state = 0x2468ace0;
+	WriteBufferClientData expected, got;
+	uint32_t i, variable_blocksize, threads;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (write buffers)\n\n");
+
+	printf("testing FLAC__stream_encoder_set_write_buffer_callback()... ");
+	encoder = FLAC__stream_encoder_new();
+	if(0 == encoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	if(!FLAC__stream_encoder_set_write_buffer_callback(encoder, write_buffer_callback_))
+		return die_s_("FLAC__stream_encoder_set_write_buffer_callback() returned false", encoder);
+	if(FLAC__stream_encoder_init_stream(encoder, 0, stream_encoder_seek_callback_, stream_encoder_tell_callback_, 0, 0) != FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_CALLBACKS)
+		return die_s_("did not reject a NULL write callback with a seek callback", encoder);
+	FLAC__stream_encoder_delete(encoder);
+	printf("OK\n");
+
+	if(0 == (signal = malloc(sizeof(FLAC__int32) * 2 * samples)))
+		return die_("malloc failed");
+	for(i = 0; i < samples; i++) {
+		const FLAC__bool burst = (i % 5000) < 700;
+		FLAC__int32 noise;
+		rand_state = rand_state * 1103515245u + 12345u;
+		noise = (FLAC__int32)((rand_state >> 16) & 0x3fff) - 0x2000;
+		signal[2*i] = (FLAC__int32)(i % 64) - 32 + (burst? noise : 0);
+		signal[2*i+1] = (FLAC__int32)(i % 50) - 25 + (burst? noise / 2 : 0);
+	}
+
+	/* with a variable blocksize, several frames share a buffer */
+	for(variable_blocksize = 0; variable_blocksize <= 2; variable_blocksize += 2) {
+		if(!encode_to_memory_(signal, samples, variable_blocksize, 1, false, &expected))
+			return false;
+		for(threads = 1; threads <= 2; threads++) {
+			if(!encode_to_memory_(signal, samples, variable_blocksize, threads, true, &got))
+				return false;
+			if(got.bytes != expected.bytes || memcmp(got.data, expected.data, got.bytes) != 0)
+				return die_("output differs from the output of the write callback");
+			free(got.data);
+		}
+		free(expected.data);
+	}
+
+	free(signal);
+
+	printf("\nPASSED!\n");
+
+	return true;
+}
+
+static FLAC__bool test_stream_encoder_thread_pool(void)
+{
+	const uint32_t samples = 20 * 4096 + 123;
+	FLAC__StreamEncoder *encoder[2];
+	FLAC__ThreadPool *pool;
+	FLAC__int32 *signal;
+	WriteBufferClientData expected[2], got[2];
+	uint32_t i, e;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (thread pool)\n\n");
+
+	printf("testing FLAC__thread_pool_new()... ");
+	if(0 != FLAC__thread_pool_new(0))
+		return die_("did not return NULL for 0 threads");
+	if(0 == (pool = FLAC__thread_pool_new(2))) {
+		printf("OK, not compiled with multithreading, skipping\n");
+		printf("\nPASSED!\n");
+		return true;
+	}
+	printf("OK\n");
+
+	if(0 == (signal = malloc(sizeof(FLAC__int32) * 2 * samples)))
+		return die_("malloc failed");
+	for(i = 0; i < samples; i++) {
+		signal[2*i] = (FLAC__int32)(i % 64) - 32 + (FLAC__int32)((i * 2654435761u) >> 20 & 0xff);
+		signal[2*i+1] = (FLAC__int32)(i % 50) - 25;
+	}
+
+	/* the second instance uses a variable blocksize, so the frames the pool gets differ in size */
+	for(e = 0; e < 2; e++)
+		if(!encode_to_memory_(signal, samples, e * 2, 1, false, &expected[e]))
+			return false;
+
+	printf("testing two encoder instances sharing a pool of 2 threads... ");
+	for(e = 0; e < 2; e++) {
+		memset(&got[e], 0, sizeof(got[e]));
+		if(0 == (encoder[e] = FLAC__stream_encoder_new())) {
+			printf("FAILED, returned NULL\n");
+			return false;
+		}
+		FLAC__stream_encoder_set_verify(encoder[e], true);
+		FLAC__stream_encoder_set_channels(encoder[e], 2);
+		FLAC__stream_encoder_set_bits_per_sample(encoder[e], 16);
+		FLAC__stream_encoder_set_sample_rate(encoder[e], 44100);
+		FLAC__stream_encoder_set_compression_level(encoder[e], 5);
+		FLAC__stream_encoder_set_blocksize(encoder[e], 4096);
+		FLAC__stream_encoder_set_total_samples_estimate(encoder[e], samples);
+		FLAC__stream_encoder_set_variable_blocksize(encoder[e], e * 2);
+		if(!FLAC__stream_encoder_set_thread_pool(encoder[e], pool))
+			return die_s_("FLAC__stream_encoder_set_thread_pool() returned false", encoder[e]);
+		if(FLAC__stream_encoder_init_stream(encoder[e], write_buffer_copy_callback_, 0, 0, 0, &got[e]) != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+			return die_s_("FLAC__stream_encoder_init_stream() failed", encoder[e]);
+		if(FLAC__stream_encoder_set_thread_pool(encoder[e], 0))
+			return die_s_("FLAC__stream_encoder_set_thread_pool() did not return false when initialized", encoder[e]);
+		if(FLAC__stream_encoder_get_num_threads(encoder[e]) != 3)
+			return die_s_("the number of threads does not follow the pool", encoder[e]);
+	}
+
+	for(i = 0; i < samples; i += 1000) {
+		const uint32_t n = samples - i < 1000? samples - i : 1000;
+		for(e = 0; e < 2; e++)
+			if(!FLAC__stream_encoder_process_interleaved(encoder[e], signal + 2 * i, n))
+				return die_s_("FLAC__stream_encoder_process_interleaved() failed", encoder[e]);
+	}
+
+	for(e = 0; e < 2; e++) {
+		if(!FLAC__stream_encoder_finish(encoder[e]))
+			return die_s_("FLAC__stream_encoder_finish() failed", encoder[e]);
+		FLAC__stream_encoder_delete(encoder[e]);
+		if(got[e].error)
+			return die_("writing the output failed");
+		if(got[e].bytes != expected[e].bytes || memcmp(got[e].data, expected[e].data, got[e].bytes) != 0)
+			return die_("output differs from single-threaded output");
+		free(got[e].data);
+		free(expected[e].data);
+	}
+	printf("OK\n");
+
+	FLAC__thread_pool_delete(pool);
+	free(signal);
+
+	printf("\nPASSED!\n");
+
+	return true;
+}
+
+static FLAC__bool encode_small_blocks_(const FLAC__int32 *signal, uint32_t samples, uint32_t threads, WriteBufferClientData *cd)
+{
+	FLAC__StreamEncoder *encoder;
+	uint32_t i;
+
+	memset(cd, 0, sizeof(*cd));
+
+	printf("testing encoding blocks of 16 samples at -0, %u thread(s)... ", threads);
+
+	encoder = FLAC__stream_encoder_new();
+	if(0 == encoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	FLAC__stream_encoder_set_verify(encoder, true);
+	FLAC__stream_encoder_set_channels(encoder, 2);
+	FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+	FLAC__stream_encoder_set_sample_rate(encoder, 44100);
+	FLAC__stream_encoder_set_compression_level(encoder, 0);
+	FLAC__stream_encoder_set_blocksize(encoder, 16);
+	FLAC__stream_encoder_set_total_samples_estimate(encoder, samples);
+	if(FLAC__stream_encoder_set_num_threads(encoder, threads) != FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK && threads == 1)
+		return die_s_("FLAC__stream_encoder_set_num_threads() failed", encoder);
+
+	if(FLAC__stream_encoder_init_stream(encoder, write_buffer_copy_callback_, 0, 0, 0, cd) != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+		return die_s_("FLAC__stream_encoder_init_stream() failed", encoder);
+
+	/* a size that is not a multiple of the blocksize, so that the threads
+	 * get a varying number of blocks with every call */
+	for(i = 0; i < samples; i += 333) {
+		const uint32_t n = samples - i < 333? samples - i : 333;
+		if(!FLAC__stream_encoder_process_interleaved(encoder, signal + 2 * i, n))
+			return die_s_("FLAC__stream_encoder_process_interleaved() failed", encoder);
+	}
+
+	if(!FLAC__stream_encoder_finish(encoder))
+		return die_s_("FLAC__stream_encoder_finish() failed", encoder);
+
+	FLAC__stream_encoder_delete(encoder);
+
+	if(cd->error)
+		return die_("writing the output failed");
+
+	printf("OK, %u bytes\n", (uint32_t)cd->bytes);
+
+	return true;
+}
+
+static FLAC__bool test_stream_encoder_small_blocks(void)
+{
+	const uint32_t samples = 1000 * 16 + 5;
+	FLAC__int32 *signal;
+	WriteBufferClientData expected, got;
+	uint32_t i, threads;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (threads with small blocks)\n\n");
+
+	/* with blocks this small, the threads mostly wait on each other, which
+	 * is where handing over the threadtasks can go wrong */
+	if(0 == (signal = malloc(sizeof(FLAC__int32) * 2 * samples)))
+		return die_("malloc failed");
+	for(i = 0; i < samples; i++) {
+		signal[2*i] = (FLAC__int32)(i % 64) - 32 + (FLAC__int32)((i * 2654435761u) >> 20 & 0xff);
+		signal[2*i+1] = (FLAC__int32)(i % 50) - 25;
+	}
+
+	if(!encode_small_blocks_(signal, samples, 1, &expected))
+		return false;
+	for(threads = 2; threads <= 8; threads *= 2) {
+		if(!encode_small_blocks_(signal, samples, threads, &got))
+			return false;
+		if(got.bytes != expected.bytes || memcmp(got.data, expected.data, got.bytes) != 0)
+			return die_("output differs from single-threaded output");
+		free(got.data);
+	}
+	free(expected.data);
+
+	free(signal);
+
+	printf("\nPASSED!\n");
+
+	return true;
+}
+
+static FLAC__bool encode_with_verify_mismatch_(const FLAC__int32 *signal, uint32_t samples, uint32_t threads, FLAC__uint64 mismatch_sample)
+{
+	FLAC__StreamEncoder *encoder;
+	FLAC__StreamEncoderState state;
+	WriteBufferClientData cd;
+	FLAC__uint64 absolute_sample;
+	uint32_t i, frame_number, channel, sample;
+	FLAC__int32 expected, got;
+
+	memset(&cd, 0, sizeof(cd));
+
+	printf("testing a verify mismatch at sample %" PRIu64 ", %u thread(s)... ", mismatch_sample, threads);
+
+	encoder = FLAC__stream_encoder_new();
+	if(0 == encoder) {
+		printf("FAILED, returned NULL\n");
+		return false;
+	}
+	FLAC__stream_encoder_set_verify(encoder, true);
+	FLAC__stream_encoder_set_channels(encoder, 2);
+	FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+	FLAC__stream_encoder_set_sample_rate(encoder, 44100);
+	FLAC__stream_encoder_set_compression_level(encoder, 5);
+	FLAC__stream_encoder_set_blocksize(encoder, 4096);
+	FLAC__stream_encoder_set_total_samples_estimate(encoder, samples);
+	if(FLAC__stream_encoder_set_num_threads(encoder, threads) != FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK && threads == 1)
+		return die_s_("FLAC__stream_encoder_set_num_threads() failed", encoder);
+	if(!FLAC__stream_encoder_inject_verify_mismatch(encoder, mismatch_sample))
+		return die_s_("FLAC__stream_encoder_inject_verify_mismatch() returned false", encoder);
+
+	if(FLAC__stream_encoder_init_stream(encoder, write_buffer_copy_callback_, 0, 0, 0, &cd) != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+		return die_s_("FLAC__stream_encoder_init_stream() failed", encoder);
+
+	/* when verifying on the threads, the mismatch may only be reported by
+	 * a later call or by finishing */
+	for(i = 0; i < samples; i += 1000) {
+		const uint32_t n = samples - i < 1000? samples - i : 1000;
+		if(!FLAC__stream_encoder_process_interleaved(encoder, signal + 2 * i, n))
+			break;
+	}
+	if(i < samples) {
+		if(i + 1000 <= mismatch_sample)
+			return die_s_("FLAC__stream_encoder_process_interleaved() failed before the mismatch", encoder);
+		state = FLAC__stream_encoder_get_state(encoder);
+		(void)FLAC__stream_encoder_finish(encoder);
+	}
+	else {
+		if(FLAC__stream_encoder_finish(encoder))
+			return die_s_("FLAC__stream_encoder_finish() did not return false", encoder);
+		state = FLAC__stream_encoder_get_state(encoder);
+	}
+	if(state != FLAC__STREAM_ENCODER_VERIFY_MISMATCH_IN_AUDIO_DATA)
+		return die_s_("encoder state is not FLAC__STREAM_ENCODER_VERIFY_MISMATCH_IN_AUDIO_DATA", encoder);
+
+	FLAC__stream_encoder_get_verify_decoder_error_stats(encoder, &absolute_sample, &frame_number, &channel, &sample, &expected, &got);
+	if(absolute_sample != mismatch_sample)
+		return die_s_("wrong absolute sample in the verify decoder error stats", encoder);
+	if(frame_number != mismatch_sample / 4096 || sample != mismatch_sample % 4096 || channel != 0)
+		return die_s_("wrong frame, sample or channel in the verify decoder error stats", encoder);
+	if(got != signal[2 * mismatch_sample] || expected != (got ^ 1))
+		return die_s_("wrong sample values in the verify decoder error stats", encoder);
+
+	FLAC__stream_encoder_delete(encoder);
+	free(cd.data);
+
+	printf("OK\n");
+
+	return true;
+}
+
+static FLAC__bool test_stream_encoder_verify_mismatch(void)
+{
+	const uint32_t samples = 20 * 4096 + 123;
+	FLAC__int32 *signal;
+	uint32_t i, threads;
+
+	printf("\n+++ libFLAC unit test: FLAC__StreamEncoder (verify mismatch)\n\n");
+
+	if(0 == (signal = malloc(sizeof(FLAC__int32) * 2 * samples)))
+		return die_("malloc failed");
+	for(i = 0; i < samples; i++) {
+		signal[2*i] = (FLAC__int32)(i % 64) - 32 + (FLAC__int32)((i * 2654435761u) >> 20 & 0xff);
+		signal[2*i+1] = (FLAC__int32)(i % 50) - 25;
+	}
+
+	/* with more threads, the frames are verified on the threads */
+	for(threads = 1; threads <= 4; threads *= 4) {
+		if(!encode_with_verify_mismatch_(signal, samples, threads, 15 * 4096 + 1234))
+			return false;
+		if(!encode_with_verify_mismatch_(signal, samples, threads, 19 * 4096 + 4095))
+			return false;
+	}
+
+	free(signal);
+
+	printf("\nPASSED!\n");
+
+	return true;
+}
+
 FLAC__bool test_encoders(void)
 {
 	FLAC__bool is_ogg = false;
@@ -517,6 +1250,24 @@ FLAC__bool test_encoders(void)
 		if(!test_stream_encoder(LAYER_FILENAME, is_ogg))
 			return false;
 
+		if(!is_ogg && !test_stream_encoder_variable_blocksize())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_estimate())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_write_buffers())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_thread_pool())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_small_blocks())
+			return false;
+
+		if(!is_ogg && !test_stream_encoder_verify_mismatch())
+			return false;
+
 		(void) grabbag__file_remove_file(flacfilename(is_ogg));
 
 		free_metadata_blocks_();
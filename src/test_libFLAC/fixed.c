@@ -0,0 +1,171 @@
+/* test_libFLAC - Unit tester for libFLAC
+ * Copyright (C) 2025  Xiph.Org Foundation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FLAC/assert.h"
+#include "share/compat.h"
+#include "private/cpu.h"
+#include "private/fixed.h"
+#include "fixed.h"
+
+typedef void (*RestoreSignal)(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[]);
+
+#define MAX_DATA_LEN 300
+#define GUARD_LEN 16
+#define GUARD_VALUE 0x5a5a5a5a
+
+/* lengths around the vector widths, and longer ones where the loops run many times */
+static const uint32_t data_lens_[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 11, 13, 15, 16, 17, 31, 33, 63, 100, 257, MAX_DATA_LEN };
+
+static FLAC__uint32 rand_state_ = 0x2468ace1;
+
+static FLAC__int32 random_(FLAC__int32 limit)
+{
+	rand_state_ = rand_state_ * 1103515245u + 12345u;
+	return (FLAC__int32)((rand_state_ >> 1) % (2u * (FLAC__uint32)limit + 1)) - limit;
+}
+
+/* Makes up a signal and the residual that restores exactly that signal;
+ * 'signal' starts with 'order' samples of history before index 0. For the
+ * wide versions, the signal is a random walk over the full 32-bit range,
+ * so that the sums in the predictor need more than 32 bits */
+static void make_residual_(FLAC__int32 *signal, FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__bool wide)
+{
+	int i;
+
+	if(wide) {
+		FLAC__int64 value = random_(INT32_MAX);
+		for(i = -(int)order; i < (int)data_len; i++) {
+			value += random_(1 << 20);
+			if(value > INT32_MAX || value < -INT32_MAX)
+				value = value > 0? INT32_MAX - (1 << 20) : -INT32_MAX + (1 << 20);
+			signal[i] = (FLAC__int32)value;
+		}
+	}
+	else {
+		for(i = -(int)order; i < (int)data_len; i++)
+			signal[i] = random_((1 << 23) - 1);
+	}
+
+	for(i = 0; i < (int)data_len; i++) {
+		switch(order) {
+			case 0:
+				residual[i] = signal[i];
+				break;
+			case 1:
+				residual[i] = (FLAC__int32)((FLAC__int64)signal[i] - signal[i-1]);
+				break;
+			case 2:
+				residual[i] = (FLAC__int32)((FLAC__int64)signal[i] - 2*(FLAC__int64)signal[i-1] + signal[i-2]);
+				break;
+			case 3:
+				residual[i] = (FLAC__int32)((FLAC__int64)signal[i] - 3*(FLAC__int64)signal[i-1] + 3*(FLAC__int64)signal[i-2] - signal[i-3]);
+				break;
+			case 4:
+				residual[i] = (FLAC__int32)((FLAC__int64)signal[i] - 4*(FLAC__int64)signal[i-1] + 6*(FLAC__int64)signal[i-2] - 4*(FLAC__int64)signal[i-3] + signal[i-4]);
+				break;
+			default:
+				FLAC__ASSERT(0);
+		}
+	}
+}
+
+static FLAC__bool test_restore_signal_(const char *name, RestoreSignal restore_signal, RestoreSignal reference, FLAC__bool wide)
+{
+	FLAC__int32 signal_buffer[FLAC__MAX_FIXED_ORDER + MAX_DATA_LEN], residual[MAX_DATA_LEN];
+	FLAC__int32 expected_buffer[FLAC__MAX_FIXED_ORDER + MAX_DATA_LEN + GUARD_LEN], got_buffer[FLAC__MAX_FIXED_ORDER + MAX_DATA_LEN + GUARD_LEN];
+	FLAC__int32 *signal = signal_buffer + FLAC__MAX_FIXED_ORDER, *expected = expected_buffer + FLAC__MAX_FIXED_ORDER, *got = got_buffer + FLAC__MAX_FIXED_ORDER;
+	uint32_t order, n, i, repeat;
+
+	printf("testing %s with %s-bit samples ... ", name, wide? "32" : "24");
+
+	for(order = 0; order <= FLAC__MAX_FIXED_ORDER; order++) {
+		for(n = 0; n < sizeof(data_lens_) / sizeof(data_lens_[0]); n++) {
+			for(repeat = 0; repeat < 8; repeat++) {
+				const uint32_t data_len = data_lens_[n];
+				make_residual_(signal, residual, data_len, order, wide);
+
+				for(i = 0; i < FLAC__MAX_FIXED_ORDER + MAX_DATA_LEN + GUARD_LEN; i++)
+					expected_buffer[i] = got_buffer[i] = GUARD_VALUE;
+				memcpy(expected - order, signal - order, sizeof(FLAC__int32) * order);
+				memcpy(got - order, signal - order, sizeof(FLAC__int32) * order);
+
+				reference(residual, data_len, order, expected);
+				restore_signal(residual, data_len, order, got);
+
+				if(memcmp(expected, signal, sizeof(FLAC__int32) * data_len)) {
+					printf("FAILED, reference version did not restore the signal (order=%u, data_len=%u)\n", order, data_len);
+					return false;
+				}
+				/* the history and the samples just beyond the output must be left alone */
+				if(memcmp(expected_buffer, got_buffer, sizeof(expected_buffer))) {
+					printf("FAILED, output differs from the reference version (order=%u, data_len=%u)\n", order, data_len);
+					return false;
+				}
+			}
+		}
+	}
+
+	printf("OK\n");
+	return true;
+}
+
+FLAC__bool test_fixed(void)
+{
+	FLAC__CPUInfo cpuinfo;
+
+	printf("\n+++ libFLAC unit test: fixed\n\n");
+
+	FLAC__cpu_info(&cpuinfo);
+	(void)cpuinfo;
+
+	if(!test_restore_signal_("FLAC__fixed_restore_signal", FLAC__fixed_restore_signal, FLAC__fixed_restore_signal, false))
+		return false;
+	if(!test_restore_signal_("FLAC__fixed_restore_signal_wide", FLAC__fixed_restore_signal_wide, FLAC__fixed_restore_signal_wide, true))
+		return false;
+
+#ifndef FLAC__NO_ASM
+#  if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
+#    ifdef FLAC__SSE2_SUPPORTED
+	if(cpuinfo.use_asm && cpuinfo.x86.sse2) {
+		if(!test_restore_signal_("FLAC__fixed_restore_signal_intrin_sse2", FLAC__fixed_restore_signal_intrin_sse2, FLAC__fixed_restore_signal, false))
+			return false;
+		if(!test_restore_signal_("FLAC__fixed_restore_signal_wide_intrin_sse2", FLAC__fixed_restore_signal_wide_intrin_sse2, FLAC__fixed_restore_signal_wide, true))
+			return false;
+	}
+#    endif
+#    ifdef FLAC__AVX2_SUPPORTED
+	if(cpuinfo.use_asm && cpuinfo.x86.avx2) {
+		if(!test_restore_signal_("FLAC__fixed_restore_signal_intrin_avx2", FLAC__fixed_restore_signal_intrin_avx2, FLAC__fixed_restore_signal, false))
+			return false;
+		if(!test_restore_signal_("FLAC__fixed_restore_signal_wide_intrin_avx2", FLAC__fixed_restore_signal_wide_intrin_avx2, FLAC__fixed_restore_signal_wide, true))
+			return false;
+	}
+#    endif
+#  endif
+#endif
+
+	printf("\nPASSED!\n");
+	return true;
+}
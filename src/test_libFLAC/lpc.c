@@ -0,0 +1,160 @@
+/* test_libFLAC - Unit tester for libFLAC
+ * Copyright (C) 2025  Xiph.Org Foundation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FLAC/assert.h"
+#include "share/compat.h"
+#include "private/cpu.h"
+#include "private/lpc.h"
+#include "lpc.h"
+
+typedef void (*RestoreSignal)(const FLAC__int32 residual[], uint32_t data_len, const FLAC__int32 qlp_coeff[], uint32_t order, int lp_quantization, FLAC__int32 data[]);
+
+#define MAX_DATA_LEN 300
+#define GUARD_LEN 16
+#define GUARD_VALUE 0x5a5a5a5a
+
+/* lengths around the vector widths, and longer ones where the loops run many times */
+static const uint32_t data_lens_[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 11, 13, 15, 16, 17, 31, 33, 63, 100, 257, MAX_DATA_LEN };
+
+static FLAC__uint32 rand_state_ = 0x13579bdf;
+
+static FLAC__int32 random_(FLAC__int32 limit)
+{
+	rand_state_ = rand_state_ * 1103515245u + 12345u;
+	return (FLAC__int32)((rand_state_ >> 1) % (2u * (FLAC__uint32)limit + 1)) - limit;
+}
+
+/* Makes up a signal and coefficients, and the residual that restores
+ * exactly that signal; 'signal' starts with 'order' samples of history
+ * before index 0 */
+static void make_residual_(FLAC__int32 *signal, FLAC__int32 residual[], uint32_t data_len, FLAC__int32 qlp_coeff[], uint32_t order, int lp_quantization, FLAC__int32 signal_limit, FLAC__int32 coeff_limit)
+{
+	int i;
+	uint32_t j;
+
+	for(j = 0; j < order; j++)
+		qlp_coeff[j] = random_(coeff_limit);
+	for(i = -(int)order; i < (int)data_len; i++)
+		signal[i] = random_(signal_limit);
+	for(i = 0; i < (int)data_len; i++) {
+		FLAC__int64 sum = 0;
+		for(j = 0; j < order; j++)
+			sum += (FLAC__int64)qlp_coeff[j] * signal[i-(int)j-1];
+		residual[i] = (FLAC__int32)(signal[i] - (sum >> lp_quantization));
+	}
+}
+
+static FLAC__bool test_restore_signal_(const char *name, RestoreSignal restore_signal, RestoreSignal reference, FLAC__bool wide)
+{
+	FLAC__int32 signal_buffer[FLAC__MAX_LPC_ORDER + MAX_DATA_LEN], residual[MAX_DATA_LEN], qlp_coeff[FLAC__MAX_LPC_ORDER];
+	FLAC__int32 expected_buffer[FLAC__MAX_LPC_ORDER + MAX_DATA_LEN + GUARD_LEN], got_buffer[FLAC__MAX_LPC_ORDER + MAX_DATA_LEN + GUARD_LEN];
+	FLAC__int32 *signal = signal_buffer + FLAC__MAX_LPC_ORDER, *expected = expected_buffer + FLAC__MAX_LPC_ORDER, *got = got_buffer + FLAC__MAX_LPC_ORDER;
+	uint32_t order, n, i;
+	int lp_quantization;
+
+	printf("testing %s ... ", name);
+
+	for(order = 1; order <= FLAC__MAX_LPC_ORDER; order++) {
+		for(lp_quantization = 0; lp_quantization < (1 << FLAC__SUBFRAME_LPC_QLP_SHIFT_LEN) / 2; lp_quantization++) {
+			for(n = 0; n < sizeof(data_lens_) / sizeof(data_lens_[0]); n++) {
+				const uint32_t data_len = data_lens_[n];
+				/* The 32-bit versions are used when the sum fits in 32 bits,
+				 * which 16-bit samples with 11-bit coefficients always do;
+				 * the wide ones get 24-bit samples and sums of up to 43
+				 * bits, as long as the shifted sum fits in 32 bits */
+				if(wide)
+					make_residual_(signal, residual, data_len, qlp_coeff, order, lp_quantization, (1 << 23) - 1, (1 << (lp_quantization < 12? lp_quantization + 2 : 14)) - 1);
+				else
+					make_residual_(signal, residual, data_len, qlp_coeff, order, lp_quantization, (1 << 15) - 1, (1 << 10) - 1);
+
+				for(i = 0; i < FLAC__MAX_LPC_ORDER + MAX_DATA_LEN + GUARD_LEN; i++)
+					expected_buffer[i] = got_buffer[i] = GUARD_VALUE;
+				memcpy(expected - order, signal - order, sizeof(FLAC__int32) * order);
+				memcpy(got - order, signal - order, sizeof(FLAC__int32) * order);
+
+				reference(residual, data_len, qlp_coeff, order, lp_quantization, expected);
+				restore_signal(residual, data_len, qlp_coeff, order, lp_quantization, got);
+
+				if(memcmp(expected, signal, sizeof(FLAC__int32) * data_len)) {
+					printf("FAILED, reference version did not restore the signal (order=%u, lp_quantization=%d, data_len=%u)\n", order, lp_quantization, data_len);
+					return false;
+				}
+				/* the history and the samples just beyond the output must be left alone */
+				if(memcmp(expected_buffer, got_buffer, sizeof(expected_buffer))) {
+					printf("FAILED, output differs from the reference version (order=%u, lp_quantization=%d, data_len=%u)\n", order, lp_quantization, data_len);
+					return false;
+				}
+			}
+		}
+	}
+
+	printf("OK\n");
+	return true;
+}
+
+FLAC__bool test_lpc(void)
+{
+	FLAC__CPUInfo cpuinfo;
+
+	printf("\n+++ libFLAC unit test: lpc\n\n");
+
+	FLAC__cpu_info(&cpuinfo);
+	(void)cpuinfo;
+
+	if(!test_restore_signal_("FLAC__lpc_restore_signal", FLAC__lpc_restore_signal, FLAC__lpc_restore_signal, false))
+		return false;
+	if(!test_restore_signal_("FLAC__lpc_restore_signal_wide", FLAC__lpc_restore_signal_wide, FLAC__lpc_restore_signal_wide, true))
+		return false;
+
+#ifndef FLAC__NO_ASM
+#  if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
+#    ifdef FLAC__SSE4_1_SUPPORTED
+	if(cpuinfo.use_asm && cpuinfo.x86.sse41) {
+		if(!test_restore_signal_("FLAC__lpc_restore_signal_intrin_sse41", FLAC__lpc_restore_signal_intrin_sse41, FLAC__lpc_restore_signal, false))
+			return false;
+		if(!test_restore_signal_("FLAC__lpc_restore_signal_wide_intrin_sse41", FLAC__lpc_restore_signal_wide_intrin_sse41, FLAC__lpc_restore_signal_wide, true))
+			return false;
+	}
+#    endif
+#    ifdef FLAC__AVX2_SUPPORTED
+	if(cpuinfo.use_asm && cpuinfo.x86.avx2) {
+		if(!test_restore_signal_("FLAC__lpc_restore_signal_intrin_avx2", FLAC__lpc_restore_signal_intrin_avx2, FLAC__lpc_restore_signal, false))
+			return false;
+		if(!test_restore_signal_("FLAC__lpc_restore_signal_wide_intrin_avx2", FLAC__lpc_restore_signal_wide_intrin_avx2, FLAC__lpc_restore_signal_wide, true))
+			return false;
+	}
+#    endif
+#  endif
+#  if defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN
+	if(!test_restore_signal_("FLAC__lpc_restore_signal_intrin_neon", FLAC__lpc_restore_signal_intrin_neon, FLAC__lpc_restore_signal, false))
+		return false;
+	if(!test_restore_signal_("FLAC__lpc_restore_signal_wide_intrin_neon", FLAC__lpc_restore_signal_wide_intrin_neon, FLAC__lpc_restore_signal_wide, true))
+		return false;
+#  endif
+#endif
+
+	printf("\nPASSED!\n");
+	return true;
+}
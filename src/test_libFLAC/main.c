@@ -27,7 +27,9 @@
 #include "decoders.h"
 #include "encoders.h"
 #include "endswap.h"
+#include "fixed.h"
 #include "format.h"
+#include "lpc.h"
 #include "metadata.h"
 #include "md5.h"
 
@@ -42,6 +44,12 @@ int main(void)
 	if(!test_md5())
 		return 1;
 
+	if(!test_fixed())
+		return 1;
+
+	if(!test_lpc())
+		return 1;
+
 	if(!test_bitreader())
 		return 1;
 
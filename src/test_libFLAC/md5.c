@@ -25,12 +25,14 @@
 
 #include "FLAC/assert.h"
 #include "share/compat.h"
+#include "private/cpu.h"
 #include "private/md5.h"
 #include "md5.h"
 
 
 static FLAC__bool test_md5_clear_context(void);
 static FLAC__bool test_md5_codec(void);
+static FLAC__bool test_md5_format_input(void);
 static FLAC__bool test_md5_accumulate(const FLAC__int32 * const * signal,uint32_t channels, uint32_t samples, uint32_t bytes_per_sample, const FLAC__byte target_digest [16]);
 
 FLAC__bool test_md5(void)
@@ -43,6 +45,9 @@ FLAC__bool test_md5(void)
 	if (! test_md5_codec())
 		return false;
 
+	if (! test_md5_format_input())
+		return false;
+
 	printf("\nPASSED!\n");
 	return true;
 }
@@ -219,3 +224,72 @@ static FLAC__bool test_md5_accumulate(const FLAC__int32 * const * signal, uint32
 	printf("OK\n");
 	return true;
 }
+
+static FLAC__bool test_md5_format_input(void)
+{
+	FLAC__int32 arrays[MAX_CHANNEL_COUNT][MD5_SAMPLE_COUNT], *pointer[MAX_CHANNEL_COUNT];
+	FLAC__byte expected[MAX_CHANNEL_COUNT * MD5_SAMPLE_COUNT * 4 + 16], got[MAX_CHANNEL_COUNT * MD5_SAMPLE_COUNT * 4 + 16];
+	FLAC__MD5FormatInput format_input[3];
+	const char *name[3];
+	uint32_t chan, byte_size, samples, n, count = 0, seed = 0x9e3779b9;
+	FLAC__CPUInfo cpuinfo;
+
+	FLAC__cpu_info(&cpuinfo);
+	(void)cpuinfo;
+#ifndef FLAC__NO_ASM
+#  if (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
+#    ifdef FLAC__SSE2_SUPPORTED
+	if (cpuinfo.use_asm && cpuinfo.x86.sse2) {
+		format_input[count] = FLAC__md5_format_input_intrin_sse2;
+		name[count++] = "sse2";
+	}
+#    endif
+#    ifdef FLAC__AVX2_SUPPORTED
+	if (cpuinfo.use_asm && cpuinfo.x86.avx2) {
+		format_input[count] = FLAC__md5_format_input_intrin_avx2;
+		name[count++] = "avx2";
+	}
+#    endif
+#  endif
+#  if defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN && !WORDS_BIGENDIAN
+	format_input[count] = FLAC__md5_format_input_intrin_neon;
+	name[count++] = "neon";
+#  endif
+#endif
+
+	/* Full-range samples, so that truncation to the sample size is tested as well */
+	for (chan = 0 ; chan < MAX_CHANNEL_COUNT ; chan ++) {
+		uint32_t k;
+		pointer[chan] = arrays [chan];
+		for (k = 0 ; k < MD5_SAMPLE_COUNT ; k++) {
+			seed = seed * 1103515245 + 12345;
+			arrays[chan][k] = seed;
+		}
+	}
+
+	for (n = 0 ; n < count ; n++) {
+		printf("testing FLAC__md5_format_input_intrin_%s ... ", name[n]);
+		for (chan = 1 ; chan <= MAX_CHANNEL_COUNT ; chan ++) {
+			for (byte_size = 1 ; byte_size <= 4 ; byte_size ++) {
+				for (samples = 0 ; samples <= MD5_SAMPLE_COUNT ; samples ++) {
+					const size_t bytes = (size_t)chan * samples * byte_size;
+					FLAC__multibyte mbuf;
+					memset(expected, 0x5a, sizeof (expected));
+					memset(got, 0x5a, sizeof (got));
+					mbuf.p8 = expected;
+					FLAC__md5_format_input(&mbuf, (const FLAC__int32 * const *) pointer, chan, samples, byte_size);
+					mbuf.p8 = got;
+					format_input[n](&mbuf, (const FLAC__int32 * const *) pointer, chan, samples, byte_size);
+					/* also compare the bytes just beyond the output, which must be left alone */
+					if (memcmp(expected, got, bytes + 16)) {
+						printf("FAILED, output differs from FLAC__md5_format_input (samples=%u, channels=%u, bytes_per_sample=%u)\n", samples, chan, byte_size);
+						return false;
+					}
+				}
+			}
+		}
+		printf("OK\n");
+	}
+
+	return true;
+}
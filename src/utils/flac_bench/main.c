@@ -0,0 +1,929 @@
+/* flac_bench - Benchmarks libFLAC on generated audio
+ * Copyright (C) 2025  Xiph.Org Foundation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * flac_bench times the encoder presets and the decoder on a generated
+ * corpus, and the DSP kernels of libFLAC once for every instruction set
+ * variant the CPU supports, and writes the results as JSON so they can
+ * be compared between builds and revisions.  Every kernel is checked
+ * against the plain C version before it is timed.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include "FLAC/assert.h"
+#include "FLAC/stream_decoder.h"
+#include "FLAC/stream_encoder.h"
+#include "share/compat.h"
+#include "private/bitreader.h" /* from the libFLAC private include area */
+#include "private/bitwriter.h"
+#include "private/cpu.h"
+#include "private/crc.h"
+#include "private/fixed.h"
+#include "private/lpc.h"
+#include "private/md5.h"
+#include "private/window.h"
+
+#define SAMPLE_RATE 44100
+#define BLOCKSIZE 4096
+#define LPC_ORDER 8
+#define QLP_COEFF_PRECISION 12
+#define FIXED_ORDER 2
+#define MAX_KERNELS 64
+#define MAX_REPETITIONS 1000
+
+typedef enum {
+	SIGNAL_SWEEP,
+	SIGNAL_NOISE,
+	SIGNAL_SILENCE,
+	SIGNAL_TRANSIENTS,
+	NUM_SIGNALS
+} signal_type;
+
+static const char * const signal_names[NUM_SIGNALS] = { "sweep", "noise", "silence", "transients" };
+static const uint32_t corpus_bps[] = { 16, 24, 32 };
+static const uint32_t corpus_channels[] = { 1, 2, 6, 8 };
+static const uint32_t kernel_bps[] = { 16, 24 };
+
+typedef enum {
+	KERNEL_AUTOCORRELATION,
+	KERNEL_RESIDUAL,
+	KERNEL_LPC_RESTORE,
+	KERNEL_FIXED_RESTORE,
+	KERNEL_RICE_WRITE,
+	KERNEL_RICE_READ,
+	KERNEL_CRC8,
+	KERNEL_CRC16,
+	KERNEL_CRC16_WORDS32,
+	KERNEL_CRC16_WORDS64,
+	KERNEL_MD5
+} kernel_type;
+
+typedef struct {
+	kernel_type type;
+	const char *name;
+	const char *variant;
+	uint32_t max_bps; /* 0 if the variant handles any resolution, otherwise it accumulates in 32 bits */
+	union {
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+		void (*autocorrelation)(const FLAC__real data[], uint32_t data_len, uint32_t lag, double autoc[]);
+#endif
+		void (*residual)(const FLAC__int32 *data, uint32_t data_len, const FLAC__int32 qlp_coeff[], uint32_t order, int lp_quantization, FLAC__int32 residual[]);
+		void (*lpc_restore)(const FLAC__int32 residual[], uint32_t data_len, const FLAC__int32 qlp_coeff[], uint32_t order, int lp_quantization, FLAC__int32 data[]);
+		void (*fixed_restore)(const FLAC__int32 residual[], uint32_t data_len, uint32_t order, FLAC__int32 data[]);
+		FLAC__BitWriterWriteRiceSignedBlock rice_write;
+		FLAC__bool (*rice_read)(FLAC__BitReader *br, int vals[], uint32_t nvals, uint32_t parameter);
+		FLAC__MD5FormatInput md5_format_input;
+		const FLAC__CRC16Functions *crc16;
+	} fn;
+} bench_kernel;
+
+typedef struct {
+	FLAC__byte *data;
+	size_t bytes, capacity, position;
+} memory_stream;
+
+typedef struct {
+	memory_stream *stream;
+	FLAC__bool error;
+} decoder_client;
+
+/* the input of the kernels: one channel of the sweep, split in blocks of BLOCKSIZE samples */
+typedef struct {
+	uint32_t bps;
+	uint32_t blocks;
+	uint32_t samples;
+	FLAC__int32 *signal;
+	FLAC__int32 *output;
+	FLAC__int32 *lpc_residual;
+	FLAC__int32 *fixed_residual;
+	FLAC__int32 *qlp_coeff; /* LPC_ORDER per block */
+	int *shift;
+	uint32_t *rice_parameter;
+	int *decoded;
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	FLAC__real *windowed;
+#endif
+	FLAC__BitWriter *bw;
+	FLAC__BitReader *br;
+	memory_stream rice;
+	FLAC__byte md5sum[16];
+} kernel_input;
+
+typedef struct {
+	uint32_t count;
+	double min, median, mean, stddev;
+} bench_stats;
+
+static bench_kernel kernels_[MAX_KERNELS];
+static uint32_t num_kernels_ = 0;
+
+static FLAC__uint64 nanoseconds_(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	if(frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (FLAC__uint64)(counter.QuadPart / frequency.QuadPart) * 1000000000u +
+	       (FLAC__uint64)(counter.QuadPart % frequency.QuadPart) * 1000000000u / (FLAC__uint64)frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (FLAC__uint64)ts.tv_sec * 1000000000u + (FLAC__uint64)ts.tv_nsec;
+#endif
+}
+
+static int compare_doubles_(const void *a, const void *b)
+{
+	const double x = *(const double *)a, y = *(const double *)b;
+	return x < y? -1 : x > y? 1 : 0;
+}
+
+static void compute_stats_(double ns[], uint32_t count, bench_stats *stats)
+{
+	double sum = 0.0, squares = 0.0;
+	uint32_t i;
+
+	qsort(ns, count, sizeof(double), compare_doubles_);
+	for(i = 0; i < count; i++)
+		sum += ns[i];
+	stats->count = count;
+	stats->min = ns[0];
+	stats->median = count % 2? ns[count / 2] : (ns[count / 2 - 1] + ns[count / 2]) / 2.0;
+	stats->mean = sum / count;
+	for(i = 0; i < count; i++)
+		squares += (ns[i] - stats->mean) * (ns[i] - stats->mean);
+	stats->stddev = count > 1? sqrt(squares / (count - 1)) : 0.0;
+}
+
+static void print_stats_(FILE *f, const char *name, const bench_stats *stats)
+{
+	fprintf(f, "\"%s\": { \"repetitions\": %u, \"min_ns\": %.0f, \"median_ns\": %.0f, \"mean_ns\": %.0f, \"stddev_ns\": %.0f }",
+		name, stats->count, stats->min, stats->median, stats->mean, stats->stddev);
+}
+
+/*
+ * corpus generation
+ */
+
+/* The generator of noisy-sine.wav in test_streams: unlike random(), it
+ * gives the same numbers on every platform, so the corpus is the same
+ * everywhere. */
+static double noise_(FLAC__uint64 *state)
+{
+	*state = 11117 * *state + 211231;
+	*state = 11117 * *state + 211231;
+	*state = 11117 * *state + 211231;
+	return ((FLAC__int32)*state) / (0x7fffffff * 1.000001);
+}
+
+/* Fills signal with samples*channels interleaved samples.  The sweep is
+ * the two-tone signal of the sine streams of test_streams, with the first
+ * tone sweeping from 20Hz to 20kHz and the channels multiplying the
+ * phase like generate_sine16_2() does. */
+static void generate_signal_(signal_type type, uint32_t channels, uint32_t bps, uint32_t samples, FLAC__int32 signal[])
+{
+	const double full_scale = (double)(((FLAC__int64)1 << (bps - 1)) - 1);
+	const double a1 = 0.49, a2 = 0.37, f2 = 661.5;
+	const uint32_t burst_interval = SAMPLE_RATE / 4;
+	FLAC__uint64 state[FLAC__MAX_CHANNELS];
+	double theta1 = 0.0, theta2 = 0.0;
+	uint32_t i, channel;
+
+	for(channel = 0; channel < channels; channel++)
+		state[channel] = 0x1243456 + channel;
+
+	for(i = 0; i < samples; i++) {
+		const double f1 = 20.0 * pow(1000.0, (double)i / samples);
+		for(channel = 0; channel < channels; channel++) {
+			double val = 0.0;
+			switch(type) {
+				case SIGNAL_SWEEP:
+					val = a1 * sin(theta1 * (1.0 + 0.1 * channel)) + a2 * sin(theta2 * (channel + 1));
+					if(channel & 1)
+						val = -val;
+					break;
+				case SIGNAL_NOISE:
+					val = 0.5 * noise_(&state[channel]);
+					break;
+				case SIGNAL_SILENCE:
+					break;
+				case SIGNAL_TRANSIENTS:
+					/* decaying bursts of noise four times a second, over a faint noise floor */
+					val = 0.9 * exp(-(double)(i % burst_interval) / (0.005 * SAMPLE_RATE)) * noise_(&state[channel]) + 0.001 * noise_(&state[channel]);
+					break;
+				default:
+					break;
+			}
+			val = floor(val * full_scale + 0.5);
+			if(val > full_scale)
+				val = full_scale;
+			else if(val < -full_scale - 1.0)
+				val = -full_scale - 1.0;
+			signal[i * channels + channel] = (FLAC__int32)val;
+		}
+		theta1 += 2.0 * M_PI * f1 / SAMPLE_RATE;
+		theta2 += 2.0 * M_PI * f2 / SAMPLE_RATE;
+	}
+}
+
+/*
+ * presets
+ */
+
+static FLAC__StreamEncoderWriteStatus encoder_write_callback_(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, uint32_t samples, uint32_t current_frame, void *client_data)
+{
+	memory_stream *stream = (memory_stream *)client_data;
+	(void)encoder, (void)samples, (void)current_frame;
+
+	if(stream->bytes + bytes > stream->capacity) {
+		size_t capacity = stream->capacity? stream->capacity : 65536;
+		FLAC__byte *data;
+		while(stream->bytes + bytes > capacity)
+			capacity *= 2;
+		if(0 == (data = realloc(stream->data, capacity)))
+			return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+		stream->data = data;
+		stream->capacity = capacity;
+	}
+	memcpy(stream->data + stream->bytes, buffer, bytes);
+	stream->bytes += bytes;
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+static FLAC__StreamDecoderReadStatus decoder_read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
+{
+	memory_stream *stream = ((decoder_client *)client_data)->stream;
+	(void)decoder;
+
+	if(stream->position >= stream->bytes) {
+		*bytes = 0;
+		return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+	}
+	if(*bytes > stream->bytes - stream->position)
+		*bytes = stream->bytes - stream->position;
+	memcpy(buffer, stream->data + stream->position, *bytes);
+	stream->position += *bytes;
+	return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+static FLAC__StreamDecoderWriteStatus decoder_write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
+{
+	(void)decoder, (void)frame, (void)buffer, (void)client_data;
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+static void decoder_error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+	(void)decoder;
+	((decoder_client *)client_data)->error = true;
+	fprintf(stderr, "flac_bench: ERROR: decoder error %s\n", FLAC__StreamDecoderErrorStatusString[status]);
+}
+
+static FLAC__bool encode_(const FLAC__int32 signal[], uint32_t channels, uint32_t bps, uint32_t samples, uint32_t preset, memory_stream *stream)
+{
+	FLAC__StreamEncoder *encoder;
+	FLAC__bool ok;
+
+	if(0 == (encoder = FLAC__stream_encoder_new()))
+		return false;
+	ok = FLAC__stream_encoder_set_channels(encoder, channels);
+	ok &= FLAC__stream_encoder_set_bits_per_sample(encoder, bps);
+	ok &= FLAC__stream_encoder_set_sample_rate(encoder, SAMPLE_RATE);
+	ok &= FLAC__stream_encoder_set_compression_level(encoder, preset);
+	ok &= FLAC__stream_encoder_set_streamable_subset(encoder, bps <= 24);
+	ok &= FLAC__stream_encoder_set_total_samples_estimate(encoder, samples);
+	stream->bytes = 0;
+	ok = ok && FLAC__stream_encoder_init_stream(encoder, encoder_write_callback_, 0, 0, 0, stream) == FLAC__STREAM_ENCODER_INIT_STATUS_OK;
+	ok = ok && FLAC__stream_encoder_process_interleaved(encoder, signal, samples);
+	ok = ok && FLAC__stream_encoder_finish(encoder);
+	if(!ok)
+		fprintf(stderr, "flac_bench: ERROR: encoding failed, state = %s\n", FLAC__stream_encoder_get_resolved_state_string(encoder));
+	FLAC__stream_encoder_delete(encoder);
+	return ok;
+}
+
+static FLAC__bool decode_(memory_stream *stream)
+{
+	FLAC__StreamDecoder *decoder;
+	decoder_client client;
+	FLAC__bool ok;
+
+	if(0 == (decoder = FLAC__stream_decoder_new()))
+		return false;
+	client.stream = stream;
+	client.error = false;
+	stream->position = 0;
+	ok = FLAC__stream_decoder_set_md5_checking(decoder, true);
+	ok = ok && FLAC__stream_decoder_init_stream(decoder, decoder_read_callback_, 0, 0, 0, 0, decoder_write_callback_, 0, decoder_error_callback_, &client) == FLAC__STREAM_DECODER_INIT_STATUS_OK;
+	ok = ok && FLAC__stream_decoder_process_until_end_of_stream(decoder);
+	/* finish() returns false on an MD5 mismatch */
+	ok = FLAC__stream_decoder_finish(decoder) && ok && !client.error;
+	if(!ok)
+		fprintf(stderr, "flac_bench: ERROR: decoding failed\n");
+	FLAC__stream_decoder_delete(decoder);
+	return ok;
+}
+
+static FLAC__bool bench_presets_(FILE *out, uint32_t seconds, uint32_t repetitions)
+{
+	const uint32_t samples = seconds * SAMPLE_RATE;
+	FLAC__int32 *signal;
+	memory_stream stream = { 0, 0, 0, 0 };
+	double encode_ns[MAX_REPETITIONS], decode_ns[MAX_REPETITIONS];
+	bench_stats encode_stats, decode_stats;
+	FLAC__bool first = true;
+	uint32_t s, b, c, preset, r;
+
+	if(0 == (signal = malloc(sizeof(FLAC__int32) * samples * FLAC__MAX_CHANNELS))) {
+		fprintf(stderr, "flac_bench: ERROR: out of memory\n");
+		return false;
+	}
+
+	fprintf(out, "  \"presets\": [\n");
+	for(s = 0; s < NUM_SIGNALS; s++) {
+		for(b = 0; b < sizeof(corpus_bps) / sizeof(corpus_bps[0]); b++) {
+			for(c = 0; c < sizeof(corpus_channels) / sizeof(corpus_channels[0]); c++) {
+				const uint32_t bps = corpus_bps[b], channels = corpus_channels[c];
+
+				fprintf(stderr, "flac_bench: presets, %s %u bit %u channel%s\n", signal_names[s], bps, channels, channels == 1? "" : "s");
+				generate_signal_((signal_type)s, channels, bps, samples, signal);
+
+				for(preset = 0; preset <= 8; preset++) {
+					for(r = 0; r < repetitions; r++) {
+						FLAC__uint64 start = nanoseconds_();
+						if(!encode_(signal, channels, bps, samples, preset, &stream))
+							goto fail;
+						encode_ns[r] = (double)(nanoseconds_() - start);
+						start = nanoseconds_();
+						if(!decode_(&stream))
+							goto fail;
+						decode_ns[r] = (double)(nanoseconds_() - start);
+					}
+					compute_stats_(encode_ns, repetitions, &encode_stats);
+					compute_stats_(decode_ns, repetitions, &decode_stats);
+
+					fprintf(out, "%s    { \"signal\": \"%s\", \"bps\": %u, \"channels\": %u, \"preset\": %u, \"samples\": %u, \"bytes\": %lu, \"ratio\": %.4f, ",
+						first? "" : ",\n", signal_names[s], bps, channels, preset, samples, (unsigned long)stream.bytes,
+						(double)stream.bytes / ((double)samples * channels * bps / 8.0));
+					print_stats_(out, "encode", &encode_stats);
+					fprintf(out, ", ");
+					print_stats_(out, "decode", &decode_stats);
+					fprintf(out, " }");
+					first = false;
+				}
+			}
+		}
+	}
+	fprintf(out, "\n  ]");
+
+	free(stream.data);
+	free(signal);
+	return true;
+fail:
+	free(stream.data);
+	free(signal);
+	return false;
+}
+
+/*
+ * kernels
+ */
+
+static bench_kernel *add_kernel_(kernel_type type, const char *name, const char *variant, uint32_t max_bps)
+{
+	bench_kernel *kernel = &kernels_[num_kernels_++];
+
+	FLAC__ASSERT(num_kernels_ <= MAX_KERNELS);
+	kernel->type = type;
+	kernel->name = name;
+	kernel->variant = variant;
+	kernel->max_bps = max_bps;
+	return kernel;
+}
+
+/* Registers the plain C kernels and every variant the CPU supports,
+ * under the same conditions the encoder and decoder select them. */
+static void add_kernels_(const FLAC__CPUInfo *cpuinfo)
+{
+	(void)cpuinfo;
+
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	add_kernel_(KERNEL_AUTOCORRELATION, "autocorrelation", "generic", 0)->fn.autocorrelation = FLAC__lpc_compute_autocorrelation;
+	add_kernel_(KERNEL_RESIDUAL, "residual", "generic", 16)->fn.residual = FLAC__lpc_compute_residual_from_qlp_coefficients;
+	add_kernel_(KERNEL_RESIDUAL, "residual_wide", "generic", 0)->fn.residual = FLAC__lpc_compute_residual_from_qlp_coefficients_wide;
+#endif
+	add_kernel_(KERNEL_LPC_RESTORE, "lpc_restore", "generic", 16)->fn.lpc_restore = FLAC__lpc_restore_signal;
+	add_kernel_(KERNEL_LPC_RESTORE, "lpc_restore_wide", "generic", 0)->fn.lpc_restore = FLAC__lpc_restore_signal_wide;
+	add_kernel_(KERNEL_FIXED_RESTORE, "fixed_restore", "generic", 0)->fn.fixed_restore = FLAC__fixed_restore_signal;
+	add_kernel_(KERNEL_RICE_WRITE, "rice_write", "generic", 0)->fn.rice_write = FLAC__bitwriter_write_rice_signed_block;
+	add_kernel_(KERNEL_RICE_READ, "rice_read", "generic", 0)->fn.rice_read = FLAC__bitreader_read_rice_signed_block;
+	add_kernel_(KERNEL_CRC8, "crc8", "generic", 0);
+	add_kernel_(KERNEL_CRC16, "crc16", "generic", 0)->fn.crc16 = &FLAC__crc16_functions;
+	add_kernel_(KERNEL_CRC16_WORDS32, "crc16_words32", "generic", 0)->fn.crc16 = &FLAC__crc16_functions;
+	add_kernel_(KERNEL_CRC16_WORDS64, "crc16_words64", "generic", 0)->fn.crc16 = &FLAC__crc16_functions;
+	add_kernel_(KERNEL_MD5, "md5", "generic", 0)->fn.md5_format_input = FLAC__md5_format_input;
+
+#if !defined FLAC__NO_ASM && (defined FLAC__CPU_IA32 || defined FLAC__CPU_X86_64) && FLAC__HAS_X86INTRIN
+	if(cpuinfo->use_asm) {
+# ifdef FLAC__SSE2_SUPPORTED
+		if(cpuinfo->x86.sse2) {
+#  ifndef FLAC__INTEGER_ONLY_LIBRARY
+			add_kernel_(KERNEL_AUTOCORRELATION, "autocorrelation", "sse2_lag_10", 0)->fn.autocorrelation = FLAC__lpc_compute_autocorrelation_intrin_sse2_lag_10;
+			add_kernel_(KERNEL_RESIDUAL, "residual", "sse2_16", 16)->fn.residual = FLAC__lpc_compute_residual_from_qlp_coefficients_16_intrin_sse2;
+#   ifdef FLAC__CPU_IA32
+			add_kernel_(KERNEL_RESIDUAL, "residual", "sse2", 16)->fn.residual = FLAC__lpc_compute_residual_from_qlp_coefficients_intrin_sse2;
+#   endif
+#  endif
+			add_kernel_(KERNEL_FIXED_RESTORE, "fixed_restore", "sse2", 0)->fn.fixed_restore = FLAC__fixed_restore_signal_intrin_sse2;
+			add_kernel_(KERNEL_MD5, "md5", "sse2", 0)->fn.md5_format_input = FLAC__md5_format_input_intrin_sse2;
+		}
+# endif
+# ifdef FLAC__SSE4_1_SUPPORTED
+		if(cpuinfo->x86.sse41) {
+#  ifndef FLAC__INTEGER_ONLY_LIBRARY
+			add_kernel_(KERNEL_RESIDUAL, "residual", "sse41", 16)->fn.residual = FLAC__lpc_compute_residual_from_qlp_coefficients_intrin_sse41;
+#   ifdef FLAC__CPU_IA32
+			add_kernel_(KERNEL_RESIDUAL, "residual_wide", "sse41", 0)->fn.residual = FLAC__lpc_compute_residual_from_qlp_coefficients_wide_intrin_sse41;
+#   endif
+#  endif
+			add_kernel_(KERNEL_LPC_RESTORE, "lpc_restore", "sse41", 16)->fn.lpc_restore = FLAC__lpc_restore_signal_intrin_sse41;
+			add_kernel_(KERNEL_LPC_RESTORE, "lpc_restore_wide", "sse41", 0)->fn.lpc_restore = FLAC__lpc_restore_signal_wide_intrin_sse41;
+		}
+# endif
+# ifdef FLAC__PCLMUL_SUPPORTED
+		if(cpuinfo->x86.pclmul && cpuinfo->x86.ssse3) {
+			add_kernel_(KERNEL_CRC16, "crc16", "pclmul", 0)->fn.crc16 = &FLAC__crc16_functions_intrin_pclmul;
+			add_kernel_(KERNEL_CRC16_WORDS32, "crc16_words32", "pclmul", 0)->fn.crc16 = &FLAC__crc16_functions_intrin_pclmul;
+			add_kernel_(KERNEL_CRC16_WORDS64, "crc16_words64", "pclmul", 0)->fn.crc16 = &FLAC__crc16_functions_intrin_pclmul;
+		}
+# endif
+# ifdef FLAC__AVX2_SUPPORTED
+		if(cpuinfo->x86.avx2) {
+#  ifndef FLAC__INTEGER_ONLY_LIBRARY
+			add_kernel_(KERNEL_RESIDUAL, "residual", "avx2_16", 16)->fn.residual = FLAC__lpc_compute_residual_from_qlp_coefficients_16_intrin_avx2;
+			add_kernel_(KERNEL_RESIDUAL, "residual", "avx2", 16)->fn.residual = FLAC__lpc_compute_residual_from_qlp_coefficients_intrin_avx2;
+			add_kernel_(KERNEL_RESIDUAL, "residual_wide", "avx2", 0)->fn.residual = FLAC__lpc_compute_residual_from_qlp_coefficients_wide_intrin_avx2;
+#  endif
+			add_kernel_(KERNEL_LPC_RESTORE, "lpc_restore", "avx2", 16)->fn.lpc_restore = FLAC__lpc_restore_signal_intrin_avx2;
+			add_kernel_(KERNEL_LPC_RESTORE, "lpc_restore_wide", "avx2", 0)->fn.lpc_restore = FLAC__lpc_restore_signal_wide_intrin_avx2;
+			add_kernel_(KERNEL_FIXED_RESTORE, "fixed_restore", "avx2", 0)->fn.fixed_restore = FLAC__fixed_restore_signal_intrin_avx2;
+			add_kernel_(KERNEL_MD5, "md5", "avx2", 0)->fn.md5_format_input = FLAC__md5_format_input_intrin_avx2;
+		}
+# endif
+# if defined FLAC__CPU_X86_64 && defined FLAC__FMA_SUPPORTED && !defined FLAC__INTEGER_ONLY_LIBRARY
+		if(cpuinfo->x86.fma)
+			add_kernel_(KERNEL_AUTOCORRELATION, "autocorrelation", "fma_lag_12", 0)->fn.autocorrelation = FLAC__lpc_compute_autocorrelation_intrin_fma_lag_12;
+# endif
+	}
+#endif
+#if ENABLE_64_BIT_WORDS && defined FLAC__AVX2_SUPPORTED
+	if(cpuinfo->x86.avx2)
+		add_kernel_(KERNEL_RICE_WRITE, "rice_write", "avx2", 0)->fn.rice_write = FLAC__bitwriter_write_rice_signed_block_avx2;
+#endif
+#ifdef FLAC__BMI2_SUPPORTED
+	if(cpuinfo->x86.bmi2)
+		add_kernel_(KERNEL_RICE_READ, "rice_read", "bmi2", 0)->fn.rice_read = FLAC__bitreader_read_rice_signed_block_bmi2;
+#endif
+#if ENABLE_64_BIT_WORDS && defined FLAC__AVX2_SUPPORTED && defined FLAC__BMI2_SUPPORTED
+	if(cpuinfo->x86.avx2 && cpuinfo->x86.bmi2)
+		add_kernel_(KERNEL_RICE_READ, "rice_read", "avx2", 0)->fn.rice_read = FLAC__bitreader_read_rice_signed_block_avx2;
+#endif
+
+#if !defined FLAC__NO_ASM && defined FLAC__CPU_ARM64 && FLAC__HAS_NEONINTRIN
+# ifndef FLAC__INTEGER_ONLY_LIBRARY
+#  if FLAC__HAS_A64NEONINTRIN
+	add_kernel_(KERNEL_AUTOCORRELATION, "autocorrelation", "neon_lag_10", 0)->fn.autocorrelation = FLAC__lpc_compute_autocorrelation_intrin_neon_lag_10;
+#  endif
+	add_kernel_(KERNEL_RESIDUAL, "residual", "neon", 16)->fn.residual = FLAC__lpc_compute_residual_from_qlp_coefficients_intrin_neon;
+	add_kernel_(KERNEL_RESIDUAL, "residual_wide", "neon", 0)->fn.residual = FLAC__lpc_compute_residual_from_qlp_coefficients_wide_intrin_neon;
+# endif
+	add_kernel_(KERNEL_LPC_RESTORE, "lpc_restore", "neon", 16)->fn.lpc_restore = FLAC__lpc_restore_signal_intrin_neon;
+	add_kernel_(KERNEL_LPC_RESTORE, "lpc_restore_wide", "neon", 0)->fn.lpc_restore = FLAC__lpc_restore_signal_wide_intrin_neon;
+# if ENABLE_64_BIT_WORDS
+	add_kernel_(KERNEL_RICE_READ, "rice_read", "neon", 0)->fn.rice_read = FLAC__bitreader_read_rice_signed_block_neon;
+# endif
+# if !WORDS_BIGENDIAN
+	add_kernel_(KERNEL_MD5, "md5", "neon", 0)->fn.md5_format_input = FLAC__md5_format_input_intrin_neon;
+# endif
+#endif
+}
+
+static FLAC__bool rice_read_callback_(FLAC__byte buffer[], size_t *bytes, void *client_data)
+{
+	memory_stream *stream = (memory_stream *)client_data;
+
+	if(*bytes > stream->bytes - stream->position)
+		*bytes = stream->bytes - stream->position;
+	memcpy(buffer, stream->data + stream->position, *bytes);
+	stream->position += *bytes;
+	return *bytes > 0;
+}
+
+static void free_kernel_input_(kernel_input *in)
+{
+	free(in->signal);
+	free(in->output);
+	free(in->lpc_residual);
+	free(in->fixed_residual);
+	free(in->qlp_coeff);
+	free(in->shift);
+	free(in->rice_parameter);
+	free(in->decoded);
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	free(in->windowed);
+#endif
+	free(in->rice.data);
+	if(0 != in->bw)
+		FLAC__bitwriter_delete(in->bw);
+	if(0 != in->br)
+		FLAC__bitreader_delete(in->br);
+}
+
+/* Prepares the input of every kernel with the plain C versions, which
+ * also gives the reference results the other variants are checked against. */
+static FLAC__bool init_kernel_input_(kernel_input *in, uint32_t bps, uint32_t seconds)
+{
+	const FLAC__int32 *md5_signal[2];
+	FLAC__MD5Context md5;
+	const FLAC__byte *buffer;
+	size_t bytes;
+	uint32_t block, i;
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	FLAC__real *window;
+	FLAC__real lp_coeff[FLAC__MAX_LPC_ORDER][FLAC__MAX_LPC_ORDER];
+	double autoc[FLAC__MAX_LPC_ORDER + 1], error[FLAC__MAX_LPC_ORDER];
+	uint32_t max_order;
+#endif
+
+	memset(in, 0, sizeof(*in));
+	in->bps = bps;
+	in->blocks = (seconds * SAMPLE_RATE + BLOCKSIZE - 1) / BLOCKSIZE;
+	in->samples = in->blocks * BLOCKSIZE;
+
+	in->signal = malloc(sizeof(FLAC__int32) * in->samples);
+	in->output = malloc(sizeof(FLAC__int32) * in->samples);
+	in->lpc_residual = calloc(in->samples, sizeof(FLAC__int32));
+	in->fixed_residual = calloc(in->samples, sizeof(FLAC__int32));
+	in->qlp_coeff = calloc(in->blocks * LPC_ORDER, sizeof(FLAC__int32));
+	in->shift = calloc(in->blocks, sizeof(int));
+	in->rice_parameter = malloc(sizeof(uint32_t) * in->blocks);
+	in->decoded = malloc(sizeof(int) * BLOCKSIZE);
+	in->bw = FLAC__bitwriter_new();
+	in->br = FLAC__bitreader_new();
+	if(0 == in->signal || 0 == in->output || 0 == in->lpc_residual || 0 == in->fixed_residual || 0 == in->qlp_coeff ||
+	   0 == in->shift || 0 == in->rice_parameter || 0 == in->decoded || 0 == in->bw || 0 == in->br ||
+	   !FLAC__bitwriter_init(in->bw) || !FLAC__bitreader_init(in->br, rice_read_callback_, &in->rice))
+		return false;
+
+	generate_signal_(SIGNAL_SWEEP, 1, bps, in->samples, in->signal);
+	memcpy(in->output, in->signal, sizeof(FLAC__int32) * in->samples);
+
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	if(0 == (in->windowed = malloc(sizeof(FLAC__real) * in->samples)) || 0 == (window = malloc(sizeof(FLAC__real) * BLOCKSIZE)))
+		return false;
+	FLAC__window_hann(window, BLOCKSIZE);
+	for(block = 0; block < in->blocks; block++) {
+		const uint32_t offset = block * BLOCKSIZE;
+		FLAC__lpc_window_data(in->signal + offset, window, in->windowed + offset, BLOCKSIZE);
+		FLAC__lpc_compute_autocorrelation(in->windowed + offset, BLOCKSIZE, LPC_ORDER + 1, autoc);
+		if(autoc[0] != 0.0) {
+			max_order = LPC_ORDER;
+			FLAC__lpc_compute_lp_coefficients(autoc, &max_order, lp_coeff, error);
+			/* a lower order found by the solver is padded with zero coefficients */
+			if(0 != FLAC__lpc_quantize_coefficients(lp_coeff[max_order - 1], max_order, QLP_COEFF_PRECISION, in->qlp_coeff + block * LPC_ORDER, &in->shift[block]))
+				memset(in->qlp_coeff + block * LPC_ORDER, 0, sizeof(FLAC__int32) * LPC_ORDER);
+		}
+		FLAC__lpc_compute_residual_from_qlp_coefficients_wide(in->signal + offset + LPC_ORDER, BLOCKSIZE - LPC_ORDER, in->qlp_coeff + block * LPC_ORDER, LPC_ORDER, in->shift[block], in->lpc_residual + offset + LPC_ORDER);
+	}
+	free(window);
+#endif
+
+	for(block = 0; block < in->blocks; block++) {
+		const uint32_t offset = block * BLOCKSIZE;
+		double sum = 0.0;
+		uint32_t parameter = 0;
+
+		FLAC__fixed_compute_residual(in->signal + offset + FIXED_ORDER, BLOCKSIZE - FIXED_ORDER, FIXED_ORDER, in->fixed_residual + offset + FIXED_ORDER);
+		for(i = FIXED_ORDER; i < BLOCKSIZE; i++)
+			sum += fabs((double)in->fixed_residual[offset + i]);
+		/* the parameter whose rice code suits the mean of the absolute residual */
+		while(parameter < FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2_ESCAPE_PARAMETER - 1 && (double)((FLAC__uint32)2 << parameter) < sum / (BLOCKSIZE - FIXED_ORDER))
+			parameter++;
+		in->rice_parameter[block] = parameter;
+		if(!FLAC__bitwriter_write_rice_signed_block(in->bw, in->fixed_residual + offset + FIXED_ORDER, BLOCKSIZE - FIXED_ORDER, parameter))
+			return false;
+	}
+	if(!FLAC__bitwriter_zero_pad_to_byte_boundary(in->bw) || !FLAC__bitwriter_get_buffer(in->bw, &buffer, &bytes))
+		return false;
+	/* words of padding, for the word-wise CRC kernels */
+	if(0 == (in->rice.data = calloc(bytes + 8, 1))) {
+		FLAC__bitwriter_release_buffer(in->bw);
+		return false;
+	}
+	memcpy(in->rice.data, buffer, bytes);
+	in->rice.bytes = bytes;
+	FLAC__bitwriter_release_buffer(in->bw);
+
+	FLAC__MD5Init(&md5);
+	md5_signal[0] = md5_signal[1] = in->signal;
+	if(!FLAC__MD5Accumulate(&md5, md5_signal, 2, in->samples, bps / 8))
+		return false;
+	FLAC__MD5Final(in->md5sum, &md5);
+
+	return true;
+}
+
+/* Runs the kernel once over all blocks of the input.  With check set,
+ * the results are compared to the ones of the plain C version. */
+static FLAC__bool run_kernel_(const bench_kernel *kernel, kernel_input *in, FLAC__bool check)
+{
+	const FLAC__int32 *md5_signal[2];
+	FLAC__MD5Context md5;
+	FLAC__byte md5sum[16];
+	uint32_t block;
+	volatile FLAC__uint32 crc = 0; /* keeps the CRC kernels from being optimized away */
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	double autoc[FLAC__MAX_LPC_ORDER + 1]; /* the kernels may compute more lags than asked for */
+#endif
+
+	switch(kernel->type) {
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+		case KERNEL_AUTOCORRELATION:
+			for(block = 0; block < in->blocks; block++)
+				kernel->fn.autocorrelation(in->windowed + block * BLOCKSIZE, BLOCKSIZE, LPC_ORDER + 1, autoc);
+			break;
+		case KERNEL_RESIDUAL:
+			for(block = 0; block < in->blocks; block++) {
+				const uint32_t offset = block * BLOCKSIZE;
+				kernel->fn.residual(in->signal + offset + LPC_ORDER, BLOCKSIZE - LPC_ORDER, in->qlp_coeff + block * LPC_ORDER, LPC_ORDER, in->shift[block], in->output + offset + LPC_ORDER);
+			}
+			if(check) {
+				for(block = 0; block < in->blocks; block++) {
+					const uint32_t offset = block * BLOCKSIZE;
+					if(memcmp(in->output + offset + LPC_ORDER, in->lpc_residual + offset + LPC_ORDER, sizeof(FLAC__int32) * (BLOCKSIZE - LPC_ORDER)))
+						return false;
+				}
+				memcpy(in->output, in->signal, sizeof(FLAC__int32) * in->samples);
+			}
+			break;
+		case KERNEL_LPC_RESTORE:
+			for(block = 0; block < in->blocks; block++) {
+				const uint32_t offset = block * BLOCKSIZE;
+				kernel->fn.lpc_restore(in->lpc_residual + offset + LPC_ORDER, BLOCKSIZE - LPC_ORDER, in->qlp_coeff + block * LPC_ORDER, LPC_ORDER, in->shift[block], in->output + offset + LPC_ORDER);
+			}
+			if(check && memcmp(in->output, in->signal, sizeof(FLAC__int32) * in->samples))
+				return false;
+			break;
+#else
+		case KERNEL_AUTOCORRELATION:
+		case KERNEL_RESIDUAL:
+		case KERNEL_LPC_RESTORE:
+			return false;
+#endif
+		case KERNEL_FIXED_RESTORE:
+			for(block = 0; block < in->blocks; block++) {
+				const uint32_t offset = block * BLOCKSIZE;
+				kernel->fn.fixed_restore(in->fixed_residual + offset + FIXED_ORDER, BLOCKSIZE - FIXED_ORDER, FIXED_ORDER, in->output + offset + FIXED_ORDER);
+			}
+			if(check && memcmp(in->output, in->signal, sizeof(FLAC__int32) * in->samples))
+				return false;
+			break;
+		case KERNEL_RICE_WRITE:
+			FLAC__bitwriter_clear(in->bw);
+			for(block = 0; block < in->blocks; block++) {
+				const uint32_t offset = block * BLOCKSIZE;
+				if(!kernel->fn.rice_write(in->bw, in->fixed_residual + offset + FIXED_ORDER, BLOCKSIZE - FIXED_ORDER, in->rice_parameter[block]))
+					return false;
+			}
+			if(check) {
+				const FLAC__byte *buffer;
+				size_t bytes;
+				FLAC__bool ok;
+				if(!FLAC__bitwriter_zero_pad_to_byte_boundary(in->bw) || !FLAC__bitwriter_get_buffer(in->bw, &buffer, &bytes))
+					return false;
+				ok = bytes == in->rice.bytes && 0 == memcmp(buffer, in->rice.data, bytes);
+				FLAC__bitwriter_release_buffer(in->bw);
+				if(!ok)
+					return false;
+			}
+			break;
+		case KERNEL_RICE_READ:
+			in->rice.position = 0;
+			FLAC__bitreader_clear(in->br);
+			for(block = 0; block < in->blocks; block++) {
+				const uint32_t offset = block * BLOCKSIZE;
+				if(!kernel->fn.rice_read(in->br, in->decoded, BLOCKSIZE - FIXED_ORDER, in->rice_parameter[block]))
+					return false;
+				if(check && memcmp(in->decoded, in->fixed_residual + offset + FIXED_ORDER, sizeof(int) * (BLOCKSIZE - FIXED_ORDER)))
+					return false;
+			}
+			break;
+		case KERNEL_CRC8:
+			crc = FLAC__crc8(in->rice.data, (uint32_t)in->rice.bytes);
+			break;
+		case KERNEL_CRC16:
+			crc = kernel->fn.crc16->update(in->rice.data, (uint32_t)in->rice.bytes, 0);
+			if(check && crc != FLAC__crc16(in->rice.data, (uint32_t)in->rice.bytes))
+				return false;
+			break;
+		case KERNEL_CRC16_WORDS32:
+			crc = kernel->fn.crc16->update_words32((const FLAC__uint32 *)in->rice.data, (uint32_t)(in->rice.bytes / 4), 0);
+			if(check && crc != FLAC__crc16_update_words32((const FLAC__uint32 *)in->rice.data, (uint32_t)(in->rice.bytes / 4), 0))
+				return false;
+			break;
+		case KERNEL_CRC16_WORDS64:
+			crc = kernel->fn.crc16->update_words64((const FLAC__uint64 *)in->rice.data, (uint32_t)(in->rice.bytes / 8), 0);
+			if(check && crc != FLAC__crc16_update_words64((const FLAC__uint64 *)in->rice.data, (uint32_t)(in->rice.bytes / 8), 0))
+				return false;
+			break;
+		case KERNEL_MD5:
+			FLAC__MD5Init(&md5);
+			md5.format_input = kernel->fn.md5_format_input;
+			for(block = 0; block < in->blocks; block++) {
+				md5_signal[0] = md5_signal[1] = in->signal + block * BLOCKSIZE;
+				if(!FLAC__MD5Accumulate(&md5, md5_signal, 2, BLOCKSIZE, in->bps / 8))
+					return false;
+			}
+			FLAC__MD5Final(md5sum, &md5);
+			if(check && memcmp(md5sum, in->md5sum, 16))
+				return false;
+			break;
+		default:
+			return false;
+	}
+	(void)crc;
+	return true;
+}
+
+static FLAC__bool bench_kernels_(FILE *out, uint32_t seconds, uint32_t repetitions)
+{
+	kernel_input in;
+	double ns[MAX_REPETITIONS];
+	bench_stats stats;
+	FLAC__bool first = true;
+	uint32_t b, k, r;
+
+	fprintf(out, "  \"kernels\": [\n");
+	for(b = 0; b < sizeof(kernel_bps) / sizeof(kernel_bps[0]); b++) {
+		if(!init_kernel_input_(&in, kernel_bps[b], seconds)) {
+			fprintf(stderr, "flac_bench: ERROR: could not prepare the input of the kernels\n");
+			free_kernel_input_(&in);
+			return false;
+		}
+		for(k = 0; k < num_kernels_; k++) {
+			const bench_kernel *kernel = &kernels_[k];
+
+			if(kernel->max_bps > 0 && in.bps > kernel->max_bps)
+				continue;
+			fprintf(stderr, "flac_bench: kernel %s (%s), %u bit\n", kernel->name, kernel->variant, in.bps);
+			if(!run_kernel_(kernel, &in, /*check=*/true)) {
+				fprintf(stderr, "flac_bench: ERROR: kernel %s (%s) gives wrong results\n", kernel->name, kernel->variant);
+				free_kernel_input_(&in);
+				return false;
+			}
+			for(r = 0; r < repetitions; r++) {
+				const FLAC__uint64 start = nanoseconds_();
+				(void)run_kernel_(kernel, &in, /*check=*/false);
+				ns[r] = (double)(nanoseconds_() - start);
+			}
+			compute_stats_(ns, repetitions, &stats);
+
+			fprintf(out, "%s    { \"kernel\": \"%s\", \"variant\": \"%s\", \"bps\": %u, \"samples\": %u, \"msamples_per_second\": %.2f, ",
+				first? "" : ",\n", kernel->name, kernel->variant, in.bps, in.samples,
+				stats.median > 0.0? in.samples * 1000.0 / stats.median : 0.0);
+			print_stats_(out, "time", &stats);
+			fprintf(out, " }");
+			first = false;
+		}
+		free_kernel_input_(&in);
+	}
+	fprintf(out, "\n  ]");
+	return true;
+}
+
+static void print_cpu_(FILE *out, const FLAC__CPUInfo *cpuinfo)
+{
+	const char *arch =
+		cpuinfo->type == FLAC__CPUINFO_TYPE_X86_64? "x86_64" :
+		cpuinfo->type == FLAC__CPUINFO_TYPE_IA32? "ia32" :
+#ifdef FLAC__CPU_ARM64
+		"arm64";
+#else
+		"unknown";
+#endif
+
+	fprintf(out, "  \"cpu\": { \"arch\": \"%s\", \"use_asm\": %s", arch, cpuinfo->use_asm? "true" : "false");
+	if(cpuinfo->type == FLAC__CPUINFO_TYPE_X86_64 || cpuinfo->type == FLAC__CPUINFO_TYPE_IA32)
+		fprintf(out, ", \"sse2\": %s, \"ssse3\": %s, \"sse41\": %s, \"sse42\": %s, \"avx\": %s, \"avx2\": %s, \"fma\": %s, \"bmi2\": %s, \"pclmul\": %s",
+			cpuinfo->x86.sse2? "true" : "false",
+			cpuinfo->x86.ssse3? "true" : "false",
+			cpuinfo->x86.sse41? "true" : "false",
+			cpuinfo->x86.sse42? "true" : "false",
+			cpuinfo->x86.avx? "true" : "false",
+			cpuinfo->x86.avx2? "true" : "false",
+			cpuinfo->x86.fma? "true" : "false",
+			cpuinfo->x86.bmi2? "true" : "false",
+			cpuinfo->x86.pclmul? "true" : "false");
+	fprintf(out, " },\n");
+}
+
+static void usage_(void)
+{
+	printf("usage: flac_bench [options]\n");
+	printf("\n");
+	printf("Times the encoder presets, the decoder and the kernels of libFLAC on\n");
+	printf("generated audio and writes the results as JSON.\n");
+	printf("\n");
+	printf("  --seconds=#       Length of each generated signal (default 2)\n");
+	printf("  --repetitions=#   Number of timed runs of everything (default 5)\n");
+	printf("  --output=FILE     Write the JSON to FILE instead of stdout\n");
+	printf("  --presets-only    Only time the presets\n");
+	printf("  --kernels-only    Only time the kernels\n");
+}
+
+int main(int argc, char *argv[])
+{
+	FLAC__CPUInfo cpuinfo;
+	FILE *out = stdout;
+	const char *output = 0;
+	uint32_t seconds = 2, repetitions = 5;
+	FLAC__bool presets = true, kernels = true, ok = true;
+	int i;
+
+	for(i = 1; i < argc; i++) {
+		if(0 == strncmp(argv[i], "--seconds=", 10))
+			seconds = (uint32_t)strtoul(argv[i] + 10, 0, 10);
+		else if(0 == strncmp(argv[i], "--repetitions=", 14))
+			repetitions = (uint32_t)strtoul(argv[i] + 14, 0, 10);
+		else if(0 == strncmp(argv[i], "--output=", 9))
+			output = argv[i] + 9;
+		else if(0 == strcmp(argv[i], "--presets-only"))
+			kernels = false;
+		else if(0 == strcmp(argv[i], "--kernels-only"))
+			presets = false;
+		else {
+			usage_();
+			return strcmp(argv[i], "--help")? 1 : 0;
+		}
+	}
+	if(seconds == 0 || seconds > 600 || repetitions == 0 || repetitions > MAX_REPETITIONS || (!presets && !kernels)) {
+		usage_();
+		return 1;
+	}
+	if(0 != output && 0 == (out = fopen(output, "w"))) {
+		fprintf(stderr, "flac_bench: ERROR: could not open %s for writing\n", output);
+		return 1;
+	}
+
+	FLAC__cpu_info(&cpuinfo);
+	add_kernels_(&cpuinfo);
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"version\": \"%s\",\n", FLAC__VENDOR_STRING);
+	print_cpu_(out, &cpuinfo);
+	fprintf(out, "  \"sample_rate\": %u,\n", SAMPLE_RATE);
+	fprintf(out, "  \"seconds\": %u,\n", seconds);
+	fprintf(out, "  \"repetitions\": %u", repetitions);
+	if(presets) {
+		fprintf(out, ",\n");
+		ok = bench_presets_(out, seconds, repetitions);
+	}
+	if(ok && kernels) {
+		fprintf(out, ",\n");
+		ok = bench_kernels_(out, seconds, repetitions);
+	}
+	fprintf(out, "\n}\n");
+
+	if(out != stdout)
+		fclose(out);
+	return ok? 0 : 1;
+}
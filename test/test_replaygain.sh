@@ -140,4 +140,46 @@ for ACTION in $REPLAYGAIN_FREQ ; do
   done
 done
 
+
+# Album gain of several files, which metaflac --threads and flac
+# --parallel-files analyze in whatever order the files finish: the tags
+# must be exactly the ones of a serial run. The tones are reinterpreted at
+# 44.1 kHz, so that the files differ but can form an album.
+
+rawformat="--force-raw-format --endian=little --sign=signed --channels=1 --bps=24 --sample-rate=44100"
+for RATE in 8000 16000 32000 44100 ; do
+  tonegenerator $RATE rpg-album.flac
+  run_flac --silent --force --decode --force-raw-format --endian=little --sign=signed --output-name=rpg-album-$RATE.raw rpg-album.flac || die "ERROR decoding rpg-album.flac"
+  run_flac --silent --force $rawformat --output-name=rpg-album-serial-$RATE.flac rpg-album-$RATE.raw || die "ERROR encoding rpg-album-$RATE.raw"
+  cp rpg-album-serial-$RATE.flac rpg-album-threads-$RATE.flac
+done
+
+echo $ECHO_N "Testing FLAC replaygain album with metaflac --threads ... " $ECHO_C
+run_metaflac --add-replay-gain rpg-album-serial-*.flac
+run_metaflac --threads=4 --add-replay-gain rpg-album-threads-*.flac
+for RATE in 8000 16000 32000 44100 ; do
+  run_metaflac --export-tags-to=rpg-album-serial.tags rpg-album-serial-$RATE.flac
+  run_metaflac --export-tags-to=rpg-album-threads.tags rpg-album-threads-$RATE.flac
+  cmp rpg-album-serial.tags rpg-album-threads.tags || die "ERROR, tags of rpg-album-threads-$RATE.flac differ from a serial run"
+done
+echo OK
+
+echo $ECHO_N "Testing FLAC replaygain album with flac --parallel-files ... " $ECHO_C
+run_flac --silent --force --replay-gain $rawformat --output-prefix=serial- rpg-album-*.raw || die "ERROR encoding with --replay-gain"
+if run_flac --silent --force --replay-gain --parallel-files=4 $rawformat --output-prefix=parallel- rpg-album-*.raw 2>rpg-album.err ; then
+  for RATE in 8000 16000 32000 44100 ; do
+    run_metaflac --export-tags-to=rpg-album-serial.tags serial-rpg-album-$RATE.flac
+    run_metaflac --export-tags-to=rpg-album-parallel.tags parallel-rpg-album-$RATE.flac
+    cmp rpg-album-serial.tags rpg-album-parallel.tags || die "ERROR, tags of parallel-rpg-album-$RATE.flac differ from a serial run"
+  done
+  echo OK
+elif grep "not available" rpg-album.err >/dev/null ; then
+  echo "skipped, multithreading is not enabled"
+else
+  cat rpg-album.err
+  die "ERROR encoding with --replay-gain --parallel-files"
+fi
+
+rm -f rpg-album* serial-rpg-album-* parallel-rpg-album-*
+
 exit 0